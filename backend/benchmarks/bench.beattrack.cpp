@@ -0,0 +1,39 @@
+#include "../include/beat-track.hpp"
+#include "../include/tempo-map.hpp"
+#include "benchmark.hpp"
+
+/**
+ * BeatTrack::renderBlock cost per sample across buffer sizes
+ */
+class BeatTrackBenchmark : public Benchmark {
+ public:
+  BeatTrackBenchmark() : Benchmark("BeatTrack") {}
+
+  void run(BenchmarkRunner& runner) override {
+    const TempoMap tempoMap(120.0, 44100.0);
+
+    // One second of audio per run, so every size covers beats and silence
+    constexpr int samplesPerRun = 44100;
+
+    for (int bufferSize = 32; bufferSize <= 4096; bufferSize *= 2) {
+      BeatTrack track(440.0f);
+      juce::AudioBuffer<float> buffer(1, bufferSize);
+      const int numBlocks = samplesPerRun / bufferSize;
+      juce::int64 position = 0;
+
+      runner.measure(
+          "renderBlock",
+          BenchmarkRunner::makeParameters({{"bufferSize", bufferSize}}),
+          (juce::int64)numBlocks * bufferSize, "sample", [&]() {
+            for (int block = 0; block < numBlocks; ++block) {
+              track.renderBlock(buffer, 0, bufferSize,
+                                tempoMap.getContext(position));
+              position += bufferSize;
+            }
+            BenchmarkRunner::doNotOptimize(buffer.getSample(0, 0));
+          });
+    }
+  }
+};
+
+static BeatTrackBenchmark beatTrackBenchmark;
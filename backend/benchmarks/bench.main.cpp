@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <iostream>
+#include "benchmark.hpp"
+
+namespace {
+volatile float benchmarkSink = 0.0f;
+}
+
+//==============================================================================
+Benchmark::Benchmark(const juce::String& benchmarkName) : name(benchmarkName) {
+  getAllBenchmarks().push_back(this);
+}
+
+Benchmark::~Benchmark() {
+  auto& all = getAllBenchmarks();
+  all.erase(std::remove(all.begin(), all.end(), this), all.end());
+}
+
+std::vector<Benchmark*>& Benchmark::getAllBenchmarks() {
+  static std::vector<Benchmark*> benchmarks;
+  return benchmarks;
+}
+
+//==============================================================================
+BenchmarkRunner::BenchmarkRunner(const Options& runnerOptions)
+    : options(runnerOptions) {}
+
+void BenchmarkRunner::runAll() {
+  for (auto* benchmark : Benchmark::getAllBenchmarks()) {
+    currentGroup = benchmark;
+    benchmark->run(*this);
+  }
+  currentGroup = nullptr;
+}
+
+void BenchmarkRunner::measure(const juce::String& caseName,
+                              const juce::var& parameters,
+                              juce::int64 itemsPerRun,
+                              const juce::String& itemUnit,
+                              const std::function<void()>& body) {
+  const auto fullName =
+      (currentGroup != nullptr ? currentGroup->getName() + "/" : juce::String()) +
+      caseName;
+  if (options.filter.isNotEmpty() && !fullName.contains(options.filter)) {
+    return;
+  }
+
+  body();  // Warm-up: caches, page faults, lazy initialisation
+
+  std::vector<double> nsPerItem;
+  double totalSeconds = 0.0;
+  while ((int)nsPerItem.size() < options.minRepetitions ||
+         totalSeconds < options.minSecondsPerCase) {
+    const auto start = juce::Time::getHighResolutionTicks();
+    body();
+    const double seconds = juce::Time::highResolutionTicksToSeconds(
+        juce::Time::getHighResolutionTicks() - start);
+
+    totalSeconds += seconds;
+    nsPerItem.push_back(seconds * 1.0e9 / (double)itemsPerRun);
+  }
+
+  std::sort(nsPerItem.begin(), nsPerItem.end());
+  double mean = 0.0;
+  for (const double value : nsPerItem) {
+    mean += value;
+  }
+  mean /= (double)nsPerItem.size();
+  lastNsPerItem = nsPerItem[nsPerItem.size() / 2];
+
+  auto* result = new juce::DynamicObject();
+  result->setProperty("name", fullName);
+  result->setProperty("parameters", parameters);
+  result->setProperty("unit", itemUnit);
+  result->setProperty("itemsPerRun", itemsPerRun);
+  result->setProperty("repetitions", (int)nsPerItem.size());
+  result->setProperty("nsPerItemMedian", lastNsPerItem);
+  result->setProperty("nsPerItemMin", nsPerItem.front());
+  result->setProperty("nsPerItemMean", mean);
+  result->setProperty("itemsPerSecond", 1.0e9 / lastNsPerItem);
+  results.add(juce::var(result));
+
+  juce::Logger::writeToLog(fullName + " " + juce::JSON::toString(parameters, true) +
+                           ": " + juce::String(lastNsPerItem, 3) + " ns/" +
+                           itemUnit);
+}
+
+void BenchmarkRunner::addMetric(const juce::String& key, double value) {
+  if (results.isEmpty()) {
+    return;
+  }
+
+  if (auto* result = results.getReference(results.size() - 1).getDynamicObject()) {
+    result->setProperty(key, value);
+  }
+}
+
+juce::var BenchmarkRunner::getReport() const {
+  auto* report = new juce::DynamicObject();
+  report->setProperty("version", JUCE_APPLICATION_VERSION_STRING);
+  report->setProperty("timestamp",
+                      juce::Time::getCurrentTime().toISO8601(true));
+  report->setProperty("cpu", juce::SystemStats::getCpuModel());
+  report->setProperty("numCpus", juce::SystemStats::getNumCpus());
+  report->setProperty("results", results);
+  return juce::var(report);
+}
+
+juce::var BenchmarkRunner::makeParameters(
+    std::initializer_list<std::pair<const char*, juce::var>> values) {
+  auto* parameters = new juce::DynamicObject();
+  for (const auto& [key, value] : values) {
+    parameters->setProperty(key, value);
+  }
+  return juce::var(parameters);
+}
+
+void BenchmarkRunner::doNotOptimize(float value) noexcept {
+  benchmarkSink = value;
+}
+
+//==============================================================================
+// Usage: DAWAudioEngine_Benchmarks [--output results.json] [--filter text]
+//                                  [--min-time seconds]
+int main(int argc, char* argv[]) {
+  juce::StringArray args;
+  for (int i = 1; i < argc; ++i) {
+    args.add(argv[i]);
+  }
+
+  auto getOption = [&args](const juce::String& name) {
+    const int index = args.indexOf(name);
+    return index >= 0 && index + 1 < args.size() ? args[index + 1]
+                                                 : juce::String();
+  };
+
+  BenchmarkRunner::Options options;
+  options.filter = getOption("--filter");
+  if (const auto minTime = getOption("--min-time"); minTime.isNotEmpty()) {
+    options.minSecondsPerCase = minTime.getDoubleValue();
+  }
+
+  BenchmarkRunner runner(options);
+  runner.runAll();
+
+  const auto json = juce::JSON::toString(runner.getReport());
+  if (const auto output = getOption("--output"); output.isNotEmpty()) {
+    const auto file =
+        juce::File::getCurrentWorkingDirectory().getChildFile(output);
+    if (!file.replaceWithText(json)) {
+      std::cerr << "Cannot write " << output << std::endl;
+      return 1;
+    }
+  } else {
+    std::cout << json << std::endl;
+  }
+
+  return 0;
+}
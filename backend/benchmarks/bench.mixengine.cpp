@@ -0,0 +1,268 @@
+#include "../include/audio-context.hpp"
+#include "../include/audio-effect.hpp"
+#include "../include/beat-track.hpp"
+#include "../include/channel-strip.hpp"
+#include "../include/mix-engine.hpp"
+#include "benchmark.hpp"
+
+/**
+ * Full mix cost (render + mix + master gain) for growing sessions, with
+ * serial and parallel track rendering, the cost of level metering and
+ * detailed profiling, the track mix kernel against separate passes, the
+ * saving of skipping silent ranges in a sparse session, and submix buses
+ * with insert effects run serially or on the worker pool
+ */
+class MixEngineBenchmark : public Benchmark {
+ public:
+  MixEngineBenchmark() : Benchmark("MixEngine") {}
+
+  void run(BenchmarkRunner& runner) override {
+    auto& ctx = AudioContext::getInstance();
+    ctx.sampleRate = 44100.0;
+
+    constexpr int blockSize = 512;
+    constexpr int blocksPerRun = 16;
+    const double blockSeconds = blockSize / ctx.sampleRate;
+    const int threadCounts[] = {0, RenderWorkerPool::getDefaultThreadCount()};
+
+    for (const int numTracks : {1, 10, 50, 100, 250, 500, 1000}) {
+      for (const int numThreads : threadCounts) {
+        MixEngine engine(numThreads);
+        for (int i = 0; i < numTracks; ++i) {
+          engine.addTrack(std::make_shared<BeatTrack>(200.0f + (float)(i % 64) * 10.0f));
+        }
+        engine.prepare(blockSize, ctx.sampleRate);
+        juce::AudioBuffer<float> output(2, blockSize);
+
+        runner.measure("process",
+                       BenchmarkRunner::makeParameters(
+                           {{"tracks", numTracks},
+                            {"renderThreads", numThreads},
+                            {"blockSize", blockSize}}),
+                       blocksPerRun, "block", [&]() {
+                         for (int block = 0; block < blocksPerRun; ++block) {
+                           engine.process(output, 0, blockSize);
+                         }
+                         BenchmarkRunner::doNotOptimize(output.getSample(0, 0));
+                       });
+
+        // Fraction of the block deadline spent in the mix
+        runner.addMetric("dspLoad", runner.getLastNanosecondsPerItem() * 1.0e-9 /
+                                        blockSeconds);
+
+        if (numThreads == threadCounts[1]) {
+          break;  // Avoid a duplicate case on single-core machines
+        }
+      }
+    }
+
+    // Metering on/off at a large session (serial, so the cost is not hidden
+    // by idle workers)
+    constexpr int meterTracks = 500;
+    double unmeteredNs = 0.0;
+    for (const bool metering : {false, true}) {
+      MixEngine engine(0);
+      for (int i = 0; i < meterTracks; ++i) {
+        engine.addTrack(std::make_shared<BeatTrack>(200.0f + (float)(i % 64) * 10.0f));
+      }
+      engine.prepare(blockSize, ctx.sampleRate);
+      engine.setMeteringEnabled(metering);
+      juce::AudioBuffer<float> output(2, blockSize);
+
+      runner.measure("metering",
+                     BenchmarkRunner::makeParameters({{"tracks", meterTracks},
+                                                      {"metering", metering},
+                                                      {"blockSize", blockSize}}),
+                     blocksPerRun, "block", [&]() {
+                       for (int block = 0; block < blocksPerRun; ++block) {
+                         engine.process(output, 0, blockSize);
+                         // Drain frames like the WebSocket meter thread
+                         if (const auto* frame = engine.readMeters()) {
+                           BenchmarkRunner::doNotOptimize(frame->master[0].peak);
+                         }
+                       }
+                     });
+
+      if (metering) {
+        // Relative cost of metering every track and the master bus
+        runner.addMetric("overhead",
+                         runner.getLastNanosecondsPerItem() / unmeteredNs - 1.0);
+      } else {
+        unmeteredNs = runner.getLastNanosecondsPerItem();
+      }
+    }
+
+    // Per-track timing on/off at the same session size
+    double untimedNs = 0.0;
+    for (const bool detailed : {false, true}) {
+      EngineProfiler profiler;
+      profiler.prepare(ctx.sampleRate);
+      profiler.setDetailed(detailed);
+      MixEngine engine(0);
+      engine.setProfiler(&profiler);
+      for (int i = 0; i < meterTracks; ++i) {
+        engine.addTrack(std::make_shared<BeatTrack>(200.0f + (float)(i % 64) * 10.0f));
+      }
+      engine.prepare(blockSize, ctx.sampleRate);
+      juce::AudioBuffer<float> output(2, blockSize);
+
+      runner.measure("profiling",
+                     BenchmarkRunner::makeParameters({{"tracks", meterTracks},
+                                                      {"detailed", detailed},
+                                                      {"blockSize", blockSize}}),
+                     blocksPerRun, "block", [&]() {
+                       for (int block = 0; block < blocksPerRun; ++block) {
+                         engine.process(output, 0, blockSize);
+                       }
+                       BenchmarkRunner::doNotOptimize(output.getSample(0, 0));
+                     });
+
+      if (detailed) {
+        runner.addMetric("overhead",
+                         runner.getLastNanosecondsPerItem() / untimedNs - 1.0);
+      } else {
+        untimedNs = runner.getLastNanosecondsPerItem();
+      }
+    }
+
+    // Beat tracks sound 170 ms out of every 500 ms beat: mixing and metering
+    // only their active ranges, against tracks reporting signal everywhere
+    double denseNs = 0.0;
+    for (const bool reportActivity : {false, true}) {
+      MixEngine engine(0);
+      for (int i = 0; i < meterTracks; ++i) {
+        const float frequency = 200.0f + (float)(i % 64) * 10.0f;
+        if (reportActivity) {
+          engine.addTrack(std::make_shared<BeatTrack>(frequency));
+        } else {
+          engine.addTrack(std::make_shared<AlwaysActiveTrack>(frequency));
+        }
+      }
+      engine.prepare(blockSize, ctx.sampleRate);
+      juce::AudioBuffer<float> output(2, blockSize);
+
+      runner.measure("sparse",
+                     BenchmarkRunner::makeParameters({{"tracks", meterTracks},
+                                                      {"activity", reportActivity},
+                                                      {"blockSize", blockSize}}),
+                     blocksPerRun, "block", [&]() {
+                       for (int block = 0; block < blocksPerRun; ++block) {
+                         engine.process(output, 0, blockSize);
+                       }
+                       BenchmarkRunner::doNotOptimize(output.getSample(0, 0));
+                     });
+
+      if (reportActivity) {
+        runner.addMetric("speedup", denseNs / runner.getLastNanosecondsPerItem());
+      } else {
+        denseNs = runner.getLastNanosecondsPerItem();
+      }
+    }
+
+    // Tracks grouped on buses, each running a filter and a delay, summed by
+    // one group bus: bus levels serial against on the worker pool
+    constexpr int busTracks = 256;
+    double serialBusNs = 0.0;
+    for (const int numThreads : threadCounts) {
+      for (const int numBuses : {4, 16, 64}) {
+        MixEngine engine(numThreads);
+        for (int i = 0; i < busTracks; ++i) {
+          engine.addTrack(std::make_shared<BeatTrack>(200.0f + (float)(i % 64) * 10.0f));
+        }
+        engine.prepare(blockSize, ctx.sampleRate);
+
+        const int groupBus = engine.addBus(std::make_shared<MixBus>("Groups"));
+        for (int bus = 0; bus < numBuses; ++bus) {
+          const int index = engine.addBus(std::make_shared<MixBus>(), groupBus);
+          engine.setEffects(index,
+                            {std::make_shared<BiquadFilter>(BiquadFilter::Type::LowPass,
+                                                            500.0 + 50.0 * bus, 0.707),
+                             std::make_shared<DelayEffect>(0.1 + 0.01 * bus, 0.4f, 0.3f)});
+          for (int track = bus; track < busTracks; track += numBuses) {
+            engine.setTrackOutput((size_t)track, index);
+          }
+        }
+        juce::AudioBuffer<float> output(2, blockSize);
+
+        runner.measure("buses",
+                       BenchmarkRunner::makeParameters({{"tracks", busTracks},
+                                                        {"buses", numBuses},
+                                                        {"renderThreads", numThreads},
+                                                        {"blockSize", blockSize}}),
+                       blocksPerRun, "block", [&]() {
+                         for (int block = 0; block < blocksPerRun; ++block) {
+                           engine.process(output, 0, blockSize);
+                         }
+                         BenchmarkRunner::doNotOptimize(output.getSample(0, 0));
+                       });
+
+        if (numThreads == 0 && numBuses == 64) {
+          serialBusNs = runner.getLastNanosecondsPerItem();
+        } else if (numThreads > 0 && numBuses == 64) {
+          runner.addMetric("speedup", serialBusNs / runner.getLastNanosecondsPerItem());
+        }
+      }
+
+      if (numThreads == threadCounts[1]) {
+        break;
+      }
+    }
+
+    // Mixing one rendered track into the stereo bus: gain, pan and sum as
+    // separate passes, against the fused kernel (mono, while a gain ramps).
+    // Both copy the track first, standing in for its render.
+    constexpr int mixTracks = 64;
+    juce::AudioBuffer<float> trackBuffer(1, blockSize);
+    juce::AudioBuffer<float> rendered(1, blockSize);
+    juce::AudioBuffer<float> bus(2, blockSize);
+    for (int i = 0; i < blockSize; ++i) {
+      trackBuffer.setSample(0, i, (float)(i % 100) * 0.01f - 0.5f);
+    }
+    bus.clear();
+    const auto mixParameters =
+        BenchmarkRunner::makeParameters({{"tracks", mixTracks}, {"blockSize", blockSize}});
+
+    runner.measure("trackMixSeparate", mixParameters, mixTracks, "track", [&]() {
+      for (int track = 0; track < mixTracks; ++track) {
+        rendered.copyFrom(0, 0, trackBuffer, 0, 0, blockSize);
+        rendered.applyGainRamp(0, 0, blockSize, 0.5f, 0.6f);
+        bus.addFrom(0, 0, rendered, 0, 0, blockSize, 0.9f);
+        bus.addFrom(1, 0, rendered, 0, 0, blockSize, 1.1f);
+      }
+      BenchmarkRunner::doNotOptimize(bus.getSample(0, 0));
+    });
+
+    StripGains gains;
+    gains.fader = {0.5f, 0.1f / blockSize, 0.6f, blockSize};
+    gains.left = GainRamp::constant(0.9f);
+    gains.right = GainRamp::constant(1.1f);
+    runner.measure("trackMixFused", mixParameters, mixTracks, "track", [&]() {
+      for (int track = 0; track < mixTracks; ++track) {
+        rendered.copyFrom(0, 0, trackBuffer, 0, 0, blockSize);
+        ChannelStrip::MixJob job;
+        job.input[0] = rendered.getReadPointer(0);
+        job.left = bus.getWritePointer(0);
+        job.right = bus.getWritePointer(1);
+        job.numSamples = blockSize;
+        job.gains = gains;
+        ChannelStrip::mix(job);
+      }
+      BenchmarkRunner::doNotOptimize(bus.getSample(0, 0));
+    });
+  }
+
+ private:
+  // Beat track without activity reporting: mixed and metered every block
+  class AlwaysActiveTrack : public BeatTrack {
+   public:
+    using BeatTrack::BeatTrack;
+
+    RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                               int numSamples, const BeatContext& context) override {
+      BeatTrack::renderBlock(buffer, startSample, numSamples, context);
+      return RenderActivity::whole(numSamples);
+    }
+  };
+};
+
+static MixEngineBenchmark mixEngineBenchmark;
@@ -0,0 +1,79 @@
+#include "../include/pattern-track.hpp"
+#include "../include/tempo-map.hpp"
+#include "benchmark.hpp"
+
+/**
+ * PatternTimeline::compile cost per step across pattern lengths, and
+ * PatternTrack::renderBlock cost per sample across note densities, which
+ * set how often blocks are split at note events.
+ */
+class PatternTrackBenchmark : public Benchmark {
+ public:
+  PatternTrackBenchmark() : Benchmark("PatternTrack") {}
+
+  void run(BenchmarkRunner& runner) override {
+    const TempoMap tempoMap(120.0, 48000.0);
+
+    for (int numSteps : {16, 64, Pattern::kMaxSteps}) {
+      measureCompile(runner, tempoMap, numSteps);
+    }
+    // Sixteenth notes to 128th notes (750 to 94 samples apart)
+    for (int stepsPerBeat : {4, 16, 32}) {
+      measureRender(runner, tempoMap, stepsPerBeat);
+    }
+  }
+
+ private:
+  static Pattern makePattern(int stepsPerBeat, int numSteps) {
+    Pattern pattern;
+    for (int step = 0; step < numSteps; ++step) {
+      PatternStep patternStep;
+      patternStep.note = 36 + step * 5 % 48;
+      patternStep.length = 0.5 + step % 3;
+      pattern.steps.push_back(patternStep);
+    }
+    pattern.stepBeats = 1.0 / stepsPerBeat;
+    pattern.swing = 0.2;
+    return pattern;
+  }
+
+  static void measureCompile(BenchmarkRunner& runner, const TempoMap& tempoMap,
+                             int numSteps) {
+    const Pattern pattern = makePattern(4, numSteps);
+    runner.measure("compile", BenchmarkRunner::makeParameters({{"steps", numSteps}}),
+                   numSteps, "step", [&]() {
+                     const auto timeline = PatternTimeline::compile(pattern, tempoMap);
+                     BenchmarkRunner::doNotOptimize(timeline->notes.back().beat);
+                   });
+  }
+
+  static void measureRender(BenchmarkRunner& runner, const TempoMap& tempoMap,
+                            int stepsPerBeat) {
+    constexpr int bufferSize = 64;
+    constexpr int samplesPerRun = 4800;
+    PatternTrack track;
+    ADSRParameters adsr;
+    adsr.releaseTime = 0.01f;
+    track.setADSRParameters(adsr);
+    track.setPattern(makePattern(stepsPerBeat, 16), tempoMap);
+
+    juce::AudioBuffer<float> buffer(1, bufferSize);
+    const int numBlocks = samplesPerRun / bufferSize;
+
+    // Every run restarts from the beginning of the pattern (a seek)
+    runner.measure(
+        "renderBlock",
+        BenchmarkRunner::makeParameters(
+            {{"stepsPerBeat", stepsPerBeat}, {"bufferSize", bufferSize}}),
+        (juce::int64)numBlocks * bufferSize, "sample", [&]() {
+          juce::int64 position = 0;
+          for (int block = 0; block < numBlocks; ++block) {
+            track.renderBlock(buffer, 0, bufferSize, tempoMap.getContext(position));
+            position += bufferSize;
+          }
+          BenchmarkRunner::doNotOptimize(buffer.getSample(0, 0));
+        });
+  }
+};
+
+static PatternTrackBenchmark patternTrackBenchmark;
@@ -0,0 +1,102 @@
+#include <crow.h>
+#include <string>
+#include <vector>
+#include "../include/control-protocol.hpp"
+#include "benchmark.hpp"
+
+/**
+ * Control message throughput of the WebSocket formats: decoding a volume
+ * change and encoding the reply, as the server does for each message (the
+ * engine command queue itself is not included). itemsPerSecond is the
+ * number of messages per second.
+ *
+ * Binary frames are measured from one command per frame (a single UI
+ * change, the common case) up to 16 (a batched fader drag), to show the
+ * batch size from which they beat JSON.
+ */
+class ControlProtocolBenchmark : public Benchmark {
+ public:
+  ControlProtocolBenchmark() : Benchmark("ControlProtocol") {}
+
+  void run(BenchmarkRunner& runner) override {
+    constexpr int messagesPerRun = 4096;
+
+    // Fader drag: volume changes of one track, timed on the beat grid
+    std::vector<std::string> textMessages;
+    for (int i = 0; i < messagesPerRun; ++i) {
+      textMessages.push_back(
+          "{\"type\":\"setVolume\",\"index\":3,\"value\":" +
+          std::to_string(0.5 + i * 1.0e-4) +
+          ",\"beat\":" + std::to_string(16.0 + i / 64.0) + "}");
+    }
+
+    size_t textBytes = 0;
+    for (const auto& message : textMessages) {
+      textBytes += message.size();
+    }
+
+    runner.measure("json", BenchmarkRunner::makeParameters({{"batch", 1}}),
+                   messagesPerRun, "message", [&]() {
+                     double checksum = 0.0;
+                     for (const auto& text : textMessages) {
+                       const auto message = crow::json::load(text);
+                       const std::string type = message["type"].s();
+                       checksum += (double)message["index"].i() +
+                                   message["value"].d() + message["beat"].d() +
+                                   (double)type.size();
+
+                       crow::json::wvalue reply;
+                       reply["type"] = "commandQueued";
+                       reply["id"] = 1;
+                       reply["trackCount"] = 8;
+                       reply["appliedCommand"] = 0;
+                       checksum += (double)reply.dump().size();
+                     }
+                     BenchmarkRunner::doNotOptimize((float)checksum);
+                   });
+    runner.addMetric("bytesPerMessage", (double)textBytes / messagesPerRun);
+
+    for (const int batch : {1, 2, 4, 16}) {
+      using namespace ControlProtocol;
+
+      std::vector<std::string> frames;
+      for (int i = 0; i < messagesPerRun; i += batch) {
+        std::string frame;
+        beginFrame(frame, MessageType::Commands, (juce::uint32)i);
+        for (int j = i; j < i + batch; ++j) {
+          appendCommand(frame, Op::SetTrackVolume, Timing::Beat, 3,
+                        0.5 + j * 1.0e-4, 16.0 + j / 64.0);
+        }
+        frames.push_back(std::move(frame));
+      }
+
+      std::string reply;
+      runner.measure("binary", BenchmarkRunner::makeParameters({{"batch", batch}}),
+                     messagesPerRun, "message", [&]() {
+                       double checksum = 0.0;
+                       for (const auto& data : frames) {
+                         const FrameView frame(data.data(), data.size());
+                         for (int i = 0; i < frame.getCount(); ++i) {
+                           const auto command = frame.getCommand(i);
+                           checksum += (double)command.getTrack() +
+                                       command.getValue() + command.getWhen() +
+                                       (double)command.getOp();
+                         }
+
+                         Status status;
+                         status.firstCommandId = 1;
+                         status.accepted = (juce::uint16)frame.getCount();
+                         status.trackCount = 8;
+                         writeStatusFrame(reply, frame.getSequence(), status);
+                         checksum += (double)reply.size();
+                       }
+                       BenchmarkRunner::doNotOptimize((float)checksum);
+                     });
+      runner.addMetric("bytesPerMessage",
+                       (double)(HeaderLayout::size + batch * CommandLayout::size) /
+                           batch);
+    }
+  }
+};
+
+static ControlProtocolBenchmark controlProtocolBenchmark;
@@ -0,0 +1,101 @@
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <memory>
+#include <vector>
+#include "../include/sample-cache.hpp"
+#include "../include/sample-sidecar.hpp"
+#include "benchmark.hpp"
+
+/**
+ * Session load time of cached samples: every file decoded and resampled to
+ * the output rate, against every file mapped from its sidecar. The decoder
+ * is a generated ramp, far cheaper than FLAC or MP3, so the decode case is
+ * a lower bound. itemsPerSecond is the number of files loaded per second.
+ */
+class SampleCacheBenchmark : public Benchmark {
+ public:
+  SampleCacheBenchmark() : Benchmark("SampleCache") {}
+
+  void run(BenchmarkRunner& runner) override {
+    constexpr int numFiles = 32;
+    constexpr double seconds = 5.0;
+    constexpr double sourceRate = 44100.0;
+    constexpr double outputRate = 48000.0;
+
+    const auto directory = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                               .getChildFile("daw-sample-cache-benchmark");
+    directory.deleteRecursively();
+    const auto sidecarDirectory = directory.getChildFile("sidecars");
+    sidecarDirectory.createDirectory();
+
+    std::vector<juce::File> sources;
+    for (int i = 0; i < numFiles; ++i) {
+      sources.push_back(directory.getChildFile("sample" + juce::String(i) + ".flac"));
+      sources.back().replaceWithText("compressed audio " + juce::String(i));
+    }
+    const SampleStream::ReaderFactory factory = [&]() {
+      return std::make_unique<RampReader>(sourceRate, (juce::int64)(seconds * sourceRate));
+    };
+
+    const auto parameters = BenchmarkRunner::makeParameters(
+        {{"files", numFiles}, {"seconds", seconds}, {"channels", 2}});
+
+    runner.measure("decode", parameters, numFiles, "file", [&]() {
+      SampleCache cache;
+      for (const auto& source : sources) {
+        BenchmarkRunner::doNotOptimize(
+            cache.load(source, outputRate, factory)->getReadPointer(0)[100]);
+      }
+    });
+
+    // Written once, then mapped by each run (a restart of the session)
+    {
+      SampleCache cache;
+      cache.setSidecarDirectory(sidecarDirectory);
+      for (const auto& source : sources) {
+        cache.load(source, outputRate, factory);
+      }
+    }
+
+    runner.measure("sidecar", parameters, numFiles, "file", [&]() {
+      SampleCache cache;
+      cache.setSidecarDirectory(sidecarDirectory);
+      for (const auto& source : sources) {
+        BenchmarkRunner::doNotOptimize(
+            cache.load(source, outputRate, factory)->getReadPointer(0)[100]);
+      }
+    });
+
+    directory.deleteRecursively();
+  }
+
+ private:
+  // Stereo ramp standing in for a decoder
+  class RampReader : public juce::AudioFormatReader {
+   public:
+    RampReader(double rate, juce::int64 length) : juce::AudioFormatReader(nullptr, "Ramp") {
+      sampleRate = rate;
+      numChannels = 2;
+      lengthInSamples = length;
+      bitsPerSample = 32;
+      usesFloatingPointData = true;
+    }
+
+    bool readSamples(int* const* destChannels, int numDestChannels,
+                     int startOffsetInDestBuffer, juce::int64 startSampleInFile,
+                     int numSamples) override {
+      for (int channel = 0; channel < numDestChannels; ++channel) {
+        if (destChannels[channel] == nullptr) {
+          continue;
+        }
+        auto* output =
+            reinterpret_cast<float*>(destChannels[channel]) + startOffsetInDestBuffer;
+        for (int i = 0; i < numSamples; ++i) {
+          output[i] = (float)((startSampleInFile + i) % 40000) * 2.5e-5f;
+        }
+      }
+      return true;
+    }
+  };
+};
+
+static SampleCacheBenchmark sampleCacheBenchmark;
@@ -0,0 +1,130 @@
+#include <vector>
+#include "../include/wave-table-bank.hpp"
+#include "../include/wave-table-simd.hpp"
+#include "../include/wave-table.hpp"
+#include "benchmark.hpp"
+
+/**
+ * Throughput of the per-sample WaveTable lookups and of the block kernels
+ * of every instruction set available on this machine
+ */
+class WaveTableBenchmark : public Benchmark {
+ public:
+  WaveTableBenchmark() : Benchmark("WaveTable") {}
+
+  void run(BenchmarkRunner& runner) override {
+    const WaveTable waveTable(WaveTable::WaveType::SINE, 2048);
+    const float twoPi = 2.0f * juce::MathConstants<float>::pi;
+    const float increment = twoPi * 440.0f / 44100.0f;
+    constexpr int numCalls = 1 << 16;
+
+    runner.measure("getSample", {}, numCalls, "call", [&]() {
+      float phase = 0.0f;
+      float sum = 0.0f;
+      for (int i = 0; i < numCalls; ++i) {
+        sum += waveTable.getSample(phase);
+        phase += increment;
+        if (phase >= twoPi) {
+          phase -= twoPi;
+        }
+      }
+      BenchmarkRunner::doNotOptimize(sum);
+    });
+
+    runner.measure("getSampleFast", {}, numCalls, "call", [&]() {
+      float phase = 0.0f;
+      float sum = 0.0f;
+      for (int i = 0; i < numCalls; ++i) {
+        sum += waveTable.getSampleFast(phase);
+        phase += increment;
+        if (phase >= twoPi) {
+          phase -= twoPi;
+        }
+      }
+      BenchmarkRunner::doNotOptimize(sum);
+    });
+
+    runBlockKernels(runner);
+    runBank(runner);
+  }
+
+ private:
+  // Band-limited saw per octave: exact levels and crossfaded increments
+  static void runBank(BenchmarkRunner& runner) {
+    const auto& bank = WaveTableBank::get(WaveTable::WaveType::SAW);
+    constexpr int blockSize = 512;
+    std::vector<float> output(blockSize);
+
+    for (float frequency : {110.0f, 880.0f, 1244.5f, 7040.0f}) {
+      const float increment =
+          2.0f * juce::MathConstants<float>::pi * frequency / 44100.0f;
+      float phase = 0.0f;
+
+      runner.measure(
+          "bankRenderBlock",
+          BenchmarkRunner::makeParameters(
+              {{"frequency", frequency},
+               {"level", bank.getLevelForIncrement(increment)},
+               {"blockSize", blockSize}}),
+          blockSize, "sample", [&]() {
+            phase = bank.renderBlock(output.data(), blockSize, phase, increment);
+            BenchmarkRunner::doNotOptimize(output[0]);
+          });
+    }
+  }
+
+  static void runBlockKernels(BenchmarkRunner& runner) {
+    constexpr int tableSize = 2048;
+    constexpr int blockSize = 512;
+    const float twoPi = 2.0f * juce::MathConstants<float>::pi;
+
+    std::vector<float> table(tableSize + 1);
+    for (int i = 0; i <= tableSize; ++i) {
+      table[(size_t)i] = std::sin(twoPi * (float)(i % tableSize) / tableSize);
+    }
+
+    std::vector<float> modulation(blockSize);
+    for (int i = 0; i < blockSize; ++i) {
+      modulation[(size_t)i] = 2.0f * std::sin(twoPi * (float)i / 64.0f);
+    }
+
+    std::vector<float> output(blockSize);
+    const float increment = tableSize * 440.0f / 44100.0f;
+
+    for (auto level : {WaveTableSimd::Level::Scalar, WaveTableSimd::Level::SSE2,
+                       WaveTableSimd::Level::AVX2, WaveTableSimd::Level::AVX512}) {
+      const auto* kernels = WaveTableSimd::getKernels(level);
+      if (kernels == nullptr) {
+        continue;
+      }
+
+      for (bool linear : {true, false}) {
+        for (bool modulated : {false, true}) {
+          const auto kernel = linear ? kernels->linear : kernels->nearest;
+          WaveTableSimd::BlockJob job{table.data(),
+                                      tableSize,
+                                      output.data(),
+                                      modulated ? modulation.data() : nullptr,
+                                      tableSize / twoPi,
+                                      blockSize,
+                                      0.0f,
+                                      increment};
+
+          runner.measure(
+              "renderBlock",
+              BenchmarkRunner::makeParameters(
+                  {{"isa", WaveTableSimd::getLevelName(level)},
+                   {"interpolation", linear ? "linear" : "nearest"},
+                   {"phaseModulation", modulated},
+                   {"blockSize", blockSize}}),
+              blockSize, "sample", [&]() {
+                job.position = kernel(job);
+                BenchmarkRunner::doNotOptimize(output[0]);
+              });
+        }
+      }
+    }
+  }
+};
+
+static WaveTableBenchmark waveTableBenchmark;
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+/**
+ * @file benchmark.hpp
+ * @brief Minimal benchmark harness emitting machine-readable JSON
+ */
+
+class BenchmarkRunner;
+
+/**
+ * @class Benchmark
+ * @brief Base class for a group of benchmark cases
+ *
+ * Like juce::UnitTest, derived classes register themselves when a static
+ * instance is constructed, and the runner executes every registered group.
+ */
+class Benchmark {
+ public:
+  /**
+   * @brief Register a benchmark group
+   * @param name Group name, used as prefix of every case name
+   */
+  explicit Benchmark(const juce::String& name);
+
+  virtual ~Benchmark();
+
+  /**
+   * @brief Run all cases of the group
+   * @param runner Runner timing the cases and collecting results
+   */
+  virtual void run(BenchmarkRunner& runner) = 0;
+
+  /** @brief Group name */
+  const juce::String& getName() const noexcept { return name; }
+
+  /** @brief All registered groups, in registration order */
+  static std::vector<Benchmark*>& getAllBenchmarks();
+
+ private:
+  juce::String name;
+};
+
+/**
+ * @class BenchmarkRunner
+ * @brief Times benchmark cases and collects the results as JSON
+ *
+ * Each case is run once to warm up, then repeated until both a minimum
+ * number of repetitions and a minimum total time are reached. The median
+ * time per item is reported, together with the minimum and mean.
+ */
+class BenchmarkRunner {
+ public:
+  /**
+   * @struct Options
+   * @brief Runner configuration
+   */
+  struct Options {
+    /** @brief Minimum accumulated time per case in seconds */
+    double minSecondsPerCase = 0.25;
+
+    /** @brief Minimum number of timed repetitions per case */
+    int minRepetitions = 5;
+
+    /** @brief Only run cases whose full name contains this text */
+    juce::String filter;
+  };
+
+  explicit BenchmarkRunner(const Options& options);
+
+  /**
+   * @brief Run all registered benchmark groups
+   */
+  void runAll();
+
+  /**
+   * @brief Time one case and record its result
+   * @param caseName Case name (prefixed with the group name)
+   * @param parameters Object describing the case (buffer size, tracks...)
+   * @param itemsPerRun Number of items processed by one call of body
+   * @param itemUnit What an item is ("sample", "block", "call"...)
+   * @param body Code under test
+   */
+  void measure(const juce::String& caseName,
+               const juce::var& parameters,
+               juce::int64 itemsPerRun,
+               const juce::String& itemUnit,
+               const std::function<void()>& body);
+
+  /**
+   * @brief Attach an extra metric to the last measured case
+   * @param key Metric name
+   * @param value Metric value
+   */
+  void addMetric(const juce::String& key, double value);
+
+  /** @brief Median nanoseconds per item of the last measured case */
+  double getLastNanosecondsPerItem() const noexcept { return lastNsPerItem; }
+
+  /** @brief Build the JSON report of every measured case */
+  juce::var getReport() const;
+
+  /**
+   * @brief Build a parameters object from name/value pairs
+   */
+  static juce::var makeParameters(
+      std::initializer_list<std::pair<const char*, juce::var>> values);
+
+  /**
+   * @brief Prevent the compiler from discarding a computed value
+   */
+  static void doNotOptimize(float value) noexcept;
+
+ private:
+  Options options;
+  Benchmark* currentGroup = nullptr;
+  juce::Array<juce::var> results;
+  double lastNsPerItem = 0.0;
+};
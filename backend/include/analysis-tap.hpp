@@ -0,0 +1,229 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_core/juce_core.h>
+#include <juce_dsp/juce_dsp.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class AudioTrack;
+
+/**
+ * @file analysis-tap.hpp
+ * @brief Spectrum and oscilloscope analysis of the engine output
+ */
+
+/**
+ * @class AnalysisTap
+ * @brief Lock-free sample FIFOs from the audio thread to an analysis thread
+ *
+ * Source 0 is the master output (mono sum of its channels); sources 1 to
+ * kMaxTrackTaps are tracks selected by a control thread. The audio thread
+ * only copies the samples of active sources into preallocated FIFOs;
+ * windowing, FFTs and decimation all happen on the analysis thread, which
+ * drains the FIFOs with read().
+ *
+ * When the reader falls behind, new samples are dropped (and counted)
+ * rather than overwriting unread ones.
+ *
+ * @note One writer per source at a time (the audio thread, or the render
+ * worker of a tapped track) and a single reader for all sources
+ */
+class AnalysisTap {
+ public:
+  /** @brief Tracks which can be tapped at the same time */
+  static constexpr int kMaxTrackTaps = 4;
+
+  /** @brief Master plus track sources */
+  static constexpr int kNumSources = kMaxTrackTaps + 1;
+
+  /** @brief Source index of the master output */
+  static constexpr int kMasterSource = 0;
+
+  /**
+   * @brief Allocate the FIFOs
+   * @param fifoSamples Capacity of each FIFO (1.3 s at 48 kHz by default,
+   * so the reader can be late by many frames)
+   */
+  explicit AnalysisTap(int fifoSamples = 1 << 16);
+
+  /** @brief Sample rate of the tapped audio */
+  void prepare(double newSampleRate) noexcept { sampleRate.store(newSampleRate); }
+  double getSampleRate() const noexcept { return sampleRate.load(); }
+
+  //==============================================================================
+  // Control thread
+
+  /** @brief Start or stop copying the master output */
+  void setMasterActive(bool active) noexcept;
+
+  /**
+   * @brief Tap a track into a source, or stop with nullptr
+   * @param source 1 to kMaxTrackTaps
+   * @param track Only compared by address, never accessed
+   */
+  void setTrackSource(int source, const AudioTrack* track) noexcept;
+
+  /** @brief Track tapped by a source, or nullptr */
+  const AudioTrack* getTrackSource(int source) const noexcept {
+    return sources[(size_t)source]->track.load(std::memory_order_acquire);
+  }
+
+  //==============================================================================
+  // Audio thread
+
+  /** @brief Copy the mono sum of an output block if the master is active */
+  void pushMaster(const juce::AudioBuffer<float>& buffer, int startSample,
+                  int numSamples) noexcept;
+
+  /** @brief True if any track is tapped (sample once per block) */
+  bool hasTrackTaps() const noexcept {
+    return numTrackTaps.load(std::memory_order_acquire) > 0;
+  }
+
+  /** @brief Copy a rendered track span if the track is tapped */
+  void pushTrack(const AudioTrack& track, const float* samples,
+                 int numSamples) noexcept;
+
+  //==============================================================================
+  // Analysis thread
+
+  /**
+   * @brief Move up to maxSamples of a source into destination
+   * @return Number of samples read
+   */
+  int read(int source, float* destination, int maxSamples) noexcept;
+
+  /** @brief Throw away the unread samples of a source */
+  void discard(int source) noexcept;
+
+  /** @brief Samples a source could not store since it was created */
+  juce::uint64 getDroppedSamples(int source) const noexcept {
+    return sources[(size_t)source]->dropped.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Source {
+    explicit Source(int capacity) : fifo(capacity), samples((size_t)capacity) {}
+
+    juce::AbstractFifo fifo;
+    std::vector<float> samples;
+    std::atomic<bool> active{false};
+    std::atomic<const AudioTrack*> track{nullptr};
+    std::atomic<juce::uint64> dropped{0};
+  };
+
+  /** @brief Write (a + b) * gain into a FIFO (a * gain when b is null) */
+  static void write(Source& source, const float* a, const float* b, float gain,
+                    int numSamples) noexcept;
+
+  std::array<std::unique_ptr<Source>, kNumSources> sources;
+  std::atomic<int> numTrackTaps{0};
+  std::atomic<double> sampleRate{44100.0};
+
+  JUCE_DECLARE_NON_COPYABLE(AnalysisTap)
+};
+
+/**
+ * @class AnalysisHistory
+ * @brief The most recent samples of one tapped source (analysis thread)
+ *
+ * Samples are numbered from 0 since the last reset(), so consumers
+ * (spectrum frames, scope frames at their own rates) can each remember how
+ * far they have read.
+ */
+class AnalysisHistory {
+ public:
+  /** @brief Samples kept: twice the largest FFT */
+  static constexpr int kCapacity = 1 << 15;
+
+  AnalysisHistory() : samples((size_t)kCapacity, 0.0f) {}
+
+  /** @brief Move all the samples waiting in a tap source to the history */
+  void drain(AnalysisTap& tap, int source) noexcept;
+
+  /** @brief Append samples (drain() without a tap) */
+  void append(const float* data, int numSamples) noexcept;
+
+  /** @brief Forget all samples */
+  void reset() noexcept;
+
+  /** @brief Number of samples appended since the last reset() */
+  juce::uint64 getEnd() const noexcept { return end; }
+
+  /** @brief Oldest sample still available */
+  juce::uint64 getStart() const noexcept {
+    return end > (juce::uint64)kCapacity ? end - (juce::uint64)kCapacity : 0;
+  }
+
+  /**
+   * @brief Copy the numSamples samples ending at getEnd()
+   *
+   * Positions before the first sample read as silence.
+   */
+  void copyLatest(float* destination, int numSamples) const noexcept;
+
+  /**
+   * @brief Copy the samples from position first (at least getStart()) to
+   * getEnd()
+   * @return Number of samples copied
+   */
+  int copyFrom(juce::uint64 first, float* destination) const noexcept;
+
+ private:
+  std::vector<float> samples;
+  juce::uint64 end = 0;
+};
+
+/**
+ * @class SpectrumAnalyzer
+ * @brief Hann-windowed magnitude spectrum in dBFS
+ *
+ * Scaled so a full-scale sine centred on a bin reads 0 dB; magnitudes
+ * below kFloorDb are clamped.
+ */
+class SpectrumAnalyzer {
+ public:
+  /** @brief FFT size range, as powers of two */
+  static constexpr int kMinOrder = 8;
+  static constexpr int kMaxOrder = 14;
+
+  /** @brief Lowest reported level */
+  static constexpr float kFloorDb = -140.0f;
+
+  /** @param order log2 of the FFT size (kMinOrder to kMaxOrder) */
+  explicit SpectrumAnalyzer(int order);
+
+  /** @brief Power-of-two order of the closest allowed FFT size */
+  static int getOrderForSize(int fftSize) noexcept;
+
+  int getSize() const noexcept { return fft.getSize(); }
+
+  /** @brief Bins from DC to Nyquist */
+  int getNumBins() const noexcept { return getSize() / 2 + 1; }
+
+  /**
+   * @brief Spectrum of getSize() samples
+   * @param samples Input (not modified)
+   * @param magnitudesDb Receives getNumBins() levels
+   */
+  void process(const float* samples, float* magnitudesDb) noexcept;
+
+ private:
+  juce::dsp::FFT fft;
+  std::vector<float> window;
+  std::vector<float> workspace;
+  float scale = 1.0f;
+};
+
+/**
+ * @brief Reduce samples to min/max pairs, one per oscilloscope column
+ * @param samples Input samples
+ * @param numSamples At least numPoints
+ * @param minimums Receives numPoints lowest values
+ * @param maximums Receives numPoints highest values
+ * @param numPoints Number of columns
+ */
+void decimateScope(const float* samples, int numSamples, float* minimums,
+                   float* maximums, int numPoints) noexcept;
@@ -0,0 +1,233 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <memory>
+#include <vector>
+
+/**
+ * @file audio-effect.hpp
+ * @brief Insert effects processed on mix buses
+ */
+
+/**
+ * @class AudioEffect
+ * @brief Stereo processor in the insert chain of a bus
+ *
+ * prepare() runs on a control thread (or before playback starts) and
+ * allocates whatever process() needs; process() then runs on the audio
+ * thread or a render worker, in place, without allocating or locking.
+ *
+ * An effect may keep sounding after its input stops (delay repeats, filter
+ * ringing). getTailSamples() bounds that time: the mixer keeps processing a
+ * bus for the tail of its chain after its inputs fall silent, then skips it.
+ * An effect which looks ahead reports the delay it adds with
+ * getLatencySamples().
+ *
+ * @note One thread processes an effect at a time
+ */
+class AudioEffect {
+ public:
+  virtual ~AudioEffect() = default;
+
+  /**
+   * @brief Allocate and reset for a sample rate
+   * @param sampleRate Sample rate in Hz
+   * @param maxBlockSize Largest numSamples passed to process()
+   * @note Not concurrently with process()
+   */
+  virtual void prepare(double sampleRate, int maxBlockSize) = 0;
+
+  /**
+   * @brief Process a span in place
+   * @param channels Left and right channel (first sample of the span)
+   * @param numSamples Number of samples, at most the prepared block size
+   */
+  virtual void process(float* const* channels, int numSamples) noexcept = 0;
+
+  /** @brief Clear the internal state (delay lines, filter memory) */
+  virtual void reset() noexcept = 0;
+
+  /**
+   * @brief Samples of output after the input falls silent, until the
+   * output is below -100 dB (0: none)
+   */
+  virtual int getTailSamples() const noexcept { return 0; }
+
+  /**
+   * @brief Samples by which the output lags the input (lookahead, linear
+   * phase filters), valid once prepared
+   *
+   * The MixGraph delays the other paths into a bus by the difference, so
+   * everything reaching it stays aligned.
+   */
+  virtual int getLatencySamples() const noexcept { return 0; }
+
+  /**
+   * @brief Create an independent copy with the same parameters
+   * @note The copy must be prepared before use
+   */
+  virtual std::unique_ptr<AudioEffect> clone() const = 0;
+
+  /** @brief Effect type, e.g. "delay" */
+  virtual juce::String getName() const = 0;
+};
+
+/**
+ * @class DelayEffect
+ * @brief Feedback delay added to the dry signal
+ *
+ * Each channel has its own line, preallocated for kMaxDelaySeconds by
+ * prepare(). Repeats decay by the feedback gain, so the tail is the time
+ * they take to fall by 100 dB.
+ */
+class DelayEffect : public AudioEffect {
+ public:
+  /** @brief Longest delay, and length of the lines */
+  static constexpr double kMaxDelaySeconds = 2.0;
+
+  /** @brief Highest feedback gain (keeps the tail finite) */
+  static constexpr float kMaxFeedback = 0.95f;
+
+  /**
+   * @brief Construct a delay
+   * @param delaySeconds Delay time (clamped to (0, kMaxDelaySeconds])
+   * @param feedback Gain of each repeat (clamped to [0, kMaxFeedback])
+   * @param wet Level of the delayed signal added to the input (0 to 1)
+   */
+  DelayEffect(double delaySeconds, float feedback, float wet);
+
+  void prepare(double sampleRate, int maxBlockSize) override;
+  void process(float* const* channels, int numSamples) noexcept override;
+  void reset() noexcept override;
+  int getTailSamples() const noexcept override;
+  std::unique_ptr<AudioEffect> clone() const override;
+  juce::String getName() const override { return "delay"; }
+
+  double getDelaySeconds() const noexcept { return delaySeconds; }
+  float getFeedback() const noexcept { return feedback; }
+  float getWet() const noexcept { return wet; }
+
+ private:
+  double delaySeconds;
+  float feedback;
+  float wet;
+
+  // Delay lines and write position (prepare())
+  std::vector<float> lines[2];
+  int lineLength = 0;
+  int writePosition = 0;
+  int delaySamples = 1;
+};
+
+/**
+ * @class BiquadFilter
+ * @brief Second-order low-pass or high-pass filter (RBJ cookbook)
+ *
+ * Transposed direct form II, with the state of each channel kept between
+ * spans. The tail is the ringing of the poles: about 11.5 time constants
+ * (Q / (pi * cutoff)) to decay by 100 dB.
+ */
+class BiquadFilter : public AudioEffect {
+ public:
+  /**
+   * @enum Type
+   * @brief Response of the filter
+   */
+  enum class Type { LowPass, HighPass };
+
+  /**
+   * @brief Construct a filter
+   * @param type Low-pass or high-pass
+   * @param cutoff Cutoff frequency in Hz (clamped below Nyquist by prepare())
+   * @param q Quality factor (0.707 for a Butterworth response)
+   */
+  BiquadFilter(Type type, double cutoff, double q);
+
+  void prepare(double sampleRate, int maxBlockSize) override;
+  void process(float* const* channels, int numSamples) noexcept override;
+  void reset() noexcept override;
+  int getTailSamples() const noexcept override;
+  std::unique_ptr<AudioEffect> clone() const override;
+  juce::String getName() const override {
+    return type == Type::LowPass ? "lowpass" : "highpass";
+  }
+
+  Type getType() const noexcept { return type; }
+  double getCutoff() const noexcept { return cutoff; }
+  double getQ() const noexcept { return q; }
+
+ private:
+  Type type;
+  double cutoff;
+  double q;
+  double sampleRate = 44100.0;
+
+  // Normalised coefficients (a0 = 1)
+  float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+
+  // Transposed direct form II state of each channel
+  float state[2][2] = {};
+};
+
+/**
+ * @class LimiterEffect
+ * @brief Lookahead peak limiter keeping both channels under a ceiling
+ *
+ * The gain each sample needs is known a window of lookahead samples before
+ * it is played. A sliding minimum over the window, smoothed by a moving
+ * average of the same length, brings the gain down in time without
+ * overshoot; it then recovers with an exponential release. Both channels
+ * share the gain, and the output is delayed by the lookahead: its latency.
+ */
+class LimiterEffect : public AudioEffect {
+ public:
+  /** @brief Longest lookahead */
+  static constexpr double kMaxLookaheadSeconds = 0.05;
+
+  /**
+   * @brief Construct a limiter
+   * @param ceiling Highest output magnitude (clamped to (0, 1])
+   * @param lookaheadSeconds Attack and latency (clamped to (0, kMaxLookaheadSeconds])
+   * @param releaseSeconds Time constant of the gain recovery
+   */
+  LimiterEffect(float ceiling, double lookaheadSeconds, double releaseSeconds);
+
+  void prepare(double sampleRate, int maxBlockSize) override;
+  void process(float* const* channels, int numSamples) noexcept override;
+  void reset() noexcept override;
+  int getTailSamples() const noexcept override { return lookaheadSamples; }
+  int getLatencySamples() const noexcept override { return lookaheadSamples; }
+  std::unique_ptr<AudioEffect> clone() const override;
+  juce::String getName() const override { return "limiter"; }
+
+  float getCeiling() const noexcept { return ceiling; }
+  double getLookaheadSeconds() const noexcept { return lookaheadSeconds; }
+  double getReleaseSeconds() const noexcept { return releaseSeconds; }
+
+ private:
+  float ceiling;
+  double lookaheadSeconds;
+  double releaseSeconds;
+
+  // Latency, and length of the windows (lookaheadSamples + 1) (prepare())
+  int lookaheadSamples = 1;
+  int windowLength = 2;
+  float releaseCoefficient = 0.0f;
+
+  // Input delayed by the lookahead
+  std::vector<float> lines[2];
+  int linePosition = 0;
+
+  // Sliding minimum of the gains needed: increasing gains and the sample
+  // they were needed at, in a ring of windowLength entries
+  std::vector<float> minimumGains;
+  std::vector<juce::int64> minimumTimes;
+  int minimumFirst = 0;
+  int minimumCount = 0;
+  juce::int64 time = 0;
+
+  // Released gain, and its moving average over the window
+  float releasedGain = 1.0f;
+  std::vector<float> history;
+  int historyPosition = 0;
+  double historySum = 0.0;
+};
@@ -1,32 +1,36 @@
+#pragma once
+
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <juce_audio_devices/juce_audio_devices.h>
 #include <juce_audio_formats/juce_audio_formats.h>
 #include <juce_audio_utils/juce_audio_utils.h>
 #include <juce_core/juce_core.h>
 #include <juce_events/juce_events.h>
+#include <atomic>
 #include <memory>
+#include <string>
 #include <vector>
+#include "analysis-tap.hpp"
 #include "audio-track.hpp"
 #include "beat-track.hpp"
-
-// TODO: [HIGH] Add dynamic track management API:
-// - void addTrack(std::unique_ptr<AudioTrack> track);
-// - void removeTrack(size_t index);
-// - AudioTrack* getTrack(size_t index);
-// - size_t getTrackCount() const;
-
-// TODO: [MEDIUM] Add mixer functionality:
-// - struct MixerBus { float volume, pan; std::vector<Effect*> effects; };
-// - void setMasterVolume(float volume);
-// - void setTrackPan(size_t trackIndex, float pan);
+#include "disk-streamer.hpp"
+#include "engine-profiler.hpp"
+#include "midi-input.hpp"
+#include "mix-engine.hpp"
+#include "offline-renderer.hpp"
+#include "render-worker-pool.hpp"
 
 // TODO: [MEDIUM] Add error callback system:
 // - std::function<void(const String& error)> errorCallback;
 // - void setErrorCallback(std::function<void(const String&)> callback);
 
-class AudioEngineCore : public juce::AudioAppComponent {
+class AudioEngineCore : public juce::AudioAppComponent,
+                        private juce::MidiInputCallback {
  public:
-  AudioEngineCore();
+  // numRenderThreads: worker threads rendering tracks in parallel with the
+  // device thread (0 = always render serially)
+  explicit AudioEngineCore(
+      int numRenderThreads = RenderWorkerPool::getDefaultThreadCount());
   ~AudioEngineCore() override;
 
   // AudioAppComponent overrides
@@ -35,20 +39,121 @@ class AudioEngineCore : public juce::AudioAppComponent {
       const juce::AudioSourceChannelInfo& bufferToFill) override;
   void releaseResources() override;
 
+  // Track management (control thread only, never blocks the audio thread)
+  size_t addTrack(std::unique_ptr<AudioTrack> track);
+  bool removeTrack(size_t index);
+  std::shared_ptr<AudioTrack> getTrack(size_t index) const;
+  size_t getTrackCount() const;
+
+  // Submix buses, sends and insert effects (control thread only, never
+  // blocks the audio thread). Bus and send parameters change through
+  // commands; see MixGraph for the routing rules.
+  int addBus(std::shared_ptr<MixBus> bus, int output = MixGraph::kMaster);
+  bool removeBus(int index);
+  std::shared_ptr<MixBus> getBus(int index) const;
+  int getBusCount() const;
+  bool setTrackOutput(size_t track, int output);
+  bool setBusOutput(int bus, int output);
+  int addSend(MixGraph::Source source, int destination,
+              std::shared_ptr<MixSend> send = nullptr);
+  bool removeSend(int index);
+  std::shared_ptr<MixSend> getSend(int index) const;
+  bool setEffects(int bus, std::vector<std::shared_ptr<AudioEffect>> chain);
+  MixGraph getGraph() const;
+
+  // Delay added by the insert effects on the way to the master, in samples
+  int getLatencySamples() const;
+
+  // Pick up latencies the insert effects changed since they were routed:
+  // only the compensation delays are recomputed. True if they changed.
+  bool refreshLatency();
+
+  // Free track lists retired by add/remove once the audio thread released them,
+  // collect the commands it has applied, and trim the SampleCache
+  void collectGarbage();
+
+  // Queue a timestamped command for the audio thread (any control thread).
+  // Returns false if too many commands are waiting to be applied.
+  bool sendCommand(EngineCommand command);
+
+  // Id of the last command the audio thread acknowledged
+  juce::uint32 getLastAppliedCommand() const {
+    return lastAppliedCommand.load();
+  }
+
+  // Newest track and master levels, or nullptr if none was published since
+  // the previous call. A single thread may poll (e.g. the meter push thread).
+  const MeterFrame* readMeters() { return mixer.readMeters(); }
+
+  // Copies of the master output and selected tracks for spectrum and
+  // oscilloscope analysis. Sources are selected by a control thread and
+  // drained by a single analysis thread.
+  AnalysisTap& getAnalysisTap() { return analysisTap; }
+
+  // Callback timing, DSP load and missed deadlines (on unless
+  // setEnabled(false) is called on it), plus per-track render timing when
+  // setDetailed(true) is
+  EngineProfiler& getProfiler() { return profiler; }
+
+  // Notes from every MIDI input device, played by the tracks armed with
+  // EngineCommand::Type::SetTrackMidiInput. Arrival to playback latency and
+  // jitter are part of the profile.
+  MidiInputQueue& getMidiInput() { return midiInput; }
+
+  // Disk thread streaming the files of sample tracks
+  // (DiskStreamer::createStream(), then addTrack() a SampleTrack)
+  DiskStreamer& getDiskStreamer() { return diskStreamer; }
+
+  // Read every profiling histogram and the device xrun count (any thread)
+  void captureProfile(ProfileSnapshot& snapshot) const;
+
+  // The profile and SampleCache statistics in the Prometheus text format,
+  // for the /metrics route
+  std::string getMetrics() const;
+
+  // Tempo and time signatures of the session (control thread, never blocks
+  // the audio thread)
+  void setTempoMap(TempoMap map);
+  std::shared_ptr<const TempoMap> getTempoMap() const;
+
+  // Parallel rendering configuration
+  int getRenderThreadCount() const;
+  void setParallelTrackThreshold(int minTracks);
+
+  // Rate of the audio device (44.1 kHz until it opens)
+  double getSampleRate() const { return mixer.getSampleRate(); }
+
+  // Bounce a snapshot of the current tracks to a file, faster than realtime.
+  // Tracks and routing are cloned from their settings, never from render
+  // state, so this can run while the audio thread plays the originals.
+  // The session tempo map and routing replace those in the settings.
+  OfflineRenderer::Result renderOffline(
+      const OfflineRenderer::Settings& settings) const;
+
  private:
+  // MIDI device thread: timestamp the message and queue it
+  void handleIncomingMidiMessage(juce::MidiInput* source,
+                                 const juce::MidiMessage& message) override;
+
   bool playing;
-  double currentPosition;  // TODO: [MEDIUM] Replace with int64_t totalSampleCount
-  float masterVolume;
 
-  // Pre-allocated buffers for audio processing (avoid allocations in audio thread)
-  juce::AudioBuffer<float> mixBuffer;  // Stereo mix buffer
-  juce::AudioBuffer<float> trackBuffer;  // Mono buffer for individual track rendering
-  std::vector<float> trackPanValues;
+  // Filled at the end of getNextAudioBlock (and by the mixer for tracks)
+  AnalysisTap analysisTap;
+
+  // Timed in getNextAudioBlock (and by the mixer for detailed timing)
+  EngineProfiler profiler;
+
+  // Destroyed after the mixer: streams of its tracks refer to it
+  DiskStreamer diskStreamer;
+
+  // Filled by the MIDI device threads, drained by the mixer
+  MidiInputQueue midiInput;
 
-  // TODO: [HIGH] Add thread-safe track management:
-  // juce::SpinLock trackLock;  // or use lock-free structure
+  // Track rendering and mixing pipeline (shared with offline rendering)
+  MixEngine mixer;
 
-  std::vector<std::unique_ptr<AudioTrack>> tracks;
+  // Updated when acknowledgements are collected
+  std::atomic<juce::uint32> lastAppliedCommand{0};
 
   JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioEngineCore)
 };
\ No newline at end of file
@@ -1,12 +1,59 @@
 #pragma once
 
 #include <juce_audio_basics/juce_audio_basics.h>
+#include <memory>
+#include "channel-strip.hpp"
+#include "engine-profiler.hpp"
+#include "level-meter.hpp"
+#include "tempo-map.hpp"
+
+class MidiEventList;
+struct MidiEvent;
 
 /**
  * @file audio-track.hpp
  * @brief Abstract base class for all audio track types
  */
 
+/**
+ * @struct RenderActivity
+ * @brief Part of a rendered span which may hold signal
+ *
+ * Returned by AudioTrack::renderBlock(): samples [start, end) of the span
+ * (relative to its first sample) may be non-zero, every other sample was
+ * written as an exact zero. The range may be wider than the signal, never
+ * narrower. Tails (an envelope release, the last frames of a resampled
+ * file) are part of it: a track reports silence once its output has
+ * decayed to zeros, not when its last note ends.
+ */
+struct RenderActivity {
+  int start = 0;
+  int end = 0;
+
+  /** @brief Nothing but zeros */
+  static RenderActivity silent() noexcept { return {}; }
+
+  /** @brief Signal anywhere in a span of numSamples */
+  static RenderActivity whole(int numSamples) noexcept { return {0, numSamples}; }
+
+  /** @brief True if every sample of the span is zero */
+  bool isSilent() const noexcept { return end <= start; }
+
+  /** @brief Number of samples in the range */
+  int getLength() const noexcept { return juce::jmax(0, end - start); }
+
+  /** @brief Extend the range to cover samples [first, last) */
+  void include(int first, int last) noexcept {
+    if (isSilent()) {
+      start = first;
+      end = last;
+    } else {
+      start = juce::jmin(start, first);
+      end = juce::jmax(end, last);
+    }
+  }
+};
+
 /**
  * @class AudioTrack
  * @brief Abstract base class representing a single audio track
@@ -15,6 +62,14 @@
  * Derived classes must implement the getSampleValue() method to generate
  * audio samples at a given time.
  *
+ * Tracks render dry, at unity gain: volume, pan and mute are applied by
+ * the MixEngine through the track's ChannelStrip, with smoothing. Each
+ * block reports the range holding signal, so the mixer skips silent tracks
+ * (a drum track between hits) and only mixes the active part of the others.
+ *
+ * Tracks armed with receivesMidi get the notes played on MIDI inputs: the
+ * MixEngine splits their render at each event with renderWithEvents().
+ *
  * @note This is an abstract class and cannot be instantiated directly
  */
 class AudioTrack {
@@ -32,19 +87,26 @@ class AudioTrack {
   virtual ~AudioTrack() = default;
 
   /**
-   * @brief Generate an audio sample at a given time
-   * @param sampleTime The time position in seconds
-   * @return The audio sample value (typically in range [-1.0, 1.0])
+   * @brief Generate an audio sample at a given position
+   * @param context Position and tempo of the sample
+   * @return The dry sample value (typically in range [-1.0, 1.0]), of the
+   * left channel for stereo tracks
    * @note Pure virtual function - must be implemented by derived classes
    */
-  virtual float getSampleValue(double sampleTime) = 0;
+  virtual float getSampleValue(const BeatContext& context) = 0;
 
   /**
    * @brief Render a block of audio samples (batch processing)
-   * @param buffer The audio buffer to fill (mono, single channel)
+   * @param buffer The audio buffer to fill: channels [0,
+   * getNumOutputChannels()) are written, at unity gain. It may have more
+   * channels.
    * @param startSample The starting sample index in the buffer
    * @param numSamples The number of samples to render
-   * @param startTime The time position in seconds for the first sample
+   * @param context Position and tempo of the first sample. The tempo is
+   * constant or ramps linearly and the time signature does not change
+   * within the block (see BeatContext::getBeatAt()).
+   * @return Samples of the block which may be non-zero (the rest were
+   * written as zeros), RenderActivity::whole(numSamples) if unknown
    *
    * This method provides optimized batch processing instead of per-sample
    * rendering. It allows for SIMD optimizations and reduces virtual call
@@ -53,8 +115,73 @@ class AudioTrack {
    * @note Pure virtual function - must be implemented by derived classes
    * @note Buffer should be pre-allocated with sufficient size
    */
-  virtual void renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
-                          int numSamples, double startTime) = 0;
+  virtual RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                                     int numSamples, const BeatContext& context) = 0;
+
+  /**
+   * @brief Number of channels written by renderBlock()
+   * @return 1 (mono, the default) or 2 (left and right). Must not change
+   * during the life of the track.
+   */
+  virtual int getNumOutputChannels() const { return 1; }
+
+  /**
+   * @brief Create an independent copy of the track
+   * @return A new track with the same settings and its own render state
+   *
+   * Used to render a snapshot of the session offline while the original
+   * tracks keep playing on the audio thread. The copy is built from the
+   * track's settings only (see copyMixSettings()): render state (voices,
+   * phases, envelopes, strip, meters) is written by the audio thread and
+   * must not be read here.
+   *
+   * @note Pure virtual function - must be implemented by derived classes
+   */
+  virtual std::unique_ptr<AudioTrack> clone() const = 0;
+
+  /**
+   * @brief Start a note on an instrument track (other tracks ignore it)
+   * @param note MIDI note number (0 to 127)
+   * @param velocity Gain of the note (0 to 1)
+   * @note Called between two renderBlock() calls by the thread rendering
+   * the track (see EngineCommand::Type::NoteOn)
+   */
+  virtual void noteOn(int /*note*/, float /*velocity*/) noexcept {}
+
+  /**
+   * @brief Release a note on an instrument track (other tracks ignore it)
+   * @param note MIDI note number (0 to 127)
+   * @note Called like noteOn()
+   */
+  virtual void noteOff(int /*note*/) noexcept {}
+
+  /**
+   * @brief Render a span, playing MIDI events on their sample
+   * @param buffer, startSample, numSamples, context As for renderBlock()
+   * @param events Events of the block; their offsets index the buffer like
+   * startSample. Those in [startSample, startSample + numSamples) are
+   * played, the others are ignored.
+   * @return Activity of the whole span, as for renderBlock()
+   *
+   * renderBlock() is called once per stretch between two event samples,
+   * with the context of the stretch's first sample, and the events on a
+   * sample are played before rendering it.
+   */
+  RenderActivity renderWithEvents(juce::AudioBuffer<float>& buffer, int startSample,
+                                  int numSamples, const BeatContext& context,
+                                  const MidiEventList& events);
+
+  /** @brief Apply one MIDI event with noteOn() or noteOff() */
+  void playEvent(const MidiEvent& event) noexcept;
+
+  /**
+   * @brief Called with a tempo map before the MixEngine publishes it, and
+   * when the track is added to one (control thread)
+   *
+   * Tracks which precompute sample positions from beats rebuild them here
+   * (see PatternTrack). The default does nothing.
+   */
+  virtual void tempoMapChanged(const TempoMap& /*map*/) {}
 
   /**
    * @brief Set the mute state of the track
@@ -68,6 +195,12 @@ class AudioTrack {
    */
   virtual void setVolume(float volume);
 
+  /**
+   * @brief Set the pan position of the track
+   * @param pan Pan position (clamped to range [-1.0, 1.0])
+   */
+  virtual void setPan(float pan);
+
   /** @brief Track volume level (0.0 to 1.0) */
   float volume;
 
@@ -76,4 +209,31 @@ class AudioTrack {
 
   /** @brief Mute state (true = muted, false = playing) */
   bool mute;
+
+  /** @brief Plays the notes of the MIDI inputs (set by the MixEngine, see
+   * EngineCommand::Type::SetTrackMidiInput) */
+  bool receivesMidi = false;
+
+  /** @brief Smoothed volume, pan and mute, applied by the MixEngine */
+  ChannelStrip strip;
+
+  /** @brief Result of the last renderBlock() called by the MixEngine,
+   * which only mixes and meters that range */
+  RenderActivity activity;
+
+  /** @brief Post-fader levels (left channel of a stereo track), measured
+   * by the MixEngine after rendering */
+  ChannelMeter meter{ChannelMeter::TruePeakMode::AroundPeak};
+
+  /** @brief Post-fader levels of the right channel of a stereo track */
+  ChannelMeter rightMeter{ChannelMeter::TruePeakMode::AroundPeak};
+
+  /** @brief Time spent in renderBlock(), recorded by the MixEngine when
+   * detailed profiling is on */
+  Histogram renderTime{Histogram::Scale::Seconds};
+
+ protected:
+  /** @brief Take the volume, pan, mute and MIDI input of another track,
+   * for clone() */
+  void copyMixSettings(const AudioTrack& other);
 };
\ No newline at end of file
@@ -1,18 +1,7 @@
 #pragma once
 #include "audio-track.hpp"
-#include "wave-table.hpp"
-
-// TODO: [MEDIUM] Add ADSR configuration structure:
-// struct ADSRParameters {
-//   float attackTime = 0.01f;
-//   float decayTime = 0.02f;
-//   float sustainLevel = 0.4f;
-//   float releaseTime = 0.02f;
-//   enum Curve { Linear, Exponential, Logarithmic };
-//   Curve attackCurve = Exponential;
-//   Curve decayCurve = Exponential;
-//   Curve releaseCurve = Exponential;
-// };
+#include "envelope-generator.hpp"
+#include "wave-table-bank.hpp"
 
 // TODO: [LOW] Add waveform type selection (currently hardcoded to SINE)
 // TODO: [LOW] Add velocity sensitivity for dynamic expression
@@ -26,11 +15,29 @@
  * @class BeatTrack
  * @brief Audio track that generates beat-synchronized tones with ADSR envelope
  *
- * This class generates periodic audio tones synchronized to the global tempo.
+ * This class generates periodic audio tones synchronized to the session tempo
+ * map, one note per beat.
  * Each beat uses a wavetable oscillator and applies an ADSR envelope for
  * dynamic sound shaping.
  *
- * @note Uses a shared static WaveTable for efficiency
+ * renderBlock() is incremental: it keeps an integer sample position and a
+ * running oscillator phase between calls. Silent spans between beats are
+ * cleared in one go, and beats starting mid-block are handled without
+ * splitting the block. Beat k starts at the first sample reaching beat
+ * position k, looked up in the tempo map once per beat rather than
+ * accumulated, so beats never drift however long the session runs. A block
+ * that does not follow the previous one (seek, or another tempo map)
+ * resynchronizes the state.
+ *
+ * Notes are shaped by an EnvelopeGenerator, applied a block at a time.
+ * The release starts `duration` seconds into each beat. The output is mono
+ * and dry: volume and mute are applied by the mixer, and a muted track
+ * keeps its place in the beat. renderBlock() reports the samples covered
+ * by notes (release included), so blocks between notes cost a clear.
+ *
+ * @note Uses the shared band-limited sine bank (WaveTableBank::get())
+ * @note Render state makes renderBlock() single-threaded per track, as
+ * tracks already are
  */
 class BeatTrack : public AudioTrack {
  public:
@@ -46,31 +53,40 @@ class BeatTrack : public AudioTrack {
   ~BeatTrack() override;
 
   /**
-   * @brief Generate an audio sample at a given time
-   * @param sampleTime The time position in seconds
+   * @brief Generate an audio sample at a given position
+   * @param context Position and tempo of the sample
    * @return The audio sample value with ADSR envelope applied
    */
-  float getSampleValue(double sampleTime) override;
+  float getSampleValue(const BeatContext& context) override;
 
   /**
    * @brief Render a block of audio samples (optimized batch processing)
-   * @param buffer The audio buffer to fill (mono, single channel)
+   * @param buffer The audio buffer to fill (channel 0, at unity gain)
    * @param startSample The starting sample index in the buffer
    * @param numSamples The number of samples to render
-   * @param startTime The time position in seconds for the first sample
+   * @param context Position and tempo of the first sample
+   * @return From the first to the last sample of notes in the block
    */
-  void renderBlock(juce::AudioBuffer<float>& buffer,
+  RenderActivity renderBlock(juce::AudioBuffer<float>& buffer,
                    int startSample,
                    int numSamples,
-                   double startTime) override;
+                   const BeatContext& context) override;
+
+  /**
+   * @brief Create a copy of this track (same frequency, envelope and mixer
+   * settings)
+   */
+  std::unique_ptr<AudioTrack> clone() const override;
 
-  // TODO: [MEDIUM] Add ADSR configuration methods:
-  // void setADSRParameters(const ADSRParameters& params);
-  // ADSRParameters getADSRParameters() const;
-  // void setAttackTime(float time);
-  // void setDecayTime(float time);
-  // void setSustainLevel(float level);
-  // void setReleaseTime(float time);
+  /**
+   * @brief Set the envelope of the notes
+   * @note Takes effect from the next beat. Like setVolume(), not
+   * synchronized with the audio thread.
+   */
+  void setADSRParameters(const ADSRParameters& params);
+
+  /** @brief Get the envelope of the notes */
+  ADSRParameters getADSRParameters() const;
 
   // TODO: [LOW] Add waveform selection:
   // void setWaveform(WaveTable::WaveformType type);
@@ -82,15 +98,26 @@ class BeatTrack : public AudioTrack {
 
  private:
   /**
-   * @brief Compute the ADSR envelope value
-   * @param timeSinceLastBeat Time elapsed since the last beat started (in
-   * seconds)
-   * @return Envelope amplitude multiplier (0.0 to 1.0)
+   * @brief Put an envelope in the state it has at a point of a beat
+   * @param env Envelope to set up (parameters and sample rate already set)
+   * @param sampleInBeat Samples since the beat started
+   * @param noteOffAt Sample of the beat where the release starts
+   */
+  static void seekEnvelope(EnvelopeGenerator& env, juce::int64 sampleInBeat,
+                           juce::int64 noteOffAt);
+
+  /**
+   * @brief Move the render state to an absolute sample position
+   * @param map Tempo map of the session
+   * @param sample Sample index since the start of the session
    */
-  float computeEnveloppe(float timeSinceLastBeat) const;
+  void resync(const TempoMap& map, juce::int64 sample);
 
-  /** @brief Beat interval in seconds (calculated from tempo) */
-  float interval;
+  /**
+   * @brief Render the sounding part of a beat (oscillator times envelope)
+   * @param output Destination for numSamples samples
+   */
+  void renderNote(float* output, int numSamples);
 
   /** @brief Oscillator frequency in Hz */
   float frequency;
@@ -98,31 +125,45 @@ class BeatTrack : public AudioTrack {
   /** @brief Note duration in seconds (before release phase) */
   float duration;
 
-  /** @brief Attack time in seconds */
-  float att;
+  /** @brief Envelope of every note */
+  ADSRParameters adsr;
+
+  /** @brief Shared band-limited oscillator tables (sine) */
+  const WaveTableBank* oscillator;
+
+  /** @brief Sample rate the render state was computed for */
+  double renderSampleRate = 0.0;
 
-  /** @brief Decay time in seconds */
-  float dec;
+  /** @brief Tempo map the render state was computed for (TempoMap::getId()) */
+  juce::uint32 tempoMapId = 0;
 
-  /** @brief Sustain level (0.0 to 1.0) */
-  float sus;
+  /** @brief Sample expected at the start of the next block (-1: none) */
+  juce::int64 nextSample = -1;
 
-  /** @brief Release time in seconds */
-  float rel;
+  /** @brief Index of the current beat */
+  juce::int64 beatIndex = 0;
 
-  /** @brief Shared wavetable oscillator (sine wave, 2048 samples) */
-  static WaveTable waveTable;
+  /** @brief First sample of the current beat */
+  juce::int64 beatStart = 0;
 
-  // TODO: [MEDIUM] Add configurable ADSR parameters member:
-  // ADSRParameters adsrParams;
+  /** @brief First sample of the next beat */
+  juce::int64 nextBeatStart = 0;
+
+  /** @brief Sample of the beat where the release starts */
+  juce::int64 noteOffSample = 0;
+
+  /** @brief Envelope of the current note */
+  EnvelopeGenerator envelope;
+
+  /** @brief Oscillator phase of the next sample, in radians */
+  float oscillatorPhase = 0.0f;
+
+  /** @brief Oscillator phase advance per sample, in radians */
+  float phaseIncrement = 0.0f;
 
   // TODO: [LOW] Add per-instance waveform (replace static shared wavetable):
   // std::unique_ptr<WaveTable> oscillator;
 
   // TODO: [LOW] Add velocity member for dynamic response:
   // float velocity = 1.0f;
-
-  // TODO: [LOW] Add volume and mute state members:
-  // float volume = 0.4f;
-  // bool muted = false;
 };
\ No newline at end of file
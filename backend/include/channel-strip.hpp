@@ -0,0 +1,196 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include "level-meter.hpp"
+
+/**
+ * @file channel-strip.hpp
+ * @brief Smoothed track gain, pan and mute, and the kernels mixing tracks
+ */
+
+/**
+ * @struct GainRamp
+ * @brief Gain of the samples of a span: a linear ramp, then a constant
+ *
+ * Sample i gets start + step * i while i < length, then end.
+ */
+struct GainRamp {
+  float start = 0.0f;
+  float step = 0.0f;
+  float end = 0.0f;
+
+  /** @brief Samples of the ramp (0: constant at end) */
+  int length = 0;
+
+  /** @brief Constant gain */
+  static GainRamp constant(float gain) noexcept { return {gain, 0.0f, gain, 0}; }
+
+  /** @brief True if every sample gets end */
+  bool isConstant() const noexcept { return length == 0; }
+
+  /** @brief The same gains from sample offset of the span on */
+  GainRamp from(int offset) const noexcept {
+    if (offset <= 0) {
+      return *this;
+    }
+    if (offset >= length) {
+      return constant(end);
+    }
+    return {at(offset), step, end, length - offset};
+  }
+
+  /** @brief Gain of a sample of the span */
+  float at(int index) const noexcept {
+    const float position = (float)index;
+    return position < (float)length ? start + step * position : end;
+  }
+};
+
+/**
+ * @struct StripGains
+ * @brief Gains of a track over one span
+ *
+ * The fader gain (volume, or 0 when muted) makes the post-fader signal,
+ * which is metered; the pan gains place it on the left and right buses.
+ */
+struct StripGains {
+  GainRamp fader;
+  GainRamp left;
+  GainRamp right;
+
+  /** @brief Gains from sample offset of the span on (GainRamp::from()) */
+  StripGains from(int offset) const noexcept {
+    return {fader.from(offset), left.from(offset), right.from(offset)};
+  }
+};
+
+/**
+ * @class ChannelStrip
+ * @brief Mixer state of one track: smoothed volume, pan and mute
+ *
+ * Tracks render dry, at unity gain; the MixEngine applies the track's
+ * volume, pan and mute through its strip. advance() turns the current
+ * parameter values into ramps over the next span. A change does not jump:
+ * every gain moves linearly to its new value over kSmoothingSeconds, so
+ * automation and mute do not click (zipper noise). Ramps run across spans
+ * and blocks, whatever their length, and end exactly on the new value.
+ *
+ * Pan is constant power, normalised to unity at the centre: a centred
+ * track is mixed at its volume on both sides, and hard left is +3 dB on
+ * the left. Stereo tracks use the same gains as a balance control.
+ *
+ * mix() applies the fader and pan gains and accumulates into the mix bus
+ * in a single pass over the track buffer. Its SSE2 path evaluates the
+ * ramps at the same sample index with the same arithmetic as mixScalar()
+ * (the file is built with -ffp-contract=off), so both match bit for bit, as
+ * does applyFader() followed by a mix at unity fader. Both can also reduce
+ * the post-fader signal for the meters (SpanLevels) in the same pass: a
+ * multiply, an add and a max per sample on values already in registers,
+ * instead of a second pass over the buffer, and without storing the
+ * post-fader signal.
+ *
+ * @note Not thread-safe: advanced by the thread rendering the track
+ */
+class ChannelStrip {
+ public:
+  /** @brief Time taken by a parameter change to reach its new value */
+  static constexpr double kSmoothingSeconds = 0.02;
+
+  /**
+   * @struct MixJob
+   * @brief Arguments of a mix: one track span into the stereo bus
+   */
+  struct MixJob {
+    /** @brief Left (or mono) and right channel of the track; input[1] is
+     * nullptr for a mono track */
+    const float* input[2] = {nullptr, nullptr};
+
+    /** @brief Where to store the post-fader signal of each input channel
+     * (may be the input itself), or nullptr */
+    float* postFader[2] = {nullptr, nullptr};
+    /** @brief Receives the levels of the post-fader signal of each input
+     * channel (2 entries), or nullptr */
+    SpanLevels* levels = nullptr;
+
+    /** @brief Mix bus, accumulated into */
+    float* left = nullptr;
+    float* right = nullptr;
+
+    int numSamples = 0;
+    StripGains gains;
+  };
+
+  /**
+   * @brief Constant-power pan gains
+   * @param pan -1 (left) to 1 (right)
+   * @param left Receives the left gain (sqrt(2) at hard left, 1 centred)
+   * @param right Receives the right gain
+   */
+  static void getPanGains(float pan, float& left, float& right) noexcept;
+
+  /**
+   * @brief Gains for the next span of a track
+   * @param volume Track volume
+   * @param pan Track pan
+   * @param mute Mute state (fades the fader gain to 0)
+   * @param numSamples Length of the span
+   * @param smoothingSamples Length of a ramp (kSmoothingSeconds at the
+   * engine rate). The first span after construction or reset() starts
+   * directly at the parameter values.
+   * @return Ramps over the span, also kept for getGains()
+   */
+  const StripGains& advance(float volume, float pan, bool mute, int numSamples,
+                            int smoothingSamples) noexcept;
+
+  /** @brief Gains returned by the last advance() */
+  const StripGains& getGains() const noexcept { return gains; }
+
+  /**
+   * @brief True if the last span was silent: fader at 0 and not moving
+   *
+   * The track output does not reach the bus, so its mix can be skipped.
+   */
+  bool isSilent() const noexcept {
+    return gains.fader.isConstant() && gains.fader.end == 0.0f;
+  }
+
+  /** @brief Jump to the parameter values at the next advance() */
+  void reset() noexcept { initialised = false; }
+
+  /**
+   * @brief Multiply channels in place by a fader ramp
+   * @param channels Channel pointers (first sample of the span)
+   * @param levels Receives the levels of each scaled channel (numChannels
+   * entries), or nullptr
+   */
+  static void applyFader(float* const* channels, int numChannels, int numSamples,
+                         GainRamp fader, SpanLevels* levels = nullptr) noexcept;
+
+  /**
+   * @brief Accumulate a track into the bus: bus += input * fader * pan
+   *
+   * Uses SSE2 where available, else mixScalar().
+   */
+  static void mix(const MixJob& job) noexcept;
+
+  /** @brief Portable mix(), the reference for the vector path */
+  static void mixScalar(const MixJob& job) noexcept;
+
+ private:
+  /** @brief Move a current value towards its target over numSamples */
+  GainRamp ramp(float& current, float target, int numSamples) const noexcept;
+
+  bool initialised = false;
+
+  // Parameters of the current ramp, and the samples left in it
+  float targetFader = 0.0f;
+  float targetLeft = 0.0f;
+  float targetRight = 0.0f;
+  int remainingSamples = 0;
+
+  // Gains reached at the end of the last span
+  float fader = 0.0f;
+  float left = 0.0f;
+  float right = 0.0f;
+
+  StripGains gains;
+};
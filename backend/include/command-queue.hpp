@@ -0,0 +1,160 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <memory>
+#include <mutex>
+#include "audio-track.hpp"
+#include "mix-graph.hpp"
+#include "spsc-queue.hpp"
+
+/**
+ * @file command-queue.hpp
+ * @brief Timestamped commands from control threads to the audio thread
+ */
+
+/**
+ * @struct EngineCommand
+ * @brief A change applied by the audio thread at a given sample
+ *
+ * Commands travel to the audio thread and back: once applied, the audio
+ * thread returns the command as its acknowledgement. The track, bus or send
+ * it holds is therefore never released on the audio thread, even if it was
+ * removed from the session in the meantime.
+ */
+struct EngineCommand {
+  /**
+   * @enum Type
+   * @brief What the command changes
+   */
+  enum class Type {
+    SetTrackVolume,    /**< track->setVolume(value) */
+    SetTrackMute,      /**< track->setMute(value != 0) */
+    SetTrackPan,       /**< track->setPan(value) */
+    SetMasterVolume,   /**< Master gain (value) */
+    Play,              /**< Start the transport */
+    Stop,              /**< Stop the transport (output silence) */
+    Seek,              /**< Move the transport to sample (int64) value */
+    SetBusVolume,      /**< bus->setVolume(value) */
+    SetBusMute,        /**< bus->setMute(value != 0) */
+    SetBusPan,         /**< bus->setPan(value) */
+    SetSendLevel,      /**< send->setLevel(value) */
+    NoteOn,            /**< track->noteOn(note, value) */
+    NoteOff,           /**< track->noteOff(note) */
+    SetTrackMidiInput  /**< track->receivesMidi = (value != 0) */
+  };
+
+  /** @brief Apply as soon as possible */
+  static constexpr juce::int64 kImmediate = -1;
+
+  Type type = Type::Play;
+
+  /**
+   * @brief Transport sample at which the command applies
+   *
+   * Commands due inside a block split it, so they take effect exactly on
+   * that sample. Commands already due (or kImmediate) apply at the start of
+   * the next block. While the transport is stopped its position does not
+   * move, so every command applies at the next block, whatever its sample.
+   */
+  juce::int64 sample = kImmediate;
+
+  /** @brief Caller-chosen identifier, returned with the acknowledgement */
+  juce::uint32 id = 0;
+
+  /** @brief Target of track commands */
+  std::shared_ptr<AudioTrack> track;
+
+  /** @brief Target of bus commands */
+  std::shared_ptr<MixBus> bus;
+
+  /** @brief Target of SetSendLevel */
+  std::shared_ptr<MixSend> send;
+
+  /** @brief Parameter of the command */
+  double value = 0.0;
+
+  /** @brief MIDI note of NoteOn and NoteOff */
+  int note = 0;
+
+  /** @brief Set by the audio thread: transport sample it was applied at */
+  juce::int64 appliedSample = kImmediate;
+};
+
+/**
+ * @class CommandQueue
+ * @brief Pair of SPSC queues: commands in, acknowledgements out
+ *
+ * Control threads push commands, the audio thread pops them and sends each
+ * one back once applied. Both queues have the same preallocated capacity,
+ * and the control side never has more commands in flight than that, so the
+ * audio thread can always return a command without waiting or allocating.
+ *
+ * Control threads (Crow workers, UI, tests) are serialised by a mutex the
+ * audio thread never takes, which keeps each queue single-producer and
+ * single-consumer.
+ */
+class CommandQueue {
+ public:
+  /**
+   * @brief Allocate the slots of both queues
+   * @param capacity Maximum number of commands in flight (rounded up to a
+   * power of two)
+   */
+  explicit CommandQueue(int capacity = 1024);
+
+  /** @brief Maximum number of commands in flight */
+  int getCapacity() const noexcept { return (int)commands.getCapacity(); }
+
+  /**
+   * @brief Queue a command (control threads)
+   * @return False if too many commands are in flight. Call collectReplies()
+   * to return acknowledged ones.
+   */
+  bool push(EngineCommand command);
+
+  /**
+   * @brief Release acknowledged commands (control threads)
+   * @param callback Called with each applied command before it is destroyed
+   * @return Number of acknowledgements collected
+   */
+  template <typename Callback>
+  int collectReplies(Callback&& callback) {
+    const std::lock_guard<std::mutex> lock(controlMutex);
+
+    int count = 0;
+    EngineCommand reply;
+    while (replies.tryPop(reply)) {
+      callback(static_cast<const EngineCommand&>(reply));
+      reply = EngineCommand();  // Releases its targets here, not on the audio thread
+      ++count;
+    }
+    inFlight -= count;
+    return count;
+  }
+
+  /** @brief Release acknowledged commands without looking at them */
+  int collectReplies() {
+    return collectReplies([](const EngineCommand&) {});
+  }
+
+  /**
+   * @brief Take the oldest queued command (audio thread)
+   * @param command Destination, must not hold a track
+   */
+  bool pop(EngineCommand& command) noexcept { return commands.tryPop(command); }
+
+  /**
+   * @brief Return an applied command (audio thread)
+   * @note Never fails: the in-flight limit guarantees a free slot
+   */
+  void sendReply(EngineCommand&& command) noexcept;
+
+ private:
+  SpscQueue<EngineCommand> commands;
+  SpscQueue<EngineCommand> replies;
+
+  /** @brief Serialises control threads */
+  std::mutex controlMutex;
+
+  /** @brief Commands pushed and not collected yet (control side) */
+  int inFlight = 0;
+};
@@ -0,0 +1,443 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * @file control-protocol.hpp
+ * @brief Compact binary format of WebSocket control messages
+ */
+
+/**
+ * @namespace ControlProtocol
+ * @brief Versioned binary frames for high-rate control traffic
+ *
+ * JSON stays the default (and debugging) format of the WebSocket. A client
+ * switches its connection to binary frames by sending
+ * {"type": "hello", "binary": [1]} with the versions it supports; the server
+ * answers with the chosen version and getSchema(), which describes every
+ * layout below so clients can generate their codecs.
+ *
+ * Every frame is a fixed header followed by `count` fixed-size records of
+ * the frame type, all little-endian:
+ *
+ * | Offset | Header field | Type |
+ * |--------|--------------|------|
+ * | 0      | version      | u8   |
+ * | 1      | type         | u8   |
+ * | 2      | count        | u16  |
+ * | 4      | sequence     | u32  |
+ *
+ * Clients send Commands frames (one record per parameter or transport
+ * change, so a fader drag can batch many); the server answers each one with
+ * a Status frame echoing its sequence. Clients subscribed to meters receive
+ * Meters frames and may acknowledge them with an empty MeterAck frame
+ * carrying the same sequence.
+ *
+ * Spectrum and Scope frames (analysis subscriptions) insert an
+ * AnalysisLayout prefix between the header and their records.
+ *
+ * Decoding is zero-copy: FrameView validates the size once, then views read
+ * fields straight from the received bytes. Encoding appends to a reused
+ * std::string, which stops allocating once it has grown to the largest
+ * frame.
+ */
+namespace ControlProtocol {
+
+/** @brief Current (and highest supported) binary version */
+constexpr juce::uint8 kVersion = 1;
+
+/**
+ * @enum MessageType
+ * @brief Frame type, from client (0x0_) or server (0x8_)
+ */
+enum class MessageType : juce::uint8 {
+  Commands = 0x01, /**< CommandLayout records */
+  MeterAck = 0x02, /**< No record, sequence of the Meters frame received */
+  Status = 0x81,   /**< One StatusLayout record */
+  Meters = 0x82,   /**< MeterLayout records: master left, right, then tracks */
+  Spectrum = 0x83, /**< AnalysisLayout, then SpectrumLayout records (DC to Nyquist) */
+  Scope = 0x84     /**< AnalysisLayout, then ScopeLayout records (oldest first) */
+};
+
+/**
+ * @enum Op
+ * @brief Command of a record (same set as EngineCommand::Type)
+ */
+enum class Op : juce::uint8 {
+  SetTrackVolume = 0,
+  SetTrackMute = 1,
+  SetMasterVolume = 2,
+  Play = 3,
+  Stop = 4,
+  Seek = 5,
+  SetTrackPan = 6,
+  SetBusVolume = 7,
+  SetBusMute = 8,
+  SetBusPan = 9,
+  SetSendLevel = 10,
+  NoteOn = 11,
+  NoteOff = 12,
+  SetTrackMidiInput = 13
+};
+
+/**
+ * @enum Timing
+ * @brief Unit of the `when` field of a command
+ *
+ * For Seek, `when` is the target position and Immediate means sample 0.
+ */
+enum class Timing : juce::uint8 {
+  Immediate = 0, /**< Next audio block, `when` ignored */
+  Sample = 1,    /**< Transport sample */
+  Beat = 2,      /**< Quarter-note beat on the tempo map */
+  Seconds = 3    /**< Seconds from the session start */
+};
+
+/**
+ * @enum Error
+ * @brief Result reported in a Status frame
+ */
+enum class Error : juce::uint16 {
+  None = 0,
+  BadFrame = 1,           /**< Truncated frame or wrong record count */
+  UnsupportedVersion = 2, /**< Version byte not negotiated */
+  UnknownMessage = 3,     /**< Unexpected frame type or op */
+  NoSuchTrack = 4,        /**< Track index out of range */
+  QueueFull = 5,          /**< Too many commands in flight */
+  NotNegotiated = 6,      /**< Binary frame before a "hello" */
+  NoSuchBus = 7,          /**< Bus index out of range */
+  NoSuchSend = 8          /**< Send index out of range */
+};
+
+/** @brief Byte offsets of the frame header */
+struct HeaderLayout {
+  static constexpr size_t version = 0;
+  static constexpr size_t type = 1;
+  static constexpr size_t count = 2;
+  static constexpr size_t sequence = 4;
+  static constexpr size_t size = 8;
+};
+
+/** @brief Byte offsets of a Commands record */
+struct CommandLayout {
+  static constexpr size_t op = 0;      /**< u8 Op */
+  static constexpr size_t timing = 1;  /**< u8 Timing */
+  static constexpr size_t note = 2;    /**< u8 MIDI note of NoteOn/NoteOff (1 byte reserved) */
+  static constexpr size_t track = 4;   /**< u32 track (bus, send) index */
+  static constexpr size_t value = 8;   /**< f64 volume, mute (0/1), velocity... */
+  static constexpr size_t when = 16;   /**< f64 in Timing units */
+  static constexpr size_t size = 24;
+};
+
+/** @brief Byte offsets of a Status record */
+struct StatusLayout {
+  static constexpr size_t firstCommandId = 0;  /**< u32 id of record 0 */
+  static constexpr size_t accepted = 4;        /**< u16 records queued */
+  static constexpr size_t error = 6;           /**< u16 Error of the first rejected record */
+  static constexpr size_t appliedCommand = 8;  /**< u32 last applied id */
+  static constexpr size_t trackCount = 12;     /**< u32 */
+  static constexpr size_t size = 16;
+};
+
+/** @brief Byte offsets of a Meters record (linear levels) */
+struct MeterLayout {
+  static constexpr size_t peak = 0;      /**< f32 */
+  static constexpr size_t truePeak = 4;  /**< f32 */
+  static constexpr size_t rms = 8;       /**< f32 */
+  static constexpr size_t size = 12;
+};
+
+/** @brief Byte offsets of the prefix of Spectrum and Scope frames */
+struct AnalysisLayout {
+  static constexpr size_t subscription = 0;  /**< u32 id from "analysisSubscribed" */
+  static constexpr size_t span = 4;          /**< u32 samples analysed */
+  static constexpr size_t end = 8;           /**< u64 source sample after the last one analysed */
+  static constexpr size_t sampleRate = 16;   /**< f32 Hz */
+  static constexpr size_t size = 20;
+};
+
+/** @brief Byte offsets of a Spectrum record (one FFT bin) */
+struct SpectrumLayout {
+  static constexpr size_t magnitude = 0;  /**< f32 dBFS */
+  static constexpr size_t size = 4;
+};
+
+/** @brief Byte offsets of a Scope record (one column of the waveform) */
+struct ScopeLayout {
+  static constexpr size_t min = 0;  /**< f32 lowest sample */
+  static constexpr size_t max = 4;  /**< f32 highest sample */
+  static constexpr size_t size = 8;
+};
+
+/** @brief Maximum records in one frame */
+constexpr int kMaxRecords = 0xffff;
+
+/**
+ * @brief Little-endian field accessors (independent of the host byte order)
+ *
+ * Little-endian hosts copy fields as they are (a single unaligned load or
+ * store); others assemble them byte by byte.
+ */
+namespace Bytes {
+
+template <typename UInt>
+inline UInt readUInt(const juce::uint8* data) noexcept {
+  UInt value = 0;
+#if JUCE_LITTLE_ENDIAN
+  std::memcpy(&value, data, sizeof(value));
+#else
+  for (size_t i = 0; i < sizeof(UInt); ++i) {
+    value |= (UInt)data[i] << (8 * i);
+  }
+#endif
+  return value;
+}
+
+inline float readFloat(const juce::uint8* data) noexcept {
+  const auto bits = readUInt<juce::uint32>(data);
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+inline double readDouble(const juce::uint8* data) noexcept {
+  const auto bits = readUInt<juce::uint64>(data);
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+template <typename UInt>
+inline void writeUInt(juce::uint8* data, UInt value) noexcept {
+#if JUCE_LITTLE_ENDIAN
+  std::memcpy(data, &value, sizeof(value));
+#else
+  for (size_t i = 0; i < sizeof(UInt); ++i) {
+    data[i] = (juce::uint8)(value >> (8 * i));
+  }
+#endif
+}
+
+inline void writeFloat(juce::uint8* data, float value) noexcept {
+  juce::uint32 bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  writeUInt(data, bits);
+}
+
+inline void writeDouble(juce::uint8* data, double value) noexcept {
+  juce::uint64 bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  writeUInt(data, bits);
+}
+
+}  // namespace Bytes
+
+/**
+ * @class CommandView
+ * @brief One Commands record, read in place
+ */
+class CommandView {
+ public:
+  explicit CommandView(const juce::uint8* record) noexcept : data(record) {}
+
+  Op getOp() const noexcept { return (Op)data[CommandLayout::op]; }
+  Timing getTiming() const noexcept { return (Timing)data[CommandLayout::timing]; }
+  int getNote() const noexcept { return data[CommandLayout::note]; }
+  juce::uint32 getTrack() const noexcept {
+    return Bytes::readUInt<juce::uint32>(data + CommandLayout::track);
+  }
+  double getValue() const noexcept {
+    return Bytes::readDouble(data + CommandLayout::value);
+  }
+  double getWhen() const noexcept {
+    return Bytes::readDouble(data + CommandLayout::when);
+  }
+
+ private:
+  const juce::uint8* data;
+};
+
+/**
+ * @class MeterView
+ * @brief One Meters record, read in place
+ */
+class MeterView {
+ public:
+  explicit MeterView(const juce::uint8* record) noexcept : data(record) {}
+
+  float getPeak() const noexcept {
+    return Bytes::readFloat(data + MeterLayout::peak);
+  }
+  float getTruePeak() const noexcept {
+    return Bytes::readFloat(data + MeterLayout::truePeak);
+  }
+  float getRms() const noexcept {
+    return Bytes::readFloat(data + MeterLayout::rms);
+  }
+
+ private:
+  const juce::uint8* data;
+};
+
+/**
+ * @class ScopeView
+ * @brief One Scope record, read in place
+ */
+class ScopeView {
+ public:
+  explicit ScopeView(const juce::uint8* record) noexcept : data(record) {}
+
+  float getMin() const noexcept { return Bytes::readFloat(data + ScopeLayout::min); }
+  float getMax() const noexcept { return Bytes::readFloat(data + ScopeLayout::max); }
+
+ private:
+  const juce::uint8* data;
+};
+
+/**
+ * @struct AnalysisInfo
+ * @brief Decoded prefix of a Spectrum or Scope frame
+ */
+struct AnalysisInfo {
+  juce::uint32 subscription = 0;
+  juce::uint32 span = 0;
+  juce::uint64 end = 0;
+  float sampleRate = 0.0f;
+};
+
+/**
+ * @struct Status
+ * @brief Decoded Status record
+ */
+struct Status {
+  juce::uint32 firstCommandId = 0;
+  juce::uint16 accepted = 0;
+  Error error = Error::None;
+  juce::uint32 appliedCommand = 0;
+  juce::uint32 trackCount = 0;
+};
+
+/**
+ * @class FrameView
+ * @brief Validated view of a received frame
+ *
+ * The bytes are not copied and must outlive the view.
+ */
+class FrameView {
+ public:
+  /**
+   * @brief Check the header and size of a frame
+   * @param data Frame bytes
+   * @param size Frame size in bytes
+   */
+  FrameView(const void* data, size_t size) noexcept;
+
+  /** @brief Error::None if the frame can be read */
+  Error getError() const noexcept { return error; }
+  bool isValid() const noexcept { return error == Error::None; }
+
+  /** @brief Header fields (sequence is set whenever the header is complete) */
+  MessageType getType() const noexcept { return type; }
+  int getCount() const noexcept { return count; }
+  juce::uint32 getSequence() const noexcept { return sequence; }
+
+  /** @brief Record index of a valid Commands frame */
+  CommandView getCommand(int index) const noexcept {
+    return CommandView(data + HeaderLayout::size +
+                       (size_t)index * CommandLayout::size);
+  }
+
+  /** @brief Record of a valid Status frame */
+  Status getStatus() const noexcept;
+
+  /** @brief Record index of a valid Meters frame */
+  MeterView getMeter(int index) const noexcept {
+    return MeterView(data + HeaderLayout::size +
+                     (size_t)index * MeterLayout::size);
+  }
+
+  /** @brief Prefix of a valid Spectrum or Scope frame */
+  AnalysisInfo getAnalysisInfo() const noexcept;
+
+  /** @brief Level in dBFS of bin index of a valid Spectrum frame */
+  float getBin(int index) const noexcept {
+    return Bytes::readFloat(data + HeaderLayout::size + AnalysisLayout::size +
+                            (size_t)index * SpectrumLayout::size);
+  }
+
+  /** @brief Record index of a valid Scope frame */
+  ScopeView getScope(int index) const noexcept {
+    return ScopeView(data + HeaderLayout::size + AnalysisLayout::size +
+                     (size_t)index * ScopeLayout::size);
+  }
+
+ private:
+  const juce::uint8* data;
+  Error error = Error::None;
+  MessageType type = MessageType::Commands;
+  int count = 0;
+  juce::uint32 sequence = 0;
+};
+
+/**
+ * @brief Start a frame in a reused buffer
+ * @param out Cleared, then receives the header (count 0)
+ */
+void beginFrame(std::string& out, MessageType type, juce::uint32 sequence);
+
+/**
+ * @brief Append a record to a Commands frame and update its count
+ * @param note MIDI note of NoteOn and NoteOff, 0 for other ops
+ */
+void appendCommand(std::string& out, Op op, Timing timing, juce::uint32 track,
+                   double value, double when, juce::uint8 note = 0);
+
+/**
+ * @brief Append the record of a Status frame
+ */
+void appendStatus(std::string& out, const Status& status);
+
+/**
+ * @brief Encode a whole Status frame (header and record) in one pass
+ *
+ * Same bytes as beginFrame() then appendStatus(), with a single resize: the
+ * reply to every Commands frame.
+ */
+void writeStatusFrame(std::string& out, juce::uint32 sequence, const Status& status);
+
+/**
+ * @brief Append a record to a Meters frame and update its count
+ */
+void appendMeter(std::string& out, float peak, float truePeak, float rms);
+
+/**
+ * @brief Start a Spectrum or Scope frame: header and prefix (count 0)
+ */
+void beginAnalysisFrame(std::string& out, MessageType type,
+                        juce::uint32 sequence, const AnalysisInfo& info);
+
+/**
+ * @brief Append count bins to a Spectrum frame and update its count
+ */
+void appendSpectrum(std::string& out, const float* magnitudesDb, int count);
+
+/**
+ * @brief Append count columns to a Scope frame and update its count
+ */
+void appendScope(std::string& out, const float* minimums, const float* maximums,
+                 int count);
+
+/**
+ * @brief Layouts and enum values of the current version, as JSON
+ *
+ * Sent to clients when they negotiate the binary format.
+ */
+juce::var getSchema();
+
+/** @brief Readable name of an error ("queueFull"...) */
+const char* getErrorName(Error error) noexcept;
+
+}  // namespace ControlProtocol
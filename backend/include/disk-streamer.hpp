@@ -0,0 +1,260 @@
+#pragma once
+#include <semaphore.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class DiskStreamer;
+
+/**
+ * @file disk-streamer.hpp
+ * @brief Streaming of audio files from disk through a background thread
+ */
+
+/**
+ * @class SampleStream
+ * @brief Lock-free ring buffer between the disk thread and one audio reader
+ *
+ * The disk thread decodes (and resamples to the engine rate) the file
+ * ahead of the read position into a ring of kMaxChannels planar channels.
+ * The audio thread only copies from the ring: it never opens, reads or
+ * seeks the file, and never waits for the disk thread.
+ *
+ * Reads are addressed by output frame. A read which does not continue the
+ * previous one (transport seek, loop, other sample rate) posts a seek
+ * request and returns silence until the disk thread has refilled the ring
+ * from the new position, usually within a few milliseconds. Frames which
+ * were not decoded in time during continuous playback are output as
+ * silence and counted as underruns.
+ *
+ * Request handshake: the audio thread publishes the target frame and rate
+ * under a sequence number (seqlock, the disk thread never blocks it). When
+ * the disk thread takes a request it publishes the ring index where frames
+ * of that request begin, tagged with its sequence, before writing any of
+ * them. The reader finds any later frame from that index, so the stream
+ * stays in time after a seek or an underrun.
+ *
+ * @note One reader thread (the audio thread, or a render worker rendering
+ * the track) and one disk thread per stream. Synchronous streams (offline
+ * rendering) have no disk thread: read() decodes what it needs itself.
+ */
+class SampleStream {
+ public:
+  /** @brief Opens a new reader on the streamed file */
+  using ReaderFactory = std::function<std::unique_ptr<juce::AudioFormatReader>()>;
+
+  /** @brief Channels kept per stream (more are not read) */
+  static constexpr int kMaxChannels = 2;
+
+  /** @brief Default ring capacity: 0.68 s at 48 kHz */
+  static constexpr int kDefaultBufferFrames = 1 << 15;
+
+  /**
+   * @brief Open the file and prefetch from frame 0 (see DiskStreamer)
+   * @param factory Opens the file; called once here
+   * @param sampleRate Output sample rate of the first reads
+   * @param bufferFrames Ring capacity, rounded up to a power of two
+   * @param owner Disk thread servicing the stream, or nullptr for a
+   * synchronous stream, decoded by the thread calling read()
+   */
+  SampleStream(ReaderFactory factory, double sampleRate, int bufferFrames,
+               DiskStreamer* owner);
+  ~SampleStream();
+
+  /** @brief False if the file could not be opened (reads output silence) */
+  bool isValid() const noexcept { return reader != nullptr; }
+
+  /** @brief Channels of the file, at most kMaxChannels */
+  int getNumChannels() const noexcept { return numChannels; }
+
+  double getSourceSampleRate() const noexcept { return sourceSampleRate; }
+
+  /** @brief Length of the file in its own frames */
+  juce::int64 getSourceLength() const noexcept { return sourceLength; }
+
+  /** @brief Length of the file once resampled to an output rate */
+  juce::int64 getLength(double sampleRate) const noexcept;
+
+  /** @brief True if the file is read through a memory map */
+  bool isMemoryMapped() const noexcept { return memoryMapped; }
+
+  /** @brief Opens the file again, e.g. for a synchronous copy */
+  const ReaderFactory& getReaderFactory() const noexcept { return factory; }
+
+  //==============================================================================
+  // Reader (audio thread)
+
+  /**
+   * @brief Copy output frames from the ring
+   * @param frame First output frame (negative: silence before the file)
+   * @param sampleRate Output sample rate
+   * @param destinations 1 (a stereo file is summed to mono) or 2 channels
+   * (a mono file is copied to both)
+   * @param numDestinations Number of destination channels
+   * @param numFrames Frames to write to each destination
+   * @return Frames copied from the file; the rest are silence
+   */
+  int read(juce::int64 frame, double sampleRate, float* const* destinations,
+           int numDestinations, int numFrames) noexcept;
+
+  /** @brief File frames which were due but not decoded in time */
+  juce::uint64 getUnderrunFrames() const noexcept {
+    return underrunFrames.load(std::memory_order_relaxed);
+  }
+
+  /** @brief Frames decoded ahead of the reader (any thread, approximate) */
+  int getBufferedFrames() const noexcept;
+
+  //==============================================================================
+  // Disk thread
+
+  /**
+   * @brief Take a pending seek, then decode up to maxFrames into the ring
+   * @return Frames written (0 if the ring is full or the file ended)
+   */
+  int prefetch(int maxFrames);
+
+  /** @brief True if a seek is waiting for the disk thread */
+  bool hasPendingSeek() const noexcept;
+
+ private:
+  /** @brief Frames past the seek position are decoded from here */
+  struct Segment {
+    std::uint64_t startIndex;
+    std::uint32_t sequence;
+  };
+
+  static std::uint64_t pack(Segment segment) noexcept {
+    return segment.startIndex << 16 | (segment.sequence & 0xFFFFu);
+  }
+
+  static Segment unpack(std::uint64_t packed) noexcept {
+    return {packed >> 16, (std::uint32_t)(packed & 0xFFFFu)};
+  }
+
+  /** @brief Reader side: ask the disk thread to continue from a frame */
+  void requestSeek(juce::int64 frame, double sampleRate) noexcept;
+
+  /** @brief Disk side: read the newest request if it was not taken yet */
+  void takeRequest();
+
+  /** @brief Disk side: decode frames at the current position */
+  void decode(float* const* destinations, int numFrames);
+
+  /** @brief Reader side: copy up to numFrames from an output frame on */
+  int consume(juce::int64 frame, float* const* destinations, int numDestinations,
+              int offset, int numFrames) noexcept;
+
+  ReaderFactory factory;
+  std::unique_ptr<juce::AudioFormatReader> reader;
+  DiskStreamer* owner;
+  bool memoryMapped = false;
+  int numChannels = 0;
+  double sourceSampleRate = 0.0;
+  juce::int64 sourceLength = 0;
+
+  /** @brief Planar ring of `capacity` frames, written by the disk thread */
+  juce::AudioBuffer<float> ring;
+  int capacity = 0;
+
+  // Shared between the threads
+  alignas(64) std::atomic<std::uint64_t> writeIndex{0};
+  std::atomic<std::uint64_t> segment{0};
+  alignas(64) std::atomic<std::uint64_t> readIndex{0};
+  std::atomic<juce::uint64> underrunFrames{0};
+
+  /** @brief Seqlock of the request: odd while the reader writes it */
+  alignas(64) std::atomic<std::uint32_t> requestSequence{0};
+  std::atomic<juce::int64> requestFrame{0};
+  std::atomic<double> requestRate{0.0};
+
+  // Reader only
+  alignas(64) std::uint32_t readerSequence = 0;
+  juce::int64 seekFrame = 0;
+  juce::int64 nextFrame = 0;
+  double readerRate = 0.0;
+  juce::int64 readerLength = 0;
+  bool primed = false;
+
+  // Disk thread only
+  alignas(64) std::uint32_t diskSequence = 0;
+  juce::int64 outputFrame = 0;
+  juce::int64 outputLength = 0;
+  juce::int64 sourcePosition = 0;
+  double speedRatio = 1.0;
+  juce::AudioBuffer<float> scratch;
+  std::array<juce::LagrangeInterpolator, kMaxChannels> interpolators;
+
+  JUCE_DECLARE_NON_COPYABLE(SampleStream)
+};
+
+/**
+ * @class DiskStreamer
+ * @brief Background thread keeping every SampleStream ahead of its reader
+ *
+ * One thread services all streams: each pass decodes one chunk into each
+ * stream with room for it, the most starved streams (and pending seeks)
+ * first, and sleeps when every ring is full. Readers wake it when they
+ * seek. Streams are held weakly and dropped once their track is gone.
+ *
+ * WAV and AIFF files are read through a memory map, so decoding is a copy
+ * from the page cache; other formats go through their regular reader.
+ *
+ * @note Must outlive the streams it creates
+ */
+class DiskStreamer {
+ public:
+  /** @brief Frames decoded per stream and pass */
+  static constexpr int kDefaultChunkFrames = 4096;
+
+  /**
+   * @brief Start the disk thread
+   * @param bufferFrames Ring capacity of new streams
+   * @param chunkFrames Frames decoded per stream and pass
+   */
+  explicit DiskStreamer(int bufferFrames = SampleStream::kDefaultBufferFrames,
+                        int chunkFrames = kDefaultChunkFrames);
+  ~DiskStreamer();
+
+  /**
+   * @brief Open a file for streaming (control thread)
+   * @param sampleRate Output sample rate of the first reads
+   * @return nullptr if the file cannot be opened
+   */
+  std::shared_ptr<SampleStream> createStream(const juce::File& file,
+                                             double sampleRate);
+  std::shared_ptr<SampleStream> createStream(SampleStream::ReaderFactory factory,
+                                             double sampleRate);
+
+  /** @brief Opens a file, memory-mapped when the format supports it */
+  static SampleStream::ReaderFactory getReaderFactory(const juce::File& file);
+
+  /** @brief Streams still alive */
+  int getNumStreams() const;
+
+  /** @brief Wake the disk thread (any thread, real-time safe) */
+  void wakeUp() noexcept { sem_post(&wakeUpSignal); }
+
+ private:
+  void run();
+
+  const int bufferFrames;
+  const int chunkFrames;
+
+  mutable std::mutex streamsMutex;
+  std::vector<std::weak_ptr<SampleStream>> streams;
+
+  sem_t wakeUpSignal;
+  std::atomic<bool> shouldExit{false};
+  std::thread thread;
+
+  JUCE_DECLARE_NON_COPYABLE(DiskStreamer)
+};
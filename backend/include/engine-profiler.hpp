@@ -0,0 +1,205 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+
+/**
+ * @file engine-profiler.hpp
+ * @brief Timing histograms of the audio callback, exported for monitoring
+ */
+
+/**
+ * @class Histogram
+ * @brief Lock-free histogram with fixed bucket bounds
+ *
+ * Written by a single thread (the audio thread, or the worker rendering a
+ * track) with plain relaxed stores, so recording costs a bucket search and
+ * a few stores; any thread can take a Snapshot at the same time. Bounds
+ * follow Prometheus conventions: bucket i counts values up to
+ * getBound(i), the last bucket everything above.
+ */
+class Histogram {
+ public:
+  /**
+   * @enum Scale
+   * @brief Bucket bounds of the histogram
+   */
+  enum class Scale {
+    Seconds,  /**< 1 us to 100 ms, in 1-2.5-5 steps */
+    Load      /**< Fraction of the buffer deadline, 0.1 to 2 */
+  };
+
+  /** @brief Upper bounds plus the overflow bucket */
+  static constexpr int kMaxBuckets = 24;
+
+  /**
+   * @struct Snapshot
+   * @brief Counts of a histogram at one point in time
+   */
+  struct Snapshot {
+    /** @brief Values per bucket (not cumulative) */
+    std::array<juce::uint64, kMaxBuckets> counts{};
+    double sum = 0.0;
+    double max = 0.0;
+
+    /** @brief Number of values recorded */
+    juce::uint64 getCount() const noexcept;
+
+    /** @brief Mean value, 0 when empty */
+    double getMean() const noexcept;
+
+    /**
+     * @brief Upper bound of the bucket holding quantile q (0 to 1)
+     * @param scale Bounds of the histogram
+     * @return The bound, max for the overflow bucket, 0 when empty
+     */
+    double getQuantile(Scale scale, double q) const noexcept;
+
+    /** @brief Values recorded since an earlier snapshot (max is kept) */
+    Snapshot since(const Snapshot& earlier) const noexcept;
+  };
+
+  explicit Histogram(Scale scale) noexcept : scale(scale) {}
+
+  /** @brief Copy of the current counts (tracks are cloned with theirs) */
+  Histogram(const Histogram& other) noexcept;
+  Histogram& operator=(const Histogram&) = delete;
+
+  /** @brief Bounds of a scale, without the overflow bucket */
+  static int getNumBounds(Scale scale) noexcept;
+  static double getBound(Scale scale, int bucket) noexcept;
+
+  Scale getScale() const noexcept { return scale; }
+
+  /** @brief Add a value (single writer) */
+  void record(double value) noexcept;
+
+  /** @brief Read the counts (any thread) */
+  Snapshot getSnapshot() const noexcept;
+
+  /** @brief Forget all values (not concurrently with record()) */
+  void reset() noexcept;
+
+ private:
+  Scale scale;
+  std::array<std::atomic<juce::uint64>, kMaxBuckets> counts{};
+  std::atomic<double> sum{0.0};
+  std::atomic<double> max{0.0};
+};
+
+/**
+ * @struct ProfileSnapshot
+ * @brief Everything the profiler measured, captured for export
+ */
+struct ProfileSnapshot {
+  Histogram::Snapshot callback;
+  Histogram::Snapshot load;
+  Histogram::Snapshot render;
+  Histogram::Snapshot mix;
+
+  /** @brief renderBlock() times, in track list order */
+  std::vector<Histogram::Snapshot> tracks;
+
+  juce::uint64 missedDeadlines = 0;
+
+  /** @brief Under/overruns reported by the audio device, -1 if unknown */
+  int deviceXRuns = -1;
+
+  /** @brief MIDI input timing (see MidiInputQueue): delay from arrival to
+   * playback, its distance from one block, events lost to a full queue */
+  Histogram::Snapshot midiLatency;
+  Histogram::Snapshot midiJitter;
+  juce::uint64 midiDropped = 0;
+
+  bool detailed = false;
+};
+
+/**
+ * @class EngineProfiler
+ * @brief Measures where the audio thread spends its time
+ *
+ * Measured by default (two clock reads per block): callback duration, its
+ * ratio to the buffer duration (DSP load) and the callbacks that missed
+ * their deadline, i.e. took longer than the audio they produced.
+ * setEnabled(false) stops every measurement; the counters keep their
+ * values.
+ *
+ * With detailed timing on, the MixEngine also times every renderBlock()
+ * call (into AudioTrack::renderTime), the render phase and the mix phase
+ * (everything else: commands, summing, master gain, metering). This costs
+ * two clock reads per track and is off by default.
+ *
+ * Snapshots are exported in the Prometheus text format (/metrics) and as
+ * JSON summaries for WebSocket subscribers.
+ */
+class EngineProfiler {
+ public:
+  EngineProfiler() = default;
+
+  /** @brief Sample rate of the callbacks */
+  void prepare(double newSampleRate) noexcept { sampleRate.store(newSampleRate); }
+
+  /** @brief Turn all measurements on or off (default on) */
+  void setEnabled(bool shouldProfile) noexcept { enabled.store(shouldProfile); }
+  bool isEnabled() const noexcept { return enabled.load(std::memory_order_relaxed); }
+
+  /** @brief Turn per-track, render and mix timing on or off (default off) */
+  void setDetailed(bool shouldTime) noexcept { detailed.store(shouldTime); }
+  bool isDetailed() const noexcept {
+    return detailed.load(std::memory_order_relaxed) && isEnabled();
+  }
+
+  /** @brief High-resolution clock of all measurements */
+  static juce::int64 now() noexcept { return juce::Time::getHighResolutionTicks(); }
+  static double toSeconds(juce::int64 ticks) noexcept;
+
+  //==============================================================================
+  // Audio thread
+
+  /**
+   * @brief Record one callback
+   * @param ticks Duration from now()
+   * @param numSamples Samples produced, which set the deadline
+   */
+  void recordCallback(juce::int64 ticks, int numSamples) noexcept;
+
+  /** @brief Record the render and mix phases of a block (detailed timing) */
+  void recordPhases(juce::int64 renderTicks, juce::int64 mixTicks) noexcept;
+
+  //==============================================================================
+  // Any thread
+
+  /**
+   * @brief Read every histogram
+   * @param trackHistograms renderBlock() times of the tracks, in order
+   * @param snapshot Filled in place (its track vector is reused)
+   */
+  void capture(const std::vector<const Histogram*>& trackHistograms,
+               ProfileSnapshot& snapshot) const;
+
+  /** @brief Append a snapshot in the Prometheus text exposition format */
+  static void writePrometheus(const ProfileSnapshot& snapshot, std::string& out);
+
+  /**
+   * @brief JSON summary of the interval between two snapshots
+   *
+   * Quantiles and means cover the interval; peaks cover the whole run.
+   */
+  static juce::var describe(const ProfileSnapshot& current,
+                            const ProfileSnapshot& previous);
+
+ private:
+  std::atomic<bool> enabled{true};
+  std::atomic<bool> detailed{false};
+  std::atomic<double> sampleRate{44100.0};
+
+  Histogram callbackTime{Histogram::Scale::Seconds};
+  Histogram load{Histogram::Scale::Load};
+  Histogram renderTime{Histogram::Scale::Seconds};
+  Histogram mixTime{Histogram::Scale::Seconds};
+  std::atomic<juce::uint64> missedDeadlines{0};
+
+  JUCE_DECLARE_NON_COPYABLE(EngineProfiler)
+};
@@ -0,0 +1,178 @@
+#pragma once
+#include <juce_core/juce_core.h>
+
+/**
+ * @file envelope-generator.hpp
+ * @brief Segment-based ADSR envelope rendered a block at a time
+ */
+
+/**
+ * @struct ADSRParameters
+ * @brief Times, sustain level and segment curves of an ADSR envelope
+ */
+struct ADSRParameters {
+  /**
+   * @enum Curve
+   * @brief Shape of a segment between its start and end values
+   */
+  enum class Curve {
+    Linear,      /**< Constant slope */
+    Exponential, /**< Fast at first, easing into the target (RC curve) */
+    Logarithmic  /**< Slow at first, accelerating into the target */
+  };
+
+  /** @brief Attack time in seconds (0 to 1) */
+  float attackTime = 0.01f;
+
+  /** @brief Decay time in seconds (1 to sustain level) */
+  float decayTime = 0.02f;
+
+  /** @brief Sustain level (0.0 to 1.0) */
+  float sustainLevel = 0.8f;
+
+  /** @brief Release time in seconds (current level to 0) */
+  float releaseTime = 0.02f;
+
+  Curve attackCurve = Curve::Linear;
+  Curve decayCurve = Curve::Linear;
+  Curve releaseCurve = Curve::Linear;
+};
+
+/**
+ * @class EnvelopeGenerator
+ * @brief Incremental ADSR envelope usable by any track type
+ *
+ * The envelope is a sequence of segments: attack, decay, sustain, release.
+ * Each segment is set up once, when it starts:
+ *
+ * - Linear segments compute value = start + n * increment. A block is a
+ *   ramp the compiler vectorizes.
+ * - Curved segments compute value = asymptote + distance * multiplier^n.
+ *   The asymptote is solved so the segment ends exactly on its target
+ *   after its length.
+ *
+ * Stage changes are only looked at on segment boundaries, never per
+ * sample. Blocks are rendered as gain values (renderBlock()) or applied in
+ * place (applyBlock()).
+ *
+ * @note Real-time safe: no allocation, no locks
+ * @note Not thread-safe, owned by one render thread like the track state
+ */
+class EnvelopeGenerator {
+ public:
+  /**
+   * @enum Stage
+   * @brief Current segment of the envelope
+   */
+  enum class Stage { Idle, Attack, Decay, Sustain, Release };
+
+  EnvelopeGenerator() = default;
+
+  /**
+   * @brief Construct with parameters and a sample rate
+   */
+  EnvelopeGenerator(const ADSRParameters& parameters, double sampleRate);
+
+  /**
+   * @brief Set the envelope parameters
+   * @note Takes effect from the next segment
+   */
+  void setParameters(const ADSRParameters& newParameters);
+
+  /** @brief Get the envelope parameters */
+  const ADSRParameters& getParameters() const { return parameters; }
+
+  /**
+   * @brief Set the sample rate segment lengths are computed for
+   * @note Takes effect from the next segment
+   */
+  void setSampleRate(double newSampleRate);
+
+  /**
+   * @brief Start the attack from the current value
+   */
+  void noteOn();
+
+  /**
+   * @brief Start the release from the current value
+   * @note Ignored while idle
+   */
+  void noteOff();
+
+  /**
+   * @brief Jump to idle at zero
+   */
+  void reset();
+
+  /**
+   * @brief Advance without rendering
+   * @param numSamples Samples to skip (any amount, segments are crossed
+   * analytically)
+   */
+  void advance(juce::int64 numSamples);
+
+  /**
+   * @brief Fill gain values and advance
+   * @param gains Destination for numSamples values
+   */
+  void renderBlock(float* gains, int numSamples);
+
+  /**
+   * @brief Multiply samples by the envelope and advance
+   * @param samples Samples to scale in place
+   */
+  void applyBlock(float* samples, int numSamples);
+
+  /** @brief Current stage */
+  Stage getStage() const { return stage; }
+
+  /** @brief True unless idle */
+  bool isActive() const { return stage != Stage::Idle; }
+
+  /** @brief Value of the next sample */
+  float getValue() const;
+
+  /**
+   * @brief Samples left in the current segment
+   * @return Remaining length, or -1 for sustain and idle (unbounded)
+   */
+  juce::int64 getRemainingSamples() const;
+
+ private:
+  /** @brief Set up a segment going from one value to another */
+  void startSegment(Stage newStage, float from, float newTarget,
+                    float seconds, ADSRParameters::Curve newCurve);
+
+  /** @brief Enter the stage following a finished segment */
+  void finishSegment();
+
+  /** @brief Render or apply numSamples of the current segment */
+  template <bool Apply>
+  void processSegment(float* data, int numSamples);
+
+  /** @brief Render or apply a block, crossing segment boundaries */
+  template <bool Apply>
+  void process(float* data, int numSamples);
+
+  ADSRParameters parameters;
+  double sampleRate = 44100.0;
+
+  Stage stage = Stage::Idle;
+  ADSRParameters::Curve curve = ADSRParameters::Curve::Linear;
+
+  /** @brief Value reached at the end of the segment */
+  float target = 0.0f;
+
+  /** @brief Segment length and position, in samples */
+  juce::int64 length = 0;
+  juce::int64 position = 0;
+
+  /** @brief Linear segments: value at position 0 and slope */
+  float start = 0.0f;
+  float increment = 0.0f;
+
+  /** @brief Curved segments: asymptote, distance to it, per-sample ratio */
+  float asymptote = 0.0f;
+  float distance = 0.0f;
+  float multiplier = 1.0f;
+};
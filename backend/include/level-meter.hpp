@@ -0,0 +1,279 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/**
+ * @file level-meter.hpp
+ * @brief Peak, RMS and true-peak level measurement
+ */
+
+/**
+ * @struct MeterReading
+ * @brief Levels of one channel (linear gain, not dB)
+ */
+struct MeterReading {
+  /** @brief Highest absolute sample value since the previous reading */
+  float peak = 0.0f;
+
+  /** @brief Highest inter-sample value (4x oversampled) since the previous reading */
+  float truePeak = 0.0f;
+
+  /** @brief RMS level over the last ChannelMeter::kRmsWindowSeconds */
+  float rms = 0.0f;
+
+  /**
+   * @brief Combine with a later reading: highest peaks, latest RMS
+   */
+  void merge(const MeterReading& later) noexcept {
+    peak = juce::jmax(peak, later.peak);
+    truePeak = juce::jmax(truePeak, later.truePeak);
+    rms = later.rms;
+  }
+
+  /**
+   * @brief Levels of a stereo pair as one channel: highest peaks, RMS of
+   * the mean power
+   */
+  static MeterReading combine(const MeterReading& left, const MeterReading& right) noexcept {
+    MeterReading combined;
+    combined.peak = juce::jmax(left.peak, right.peak);
+    combined.truePeak = juce::jmax(left.truePeak, right.truePeak);
+    combined.rms = std::sqrt(0.5f * (left.rms * left.rms + right.rms * right.rms));
+    return combined;
+  }
+};
+
+/**
+ * @struct SpanLevels
+ * @brief Reductions of a span of samples: sample peak, where it is, and
+ * the sum of squares
+ *
+ * Computed by ChannelMeter, or by a kernel which already reads every sample
+ * (ChannelStrip::mix()), so that metering needs no second pass.
+ */
+struct SpanLevels {
+  /** @brief Largest absolute sample value */
+  float peak = 0.0f;
+
+  /** @brief Index of the first sample reaching peak */
+  int peakIndex = 0;
+
+  /** @brief Sum of the squared samples */
+  float sumSquares = 0.0f;
+};
+
+/**
+ * @class ChannelMeter
+ * @brief Measures the levels of a stream of samples, block by block
+ *
+ * process() runs on the audio thread (or a render worker) right after a
+ * block is rendered, while the samples are still in cache:
+ *
+ * - peak and sum of squares are reductions over independent lanes, which
+ *   the compiler turns into vector instructions;
+ * - RMS is a mean square smoothed with a one-pole over kRmsWindowSeconds;
+ * - true peak follows ITU-R BS.1770: 4x oversampling with a 48-tap
+ *   polyphase interpolator. In Exact mode it runs on every 32-sample chunk
+ *   loud enough to exceed the current true peak (the interpolator gain is
+ *   bounded), which is still most chunks of a steady tone. AroundPeak mode
+ *   only interpolates the two gaps next to the largest sample of each
+ *   reading, where inter-sample overs form: an estimate within the 4x grid
+ *   resolution, for the hundreds of track meters of a session. It keeps
+ *   the 13 samples around that peak, so it can take its reductions from
+ *   the mix pass (SpanLevels) and never reads the span again.
+ *
+ * @note Not thread-safe: one thread processes a meter at a time
+ */
+class ChannelMeter {
+ public:
+  /** @brief Integration time of the RMS level */
+  static constexpr double kRmsWindowSeconds = 0.3;
+
+  /** @brief Taps per oversampling phase */
+  static constexpr int kTruePeakTaps = 12;
+
+  /** @brief Independent accumulators of the reductions (one vector register) */
+  static constexpr int kReductionLanes = 8;
+
+  /**
+   * @enum TruePeakMode
+   * @brief Which inter-sample values are measured
+   */
+  enum class TruePeakMode {
+    Exact,      /**< All of them (master bus) */
+    AroundPeak  /**< Only next to each new sample peak (tracks) */
+  };
+
+  explicit ChannelMeter(TruePeakMode mode = TruePeakMode::Exact) noexcept
+      : truePeakMode(mode) {}
+
+  /**
+   * @brief RMS smoothing coefficient for a span of samples
+   *
+   * Computed once per span and shared by every meter of the block.
+   */
+  static float getRmsCoefficient(int numSamples, double sampleRate) noexcept;
+
+  /**
+   * @brief Measure a span of samples
+   * @param samples Samples to measure
+   * @param numSamples Number of samples
+   * @param rmsCoefficient getRmsCoefficient(numSamples, sampleRate)
+   */
+  void process(const float* samples, int numSamples, float rmsCoefficient) noexcept;
+
+  /**
+   * @brief Measure a span whose reductions are already known (AroundPeak
+   * meters only)
+   * @param levels Reductions of the span
+   * @param sampleAt Callable returning sample i of the span, for
+   * 0 <= i < numSamples: only the few next to the edges and to a new peak
+   * are read, so the span need not be stored
+   *
+   * Costs a few dozen operations per span; the true peak is interpolated
+   * once per reading, around its highest sample.
+   */
+  template <typename SampleAt>
+  void process(int numSamples, const SpanLevels& levels, float rmsCoefficient,
+               SampleAt&& sampleAt) noexcept {
+    jassert(truePeakMode == TruePeakMode::AroundPeak);
+    if (numSamples <= 0) {
+      return;
+    }
+
+    SpanEdges edges;
+    edges.numHead = juce::jmin(windowMissing, numSamples);
+    for (int i = 0; i < edges.numHead; ++i) {
+      edges.head[i] = sampleAt(i);
+    }
+    edges.newPeak = raisesPeak(levels);
+    if (edges.newPeak) {
+      for (int i = 0; i < kPeakWindow; ++i) {
+        const int index = levels.peakIndex - kPeakWindow / 2 + i;
+        edges.aroundPeak[i] = index >= 0 && index < numSamples ? sampleAt(index) : 0.0f;
+      }
+    }
+    edges.numTail = juce::jmin(kPeakWindow / 2, numSamples);
+    for (int i = 0; i < edges.numTail; ++i) {
+      edges.tail[i] = sampleAt(numSamples - edges.numTail + i);
+    }
+    processAroundPeak(numSamples, levels, edges, rmsCoefficient);
+  }
+
+  /**
+   * @brief Measure a span of silence (track not rendered)
+   */
+  void processSilence(int numSamples, float rmsCoefficient) noexcept;
+
+  /**
+   * @brief Levels since the previous reading, then start a new interval
+   * @param previousUnread True if the previous reading was never delivered:
+   * its peaks are carried over so none is lost
+   */
+  MeterReading takeReading(bool previousUnread) noexcept;
+
+  /** @brief Forget all levels and the interpolator history */
+  void reset() noexcept;
+
+ private:
+  // Samples next to a sample peak which its true-peak estimate reads
+  static constexpr int kPeakWindow = kTruePeakTaps + 1;
+
+  /** @brief The samples of a span an AroundPeak meter reads */
+  struct SpanEdges {
+    // First samples, completing the window of a peak near the end of an
+    // earlier span
+    float head[kPeakWindow / 2];
+    int numHead = 0;
+
+    // Samples around the peak (zeros beyond the span), if it is a new one
+    float aroundPeak[kPeakWindow];
+    bool newPeak = false;
+
+    // Last samples, for a peak near the start of the next span
+    float tail[kPeakWindow / 2];
+    int numTail = 0;
+  };
+
+  /** @brief Sample peak and energy in chunks, with the full true peak */
+  void processExact(const float* samples, int numSamples,
+                    float (&sumLanes)[kReductionLanes]) noexcept;
+
+  /** @brief True if a span with these levels holds the peak of the reading */
+  bool raisesPeak(const SpanLevels& levels) const noexcept;
+
+  /** @brief Levels and peak window of an AroundPeak span */
+  void processAroundPeak(int numSamples, const SpanLevels& levels, const SpanEdges& edges,
+                         float rmsCoefficient) noexcept;
+
+  /** @brief Keep the end of a span for the interpolator */
+  void keepHistory(const float* samples, int numSamples) noexcept;
+
+  /** @brief Interpolate the two gaps next to the sample peak of the window */
+  void interpolateWindow() noexcept;
+
+  TruePeakMode truePeakMode;
+
+  float peak = 0.0f;
+  float truePeak = 0.0f;
+  float meanSquare = 0.0f;
+
+  // Peaks of the previous reading, in case it was not delivered
+  float heldPeak = 0.0f;
+  float heldTruePeak = 0.0f;
+
+  // Last samples of the previous span, for the interpolator
+  float history[kTruePeakTaps - 1] = {};
+
+  // AroundPeak: samples around the highest peak of the reading, the last
+  // windowMissing of them still to come from the next spans
+  float window[kPeakWindow] = {};
+  int windowMissing = 0;
+  bool windowPending = false;
+};
+
+/**
+ * @struct MeterFrame
+ * @brief Levels of every track and of the master bus at one point in time
+ */
+struct MeterFrame {
+  /** @brief Tracks beyond this index are not reported */
+  static constexpr int kMaxTracks = 1024;
+
+  /** @brief Transport position at the end of the measured interval */
+  juce::int64 position = 0;
+
+  /** @brief Master bus, left and right */
+  MeterReading master[2];
+
+  /** @brief Number of valid entries in tracks, in track list order */
+  int numTracks = 0;
+
+  /** @brief Post-fader track levels (preallocated to kMaxTracks) */
+  std::vector<MeterReading> tracks;
+
+  /**
+   * @brief Combine with a later frame (for a consumer slower than the engine)
+   *
+   * Peaks are the highest of both intervals, RMS and position the latest.
+   * Does not allocate if tracks is preallocated.
+   */
+  void merge(const MeterFrame& later) {
+    position = later.position;
+    master[0].merge(later.master[0]);
+    master[1].merge(later.master[1]);
+
+    const int common = juce::jmin(numTracks, later.numTracks);
+    for (int i = 0; i < common; ++i) {
+      tracks[(size_t)i].merge(later.tracks[(size_t)i]);
+    }
+    if (tracks.size() < (size_t)later.numTracks) {
+      tracks.resize((size_t)later.numTracks);
+    }
+    std::copy(later.tracks.begin() + common,
+              later.tracks.begin() + later.numTracks, tracks.begin() + common);
+    numTracks = later.numTracks;
+  }
+};
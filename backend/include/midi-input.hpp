@@ -0,0 +1,182 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "engine-profiler.hpp"
+#include "spsc-queue.hpp"
+
+/**
+ * @file midi-input.hpp
+ * @brief Timestamped MIDI note events from input devices to the audio thread
+ */
+
+/**
+ * @struct MidiEvent
+ * @brief A note message and the sample of the block it plays on
+ */
+struct MidiEvent {
+  /**
+   * @enum Type
+   * @brief What the event does to the tracks receiving it
+   */
+  enum class Type : juce::uint8 {
+    NoteOn, /**< AudioTrack::noteOn(note, velocity) */
+    NoteOff /**< AudioTrack::noteOff(note) */
+  };
+
+  Type type = Type::NoteOn;
+
+  /** @brief MIDI channel, 1 to 16 */
+  juce::uint8 channel = 1;
+
+  /** @brief MIDI note number, 0 to 127 */
+  juce::uint8 note = 0;
+
+  /** @brief Velocity of a NoteOn, 0 to 1 */
+  float velocity = 0.0f;
+
+  /** @brief Sample of the block the event plays on (set on delivery) */
+  int offset = 0;
+
+  /** @brief Arrival time, in EngineProfiler::now() ticks */
+  juce::int64 arrivalTicks = 0;
+};
+
+/**
+ * @class MidiEventList
+ * @brief Events of one block, sorted by offset, in preallocated storage
+ *
+ * Filled by the audio thread at the top of each block and read by the
+ * tracks while they render it. Adding never allocates: a full list
+ * refuses the event.
+ */
+class MidiEventList {
+ public:
+  /** @brief Default number of events per block */
+  static constexpr int kDefaultCapacity = 1024;
+
+  /** @brief Allocate room for capacity events */
+  explicit MidiEventList(int capacity = kDefaultCapacity)
+      : events((size_t)juce::jmax(1, capacity)) {}
+
+  /** @brief Remove every event */
+  void clear() noexcept { numEvents = 0; }
+
+  /**
+   * @brief Insert an event after those with the same or an earlier offset
+   * @return False if the list is full
+   */
+  bool add(const MidiEvent& event) noexcept;
+
+  int size() const noexcept { return numEvents; }
+  bool isEmpty() const noexcept { return numEvents == 0; }
+  bool isFull() const noexcept { return numEvents == (int)events.size(); }
+  int getCapacity() const noexcept { return (int)events.size(); }
+
+  const MidiEvent& operator[](int index) const noexcept {
+    return events[(size_t)index];
+  }
+
+  const MidiEvent* begin() const noexcept { return events.data(); }
+  const MidiEvent* end() const noexcept { return events.data() + numEvents; }
+
+  /** @brief First event with an offset of at least offset */
+  const MidiEvent* lowerBound(int offset) const noexcept;
+
+ private:
+  std::vector<MidiEvent> events;
+  int numEvents = 0;
+};
+
+/**
+ * @class MidiInputQueue
+ * @brief Lock-free handover of MIDI input to the audio thread, with the
+ * timing error of each event measured
+ *
+ * MIDI device threads push note messages stamped with their arrival time.
+ * Several devices may push at once: producers are serialised by a mutex
+ * the audio thread never takes, which keeps the queue single-producer.
+ *
+ * At the top of each block the audio thread calls collectBlock() with the
+ * time of its callback. An event that arrived d seconds after the
+ * previous callback plays on sample d * sampleRate of this block, so
+ * events keep their spacing and are all delayed by about one block.
+ * Events arriving after the callback wait for the next block.
+ *
+ * For every event, the delay from its arrival to the time of its sample
+ * is recorded (getLatency()), and the distance of that delay from one
+ * block (getJitter()). With a steady callback, jitter stays within a
+ * sample; late or irregular callbacks show up in it.
+ */
+class MidiInputQueue {
+ public:
+  /** @brief Default number of events in flight */
+  static constexpr int kDefaultCapacity = 4096;
+
+  /**
+   * @brief Allocate the queue
+   * @param capacity Maximum number of events waiting for the audio thread
+   */
+  explicit MidiInputQueue(int capacity = kDefaultCapacity);
+
+  /**
+   * @brief Queue a note message (MIDI device threads)
+   * @param message Note-on or note-off; other messages are ignored
+   * @param arrivalTicks Arrival time, from EngineProfiler::now()
+   * @return False if the message was ignored or the queue is full
+   */
+  bool push(const juce::MidiMessage& message, juce::int64 arrivalTicks);
+
+  /**
+   * @brief Queue an event (MIDI device threads)
+   * @return False if the queue is full (the event is counted as dropped)
+   */
+  bool push(const MidiEvent& event);
+
+  /**
+   * @brief Set the sample rate of the blocks
+   * @note Not concurrently with collectBlock()
+   */
+  void prepare(double newSampleRate) noexcept;
+
+  /**
+   * @brief Deliver the events which arrived before a callback (audio thread)
+   * @param callbackTicks Time of the callback, from EngineProfiler::now()
+   * @param numSamples Length of the block
+   * @param events Cleared, then receives the events with their offset in
+   * the block. Events which do not fit stay queued for the next block.
+   */
+  void collectBlock(juce::int64 callbackTicks, int numSamples,
+                    MidiEventList& events) noexcept;
+
+  /** @brief Delay from the arrival of each event to its sample */
+  const Histogram& getLatency() const noexcept { return latency; }
+
+  /** @brief Distance of each event's delay from one block */
+  const Histogram& getJitter() const noexcept { return jitter; }
+
+  /** @brief Events lost to a full queue */
+  juce::uint64 getDroppedCount() const noexcept {
+    return dropped.load(std::memory_order_relaxed);
+  }
+
+ private:
+  /** @brief Serialises the MIDI device threads */
+  std::mutex producerMutex;
+
+  SpscQueue<MidiEvent> queue;
+
+  /** @brief Event popped ahead of its block */
+  MidiEvent held;
+  bool hasHeld = false;
+
+  double sampleRate = 44100.0;
+
+  /** @brief Time of the previous callback (0: none yet) */
+  juce::int64 previousCallbackTicks = 0;
+
+  Histogram latency{Histogram::Scale::Seconds};
+  Histogram jitter{Histogram::Scale::Seconds};
+  std::atomic<juce::uint64> dropped{0};
+};
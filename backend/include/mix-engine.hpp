@@ -0,0 +1,456 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "analysis-tap.hpp"
+#include "audio-track.hpp"
+#include "channel-strip.hpp"
+#include "command-queue.hpp"
+#include "engine-profiler.hpp"
+#include "level-meter.hpp"
+#include "midi-input.hpp"
+#include "mix-graph.hpp"
+#include "render-worker-pool.hpp"
+#include "tempo-map.hpp"
+#include "track-list.hpp"
+#include "transport.hpp"
+#include "triple-buffer.hpp"
+
+/**
+ * @file mix-engine.hpp
+ * @brief Device-independent track rendering and mixing pipeline
+ */
+
+/**
+ * @class MixEngine
+ * @brief Renders all tracks and mixes them into a stereo output block
+ *
+ * This is the pipeline behind AudioEngineCore::getNextAudioBlock(). It does
+ * not depend on an audio device, so the same code drives live playback and
+ * the offline renderer.
+ *
+ * Tracks and the tempo map are published lock-free through a
+ * TrackListPublisher. Sessions with many tracks are rendered in parallel on a
+ * RenderWorkerPool, then mixed in track order on the calling thread.
+ *
+ * Tracks render dry, in mono or stereo. Each track's ChannelStrip turns its
+ * volume, pan and mute into smoothed gain ramps, applied by a fused kernel
+ * that accumulates the track into the stereo bus in one pass. Serially, the
+ * kernel applies the fader too; in parallel, workers apply the fader and the
+ * mix only pans, with the same result bit for bit. A muted track (fader
+ * settled at 0) is still rendered, so that it continues seamlessly when
+ * unmuted, but not mixed.
+ *
+ * Tracks go to the master or to submix buses (MixGraph), which sum them
+ * with other buses and sends, run an insert chain of effects, and go to
+ * the master or another bus through their own fader and pan. The graph is
+ * compiled into a MixPlan published with the track list: tracks are summed
+ * into their buses in track order, then buses run level by level (on the
+ * worker pool when several insert chains can run side by side), each
+ * pulling its inputs in plan order, and the master pulls its buses last.
+ * Every sum is done in the same order on any thread, so parallel and
+ * serial mixes are identical. A bus whose inputs are silent is skipped once
+ * the tail of its effects has been played.
+ *
+ * Tracks report which part of each span holds signal (RenderActivity).
+ * Only that range is faded and mixed, and a silent track is neither mixed
+ * nor metered beyond decaying its meter, so idle tracks of a sparse session
+ * (drums between hits, one-shots) cost little more than their render call.
+ *
+ * The playback position is an integer sample count kept by a Transport.
+ * Blocks crossing a tempo or time signature change are rendered in two
+ * spans, so every track receives a BeatContext valid for its whole span.
+ *
+ * Parameter and transport changes arrive through a CommandQueue, drained at
+ * the top of each block. A command due inside the block splits it the same
+ * way, so it applies on its exact sample.
+ *
+ * Each track is metered after its fader, by the pass applying it (the mix,
+ * or the worker that rendered it), and the master bus after the master
+ * gain. Both channels of a stereo track are metered and reported as one
+ * combined reading. Every kMeterIntervalSeconds the levels are published as
+ * a MeterFrame through a TripleBuffer, for one reader thread to poll with
+ * readMeters().
+ *
+ * Tracks selected on an AnalysisTap are copied to it the same way (the left
+ * channel of stereo tracks), for the spectrum and oscilloscope views.
+ *
+ * When an EngineProfiler asks for detailed timing, every renderBlock() call
+ * and the render and mix phases are timed.
+ *
+ * @note process() is real-time safe: no locks, no allocations
+ */
+class MixEngine {
+ public:
+  /**
+   * @brief Interval between two published meter frames: one per display
+   * refresh. Each reading interpolates the true peak around its largest
+   * sample, so readings cost more the more often they are taken.
+   */
+  static constexpr double kMeterIntervalSeconds = 1.0 / 60.0;
+
+  /**
+   * @brief Construct a new MixEngine
+   * @param numRenderThreads Worker threads rendering tracks in parallel with
+   * the calling thread (0 = always render serially)
+   */
+  explicit MixEngine(int numRenderThreads);
+
+  /**
+   * @brief Destructor
+   */
+  ~MixEngine();
+
+  /**
+   * @brief Allocate buffers for the given block size
+   * @param maxBlockSize Maximum number of samples passed to process()
+   * @param sampleRate Sample rate in Hz
+   * @note Must not be called concurrently with process()
+   */
+  void prepare(int maxBlockSize, double sampleRate);
+
+  /**
+   * @brief Render and mix one block of all tracks
+   * @param output Stereo output buffer
+   * @param startSample First sample to write in the output buffer
+   * @param numSamples Number of samples (at most the prepared block size)
+   *
+   * Applies queued commands, then advances the playback position by
+   * numSamples unless the transport is stopped.
+   */
+  void process(juce::AudioBuffer<float>& output, int startSample,
+               int numSamples);
+
+  /** @brief Playback position of the next block in samples */
+  juce::int64 getPosition() const noexcept { return transport.getPosition(); }
+
+  /** @brief Move the playback position (not concurrently with process()) */
+  void setPosition(juce::int64 sample) noexcept {
+    transport.setPosition(sample);
+  }
+
+  /**
+   * @brief Queue a command for process() (control threads, never blocks it)
+   * @return False if the queue is full
+   */
+  bool sendCommand(EngineCommand command);
+
+  /**
+   * @brief Release commands applied by process() (control threads)
+   * @param callback Called with each acknowledged command
+   * @return Number of acknowledgements collected
+   */
+  template <typename Callback>
+  int collectCommandReplies(Callback&& callback) {
+    return commands.collectReplies(std::forward<Callback>(callback));
+  }
+
+  /** @brief True unless a Stop command is in effect (audio thread) */
+  bool isPlaying() const noexcept { return playing; }
+
+  /**
+   * @brief Replace the tempo map (control thread, never blocks process())
+   * @param map The new map, recompiled for the engine sample rate
+   */
+  void setTempoMap(TempoMap map);
+
+  /** @brief Current tempo map (control thread) */
+  std::shared_ptr<const TempoMap> getTempoMap() const;
+
+  /**
+   * @brief Enable or disable level metering (any thread, default enabled)
+   */
+  void setMeteringEnabled(bool shouldMeter) noexcept {
+    meteringEnabled.store(shouldMeter, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Levels published since the previous call (single reader thread)
+   * @return The newest frame, or nullptr if none was published. The frame
+   * stays valid until the next call.
+   */
+  const MeterFrame* readMeters() noexcept {
+    return meterFrames.update() ? &meterFrames.getReadBuffer() : nullptr;
+  }
+
+  /**
+   * @brief Copy tapped tracks to an analysis tap (nullptr to disable)
+   * @note Must not be called concurrently with process()
+   */
+  void setAnalysisTap(AnalysisTap* tap) noexcept { analysisTap = tap; }
+
+  /**
+   * @brief Record detailed timing into a profiler (nullptr to disable)
+   * @note Must not be called concurrently with process()
+   */
+  void setProfiler(EngineProfiler* newProfiler) noexcept { profiler = newProfiler; }
+
+  /**
+   * @brief Play the events of a MIDI input on tracks armed with
+   * receivesMidi (nullptr to disable)
+   *
+   * Each block collects the events which arrived since the previous one
+   * and renders the armed tracks with AudioTrack::renderWithEvents(). While
+   * the transport is stopped, events are played at the start of the block.
+   *
+   * @note Must not be called concurrently with process()
+   */
+  void setMidiInput(MidiInputQueue* input) noexcept { midiInput = input; }
+
+  /** @brief Sample rate given to prepare() (44.1 kHz before) */
+  double getSampleRate() const noexcept { return sampleRate; }
+
+  /** @brief Maximum block size given to prepare() */
+  int getMaxBlockSize() const noexcept { return mixBuffer.getNumSamples(); }
+
+  // Track management (control thread only, never blocks process())
+  size_t addTrack(std::shared_ptr<AudioTrack> track);
+  bool removeTrack(size_t index);
+  std::shared_ptr<AudioTrack> getTrack(size_t index) const;
+  std::vector<std::shared_ptr<AudioTrack>> getTracks() const;
+  size_t getTrackCount() const;
+
+  // Routing (control thread only, never blocks process()). Effects are
+  // prepared here before they are published, see MixGraph for the rules.
+  int addBus(std::shared_ptr<MixBus> bus, int output = MixGraph::kMaster);
+  bool removeBus(int index);
+  std::shared_ptr<MixBus> getBus(int index) const;
+  int getBusCount() const;
+  bool setTrackOutput(size_t track, int output);
+  bool setBusOutput(int bus, int output);
+  int addSend(MixGraph::Source source, int destination,
+              std::shared_ptr<MixSend> send = nullptr);
+  bool removeSend(int index);
+  std::shared_ptr<MixSend> getSend(int index) const;
+  bool setEffects(int bus, std::vector<std::shared_ptr<AudioEffect>> chain);
+  MixGraph getGraph() const;
+
+  /**
+   * @brief Replace the whole routing, e.g. with a clone for an offline
+   * render (control thread)
+   *
+   * Tracks missing from the graph go to the master, extra routes are
+   * dropped.
+   */
+  void setGraph(MixGraph graph);
+
+  /**
+   * @brief Delay of the output behind the transport, from the insert
+   * effects on the way to the master, in samples
+   */
+  int getLatencySamples() const;
+
+  /**
+   * @brief Recompute latency compensation after an effect changed its
+   * latency outside of setEffects() or prepare() (control thread)
+   *
+   * The routing is kept: only the delays of the published plan are
+   * recomputed (MixPlan::compensateLatency()).
+   *
+   * @return True if the compensation changed
+   */
+  bool refreshLatency();
+
+  /** @brief Free track lists retired by add/remove (control thread) */
+  void collectGarbage();
+
+  /** @brief Number of worker threads (excluding the calling thread) */
+  int getRenderThreadCount() const;
+
+  /** @brief Minimum track count for rendering on the worker pool */
+  void setParallelTrackThreshold(int minTracks);
+
+ private:
+  /** @brief Pop new commands and apply those due at the transport position */
+  void applyCommands();
+
+  /** @brief Apply one command (audio thread, between spans) */
+  void applyCommand(const EngineCommand& command);
+
+  /** @brief Fill and publish a meter frame (audio thread) */
+  void publishMeters(const TrackList& trackList);
+
+  /** @brief Render and mix all tracks over a span of the block */
+  void renderSpan(const TrackList& trackList, int offset, int numSamples,
+                  const BeatContext& context);
+
+  /**
+   * @brief Render one track into its scratch buffer and apply its fader
+   * (RenderWorkerPool task)
+   */
+  static void renderTrackTask(void* context, int trackIndex);
+
+  /**
+   * @struct MixTarget
+   * @brief Left and right channel of a bus, at the first sample of the span
+   */
+  struct MixTarget {
+    float* left;
+    float* right;
+  };
+
+  /**
+   * @brief Bus receiving a range of the span: mixBuffer for the master, or
+   * the buffer of a step, cleared on its first input of the span
+   * @param range Part of the span about to be added, extends the activity
+   * of the bus
+   */
+  MixTarget getTarget(const TrackList& trackList, int step, int offset, int numSamples,
+                      RenderActivity range) noexcept;
+
+  /**
+   * @brief Accumulate the active range of a rendered track into its output
+   * and its sends
+   * @param keepPostFader Also store the post-fader signal into buffer, for
+   * taps and sends (false if it is already post-fader)
+   * @param levels Receives the post-fader levels of each channel, for the
+   * meters (unchanged if the track is not audible), or nullptr
+   */
+  void routeTrack(const TrackList& trackList, int trackIndex, juce::AudioBuffer<float>& buffer,
+                  int offset, int numSamples, const StripGains& gains,
+                  bool keepPostFader, SpanLevels* levels) noexcept;
+
+  /**
+   * @brief Accumulate the active range of a rendered track into a bus with
+   * the fused kernel
+   * @param gains Gains over the whole span
+   * @param keepPostFader Also store the post-fader signal into buffer
+   * @param levels Receives the post-fader levels of each channel, or nullptr
+   */
+  void mixTrack(const AudioTrack& track, juce::AudioBuffer<float>& buffer, int offset,
+                const StripGains& gains, bool keepPostFader, SpanLevels* levels,
+                MixTarget target) noexcept;
+
+  /**
+   * @brief Accumulate a range of a stereo or mono signal into a bus
+   * @param input Left and right channel (right may be nullptr), at the
+   * first sample of the span
+   * @param gains Gains over the whole span
+   */
+  static void mixRange(const float* const* input, RenderActivity range,
+                       const StripGains& gains, MixTarget target) noexcept;
+
+  /** @brief Sum the buses level by level, then into mixBuffer */
+  void mixBuses(const TrackList& trackList, int offset, int numSamples);
+
+  /**
+   * @brief Pull the inputs of a bus, run its inserts and advance its gains
+   * and sends
+   */
+  void processBus(const TrackList& trackList, int step, int offset, int numSamples) noexcept;
+
+  /**
+   * @brief Delay what the tracks mixed into a bus (or the master) to line
+   * it up with its slower inputs
+   */
+  void delayTracks(const TrackList& trackList, int step, int offset, int numSamples) noexcept;
+
+  /** @brief Add an input of a bus or the master to its target, through its
+   * compensation if it has one */
+  void pullInput(const TrackList& trackList, const MixPlan::Input& input, int destination,
+                 int offset, int numSamples) noexcept;
+
+  /** @brief processBus() of a step of the running level (RenderWorkerPool task) */
+  static void busTask(void* context, int index);
+
+  /** @brief Prepare the effects of a graph which are not published yet
+   * (control thread) */
+  void prepareEffects(const MixGraph& graph) const;
+
+  /** @brief True if the last span of a track reaches the bus: not muted,
+   * and not silent */
+  static bool isAudible(const AudioTrack& track) noexcept {
+    return !track.strip.isSilent() && !track.activity.isSilent();
+  }
+
+  /**
+   * @brief Meter and tap the post-fader signal of a track
+   * @param levels Levels of each channel over the span, computed by the
+   * fader pass (read if metering and the track is audible)
+   * @param fader Fader gains of the span if buffer still holds the
+   * pre-fader signal (the mix did not store it), or nullptr
+   */
+  void measureTrack(AudioTrack& track, juce::AudioBuffer<float>& buffer, int offset,
+                    int numSamples, const SpanLevels* levels,
+                    const GainRamp* fader) const noexcept;
+
+  /**
+   * @brief Call renderBlock(), keeping its activity and timing it into the
+   * track's histogram
+   * @param events MIDI events of the block (may be null), played if the
+   * track receives MIDI
+   * @return Ticks spent when timed, else 0
+   */
+  static juce::int64 renderTrack(AudioTrack& track, juce::AudioBuffer<float>& buffer,
+                                 int offset, int numSamples,
+                                 const BeatContext& context,
+                                 const MidiEventList* events, bool timed) noexcept;
+
+  // Sample-accurate playback position
+  Transport transport;
+  double sampleRate;
+  float masterVolume;
+
+  // Transport state, changed by Play/Stop commands (audio thread)
+  bool playing = true;
+
+  // Commands from control threads, and those not due yet (audio thread,
+  // preallocated to the queue capacity)
+  CommandQueue commands;
+  std::vector<EngineCommand> pendingCommands;
+  size_t numPendingCommands = 0;
+
+  // Pre-allocated buffers for audio processing (avoid allocations in audio thread)
+  juce::AudioBuffer<float> mixBuffer;  // Stereo mix buffer
+  juce::AudioBuffer<float> trackBuffer;  // Stereo buffer for individual track rendering
+
+  // Length of the track gain ramps at the current sample rate
+  int smoothingSamples = 0;
+
+  // Track list published to the audio thread with an atomic pointer swap
+  TrackListPublisher tracks;
+
+  // Worker threads for parallel track rendering (null when disabled)
+  std::unique_ptr<RenderWorkerPool> renderPool;
+
+  // Below this many tracks, waking workers costs more than it saves
+  std::atomic<int> parallelTrackThreshold{8};
+
+  // Span currently rendered by the worker pool (process() only)
+  const TrackList* renderingList = nullptr;
+  int renderingOffset = 0;
+  int renderingNumSamples = 0;
+  const BeatContext* renderingContext = nullptr;
+  const MidiEventList* renderingEvents = nullptr;
+  int renderingLevelBegin = 0;
+
+  // Level metering: enabled flag sampled once per block, RMS coefficient of
+  // the current span
+  std::atomic<bool> meteringEnabled{true};
+  bool metering = false;
+  float meterCoefficient = 0.0f;
+  ChannelMeter masterMeters[2];
+  TripleBuffer<MeterFrame> meterFrames;
+  int meterIntervalSamples = 0;
+  int samplesSinceMeterFrame = 0;
+
+  // Track analysis: tap (may be null) and whether any track is tapped,
+  // sampled once per block
+  AnalysisTap* analysisTap = nullptr;
+  bool tappingTracks = false;
+
+  // Detailed timing: profiler (may be null), enabled flag sampled once per
+  // block, and ticks spent rendering tracks in the current block
+  EngineProfiler* profiler = nullptr;
+  bool timing = false;
+  juce::int64 renderTicks = 0;
+
+  // MIDI input (may be null) and its events in the current block,
+  // preallocated
+  MidiInputQueue* midiInput = nullptr;
+  MidiEventList blockEvents;
+
+  JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MixEngine)
+};
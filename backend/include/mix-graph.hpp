@@ -0,0 +1,471 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <memory>
+#include <vector>
+#include "audio-effect.hpp"
+#include "audio-track.hpp"
+#include "channel-strip.hpp"
+
+/**
+ * @file mix-graph.hpp
+ * @brief Routing of tracks through submix buses, sends and insert effects
+ */
+
+/**
+ * @class MixBus
+ * @brief Submix bus: sums tracks and other buses, runs its insert chain and
+ * goes through its own fader and pan to its output
+ *
+ * Like an AudioTrack, a bus is shared by consecutive compiled plans and
+ * holds the mixer state the audio thread keeps between blocks, so that
+ * editing the routing does not restart its gains. Where the bus is routed
+ * and which effects it runs belong to the MixGraph.
+ */
+class MixBus {
+ public:
+  /**
+   * @brief Construct a bus at unity gain, centred
+   * @param name Display name
+   */
+  explicit MixBus(juce::String name = {});
+
+  /** @brief Set the volume (clamped to [0, 1]) */
+  void setVolume(float newVolume);
+
+  /** @brief Set the pan (clamped to [-1, 1]), or balance of stereo inputs */
+  void setPan(float newPan);
+
+  /** @brief Mute or unmute the bus output */
+  void setMute(bool shouldMute) { mute = shouldMute; }
+
+  /** @brief Display name */
+  juce::String name;
+
+  float volume = 1.0f;
+  float pan = 0.0f;
+  bool mute = false;
+
+  /** @brief Smoothed volume, pan and mute, applied where the bus is mixed */
+  ChannelStrip strip;
+
+  /**
+   * @brief Range of the current span holding signal (audio thread)
+   *
+   * Covers what was summed so far while inputs arrive, then the output of
+   * the insert chain.
+   */
+  RenderActivity activity;
+
+  /** @brief Samples of effect tail left to process (audio thread) */
+  int tailRemaining = 0;
+};
+
+/**
+ * @class MixSend
+ * @brief Level of a send: a copy of a track or bus into another bus
+ *
+ * Sends are post-fader: they tap the source after its volume and mute, but
+ * before its pan (stereo sources keep their balance). The level is smoothed
+ * like a fader.
+ */
+class MixSend {
+ public:
+  /** @brief Construct a send at a level (clamped to [0, 1]) */
+  explicit MixSend(float level = 1.0f);
+
+  /** @brief Set the level (clamped to [0, 1]) */
+  void setLevel(float newLevel);
+
+  float level;
+
+  /** @brief Smoothed level (fader only, centred), advanced every span */
+  ChannelStrip strip;
+};
+
+/**
+ * @class CompensationDelay
+ * @brief Fixed stereo delay lining up a path of the mix with slower ones
+ *
+ * The line is a ring of delaySamples samples: each span reads its delayed
+ * output at the ring position, then writes its input there, so a span
+ * costs its own length whatever the delay. Input and output are separate
+ * buffers of one span, contiguous for the mix. Its activity is tracked
+ * like a track's, and a line holding only zeros is skipped.
+ *
+ * Lines are allocated by the TrackListPublisher for the paths of a plan,
+ * and kept across plans while the delay of their path does not change.
+ */
+class CompensationDelay {
+ public:
+  /**
+   * @brief Allocate a line
+   * @param delaySamples Delay (positive)
+   * @param maxBlockSize Longest span
+   */
+  CompensationDelay(int delaySamples, int maxBlockSize);
+
+  int getDelaySamples() const noexcept { return delaySamples; }
+  int getMaxBlockSize() const noexcept { return maxBlockSize; }
+
+  /** @brief True if the delayed output is all zeros until more input */
+  bool isSilent() const noexcept { return heldSamples == 0; }
+
+  /**
+   * @brief Start a span
+   * @return Left and right channel to add the span's input to, cleared
+   */
+  float* const* beginSpan(int numSamples) noexcept;
+
+  /**
+   * @brief Finish the span started by beginSpan()
+   * @param input Range of the input holding signal
+   * @return Range of getOutput() holding signal
+   */
+  RenderActivity endSpan(RenderActivity input, int numSamples) noexcept;
+
+  /** @brief Delayed output of the span (after endSpan()) */
+  const float* const* getOutput() const noexcept { return output; }
+
+ private:
+  int delaySamples;
+  int maxBlockSize;
+
+  // delaySamples samples per channel, read then written at position
+  std::vector<float> rings[2];
+  int position = 0;
+
+  // maxBlockSize samples per channel
+  std::vector<float> inputs[2];
+  std::vector<float> outputs[2];
+  float* input[2];
+  float* output[2];
+
+  int heldSamples = 0;
+};
+
+/**
+ * @struct MixPlan
+ * @brief Immutable, compiled form of a MixGraph, executed by the MixEngine
+ *
+ * Buses are listed as steps in dependency order: every bus comes after all
+ * the buses feeding it. Steps are grouped into levels, whose buses only
+ * read tracks and earlier levels, so those of one level can run in
+ * parallel. Each step knows its inputs in a fixed order, which keeps the
+ * sums identical whatever thread runs them.
+ *
+ * Buses whose lifetimes do not overlap share a scratch buffer: a bus buffer
+ * is needed from the first write (the track phase, or its level) until the
+ * last level reading it.
+ *
+ * Latency is compensated: every path into a bus, or the master, is delayed
+ * to arrive with the slowest one. Tracks are sources without latency; a bus
+ * adds the latency of its insert chain to that of its inputs. The delays
+ * are listed as compensations, whose lines the TrackListPublisher assigns.
+ *
+ * The plan holds raw pointers for the audio thread, kept alive by owning
+ * pointers of its own.
+ */
+struct MixPlan {
+  /** @brief Destination of a step or track: the master bus */
+  static constexpr int kMaster = -1;
+
+  /**
+   * @struct Input
+   * @brief A bus mixed into a step: its output, or a send from it
+   */
+  struct Input {
+    /** @brief Step of the source bus (earlier level) */
+    int source = 0;
+
+    /** @brief Send level, or nullptr for the direct output of the source */
+    MixSend* send = nullptr;
+
+    /** @brief Compensation delaying the input, or -1 */
+    int delay = -1;
+  };
+
+  /**
+   * @struct Send
+   * @brief A send from a track or a bus to a step (or the master)
+   */
+  struct Send {
+    int destination = kMaster;
+    MixSend* send = nullptr;
+  };
+
+  /**
+   * @struct TrackRoute
+   * @brief Where a track goes: its output and its sends
+   */
+  struct TrackRoute {
+    int output = kMaster;
+    int firstSend = 0;
+    int numSends = 0;
+  };
+
+  /**
+   * @struct Step
+   * @brief One bus: pull its inputs, run its inserts, advance its gains
+   */
+  struct Step {
+    MixBus* bus = nullptr;
+    int buffer = 0;
+
+    /** @brief Range in inputs, pulled in this order */
+    int firstInput = 0;
+    int numInputs = 0;
+
+    /** @brief Range in effects (the insert chain) */
+    int firstEffect = 0;
+    int numEffects = 0;
+
+    /** @brief Sends from this bus, in busSends (advanced with the bus) */
+    int firstSend = 0;
+    int numSends = 0;
+
+    /** @brief Samples processed after the input falls silent */
+    int tailSamples = 0;
+
+    /** @brief Compensation delaying what the tracks mixed in, or -1 */
+    int trackDelay = -1;
+
+    /** @brief Latency of the bus output: its inputs, then its inserts */
+    int latency = 0;
+  };
+
+  /**
+   * @struct Level
+   * @brief Range of steps independent of each other
+   */
+  struct Level {
+    int begin = 0;
+    int end = 0;
+
+    /** @brief Worth running on the worker pool (two or more insert chains) */
+    bool parallel = false;
+  };
+
+  /**
+   * @struct Compensation
+   * @brief A delayed path, identifying its line from one plan to the next
+   */
+  struct Compensation {
+    /** @brief Bus or send feeding the path; for the tracks mixed into a
+     * bus, that bus (nullptr: the master) */
+    const void* path = nullptr;
+    bool tracks = false;
+    int samples = 0;
+
+    bool operator==(const Compensation& other) const noexcept {
+      return path == other.path && tracks == other.tracks && samples == other.samples;
+    }
+  };
+
+  /** @brief Route of every track, in track order */
+  std::vector<TrackRoute> tracks;
+  std::vector<Send> trackSends;
+
+  /** @brief Buses in dependency order, grouped by levels */
+  std::vector<Step> steps;
+  std::vector<Level> levels;
+
+  /** @brief Inputs of the steps, then those of the master */
+  std::vector<Input> inputs;
+  int firstMasterInput = 0;
+  int numMasterInputs = 0;
+
+  /** @brief Sends leaving the steps (their levels advance with the bus) */
+  std::vector<MixSend*> busSends;
+
+  /** @brief Insert chains of the steps, then that of the master */
+  std::vector<AudioEffect*> effects;
+  int firstMasterEffect = 0;
+  int numMasterEffects = 0;
+
+  /** @brief Number of stereo bus buffers used by the steps */
+  int numBuffers = 0;
+
+  /** @brief Delayed paths: the steps' and inputs' delays index them */
+  std::vector<Compensation> compensations;
+  int masterTrackDelay = -1;
+
+  /** @brief Latency of the master output, in samples */
+  int latency = 0;
+
+  // Objects the pointers above refer to
+  std::vector<std::shared_ptr<MixBus>> ownedBuses;
+  std::vector<std::shared_ptr<MixSend>> ownedSends;
+  std::vector<std::shared_ptr<AudioEffect>> ownedEffects;
+
+  /**
+   * @brief Recompute the latencies and compensations from the latency the
+   * insert effects report now; the routing is left as it is
+   */
+  void compensateLatency();
+};
+
+/**
+ * @class MixGraph
+ * @brief Editable description of the routing: buses, outputs, sends and
+ * insert chains
+ *
+ * Every track and bus has one output, the master or a bus, and any number
+ * of sends to other buses. Edits which would make a bus feed itself,
+ * directly or through other buses, are rejected, so the graph always
+ * compiles.
+ *
+ * The graph is a value: the TrackListPublisher keeps the current one,
+ * edits a copy and publishes its compiled MixPlan with the tracks.
+ * Buses, sends and effects are shared between copies; clone() makes an
+ * independent graph for an offline render.
+ */
+class MixGraph {
+ public:
+  /** @brief Output or send destination: the master bus */
+  static constexpr int kMaster = MixPlan::kMaster;
+
+  /**
+   * @struct Source
+   * @brief Origin of a send: a track or a bus
+   */
+  struct Source {
+    bool isBus = false;
+    int index = 0;
+
+    static Source track(int index) noexcept { return {false, index}; }
+    static Source bus(int index) noexcept { return {true, index}; }
+  };
+
+  /**
+   * @struct Bus
+   * @brief A bus, where it goes and its insert chain
+   */
+  struct Bus {
+    std::shared_ptr<MixBus> bus;
+    int output = kMaster;
+    std::vector<std::shared_ptr<AudioEffect>> effects;
+  };
+
+  /**
+   * @struct Send
+   * @brief A send from a track or bus to a bus
+   */
+  struct Send {
+    Source source;
+    int destination = 0;
+    std::shared_ptr<MixSend> send;
+  };
+
+  /**
+   * @brief Add a bus
+   * @param bus The bus (a new one if null)
+   * @param output Bus it goes to, or kMaster
+   * @return Index of the bus, or -1 if the output does not exist
+   */
+  int addBus(std::shared_ptr<MixBus> bus, int output = kMaster);
+
+  /**
+   * @brief Remove a bus and its sends
+   *
+   * Tracks and buses going to it go to the master instead, and higher bus
+   * indices move down by one.
+   */
+  bool removeBus(int index);
+
+  /**
+   * @brief Route a bus to another bus or the master
+   * @return False if either bus does not exist or the route makes a loop
+   */
+  bool setBusOutput(int index, int output);
+
+  /**
+   * @brief Route a track to a bus or the master
+   * @return False if the track or the bus does not exist
+   */
+  bool setTrackOutput(int track, int output);
+
+  /**
+   * @brief Add a send
+   * @param source Track or bus sent
+   * @param destination Bus receiving the send
+   * @param send The level (a new one at unity if null)
+   * @return Index of the send, or -1 if an end does not exist or the send
+   * makes a loop
+   */
+  int addSend(Source source, int destination, std::shared_ptr<MixSend> send);
+
+  /** @brief Remove a send */
+  bool removeSend(int index);
+
+  /**
+   * @brief Replace the insert chain of a bus, or of the master (kMaster)
+   * @return False if the bus does not exist
+   */
+  bool setEffects(int index, std::vector<std::shared_ptr<AudioEffect>> chain);
+
+  /** @brief Insert chain of a bus or of the master (empty if none) */
+  const std::vector<std::shared_ptr<AudioEffect>>& getEffects(int index) const;
+
+  /** @brief A track was appended: route it to the master */
+  void addTrack() { trackOutputs.push_back(kMaster); }
+
+  /** @brief A track was removed: drop its route and sends */
+  void removeTrack(int index);
+
+  /** @brief Keep numTracks routes, new tracks going to the master */
+  void resizeTracks(int numTracks);
+
+  int getNumBuses() const noexcept { return (int)buses.size(); }
+  int getNumTracks() const noexcept { return (int)trackOutputs.size(); }
+  const std::vector<Bus>& getBuses() const noexcept { return buses; }
+  const std::vector<Send>& getSends() const noexcept { return sends; }
+
+  /** @brief Output of a track (kMaster if out of range) */
+  int getTrackOutput(int track) const noexcept;
+
+  /** @brief True if the effect is in an insert chain of the graph */
+  bool containsEffect(const AudioEffect* effect) const noexcept;
+
+  /** @brief Call function with every effect of the graph */
+  template <typename Function>
+  void forEachEffect(Function&& function) const {
+    for (const auto& bus : buses) {
+      for (const auto& effect : bus.effects) {
+        function(*effect);
+      }
+    }
+    for (const auto& effect : masterEffects) {
+      function(*effect);
+    }
+  }
+
+  /**
+   * @brief Independent copy: new buses, sends and effects with the same
+   * settings (effects must be prepared before use)
+   */
+  MixGraph clone() const;
+
+  /** @brief Compile the plan executed by the MixEngine */
+  std::shared_ptr<const MixPlan> compile() const;
+
+ private:
+  /** @brief True if no bus feeds itself */
+  bool isAcyclic() const;
+
+  /**
+   * @brief Order buses so that each comes after its inputs
+   * @param levels Receives the level of each bus (1 for buses fed by tracks
+   * only)
+   * @return Bus indices, fewer than the buses if there is a loop
+   */
+  std::vector<int> sortBuses(std::vector<int>& levels) const;
+
+  bool isBus(int index) const noexcept {
+    return index >= 0 && index < (int)buses.size();
+  }
+
+  std::vector<Bus> buses;
+  std::vector<int> trackOutputs;
+  std::vector<Send> sends;
+  std::vector<std::shared_ptr<AudioEffect>> masterEffects;
+};
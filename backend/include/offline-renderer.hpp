@@ -0,0 +1,107 @@
+#pragma once
+
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_core/juce_core.h>
+#include <memory>
+#include <vector>
+#include "audio-track.hpp"
+#include "mix-graph.hpp"
+#include "render-worker-pool.hpp"
+#include "tempo-map.hpp"
+
+/**
+ * @file offline-renderer.hpp
+ * @brief Faster-than-realtime bounce of a session to an audio file
+ */
+
+/**
+ * @class OfflineRenderer
+ * @brief Drives the MixEngine pipeline in a tight loop and writes the result
+ *
+ * No audio device is involved: blocks are rendered as fast as the CPU
+ * allows, with large blocks and the parallel worker pool, and written to a
+ * WAV or FLAC file through juce_audio_formats.
+ *
+ * The sample rate comes from the settings, not from the audio device: a
+ * render may run before the device opens, or at another rate. Tracks follow
+ * the rate of the BeatContext they render.
+ */
+class OfflineRenderer {
+ public:
+  /**
+   * @struct Settings
+   * @brief Parameters of an offline render
+   */
+  struct Settings {
+    /** @brief Destination file, format chosen from the extension (.wav/.flac) */
+    juce::File outputFile;
+
+    /** @brief Session position of the first rendered sample in seconds */
+    double startSeconds = 0.0;
+
+    /** @brief Sample rate of the render and of the file in Hz */
+    double sampleRate = 44100.0;
+
+    /** @brief Length of the render in seconds */
+    double durationSeconds = 10.0;
+
+    /** @brief Samples per block (larger blocks amortise per-block costs) */
+    int blockSize = 4096;
+
+    /** @brief Output bit depth (16/24, or 32 float for WAV) */
+    int bitDepth = 24;
+
+    /** @brief Worker threads in addition to the rendering thread */
+    int numRenderThreads = RenderWorkerPool::getDefaultThreadCount();
+
+    /** @brief Tempo and time signatures the tracks follow */
+    TempoMap tempoMap;
+
+    /**
+     * @brief Buses, sends and effects the tracks go through (default: every
+     * track to the master)
+     *
+     * Used as is: give a MixGraph::clone() of a live graph, so the render
+     * does not process the effects of the audio thread. The latency of its
+     * effects is rendered ahead and dropped, so the file starts on time.
+     */
+    MixGraph routing;
+  };
+
+  /**
+   * @struct Result
+   * @brief Outcome and statistics of an offline render
+   */
+  struct Result {
+    /** @brief True if the whole file was written */
+    bool success = false;
+
+    /** @brief Reason of the failure (empty on success) */
+    juce::String errorMessage;
+
+    /** @brief Number of sample frames written */
+    juce::int64 numSamples = 0;
+
+    /** @brief Wall-clock duration of the render in seconds */
+    double renderSeconds = 0.0;
+
+    /** @brief Rendered audio duration divided by wall-clock duration */
+    double realtimeFactor = 0.0;
+  };
+
+  /**
+   * @brief Render tracks to a file
+   * @param tracks Tracks to mix (must not be rendered by another thread
+   * during the call, see AudioTrack::clone())
+   * @param settings Render parameters
+   * @return Result of the render
+   */
+  static Result render(const std::vector<std::shared_ptr<AudioTrack>>& tracks,
+                       const Settings& settings);
+
+ private:
+  /** @brief Create a writer for the file extension, or report an error
+   * (no file is left behind) */
+  static std::unique_ptr<juce::AudioFormatWriter> createWriter(
+      const Settings& settings, double sampleRate, juce::String& error);
+};
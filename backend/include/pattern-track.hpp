@@ -0,0 +1,275 @@
+#pragma once
+#include <array>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "spsc-queue.hpp"
+#include "synth-track.hpp"
+#include "tempo-map.hpp"
+
+/**
+ * @file pattern-track.hpp
+ * @brief Step sequencer track playing a pattern compiled to samples
+ */
+
+/**
+ * @struct PatternStep
+ * @brief One step of a pattern
+ */
+struct PatternStep {
+  /** @brief MIDI note number, 0 to 127 */
+  int note = 60;
+
+  /** @brief Gain of the note, 0 to 1 (0: rest) */
+  float velocity = 0.8f;
+
+  /** @brief Duration of the note, in steps (may span the next steps) */
+  double length = 1.0;
+
+  /** @brief Delay of the note, as a fraction of a step */
+  double swing = 0.0;
+};
+
+/**
+ * @struct Pattern
+ * @brief Steps played in a loop from a beat position, forever
+ */
+struct Pattern {
+  /** @brief Largest number of steps */
+  static constexpr int kMaxSteps = 256;
+
+  /** @brief Largest delay of a step, in steps (swing and step swing) */
+  static constexpr double kMaxSwing = 0.75;
+
+  /** @brief Steps of one loop (at most kMaxSteps) */
+  std::vector<PatternStep> steps;
+
+  /** @brief Duration of a step in beats (0.25: sixteenth notes) */
+  double stepBeats = 0.25;
+
+  /** @brief Delay of every odd step, as a fraction of a step (1/3: triplet
+   * feel), added to the step's own swing */
+  double swing = 0.0;
+
+  /** @brief Beat position of the first step */
+  double startBeat = 0.0;
+};
+
+/**
+ * @struct PatternTimeline
+ * @brief One cycle of a pattern, placed on the samples of a tempo map
+ *
+ * The notes of one cycle are kept in beats from the start of the cycle,
+ * which repeats every cycleBeats from firstBeat. A Cursor names a note of
+ * a cycle; its samples come from the copy of the tempo map the timeline was
+ * compiled with, so tempo changes during the pattern are followed.
+ *
+ * Compiled on a control thread and immutable afterwards: the audio thread
+ * only walks it with a cursor, which wraps to the next cycle after the
+ * last note.
+ */
+struct PatternTimeline {
+  /**
+   * @struct Note
+   * @brief A note of the cycle, in beats
+   */
+  struct Note {
+    /** @brief Start from the start of the cycle (swing included) */
+    double beat = 0.0;
+    double length = 0.0;
+    int note = 60;
+    float velocity = 0.0f;
+  };
+
+  /**
+   * @struct Cursor
+   * @brief A note of one cycle: notes[index] in cycle number cycle
+   */
+  struct Cursor {
+    juce::int64 cycle = 0;
+    size_t index = 0;
+
+    bool operator==(const Cursor& other) const noexcept {
+      return cycle == other.cycle && index == other.index;
+    }
+  };
+
+  /** @brief Notes of one cycle, ordered by beat */
+  std::vector<Note> notes;
+
+  /** @brief Beat position of the first cycle, and length of a cycle */
+  double firstBeat = 0.0;
+  double cycleBeats = 0.0;
+
+  /** @brief Copy of the map the samples are computed with */
+  TempoMap map;
+
+  /** @brief TempoMap::getId() of that map */
+  juce::uint32 tempoMapId = 0;
+
+  /**
+   * @brief Compile one cycle of a pattern for a tempo map
+   *
+   * Rests (velocity 0) are left out.
+   */
+  static std::shared_ptr<const PatternTimeline> compile(const Pattern& pattern,
+                                                        const TempoMap& map);
+
+  /**
+   * @brief First sample of a note: the first reaching its beat position,
+   * like the beats of a BeatTrack
+   */
+  juce::int64 getStart(Cursor cursor) const noexcept;
+
+  /** @brief Sample a note ends on, at least one after its start */
+  juce::int64 getEnd(Cursor cursor) const noexcept;
+
+  /** @brief The note after another, in the next cycle after the last one */
+  Cursor getNext(Cursor cursor) const noexcept;
+
+  /**
+   * @brief First note starting at or after a sample (O(log n))
+   * @note The timeline must hold notes
+   */
+  Cursor findFirst(juce::int64 sample) const noexcept;
+
+ private:
+  double getBeat(Cursor cursor) const noexcept;
+};
+
+/**
+ * @class PatternTrack
+ * @brief SynthTrack playing a step pattern, compiled to a sample timeline
+ *
+ * One cycle of the pattern is compiled on the control thread against the
+ * session tempo map into a PatternTimeline. Rendering keeps a cursor on the
+ * next note, and the sample it starts on: a block only compares its end to
+ * that sample and to the next note-off, then splits its render at those
+ * samples. After the last note of a cycle the cursor wraps to the first
+ * one of the next. It moves by binary search only after a seek or a new
+ * timeline.
+ *
+ * Edits never interrupt playback. setPattern() compiles the new timeline
+ * and hands it over through a lock-free queue; the audio thread swaps it
+ * in at the start of its next block and returns the old one through a
+ * second queue, so timelines are only freed on control threads. Note-offs
+ * of sounding notes are kept by the track, not read from the timeline: a
+ * note started by the old timeline still ends on its sample.
+ *
+ * A seek (or a block not following the previous one) releases the
+ * sounding notes; notes which started before the new position are not
+ * restarted. The timeline is recompiled when the MixEngine publishes
+ * another tempo map (see AudioTrack::tempoMapChanged()).
+ *
+ * Voices, envelopes and live notes (noteOn(), MIDI input) come from
+ * SynthTrack.
+ */
+class PatternTrack : public SynthTrack {
+ public:
+  /** @brief Default size of the voice pool */
+  static constexpr int kDefaultVoices = 32;
+
+  /** @brief Timeline swaps waiting for the audio thread */
+  static constexpr int kMaxPendingTimelines = 8;
+
+  /**
+   * @brief Construct a track without a pattern
+   * @param maxVoices Size of the voice pool (see SynthTrack)
+   * @param waveform Oscillator waveform of every voice
+   */
+  explicit PatternTrack(int maxVoices = kDefaultVoices,
+                        WaveTable::WaveType waveform = WaveTable::WaveType::SAW);
+
+  ~PatternTrack() override;
+
+  /**
+   * @brief Play the notes due on a sample, then render it
+   * @param context Position and tempo of the sample
+   */
+  float getSampleValue(const BeatContext& context) override;
+
+  /**
+   * @brief Render a block, starting and ending the notes of the timeline on
+   * their sample
+   * @return Activity of the voices, as for SynthTrack
+   */
+  RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                             int numSamples, const BeatContext& context) override;
+
+  /** @brief Copy with the same pattern and timeline, without voices */
+  std::unique_ptr<AudioTrack> clone() const override;
+
+  /** @brief Recompile the pattern for another tempo map (control thread) */
+  void tempoMapChanged(const TempoMap& map) override;
+
+  /**
+   * @brief Replace the pattern (control threads)
+   * @param newPattern Steps, clamped to the limits of Pattern
+   * @param map Tempo map of the session
+   * @return False if kMaxPendingTimelines edits are still waiting for the
+   * audio thread (the pattern is unchanged)
+   */
+  bool setPattern(Pattern newPattern, const TempoMap& map);
+
+  /** @brief Current pattern (control threads) */
+  Pattern getPattern() const;
+
+  /** @brief Timeline of the current pattern (control threads) */
+  std::shared_ptr<const PatternTimeline> getTimeline() const;
+
+ private:
+  /** @brief Copy for clone(): settings and timeline only, not the render
+   * state of other */
+  PatternTrack(const PatternTrack& other);
+
+  /** @brief Queue a timeline for the audio thread (control mutex held) */
+  bool publish(std::shared_ptr<const PatternTimeline> compiled);
+
+  /** @brief Free timelines returned by the audio thread (control mutex held) */
+  void collectRetired();
+
+  /** @brief Take a new timeline, move the cursor after a seek (audio thread) */
+  void sync(juce::int64 position) noexcept;
+
+  /** @brief End and start the notes due on a sample (audio thread) */
+  void playDue(juce::int64 position) noexcept;
+
+  /** @brief Start the note at the cursor, ending the same note first */
+  void startNote(const PatternTimeline::Note& note, juce::int64 end) noexcept;
+
+  /** @brief End the notes whose end sample is reached */
+  void releaseDue(juce::int64 position) noexcept;
+
+  /** @brief End every note started by the timeline */
+  void releaseAll() noexcept;
+
+  /** @brief Sample of the next note-on or note-off */
+  juce::int64 getNextEvent() const noexcept;
+
+  static constexpr juce::int64 kNever = std::numeric_limits<juce::int64>::max();
+
+  // Control side, serialised by the mutex: pattern, its latest timeline,
+  // and swaps not returned by the audio thread yet
+  mutable std::mutex controlMutex;
+  Pattern pattern;
+  std::shared_ptr<const PatternTimeline> latest;
+  int inFlight = 0;
+
+  // New timelines in, replaced ones out (see CommandQueue)
+  SpscQueue<std::shared_ptr<const PatternTimeline>> incoming{kMaxPendingTimelines};
+  SpscQueue<std::shared_ptr<const PatternTimeline>> retired{kMaxPendingTimelines};
+
+  // Render state: timeline played, next note and its start (kNever without
+  // notes), sample after the last block
+  std::shared_ptr<const PatternTimeline> timeline;
+  PatternTimeline::Cursor cursor;
+  juce::int64 cursorStart = kNever;
+  juce::int64 nextSample = -1;
+
+  /** @brief End sample of each sounding note of the timeline (kNever: off) */
+  std::array<juce::int64, 128> noteEnds;
+
+  /** @brief Earliest of noteEnds (may be early after a retrigger) */
+  juce::int64 nextNoteEnd = kNever;
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @file realtime-guard.hpp
+ * @brief Detection of allocations, locks and blocking calls on the audio thread
+ */
+
+#ifndef DAW_REALTIME_GUARD
+#define DAW_REALTIME_GUARD 0
+#endif
+
+/**
+ * @class RealtimeGuard
+ * @brief Flags calls the audio thread must never make
+ *
+ * Code running inside a Scope (the audio callback, and render workers
+ * helping it) must not allocate, free, lock or block. Built with
+ * -DENABLE_REALTIME_GUARD=ON, the engine replaces operator new/delete and,
+ * on Linux, interposes malloc/free, mutex and rwlock locking, semaphore
+ * waits, sleeps and thread joins. Each such call made inside a
+ * Scope is a violation: it is counted, and reported with a stack trace or
+ * aborts the process depending on the mode.
+ *
+ * The mode comes from the DAW_REALTIME_GUARD_MODE environment variable
+ * ("report", "abort" or "count"; ctest runs with "abort") and can be
+ * changed with setMode().
+ *
+ * Without the option, scopes compile to nothing and no function is
+ * intercepted.
+ */
+class RealtimeGuard {
+ public:
+  /** @brief True when the guard is built in */
+  static constexpr bool kEnabled = DAW_REALTIME_GUARD != 0;
+
+  /**
+   * @enum Mode
+   * @brief What happens on a violation
+   */
+  enum class Mode {
+    Report, /**< Print the call and a stack trace to stderr, continue */
+    Abort,  /**< Print, then abort (tests) */
+    Count   /**< Only count (tests provoking violations on purpose) */
+  };
+
+  /**
+   * @class Scope
+   * @brief Marks the current thread as real-time while it exists
+   *
+   * Scopes nest; an inactive scope does nothing, which lets worker threads
+   * inherit the state of the thread they help.
+   */
+  class Scope {
+   public:
+    explicit Scope(bool active = true) noexcept : active(kEnabled && active) {
+      if (this->active) {
+        enter();
+      }
+    }
+
+    ~Scope() {
+      if (active) {
+        leave();
+      }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    bool active;
+  };
+
+  /**
+   * @class AllowScope
+   * @brief Permits blocking calls inside a Scope, e.g. a deliberate log line
+   */
+  class AllowScope {
+   public:
+    AllowScope() noexcept {
+      if (kEnabled) {
+        suspend();
+      }
+    }
+
+    ~AllowScope() {
+      if (kEnabled) {
+        resume();
+      }
+    }
+
+    AllowScope(const AllowScope&) = delete;
+    AllowScope& operator=(const AllowScope&) = delete;
+  };
+
+  /** @brief True inside a Scope (and outside any AllowScope) */
+  static bool isRealtimeThread() noexcept;
+
+  static void setMode(Mode mode) noexcept;
+  static Mode getMode() noexcept;
+
+  /** @brief Violations since the start, on all threads */
+  static std::uint64_t getViolationCount() noexcept;
+
+  /**
+   * @brief Record a violation if the current thread is real-time
+   * @param function Name of the intercepted call
+   */
+  static void check(const char* function) noexcept;
+
+ private:
+  static void enter() noexcept;
+  static void leave() noexcept;
+  static void suspend() noexcept;
+  static void resume() noexcept;
+};
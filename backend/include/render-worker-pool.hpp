@@ -0,0 +1,150 @@
+#pragma once
+
+#include <semaphore.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/**
+ * @file render-worker-pool.hpp
+ * @brief Real-time safe worker pool used to render tracks in parallel
+ */
+
+/**
+ * @class WorkStealingDeque
+ * @brief Fixed-capacity Chase-Lev deque of task indices
+ *
+ * The owner pops from the bottom, other workers steal from the top. Tasks
+ * are only pushed while no worker is running (between two blocks), so the
+ * deque never grows and never allocates after construction.
+ */
+class WorkStealingDeque {
+ public:
+  /**
+   * @brief Construct a deque able to hold capacity tasks
+   * @param capacity Maximum number of tasks pushed between two resets
+   */
+  explicit WorkStealingDeque(int capacity);
+
+  /** @brief Remove all tasks (no worker may be running) */
+  void reset() noexcept;
+
+  /**
+   * @brief Push a task at the bottom (no worker may be running)
+   * @return False if the deque is full
+   */
+  bool push(int task) noexcept;
+
+  /**
+   * @brief Pop a task from the bottom (owner only)
+   * @return The task index, or -1 if the deque is empty
+   */
+  int pop() noexcept;
+
+  /**
+   * @brief Steal a task from the top (any thread)
+   * @return The task index, or -1 if the deque is empty or the race was lost
+   */
+  int steal() noexcept;
+
+ private:
+  std::vector<int> tasks;
+  alignas(64) std::atomic<int64_t> top{0};
+  alignas(64) std::atomic<int64_t> bottom{0};
+};
+
+/**
+ * @class RenderWorkerPool
+ * @brief Pre-spawned worker threads executing one batch of tasks per block
+ *
+ * run() distributes task indices round-robin over one deque per participant
+ * (the calling thread is participant 0), wakes the workers and helps until
+ * every task is done. Idle participants steal from the others, which
+ * balances tracks of uneven cost.
+ *
+ * Nothing is allocated and no mutex is taken by run(). Workers sleep on a
+ * POSIX semaphore between blocks; a worker that has not woken up by the end
+ * of the block is cancelled instead of waited for, so a descheduled worker
+ * never delays the audio callback. Workers run the tasks of a batch as
+ * real-time threads (RealtimeGuard) when run() is called from one.
+ *
+ * @note run() must only be called from one thread at a time
+ */
+class RenderWorkerPool {
+ public:
+  /** @brief Task entry point: a plain function pointer avoids std::function */
+  using TaskFunction = void (*)(void* context, int taskIndex);
+
+  /**
+   * @brief Construct the pool and spawn its threads
+   * @param numWorkers Number of threads in addition to the calling thread
+   * @param maxTasks Maximum number of tasks handed to one run() call;
+   * extra tasks are executed by the calling thread
+   */
+  RenderWorkerPool(int numWorkers, int maxTasks = 4096);
+
+  /**
+   * @brief Stop and join all worker threads
+   */
+  ~RenderWorkerPool();
+
+  RenderWorkerPool(const RenderWorkerPool&) = delete;
+  RenderWorkerPool& operator=(const RenderWorkerPool&) = delete;
+
+  /**
+   * @brief Execute function(context, i) for every i in [0, numTasks)
+   * @param numTasks Number of tasks
+   * @param function Task entry point, called from any participant
+   * @param context Opaque pointer forwarded to the function
+   *
+   * Returns once all tasks have completed.
+   */
+  void run(int numTasks, TaskFunction function, void* context) noexcept;
+
+  /** @brief Number of worker threads (excluding the calling thread) */
+  int getNumWorkers() const noexcept { return (int)workers.size(); }
+
+  /**
+   * @brief Default worker count: one per extra hardware thread
+   */
+  static int getDefaultThreadCount();
+
+ private:
+  enum WorkerState : int { Idle, Pending, Running };
+
+  struct Worker {
+    std::thread thread;
+    sem_t wakeUp;
+    std::atomic<int> state{Idle};
+  };
+
+  /** @brief Worker thread main loop */
+  void workerLoop(int workerIndex);
+
+  /** @brief Execute tasks from the own deque, then steal, until all are done */
+  void executeTasks(int participant) noexcept;
+
+  /** @brief One deque per participant (index 0 is the calling thread) */
+  std::vector<std::unique_ptr<WorkStealingDeque>> deques;
+
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  /** @brief Capacity of each deque */
+  int dequeCapacity;
+
+  /** @brief Tasks not completed yet in the current batch */
+  alignas(64) std::atomic<int> remainingTasks{0};
+
+  TaskFunction currentFunction = nullptr;
+  void* currentContext = nullptr;
+
+  /** @brief Number of workers woken for the current batch */
+  int wokenWorkers = 0;
+
+  /** @brief The current batch was started by a real-time thread */
+  bool realtimeBatch = false;
+
+  std::atomic<bool> shouldExit{false};
+};
@@ -0,0 +1,258 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_core/juce_core.h>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "disk-streamer.hpp"
+
+/**
+ * @file sample-cache.hpp
+ * @brief Decoded audio files shared by every track playing them
+ */
+
+/**
+ * @class DecodedSample
+ * @brief A whole audio file decoded to float, never modified once created
+ *
+ * Shared between tracks (and their offline copies) through
+ * std::shared_ptr<const DecodedSample>. The frames are either in memory or
+ * in a memory-mapped sidecar file (see SampleSidecar).
+ */
+class DecodedSample {
+ public:
+  /** @brief Channels kept (more are not decoded) */
+  static constexpr int kMaxChannels = SampleStream::kMaxChannels;
+
+  /** @brief Silent frames after the end, read ahead by interpolators */
+  static constexpr int kPaddingFrames = 32;
+
+  /**
+   * @brief Decode a whole file
+   * @return nullptr if the reader is null or the file too long
+   */
+  static std::shared_ptr<const DecodedSample> decode(juce::AudioFormatReader* reader);
+
+  /**
+   * @brief Resample a whole sample to another rate
+   * @return The sample itself if already at that rate
+   */
+  static std::shared_ptr<const DecodedSample> resample(
+      std::shared_ptr<const DecodedSample> sample, double sampleRate);
+
+  int getNumChannels() const noexcept { return numChannels; }
+
+  /** @brief Frames of the file (kPaddingFrames more can be read) */
+  int getLength() const noexcept { return length; }
+
+  double getSampleRate() const noexcept { return sampleRate; }
+
+  /** @brief Length once resampled to an output rate */
+  juce::int64 getLength(double outputSampleRate) const noexcept;
+
+  /** @brief Memory held by the samples (mapped or allocated) */
+  size_t getSizeInBytes() const noexcept {
+    return (size_t)numChannels * (size_t)(length + kPaddingFrames) * sizeof(float);
+  }
+
+  /** @brief True if the frames are read from a mapped sidecar file */
+  bool isMapped() const noexcept { return mapping != nullptr; }
+
+  /** @brief Frames of a channel, followed by the padding */
+  const float* getReadPointer(int channel) const noexcept {
+    return channels[(size_t)channel];
+  }
+
+ private:
+  friend class SampleSidecar;
+
+  DecodedSample() = default;
+
+  /** @brief Allocate channels of length + kPaddingFrames frames */
+  void allocate(int newNumChannels, int newLength);
+
+  juce::AudioBuffer<float> buffer;
+  std::unique_ptr<juce::MemoryMappedFile> mapping;
+  std::array<const float*, kMaxChannels> channels{};
+  int numChannels = 0;
+  int length = 0;
+  double sampleRate = 0.0;
+};
+
+/**
+ * @class SamplePlayhead
+ * @brief Render state of a track reading a DecodedSample
+ *
+ * Copies frames at the file rate, or resamples them to the output rate
+ * with interpolators that follow the playhead from block to block. Any
+ * AudioTrack playing cached samples keeps one per sample it plays.
+ */
+class SamplePlayhead {
+ public:
+  /**
+   * @brief Copy output frames of a sample (real-time safe)
+   * @param sample Sample to play
+   * @param frame First output frame (negative: silence before the sample)
+   * @param sampleRate Output sample rate
+   * @param destinations 1 (a stereo sample is summed to mono) or 2 channels
+   * (a mono sample is copied to both)
+   * @param numDestinations Number of destination channels
+   * @param numFrames Frames to write to each destination
+   * @return Frames of the sample written; the rest are silence
+   */
+  int read(const DecodedSample& sample, juce::int64 frame, double sampleRate,
+           float* const* destinations, int numDestinations,
+           int numFrames) noexcept;
+
+ private:
+  /** @brief Frame expected by the next read (-1: none) */
+  juce::int64 nextFrame = -1;
+  double lastSampleRate = 0.0;
+
+  /** @brief Next source frame fed to the interpolators */
+  juce::int64 sourcePosition = 0;
+  std::array<juce::LagrangeInterpolator, DecodedSample::kMaxChannels> interpolators;
+};
+
+/**
+ * @class SampleCache
+ * @brief Process-wide cache of decoded files with LRU eviction
+ *
+ * load() decodes a file once; later loads of the same file (same path,
+ * size and modification time) share the buffer. Entries are kept in
+ * least-recently-used order under a memory budget. Files can be resampled
+ * once to the output rate when decoded, and kept in sidecar files so that
+ * later runs map them instead of decoding them again (see
+ * setSidecarDirectory()). Only entries no track
+ * holds any more are evicted: they would not free memory, and a later load
+ * would decode a second copy.
+ *
+ * The cache keeps a reference to every sample in use, so the last
+ * reference is always dropped here, by load(), trim() or clear() on a
+ * control thread, never by a track on the audio thread.
+ *
+ * @note Thread-safe. Decoding happens outside the lock; two threads loading
+ * the same new file both decode it, and the first one stored is kept.
+ */
+class SampleCache {
+ public:
+  /** @brief Default memory budget: 512 MiB */
+  static constexpr size_t kDefaultBudgetBytes = (size_t)512 << 20;
+
+  /**
+   * @struct Statistics
+   * @brief Counters since the cache was created
+   */
+  struct Statistics {
+    juce::uint64 hits = 0;
+    juce::uint64 misses = 0;
+    /** @brief Entries dropped to stay within the budget */
+    juce::uint64 evictions = 0;
+    /** @brief Loads of files which could not be decoded */
+    juce::uint64 failures = 0;
+    /** @brief Misses served by mapping a sidecar instead of decoding */
+    juce::uint64 sidecarLoads = 0;
+    /** @brief Sidecars written after decoding */
+    juce::uint64 sidecarWrites = 0;
+    int entries = 0;
+    /** @brief Entries held by tracks (not evictable) */
+    int entriesInUse = 0;
+    size_t bytes = 0;
+    size_t budgetBytes = 0;
+  };
+
+  explicit SampleCache(size_t budgetBytes = kDefaultBudgetBytes);
+
+  /** @brief The cache shared by the whole process */
+  static SampleCache& getInstance();
+
+  /**
+   * @brief Decoded contents of a file, decoding it on a miss (control thread)
+   * @param sampleRate Rate the file is resampled to once, when decoded
+   * (0: the file's own rate, and no sidecar)
+   * @return nullptr if the file cannot be decoded
+   */
+  std::shared_ptr<const DecodedSample> load(const juce::File& file,
+                                            double sampleRate = 0.0);
+
+  /** @brief Same, decoding with a given reader (e.g. of a format not registered) */
+  std::shared_ptr<const DecodedSample> load(const juce::File& file, double sampleRate,
+                                            const SampleStream::ReaderFactory& factory);
+
+  /**
+   * @brief Same, for any reader (e.g. a file in memory)
+   * @param key Identifies the contents: equal keys share one entry
+   */
+  std::shared_ptr<const DecodedSample> load(
+      const std::string& key, const SampleStream::ReaderFactory& factory);
+
+  /**
+   * @brief Keep resampled files in sidecars (see SampleSidecar)
+   *
+   * Misses at a given rate then map the file's sidecar if it is current, or
+   * decode the file and write its sidecar. Sidecars are not deleted: the
+   * directory belongs to the caller. An empty path (the default) turns
+   * sidecars off.
+   */
+  void setSidecarDirectory(const juce::File& directory);
+  juce::File getSidecarDirectory() const;
+
+  /** @brief Change the budget and evict down to it */
+  void setBudget(size_t budgetBytes);
+  size_t getBudget() const;
+
+  /**
+   * @brief Evict unused entries while over budget
+   *
+   * Tracks release samples without notifying the cache: call periodically
+   * (the engine does in collectGarbage()) to free what they left.
+   */
+  void trim();
+
+  /** @brief Evict every unused entry */
+  void clear();
+
+  Statistics getStatistics() const;
+
+  /** @brief Statistics in the Prometheus text format (appended to out) */
+  static void writePrometheus(const Statistics& statistics, std::string& out);
+
+ private:
+  using Decoder = std::function<std::shared_ptr<const DecodedSample>()>;
+
+  /** @brief Look a key up, calling decoder on a miss (without the lock) */
+  std::shared_ptr<const DecodedSample> loadDecoded(const std::string& key,
+                                                   const Decoder& decoder);
+
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const DecodedSample> sample;
+  };
+
+  /**
+   * @brief Drop unused entries, oldest first, down to a size (lock held)
+   * @param released Receives the samples, to be freed once unlocked
+   */
+  void evict(size_t targetBytes,
+             std::vector<std::shared_ptr<const DecodedSample>>& released);
+
+  mutable std::mutex mutex;
+
+  /** @brief Most recently used first */
+  std::list<Entry> entries;
+  std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+  size_t budget;
+  juce::File sidecarDirectory;
+  size_t bytes = 0;
+  Statistics counters;
+
+  JUCE_DECLARE_NON_COPYABLE(SampleCache)
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <cstddef>
+#include <memory>
+#include "sample-cache.hpp"
+
+/**
+ * @file sample-sidecar.hpp
+ * @brief Decoded samples saved as raw float files, mapped instead of decoded
+ */
+
+/**
+ * @class SampleSidecar
+ * @brief Raw float files holding a source file decoded at one sample rate
+ *
+ * A sidecar is one page of header followed by the planar frames of each
+ * channel (and DecodedSample::kPaddingFrames of silence), every channel
+ * starting on a page boundary. Opening one maps it: nothing is decoded or
+ * resampled, so loading a session of cached samples costs one mmap per
+ * file instead of decoding every file.
+ *
+ * The header records the sample rate and the source file's size,
+ * modification time and content hash. A sidecar is used only for the rate
+ * it was written at, and only while the source has the same contents: a
+ * source with a new modification time (copied, touched or rewritten) is
+ * hashed and compared. Stale or damaged sidecars are ignored, and
+ * overwritten by the next write().
+ *
+ * Files are in the machine's byte order; a sidecar from another byte order
+ * is ignored like a damaged one.
+ */
+class SampleSidecar {
+ public:
+  /** @brief Alignment of the header and of each channel */
+  static constexpr size_t kPageBytes = 4096;
+
+  /** @brief Format version, bumped on any layout change */
+  static constexpr juce::uint32 kVersion = 1;
+
+  /**
+   * @brief Sidecar of a source file at a sample rate
+   * @param directory Directory holding sidecars
+   * @return A file named after the source file, its path and the rate
+   */
+  static juce::File getFile(const juce::File& directory, const juce::File& source,
+                            double sampleRate);
+
+  /**
+   * @brief Map a sidecar
+   *
+   * Every page is read once here, so that the audio thread does not wait
+   * for the disk on first playback.
+   *
+   * @return nullptr if the sidecar is missing, damaged, at another rate or
+   * older than the source
+   */
+  static std::shared_ptr<const DecodedSample> open(const juce::File& sidecar,
+                                                   const juce::File& source,
+                                                   double sampleRate);
+
+  /**
+   * @brief Save a decoded sample of a source file
+   *
+   * Written to a temporary file renamed over the sidecar, so that a
+   * crash never leaves a partial sidecar behind.
+   *
+   * @return false if the sidecar could not be written
+   */
+  static bool write(const juce::File& sidecar, const juce::File& source,
+                    const DecodedSample& sample);
+
+  /** @brief 64-bit FNV-1a hash of a file's contents (0 if unreadable) */
+  static juce::uint64 hashFile(const juce::File& file);
+};
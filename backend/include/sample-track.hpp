@@ -0,0 +1,99 @@
+#pragma once
+#include <memory>
+#include "audio-track.hpp"
+#include "disk-streamer.hpp"
+#include "sample-cache.hpp"
+
+/**
+ * @file sample-track.hpp
+ * @brief Audio track playing an audio file
+ */
+
+/**
+ * @class SampleTrack
+ * @brief Plays an audio file at a position of the timeline
+ *
+ * The file is either streamed through a SampleStream (the DiskStreamer
+ * thread decodes it ahead of the transport) or played from a DecodedSample
+ * shared with other tracks through the SampleCache, for one-shots and
+ * loops used many times. Either way renderBlock() only copies from memory.
+ * Seeks and loops are followed automatically (reads which do not continue
+ * the previous block reposition the stream or playhead). Mono files render
+ * one channel; files with two channels or more render stereo (beyond two,
+ * only the first two are played). The output is dry: volume, pan and mute
+ * are applied by the mixer.
+ *
+ * Muted tracks keep reading, so unmuting continues without a seek.
+ */
+class SampleTrack : public AudioTrack {
+ public:
+  /**
+   * @brief Construct a new SampleTrack
+   * @param stream Stream of the file (DiskStreamer::createStream())
+   * @param startSample Timeline sample where the file starts
+   */
+  explicit SampleTrack(std::shared_ptr<SampleStream> stream,
+                       juce::int64 startSample = 0);
+
+  /**
+   * @brief Construct a SampleTrack playing a decoded file
+   * @param sample Shared samples (SampleCache::load())
+   * @param startSample Timeline sample where the file starts
+   */
+  explicit SampleTrack(std::shared_ptr<const DecodedSample> sample,
+                       juce::int64 startSample = 0);
+
+  /**
+   * @brief Read one sample of the file (left channel of a stereo file)
+   * @note Not continuous from block to block: repositions the stream
+   */
+  float getSampleValue(const BeatContext& context) override;
+
+  /**
+   * @brief Copy a block of the file
+   * @param buffer The audio buffer to fill (getNumOutputChannels() channels)
+   * @param startSample The starting sample index in the buffer
+   * @param numSamples The number of samples to render
+   * @param context Position of the first sample
+   * @return The part of the block within the file: silent before its start
+   * and after its end
+   */
+  RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                             int numSamples, const BeatContext& context) override;
+
+  /** @brief 2 for a stereo file, else 1 */
+  int getNumOutputChannels() const override { return numOutputChannels; }
+
+  /**
+   * @brief Create a copy which does not depend on the disk thread
+   * @note Streamed files are decoded by the thread rendering the copy;
+   * decoded samples are shared
+   */
+  std::unique_ptr<AudioTrack> clone() const override;
+
+  /** @brief Stream the track plays from, or nullptr */
+  const SampleStream* getStream() const { return stream.get(); }
+
+  /** @brief Decoded samples the track plays, or nullptr */
+  const std::shared_ptr<const DecodedSample>& getSample() const { return sample; }
+
+  /** @brief Timeline sample where the file starts */
+  juce::int64 getStartSample() const { return startSample; }
+
+ private:
+  /** @brief Copy one of the sources to 1 or 2 channels */
+  void read(juce::int64 frame, double sampleRate, float* const* outputs, int numOutputs,
+            int numFrames);
+
+  /** @brief Length of the source at an output rate (0 without one) */
+  juce::int64 getLength(double sampleRate) const;
+
+  /** @brief Output channels of a source with that many channels */
+  static int getOutputChannels(int sourceChannels);
+
+  std::shared_ptr<SampleStream> stream;
+  std::shared_ptr<const DecodedSample> sample;
+  SamplePlayhead playhead;
+  juce::int64 startSample;
+  int numOutputChannels;
+};
@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * @file spsc-queue.hpp
+ * @brief Bounded wait-free single-producer/single-consumer queue
+ */
+
+/**
+ * @class SpscQueue
+ * @brief Ring buffer of preallocated slots between two threads
+ *
+ * All slots are allocated by the constructor. Pushing moves a value into a
+ * free slot and popping moves it out, so neither side ever allocates, locks
+ * or waits: both operations finish in a bounded number of steps and fail
+ * instead of blocking when the queue is full or empty.
+ *
+ * Each side caches the other side's index and only reloads it when the
+ * queue looks full (producer) or empty (consumer). The two indices live on
+ * separate cache lines so the threads do not invalidate each other's line
+ * on every operation.
+ *
+ * @note Exactly one producer thread and one consumer thread
+ * @note Popped slots are left moved-from: values holding resources (e.g.
+ * shared pointers) are released by whoever ends up owning them, not by the
+ * queue
+ */
+template <typename T>
+class SpscQueue {
+ public:
+  /**
+   * @brief Allocate the slots
+   * @param minCapacity Minimum number of queued values (rounded up to a power
+   * of two)
+   */
+  explicit SpscQueue(size_t minCapacity) {
+    size_t capacity = 2;
+    while (capacity < minCapacity) {
+      capacity *= 2;
+    }
+    slots.resize(capacity);
+    mask = capacity - 1;
+  }
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  /**
+   * @brief Move a value into the queue (producer thread)
+   * @return False if the queue is full (the value is left untouched)
+   */
+  bool tryPush(T&& value) noexcept {
+    const size_t write = writeIndex.load(std::memory_order_relaxed);
+    if (write - cachedReadIndex == slots.size()) {
+      cachedReadIndex = readIndex.load(std::memory_order_acquire);
+      if (write - cachedReadIndex == slots.size()) {
+        return false;
+      }
+    }
+
+    slots[write & mask] = std::move(value);
+    writeIndex.store(write + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Move the oldest value out of the queue (consumer thread)
+   * @param value Destination, should not hold a resource the consumer
+   * cannot release
+   * @return False if the queue is empty
+   */
+  bool tryPop(T& value) noexcept {
+    const size_t read = readIndex.load(std::memory_order_relaxed);
+    if (read == cachedWriteIndex) {
+      cachedWriteIndex = writeIndex.load(std::memory_order_acquire);
+      if (read == cachedWriteIndex) {
+        return false;
+      }
+    }
+
+    value = std::move(slots[read & mask]);
+    readIndex.store(read + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** @brief Number of slots */
+  size_t getCapacity() const noexcept { return slots.size(); }
+
+  /** @brief Number of queued values (exact only on a quiescent queue) */
+  size_t getNumReady() const noexcept {
+    return writeIndex.load(std::memory_order_acquire) -
+           readIndex.load(std::memory_order_acquire);
+  }
+
+ private:
+  std::vector<T> slots;
+  size_t mask = 0;
+
+  /** @brief Producer side: next slot to write, last read index seen */
+  alignas(64) std::atomic<size_t> writeIndex{0};
+  size_t cachedReadIndex = 0;
+
+  /** @brief Consumer side: next slot to read, last write index seen */
+  alignas(64) std::atomic<size_t> readIndex{0};
+  size_t cachedWriteIndex = 0;
+};
@@ -0,0 +1,230 @@
+#pragma once
+#include <vector>
+#include "audio-track.hpp"
+#include "envelope-generator.hpp"
+#include "wave-table-bank.hpp"
+
+/**
+ * @file synth-track.hpp
+ * @brief Polyphonic wavetable instrument track
+ */
+
+/**
+ * @class SynthTrack
+ * @brief Instrument track playing notes on a fixed pool of wavetable voices
+ *
+ * Each voice is a band-limited oscillator (the WaveTableBank level of its
+ * pitch) shaped by its own EnvelopeGenerator and scaled by its velocity.
+ * The pool is allocated by the constructor and never grows: a note-on
+ * takes a free voice, or steals one when all of them sound (see
+ * StealMode), without allocating. A stolen voice keeps its oscillator
+ * phase and attacks from its current level, so stealing does not click.
+ *
+ * Voices are stored as a structure of arrays, sounding voices packed at
+ * the front, and mixed WaveTableSimd::kVoiceLanes at a time by the voice
+ * kernel of the machine. Envelopes run at control rate: they are
+ * evaluated once per chunk of WaveTableSimd::kChunkSize samples and the
+ * gain ramps linearly in between. A voice whose release has ended leaves
+ * the pool, the last sounding voice taking its slot, so the cost of a
+ * block follows the number of sounding voices. Blocks without any are a
+ * clear and report silence.
+ *
+ * Notes arrive through noteOn() and noteOff(), which the MixEngine calls
+ * between two renderBlock() calls: EngineCommand places them on their
+ * sample. The output is mono and dry like every track.
+ *
+ * @note Uses the shared band-limited bank of its waveform
+ * (WaveTableBank::get())
+ * @note Render state makes renderBlock(), noteOn() and noteOff()
+ * single-threaded per track, as tracks already are
+ */
+class SynthTrack : public AudioTrack {
+ public:
+  /**
+   * @enum StealMode
+   * @brief Voice given to a note when every voice sounds
+   */
+  enum class StealMode {
+    Oldest,  /**< The voice whose note started first */
+    Quietest /**< The voice with the lowest envelope level times velocity */
+  };
+
+  /** @brief Default size of the voice pool */
+  static constexpr int kDefaultVoices = 256;
+
+  /** @brief Largest voice pool */
+  static constexpr int kMaxVoices = 1024;
+
+  /**
+   * @brief Construct a new SynthTrack
+   * @param maxVoices Size of the voice pool (clamped to [1, kMaxVoices])
+   * @param waveform Oscillator waveform of every voice
+   */
+  explicit SynthTrack(int maxVoices = kDefaultVoices,
+                      WaveTable::WaveType waveform = WaveTable::WaveType::SAW);
+
+  /**
+   * @brief Render one sample from the current voices
+   * @param context Position and tempo of the sample
+   * @return The next output sample. Voices advance by one sample: notes
+   * are events, not a function of the position.
+   */
+  float getSampleValue(const BeatContext& context) override;
+
+  /**
+   * @brief Render a block of the sounding voices
+   * @param buffer The audio buffer to fill (channel 0, at unity gain)
+   * @param startSample The starting sample index in the buffer
+   * @param numSamples The number of samples to render
+   * @param context Position and tempo of the first sample
+   * @return The chunks rendered before the last voice ended
+   */
+  RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                             int numSamples, const BeatContext& context) override;
+
+  /**
+   * @brief Create a copy of this track (same pool size, waveform, envelope,
+   * steal mode and mixer settings, no sounding voice)
+   */
+  std::unique_ptr<AudioTrack> clone() const override;
+
+  /**
+   * @brief Start a note
+   * @param note MIDI note number (clamped to [0, 127], 69 is A4 at 440 Hz)
+   * @param velocity Gain of the note (clamped to [0, 1]). 0 releases the
+   * note, as in MIDI.
+   *
+   * A note already sounding is started again on its own voice.
+   *
+   * @note Real-time safe
+   */
+  void noteOn(int note, float velocity) noexcept override;
+
+  /**
+   * @brief Release every voice playing a note
+   * @param note MIDI note number
+   * @note Real-time safe
+   */
+  void noteOff(int note) noexcept override;
+
+  /**
+   * @brief Release every sounding voice
+   * @note Real-time safe
+   */
+  void allNotesOff() noexcept;
+
+  /**
+   * @brief Set the envelope of the notes
+   * @note Takes effect from the next note. Like setVolume(), not
+   * synchronized with the audio thread.
+   */
+  void setADSRParameters(const ADSRParameters& params);
+
+  /** @brief Get the envelope of the notes */
+  ADSRParameters getADSRParameters() const;
+
+  /** @brief Set the voice given to a note when every voice sounds */
+  void setStealMode(StealMode mode) noexcept { stealMode = mode; }
+
+  /** @brief Get the voice given to a note when every voice sounds */
+  StealMode getStealMode() const noexcept { return stealMode; }
+
+  /** @brief Oscillator waveform of every voice */
+  WaveTable::WaveType getWaveform() const noexcept { return waveform; }
+
+  /** @brief Size of the voice pool */
+  int getMaxVoices() const noexcept { return maxVoices; }
+
+  /**
+   * @brief Number of voices sounding or releasing
+   * @note Render state, read it from the thread rendering the track
+   */
+  int getActiveVoiceCount() const noexcept { return numActive; }
+
+ protected:
+  /** @brief Take the mix settings, envelope and steal mode of another
+   * synth, for clone() */
+  void copySettings(const SynthTrack& other);
+
+ private:
+  /** @brief Render numSamples samples from the current voices */
+  RenderActivity render(float* output, int numSamples) noexcept;
+
+  /** @brief Render one chunk (at most WaveTableSimd::kChunkSize samples) */
+  void renderChunk(float* output, int numSamples) noexcept;
+
+  /** @brief Slot of the voice to start a note on (free or stolen) */
+  int allocateVoice() const noexcept;
+
+  /** @brief Set the pitch of a voice from its note at the render rate */
+  void tune(int voice) noexcept;
+
+  /** @brief Retune every voice and envelope to a new sample rate */
+  void setSampleRate(double newSampleRate) noexcept;
+
+  /** @brief Move the last sounding voice into a finished voice's slot */
+  void removeVoice(int voice) noexcept;
+
+  /** @brief Size of the voice pool */
+  int maxVoices;
+
+  /** @brief Oscillator waveform of every voice */
+  WaveTable::WaveType waveform;
+
+  /** @brief Shared band-limited oscillator tables */
+  const WaveTableBank* bank;
+
+  /** @brief Envelope of every note */
+  ADSRParameters adsr;
+
+  /** @brief Voice given to a note when every voice sounds */
+  StealMode stealMode = StealMode::Oldest;
+
+  /** @brief Sample rate the voice pitches were computed for */
+  double renderSampleRate;
+
+  /** @brief Number of sounding voices, packed at the front of the pool */
+  int numActive = 0;
+
+  /** @brief Start order of the next note (oldest voice: lowest value) */
+  juce::uint64 nextOrder = 0;
+
+  // Voice kernel inputs, one entry per slot. The pool is rounded up to a
+  // multiple of WaveTableSimd::kVoiceLanes, and slots from numActive on
+  // are kept at zero (silent padding for the kernel).
+
+  /** @brief Table position of the next sample */
+  std::vector<float> positions;
+
+  /** @brief Table samples per output sample */
+  std::vector<float> increments;
+
+  /** @brief Gain of the first sample of the chunk */
+  std::vector<float> gains;
+
+  /** @brief Gain change per sample within the chunk */
+  std::vector<float> gainSteps;
+
+  /** @brief Offset of the voice's bank level from level 0 */
+  std::vector<int> tableOffsets;
+
+  // Control state, one entry per slot
+
+  /** @brief Envelope of the note */
+  std::vector<EnvelopeGenerator> envelopes;
+
+  /** @brief MIDI note played */
+  std::vector<int> notes;
+
+  /** @brief Velocity of the note */
+  std::vector<float> velocities;
+
+  /** @brief Start order of the note */
+  std::vector<juce::uint64> orders;
+
+  /** @brief Note released (noteOff() received) */
+  std::vector<bool> released;
+
+  /** @brief Partial sums of the voice kernel, kChunkSize rows of kVoiceLanes */
+  std::vector<float> partials;
+};
@@ -0,0 +1,210 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <vector>
+
+/**
+ * @file tempo-map.hpp
+ * @brief Tempo and time signature changes of a session, in samples
+ */
+
+class TempoMap;
+
+/**
+ * @struct BeatContext
+ * @brief Musical position of the first sample of a rendered span
+ *
+ * Built once per block by the Transport and passed to every track. Within
+ * the span the tempo changes linearly (constant outside of ramps) and the
+ * time signature is constant, so tracks get the beat position of any
+ * sample from getBeatAt() without looking at the tempo map.
+ */
+struct BeatContext {
+  /** @brief Absolute sample index since the start of the session */
+  juce::int64 sample = 0;
+
+  /** @brief Sample rate in Hz */
+  double sampleRate = 44100.0;
+
+  /** @brief Beat position (quarter notes since the start of the session) */
+  double beat = 0.0;
+
+  /** @brief Tempo, in beats per sample */
+  double beatsPerSample = 0.0;
+
+  /** @brief Change of beatsPerSample per sample (non-zero during ramps) */
+  double beatsPerSampleDelta = 0.0;
+
+  /** @brief Index of the bar containing the sample */
+  juce::int64 bar = 0;
+
+  /** @brief Beat position of the start of that bar */
+  double barStartBeat = 0.0;
+
+  /** @brief Time signature */
+  int numerator = 4;
+  int denominator = 4;
+
+  /** @brief Map the context was built from, for lookups outside the span */
+  const TempoMap* tempoMap = nullptr;
+
+  /** @brief Beat position of the sample at an offset from the first one */
+  double getBeatAt(double offset) const {
+    return beat + offset * (beatsPerSample + 0.5 * beatsPerSampleDelta * offset);
+  }
+
+  /** @brief Tempo in beats per minute */
+  double getTempo() const { return beatsPerSample * sampleRate * 60.0; }
+
+  /** @brief Bar length in beats */
+  double getBeatsPerBar() const { return numerator * 4.0 / denominator; }
+};
+
+/**
+ * @class TempoMap
+ * @brief Tempo points, ramps and time signature changes of a session
+ *
+ * Edits are expressed musically (tempo points at beat positions, time
+ * signatures at bar indices). After each edit the map is compiled into
+ * segments with a constant time signature and a tempo that is constant or
+ * changes linearly with time. A segment stores its exact (fractional)
+ * starting sample, so the beat position of sample n is a closed form:
+ *
+ *   beat(n) = startBeat + d / samplesPerBeat + acceleration * d^2 / 2,
+ *   with d = n - originSample
+ *
+ * Lookups binary-search the segments (O(log n)). The Transport walks them
+ * incrementally instead, one block at a time.
+ *
+ * Beats are quarter notes: tempos are quarter notes per minute and a bar of
+ * N/D lasts N * 4 / D beats.
+ *
+ * @note Maps are edited on a control thread, then published immutable to
+ * the audio thread (see MixEngine::setTempoMap())
+ */
+class TempoMap {
+ public:
+  /**
+   * @struct Segment
+   * @brief Span of constant time signature and constant or linear tempo
+   */
+  struct Segment {
+    /** @brief Exact sample at which the segment starts */
+    double originSample = 0.0;
+
+    /** @brief First whole sample belonging to the segment */
+    juce::int64 firstSample = 0;
+
+    /** @brief Beat position at originSample */
+    double startBeat = 0.0;
+
+    /** @brief Beat length in samples at originSample */
+    double samplesPerBeat = 22050.0;
+
+    /** @brief Change of the tempo in beats per sample, per sample */
+    double acceleration = 0.0;
+
+    /** @brief Time signature of the segment */
+    int numerator = 4;
+    int denominator = 4;
+
+    /** @brief Index and beat position of the first bar of that signature */
+    juce::int64 signatureBar = 0;
+    double signatureBeat = 0.0;
+  };
+
+  /**
+   * @brief Construct a map with a constant tempo in 4/4
+   * @param bpm Tempo in beats per minute (clamped to [1, 1000])
+   * @param sampleRate Sample rate segments are compiled for
+   */
+  explicit TempoMap(double bpm = 120.0, double sampleRate = 44100.0);
+
+  /**
+   * @brief Add or replace a tempo point
+   * @param beat Beat position of the point (negative values are clamped to 0)
+   * @param bpm Tempo from that point on (clamped to [1, 1000])
+   * @param rampToNext True to change the tempo linearly in time until the
+   * next point instead of jumping there
+   */
+  void setTempo(double beat, double bpm, bool rampToNext = false);
+
+  /**
+   * @brief Add or replace a time signature change
+   * @param bar Bar index where the signature starts (0 changes the initial
+   * one)
+   * @param numerator Beats per bar (at least 1)
+   * @param denominator Note value of a beat (power of two, 1 to 64)
+   */
+  void setTimeSignature(juce::int64 bar, int numerator, int denominator);
+
+  /** @brief Recompile the segments for another sample rate */
+  void setSampleRate(double newSampleRate);
+
+  /** @brief Sample rate the segments are compiled for */
+  double getSampleRate() const { return sampleRate; }
+
+  /**
+   * @brief Identifies the map contents
+   * @note Changes on every edit, kept by copies. Lets render state built
+   * for one map detect that another one was published.
+   */
+  juce::uint32 getId() const { return id; }
+
+  /** @brief Tempo at the start of the session in beats per minute */
+  double getInitialTempo() const { return tempoPoints.front().bpm; }
+
+  /** @brief Compiled segments, ordered by position */
+  const std::vector<Segment>& getSegments() const { return segments; }
+
+  /** @brief Index of the segment containing a sample (O(log n)) */
+  size_t findSegment(juce::int64 sample) const;
+
+  /** @brief First sample after a segment (INT64_MAX for the last one) */
+  juce::int64 getSegmentEnd(size_t segment) const;
+
+  /** @brief Beat position of a sample (O(log n)) */
+  double getBeatAtSample(juce::int64 sample) const;
+
+  /**
+   * @brief Exact (fractional) sample at which a beat position is reached
+   * @note O(log n)
+   */
+  double getSampleAtBeat(double beat) const;
+
+  /** @brief Context of a sample (O(log n)) */
+  BeatContext getContext(juce::int64 sample) const;
+
+  /** @brief Context of a sample known to lie in a segment (O(1)) */
+  BeatContext getContext(juce::int64 sample, size_t segment) const;
+
+ private:
+  struct TempoPoint {
+    double beat;
+    double bpm;
+    bool rampToNext;
+  };
+
+  struct TimeSignature {
+    juce::int64 bar;
+    int numerator;
+    int denominator;
+  };
+
+  /** @brief Compile tempo points and time signatures into segments */
+  void rebuild();
+
+  /** @brief Beat position of a sample within a segment */
+  static double getBeatInSegment(const Segment& segment, double sample);
+
+  /** @brief Sample of a beat position within a segment */
+  static double getSampleInSegment(const Segment& segment, double beat);
+
+  double sampleRate;
+  juce::uint32 id = 0;
+
+  /** @brief Edits, sorted by position, the first one at 0 */
+  std::vector<TempoPoint> tempoPoints;
+  std::vector<TimeSignature> timeSignatures;
+
+  std::vector<Segment> segments;
+};
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "audio-track.hpp"
+#include "mix-graph.hpp"
+#include "tempo-map.hpp"
+
+/**
+ * @file track-list.hpp
+ * @brief Lock-free publication of the track list to the audio thread
+ */
+
+/**
+ * @struct TrackList
+ * @brief Immutable snapshot of the tracks played by the engine
+ *
+ * A TrackList is built on a control thread, published once and never
+ * modified afterwards. Tracks are shared between consecutive snapshots so
+ * that adding or removing one track does not recreate the others. The tempo
+ * map the tracks follow, and the compiled routing of the mix, are published
+ * the same way.
+ */
+struct TrackList {
+  /** @brief Tracks in playback order */
+  std::vector<std::shared_ptr<AudioTrack>> tracks;
+
+  /** @brief Tempo and time signatures of the session (never null) */
+  std::shared_ptr<const TempoMap> tempoMap;
+
+  /**
+   * @brief Stereo scratch buffers for parallel rendering, one per track
+   *
+   * Written by the audio thread only. Consecutive lists share the same
+   * buffers when the capacity allows it: only one block is rendered at a
+   * time, so two lists never use them concurrently. Null until a render
+   * block size has been set.
+   */
+  std::shared_ptr<std::vector<juce::AudioBuffer<float>>> renderBuffers;
+
+  /** @brief Routing of the tracks through the buses (never null) */
+  std::shared_ptr<const MixPlan> plan;
+
+  /**
+   * @brief Stereo buffers of the buses, plan->numBuffers of them at least
+   *
+   * Shared between lists like renderBuffers. Null until a render block size
+   * has been set.
+   */
+  std::shared_ptr<std::vector<juce::AudioBuffer<float>>> busBuffers;
+
+  /**
+   * @brief Lines of the plan's compensations, in the same order
+   *
+   * A line passes from one list to the next while its path keeps the same
+   * delay, so edits elsewhere in the graph do not interrupt it. Empty until
+   * a render block size has been set.
+   */
+  std::vector<std::shared_ptr<CompensationDelay>> delays;
+};
+
+/**
+ * @class TrackListPublisher
+ * @brief RCU-style owner of the current TrackList
+ *
+ * The control thread (WebSocket, UI, tests) copies the current list, edits
+ * the copy and publishes it with a single atomic pointer swap. The audio
+ * thread reads the current list inside a ReadScope and never locks, waits or
+ * frees memory.
+ *
+ * Replaced lists are retired together with the value of the audio thread's
+ * read sequence at swap time. The sequence is odd while a block is being
+ * rendered, so a retired list can be freed as soon as the sequence has moved
+ * past that value (the block which might still see it has finished). Freeing
+ * always happens on the control thread, in collectGarbage().
+ *
+ * The publisher also owns the MixGraph. Track and routing edits recompile
+ * it, so a published list always carries a plan matching its tracks.
+ *
+ * @note A single reader thread (the audio callback) is supported
+ * @note Writers are serialised by a mutex that the audio thread never takes
+ */
+class TrackListPublisher {
+ public:
+  /**
+   * @class ReadScope
+   * @brief RAII guard marking a block rendered by the audio thread
+   *
+   * The list returned by the scope stays valid until the scope is destroyed.
+   */
+  class ReadScope {
+   public:
+    explicit ReadScope(TrackListPublisher& owner) noexcept
+        : publisher(owner), list(owner.beginRead()) {}
+
+    ~ReadScope() { publisher.endRead(); }
+
+    ReadScope(const ReadScope&) = delete;
+    ReadScope& operator=(const ReadScope&) = delete;
+
+    const TrackList& operator*() const noexcept { return *list; }
+    const TrackList* operator->() const noexcept { return list; }
+
+   private:
+    TrackListPublisher& publisher;
+    const TrackList* list;
+  };
+
+  /**
+   * @brief Construct a publisher holding an empty track list
+   */
+  TrackListPublisher();
+
+  /**
+   * @brief Destructor
+   * @note The audio thread must not be inside a ReadScope anymore
+   */
+  ~TrackListPublisher();
+
+  TrackListPublisher(const TrackListPublisher&) = delete;
+  TrackListPublisher& operator=(const TrackListPublisher&) = delete;
+
+  /**
+   * @brief Append a track and publish the new list (control thread)
+   * @param track The track to add
+   * @return Index of the new track
+   */
+  size_t addTrack(std::shared_ptr<AudioTrack> track);
+
+  /**
+   * @brief Remove a track and publish the new list (control thread)
+   * @param index Index of the track to remove
+   * @return True if the track existed and was removed
+   */
+  bool removeTrack(size_t index);
+
+  /**
+   * @brief Get a track from the current list (control thread)
+   * @param index Index of the track
+   * @return The track, or nullptr if the index is out of range
+   */
+  std::shared_ptr<AudioTrack> getTrack(size_t index) const;
+
+  /**
+   * @brief Get a copy of the current track list (control thread)
+   */
+  std::vector<std::shared_ptr<AudioTrack>> getTracks() const;
+
+  /**
+   * @brief Get the number of tracks in the current list
+   */
+  size_t getTrackCount() const;
+
+  /**
+   * @brief Replace the tempo map and publish the new list (control thread)
+   * @param map The new map (ignored if null)
+   */
+  void setTempoMap(std::shared_ptr<const TempoMap> map);
+
+  /**
+   * @brief Get the current tempo map (control thread)
+   */
+  std::shared_ptr<const TempoMap> getTempoMap() const;
+
+  /**
+   * @brief Edit the routing and publish its new plan (control thread)
+   * @param edit Called with a copy of the current graph; returns false to
+   * cancel the edit
+   * @return The value returned by edit
+   */
+  bool editGraph(const std::function<bool(MixGraph&)>& edit);
+
+  /**
+   * @brief Get a copy of the current routing (control thread)
+   */
+  MixGraph getGraph() const;
+
+  /**
+   * @brief Latency of the current plan, in samples (control thread)
+   */
+  int getLatencySamples() const;
+
+  /**
+   * @brief Recompute the delays of the current plan if the latency of an
+   * effect changed (control thread)
+   *
+   * Only paths whose delay changed get new lines.
+   *
+   * @return True if a plan with new compensations was published
+   */
+  bool refreshLatency();
+
+  /**
+   * @brief Allocate per-track render buffers for the given block size
+   * @param numSamples Maximum number of samples per block (0 disables them)
+   * @note Must not be called while the audio thread renders a block
+   */
+  void setRenderBlockSize(int numSamples);
+
+  /**
+   * @brief Free retired lists the audio thread can no longer see
+   *
+   * Called automatically after every publication. Should also be called
+   * periodically from a non real-time thread so that the last retired
+   * lists are released even when no further edit happens.
+   */
+  void collectGarbage();
+
+  /**
+   * @brief Number of retired lists still waiting to be freed
+   */
+  size_t getPendingReclaimCount() const;
+
+ private:
+  /** @brief Audio thread: enter a block and load the current list */
+  const TrackList* beginRead() noexcept;
+
+  /** @brief Audio thread: leave the block entered by beginRead() */
+  void endRead() noexcept;
+
+  /** @brief Swap in a new list and retire the previous one (writer lock held) */
+  void publish(std::unique_ptr<TrackList> next);
+
+  /** @brief Free every reclaimable retired list (writer lock held) */
+  void reclaim();
+
+  /** @brief Give a list render buffers, reusing the previous ones if possible */
+  void assignRenderBuffers(TrackList& next, const TrackList* previous) const;
+
+  /** @brief Give a list bus buffers, reusing the previous ones if possible */
+  void assignBusBuffers(TrackList& next, const TrackList* previous) const;
+
+  /** @brief Give a list compensation lines, reusing those of unchanged paths */
+  void assignDelays(TrackList& next, const TrackList* previous) const;
+
+  struct RetiredList {
+    std::unique_ptr<TrackList> list;
+    uint64_t readSequence;
+  };
+
+  /** @brief Currently published list (owned, deleted when retired) */
+  std::atomic<TrackList*> current;
+
+  /** @brief Incremented on entry and exit of each block: odd while reading */
+  std::atomic<uint64_t> readSequence{0};
+
+  /** @brief Samples per render buffer (0 = no render buffers) */
+  int renderBlockSize = 0;
+
+  /** @brief Routing of the tracks, compiled into each list (writer lock) */
+  MixGraph graph;
+
+  /** @brief Serialises control-thread writers */
+  mutable std::mutex writerMutex;
+
+  /** @brief Replaced lists waiting for their grace period to elapse */
+  std::vector<RetiredList> retired;
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include "tempo-map.hpp"
+
+/**
+ * @file transport.hpp
+ * @brief Sample-accurate playback position
+ */
+
+/**
+ * @class Transport
+ * @brief Integer playback position walking a TempoMap block by block
+ *
+ * The position is a sample count, so it never drifts however long the
+ * session plays. Each block asks for the BeatContext of the current
+ * position: the transport remembers the tempo map segment it is in and only
+ * moves to the next one when the position crosses it. A binary search only
+ * happens after a seek or when another map is published.
+ *
+ * @note Audio thread only, not thread-safe
+ */
+class Transport {
+ public:
+  /** @brief Position of the next block in samples */
+  juce::int64 getPosition() const noexcept { return position; }
+
+  /** @brief Move the playback position */
+  void setPosition(juce::int64 sample) noexcept { position = sample; }
+
+  /**
+   * @brief Context of the current position
+   * @param map Tempo map of the session
+   * @param numSamples Samples to render, reduced if needed so the span does
+   * not cross a tempo or time signature change
+   * @return Context of the first sample of the span
+   */
+  BeatContext getContext(const TempoMap& map, int& numSamples);
+
+  /** @brief Move past a rendered span */
+  void advance(int numSamples) noexcept { position += numSamples; }
+
+ private:
+  juce::int64 position = 0;
+
+  /** @brief Map and segment the position was last found in */
+  juce::uint32 mapId = 0;
+  size_t segment = 0;
+};
@@ -0,0 +1,91 @@
+#pragma once
+#include <array>
+#include <atomic>
+
+/**
+ * @file triple-buffer.hpp
+ * @brief Wait-free latest-value exchange between two threads
+ */
+
+/**
+ * @class TripleBuffer
+ * @brief Three preallocated slots: one written, one published, one read
+ *
+ * The writer fills its slot and publishes it by swapping it with the
+ * published slot; the reader takes the published slot by swapping it with
+ * its own. Both swaps are a single atomic exchange, so neither side ever
+ * waits, and each side always owns a slot the other one cannot touch.
+ *
+ * Unlike a queue, the reader only ever sees the newest value: a value
+ * published twice before the reader looks is replaced. The writer can check
+ * hasUnreadValue() to carry over what the reader would otherwise miss.
+ *
+ * @note Exactly one writer thread and one reader thread
+ */
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() = default;
+
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  /** @brief Slot owned by the writer (writer thread) */
+  T& getWriteBuffer() noexcept { return slots[writeIndex]; }
+
+  /** @brief Make the write slot the newest value (writer thread) */
+  void publish() noexcept {
+    const auto previous = state.exchange(
+        (unsigned char)(writeIndex | kUnread), std::memory_order_acq_rel);
+    writeIndex = previous & kIndexMask;
+  }
+
+  /** @brief True while the last published value has not been read */
+  bool hasUnreadValue() const noexcept {
+    return (state.load(std::memory_order_acquire) & kUnread) != 0;
+  }
+
+  /**
+   * @brief Take the newest value if there is one (reader thread)
+   * @return True if getReadBuffer() changed
+   */
+  bool update() noexcept {
+    if (!hasUnreadValue()) {
+      return false;
+    }
+
+    const auto previous = state.exchange((unsigned char)readIndex,
+                                         std::memory_order_acq_rel);
+    readIndex = previous & kIndexMask;
+    return true;
+  }
+
+  /** @brief Slot owned by the reader (reader thread) */
+  const T& getReadBuffer() const noexcept { return slots[readIndex]; }
+
+  /**
+   * @brief Call a function on every slot, e.g. to preallocate them
+   * @note Not while either thread uses the buffer
+   */
+  template <typename Function>
+  void forEachBuffer(Function&& function) {
+    for (auto& slot : slots) {
+      function(slot);
+    }
+  }
+
+ private:
+  static constexpr unsigned char kIndexMask = 0x3;
+  static constexpr unsigned char kUnread = 0x4;
+
+  std::array<T, 3> slots;
+
+  /** @brief Published slot index, plus kUnread until the reader takes it */
+  std::atomic<unsigned char> state{1};
+
+  /** @brief Writer side */
+  int writeIndex = 0;
+
+  /** @brief Reader side */
+  int readIndex = 2;
+};
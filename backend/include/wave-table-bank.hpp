@@ -0,0 +1,127 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include "wave-table.hpp"
+
+/**
+ * @file wave-table-bank.hpp
+ * @brief Mipmapped band-limited wavetables, one level per octave
+ */
+
+/**
+ * @class WaveTableBank
+ * @brief Band-limited versions of a waveform, selected from the pitch
+ *
+ * The naive WaveTable holds the waveform with all its harmonics. Above a
+ * few hundred Hz most of them lie above Nyquist and fold back as aliasing.
+ * The bank instead stores one additively synthesized table per octave:
+ *
+ * - Level k keeps the harmonics up to tableSize >> (k + 2). It is therefore
+ *   alias-free for any phase increment below 2^(k+1) table samples per
+ *   output sample, whatever the sample rate.
+ * - A block whose increment lies in [2^k, 2^(k+1)) crossfades between
+ *   levels k and k+1. The timbre changes smoothly across octaves and no
+ *   level is ever played above its band limit.
+ *
+ * Levels share the table size, so a position is valid in every level.
+ * Each level starts on a cache line and ends with a guard sample. Lookups
+ * run on the WaveTableSimd kernels.
+ *
+ * @note Banks are immutable once built. Use get() to share one bank per
+ * waveform across all tracks.
+ */
+class WaveTableBank {
+ public:
+  /**
+   * @brief Build a bank
+   * @param type Waveform to band-limit
+   * @param tableSize Samples per level, a power of two (default: 4096, which
+   * keeps 1024 harmonics at the lowest level)
+   */
+  explicit WaveTableBank(WaveTable::WaveType type, int tableSize = 4096);
+
+  ~WaveTableBank();
+
+  WaveTableBank(const WaveTableBank&) = delete;
+  WaveTableBank& operator=(const WaveTableBank&) = delete;
+
+  /**
+   * @brief Shared bank for a waveform, built on first use
+   * @note Thread-safe. The first call for a type takes a few milliseconds,
+   * so call it outside the audio thread (e.g. in a track constructor).
+   */
+  static const WaveTableBank& get(WaveTable::WaveType type);
+
+  /** @brief Number of mip levels */
+  int getNumLevels() const { return numLevels; }
+
+  /** @brief Samples per level (excluding the guard sample) */
+  int getTableSize() const { return tableSize; }
+
+  /** @brief Highest harmonic stored in a level */
+  int getNumHarmonics(int level) const { return tableSize >> (level + 2); }
+
+  /**
+   * @brief Samples of a level, 64-byte aligned, followed by a guard sample
+   */
+  const float* getLevel(int level) const {
+    return storage.get() + (size_t)level * levelStride;
+  }
+
+  /**
+   * @brief Fractional level for a phase increment
+   * @param phaseIncrement Phase advance per sample in radians
+   * @return Value in [0, getNumLevels() - 1]. The integer part is the
+   * first level, the fraction the crossfade towards the next one. Levels
+   * that repeat the one below them (all levels of a sine) are never
+   * selected.
+   */
+  float getLevelForIncrement(float phaseIncrement) const;
+
+  /**
+   * @brief Get one band-limited sample
+   * @param phase Phase in radians (any value)
+   * @param phaseIncrement Phase advance per sample in radians, used to
+   * select the level
+   */
+  float getSample(float phase, float phaseIncrement) const;
+
+  /**
+   * @brief Fill a block at a constant pitch
+   * @param output Destination for numSamples samples
+   * @param numSamples Number of samples to render
+   * @param phase Phase of the first sample in radians (any value)
+   * @param phaseIncrement Phase advance per sample in radians
+   * @return Phase following the last sample, wrapped to [0, 2π)
+   *
+   * Real-time safe: crossfades go through a fixed-size stack buffer.
+   */
+  float renderBlock(float* output, int numSamples, float phase,
+                    float phaseIncrement) const;
+
+ private:
+  struct AlignedDeleter {
+    void operator()(float* data) const;
+  };
+
+  /** @brief Fill every level with its partial sum of harmonics */
+  void build(WaveTable::WaveType type);
+
+  /** @brief Samples per level */
+  int tableSize;
+
+  /** @brief Number of levels, down to a single harmonic */
+  int numLevels;
+
+  /** @brief Levels above this one repeat it and are never selected */
+  int maxLevel;
+
+  /** @brief Distance between levels, rounded up to whole cache lines */
+  size_t levelStride;
+
+  /** @brief Radians to table samples */
+  float phaseToIndex;
+
+  /** @brief All levels in one cache-line aligned block */
+  std::unique_ptr<float[], AlignedDeleter> storage;
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+/**
+ * @file wave-table-simd.hpp
+ * @brief Block wavetable kernels with runtime instruction set dispatch
+ */
+
+/**
+ * @namespace WaveTableSimd
+ * @brief Vectorized block lookup kernels used by WaveTable::renderBlock(),
+ * and the voice kernel mixing the oscillators of SynthTrack
+ *
+ * Each instruction set lives in its own translation unit, compiled with the
+ * matching compiler flags, and is only selected at runtime when the CPU
+ * supports it. All kernels run the same arithmetic in the same order:
+ *
+ * - Samples are processed in chunks of kChunkSize. Inside a chunk, lane i
+ *   reads position base + i * increment (plus phase modulation).
+ * - base is wrapped to [0, tableSize) once per chunk, so phase never drifts
+ *   or loses precision, whatever the block length.
+ * - Positions are wrapped with floor() and a one-sample guard at the end of
+ *   the table replaces the modulo of the interpolation index.
+ *
+ * The vector paths therefore match the scalar path bit for bit. Kernel
+ * translation units are built with -ffp-contract=off so that the compiler
+ * cannot fuse a multiply and an add in one path only.
+ *
+ * @note Table positions are in table samples, not radians
+ * @note Phase modulation is expected to stay within about ±1e6 radians.
+ * Beyond that, float positions no longer resolve a table sample.
+ */
+namespace WaveTableSimd {
+
+/** @brief Samples sharing one wrapped base position */
+constexpr int kChunkSize = 16;
+
+/**
+ * @enum Level
+ * @brief Instruction set of a kernel implementation
+ */
+enum class Level {
+  Scalar, /**< Portable C++ */
+  SSE2,   /**< 4 lanes, x86-64 baseline */
+  AVX2,   /**< 8 lanes with hardware gathers */
+  AVX512  /**< 16 lanes with hardware gathers (AVX-512F) */
+};
+
+/**
+ * @struct BlockJob
+ * @brief Arguments of a block lookup
+ */
+struct BlockJob {
+  /** @brief Table of tableSize samples followed by a copy of sample 0 */
+  const float* table;
+
+  /** @brief Number of samples in the table (excluding the guard sample) */
+  int tableSize;
+
+  /** @brief Destination, numSamples values */
+  float* output;
+
+  /** @brief Per-sample position offsets in radians, or nullptr */
+  const float* phaseModulation;
+
+  /** @brief Radians to table samples factor applied to phaseModulation */
+  float modulationScale;
+
+  /** @brief Number of samples to render */
+  int numSamples;
+
+  /** @brief Position of the first sample, in [0, tableSize) */
+  float position;
+
+  /** @brief Position increment per sample */
+  float increment;
+};
+
+/**
+ * @brief Kernel entry point
+ * @return Position following the last sample, wrapped to [0, tableSize)
+ */
+using Kernel = float (*)(const BlockJob& job);
+
+/** @brief Voices mixed side by side by the voice kernel */
+constexpr int kVoiceLanes = 16;
+
+/**
+ * @struct VoiceJob
+ * @brief Arguments of a voice mix: one chunk of many oscillators, each with
+ * its own pitch, table and gain ramp
+ *
+ * Lanes hold voices instead of samples. Voice v adds into the partial sums
+ * of lane v % kVoiceLanes, voices of a lane in increasing order, so every
+ * level produces the same partial sums. The caller adds up the lanes of
+ * each sample, in a fixed order as well.
+ */
+struct VoiceJob {
+  /** @brief Tables start; voice v reads from table + tableOffset[v] */
+  const float* table;
+
+  /** @brief Samples per table, a power of two, each followed by a guard sample */
+  int tableSize;
+
+  /** @brief Number of voices, a multiple of kVoiceLanes (padding at zero gain) */
+  int numVoices;
+
+  /** @brief Samples to render, at most kChunkSize */
+  int numSamples;
+
+  /** @brief Per voice: position of the first sample, in [0, tableSize) */
+  const float* position;
+
+  /** @brief Per voice: position increment per sample, in [0, tableSize) */
+  const float* increment;
+
+  /** @brief Per voice: gain of the first sample */
+  const float* gain;
+
+  /** @brief Per voice: gain change per sample */
+  const float* gainStep;
+
+  /** @brief Per voice: offset of its table from table */
+  const int* tableOffset;
+
+  /** @brief kChunkSize rows of kVoiceLanes partial sums, added to */
+  float* partials;
+};
+
+/** @brief Voice kernel entry point */
+using VoiceKernel = void (*)(const VoiceJob& job);
+
+/**
+ * @struct Kernels
+ * @brief Linear-interpolated and nearest-sample kernels of one level, and
+ * its voice kernel
+ */
+struct Kernels {
+  Kernel linear;
+  Kernel nearest;
+  VoiceKernel voices;
+};
+
+/**
+ * @brief Wrap a position to [0, tableSize)
+ *
+ * Used by every kernel to advance the chunk base position. Defined once in
+ * the scalar translation unit so that all levels share the exact same code.
+ */
+float wrapPosition(float position, int tableSize);
+
+/**
+ * @brief Get the kernels of a level
+ * @return The kernels, or nullptr if the level was not compiled in
+ * (ENABLE_SIMD=OFF, non-x86 target) or is not supported by this CPU
+ */
+const Kernels* getKernels(Level level);
+
+/**
+ * @brief Best level available on this machine (selected once)
+ */
+Level getBestLevel();
+
+/**
+ * @brief Kernels of the best available level
+ */
+const Kernels& getBestKernels();
+
+/**
+ * @brief Human-readable name of a level ("scalar", "sse2", "avx2", "avx512")
+ */
+const char* getLevelName(Level level);
+
+// Per-level kernel tables, defined in their own translation units
+Kernels getScalarKernels();
+Kernels getSse2Kernels();
+Kernels getAvx2Kernels();
+Kernels getAvx512Kernels();
+
+}  // namespace WaveTableSimd
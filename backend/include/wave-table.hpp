@@ -2,12 +2,8 @@
 #include <juce_core/juce_core.h>
 #include <cmath>
 #include <vector>
+#include "wave-table-simd.hpp"
 
-// TODO: [LOW] Add SIMD optimizations (SSE/AVX) for waveform generation and
-// lookup
-// TODO: [LOW] Implement bandlimited waveforms to prevent aliasing:
-//   - Use PolyBLEP (Polynomial Band-Limited Step) for square/saw/triangle
-//   - Or use additive synthesis with limited harmonics based on frequency
 // TODO: [LOW] Add cache-friendly memory layout (align table to cache line)
 // TODO: [LOW] Consider cubic interpolation for higher quality (vs current
 // linear)
@@ -24,7 +20,12 @@
  * This class stores pre-computed waveform samples in a lookup table,
  * allowing for efficient real-time audio synthesis without expensive
  * trigonometric calculations. Supports multiple waveform types and
- * provides both fast and interpolated lookup methods.
+ * provides both fast and interpolated lookup methods, per sample or per
+ * block. Block lookups run on the widest SIMD instruction set available
+ * (see WaveTableSimd).
+ *
+ * The table holds every harmonic of the waveform and aliases at high
+ * pitches; see WaveTableBank for band-limited playback.
  *
  * @note The table is computed once during construction
  * @note Thread-safe for reading after construction
@@ -42,6 +43,15 @@ class WaveTable {
     TRIANGLE /**< Triangle wave */
   };
 
+  /**
+   * @enum Interpolation
+   * @brief Lookup mode of the block methods
+   */
+  enum class Interpolation {
+    LINEAR, /**< Linear interpolation, same as getSample() */
+    NEAREST /**< No interpolation, same as getSampleFast() */
+  };
+
   /**
    * @brief Construct a new WaveTable
    * @param type The waveform type to generate
@@ -51,8 +61,11 @@ class WaveTable {
    * A size of 2048 is typically sufficient for most applications.
    */
   explicit WaveTable(WaveType type = WaveType::SINE, int tableSize = 2048)
-      : size(tableSize) {
-    table.resize(size);
+      : size(tableSize),
+        phaseToIndex((float)tableSize /
+                     (2.0f * juce::MathConstants<float>::pi)) {
+    // One guard sample so interpolation never has to wrap its second index
+    table.resize(size + 1);
     float pi = juce::MathConstants<float>::pi;
 
     for (int i = 0; i < size; ++i) {
@@ -76,6 +89,8 @@ class WaveTable {
           break;
       }
     }
+
+    table[size] = table[0];
   }
 
   /**
@@ -86,22 +101,14 @@ class WaveTable {
    * This method uses linear interpolation between adjacent samples
    * for better audio quality. Phase wrapping is handled automatically.
    * @todo [LOW] Add cubic interpolation option for higher quality
-   * @todo [LOW] Optimize phase wrapping (currently uses while loops)
    */
   float getSample(float phase) const {
-    float index =
-        (phase / (2.0f * juce::MathConstants<float>::pi)) * (float)size;
-
-    while (index >= size)
-      index -= size;
-    while (index < 0)
-      index += size;
+    float index = toTableIndex(phase);
 
     auto index0 = (int)index;
-    int index1 = (index0 + 1) % size;
     float frac = index - (float)index0;
 
-    return table[index0] + frac * (table[index1] - table[index0]);
+    return table[index0] + frac * (table[index0 + 1] - table[index0]);
   }
 
   /**
@@ -114,19 +121,78 @@ class WaveTable {
    * Phase wrapping is handled automatically.
    */
   float getSampleFast(float phase) const {
-    float index =
-        (phase / (2.0f * juce::MathConstants<float>::pi)) * (float)size;
-    while (index >= size)
-      index -= size;
-    while (index < 0)
-      index += size;
-    return table[(int)index];
+    return table[(int)toTableIndex(phase)];
+  }
+
+  /**
+   * @brief Fill a block of samples from a phase and a phase increment
+   * @param output Destination for numSamples samples
+   * @param numSamples Number of samples to render
+   * @param phase Phase of the first sample in radians (any value)
+   * @param phaseIncrement Phase advance per sample in radians (may be
+   * negative)
+   * @param interpolation Linear or nearest-sample lookup
+   * @return Phase following the last sample, wrapped to [0, 2π)
+   *
+   * Equivalent to calling getSample() or getSampleFast() with an advancing
+   * phase, without per-sample wrapping loops. The phase is kept in table
+   * units and re-wrapped every WaveTableSimd::kChunkSize samples, so long
+   * blocks do not lose precision.
+   */
+  float renderBlock(float* output, int numSamples, float phase,
+                    float phaseIncrement,
+                    Interpolation interpolation = Interpolation::LINEAR) const {
+    return renderBlock(output, nullptr, numSamples, phase, phaseIncrement,
+                       interpolation);
+  }
+
+  /**
+   * @brief Fill a block of samples with per-sample phase modulation
+   * @param output Destination for numSamples samples
+   * @param phaseModulation Phase offset in radians added to each sample
+   * (not accumulated), or nullptr
+   * @param numSamples Number of samples to render
+   * @param phase Phase of the first sample in radians (any value)
+   * @param phaseIncrement Phase advance per sample in radians
+   * @param interpolation Linear or nearest-sample lookup
+   * @return Unmodulated phase following the last sample, wrapped to [0, 2π)
+   */
+  float renderBlock(float* output, const float* phaseModulation,
+                    int numSamples, float phase, float phaseIncrement,
+                    Interpolation interpolation = Interpolation::LINEAR) const {
+    WaveTableSimd::BlockJob job;
+    job.table = table.data();
+    job.tableSize = size;
+    job.output = output;
+    job.phaseModulation = phaseModulation;
+    job.modulationScale = phaseToIndex;
+    job.numSamples = numSamples;
+    job.position = WaveTableSimd::wrapPosition(phase * phaseToIndex, size);
+    job.increment = phaseIncrement * phaseToIndex;
+
+    const auto& kernels = WaveTableSimd::getBestKernels();
+    const float position = interpolation == Interpolation::LINEAR
+                               ? kernels.linear(job)
+                               : kernels.nearest(job);
+    return position / phaseToIndex;
   }
 
  private:
-  /** @brief Pre-computed waveform samples */
+  /** @brief Phase in radians to a table position in [0, size) */
+  float toTableIndex(float phase) const {
+    const float index = phase * phaseToIndex;
+    if (index >= 0.0f && index < (float)size) {
+      return index;
+    }
+    return WaveTableSimd::wrapPosition(index, size);
+  }
+
+  /** @brief Pre-computed waveform samples, plus a copy of the first one */
   std::vector<float> table;  // TODO: [LOW] Align to 16/32 bytes for SIMD
 
-  /** @brief Number of samples in the table */
+  /** @brief Number of samples in the table (excluding the guard sample) */
   int size;
+
+  /** @brief Radians to table samples */
+  float phaseToIndex;
 };
\ No newline at end of file
@@ -1,21 +1,122 @@
 #pragma once
 
 #include <crow.h>
+#include <array>
 #include <atomic>
-#include <iostream>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
+#include "audio-engine-core.hpp"
+#include "audio-effect.hpp"
+#include "control-protocol.hpp"
+#include "pattern-track.hpp"
 
 /**
  * WebSocketServer - Simple WebSocket server using Crow
  *
  * This class encapsulates a Crow HTTP/WebSocket server that runs on a separate
- * thread. For now, it just accepts connections and logs events - no business
- * logic yet.
+ * thread. Text messages are JSON commands controlling the audio engine:
+ *   {"type": "addTrack", "frequency": 440}
+ *   {"type": "addSampleTrack", "path": "drums.wav", "start": 2.5}
+ *   {"type": "addSampleTrack", "path": "kick.wav", "cache": true}
+ *   {"type": "addSynthTrack", "voices": 256, "waveform": "saw", "steal": "oldest"}
+ *   {"type": "addPatternTrack", "voices": 32, "waveform": "square"}
+ *   {"type": "removeTrack", "index": 0}
+ *   {"type": "render", "path": "/tmp/mix.wav", "duration": 60, "bitDepth": 24,
+ *    "sampleRate": 48000}
+ * Renders run one at a time on a render thread: "render" is answered with
+ * "renderQueued" at once, then "renderComplete" (or "error", with the
+ * "path") once the file is written.
+ *
+ * Parameter and transport changes are queued to the audio thread, applied
+ * immediately or on the exact sample of an optional "time" (seconds) or
+ * "beat" field:
+ *   {"type": "setVolume", "index": 0, "value": 0.5, "beat": 16}
+ *   {"type": "setMute", "index": 0, "value": true}
+ *   {"type": "setPan", "index": 0, "value": -0.5}
+ *   {"type": "setMasterVolume", "value": 0.8}
+ *   {"type": "play"} / {"type": "stop"} / {"type": "seek", "time": 30}
+ *   {"type": "noteOn", "index": 1, "note": 60, "velocity": 0.8, "beat": 4}
+ *   {"type": "noteOff", "index": 1, "note": 60, "beat": 5}
+ *   {"type": "setMidiInput", "index": 1, "value": true}
+ * The reply carries the command id; "appliedCommand" in later replies tells
+ * which commands the audio thread has applied.
+ *
+ * Tracks can be grouped on submix buses with insert effects and sends
+ * ("output" -1 or absent is the master; "effects" replaces the whole chain,
+ * of the master without "bus"):
+ *   {"type": "addBus", "name": "Drums", "output": -1}
+ *   {"type": "removeBus", "index": 0}
+ *   {"type": "routeTrack", "index": 2, "output": 0}
+ *   {"type": "routeBus", "index": 0, "output": 1}
+ *   {"type": "addSend", "track": 2, "destination": 1, "level": 0.3}
+ *   {"type": "removeSend", "index": 0}
+ *   {"type": "setEffects", "bus": 1, "effects": [
+ *     {"type": "delay", "time": 0.375, "feedback": 0.4, "wet": 0.5},
+ *     {"type": "lowpass", "cutoff": 2000, "q": 0.707},
+ *     {"type": "limiter", "ceiling": 0.9, "lookahead": 0.005, "release": 0.1}]}
+ * Effects with lookahead delay their bus; the other paths are delayed to
+ * match, and every reply carries the resulting "latency" in samples.
+ * Bus and send parameters are queued like track parameters:
+ *   {"type": "setBusVolume", "index": 0, "value": 0.8}
+ *   {"type": "setBusMute", "index": 0, "value": true}
+ *   {"type": "setBusPan", "index": 0, "value": 0.2}
+ *   {"type": "setSendLevel", "index": 0, "value": 0.5}
+ *
+ * Pattern tracks play steps compiled against the tempo map. Setting a
+ * pattern swaps it in at the next block, while the notes of the old one
+ * end on their own sample ({} is a rest):
+ *   {"type": "setPattern", "index": 1, "stepBeats": 0.25, "swing": 0.33,
+ *    "startBeat": 0, "steps": [
+ *     {"note": 36, "velocity": 1.0, "length": 0.5}, {},
+ *     {"note": 38, "velocity": 0.7, "length": 2, "swing": 0.1}]}
+ * Anything else is echoed back.
+ *
+ * JSON is meant for debugging. High-rate clients (fader drags, automation
+ * writes) send {"type": "hello", "binary": [1]} and then binary frames (see
+ * ControlProtocol), each answered with a binary Status frame. JSON commands
+ * are logged when setLogMessages() is on, binary messages never.
+ *
+ * Level meters are pushed to subscribed clients:
+ *   {"type": "subscribeMeters", "rate": 30, "ack": true}
+ *   {"type": "unsubscribeMeters"}
+ * A meter thread reads the engine's newest MeterFrame at the server rate
+ * (setMeterRate()) and sends it to each subscriber at its own rate, as JSON
+ * {"type": "meters", "sequence", "position", "master": [[peak, truePeak,
+ * rms], [...]], "tracks": [...]} or as a binary Meters frame. Clients which
+ * set "ack" answer each frame with {"type": "meterAck", "sequence": n} (or a
+ * binary MeterAck); while kMaxUnackedMeters frames are unanswered, frames
+ * are coalesced (highest peaks kept) instead of queued behind a slow link.
+ *
+ * Binary clients can also stream spectra and oscilloscope waveforms of the
+ * master output or of up to AnalysisTap::kMaxTrackTaps tracks:
+ *   {"type": "subscribeAnalysis", "track": 0, "fftSize": 4096,
+ *    "scopePoints": 512, "rate": 30}
+ *   {"type": "unsubscribeAnalysis", "id": 1}
+ * Without "track" the master is analysed; "fftSize" 0 or "scopePoints" 0
+ * turns that part off. The reply ("analysisSubscribed") carries the granted
+ * values and the subscription id found in every Spectrum and Scope frame.
+ * The audio thread only copies samples to the engine's AnalysisTap; an
+ * analysis thread drains it, runs the FFTs and decimates the waveform. Each
+ * Scope frame covers the samples since the previous one.
+ *
+ * The engine profile (callback duration, DSP load, missed deadlines, and
+ * per-track render times when detailed timing is on) is served in the
+ * Prometheus text format on GET /metrics, and pushed as JSON summaries of
+ * each interval to subscribers:
+ *   {"type": "subscribeProfile", "rate": 1}
+ *   {"type": "unsubscribeProfile"}
+ *   {"type": "setProfiling", "enabled": true, "detailed": true}
  */
 class WebSocketServer {
  public:
-  WebSocketServer() : running_(false), thread_exited_(false) {}
+  explicit WebSocketServer(AudioEngineCore& engine)
+      : engine_(engine), running_(false), thread_exited_(false) {}
 
   ~WebSocketServer() { stop(); }
 
@@ -23,95 +124,240 @@ class WebSocketServer {
    * Start the WebSocket server on the specified port
    * The server runs on a separate thread to not block the audio engine
    */
-  void start(uint16_t port = 8080) {
-    if (running_.load()) {
-      std::cerr << "[WebSocket] Server already running" << std::endl;
-      return;
-    }
+  void start(uint16_t port = 8080);
 
-    port_ = port;
-    running_.store(true);
+  /**
+   * Stop the WebSocket server gracefully
+   */
+  void stop();
 
-    // Launch server on separate thread
-    server_thread_ = std::thread([this]() { this->run(); });
+  bool isRunning() const { return running_.load(); }
 
-    std::cout << "[WebSocket] Server starting on port " << port_ << std::endl;
-  }
+  /** Frames not acknowledged before a client's meters are coalesced */
+  static constexpr juce::uint32 kMaxUnackedMeters = 4;
 
   /**
-   * Stop the WebSocket server gracefully
+   * Set how often the meter thread reads the engine (Hz), which is also the
+   * highest rate a client can subscribe to
    */
-  void stop() {
-    if (!running_.load() && !server_thread_.joinable()) {
-      return;
-    }
-
-    std::cout << "[WebSocket] Stopping server..." << std::endl;
-
-    if (app_ && running_.load()) {
-      try {
-        app_->stop();
-      } catch (...) {
-        // Ignore exceptions during shutdown
-      }
-    }
-
-    if (server_thread_.joinable()) {
-      try {
-        server_thread_.join();
-      } catch (...) {
-        // Ignore exceptions during thread join
-      }
-    }
-
-    running_.store(false);
-    std::cout << "[WebSocket] Server stopped" << std::endl;
+  void setMeterRate(double rate) {
+    meterRate_.store(juce::jlimit(1.0, 1000.0, rate));
   }
 
-  bool isRunning() const { return running_.load(); }
+  double getMeterRate() const { return meterRate_.load(); }
+
+  /** Print every JSON command received (off by default) */
+  void setLogMessages(bool shouldLog) {
+    logMessages_.store(shouldLog, std::memory_order_relaxed);
+  }
+
+  /** Highest profile summary rate of a subscription (Hz) */
+  static constexpr double kMaxProfileRate = 10.0;
+
+  /** Highest spectrum and scope frame rate of a subscription (Hz) */
+  static constexpr double kMaxAnalysisRate = 60.0;
+
+  /** Most columns in a Scope frame */
+  static constexpr int kMaxScopePoints = 4096;
+
+  /** Analysis subscriptions of all clients together */
+  static constexpr size_t kMaxAnalysisSubscriptions = 32;
+
+  /** Renders waiting for the render thread, all clients together */
+  static constexpr size_t kMaxQueuedRenders = 8;
 
   // Check if server thread has exited (e.g., due to Ctrl+C)
   bool hasExited() const { return thread_exited_.load(); }
 
  private:
-  void run() {
-    app_ = std::make_unique<crow::SimpleApp>();
-
-    // WebSocket endpoint
-    CROW_WEBSOCKET_ROUTE((*app_), "/ws")
-        .onopen([](crow::websocket::connection& conn) {
-          std::cout << "[WebSocket] Client connected" << std::endl;
-        })
-        .onclose(
-            [](crow::websocket::connection& conn, const std::string& reason) {
-              std::cout << "[WebSocket] Client disconnected: " << reason
-                        << std::endl;
-            })
-        .onmessage([](crow::websocket::connection& conn,
-                      const std::string& data, bool is_binary) {
-          std::cout << "[WebSocket] Received message: " << data << std::endl;
-          // Echo back for now
-          conn.send_text("Echo: " + data);
-        })
-        .onerror(
-            [](crow::websocket::connection& conn, const std::string& error) {
-              std::cerr << "[WebSocket] Error: " << error << std::endl;
-            });
-
-    // Simple HTTP endpoint for health check
-    CROW_ROUTE((*app_), "/health")
-    ([]() { return crow::response(200, "OK"); });
-
-    // Run the server (blocking call)
-    app_->port(port_).multithreaded().run();
-
-    thread_exited_.store(true);
-    std::cout << "[WebSocket] Server thread exited" << std::endl;
+  // Per-connection state, owned through the connection's userdata
+  struct ConnectionState {
+    // Binary version negotiated by "hello", 0 for JSON only
+    int binaryVersion = 0;
+    // Reused binary reply buffer (no allocation once grown)
+    std::string reply;
+
+    // Meter subscription, guarded by meterMutex_
+    bool metersSubscribed = false;
+    bool acknowledgesMeters = false;
+    std::chrono::steady_clock::duration meterPeriod{};
+    std::chrono::steady_clock::time_point nextMeterSend{};
+    juce::uint32 lastSentMeters = 0;
+    juce::uint32 lastAckedMeters = 0;
+    // Frames read since the last send, coalesced
+    bool hasPendingMeters = false;
+    MeterFrame pendingMeters;
+    std::string meterMessage;
+
+    // Profile subscription, guarded by meterMutex_
+    bool profileSubscribed = false;
+    std::chrono::steady_clock::duration profilePeriod{};
+    std::chrono::steady_clock::time_point nextProfileSend{};
+    // Profile at the previous summary, so each one covers its own interval
+    ProfileSnapshot lastProfile;
+  };
+
+  // Offline render requested by a client, guarded by renderMutex_
+  struct RenderJob {
+    crow::websocket::connection* conn = nullptr;
+    OfflineRenderer::Settings settings;
+  };
+
+  // Spectrum and scope stream of one client, guarded by analysisMutex_
+  struct AnalysisSubscription {
+    juce::uint32 id = 0;
+    crow::websocket::connection* conn = nullptr;
+    int source = AnalysisTap::kMasterSource;
+    // Held so the tapped address cannot be reused by another track
+    std::shared_ptr<AudioTrack> track;
+    // Null when the client asked for no spectrum
+    std::unique_ptr<SpectrumAnalyzer> spectrum;
+    int scopePoints = 0;
+    // Source position of the first sample of the next Scope frame
+    juce::uint64 scopeStart = 0;
+    juce::uint64 lastEnd = 0;
+    std::chrono::steady_clock::duration period{};
+    std::chrono::steady_clock::time_point nextSend{};
+    juce::uint32 sequence = 0;
+    // Work buffers, allocated once at subscription
+    std::vector<float> samples;
+    std::vector<float> magnitudes;
+    std::vector<float> minimums;
+    std::vector<float> maximums;
+    std::string message;
+  };
+
+  static ConnectionState& getState(crow::websocket::connection& conn) {
+    return *static_cast<ConnectionState*>(conn.userdata());
   }
 
+  void run();
+
+  // Apply a JSON command to the engine and build the reply.
+  // Runs on a Crow worker thread: engine track edits never block audio.
+  // An empty reply is not sent.
+  std::string handleMessage(crow::websocket::connection& conn,
+                            const std::string& data);
+
+  // Print a received JSON message if logging is on
+  void logMessage(const std::string& data) const;
+
+  // Apply a JSON routing edit (buses, outputs, sends, insert chains)
+  void editRouting(const std::string& type, const crow::json::rvalue& message,
+                   crow::json::wvalue& reply);
+
+  // Oscillator of a synth or pattern track ("waveform", saw by default)
+  static WaveTable::WaveType getWaveform(const crow::json::rvalue& message);
+
+  // Pattern of a setPattern message. Steps without a note or velocity are
+  // rests.
+  static Pattern parsePattern(const crow::json::rvalue& message);
+
+  // Effect described by a JSON object, or nullptr if the type is unknown
+  static std::shared_ptr<AudioEffect> makeEffect(const crow::json::rvalue& description);
+
+  // Answer a "hello": switch the connection to the highest binary version
+  // both sides support, or stay on JSON
+  std::string negotiate(ConnectionState& state,
+                        const crow::json::rvalue& message);
+
+  // Queue every record of a binary Commands frame and build the Status reply.
+  // A MeterAck gets no reply (empty).
+  const std::string& handleBinaryMessage(ConnectionState& state,
+                                         const std::string& data);
+
+  // Send a JSON parameter or transport change to the audio thread
+  void queueCommand(const std::string& type, const crow::json::rvalue& message,
+                    crow::json::wvalue& reply);
+
+  // Build an EngineCommand and send it to the audio thread (both formats).
+  // For Seek, sample is the target position.
+  ControlProtocol::Error queueCommand(ControlProtocol::Op op, juce::uint32 track,
+                                      double value, juce::int64 sample,
+                                      juce::uint32 id, int note = 0);
+
+  // Transport sample of the "beat" or "time" field, or immediate
+  juce::int64 getCommandSample(const crow::json::rvalue& message) const;
+
+  static juce::int64 getCommandSample(const TempoMap& tempoMap,
+                                      ControlProtocol::Timing timing,
+                                      double when);
+
+  // Add a connection to the meter subscribers; returns the granted rate
+  double subscribeMeters(crow::websocket::connection& conn, double rate,
+                         bool acknowledges);
+
+  void unsubscribeMeters(crow::websocket::connection& conn);
+
+  void acknowledgeMeters(ConnectionState& state, juce::uint32 sequence);
+
+  // Add a connection to the profile subscribers; returns the granted rate
+  double subscribeProfile(crow::websocket::connection& conn, double rate);
+
+  void unsubscribeProfile(crow::websocket::connection& conn);
+
+  // Send the profile summaries that are due (meter thread)
+  void sendProfiles(std::chrono::steady_clock::time_point now);
+
+  // Meter thread: the only reader of the engine's meter frames, also sends
+  // profile summaries
+  void runMeters();
+
+  // Encode and send the pending frame of a subscriber
+  void sendMeters(crow::websocket::connection& conn, ConnectionState& state);
+
+  // Start streaming spectra and/or scope frames of the master or a track
+  void subscribeAnalysis(crow::websocket::connection& conn,
+                         const crow::json::rvalue& message,
+                         crow::json::wvalue& reply);
+
+  // Remove one subscription of a connection, or all of them with id 0.
+  // Sources nobody analyses any more stop being copied.
+  bool unsubscribeAnalysis(crow::websocket::connection& conn, juce::uint32 id);
+
+  // Analysis thread: the only reader of the engine's analysis tap
+  void runAnalysis();
+
+  // Analyse the newest samples of a subscription's source and send them
+  void sendAnalysis(AnalysisSubscription& subscription, double sampleRate);
+
+  // Queue an offline render of the session; false if the queue is full
+  bool queueRender(crow::websocket::connection& conn,
+                   OfflineRenderer::Settings settings);
+
+  // Drop the renders of a closing connection; a running one still
+  // finishes, without a reply
+  void cancelRenders(crow::websocket::connection& conn);
+
+  // Render thread: bounces queued sessions one at a time and replies
+  void runRenders();
+
+  AudioEngineCore& engine_;
   std::unique_ptr<crow::SimpleApp> app_;
   std::thread server_thread_;
+  std::thread meter_thread_;
+  std::mutex meterMutex_;
+  std::condition_variable meterWakeup_;
+  std::vector<crow::websocket::connection*> meterSubscribers_;
+  std::vector<crow::websocket::connection*> profileSubscribers_;
+  ProfileSnapshot profileSnapshot_;
+  std::atomic<double> meterRate_{30.0};
+  std::atomic<bool> logMessages_{false};
+  std::thread analysis_thread_;
+  std::mutex analysisMutex_;
+  std::condition_variable analysisWakeup_;
+  std::vector<std::unique_ptr<AnalysisSubscription>> analysisSubscriptions_;
+  std::array<AnalysisHistory, AnalysisTap::kNumSources> analysisHistories_;
+  std::array<bool, AnalysisTap::kNumSources> analysisSourceActive_{};
+  juce::uint32 nextAnalysisId_ = 0;
+  std::thread render_thread_;
+  std::mutex renderMutex_;
+  std::condition_variable renderWakeup_;
+  std::deque<RenderJob> renderJobs_;
+  // Connection of the running render, null once it closed
+  crow::websocket::connection* renderingConn_ = nullptr;
   std::atomic<bool> running_;
   std::atomic<bool> thread_exited_;
+  std::atomic<juce::uint32> nextCommandId_{0};
   uint16_t port_;
 };
@@ -0,0 +1,223 @@
+#include "analysis-tap.hpp"
+#include <algorithm>
+#include <cstring>
+
+//==============================================================================
+AnalysisTap::AnalysisTap(int fifoSamples) {
+  for (auto& source : sources) {
+    source = std::make_unique<Source>(fifoSamples);
+  }
+}
+
+void AnalysisTap::setMasterActive(bool active) noexcept {
+  sources[kMasterSource]->active.store(active, std::memory_order_release);
+}
+
+void AnalysisTap::setTrackSource(int source, const AudioTrack* track) noexcept {
+  jassert(source > kMasterSource && source < kNumSources);
+  auto& slot = *sources[(size_t)source];
+
+  const auto* previous = slot.track.exchange(track, std::memory_order_acq_rel);
+  slot.active.store(track != nullptr, std::memory_order_release);
+  if (previous == nullptr && track != nullptr) {
+    numTrackTaps.fetch_add(1, std::memory_order_acq_rel);
+  } else if (previous != nullptr && track == nullptr) {
+    numTrackTaps.fetch_sub(1, std::memory_order_acq_rel);
+  }
+}
+
+void AnalysisTap::pushMaster(const juce::AudioBuffer<float>& buffer,
+                             int startSample, int numSamples) noexcept {
+  auto& master = *sources[kMasterSource];
+  if (!master.active.load(std::memory_order_acquire) ||
+      buffer.getNumChannels() == 0) {
+    return;
+  }
+
+  if (buffer.getNumChannels() == 1) {
+    write(master, buffer.getReadPointer(0, startSample), nullptr, 1.0f,
+          numSamples);
+  } else {
+    write(master, buffer.getReadPointer(0, startSample),
+          buffer.getReadPointer(1, startSample), 0.5f, numSamples);
+  }
+}
+
+void AnalysisTap::pushTrack(const AudioTrack& track, const float* samples,
+                            int numSamples) noexcept {
+  for (int i = kMasterSource + 1; i < kNumSources; ++i) {
+    auto& source = *sources[(size_t)i];
+    if (source.track.load(std::memory_order_acquire) == &track) {
+      write(source, samples, nullptr, 1.0f, numSamples);
+    }
+  }
+}
+
+void AnalysisTap::write(Source& source, const float* a, const float* b,
+                        float gain, int numSamples) noexcept {
+  int start1, size1, start2, size2;
+  source.fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+  const int written = size1 + size2;
+  if (written < numSamples) {
+    source.dropped.fetch_add((juce::uint64)(numSamples - written),
+                             std::memory_order_relaxed);
+  }
+
+  auto copy = [&](float* destination, int offset, int count) {
+    for (int i = 0; i < count; ++i) {
+      const float sample = b != nullptr ? a[offset + i] + b[offset + i]
+                                        : a[offset + i];
+      destination[i] = sample * gain;
+    }
+  };
+  copy(source.samples.data() + start1, 0, size1);
+  copy(source.samples.data() + start2, size1, size2);
+
+  source.fifo.finishedWrite(written);
+}
+
+int AnalysisTap::read(int source, float* destination, int maxSamples) noexcept {
+  auto& slot = *sources[(size_t)source];
+  int start1, size1, start2, size2;
+  slot.fifo.prepareToRead(maxSamples, start1, size1, start2, size2);
+
+  if (size1 > 0) {
+    std::memcpy(destination, slot.samples.data() + start1,
+                sizeof(float) * (size_t)size1);
+  }
+  if (size2 > 0) {
+    std::memcpy(destination + size1, slot.samples.data() + start2,
+                sizeof(float) * (size_t)size2);
+  }
+
+  slot.fifo.finishedRead(size1 + size2);
+  return size1 + size2;
+}
+
+void AnalysisTap::discard(int source) noexcept {
+  auto& fifo = sources[(size_t)source]->fifo;
+  fifo.finishedRead(fifo.getNumReady());
+}
+
+//==============================================================================
+void AnalysisHistory::drain(AnalysisTap& tap, int source) noexcept {
+  for (;;) {
+    const int writeIndex = (int)(end % (juce::uint64)kCapacity);
+    const int space = kCapacity - writeIndex;
+    const int count = tap.read(source, samples.data() + writeIndex, space);
+    end += (juce::uint64)count;
+    if (count < space) {
+      return;
+    }
+  }
+}
+
+void AnalysisHistory::append(const float* data, int numSamples) noexcept {
+  while (numSamples > 0) {
+    const int writeIndex = (int)(end % (juce::uint64)kCapacity);
+    const int count = std::min(numSamples, kCapacity - writeIndex);
+    std::memcpy(samples.data() + writeIndex, data, sizeof(float) * (size_t)count);
+    end += (juce::uint64)count;
+    data += count;
+    numSamples -= count;
+  }
+}
+
+void AnalysisHistory::reset() noexcept {
+  end = 0;
+}
+
+void AnalysisHistory::copyLatest(float* destination,
+                                 int numSamples) const noexcept {
+  jassert(numSamples <= kCapacity);
+
+  // Silence before the first sample
+  const int available = (int)std::min<juce::uint64>(end, (juce::uint64)numSamples);
+  const int silence = numSamples - available;
+  std::fill(destination, destination + silence, 0.0f);
+
+  copyFrom(end - (juce::uint64)available, destination + silence);
+}
+
+int AnalysisHistory::copyFrom(juce::uint64 first,
+                              float* destination) const noexcept {
+  first = std::max(first, getStart());
+  int copied = 0;
+
+  while (first < end) {
+    const int readIndex = (int)(first % (juce::uint64)kCapacity);
+    const int count = (int)std::min<juce::uint64>(
+        end - first, (juce::uint64)(kCapacity - readIndex));
+    std::memcpy(destination + copied, samples.data() + readIndex,
+                sizeof(float) * (size_t)count);
+    first += (juce::uint64)count;
+    copied += count;
+  }
+  return copied;
+}
+
+//==============================================================================
+SpectrumAnalyzer::SpectrumAnalyzer(int order)
+    : fft(juce::jlimit(kMinOrder, kMaxOrder, order)) {
+  const int size = fft.getSize();
+  window.resize((size_t)size);
+  juce::dsp::WindowingFunction<float>::fillWindowingTables(
+      window.data(), (size_t)size,
+      juce::dsp::WindowingFunction<float>::hann, false);
+
+  // A sine of amplitude A peaks at A * sum(window) / 2
+  double windowSum = 0.0;
+  for (const float w : window) {
+    windowSum += w;
+  }
+  scale = (float)(2.0 / windowSum);
+
+  // performFrequencyOnlyForwardTransform() works in place on 2 * size floats
+  workspace.resize((size_t)size * 2);
+}
+
+int SpectrumAnalyzer::getOrderForSize(int fftSize) noexcept {
+  int order = kMinOrder;
+  while (order < kMaxOrder && (1 << order) < fftSize) {
+    ++order;
+  }
+  return order;
+}
+
+void SpectrumAnalyzer::process(const float* samples,
+                               float* magnitudesDb) noexcept {
+  const int size = getSize();
+  for (int i = 0; i < size; ++i) {
+    workspace[(size_t)i] = samples[i] * window[(size_t)i];
+  }
+  std::fill(workspace.begin() + size, workspace.end(), 0.0f);
+
+  fft.performFrequencyOnlyForwardTransform(workspace.data(), true);
+
+  const int numBins = getNumBins();
+  for (int bin = 0; bin < numBins; ++bin) {
+    magnitudesDb[bin] =
+        juce::Decibels::gainToDecibels(workspace[(size_t)bin] * scale, kFloorDb);
+  }
+}
+
+//==============================================================================
+void decimateScope(const float* samples, int numSamples, float* minimums,
+                   float* maximums, int numPoints) noexcept {
+  jassert(numPoints > 0 && numSamples >= numPoints);
+
+  for (int point = 0; point < numPoints; ++point) {
+    const int first = (int)((juce::int64)point * numSamples / numPoints);
+    const int last = (int)((juce::int64)(point + 1) * numSamples / numPoints);
+
+    float low = samples[first];
+    float high = samples[first];
+    for (int i = first + 1; i < last; ++i) {
+      low = std::min(low, samples[i]);
+      high = std::max(high, samples[i]);
+    }
+    minimums[point] = low;
+    maximums[point] = high;
+  }
+}
@@ -0,0 +1,209 @@
+#include "audio-effect.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+DelayEffect::DelayEffect(double delaySeconds, float feedback, float wet)
+    : delaySeconds(juce::jlimit(1.0e-3, kMaxDelaySeconds, delaySeconds)),
+      feedback(juce::jlimit(0.0f, kMaxFeedback, feedback)),
+      wet(juce::jlimit(0.0f, 1.0f, wet)) {}
+
+void DelayEffect::prepare(double sampleRate, int) {
+  const int length = (int)std::ceil(kMaxDelaySeconds * sampleRate) + 1;
+  if (length != lineLength) {
+    lineLength = length;
+    for (auto& line : lines) {
+      line.assign((size_t)lineLength, 0.0f);
+    }
+  }
+  delaySamples = juce::jlimit(1, lineLength - 1, (int)std::lround(delaySeconds * sampleRate));
+  reset();
+}
+
+void DelayEffect::process(float* const* channels, int numSamples) noexcept {
+  if (lineLength == 0) {
+    return;  // Not prepared
+  }
+
+  for (int channel = 0; channel < 2; ++channel) {
+    float* line = lines[channel].data();
+    float* samples = channels[channel];
+    int write = writePosition;
+    int read = write - delaySamples;
+    if (read < 0) {
+      read += lineLength;
+    }
+
+    for (int i = 0; i < numSamples; ++i) {
+      const float delayed = line[read];
+      line[write] = samples[i] + delayed * feedback;
+      samples[i] += delayed * wet;
+      if (++write == lineLength) {
+        write = 0;
+      }
+      if (++read == lineLength) {
+        read = 0;
+      }
+    }
+  }
+
+  writePosition = (writePosition + numSamples) % juce::jmax(1, lineLength);
+}
+
+void DelayEffect::reset() noexcept {
+  for (auto& line : lines) {
+    std::fill(line.begin(), line.end(), 0.0f);
+  }
+  writePosition = 0;
+}
+
+int DelayEffect::getTailSamples() const noexcept {
+  if (wet == 0.0f) {
+    return 0;
+  }
+  // Repeats until the last one is below -100 dB
+  const double repeats =
+      feedback > 0.0f ? std::ceil(std::log(1.0e-5) / std::log((double)feedback)) : 1.0;
+  return (int)juce::jmin(repeats * delaySamples, (double)std::numeric_limits<int>::max());
+}
+
+std::unique_ptr<AudioEffect> DelayEffect::clone() const {
+  return std::make_unique<DelayEffect>(delaySeconds, feedback, wet);
+}
+
+BiquadFilter::BiquadFilter(Type type, double cutoff, double q)
+    : type(type), cutoff(juce::jmax(1.0, cutoff)), q(juce::jmax(0.1, q)) {}
+
+void BiquadFilter::prepare(double newSampleRate, int) {
+  sampleRate = newSampleRate;
+
+  const double frequency = juce::jmin(cutoff, 0.49 * sampleRate);
+  const double omega = 2.0 * juce::MathConstants<double>::pi * frequency / sampleRate;
+  const double cosine = std::cos(omega);
+  const double alpha = std::sin(omega) / (2.0 * q);
+  const double a0 = 1.0 + alpha;
+
+  const double side = type == Type::LowPass ? (1.0 - cosine) / 2.0 : (1.0 + cosine) / 2.0;
+  b0 = (float)(side / a0);
+  b1 = (float)((type == Type::LowPass ? 2.0 : -2.0) * side / a0);
+  b2 = b0;
+  a1 = (float)(-2.0 * cosine / a0);
+  a2 = (float)((1.0 - alpha) / a0);
+  reset();
+}
+
+void BiquadFilter::process(float* const* channels, int numSamples) noexcept {
+  for (int channel = 0; channel < 2; ++channel) {
+    float* samples = channels[channel];
+    float s1 = state[channel][0];
+    float s2 = state[channel][1];
+    for (int i = 0; i < numSamples; ++i) {
+      const float input = samples[i];
+      const float output = b0 * input + s1;
+      s1 = b1 * input - a1 * output + s2;
+      s2 = b2 * input - a2 * output;
+      samples[i] = output;
+    }
+    state[channel][0] = s1;
+    state[channel][1] = s2;
+  }
+}
+
+void BiquadFilter::reset() noexcept {
+  for (auto& channel : state) {
+    channel[0] = channel[1] = 0.0f;
+  }
+}
+
+int BiquadFilter::getTailSamples() const noexcept {
+  // Time constant of the poles, Q / (pi * f), about 11.5 of them for 100 dB
+  const double frequency = juce::jmin(cutoff, 0.49 * sampleRate);
+  const double timeConstant =
+      juce::jmax(q, 0.5) / (juce::MathConstants<double>::pi * frequency);
+  return (int)std::ceil(11.5 * timeConstant * sampleRate) + 2;
+}
+
+std::unique_ptr<AudioEffect> BiquadFilter::clone() const {
+  return std::make_unique<BiquadFilter>(type, cutoff, q);
+}
+
+LimiterEffect::LimiterEffect(float ceiling, double lookaheadSeconds, double releaseSeconds)
+    : ceiling(juce::jlimit(1.0e-3f, 1.0f, ceiling)),
+      lookaheadSeconds(juce::jlimit(1.0e-4, kMaxLookaheadSeconds, lookaheadSeconds)),
+      releaseSeconds(juce::jmax(1.0e-3, releaseSeconds)) {}
+
+void LimiterEffect::prepare(double sampleRate, int) {
+  lookaheadSamples = juce::jmax(1, (int)std::lround(lookaheadSeconds * sampleRate));
+  windowLength = lookaheadSamples + 1;
+  releaseCoefficient = (float)(1.0 - std::exp(-1.0 / (releaseSeconds * sampleRate)));
+
+  for (auto& line : lines) {
+    line.assign((size_t)lookaheadSamples, 0.0f);
+  }
+  minimumGains.assign((size_t)windowLength, 1.0f);
+  minimumTimes.assign((size_t)windowLength, 0);
+  history.assign((size_t)windowLength, 1.0f);
+  reset();
+}
+
+void LimiterEffect::process(float* const* channels, int numSamples) noexcept {
+  if (history.empty()) {
+    return;  // Not prepared
+  }
+
+  const float inverseLength = 1.0f / (float)windowLength;
+  for (int i = 0; i < numSamples; ++i, ++time) {
+    const float left = channels[0][i];
+    const float right = channels[1][i];
+    const float peak = juce::jmax(std::abs(left), std::abs(right));
+    const float needed = peak > ceiling ? ceiling / peak : 1.0f;
+
+    // Sliding minimum: drop the gain leaving the window, and the larger
+    // gains the new one hides
+    if (minimumCount > 0 && minimumTimes[(size_t)minimumFirst] <= time - windowLength) {
+      minimumFirst = (minimumFirst + 1) % windowLength;
+      --minimumCount;
+    }
+    while (minimumCount > 0 &&
+           minimumGains[(size_t)((minimumFirst + minimumCount - 1) % windowLength)] >= needed) {
+      --minimumCount;
+    }
+    const auto last = (size_t)((minimumFirst + minimumCount) % windowLength);
+    minimumGains[last] = needed;
+    minimumTimes[last] = time;
+    ++minimumCount;
+
+    // Every released gain averaged here is at most the one needed by the
+    // sample leaving the delay line
+    releasedGain = juce::jmin(minimumGains[(size_t)minimumFirst],
+                              releasedGain + (1.0f - releasedGain) * releaseCoefficient);
+    historySum += releasedGain - history[(size_t)historyPosition];
+    history[(size_t)historyPosition] = releasedGain;
+    historyPosition = (historyPosition + 1) % windowLength;
+    const float gain = juce::jmin(1.0f, (float)historySum * inverseLength);
+
+    channels[0][i] = lines[0][(size_t)linePosition] * gain;
+    channels[1][i] = lines[1][(size_t)linePosition] * gain;
+    lines[0][(size_t)linePosition] = left;
+    lines[1][(size_t)linePosition] = right;
+    linePosition = (linePosition + 1) % lookaheadSamples;
+  }
+}
+
+void LimiterEffect::reset() noexcept {
+  for (auto& line : lines) {
+    std::fill(line.begin(), line.end(), 0.0f);
+  }
+  linePosition = 0;
+  minimumFirst = 0;
+  minimumCount = 0;
+  time = 0;
+  releasedGain = 1.0f;
+  std::fill(history.begin(), history.end(), 1.0f);
+  historyPosition = 0;
+  historySum = (double)history.size();
+}
+
+std::unique_ptr<AudioEffect> LimiterEffect::clone() const {
+  return std::make_unique<LimiterEffect>(ceiling, lookaheadSeconds, releaseSeconds);
+}
@@ -1,24 +1,32 @@
 #include "audio-engine-core.hpp"
 #include "audio-context.hpp"
+#include "realtime-guard.hpp"
+#include "sample-cache.hpp"
 
-// TODO: [HIGH] Implement dynamic track management API (addTrack, removeTrack,
-// getTracks)
-// TODO: [MEDIUM] Add audio mixer with bus routing and effects chain
 // TODO: [MEDIUM] Implement error handling for audio device failures
-// TODO: [LOW] Add panning control per track
 
-AudioEngineCore::AudioEngineCore()
-    : playing(false), currentPosition(0.0), masterVolume(0.5f) {
-  // TODO: [HIGH] Replace hardcoded track with dynamic track management
-  // Suggestion: loadTracksFromConfig() or addTrack() API
-  tracks.push_back(std::make_unique<BeatTrack>(1000.0f));
+AudioEngineCore::AudioEngineCore(int numRenderThreads)
+    : playing(false), mixer(numRenderThreads) {
+  mixer.setAnalysisTap(&analysisTap);
+  mixer.setProfiler(&profiler);
+  mixer.setMidiInput(&midiInput);
+
+  // Default track, more can be added at runtime with addTrack()
+  addTrack(std::make_unique<BeatTrack>(1000.0f));
 
   // Audio configuration: 0 inputs, 2 outputs
   // TODO: [MEDIUM] Add error handling for audio device initialization
   setAudioChannels(0, 2);
+
+  // MIDI input: every device, timestamped on arrival
+  for (const auto& device : juce::MidiInput::getAvailableDevices()) {
+    deviceManager.setMidiInputDeviceEnabled(device.identifier, true);
+  }
+  deviceManager.addMidiInputDeviceCallback({}, this);
 }
 
 AudioEngineCore::~AudioEngineCore() {
+  deviceManager.removeMidiInputDeviceCallback({}, this);
   shutdownAudio();
 }
 
@@ -28,20 +36,18 @@ void AudioEngineCore::prepareToPlay(int samplesPerBlockExpected,
   ctx.sampleRate = sampleRate;
 
   // Pre-allocate buffers to avoid allocations in audio thread
-  // Allocate for 2 channels (stereo output)
-  mixBuffer.setSize(2, samplesPerBlockExpected, false, true, false);
-
-  // Allocate mono track buffer for individual track rendering
-  trackBuffer.setSize(1, samplesPerBlockExpected, false, true, false);
-
-  // Initialize pan values for each track (center = 0.5)
-  trackPanValues.resize(tracks.size(), 0.5f);
+  mixer.prepare(samplesPerBlockExpected, sampleRate);
+  analysisTap.prepare(sampleRate);
+  profiler.prepare(sampleRate);
+  midiInput.prepare(sampleRate);
 
   juce::Logger::writeToLog("Audio initialized:");
   juce::Logger::writeToLog(
       "- Buffer size: " + juce::String(samplesPerBlockExpected) + " samples");
   juce::Logger::writeToLog("- Sample rate: " + juce::String(sampleRate) +
                            " Hz");
+  juce::Logger::writeToLog(
+      "- Render threads: " + juce::String(getRenderThreadCount()) + " + device");
   juce::Logger::writeToLog("- Ready to play!");
 
   // Start automatically (for testing)
@@ -50,48 +56,180 @@ void AudioEngineCore::prepareToPlay(int samplesPerBlockExpected,
 
 void AudioEngineCore::getNextAudioBlock(
     const juce::AudioSourceChannelInfo& bufferToFill) {
-  auto const& ctx = AudioContext::getInstance();
+  // Debug/CI builds flag any allocation, lock or blocking call from here on
+  const RealtimeGuard::Scope realtime;
   auto* buffer = bufferToFill.buffer;
-  auto numSamples = bufferToFill.numSamples;
+  const bool profiling = profiler.isEnabled();
+  const juce::int64 start = profiling ? EngineProfiler::now() : 0;
 
   if (!playing) {
     buffer->clear();
-    return;
+  } else {
+    mixer.process(*buffer, bufferToFill.startSample, bufferToFill.numSamples);
   }
 
-  // Clear the pre-allocated mix buffer
-  mixBuffer.clear();
-
-  // OPTIMIZED: Batch processing with reduced virtual calls and SIMD-enabled mixing
-  // Render each track into trackBuffer, then mix into stereo mixBuffer
-  for (size_t trackIdx = 0; trackIdx < tracks.size(); ++trackIdx) {
-    // Render entire block at once (single virtual call instead of numSamples calls)
-    tracks[trackIdx]->renderBlock(trackBuffer, 0, numSamples, currentPosition);
+  // Copy only: the analysis itself runs on the analysis thread
+  analysisTap.pushMaster(*buffer, bufferToFill.startSample,
+                         bufferToFill.numSamples);
 
-    // Mix track buffer into both stereo channels using JUCE's optimized addFrom
-    // This uses SIMD operations internally for much better performance
-    for (int channel = 0; channel < mixBuffer.getNumChannels(); ++channel) {
-      mixBuffer.addFrom(channel, 0, trackBuffer, 0, 0, numSamples);
-    }
+  if (profiling) {
+    profiler.recordCallback(EngineProfiler::now() - start,
+                            bufferToFill.numSamples);
   }
+}
+
+void AudioEngineCore::handleIncomingMidiMessage(juce::MidiInput* /*source*/,
+                                                const juce::MidiMessage& message) {
+  // Stamped here rather than with the message's own timestamp, which uses
+  // a different clock than the audio callback
+  midiInput.push(message, EngineProfiler::now());
+}
+
+void AudioEngineCore::releaseResources() {
+  juce::Logger::writeToLog("Releasing audio resources");
+}
+
+size_t AudioEngineCore::addTrack(std::unique_ptr<AudioTrack> track) {
+  return mixer.addTrack(std::move(track));
+}
+
+bool AudioEngineCore::removeTrack(size_t index) {
+  return mixer.removeTrack(index);
+}
 
-  // Apply master volume to mixed buffer using SIMD-optimized operation
-  for (int channel = 0; channel < mixBuffer.getNumChannels(); ++channel) {
-    mixBuffer.applyGain(channel, 0, numSamples, masterVolume);
+std::shared_ptr<AudioTrack> AudioEngineCore::getTrack(size_t index) const {
+  return mixer.getTrack(index);
+}
+
+size_t AudioEngineCore::getTrackCount() const {
+  return mixer.getTrackCount();
+}
+
+void AudioEngineCore::collectGarbage() {
+  mixer.collectGarbage();
+  mixer.collectCommandReplies([this](const EngineCommand& command) {
+    lastAppliedCommand.store(command.id);
+  });
+
+  // Decoded samples released by removed tracks, if over budget
+  SampleCache::getInstance().trim();
+}
+
+bool AudioEngineCore::sendCommand(EngineCommand command) {
+  if (mixer.sendCommand(command)) {
+    return true;
   }
 
-  // Copy from mix buffer to output buffer
-  for (int channel = 0; channel < buffer->getNumChannels(); ++channel) {
-    buffer->copyFrom(channel, bufferToFill.startSample, mixBuffer,
-                     channel, 0, numSamples);
+  // Queue full of acknowledged commands: release them and retry once
+  collectGarbage();
+  return mixer.sendCommand(std::move(command));
+}
+
+void AudioEngineCore::captureProfile(ProfileSnapshot& snapshot) const {
+  // Holding the tracks keeps their histograms alive while they are read
+  const auto tracks = mixer.getTracks();
+  std::vector<const Histogram*> histograms;
+  histograms.reserve(tracks.size());
+  for (const auto& track : tracks) {
+    histograms.push_back(&track->renderTime);
   }
 
-  // Update playback position
-  // TODO: [MEDIUM] Replace floating-point accumulation with integer sample
-  // counter to avoid drift: totalSampleCount += numSamples;
-  currentPosition += (double)numSamples / ctx.sampleRate;
+  profiler.capture(histograms, snapshot);
+  snapshot.deviceXRuns = deviceManager.getXRunCount();
+  snapshot.midiLatency = midiInput.getLatency().getSnapshot();
+  snapshot.midiJitter = midiInput.getJitter().getSnapshot();
+  snapshot.midiDropped = midiInput.getDroppedCount();
 }
 
-void AudioEngineCore::releaseResources() {
-  juce::Logger::writeToLog("Releasing audio resources");
-}
\ No newline at end of file
+std::string AudioEngineCore::getMetrics() const {
+  ProfileSnapshot snapshot;
+  captureProfile(snapshot);
+  std::string text;
+  EngineProfiler::writePrometheus(snapshot, text);
+  SampleCache::writePrometheus(SampleCache::getInstance().getStatistics(), text);
+  return text;
+}
+
+void AudioEngineCore::setTempoMap(TempoMap map) {
+  mixer.setTempoMap(std::move(map));
+}
+
+std::shared_ptr<const TempoMap> AudioEngineCore::getTempoMap() const {
+  return mixer.getTempoMap();
+}
+
+int AudioEngineCore::addBus(std::shared_ptr<MixBus> bus, int output) {
+  return mixer.addBus(std::move(bus), output);
+}
+
+bool AudioEngineCore::removeBus(int index) {
+  return mixer.removeBus(index);
+}
+
+std::shared_ptr<MixBus> AudioEngineCore::getBus(int index) const {
+  return mixer.getBus(index);
+}
+
+int AudioEngineCore::getBusCount() const {
+  return mixer.getBusCount();
+}
+
+bool AudioEngineCore::setTrackOutput(size_t track, int output) {
+  return mixer.setTrackOutput(track, output);
+}
+
+bool AudioEngineCore::setBusOutput(int bus, int output) {
+  return mixer.setBusOutput(bus, output);
+}
+
+int AudioEngineCore::addSend(MixGraph::Source source, int destination,
+                             std::shared_ptr<MixSend> send) {
+  return mixer.addSend(source, destination, std::move(send));
+}
+
+bool AudioEngineCore::removeSend(int index) {
+  return mixer.removeSend(index);
+}
+
+std::shared_ptr<MixSend> AudioEngineCore::getSend(int index) const {
+  return mixer.getSend(index);
+}
+
+bool AudioEngineCore::setEffects(int bus,
+                                 std::vector<std::shared_ptr<AudioEffect>> chain) {
+  return mixer.setEffects(bus, std::move(chain));
+}
+
+MixGraph AudioEngineCore::getGraph() const {
+  return mixer.getGraph();
+}
+
+int AudioEngineCore::getLatencySamples() const {
+  return mixer.getLatencySamples();
+}
+
+bool AudioEngineCore::refreshLatency() {
+  return mixer.refreshLatency();
+}
+
+int AudioEngineCore::getRenderThreadCount() const {
+  return mixer.getRenderThreadCount();
+}
+
+void AudioEngineCore::setParallelTrackThreshold(int minTracks) {
+  mixer.setParallelTrackThreshold(minTracks);
+}
+
+OfflineRenderer::Result AudioEngineCore::renderOffline(
+    const OfflineRenderer::Settings& settings) const {
+  std::vector<std::shared_ptr<AudioTrack>> snapshot;
+  for (const auto& track : mixer.getTracks()) {
+    snapshot.push_back(track->clone());
+  }
+
+  auto sessionSettings = settings;
+  sessionSettings.tempoMap = *mixer.getTempoMap();
+  sessionSettings.routing = mixer.getGraph().clone();
+
+  return OfflineRenderer::render(snapshot, sessionSettings);
+}
@@ -1,5 +1,6 @@
 #include "audio-track.hpp"
 #include <juce_audio_utils/juce_audio_utils.h>
+#include "midi-input.hpp"
 
 AudioTrack::AudioTrack() : volume(0.4f), pan(0.0f), mute(false) {}
 
@@ -9,4 +10,58 @@ void AudioTrack::setMute(bool shouldMute) {
 
 void AudioTrack::setVolume(float newVolume) {
   this->volume = juce::jlimit(0.0f, 1.0f, newVolume);
-}
\ No newline at end of file
+}
+
+void AudioTrack::setPan(float newPan) {
+  this->pan = juce::jlimit(-1.0f, 1.0f, newPan);
+}
+
+void AudioTrack::copyMixSettings(const AudioTrack& other) {
+  setVolume(other.volume);
+  setPan(other.pan);
+  setMute(other.mute);
+  receivesMidi = other.receivesMidi;
+}
+
+RenderActivity AudioTrack::renderWithEvents(juce::AudioBuffer<float>& buffer,
+                                            int startSample, int numSamples,
+                                            const BeatContext& context,
+                                            const MidiEventList& events) {
+  const int endSample = startSample + numSamples;
+  const MidiEvent* event = events.lowerBound(startSample);
+
+  RenderActivity activity;
+  for (int done = 0; done < numSamples;) {
+    while (event != events.end() && event->offset <= startSample + done) {
+      playEvent(*event++);
+    }
+
+    const int next = event != events.end() ? juce::jmin(event->offset, endSample)
+                                           : endSample;
+    const int count = next - startSample - done;
+    BeatContext pieceContext = context;
+    if (done > 0 && context.tempoMap != nullptr) {
+      pieceContext = context.tempoMap->getContext(context.sample + done);
+    } else if (done > 0) {
+      // Same tempo segment and bar layout as the span
+      pieceContext.sample += done;
+      pieceContext.beat = context.getBeatAt(done);
+      pieceContext.beatsPerSample += context.beatsPerSampleDelta * done;
+    }
+
+    const auto piece = renderBlock(buffer, startSample + done, count, pieceContext);
+    if (!piece.isSilent()) {
+      activity.include(done + piece.start, done + piece.end);
+    }
+    done += count;
+  }
+  return activity;
+}
+
+void AudioTrack::playEvent(const MidiEvent& event) noexcept {
+  if (event.type == MidiEvent::Type::NoteOn) {
+    noteOn(event.note, event.velocity);
+  } else {
+    noteOff(event.note);
+  }
+}
@@ -1,105 +1,178 @@
 #include "beat-track.hpp"
 #include <juce_audio_utils/juce_audio_utils.h>
-#include "audio-context.hpp"
-
-// TODO: [MEDIUM] Make ADSR parameters configurable:
-// - Add ADSRParameters struct with attack, decay, sustain, release times
-// - Add setADSRParameters(const ADSRParameters& params) method
-// - Support different envelope curves (linear, exponential, logarithmic)
+#include <algorithm>
+#include <cmath>
 
 // TODO: [LOW] Add velocity sensitivity to ADSR
 // TODO: [LOW] Add retrigger modes (legato, retrigger, free-run)
 
-WaveTable BeatTrack::waveTable(WaveTable::WaveType::SINE, 2048);
+namespace {
+
+// First sample of beat k. Looked up from k, never accumulated, so beat
+// positions stay exact however long the session runs.
+juce::int64 getBeatStart(const TempoMap& map, juce::int64 beat) {
+  return (juce::int64)std::ceil(map.getSampleAtBeat((double)beat));
+}
+
+// Beat containing an absolute sample
+juce::int64 findBeat(const TempoMap& map, juce::int64 sample) {
+  auto beat = (juce::int64)std::floor(map.getBeatAtSample(sample));
+  if (getBeatStart(map, beat) > sample) {
+    --beat;
+  } else if (getBeatStart(map, beat + 1) <= sample) {
+    ++beat;
+  }
+  return beat;
+}
+
+}  // namespace
 
 BeatTrack::BeatTrack(float frequency)
-    : AudioTrack(), frequency(frequency), duration(0.15f) {
+    : AudioTrack(),
+      frequency(frequency),
+      duration(0.15f),
+      oscillator(&WaveTableBank::get(WaveTable::WaveType::SINE)) {
   // ADSR Envelope parameters
-  att = 0.01f;
-  dec = 0.02f;
-  sus = 0.8f;
-  rel = 0.02f;
+  adsr.attackTime = 0.01f;
+  adsr.decayTime = 0.02f;
+  adsr.sustainLevel = 0.8f;
+  adsr.releaseTime = 0.02f;
 }
 
 BeatTrack::~BeatTrack() = default;
 
-float BeatTrack::getSampleValue(double sampleTime) {
-  if (mute) {
+float BeatTrack::getSampleValue(const BeatContext& context) {
+  const TempoMap& map = *context.tempoMap;
+  const double sampleRate = context.sampleRate;
+
+  // Same integer beat grid as renderBlock()
+  const juce::int64 sampleInBeat =
+      context.sample - getBeatStart(map, findBeat(map, context.sample));
+
+  EnvelopeGenerator env(adsr, sampleRate);
+  seekEnvelope(env, sampleInBeat,
+               (juce::int64)std::ceil(duration * sampleRate));
+  if (!env.isActive()) {
     return 0.0f;
   }
 
-  auto const& ctx = AudioContext::getInstance();
-  float pi = juce::MathConstants<float>::pi;
-  float currentTempo = ctx.tempoBPM.load();
-  interval = 60.0f / currentTempo;
+  const double pi = juce::MathConstants<double>::pi;
+  const auto currentPhase = (float)std::fmod(
+      2.0 * pi * frequency * (double)sampleInBeat / sampleRate, 2.0 * pi);
+  const auto increment = (float)(2.0 * pi * frequency / sampleRate);
 
-  if (float timeSinceLastBeat = std::fmod(sampleTime, interval);
-      timeSinceLastBeat < duration + rel) {
-    float enveloppeVolume = computeEnveloppe(timeSinceLastBeat);
-    float currentPhase = 2.0f * pi * frequency * timeSinceLastBeat;
-    float sampleValue =
-        enveloppeVolume * volume * waveTable.getSampleFast(currentPhase);
+  return env.getValue() * oscillator->getSample(currentPhase, increment);
+}
 
-    return sampleValue;
-  }
+RenderActivity BeatTrack::renderBlock(juce::AudioBuffer<float>& buffer,
+                                      int startSample,
+                                      int numSamples,
+                                      const BeatContext& context) {
+  const TempoMap& map = *context.tempoMap;
 
-  return 0.0f;
-}
+  // Get direct pointer to buffer for faster access
+  float* bufferData = buffer.getWritePointer(0, startSample);
 
-void BeatTrack::renderBlock(juce::AudioBuffer<float>& buffer,
-                            int startSample,
-                            int numSamples,
-                            double startTime) {
-  // Early exit if muted
-  if (mute) {
-    buffer.clear(0, startSample, numSamples);
-    return;
+  // Continue from the previous block unless playback jumped or the grid
+  // changed
+  if (context.sample != nextSample || map.getId() != tempoMapId) {
+    tempoMapId = map.getId();
+    renderSampleRate = context.sampleRate;
+    resync(map, context.sample);
   }
 
-  auto const& ctx = AudioContext::getInstance();
-  const float pi = juce::MathConstants<float>::pi;
-  const float currentTempo = ctx.tempoBPM.load();
-  const double sampleRate = ctx.sampleRate;
-  interval = 60.0f / currentTempo;
+  juce::int64 position = context.sample;
+  int done = 0;
+  RenderActivity activity;
 
-  // Get direct pointer to buffer for faster access
-  float* bufferData = buffer.getWritePointer(0, startSample);
+  while (done < numSamples) {
+    const juce::int64 sampleInBeat = position - beatStart;
+    auto count = (int)std::min<juce::int64>(numSamples - done,
+                                            nextBeatStart - position);
 
-  // Render each sample in the block
-  for (int i = 0; i < numSamples; ++i) {
-    const double sampleTime = startTime + (double)i / sampleRate;
-    const float timeSinceLastBeat = std::fmod(sampleTime, interval);
+    if (sampleInBeat == noteOffSample) {
+      envelope.noteOff();
+    }
 
-    if (timeSinceLastBeat < duration + rel) {
-      const float enveloppeVolume = computeEnveloppe(timeSinceLastBeat);
-      const float currentPhase = 2.0f * pi * frequency * timeSinceLastBeat;
-      bufferData[i] =
-          enveloppeVolume * volume * waveTable.getSampleFast(currentPhase);
+    if (envelope.isActive()) {
+      // Stop at the note off, or at the end of the release
+      count = (int)std::min<juce::int64>(
+          count, sampleInBeat < noteOffSample ? noteOffSample - sampleInBeat
+                                              : envelope.getRemainingSamples());
+      renderNote(bufferData + done, count);
+      activity.include(done, done + count);
     } else {
-      bufferData[i] = 0.0f;
+      // Silence until the next beat (or the end of the block)
+      juce::FloatVectorOperations::clear(bufferData + done, count);
+    }
+
+    done += count;
+    position += count;
+
+    if (position == nextBeatStart) {
+      ++beatIndex;
+      beatStart = nextBeatStart;
+      nextBeatStart = getBeatStart(map, beatIndex + 1);
+      oscillatorPhase = 0.0f;
+      envelope.setParameters(adsr);
+      envelope.reset();
+      envelope.noteOn();
     }
   }
+
+  nextSample = position;
+  return activity;
 }
 
-float BeatTrack::computeEnveloppe(float timeSinceLastBeat) const {
-  float enveloppeVolume = 0.0f;
+void BeatTrack::resync(const TempoMap& map, juce::int64 sample) {
+  const double pi = juce::MathConstants<double>::pi;
 
-  if (timeSinceLastBeat < duration) {
-    if (timeSinceLastBeat < att) {  // Attack
-      enveloppeVolume = timeSinceLastBeat / att;
-      enveloppeVolume = juce::jmin(enveloppeVolume, 1.0f);
+  beatIndex = findBeat(map, sample);
+  beatStart = getBeatStart(map, beatIndex);
+  nextBeatStart = getBeatStart(map, beatIndex + 1);
+  noteOffSample = (juce::int64)std::ceil(duration * renderSampleRate);
 
-    } else if (timeSinceLastBeat < (att + dec)) {  // Decay
-      enveloppeVolume = (timeSinceLastBeat - att) * (sus - 1.0f) / dec + 1.0f;
-      enveloppeVolume = juce::jmax(sus, enveloppeVolume);
+  phaseIncrement = (float)(2.0 * pi * frequency / renderSampleRate);
+  oscillatorPhase = (float)std::fmod(
+      2.0 * pi * frequency * (double)(sample - beatStart) / renderSampleRate,
+      2.0 * pi);
 
-    } else if (timeSinceLastBeat >= (att + dec)) {  // Sustain
-      enveloppeVolume = sus;
-    }
-  } else {  // Release
-    enveloppeVolume = sus * (1.0f - (timeSinceLastBeat - duration) / rel);
-    enveloppeVolume = juce::jmax(0.0f, enveloppeVolume);
+  envelope.setParameters(adsr);
+  envelope.setSampleRate(renderSampleRate);
+  seekEnvelope(envelope, sample - beatStart, noteOffSample);
+}
+
+void BeatTrack::seekEnvelope(EnvelopeGenerator& env, juce::int64 sampleInBeat,
+                             juce::int64 noteOffAt) {
+  env.reset();
+  env.noteOn();
+
+  if (sampleInBeat <= noteOffAt) {
+    env.advance(sampleInBeat);
+  } else {
+    env.advance(noteOffAt);
+    env.noteOff();
+    env.advance(sampleInBeat - noteOffAt);
   }
+}
 
-  return enveloppeVolume;
-}
\ No newline at end of file
+void BeatTrack::renderNote(float* output, int numSamples) {
+  oscillatorPhase = oscillator->renderBlock(output, numSamples, oscillatorPhase,
+                                            phaseIncrement);
+  envelope.applyBlock(output, numSamples);
+}
+
+void BeatTrack::setADSRParameters(const ADSRParameters& params) {
+  adsr = params;
+}
+
+ADSRParameters BeatTrack::getADSRParameters() const {
+  return adsr;
+}
+
+std::unique_ptr<AudioTrack> BeatTrack::clone() const {
+  auto copy = std::make_unique<BeatTrack>(frequency);
+  copy->copyMixSettings(*this);
+  copy->setADSRParameters(adsr);
+  return copy;
+}
@@ -0,0 +1,450 @@
+#include "channel-strip.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if DAW_ENABLE_SIMD
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+/**
+ * @brief SpanLevels of one channel, accumulated sample by sample
+ *
+ * The peak is found on the squares, already computed for the energy. The
+ * sum of squares runs over 8 lanes (sample i into lane i % 8), like the two
+ * vector accumulators, so both give the same bits.
+ */
+struct LevelAccumulator {
+  static constexpr int kLanes = 8;
+
+  float peak = 0.0f;
+  float peakSquare = 0.0f;
+  int peakIndex = 0;
+  float sums[kLanes] = {};
+
+  void add(int index, float value) noexcept {
+    const float square = value * value;
+    if (square > peakSquare) {
+      peakSquare = square;
+      peak = std::abs(value);
+      peakIndex = index;
+    }
+    sums[index & (kLanes - 1)] += square;
+  }
+
+  SpanLevels finish() const noexcept {
+    const float low = ((sums[0] + sums[1]) + sums[2]) + sums[3];
+    const float high = ((sums[4] + sums[5]) + sums[6]) + sums[7];
+    return {peak, peakIndex, low + high};
+  }
+};
+
+// Samples [begin, numSamples) of a mix. Ramps are evaluated at the float
+// sample index, like the vector lanes (GainRamp::at()).
+template <bool Stereo, bool Store, bool Measure>
+void mixScalarFrom(const ChannelStrip::MixJob& job, int begin,
+                   LevelAccumulator (&levels)[2]) noexcept {
+  const auto& gains = job.gains;
+  for (int i = begin; i < job.numSamples; ++i) {
+    const float fader = gains.fader.at(i);
+    const float left = job.input[0][i] * fader;
+    const float right = Stereo ? job.input[1][i] * fader : left;
+    if constexpr (Store) {
+      job.postFader[0][i] = left;
+      if constexpr (Stereo) {
+        job.postFader[1][i] = right;
+      }
+    }
+    if constexpr (Measure) {
+      levels[0].add(i, left);
+      if constexpr (Stereo) {
+        levels[1].add(i, right);
+      }
+    }
+    job.left[i] += left * gains.left.at(i);
+    job.right[i] += right * gains.right.at(i);
+  }
+}
+
+#if DAW_ENABLE_SIMD
+/**
+ * @brief GainRamp over 4 lanes
+ */
+class RampLanes {
+ public:
+  explicit RampLanes(const GainRamp& ramp)
+      : start(_mm_set1_ps(ramp.start)),
+        step(_mm_set1_ps(ramp.step)),
+        end(_mm_set1_ps(ramp.end)),
+        length(_mm_set1_ps((float)ramp.length)) {}
+
+  /** @brief Gains at 4 float sample indices */
+  __m128 at(__m128 index) const noexcept {
+    const __m128 inRamp = _mm_cmplt_ps(index, length);
+    const __m128 ramped = _mm_add_ps(start, _mm_mul_ps(step, index));
+    return _mm_or_ps(_mm_and_ps(inRamp, ramped), _mm_andnot_ps(inRamp, end));
+  }
+
+ private:
+  __m128 start;
+  __m128 step;
+  __m128 end;
+  __m128 length;
+};
+
+/**
+ * @brief Constant GainRamp over 4 lanes: the gain every RampLanes lane
+ * would give
+ */
+class ConstantLanes {
+ public:
+  explicit ConstantLanes(const GainRamp& ramp) : gain(_mm_set1_ps(ramp.end)) {}
+
+  __m128 at(__m128 /*index*/) const noexcept { return gain; }
+
+ private:
+  __m128 gain;
+};
+
+/**
+ * @brief LevelAccumulator over 2 x 4 lanes
+ *
+ * Per sample, only a multiply, an add and a max: the largest square is kept
+ * per chunk of kChunkSize samples, and the chunk which first raised it is
+ * scanned again at the end for the exact sample. Groups of 4 samples
+ * alternate between two accumulators (half 0 for i % 8 == 0, half 1 for
+ * i % 8 == 4), so the adds and maxes do not wait on each other.
+ */
+class LevelLanes {
+ public:
+  static constexpr int kChunkSize = 32;
+
+  /** @brief Add 4 samples to one half */
+  void add(__m128 value, int half) noexcept {
+    const __m128 square = _mm_mul_ps(value, value);
+    sums[half] = _mm_add_ps(sums[half], square);
+    chunkPeaks[half] = _mm_max_ps(chunkPeaks[half], square);
+  }
+
+  /** @brief Close the chunk starting at sample chunkStart */
+  void endChunk(int chunkStart) noexcept {
+    const __m128 chunkPeak = _mm_max_ps(chunkPeaks[0], chunkPeaks[1]);
+    __m128 highest = _mm_max_ps(chunkPeak, _mm_movehl_ps(chunkPeak, chunkPeak));
+    highest = _mm_max_ss(highest, _mm_shuffle_ps(highest, highest, 1));
+    const float square = _mm_cvtss_f32(highest);
+    if (square > peakSquare) {
+      peakSquare = square;
+      peakChunk = chunkStart;
+    }
+    chunkPeaks[0] = chunkPeaks[1] = _mm_setzero_ps();
+  }
+
+  /**
+   * @brief Hand the lanes over to the scalar loop, which continues after them
+   * @param postFaderAt Callable returning the 4 post-fader samples from
+   * sample i (a multiple of 4) of the mix
+   */
+  template <typename PostFaderAt>
+  void store(LevelAccumulator& levels, PostFaderAt&& postFaderAt) const noexcept {
+    _mm_storeu_ps(levels.sums, sums[0]);
+    _mm_storeu_ps(levels.sums + 4, sums[1]);
+    if (peakSquare <= 0.0f) {
+      return;
+    }
+
+    // First sample of the chunk reaching the peak, as the scalar pass finds
+    const __m128 target = _mm_set1_ps(peakSquare);
+    for (int i = peakChunk;; i += 4) {
+      const __m128 value = postFaderAt(i);
+      const int found = _mm_movemask_ps(_mm_cmpeq_ps(_mm_mul_ps(value, value), target));
+      if (found != 0) {
+        int lane = 0;
+        while ((found & (1 << lane)) == 0) {
+          ++lane;
+        }
+        float values[4];
+        _mm_storeu_ps(values, value);
+        levels.peak = std::abs(values[lane]);
+        levels.peakSquare = peakSquare;
+        levels.peakIndex = i + lane;
+        return;
+      }
+    }
+  }
+
+ private:
+  __m128 sums[2] = {_mm_setzero_ps(), _mm_setzero_ps()};
+  __m128 chunkPeaks[2] = {_mm_setzero_ps(), _mm_setzero_ps()};
+  float peakSquare = 0.0f;
+  int peakChunk = 0;
+};
+
+// First 4 sample indices; exact up to 2^24 samples
+inline __m128 firstLanes() {
+  return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+}
+
+// Whole groups of 4 samples; returns the first sample left to the scalar
+// loop. Gains are RampLanes, or ConstantLanes when no gain moves.
+template <bool Stereo, bool Store, bool Measure, typename Gains>
+int mixSse2(const ChannelStrip::MixJob& job, LevelAccumulator (&levels)[2]) noexcept {
+  const Gains faderGains(job.gains.fader);
+  const Gains leftGains(job.gains.left);
+  const Gains rightGains(job.gains.right);
+  const __m128 four = _mm_set1_ps(4.0f);
+  const __m128 eight = _mm_set1_ps(8.0f);
+  LevelLanes leftLevels;
+  LevelLanes rightLevels;
+
+  // 4 samples from i, at the float indices of i
+  const auto mixFour = [&](int i, __m128 index, int half) noexcept {
+    const __m128 fader = faderGains.at(index);
+    const __m128 left = _mm_mul_ps(_mm_loadu_ps(job.input[0] + i), fader);
+    __m128 right = left;
+    if constexpr (Stereo) {
+      right = _mm_mul_ps(_mm_loadu_ps(job.input[1] + i), fader);
+    }
+    if constexpr (Store) {
+      _mm_storeu_ps(job.postFader[0] + i, left);
+      if constexpr (Stereo) {
+        _mm_storeu_ps(job.postFader[1] + i, right);
+      }
+    }
+    if constexpr (Measure) {
+      leftLevels.add(left, half);
+      if constexpr (Stereo) {
+        rightLevels.add(right, half);
+      }
+    }
+    _mm_storeu_ps(job.left + i, _mm_add_ps(_mm_loadu_ps(job.left + i),
+                                           _mm_mul_ps(left, leftGains.at(index))));
+    _mm_storeu_ps(job.right + i, _mm_add_ps(_mm_loadu_ps(job.right + i),
+                                            _mm_mul_ps(right, rightGains.at(index))));
+  };
+
+  __m128 index = firstLanes();
+  const int end = job.numSamples & ~3;
+  int i = 0;
+  while (i < end) {
+    const int chunkStart = i;
+    const int chunkEnd = std::min(end, i + LevelLanes::kChunkSize);
+    for (; i + 8 <= chunkEnd; i += 8) {
+      mixFour(i, index, 0);
+      mixFour(i + 4, _mm_add_ps(index, four), 1);
+      index = _mm_add_ps(index, eight);
+    }
+    if (i < chunkEnd) {
+      mixFour(i, index, 0);
+      index = _mm_add_ps(index, four);
+      i += 4;
+    }
+    if constexpr (Measure) {
+      leftLevels.endChunk(chunkStart);
+      rightLevels.endChunk(chunkStart);
+    }
+  }
+  if constexpr (Measure) {
+    // Post-fader samples again: stored, or the same product as the loop
+    const auto postFaderAt = [&](int channel) noexcept {
+      return [&job, &faderGains, channel](int from) noexcept {
+        if constexpr (Store) {
+          return _mm_loadu_ps(job.postFader[channel] + from);
+        } else {
+          const __m128 index = _mm_add_ps(firstLanes(), _mm_set1_ps((float)from));
+          return _mm_mul_ps(_mm_loadu_ps(job.input[channel] + from), faderGains.at(index));
+        }
+      };
+    };
+    leftLevels.store(levels[0], postFaderAt(0));
+    if constexpr (Stereo) {
+      rightLevels.store(levels[1], postFaderAt(1));
+    }
+  }
+  return i;
+}
+#endif
+
+template <bool Stereo, bool Store, bool Measure>
+void mixWith(const ChannelStrip::MixJob& job, bool vectorize) noexcept {
+  LevelAccumulator levels[2];
+  int begin = 0;
+#if DAW_ENABLE_SIMD
+  if (vectorize) {
+    const auto& gains = job.gains;
+    if (gains.fader.isConstant() && gains.left.isConstant() && gains.right.isConstant()) {
+      begin = mixSse2<Stereo, Store, Measure, ConstantLanes>(job, levels);
+    } else {
+      begin = mixSse2<Stereo, Store, Measure, RampLanes>(job, levels);
+    }
+  }
+#else
+  juce::ignoreUnused(vectorize);
+#endif
+  mixScalarFrom<Stereo, Store, Measure>(job, begin, levels);
+  if constexpr (Measure) {
+    job.levels[0] = levels[0].finish();
+    if constexpr (Stereo) {
+      job.levels[1] = levels[1].finish();
+    }
+  }
+}
+
+template <bool Stereo, bool Store>
+void dispatchMeasure(const ChannelStrip::MixJob& job, bool vectorize) noexcept {
+  if (job.levels != nullptr) {
+    mixWith<Stereo, Store, true>(job, vectorize);
+  } else {
+    mixWith<Stereo, Store, false>(job, vectorize);
+  }
+}
+
+template <bool Stereo>
+void dispatchStereo(const ChannelStrip::MixJob& job, bool vectorize) noexcept {
+  if (job.postFader[0] != nullptr) {
+    dispatchMeasure<Stereo, true>(job, vectorize);
+  } else {
+    dispatchMeasure<Stereo, false>(job, vectorize);
+  }
+}
+
+void dispatch(const ChannelStrip::MixJob& job, bool vectorize) noexcept {
+  if (job.input[1] != nullptr) {
+    dispatchStereo<true>(job, vectorize);
+  } else {
+    dispatchStereo<false>(job, vectorize);
+  }
+}
+
+// Scale one channel in place
+template <bool Measure>
+void scale(float* samples, int numSamples, const GainRamp& fader,
+           LevelAccumulator& levels) noexcept {
+  int i = 0;
+#if DAW_ENABLE_SIMD
+  const RampLanes gains(fader);
+  const __m128 four = _mm_set1_ps(4.0f);
+  const __m128 eight = _mm_set1_ps(8.0f);
+  LevelLanes lanes;
+  const auto scaleFour = [&](int i, __m128 index, int half) noexcept {
+    const __m128 scaled = _mm_mul_ps(_mm_loadu_ps(samples + i), gains.at(index));
+    _mm_storeu_ps(samples + i, scaled);
+    if constexpr (Measure) {
+      lanes.add(scaled, half);
+    }
+  };
+
+  __m128 index = firstLanes();
+  const int end = numSamples & ~3;
+  while (i < end) {
+    const int chunkStart = i;
+    const int chunkEnd = std::min(end, i + LevelLanes::kChunkSize);
+    for (; i + 8 <= chunkEnd; i += 8) {
+      scaleFour(i, index, 0);
+      scaleFour(i + 4, _mm_add_ps(index, four), 1);
+      index = _mm_add_ps(index, eight);
+    }
+    if (i < chunkEnd) {
+      scaleFour(i, index, 0);
+      index = _mm_add_ps(index, four);
+      i += 4;
+    }
+    if constexpr (Measure) {
+      lanes.endChunk(chunkStart);
+    }
+  }
+  if constexpr (Measure) {
+    lanes.store(levels, [samples](int from) noexcept { return _mm_loadu_ps(samples + from); });
+  }
+#endif
+  for (; i < numSamples; ++i) {
+    samples[i] = samples[i] * fader.at(i);
+    if constexpr (Measure) {
+      levels.add(i, samples[i]);
+    }
+  }
+}
+
+}  // namespace
+
+void ChannelStrip::getPanGains(float pan, float& left, float& right) noexcept {
+  pan = juce::jlimit(-1.0f, 1.0f, pan);
+  if (pan == 0.0f) {
+    // Exactly unity, so centred tracks mix at their volume
+    left = right = 1.0f;
+    return;
+  }
+  const double angle = (pan + 1.0) * juce::MathConstants<double>::pi / 4.0;
+  left = pan == 1.0f ? 0.0f : (float)(juce::MathConstants<double>::sqrt2 * std::cos(angle));
+  right = pan == -1.0f ? 0.0f : (float)(juce::MathConstants<double>::sqrt2 * std::sin(angle));
+}
+
+const StripGains& ChannelStrip::advance(float volume, float pan, bool mute,
+                                        int numSamples, int smoothingSamples) noexcept {
+  const float newFader = mute ? 0.0f : volume;
+  float newLeft = 1.0f;
+  float newRight = 1.0f;
+  getPanGains(pan, newLeft, newRight);
+
+  if (!initialised || smoothingSamples <= 0) {
+    fader = targetFader = newFader;
+    left = targetLeft = newLeft;
+    right = targetRight = newRight;
+    remainingSamples = 0;
+    initialised = true;
+  } else if (newFader != targetFader || newLeft != targetLeft || newRight != targetRight) {
+    // Restarts from the gains reached so far
+    targetFader = newFader;
+    targetLeft = newLeft;
+    targetRight = newRight;
+    remainingSamples = smoothingSamples;
+  }
+
+  gains.fader = ramp(fader, targetFader, numSamples);
+  gains.left = ramp(left, targetLeft, numSamples);
+  gains.right = ramp(right, targetRight, numSamples);
+  remainingSamples = std::max(0, remainingSamples - numSamples);
+  return gains;
+}
+
+GainRamp ChannelStrip::ramp(float& current, float target, int numSamples) const noexcept {
+  if (remainingSamples <= 0 || current == target) {
+    current = target;
+    return GainRamp::constant(target);
+  }
+
+  // Same slope for the rest of the ramp, whatever the span lengths
+  GainRamp result;
+  result.start = current;
+  result.step = (target - current) / (float)remainingSamples;
+  if (numSamples >= remainingSamples) {
+    result.end = target;
+    result.length = remainingSamples;
+  } else {
+    result.end = current + result.step * (float)numSamples;
+    result.length = numSamples;
+  }
+  current = result.end;
+  return result;
+}
+
+void ChannelStrip::applyFader(float* const* channels, int numChannels, int numSamples,
+                              GainRamp fader, SpanLevels* levels) noexcept {
+  for (int channel = 0; channel < numChannels; ++channel) {
+    LevelAccumulator accumulator;
+    if (levels != nullptr) {
+      scale<true>(channels[channel], numSamples, fader, accumulator);
+      levels[channel] = accumulator.finish();
+    } else {
+      scale<false>(channels[channel], numSamples, fader, accumulator);
+    }
+  }
+}
+
+void ChannelStrip::mix(const MixJob& job) noexcept {
+  dispatch(job, true);
+}
+
+void ChannelStrip::mixScalar(const MixJob& job) noexcept {
+  dispatch(job, false);
+}
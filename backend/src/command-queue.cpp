@@ -0,0 +1,21 @@
+#include "command-queue.hpp"
+
+CommandQueue::CommandQueue(int capacity)
+    : commands((size_t)juce::jmax(1, capacity)),
+      replies((size_t)juce::jmax(1, capacity)) {}
+
+bool CommandQueue::push(EngineCommand command) {
+  const std::lock_guard<std::mutex> lock(controlMutex);
+
+  if (inFlight == getCapacity() || !commands.tryPush(std::move(command))) {
+    return false;
+  }
+  ++inFlight;
+  return true;
+}
+
+void CommandQueue::sendReply(EngineCommand&& command) noexcept {
+  const bool sent = replies.tryPush(std::move(command));
+  jassert(sent);
+  juce::ignoreUnused(sent);
+}
@@ -0,0 +1,363 @@
+#include "control-protocol.hpp"
+
+namespace ControlProtocol {
+
+namespace {
+
+struct FieldInfo {
+  const char* name;
+  const char* type;
+  size_t offset;
+};
+
+const FieldInfo headerFields[] = {
+    {"version", "u8", HeaderLayout::version},
+    {"type", "u8", HeaderLayout::type},
+    {"count", "u16", HeaderLayout::count},
+    {"sequence", "u32", HeaderLayout::sequence}};
+
+const FieldInfo commandFields[] = {
+    {"op", "u8", CommandLayout::op},
+    {"timing", "u8", CommandLayout::timing},
+    {"note", "u8", CommandLayout::note},
+    {"track", "u32", CommandLayout::track},
+    {"value", "f64", CommandLayout::value},
+    {"when", "f64", CommandLayout::when}};
+
+const FieldInfo meterFields[] = {
+    {"peak", "f32", MeterLayout::peak},
+    {"truePeak", "f32", MeterLayout::truePeak},
+    {"rms", "f32", MeterLayout::rms}};
+
+const FieldInfo analysisFields[] = {
+    {"subscription", "u32", AnalysisLayout::subscription},
+    {"span", "u32", AnalysisLayout::span},
+    {"end", "u64", AnalysisLayout::end},
+    {"sampleRate", "f32", AnalysisLayout::sampleRate}};
+
+const FieldInfo spectrumFields[] = {
+    {"magnitude", "f32", SpectrumLayout::magnitude}};
+
+const FieldInfo scopeFields[] = {
+    {"min", "f32", ScopeLayout::min},
+    {"max", "f32", ScopeLayout::max}};
+
+const FieldInfo statusFields[] = {
+    {"firstCommandId", "u32", StatusLayout::firstCommandId},
+    {"accepted", "u16", StatusLayout::accepted},
+    {"error", "u16", StatusLayout::error},
+    {"appliedCommand", "u32", StatusLayout::appliedCommand},
+    {"trackCount", "u32", StatusLayout::trackCount}};
+
+template <size_t N>
+juce::var makeLayout(const FieldInfo (&fields)[N], size_t size) {
+  juce::Array<juce::var> list;
+  for (const auto& field : fields) {
+    auto* object = new juce::DynamicObject();
+    object->setProperty("name", field.name);
+    object->setProperty("type", field.type);
+    object->setProperty("offset", (int)field.offset);
+    list.add(juce::var(object));
+  }
+
+  auto* layout = new juce::DynamicObject();
+  layout->setProperty("size", (int)size);
+  layout->setProperty("fields", list);
+  return juce::var(layout);
+}
+
+juce::var makeEnum(std::initializer_list<std::pair<const char*, int>> values) {
+  auto* object = new juce::DynamicObject();
+  for (const auto& [name, value] : values) {
+    object->setProperty(name, value);
+  }
+  return juce::var(object);
+}
+
+juce::var makeMessage(MessageType type, const juce::var& record,
+                      const juce::var& prefix = {}) {
+  auto* message = new juce::DynamicObject();
+  message->setProperty("type", (int)type);
+  if (!prefix.isVoid()) {
+    message->setProperty("prefix", prefix);
+  }
+  if (!record.isVoid()) {
+    message->setProperty("record", record);
+  }
+  return juce::var(message);
+}
+
+// Grow a frame by one record and update its count
+juce::uint8* appendRecord(std::string& out, size_t recordSize) {
+  jassert(out.size() >= HeaderLayout::size);
+  const auto count =
+      Bytes::readUInt<juce::uint16>(reinterpret_cast<const juce::uint8*>(
+          out.data() + HeaderLayout::count));
+  jassert(count < kMaxRecords);
+
+  const size_t offset = out.size();
+  out.resize(offset + recordSize, '\0');
+  auto* header = reinterpret_cast<juce::uint8*>(&out[0]);
+  Bytes::writeUInt(header + HeaderLayout::count, (juce::uint16)(count + 1));
+  return header + offset;
+}
+
+// Grow a frame by count records at once and update its count
+juce::uint8* appendRecords(std::string& out, size_t recordSize, int count) {
+  jassert(out.size() >= HeaderLayout::size);
+  const auto previous =
+      Bytes::readUInt<juce::uint16>(reinterpret_cast<const juce::uint8*>(
+          out.data() + HeaderLayout::count));
+  jassert(previous + count <= kMaxRecords);
+
+  const size_t offset = out.size();
+  out.resize(offset + (size_t)count * recordSize, '\0');
+  auto* header = reinterpret_cast<juce::uint8*>(&out[0]);
+  Bytes::writeUInt(header + HeaderLayout::count, (juce::uint16)(previous + count));
+  return header + offset;
+}
+
+void writeStatusRecord(juce::uint8* record, const Status& status) {
+  Bytes::writeUInt(record + StatusLayout::firstCommandId, status.firstCommandId);
+  Bytes::writeUInt(record + StatusLayout::accepted, status.accepted);
+  Bytes::writeUInt(record + StatusLayout::error, (juce::uint16)status.error);
+  Bytes::writeUInt(record + StatusLayout::appliedCommand, status.appliedCommand);
+  Bytes::writeUInt(record + StatusLayout::trackCount, status.trackCount);
+}
+
+}  // namespace
+
+//==============================================================================
+FrameView::FrameView(const void* frame, size_t size) noexcept
+    : data(static_cast<const juce::uint8*>(frame)) {
+  if (size < HeaderLayout::size) {
+    error = Error::BadFrame;
+    return;
+  }
+
+  sequence = Bytes::readUInt<juce::uint32>(data + HeaderLayout::sequence);
+  type = (MessageType)data[HeaderLayout::type];
+  count = Bytes::readUInt<juce::uint16>(data + HeaderLayout::count);
+
+  if (data[HeaderLayout::version] != kVersion) {
+    error = Error::UnsupportedVersion;
+    return;
+  }
+
+  size_t prefixSize = 0;
+  size_t recordSize = 0;
+  switch (type) {
+    case MessageType::Commands:
+      recordSize = CommandLayout::size;
+      break;
+    case MessageType::MeterAck:
+      recordSize = 0;
+      break;
+    case MessageType::Status:
+      recordSize = StatusLayout::size;
+      if (count != 1) {
+        error = Error::BadFrame;
+        return;
+      }
+      break;
+    case MessageType::Meters:
+      recordSize = MeterLayout::size;
+      break;
+    case MessageType::Spectrum:
+      prefixSize = AnalysisLayout::size;
+      recordSize = SpectrumLayout::size;
+      break;
+    case MessageType::Scope:
+      prefixSize = AnalysisLayout::size;
+      recordSize = ScopeLayout::size;
+      break;
+    default:
+      error = Error::UnknownMessage;
+      return;
+  }
+
+  if (size != HeaderLayout::size + prefixSize + (size_t)count * recordSize) {
+    error = Error::BadFrame;
+  }
+}
+
+Status FrameView::getStatus() const noexcept {
+  const auto* record = data + HeaderLayout::size;
+  Status status;
+  status.firstCommandId =
+      Bytes::readUInt<juce::uint32>(record + StatusLayout::firstCommandId);
+  status.accepted = Bytes::readUInt<juce::uint16>(record + StatusLayout::accepted);
+  status.error = (Error)Bytes::readUInt<juce::uint16>(record + StatusLayout::error);
+  status.appliedCommand =
+      Bytes::readUInt<juce::uint32>(record + StatusLayout::appliedCommand);
+  status.trackCount = Bytes::readUInt<juce::uint32>(record + StatusLayout::trackCount);
+  return status;
+}
+
+AnalysisInfo FrameView::getAnalysisInfo() const noexcept {
+  const auto* prefix = data + HeaderLayout::size;
+  AnalysisInfo info;
+  info.subscription =
+      Bytes::readUInt<juce::uint32>(prefix + AnalysisLayout::subscription);
+  info.span = Bytes::readUInt<juce::uint32>(prefix + AnalysisLayout::span);
+  info.end = Bytes::readUInt<juce::uint64>(prefix + AnalysisLayout::end);
+  info.sampleRate = Bytes::readFloat(prefix + AnalysisLayout::sampleRate);
+  return info;
+}
+
+//==============================================================================
+void beginFrame(std::string& out, MessageType type, juce::uint32 sequence) {
+  out.assign(HeaderLayout::size, '\0');
+  auto* header = reinterpret_cast<juce::uint8*>(&out[0]);
+  header[HeaderLayout::version] = kVersion;
+  header[HeaderLayout::type] = (juce::uint8)type;
+  Bytes::writeUInt(header + HeaderLayout::sequence, sequence);
+}
+
+void appendCommand(std::string& out, Op op, Timing timing, juce::uint32 track,
+                   double value, double when, juce::uint8 note) {
+  auto* record = appendRecord(out, CommandLayout::size);
+  record[CommandLayout::op] = (juce::uint8)op;
+  record[CommandLayout::timing] = (juce::uint8)timing;
+  record[CommandLayout::note] = note;
+  Bytes::writeUInt(record + CommandLayout::track, track);
+  Bytes::writeDouble(record + CommandLayout::value, value);
+  Bytes::writeDouble(record + CommandLayout::when, when);
+}
+
+void appendMeter(std::string& out, float peak, float truePeak, float rms) {
+  auto* record = appendRecord(out, MeterLayout::size);
+  Bytes::writeFloat(record + MeterLayout::peak, peak);
+  Bytes::writeFloat(record + MeterLayout::truePeak, truePeak);
+  Bytes::writeFloat(record + MeterLayout::rms, rms);
+}
+
+void beginAnalysisFrame(std::string& out, MessageType type,
+                        juce::uint32 sequence, const AnalysisInfo& info) {
+  beginFrame(out, type, sequence);
+  out.resize(HeaderLayout::size + AnalysisLayout::size, '\0');
+  auto* prefix = reinterpret_cast<juce::uint8*>(&out[0]) + HeaderLayout::size;
+  Bytes::writeUInt(prefix + AnalysisLayout::subscription, info.subscription);
+  Bytes::writeUInt(prefix + AnalysisLayout::span, info.span);
+  Bytes::writeUInt(prefix + AnalysisLayout::end, info.end);
+  Bytes::writeFloat(prefix + AnalysisLayout::sampleRate, info.sampleRate);
+}
+
+void appendSpectrum(std::string& out, const float* magnitudesDb, int count) {
+  auto* record = appendRecords(out, SpectrumLayout::size, count);
+  for (int i = 0; i < count; ++i, record += SpectrumLayout::size) {
+    Bytes::writeFloat(record + SpectrumLayout::magnitude, magnitudesDb[i]);
+  }
+}
+
+void appendScope(std::string& out, const float* minimums, const float* maximums,
+                 int count) {
+  auto* record = appendRecords(out, ScopeLayout::size, count);
+  for (int i = 0; i < count; ++i, record += ScopeLayout::size) {
+    Bytes::writeFloat(record + ScopeLayout::min, minimums[i]);
+    Bytes::writeFloat(record + ScopeLayout::max, maximums[i]);
+  }
+}
+
+void appendStatus(std::string& out, const Status& status) {
+  jassert(out.size() == HeaderLayout::size);
+  out.resize(HeaderLayout::size + StatusLayout::size, '\0');
+  auto* header = reinterpret_cast<juce::uint8*>(&out[0]);
+  writeStatusRecord(header + HeaderLayout::size, status);
+  Bytes::writeUInt(header + HeaderLayout::count, (juce::uint16)1);
+}
+
+void writeStatusFrame(std::string& out, juce::uint32 sequence, const Status& status) {
+  // Every byte is written below: no clearing first
+  out.resize(HeaderLayout::size + StatusLayout::size);
+  auto* header = reinterpret_cast<juce::uint8*>(&out[0]);
+  header[HeaderLayout::version] = kVersion;
+  header[HeaderLayout::type] = (juce::uint8)MessageType::Status;
+  Bytes::writeUInt(header + HeaderLayout::count, (juce::uint16)1);
+  Bytes::writeUInt(header + HeaderLayout::sequence, sequence);
+  writeStatusRecord(header + HeaderLayout::size, status);
+}
+
+//==============================================================================
+juce::var getSchema() {
+  auto* messages = new juce::DynamicObject();
+  messages->setProperty(
+      "commands", makeMessage(MessageType::Commands,
+                              makeLayout(commandFields, CommandLayout::size)));
+  messages->setProperty("meterAck", makeMessage(MessageType::MeterAck, {}));
+  messages->setProperty(
+      "status", makeMessage(MessageType::Status,
+                            makeLayout(statusFields, StatusLayout::size)));
+  messages->setProperty(
+      "meters", makeMessage(MessageType::Meters,
+                            makeLayout(meterFields, MeterLayout::size)));
+  const auto analysisPrefix = makeLayout(analysisFields, AnalysisLayout::size);
+  messages->setProperty(
+      "spectrum", makeMessage(MessageType::Spectrum,
+                              makeLayout(spectrumFields, SpectrumLayout::size),
+                              analysisPrefix));
+  messages->setProperty(
+      "scope", makeMessage(MessageType::Scope,
+                           makeLayout(scopeFields, ScopeLayout::size),
+                           analysisPrefix));
+
+  auto* enums = new juce::DynamicObject();
+  enums->setProperty("op", makeEnum({{"setTrackVolume", (int)Op::SetTrackVolume},
+                                     {"setTrackMute", (int)Op::SetTrackMute},
+                                     {"setMasterVolume", (int)Op::SetMasterVolume},
+                                     {"play", (int)Op::Play},
+                                     {"stop", (int)Op::Stop},
+                                     {"seek", (int)Op::Seek},
+                                     {"setTrackPan", (int)Op::SetTrackPan},
+                                     {"setBusVolume", (int)Op::SetBusVolume},
+                                     {"setBusMute", (int)Op::SetBusMute},
+                                     {"setBusPan", (int)Op::SetBusPan},
+                                     {"setSendLevel", (int)Op::SetSendLevel},
+                                     {"noteOn", (int)Op::NoteOn},
+                                     {"noteOff", (int)Op::NoteOff},
+                                     {"setTrackMidiInput", (int)Op::SetTrackMidiInput}}));
+  enums->setProperty("timing", makeEnum({{"immediate", (int)Timing::Immediate},
+                                         {"sample", (int)Timing::Sample},
+                                         {"beat", (int)Timing::Beat},
+                                         {"seconds", (int)Timing::Seconds}}));
+
+  juce::Array<juce::var> errors;
+  for (int error = (int)Error::None; error <= (int)Error::NoSuchSend; ++error) {
+    errors.add(getErrorName((Error)error));
+  }
+  enums->setProperty("error", errors);
+
+  auto* schema = new juce::DynamicObject();
+  schema->setProperty("version", (int)kVersion);
+  schema->setProperty("byteOrder", "little");
+  schema->setProperty("header", makeLayout(headerFields, HeaderLayout::size));
+  schema->setProperty("messages", juce::var(messages));
+  schema->setProperty("enums", juce::var(enums));
+  return juce::var(schema);
+}
+
+const char* getErrorName(Error error) noexcept {
+  switch (error) {
+    case Error::None:
+      return "none";
+    case Error::BadFrame:
+      return "badFrame";
+    case Error::UnsupportedVersion:
+      return "unsupportedVersion";
+    case Error::UnknownMessage:
+      return "unknownMessage";
+    case Error::NoSuchTrack:
+      return "noSuchTrack";
+    case Error::QueueFull:
+      return "queueFull";
+    case Error::NotNegotiated:
+      return "notNegotiated";
+    case Error::NoSuchBus:
+      return "noSuchBus";
+    case Error::NoSuchSend:
+      return "noSuchSend";
+  }
+  return "unknown";
+}
+
+}  // namespace ControlProtocol
@@ -0,0 +1,399 @@
+#include "disk-streamer.hpp"
+#include <time.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+// Disk thread sleep when every ring is full; readers wake it on seeks
+constexpr long kIdleWaitNanoseconds = 5000000;
+
+}  // namespace
+
+//==============================================================================
+// SampleStream
+
+SampleStream::SampleStream(ReaderFactory readerFactory, double sampleRate,
+                           int bufferFrames, DiskStreamer* streamer)
+    : factory(std::move(readerFactory)), owner(streamer) {
+  if (factory) {
+    reader = factory();
+  }
+  if (reader == nullptr || reader->sampleRate <= 0.0 || reader->numChannels == 0) {
+    reader.reset();
+    return;
+  }
+
+  memoryMapped =
+      dynamic_cast<juce::MemoryMappedAudioFormatReader*>(reader.get()) != nullptr;
+  numChannels = juce::jmin((int)reader->numChannels, kMaxChannels);
+  sourceSampleRate = reader->sampleRate;
+  sourceLength = reader->lengthInSamples;
+
+  capacity = juce::nextPowerOfTwo(juce::jmax(bufferFrames, 64));
+  ring.setSize(numChannels, capacity);
+
+  // Prefetch the start before the first read
+  requestSeek(0, sampleRate);
+}
+
+SampleStream::~SampleStream() = default;
+
+juce::int64 SampleStream::getLength(double sampleRate) const noexcept {
+  if (sourceSampleRate <= 0.0) {
+    return 0;
+  }
+  return (juce::int64)std::ceil((double)sourceLength * sampleRate / sourceSampleRate -
+                                1.0e-6);
+}
+
+int SampleStream::read(juce::int64 frame, double sampleRate,
+                       float* const* destinations, int numDestinations,
+                       int numFrames) noexcept {
+  numDestinations = juce::jmin(numDestinations, kMaxChannels);
+  if (!isValid()) {
+    for (int channel = 0; channel < numDestinations; ++channel) {
+      juce::FloatVectorOperations::clear(destinations[channel], numFrames);
+    }
+    return 0;
+  }
+
+  // Silence before the start of the file
+  const juce::int64 first = juce::jmax<juce::int64>(frame, 0);
+  const int leadIn = (int)juce::jmin<juce::int64>(numFrames, first - frame);
+
+  if (first != nextFrame || sampleRate != readerRate) {
+    requestSeek(first, sampleRate);
+  }
+
+  // ... and after its end
+  const int inFile =
+      (int)juce::jlimit<juce::int64>(0, numFrames - leadIn, readerLength - first);
+
+  int delivered = consume(first, destinations, numDestinations, leadIn, inFile);
+  if (owner == nullptr) {
+    while (delivered < inFile && prefetch(capacity) > 0) {
+      delivered += consume(first + delivered, destinations, numDestinations,
+                           leadIn + delivered, inFile - delivered);
+    }
+  }
+
+  // Silence while a seek is pending is expected, later gaps are underruns
+  const bool underrun = primed && delivered < inFile;
+  if (underrun) {
+    underrunFrames.fetch_add((juce::uint64)(inFile - delivered),
+                             std::memory_order_relaxed);
+  }
+  primed = primed || delivered > 0;
+
+  for (int channel = 0; channel < numDestinations; ++channel) {
+    juce::FloatVectorOperations::clear(destinations[channel], leadIn);
+    juce::FloatVectorOperations::clear(destinations[channel] + leadIn + delivered,
+                                       numFrames - leadIn - delivered);
+  }
+
+  nextFrame = first + (numFrames - leadIn);
+
+  // The disk thread fell behind: have it continue from the next block rather
+  // than decode frames which are already late. Still an underrun until then.
+  if (underrun && owner != nullptr) {
+    requestSeek(nextFrame, sampleRate);
+    primed = true;
+  }
+  return delivered;
+}
+
+int SampleStream::getBufferedFrames() const noexcept {
+  const auto start = unpack(segment.load(std::memory_order_acquire)).startIndex;
+  const auto written = writeIndex.load(std::memory_order_acquire);
+  const auto position = std::max(readIndex.load(std::memory_order_acquire), start);
+  return written > position ? (int)(written - position) : 0;
+}
+
+bool SampleStream::hasPendingSeek() const noexcept {
+  return (requestSequence.load(std::memory_order_acquire) & 0xFFFFu) !=
+         unpack(segment.load(std::memory_order_acquire)).sequence;
+}
+
+int SampleStream::prefetch(int maxFrames) {
+  if (!isValid()) {
+    return 0;
+  }
+  takeRequest();
+
+  // Frames before the segment start are stale: the reader skips them
+  const auto written = writeIndex.load(std::memory_order_relaxed);
+  const auto start = unpack(segment.load(std::memory_order_relaxed)).startIndex;
+  const auto position = std::max(readIndex.load(std::memory_order_acquire), start);
+  const int space = capacity - (int)(written - position);
+
+  // Refill in large reads rather than topping up after every block
+  if (space < capacity / 8) {
+    return 0;
+  }
+
+  const int numFrames = (int)juce::jmin<juce::int64>(space, maxFrames,
+                                                     outputLength - outputFrame);
+  if (numFrames <= 0) {
+    return 0;
+  }
+
+  // Up to the end of the ring, then wrapped around to its start
+  const int offset = (int)(written & (std::uint64_t)(capacity - 1));
+  const int firstPart = juce::jmin(numFrames, capacity - offset);
+  float* destinations[kMaxChannels] = {};
+  for (int channel = 0; channel < numChannels; ++channel) {
+    destinations[channel] = ring.getWritePointer(channel, offset);
+  }
+  decode(destinations, firstPart);
+
+  if (firstPart < numFrames) {
+    for (int channel = 0; channel < numChannels; ++channel) {
+      destinations[channel] = ring.getWritePointer(channel);
+    }
+    decode(destinations, numFrames - firstPart);
+  }
+
+  writeIndex.store(written + (std::uint64_t)numFrames, std::memory_order_release);
+  outputFrame += numFrames;
+  return numFrames;
+}
+
+void SampleStream::requestSeek(juce::int64 frame, double sampleRate) noexcept {
+  const std::uint32_t sequence = readerSequence + 2;
+  requestSequence.store(sequence - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  requestFrame.store(frame, std::memory_order_relaxed);
+  requestRate.store(sampleRate, std::memory_order_relaxed);
+  requestSequence.store(sequence, std::memory_order_release);
+
+  readerSequence = sequence;
+  seekFrame = frame;
+  nextFrame = frame;
+  readerRate = sampleRate;
+  readerLength = getLength(sampleRate);
+  primed = false;
+
+  if (owner != nullptr) {
+    owner->wakeUp();
+  }
+}
+
+void SampleStream::takeRequest() {
+  for (;;) {
+    const auto sequence = requestSequence.load(std::memory_order_acquire);
+    // Odd: being written, the reader wakes us again once it is complete
+    if (sequence == diskSequence || (sequence & 1u) != 0) {
+      return;
+    }
+
+    const auto frame = requestFrame.load(std::memory_order_relaxed);
+    const auto sampleRate = requestRate.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (requestSequence.load(std::memory_order_relaxed) != sequence) {
+      continue;
+    }
+
+    diskSequence = sequence;
+    speedRatio = sourceSampleRate / sampleRate;
+    outputLength = getLength(sampleRate);
+    outputFrame = frame;
+    if (speedRatio == 1.0) {
+      sourcePosition = frame;
+    } else {
+      sourcePosition = (juce::int64)std::floor((double)frame * speedRatio);
+      for (auto& interpolator : interpolators) {
+        interpolator.reset();
+      }
+    }
+
+    segment.store(pack({writeIndex.load(std::memory_order_relaxed), sequence}),
+                  std::memory_order_release);
+    return;
+  }
+}
+
+void SampleStream::decode(float* const* destinations, int numFrames) {
+  // A few extra source frames for the interpolators to look ahead
+  const int sourceFrames =
+      speedRatio == 1.0 ? numFrames : (int)std::ceil(numFrames * speedRatio) + 4;
+  scratch.setSize(numChannels, sourceFrames, false, false, true);
+  reader->read(&scratch, 0, sourceFrames, sourcePosition, true, true);
+
+  if (speedRatio == 1.0) {
+    for (int channel = 0; channel < numChannels; ++channel) {
+      juce::FloatVectorOperations::copy(destinations[channel],
+                                        scratch.getReadPointer(channel), numFrames);
+    }
+    sourcePosition += numFrames;
+    return;
+  }
+
+  int used = 0;
+  for (int channel = 0; channel < numChannels; ++channel) {
+    used = interpolators[(size_t)channel].process(
+        speedRatio, scratch.getReadPointer(channel), destinations[channel], numFrames);
+  }
+  sourcePosition += used;
+}
+
+int SampleStream::consume(juce::int64 frame, float* const* destinations,
+                          int numDestinations, int offset,
+                          int numFrames) noexcept {
+  // Segment first: once it matches, the write index includes its start
+  const auto current = unpack(segment.load(std::memory_order_acquire));
+  if (current.sequence != (readerSequence & 0xFFFFu) || numFrames <= 0) {
+    return 0;
+  }
+
+  // Frames of the segment follow each other from the seek frame on, so
+  // frames missed by the reader are skipped
+  const auto written = writeIndex.load(std::memory_order_acquire);
+  auto position = current.startIndex + (std::uint64_t)(frame - seekFrame);
+  const int count =
+      written > position
+          ? (int)std::min<std::uint64_t>(written - position, (std::uint64_t)numFrames)
+          : 0;
+  if (count == 0) {
+    readIndex.store(std::min(position, written), std::memory_order_release);
+    return 0;
+  }
+
+  for (int done = 0; done < count;) {
+    const int index = (int)(position & (std::uint64_t)(capacity - 1));
+    const int part = juce::jmin(count - done, capacity - index);
+
+    if (numDestinations == 1 && numChannels == 2) {
+      // Mono sum of a stereo file
+      float* output = destinations[0] + offset + done;
+      juce::FloatVectorOperations::copyWithMultiply(
+          output, ring.getReadPointer(0, index), 0.5f, part);
+      juce::FloatVectorOperations::addWithMultiply(
+          output, ring.getReadPointer(1, index), 0.5f, part);
+    } else {
+      for (int channel = 0; channel < numDestinations; ++channel) {
+        juce::FloatVectorOperations::copy(
+            destinations[channel] + offset + done,
+            ring.getReadPointer(juce::jmin(channel, numChannels - 1), index), part);
+      }
+    }
+
+    done += part;
+    position += (std::uint64_t)part;
+  }
+
+  readIndex.store(position, std::memory_order_release);
+  return count;
+}
+
+//==============================================================================
+// DiskStreamer
+
+DiskStreamer::DiskStreamer(int bufferFrames, int chunkFrames)
+    : bufferFrames(bufferFrames), chunkFrames(chunkFrames) {
+  sem_init(&wakeUpSignal, 0, 0);
+  thread = std::thread([this]() { run(); });
+}
+
+DiskStreamer::~DiskStreamer() {
+  shouldExit.store(true);
+  wakeUp();
+  thread.join();
+  sem_destroy(&wakeUpSignal);
+}
+
+std::shared_ptr<SampleStream> DiskStreamer::createStream(const juce::File& file,
+                                                         double sampleRate) {
+  return createStream(getReaderFactory(file), sampleRate);
+}
+
+std::shared_ptr<SampleStream> DiskStreamer::createStream(
+    SampleStream::ReaderFactory factory, double sampleRate) {
+  auto stream = std::make_shared<SampleStream>(std::move(factory), sampleRate,
+                                               bufferFrames, this);
+  if (!stream->isValid()) {
+    return nullptr;
+  }
+
+  {
+    const std::lock_guard<std::mutex> lock(streamsMutex);
+    streams.push_back(stream);
+  }
+  wakeUp();
+  return stream;
+}
+
+SampleStream::ReaderFactory DiskStreamer::getReaderFactory(const juce::File& file) {
+  return [file]() -> std::unique_ptr<juce::AudioFormatReader> {
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    // Uncompressed formats (WAV, AIFF) map the file: decoding is a copy
+    // from the page cache, faulted in by the disk thread
+    if (auto* format = formats.findFormatForFileExtension(file.getFileExtension())) {
+      std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped(
+          format->createMemoryMappedReader(file));
+      if (mapped != nullptr && mapped->mapEntireFile()) {
+        return mapped;
+      }
+    }
+    return std::unique_ptr<juce::AudioFormatReader>(formats.createReaderFor(file));
+  };
+}
+
+int DiskStreamer::getNumStreams() const {
+  const std::lock_guard<std::mutex> lock(streamsMutex);
+  return (int)std::count_if(streams.begin(), streams.end(),
+                            [](const auto& stream) { return !stream.expired(); });
+}
+
+void DiskStreamer::run() {
+  std::vector<std::shared_ptr<SampleStream>> active;
+  std::vector<std::pair<int, SampleStream*>> order;
+
+  while (!shouldExit.load()) {
+    {
+      const std::lock_guard<std::mutex> lock(streamsMutex);
+      streams.erase(std::remove_if(streams.begin(), streams.end(),
+                                   [](const auto& stream) { return stream.expired(); }),
+                    streams.end());
+      for (const auto& stream : streams) {
+        if (auto locked = stream.lock()) {
+          active.push_back(std::move(locked));
+        }
+      }
+    }
+
+    // Pending seeks first, then the streams closest to running dry
+    order.clear();
+    for (const auto& stream : active) {
+      order.emplace_back(stream->hasPendingSeek() ? -1 : stream->getBufferedFrames(),
+                         stream.get());
+    }
+    std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) {
+      return a.first < b.first;
+    });
+
+    int written = 0;
+    for (const auto& entry : order) {
+      written += entry.second->prefetch(chunkFrames);
+    }
+
+    // Streams of removed tracks are destroyed here, off the audio thread
+    active.clear();
+
+    if (written == 0) {
+      timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += kIdleWaitNanoseconds;
+      if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_nsec -= 1000000000;
+        ++deadline.tv_sec;
+      }
+      while (sem_timedwait(&wakeUpSignal, &deadline) != 0 && errno == EINTR) {
+      }
+    }
+  }
+}
@@ -0,0 +1,325 @@
+#include "engine-profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+
+namespace {
+
+const double secondsBounds[] = {1.0e-6, 2.5e-6, 5.0e-6, 1.0e-5, 2.5e-5, 5.0e-5,
+                                1.0e-4, 2.5e-4, 5.0e-4, 1.0e-3, 2.5e-3, 5.0e-3,
+                                1.0e-2, 2.5e-2, 5.0e-2, 1.0e-1};
+
+const double loadBounds[] = {0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7,
+                             0.8, 0.9, 1.0, 1.25, 1.5, 2.0};
+
+const double* getBounds(Histogram::Scale scale) noexcept {
+  return scale == Histogram::Scale::Seconds ? secondsBounds : loadBounds;
+}
+
+std::string formatNumber(double value) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.9g", value);
+  return text;
+}
+
+void writeHeader(std::string& out, const char* name, const char* help,
+                 const char* type) {
+  out += "# HELP ";
+  out += name;
+  out += ' ';
+  out += help;
+  out += "\n# TYPE ";
+  out += name;
+  out += ' ';
+  out += type;
+  out += '\n';
+}
+
+// One histogram series; label is empty or `name="value"`
+void writeHistogram(std::string& out, const char* name, Histogram::Scale scale,
+                    const Histogram::Snapshot& snapshot,
+                    const std::string& label = {}) {
+  const std::string separator = label.empty() ? "" : ",";
+  juce::uint64 cumulative = 0;
+  const int numBounds = Histogram::getNumBounds(scale);
+
+  for (int bucket = 0; bucket <= numBounds; ++bucket) {
+    cumulative += snapshot.counts[(size_t)bucket];
+    out += name;
+    out += "_bucket{" + label + separator + "le=\"";
+    out += bucket < numBounds ? formatNumber(Histogram::getBound(scale, bucket))
+                              : std::string("+Inf");
+    out += "\"} " + std::to_string(cumulative) + '\n';
+  }
+
+  const std::string labels = label.empty() ? "" : "{" + label + "}";
+  out += name;
+  out += "_sum" + labels + ' ' + formatNumber(snapshot.sum) + '\n';
+  out += name;
+  out += "_count" + labels + ' ' + std::to_string(cumulative) + '\n';
+}
+
+void writeValue(std::string& out, const char* name, double value) {
+  out += name;
+  out += ' ' + formatNumber(value) + '\n';
+}
+
+// Mean, quantiles of an interval and peak of the whole run
+juce::var summarize(Histogram::Scale scale, const Histogram::Snapshot& interval) {
+  auto* summary = new juce::DynamicObject();
+  summary->setProperty("mean", interval.getMean());
+  summary->setProperty("p50", interval.getQuantile(scale, 0.5));
+  summary->setProperty("p99", interval.getQuantile(scale, 0.99));
+  summary->setProperty("peak", interval.max);
+  return juce::var(summary);
+}
+
+}  // namespace
+
+//==============================================================================
+juce::uint64 Histogram::Snapshot::getCount() const noexcept {
+  juce::uint64 count = 0;
+  for (const auto value : counts) {
+    count += value;
+  }
+  return count;
+}
+
+double Histogram::Snapshot::getMean() const noexcept {
+  const auto count = getCount();
+  return count > 0 ? sum / (double)count : 0.0;
+}
+
+double Histogram::Snapshot::getQuantile(Scale scale, double q) const noexcept {
+  const auto count = getCount();
+  if (count == 0) {
+    return 0.0;
+  }
+
+  const auto rank = std::max<juce::uint64>(
+      1, (juce::uint64)std::ceil(juce::jlimit(0.0, 1.0, q) * (double)count));
+  const int numBounds = getNumBounds(scale);
+  juce::uint64 cumulative = 0;
+  for (int bucket = 0; bucket < numBounds; ++bucket) {
+    cumulative += counts[(size_t)bucket];
+    if (cumulative >= rank) {
+      return getBound(scale, bucket);
+    }
+  }
+  return max;
+}
+
+Histogram::Snapshot Histogram::Snapshot::since(
+    const Snapshot& earlier) const noexcept {
+  Snapshot interval = *this;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    if (earlier.counts[i] > counts[i]) {
+      // Not the same histogram (reset, or another track at this index)
+      return *this;
+    }
+    interval.counts[i] -= earlier.counts[i];
+  }
+  interval.sum = std::max(0.0, sum - earlier.sum);
+  return interval;
+}
+
+Histogram::Histogram(const Histogram& other) noexcept : scale(other.scale) {
+  for (size_t i = 0; i < counts.size(); ++i) {
+    counts[i].store(other.counts[i].load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+  }
+  sum.store(other.sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  max.store(other.max.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+int Histogram::getNumBounds(Scale scale) noexcept {
+  return scale == Scale::Seconds ? (int)std::size(secondsBounds)
+                                 : (int)std::size(loadBounds);
+}
+
+double Histogram::getBound(Scale scale, int bucket) noexcept {
+  return getBounds(scale)[bucket];
+}
+
+void Histogram::record(double value) noexcept {
+  const double* bounds = getBounds(scale);
+  const int numBounds = getNumBounds(scale);
+  const auto bucket =
+      (size_t)(std::lower_bound(bounds, bounds + numBounds, value) - bounds);
+
+  // Single writer: plain stores, no read-modify-write
+  counts[bucket].store(counts[bucket].load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+  sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+  if (value > max.load(std::memory_order_relaxed)) {
+    max.store(value, std::memory_order_relaxed);
+  }
+}
+
+Histogram::Snapshot Histogram::getSnapshot() const noexcept {
+  Snapshot snapshot;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    snapshot.counts[i] = counts[i].load(std::memory_order_relaxed);
+  }
+  snapshot.sum = sum.load(std::memory_order_relaxed);
+  snapshot.max = max.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+void Histogram::reset() noexcept {
+  for (auto& count : counts) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  sum.store(0.0, std::memory_order_relaxed);
+  max.store(0.0, std::memory_order_relaxed);
+}
+
+//==============================================================================
+double EngineProfiler::toSeconds(juce::int64 ticks) noexcept {
+  static const double secondsPerTick =
+      1.0 / (double)juce::Time::getHighResolutionTicksPerSecond();
+  return (double)ticks * secondsPerTick;
+}
+
+void EngineProfiler::recordCallback(juce::int64 ticks, int numSamples) noexcept {
+  const double seconds = toSeconds(ticks);
+  callbackTime.record(seconds);
+
+  const double deadline = numSamples / sampleRate.load(std::memory_order_relaxed);
+  if (deadline > 0.0) {
+    load.record(seconds / deadline);
+    if (seconds > deadline) {
+      missedDeadlines.store(missedDeadlines.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+    }
+  }
+}
+
+void EngineProfiler::recordPhases(juce::int64 renderTicks,
+                                  juce::int64 mixTicks) noexcept {
+  renderTime.record(toSeconds(renderTicks));
+  mixTime.record(toSeconds(mixTicks));
+}
+
+void EngineProfiler::capture(const std::vector<const Histogram*>& trackHistograms,
+                             ProfileSnapshot& snapshot) const {
+  snapshot.callback = callbackTime.getSnapshot();
+  snapshot.load = load.getSnapshot();
+  snapshot.render = renderTime.getSnapshot();
+  snapshot.mix = mixTime.getSnapshot();
+  snapshot.missedDeadlines = missedDeadlines.load(std::memory_order_relaxed);
+  snapshot.detailed = isDetailed();
+
+  snapshot.tracks.resize(trackHistograms.size());
+  for (size_t i = 0; i < trackHistograms.size(); ++i) {
+    snapshot.tracks[i] = trackHistograms[i]->getSnapshot();
+  }
+}
+
+void EngineProfiler::writePrometheus(const ProfileSnapshot& snapshot,
+                                     std::string& out) {
+  using Scale = Histogram::Scale;
+
+  writeHeader(out, "daw_callback_duration_seconds",
+              "Time spent in the audio callback", "histogram");
+  writeHistogram(out, "daw_callback_duration_seconds", Scale::Seconds,
+                 snapshot.callback);
+
+  writeHeader(out, "daw_dsp_load",
+              "Callback duration over the duration of its buffer", "histogram");
+  writeHistogram(out, "daw_dsp_load", Scale::Load, snapshot.load);
+
+  writeHeader(out, "daw_dsp_load_peak", "Highest DSP load since the start",
+              "gauge");
+  writeValue(out, "daw_dsp_load_peak", snapshot.load.max);
+
+  writeHeader(out, "daw_missed_deadlines_total",
+              "Callbacks which took longer than their buffer", "counter");
+  writeValue(out, "daw_missed_deadlines_total", (double)snapshot.missedDeadlines);
+
+  if (snapshot.deviceXRuns >= 0) {
+    writeHeader(out, "daw_device_xruns_total",
+                "Buffer under/overruns reported by the audio device", "counter");
+    writeValue(out, "daw_device_xruns_total", snapshot.deviceXRuns);
+  }
+
+  writeHeader(out, "daw_midi_latency_seconds",
+              "Delay from the arrival of a MIDI event to its sample", "histogram");
+  writeHistogram(out, "daw_midi_latency_seconds", Scale::Seconds,
+                 snapshot.midiLatency);
+
+  writeHeader(out, "daw_midi_jitter_seconds",
+              "Distance of each MIDI event's delay from one block", "histogram");
+  writeHistogram(out, "daw_midi_jitter_seconds", Scale::Seconds,
+                 snapshot.midiJitter);
+
+  writeHeader(out, "daw_midi_dropped_total",
+              "MIDI events lost to a full input queue", "counter");
+  writeValue(out, "daw_midi_dropped_total", (double)snapshot.midiDropped);
+
+  writeHeader(out, "daw_profiling_detailed",
+              "1 while per-track, render and mix timing is on", "gauge");
+  writeValue(out, "daw_profiling_detailed", snapshot.detailed ? 1.0 : 0.0);
+
+  writeHeader(out, "daw_render_duration_seconds",
+              "Time spent rendering tracks per block (wall clock)", "histogram");
+  writeHistogram(out, "daw_render_duration_seconds", Scale::Seconds,
+                 snapshot.render);
+
+  writeHeader(out, "daw_mix_duration_seconds",
+              "Time spent per block outside track rendering", "histogram");
+  writeHistogram(out, "daw_mix_duration_seconds", Scale::Seconds, snapshot.mix);
+
+  writeHeader(out, "daw_track_render_duration_seconds",
+              "Time spent in renderBlock() per track and span", "histogram");
+  for (size_t i = 0; i < snapshot.tracks.size(); ++i) {
+    writeHistogram(out, "daw_track_render_duration_seconds", Scale::Seconds,
+                   snapshot.tracks[i], "track=\"" + std::to_string(i) + "\"");
+  }
+}
+
+juce::var EngineProfiler::describe(const ProfileSnapshot& current,
+                                   const ProfileSnapshot& previous) {
+  using Scale = Histogram::Scale;
+
+  const auto callbacks = current.callback.since(previous.callback);
+  auto* summary = new juce::DynamicObject();
+  summary->setProperty("callbacks", (juce::int64)callbacks.getCount());
+  summary->setProperty(
+      "missedDeadlines",
+      (juce::int64)(current.missedDeadlines >= previous.missedDeadlines
+                        ? current.missedDeadlines - previous.missedDeadlines
+                        : current.missedDeadlines));
+  summary->setProperty("totalMissedDeadlines", (juce::int64)current.missedDeadlines);
+  summary->setProperty("deviceXRuns", current.deviceXRuns);
+  summary->setProperty("load", summarize(Scale::Load, current.load.since(previous.load)));
+  summary->setProperty("callback", summarize(Scale::Seconds, callbacks));
+  summary->setProperty("detailed", current.detailed);
+
+  const auto midiLatency = current.midiLatency.since(previous.midiLatency);
+  auto* midi = new juce::DynamicObject();
+  midi->setProperty("events", (juce::int64)midiLatency.getCount());
+  midi->setProperty("latency", summarize(Scale::Seconds, midiLatency));
+  midi->setProperty("jitter", summarize(Scale::Seconds,
+                                        current.midiJitter.since(previous.midiJitter)));
+  midi->setProperty("dropped", (juce::int64)current.midiDropped);
+  summary->setProperty("midi", juce::var(midi));
+
+  if (current.detailed) {
+    summary->setProperty(
+        "render", summarize(Scale::Seconds, current.render.since(previous.render)));
+    summary->setProperty(
+        "mix", summarize(Scale::Seconds, current.mix.since(previous.mix)));
+
+    juce::Array<juce::var> tracks;
+    for (size_t i = 0; i < current.tracks.size(); ++i) {
+      tracks.add(summarize(Scale::Seconds,
+                           i < previous.tracks.size()
+                               ? current.tracks[i].since(previous.tracks[i])
+                               : current.tracks[i]));
+    }
+    summary->setProperty("tracks", tracks);
+  }
+  return juce::var(summary);
+}
@@ -0,0 +1,193 @@
+#include "envelope-generator.hpp"
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Curved segments cover e^-5 of their asymptotic distance: a pronounced but
+// still musical bend
+constexpr double kCurvature = 5.0;
+
+}  // namespace
+
+EnvelopeGenerator::EnvelopeGenerator(const ADSRParameters& parameters,
+                                     double sampleRate)
+    : parameters(parameters), sampleRate(sampleRate) {}
+
+void EnvelopeGenerator::setParameters(const ADSRParameters& newParameters) {
+  parameters = newParameters;
+}
+
+void EnvelopeGenerator::setSampleRate(double newSampleRate) {
+  sampleRate = newSampleRate;
+}
+
+void EnvelopeGenerator::noteOn() {
+  startSegment(Stage::Attack, getValue(), 1.0f, parameters.attackTime,
+               parameters.attackCurve);
+}
+
+void EnvelopeGenerator::noteOff() {
+  if (stage == Stage::Idle) {
+    return;
+  }
+  startSegment(Stage::Release, getValue(), 0.0f, parameters.releaseTime,
+               parameters.releaseCurve);
+}
+
+void EnvelopeGenerator::reset() {
+  stage = Stage::Idle;
+  target = 0.0f;
+  length = 0;
+  position = 0;
+}
+
+float EnvelopeGenerator::getValue() const {
+  switch (stage) {
+    case Stage::Idle:
+      return 0.0f;
+    case Stage::Sustain:
+      return target;
+    default:
+      return curve == ADSRParameters::Curve::Linear
+                 ? start + (float)position * increment
+                 : asymptote + distance;
+  }
+}
+
+juce::int64 EnvelopeGenerator::getRemainingSamples() const {
+  if (stage == Stage::Idle || stage == Stage::Sustain) {
+    return -1;
+  }
+  return length - position;
+}
+
+void EnvelopeGenerator::startSegment(Stage newStage, float from,
+                                     float newTarget, float seconds,
+                                     ADSRParameters::Curve newCurve) {
+  stage = newStage;
+  target = newTarget;
+  curve = newCurve;
+  position = 0;
+  length = (juce::int64)std::llround(std::max(0.0f, seconds) * sampleRate);
+
+  if (length == 0) {
+    finishSegment();
+    return;
+  }
+
+  start = from;
+  increment = (newTarget - from) / (float)length;
+
+  if (curve != ADSRParameters::Curve::Linear) {
+    // value(n) = asymptote + (from - asymptote) * m^n, with value(length)
+    // landing exactly on the target
+    const double bend = curve == ADSRParameters::Curve::Exponential
+                            ? -kCurvature
+                            : kCurvature;
+    const double endRatio = std::exp(bend);
+    const double solved =
+        ((double)newTarget - (double)from * endRatio) / (1.0 - endRatio);
+
+    asymptote = (float)solved;
+    distance = (float)((double)from - solved);
+    multiplier = (float)std::exp(bend / (double)length);
+  }
+}
+
+void EnvelopeGenerator::finishSegment() {
+  switch (stage) {
+    case Stage::Attack:
+      startSegment(Stage::Decay, target, parameters.sustainLevel,
+                   parameters.decayTime, parameters.decayCurve);
+      break;
+    case Stage::Decay:
+      stage = Stage::Sustain;
+      break;
+    case Stage::Release:
+      reset();
+      break;
+    default:
+      break;
+  }
+}
+
+void EnvelopeGenerator::advance(juce::int64 numSamples) {
+  while (numSamples > 0 && stage != Stage::Idle && stage != Stage::Sustain) {
+    const juce::int64 count = std::min(numSamples, length - position);
+
+    if (curve != ADSRParameters::Curve::Linear) {
+      distance = (float)((double)distance *
+                         std::pow((double)multiplier, (double)count));
+    }
+    position += count;
+    numSamples -= count;
+
+    if (position >= length) {
+      finishSegment();
+    }
+  }
+}
+
+void EnvelopeGenerator::renderBlock(float* gains, int numSamples) {
+  process<false>(gains, numSamples);
+}
+
+void EnvelopeGenerator::applyBlock(float* samples, int numSamples) {
+  process<true>(samples, numSamples);
+}
+
+template <bool Apply>
+void EnvelopeGenerator::process(float* data, int numSamples) {
+  int done = 0;
+
+  while (done < numSamples) {
+    const bool bounded = stage != Stage::Idle && stage != Stage::Sustain;
+    const int count =
+        bounded ? (int)std::min<juce::int64>(numSamples - done, length - position)
+                : numSamples - done;
+
+    processSegment<Apply>(data + done, count);
+    done += count;
+
+    if (bounded && position >= length) {
+      finishSegment();
+    }
+  }
+}
+
+template <bool Apply>
+void EnvelopeGenerator::processSegment(float* data, int numSamples) {
+  if (stage == Stage::Idle || stage == Stage::Sustain) {
+    const float value = getValue();
+    if (Apply) {
+      juce::FloatVectorOperations::multiply(data, value, numSamples);
+    } else {
+      juce::FloatVectorOperations::fill(data, value, numSamples);
+    }
+    return;
+  }
+
+  if (curve == ADSRParameters::Curve::Linear) {
+    // Independent per sample: a vectorizable ramp
+    const float base = start + (float)position * increment;
+    const float slope = increment;
+    for (int i = 0; i < numSamples; ++i) {
+      const float value = base + (float)i * slope;
+      data[i] = Apply ? data[i] * value : value;
+    }
+  } else {
+    float current = distance;
+    const float ratio = multiplier;
+    const float offset = asymptote;
+    for (int i = 0; i < numSamples; ++i) {
+      const float value = offset + current;
+      data[i] = Apply ? data[i] * value : value;
+      current *= ratio;
+    }
+    distance = current;
+  }
+
+  position += numSamples;
+}
@@ -0,0 +1,331 @@
+#include "level-meter.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr int kLanes = ChannelMeter::kReductionLanes;
+
+// Samples sharing one true-peak decision. Longer than the interpolator
+// history, so a chunk only depends on itself and the previous chunk.
+constexpr int kChunkSize = 32;
+
+constexpr int kHistory = ChannelMeter::kTruePeakTaps - 1;
+static_assert(kHistory < kChunkSize, "History must fit in one chunk");
+static_assert(ChannelMeter::kTruePeakTaps % 4 == 0, "Taps are summed over 4 lanes");
+
+// Levels below this (-120 dBFS) are reported without interpolation. Also keeps
+// the filter away from the denormals of decaying tails.
+constexpr float kTruePeakFloor = 1.0e-6f;
+
+/**
+ * 4x oversampling interpolator (ITU-R BS.1770 annex 2 style): a 48-tap
+ * windowed sinc split into its three fractional phases. Phase 0 would
+ * return the input samples, which are already measured by the sample peak.
+ */
+struct TruePeakFilter {
+  static constexpr int kPhases = 3;
+  float phases[kPhases][ChannelMeter::kTruePeakTaps];
+
+  // The same taps oldest input first, to read a span forwards
+  float reversed[kPhases][ChannelMeter::kTruePeakTaps];
+
+  // Largest possible output for inputs within [-1, 1]
+  float gain = 0.0f;
+
+  TruePeakFilter() {
+    constexpr int kOversampling = kPhases + 1;
+    constexpr int kLength = kOversampling * ChannelMeter::kTruePeakTaps;
+    constexpr double kCenter = kLength / 2;
+
+    for (int phase = 0; phase < kPhases; ++phase) {
+      double sum = 0.0;
+      double taps[ChannelMeter::kTruePeakTaps];
+      for (int k = 0; k < ChannelMeter::kTruePeakTaps; ++k) {
+        const double m = kOversampling * k + phase + 1;
+        const double x = (m - kCenter) / kOversampling;
+        const double sinc =
+            x == 0.0 ? 1.0
+                     : std::sin(juce::MathConstants<double>::pi * x) /
+                           (juce::MathConstants<double>::pi * x);
+        const double w = 2.0 * juce::MathConstants<double>::pi * m / kLength;
+        const double window = 0.42 - 0.5 * std::cos(w) + 0.08 * std::cos(2.0 * w);
+        taps[k] = sinc * window;
+        sum += taps[k];
+      }
+
+      // Unity gain at DC for every phase
+      double absSum = 0.0;
+      for (int k = 0; k < ChannelMeter::kTruePeakTaps; ++k) {
+        phases[phase][k] = (float)(taps[k] / sum);
+        reversed[phase][ChannelMeter::kTruePeakTaps - 1 - k] = phases[phase][k];
+        absSum += std::abs(taps[k] / sum);
+      }
+      gain = juce::jmax(gain, (float)absSum);
+    }
+  }
+};
+
+const TruePeakFilter truePeakFilter;
+
+float getLaneMax(const float (&lanes)[kLanes]) noexcept {
+  float result = lanes[0];
+  for (int lane = 1; lane < kLanes; ++lane) {
+    result = std::max(result, lanes[lane]);
+  }
+  return result;
+}
+
+// Largest absolute value of a span; adds its squares to sumLanes
+float reduce(const float* samples, int numSamples,
+             float (&sumLanes)[kLanes]) noexcept {
+  // Local accumulators: they cannot alias the samples, so they stay in
+  // registers
+  float maxLanes[kLanes] = {};
+  float sums[kLanes] = {};
+  int i = 0;
+  for (; i + kLanes <= numSamples; i += kLanes) {
+    for (int lane = 0; lane < kLanes; ++lane) {
+      const float value = samples[i + lane];
+      maxLanes[lane] = std::max(maxLanes[lane], std::abs(value));
+      sums[lane] += value * value;
+    }
+  }
+  for (; i < numSamples; ++i) {
+    maxLanes[0] = std::max(maxLanes[0], std::abs(samples[i]));
+    sums[0] += samples[i] * samples[i];
+  }
+
+  for (int lane = 0; lane < kLanes; ++lane) {
+    sumLanes[lane] += sums[lane];
+  }
+  return getLaneMax(maxLanes);
+}
+
+// Highest interpolated value between the samples of a chunk. samples[-kHistory]
+// to samples[kChunkSize - 1] must be readable; only the first numSamples
+// outputs count. Full-length loops, so they vectorize at any optimization level.
+float getInterpolatedPeak(const float* samples, int numSamples) noexcept {
+  float maxLanes[kLanes] = {};
+
+  for (const auto& taps : truePeakFilter.phases) {
+    float output[kChunkSize] = {};
+    for (int k = 0; k < ChannelMeter::kTruePeakTaps; ++k) {
+      const float tap = taps[k];
+      const float* input = samples - k;
+      for (int i = 0; i < kChunkSize; ++i) {
+        output[i] += tap * input[i];
+      }
+    }
+    std::fill(output + numSamples, output + kChunkSize, 0.0f);
+
+    for (int i = 0; i < kChunkSize; i += kLanes) {
+      for (int lane = 0; lane < kLanes; ++lane) {
+        maxLanes[lane] = std::max(maxLanes[lane], std::abs(output[i + lane]));
+      }
+    }
+  }
+
+  return getLaneMax(maxLanes);
+}
+
+// Highest interpolated value in the two gaps next to the middle sample of a
+// window of kTruePeakTaps + 1 samples (the outputs reading window[0..11] and
+// window[1..12]). Accumulated over independent lanes like reduce(), so each
+// phase vectorizes.
+float getWindowPeak(const float* window) noexcept {
+  constexpr int kTaps = ChannelMeter::kTruePeakTaps;
+  float result = 0.0f;
+  for (const auto& taps : truePeakFilter.reversed) {
+    for (const float* inputs : {window, window + 1}) {
+      float sums[4] = {};
+      for (int k = 0; k < kTaps; k += 4) {
+        for (int lane = 0; lane < 4; ++lane) {
+          sums[lane] += taps[k + lane] * inputs[k + lane];
+        }
+      }
+      result = std::max(result, std::abs((sums[0] + sums[1]) + (sums[2] + sums[3])));
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+//==============================================================================
+float ChannelMeter::getRmsCoefficient(int numSamples, double sampleRate) noexcept {
+  return (float)std::exp(-(double)numSamples / (kRmsWindowSeconds * sampleRate));
+}
+
+void ChannelMeter::process(const float* samples, int numSamples,
+                           float rmsCoefficient) noexcept {
+  if (numSamples <= 0) {
+    return;
+  }
+
+  float sumLanes[kLanes] = {};
+  if (truePeakMode == TruePeakMode::AroundPeak) {
+    SpanLevels levels;
+    levels.peak = reduce(samples, numSamples, sumLanes);
+    levels.peakIndex = (int)(std::find_if(samples, samples + numSamples,
+                                          [&levels](float value) {
+                                            return std::abs(value) == levels.peak;
+                                          }) -
+                             samples);
+    for (const float sum : sumLanes) {
+      levels.sumSquares += sum;
+    }
+    process(numSamples, levels, rmsCoefficient, [samples](int i) { return samples[i]; });
+    return;
+  }
+
+  processExact(samples, numSamples, sumLanes);
+  keepHistory(samples, numSamples);
+
+  float sumSquares = 0.0f;
+  for (const float sum : sumLanes) {
+    sumSquares += sum;
+  }
+  meanSquare = rmsCoefficient * meanSquare +
+               (1.0f - rmsCoefficient) * (sumSquares / (float)numSamples);
+}
+
+bool ChannelMeter::raisesPeak(const SpanLevels& levels) const noexcept {
+  // Ties count (the crest of a steady tone may be next to any), unless the
+  // window still waits for samples: it would never be complete
+  const bool raises = windowMissing > 0 ? levels.peak > peak : levels.peak >= peak;
+  return raises && levels.peak * truePeakFilter.gain > kTruePeakFloor;
+}
+
+void ChannelMeter::processAroundPeak(int numSamples, const SpanLevels& levels,
+                                     const SpanEdges& edges,
+                                     float rmsCoefficient) noexcept {
+  // Complete the window of a peak found at the end of an earlier span,
+  // before a new peak replaces it
+  if (edges.numHead > 0) {
+    std::copy(edges.head, edges.head + edges.numHead, window + kPeakWindow - windowMissing);
+    windowMissing -= edges.numHead;
+    interpolateWindow();
+  }
+
+  if (edges.newPeak) {
+    // Samples before the span come from the history, those after it from
+    // the next spans
+    constexpr int kHalf = kPeakWindow / 2;
+    for (int i = 0; i < kPeakWindow; ++i) {
+      const int index = levels.peakIndex - kHalf + i;
+      window[i] = index < 0 ? history[kHistory + index] : edges.aroundPeak[i];
+    }
+    windowMissing = std::max(0, levels.peakIndex + kHalf + 1 - numSamples);
+    windowPending = true;
+  }
+  peak = std::max(peak, levels.peak);
+
+  // The history only needs the samples the next window may reach back to
+  const int numKept = std::min(edges.numTail, kHistory);
+  std::copy(history + numKept, history + kHistory, history);
+  std::copy(edges.tail + edges.numTail - numKept, edges.tail + edges.numTail,
+            history + kHistory - numKept);
+
+  meanSquare = rmsCoefficient * meanSquare +
+               (1.0f - rmsCoefficient) * (levels.sumSquares / (float)numSamples);
+}
+
+void ChannelMeter::interpolateWindow() noexcept {
+  if (windowPending && windowMissing == 0) {
+    truePeak = std::max(truePeak, getWindowPeak(window));
+    windowPending = false;
+  }
+}
+
+void ChannelMeter::keepHistory(const float* samples, int numSamples) noexcept {
+  if (numSamples >= kHistory) {
+    std::copy(samples + numSamples - kHistory, samples + numSamples, history);
+  } else {
+    std::copy(history + numSamples, history + kHistory, history);
+    std::copy(samples, samples + numSamples, history + kHistory - numSamples);
+  }
+}
+
+void ChannelMeter::processExact(const float* samples, int numSamples,
+                                float (&sumLanes)[kReductionLanes]) noexcept {
+  float previousChunkMax = 0.0f;
+  for (const float value : history) {
+    previousChunkMax = std::max(previousChunkMax, std::abs(value));
+  }
+
+  for (int start = 0; start < numSamples; start += kChunkSize) {
+    const float* chunk = samples + start;
+    const int count = std::min(kChunkSize, numSamples - start);
+
+    const float chunkMax = reduce(chunk, count, sumLanes);
+    peak = std::max(peak, chunkMax);
+
+    // Interpolated values are bounded by the filter gain times the largest
+    // input they depend on: skip chunks which cannot raise the true peak
+    const float bound =
+        std::max(chunkMax, previousChunkMax) * truePeakFilter.gain;
+    if (bound > std::max({truePeak, peak, kTruePeakFloor})) {
+      float interpolated;
+      if (start == 0 || count < kChunkSize) {
+        // Previous samples from the history, zeros after a short last chunk
+        float extended[kHistory + kChunkSize] = {};
+        const float* previous = start == 0 ? history : chunk - kHistory;
+        std::copy(previous, previous + kHistory, extended);
+        std::copy(chunk, chunk + count, extended + kHistory);
+        interpolated = getInterpolatedPeak(extended + kHistory, count);
+      } else {
+        interpolated = getInterpolatedPeak(chunk, count);
+      }
+      truePeak = std::max(truePeak, interpolated);
+    }
+
+    previousChunkMax = chunkMax;
+  }
+}
+
+void ChannelMeter::processSilence(int numSamples, float rmsCoefficient) noexcept {
+  if (numSamples <= 0) {
+    return;
+  }
+
+  meanSquare *= rmsCoefficient;
+
+  // Zeros complete a pending window
+  const int numZeros = std::min(windowMissing, numSamples);
+  std::fill(window + kPeakWindow - windowMissing,
+            window + kPeakWindow - windowMissing + numZeros, 0.0f);
+  windowMissing -= numZeros;
+
+  if (numSamples >= kHistory) {
+    std::fill(history, history + kHistory, 0.0f);
+  } else {
+    std::copy(history + numSamples, history + kHistory, history);
+    std::fill(history + kHistory - numSamples, history + kHistory, 0.0f);
+  }
+}
+
+MeterReading ChannelMeter::takeReading(bool previousUnread) noexcept {
+  // A window still missing samples counts towards the next reading
+  interpolateWindow();
+
+  MeterReading reading;
+  reading.peak = peak;
+  reading.truePeak = std::max(truePeak, peak);
+  reading.rms = std::sqrt(meanSquare);
+
+  if (previousUnread) {
+    reading.peak = std::max(reading.peak, heldPeak);
+    reading.truePeak = std::max(reading.truePeak, heldTruePeak);
+  }
+
+  heldPeak = reading.peak;
+  heldTruePeak = reading.truePeak;
+  peak = 0.0f;
+  truePeak = 0.0f;
+  return reading;
+}
+
+void ChannelMeter::reset() noexcept {
+  *this = ChannelMeter(truePeakMode);
+}
@@ -1,4 +1,6 @@
+#include "audio-context.hpp"
 #include "audio-engine-core.hpp"
+#include "sample-cache.hpp"
 #include "websocket-server.hpp"
 
 class AudioEngineApplication : public juce::JUCEApplication,
@@ -13,13 +15,52 @@ class AudioEngineApplication : public juce::JUCEApplication,
   void initialise(const juce::String& commandLine) override {
     juce::Logger::writeToLog("=== DAW Audio Engine - Starting ===");
 
+    const auto args = juce::StringArray::fromTokens(commandLine, true);
+
+    // "--render-threads N" overrides the worker count
+    const int renderThreads = juce::jmax(
+        0, getOption(args, "--render-threads",
+                     juce::String(RenderWorkerPool::getDefaultThreadCount()))
+               .getIntValue());
+
+    // Offline mode: bounce the session to a file and exit, no audio device
+    if (args.contains("--render")) {
+      setApplicationReturnValue(renderOffline(args, renderThreads) ? 0 : 1);
+      quit();
+      return;
+    }
+
+    // "--sample-cache-mb N" sets the memory budget of decoded samples
+    if (args.contains("--sample-cache-mb")) {
+      SampleCache::getInstance().setBudget(
+          (size_t)juce::jmax(0, getOption(args, "--sample-cache-mb").getIntValue())
+          << 20);
+    }
+
+    // "--sidecar-dir PATH" keeps decoded samples as raw float files there, so
+    // that the next start maps them instead of decoding them
+    if (args.contains("--sidecar-dir")) {
+      SampleCache::getInstance().setSidecarDirectory(
+          juce::File::getCurrentWorkingDirectory().getChildFile(
+              getOption(args, "--sidecar-dir")));
+    }
+
     // Create audio engine
-    audioEngine = std::make_unique<AudioEngineCore>();
+    audioEngine = std::make_unique<AudioEngineCore>(renderThreads);
 
     juce::Logger::writeToLog("Audio engine created. You should hear a beat.");
 
     // Start WebSocket server
-    wsServer = std::make_unique<WebSocketServer>();
+    wsServer = std::make_unique<WebSocketServer>(*audioEngine);
+    // "--meter-rate HZ" sets how often meters can be pushed to clients
+    wsServer->setMeterRate(
+        getOption(args, "--meter-rate", juce::String(wsServer->getMeterRate()))
+            .getDoubleValue());
+    // "--log-messages" prints every JSON command received
+    wsServer->setLogMessages(args.contains("--log-messages"));
+    // "--profile-tracks" times every track's renderBlock() from the start
+    // (also switchable at runtime with {"type": "setProfiling"})
+    audioEngine->getProfiler().setDetailed(args.contains("--profile-tracks"));
     wsServer->start(8080);
 
     juce::Logger::writeToLog("Press Ctrl+C to quit.");
@@ -37,6 +78,11 @@ class AudioEngineApplication : public juce::JUCEApplication,
   }
 
   void timerCallback() override {
+    // Release track lists retired by the WebSocket thread
+    if (audioEngine) {
+      audioEngine->collectGarbage();
+    }
+
     // Check if WebSocket server thread has exited (e.g., due to Ctrl+C)
     if (wsServer && wsServer->hasExited()) {
       juce::Logger::writeToLog("=== Server thread exited, quitting application ===");
@@ -45,6 +91,51 @@ class AudioEngineApplication : public juce::JUCEApplication,
   }
 
  private:
+  // Value following an option on the command line, or defaultValue
+  static juce::String getOption(const juce::StringArray& args,
+                                const juce::String& name,
+                                const juce::String& defaultValue = {}) {
+    const int index = args.indexOf(name);
+    return index >= 0 && index + 1 < args.size() ? args[index + 1].unquoted()
+                                                 : defaultValue;
+  }
+
+  // Usage: --render out.wav|out.flac [--duration s] [--sample-rate hz]
+  //        [--block-size n] [--bit-depth 16|24|32] [--tracks f1,f2,...]
+  static bool renderOffline(const juce::StringArray& args, int renderThreads) {
+    OfflineRenderer::Settings settings;
+    settings.sampleRate = getOption(args, "--sample-rate", "44100").getDoubleValue();
+    settings.outputFile = juce::File::getCurrentWorkingDirectory().getChildFile(
+        getOption(args, "--render"));
+    settings.durationSeconds =
+        getOption(args, "--duration", "10").getDoubleValue();
+    settings.blockSize = getOption(args, "--block-size", "4096").getIntValue();
+    settings.bitDepth = getOption(args, "--bit-depth", "24").getIntValue();
+    settings.numRenderThreads = renderThreads;
+
+    // Same default session as live playback unless frequencies are given
+    std::vector<std::shared_ptr<AudioTrack>> tracks;
+    for (const auto& frequency : juce::StringArray::fromTokens(
+             getOption(args, "--tracks", "1000"), ",", "")) {
+      tracks.push_back(std::make_shared<BeatTrack>(frequency.getFloatValue()));
+    }
+
+    juce::Logger::writeToLog("Rendering " + juce::String(settings.durationSeconds) +
+                             " s to " + settings.outputFile.getFullPathName());
+
+    const auto result = OfflineRenderer::render(tracks, settings);
+    if (!result.success) {
+      juce::Logger::writeToLog("Render failed: " + result.errorMessage);
+      return false;
+    }
+
+    juce::Logger::writeToLog(
+        "Rendered " + juce::String(result.numSamples) + " samples in " +
+        juce::String(result.renderSeconds, 3) + " s (" +
+        juce::String(result.realtimeFactor, 1) + "x realtime)");
+    return true;
+  }
+
   std::unique_ptr<AudioEngineCore> audioEngine;
   std::unique_ptr<WebSocketServer> wsServer;
 };
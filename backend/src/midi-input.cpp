@@ -0,0 +1,108 @@
+#include "midi-input.hpp"
+#include <algorithm>
+#include <cmath>
+
+bool MidiEventList::add(const MidiEvent& event) noexcept {
+  if (isFull()) {
+    return false;
+  }
+
+  // Events mostly arrive in order: shift from the back
+  int index = numEvents;
+  while (index > 0 && events[(size_t)(index - 1)].offset > event.offset) {
+    events[(size_t)index] = events[(size_t)(index - 1)];
+    --index;
+  }
+  events[(size_t)index] = event;
+  ++numEvents;
+  return true;
+}
+
+const MidiEvent* MidiEventList::lowerBound(int offset) const noexcept {
+  return std::lower_bound(begin(), end(), offset,
+                          [](const MidiEvent& event, int value) {
+                            return event.offset < value;
+                          });
+}
+
+MidiInputQueue::MidiInputQueue(int capacity)
+    : queue((size_t)juce::jmax(1, capacity)) {}
+
+bool MidiInputQueue::push(const juce::MidiMessage& message,
+                          juce::int64 arrivalTicks) {
+  MidiEvent event;
+  if (message.isNoteOn()) {
+    event.type = MidiEvent::Type::NoteOn;
+    event.velocity = message.getFloatVelocity();
+  } else if (message.isNoteOff()) {
+    // Includes note-ons with velocity 0
+    event.type = MidiEvent::Type::NoteOff;
+  } else {
+    return false;
+  }
+
+  event.channel = (juce::uint8)juce::jlimit(1, 16, message.getChannel());
+  event.note = (juce::uint8)juce::jlimit(0, 127, message.getNoteNumber());
+  event.arrivalTicks = arrivalTicks;
+  return push(event);
+}
+
+bool MidiInputQueue::push(const MidiEvent& event) {
+  const std::lock_guard<std::mutex> lock(producerMutex);
+  MidiEvent copy = event;
+  if (!queue.tryPush(std::move(copy))) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void MidiInputQueue::prepare(double newSampleRate) noexcept {
+  sampleRate = newSampleRate;
+  previousCallbackTicks = 0;
+}
+
+void MidiInputQueue::collectBlock(juce::int64 callbackTicks, int numSamples,
+                                  MidiEventList& events) noexcept {
+  events.clear();
+  if (numSamples <= 0) {
+    return;
+  }
+
+  const double blockSeconds = (double)numSamples / sampleRate;
+  if (previousCallbackTicks == 0) {
+    // First block: assume the previous callback came one block earlier
+    previousCallbackTicks =
+        callbackTicks -
+        (juce::int64)(blockSeconds *
+                      (double)juce::Time::getHighResolutionTicksPerSecond());
+  }
+
+  while (!events.isFull()) {
+    if (!hasHeld && !queue.tryPop(held)) {
+      break;
+    }
+    hasHeld = true;
+    if (held.arrivalTicks > callbackTicks) {
+      // Arrived while this block was being prepared: next block
+      break;
+    }
+
+    // Spacing since the previous callback is kept. Events which arrived
+    // earlier (a late callback, the first block) play on the first sample.
+    const double sinceCallback =
+        EngineProfiler::toSeconds(held.arrivalTicks - previousCallbackTicks);
+    held.offset =
+        juce::jlimit(0, numSamples - 1, (int)std::floor(sinceCallback * sampleRate));
+    events.add(held);
+    hasHeld = false;
+
+    const double delay =
+        EngineProfiler::toSeconds(callbackTicks - held.arrivalTicks) +
+        (double)held.offset / sampleRate;
+    latency.record(delay);
+    jitter.record(std::abs(delay - blockSeconds));
+  }
+
+  previousCallbackTicks = callbackTicks;
+}
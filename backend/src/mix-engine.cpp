@@ -0,0 +1,835 @@
+#include "mix-engine.hpp"
+#include <algorithm>
+
+MixEngine::MixEngine(int numRenderThreads)
+    : sampleRate(44100.0), masterVolume(0.5f) {
+  pendingCommands.resize((size_t)commands.getCapacity());
+  meterFrames.forEachBuffer([](MeterFrame& frame) {
+    frame.tracks.resize((size_t)MeterFrame::kMaxTracks);
+  });
+
+  if (numRenderThreads > 0) {
+    renderPool = std::make_unique<RenderWorkerPool>(numRenderThreads);
+  }
+}
+
+MixEngine::~MixEngine() = default;
+
+void MixEngine::prepare(int maxBlockSize, double newSampleRate) {
+  sampleRate = newSampleRate;
+
+  // Pre-allocate buffers to avoid allocations in audio thread
+  // Allocate for 2 channels (stereo output)
+  mixBuffer.setSize(2, maxBlockSize, false, true, false);
+
+  // Allocate track buffer for individual track rendering (mono tracks only
+  // use the first channel)
+  trackBuffer.setSize(2, maxBlockSize, false, true, false);
+
+  meterIntervalSamples =
+      juce::jmax(1, juce::roundToInt(kMeterIntervalSeconds * sampleRate));
+  // The first block publishes, so a reader never starts empty-handed
+  samplesSinceMeterFrame = meterIntervalSamples;
+  smoothingSamples = juce::roundToInt(ChannelStrip::kSmoothingSeconds * sampleRate);
+
+  // Insert effects, before the plan is recompiled with their new tails
+  tracks.getGraph().forEachEffect(
+      [this, maxBlockSize](AudioEffect& effect) { effect.prepare(sampleRate, maxBlockSize); });
+
+  // Allocate per-track buffers used by parallel rendering, and bus buffers
+  tracks.setRenderBlockSize(maxBlockSize);
+
+  // Tempo map segments are positioned in samples
+  const auto tempoMap = tracks.getTempoMap();
+  if (tempoMap->getSampleRate() != sampleRate) {
+    setTempoMap(*tempoMap);
+  }
+}
+
+void MixEngine::process(juce::AudioBuffer<float>& output,
+                        int startSample,
+                        int numSamples) {
+  // Clear the pre-allocated mix buffer
+  mixBuffer.clear();
+
+  // Pin the current track list for the duration of the block (lock-free)
+  const TrackListPublisher::ReadScope trackList(tracks);
+  metering = meteringEnabled.load(std::memory_order_relaxed);
+  tappingTracks = analysisTap != nullptr && analysisTap->hasTrackTaps();
+  timing = profiler != nullptr && profiler->isDetailed();
+  const juce::int64 blockStart = timing ? EngineProfiler::now() : 0;
+  renderTicks = 0;
+
+  // MIDI which arrived since the previous block, on its sample in this one
+  if (midiInput != nullptr) {
+    midiInput->collectBlock(EngineProfiler::now(), numSamples, blockEvents);
+  } else {
+    blockEvents.clear();
+  }
+
+  // Usually a single span: blocks are only split at commands and tempo map
+  // changes
+  for (int done = 0; done < numSamples;) {
+    applyCommands();
+
+    int count = numSamples - done;
+    if (!playing) {
+      // Stopped: silence, the position does not move. Notes still reach the
+      // tracks, so none is left hanging.
+      for (const auto* event = blockEvents.lowerBound(done);
+           event != blockEvents.end() && event->offset < done + count; ++event) {
+        for (const auto& track : trackList->tracks) {
+          if (track->receivesMidi) {
+            track->playEvent(*event);
+          }
+        }
+      }
+      if (metering) {
+        const float coefficient = ChannelMeter::getRmsCoefficient(count, sampleRate);
+        for (const auto& track : trackList->tracks) {
+          track->meter.processSilence(count, coefficient);
+          if (track->getNumOutputChannels() > 1) {
+            track->rightMeter.processSilence(count, coefficient);
+          }
+        }
+      }
+      done += count;
+      continue;
+    }
+
+    // Stop at the next command due inside the block. Pending commands are
+    // all after the position, so the span is never empty.
+    const juce::int64 position = transport.getPosition();
+    for (size_t i = 0; i < numPendingCommands; ++i) {
+      count = (int)juce::jlimit<juce::int64>(
+          1, count, pendingCommands[i].sample - position);
+    }
+
+    const BeatContext context =
+        transport.getContext(*trackList->tempoMap, count);
+    if (metering) {
+      meterCoefficient = ChannelMeter::getRmsCoefficient(count, sampleRate);
+    }
+
+    renderSpan(*trackList, done, count, context);
+
+    transport.advance(count);
+    done += count;
+  }
+
+  if (metering) {
+    const float coefficient =
+        ChannelMeter::getRmsCoefficient(numSamples, sampleRate);
+    for (int channel = 0; channel < 2; ++channel) {
+      masterMeters[channel].process(mixBuffer.getReadPointer(channel),
+                                    numSamples, coefficient);
+    }
+
+    if (samplesSinceMeterFrame >= meterIntervalSamples) {
+      publishMeters(*trackList);
+      samplesSinceMeterFrame = 0;
+    }
+    samplesSinceMeterFrame += numSamples;
+  }
+
+  // Copy from mix buffer to output buffer
+  for (int channel = 0; channel < output.getNumChannels(); ++channel) {
+    output.copyFrom(channel, startSample, mixBuffer, channel, 0, numSamples);
+  }
+
+  if (timing) {
+    const juce::int64 blockTicks = EngineProfiler::now() - blockStart;
+    profiler->recordPhases(renderTicks, blockTicks - renderTicks);
+  }
+}
+
+void MixEngine::renderSpan(const TrackList& trackList, int offset,
+                           int numSamples, const BeatContext& context) {
+  const auto numTracks = (int)trackList.tracks.size();
+  const MidiEventList* events = blockEvents.isEmpty() ? nullptr : &blockEvents;
+
+  // Buses are cleared by their first input of the span
+  for (const auto& step : trackList.plan->steps) {
+    step.bus->activity = RenderActivity::silent();
+  }
+
+  const bool renderInParallel =
+      renderPool != nullptr && trackList.renderBuffers != nullptr &&
+      numTracks >= parallelTrackThreshold.load(std::memory_order_relaxed) &&
+      offset + numSamples <= trackList.renderBuffers->front().getNumSamples();
+
+  if (renderInParallel) {
+    // Render every track into its own buffer on the worker pool
+    renderingList = &trackList;
+    renderingOffset = offset;
+    renderingNumSamples = numSamples;
+    renderingContext = &context;
+    renderingEvents = events;
+    const juce::int64 renderStart = timing ? EngineProfiler::now() : 0;
+    renderPool->run(numTracks, &MixEngine::renderTrackTask, this);
+    if (timing) {
+      renderTicks += EngineProfiler::now() - renderStart;
+    }
+    renderingList = nullptr;
+    renderingContext = nullptr;
+    renderingEvents = nullptr;
+
+    // Deterministic mix: always summed in track order on this thread. The
+    // workers applied the faders, so the same sums as the serial path.
+    auto& renderBuffers = *trackList.renderBuffers;
+    for (int trackIdx = 0; trackIdx < numTracks; ++trackIdx) {
+      StripGains gains = trackList.tracks[(size_t)trackIdx]->strip.getGains();
+      gains.fader = GainRamp::constant(1.0f);
+      routeTrack(trackList, trackIdx, renderBuffers[(size_t)trackIdx], offset, numSamples,
+                 gains, false, nullptr);
+    }
+  } else {
+    // Render each track into trackBuffer (single virtual call per span), then
+    // apply its fader and pan while accumulating its active range into its
+    // bus. The meters get their levels from the same pass, and read the few
+    // other samples they need from the pre-fader buffer.
+    SpanLevels levels[2];
+    for (int trackIdx = 0; trackIdx < numTracks; ++trackIdx) {
+      auto& track = *trackList.tracks[(size_t)trackIdx];
+      renderTicks += renderTrack(track, trackBuffer, offset, numSamples,
+                                 context, events, timing);
+      const auto& gains = track.strip.advance(track.volume, track.pan, track.mute,
+                                              numSamples, smoothingSamples);
+      const bool hasSends = trackList.plan->tracks[(size_t)trackIdx].numSends > 0;
+      const bool keepPostFader = tappingTracks || hasSends;
+      routeTrack(trackList, trackIdx, trackBuffer, offset, numSamples, gains,
+                 keepPostFader, metering ? levels : nullptr);
+      measureTrack(track, trackBuffer, offset, numSamples, levels,
+                   keepPostFader ? nullptr : &gains.fader);
+    }
+  }
+
+  mixBuses(trackList, offset, numSamples);
+
+  // Apply master volume to mixed buffer using SIMD-optimized operation
+  for (int channel = 0; channel < mixBuffer.getNumChannels(); ++channel) {
+    mixBuffer.applyGain(channel, offset, numSamples, masterVolume);
+  }
+}
+
+void MixEngine::mixBuses(const TrackList& trackList, int offset, int numSamples) {
+  const auto& plan = *trackList.plan;
+
+  for (const auto& level : plan.levels) {
+    if (renderPool != nullptr && level.parallel) {
+      renderingList = &trackList;
+      renderingOffset = offset;
+      renderingNumSamples = numSamples;
+      renderingLevelBegin = level.begin;
+      renderPool->run(level.end - level.begin, &MixEngine::busTask, this);
+      renderingList = nullptr;
+    } else {
+      for (int step = level.begin; step < level.end; ++step) {
+        processBus(trackList, step, offset, numSamples);
+      }
+    }
+  }
+
+  if (plan.masterTrackDelay >= 0) {
+    delayTracks(trackList, MixPlan::kMaster, offset, numSamples);
+  }
+  for (int i = 0; i < plan.numMasterInputs; ++i) {
+    pullInput(trackList, plan.inputs[(size_t)(plan.firstMasterInput + i)], MixPlan::kMaster,
+              offset, numSamples);
+  }
+
+  if (plan.numMasterEffects > 0) {
+    float* const channels[2] = {mixBuffer.getWritePointer(0, offset),
+                                mixBuffer.getWritePointer(1, offset)};
+    for (int i = 0; i < plan.numMasterEffects; ++i) {
+      plan.effects[(size_t)(plan.firstMasterEffect + i)]->process(channels, numSamples);
+    }
+  }
+}
+
+void MixEngine::processBus(const TrackList& trackList, int step, int offset,
+                           int numSamples) noexcept {
+  const auto& plan = *trackList.plan;
+  const auto& entry = plan.steps[(size_t)step];
+  MixBus& bus = *entry.bus;
+
+  if (entry.trackDelay >= 0) {
+    delayTracks(trackList, step, offset, numSamples);
+  }
+  for (int i = 0; i < entry.numInputs; ++i) {
+    pullInput(trackList, plan.inputs[(size_t)(entry.firstInput + i)], step, offset,
+              numSamples);
+  }
+
+  if (entry.numEffects > 0) {
+    // The chain keeps running over silence until its tail has been played
+    const bool hasInput = !bus.activity.isSilent();
+    if (hasInput) {
+      bus.tailRemaining = entry.tailSamples;
+    }
+    if (hasInput || bus.tailRemaining > 0) {
+      const MixTarget target = getTarget(trackList, step, offset, numSamples,
+                                         RenderActivity::whole(numSamples));
+      float* const channels[2] = {target.left, target.right};
+      for (int i = 0; i < entry.numEffects; ++i) {
+        plan.effects[(size_t)(entry.firstEffect + i)]->process(channels, numSamples);
+      }
+      if (!hasInput) {
+        bus.tailRemaining = juce::jmax(0, bus.tailRemaining - numSamples);
+      }
+    }
+  }
+
+  // Gains read by the buses pulling this one, at later levels
+  bus.strip.advance(bus.volume, bus.pan, bus.mute, numSamples, smoothingSamples);
+  for (int i = 0; i < entry.numSends; ++i) {
+    auto& send = *plan.busSends[(size_t)(entry.firstSend + i)];
+    send.strip.advance(send.level, 0.0f, false, numSamples, smoothingSamples);
+  }
+}
+
+void MixEngine::delayTracks(const TrackList& trackList, int step, int offset,
+                            int numSamples) noexcept {
+  const auto& plan = *trackList.plan;
+  const bool master = step == MixPlan::kMaster;
+  const int delay = master ? plan.masterTrackDelay : plan.steps[(size_t)step].trackDelay;
+  jassert((size_t)delay < trackList.delays.size());  // prepare() was not called
+  auto& line = *trackList.delays[(size_t)delay];
+
+  // The track phase writes the whole span of the master
+  MixBus* bus = master ? nullptr : plan.steps[(size_t)step].bus;
+  const RenderActivity input = master ? RenderActivity::whole(numSamples) : bus->activity;
+  if (input.isSilent() && line.isSilent()) {
+    return;
+  }
+
+  auto& buffer = master ? mixBuffer
+                        : (*trackList.busBuffers)[(size_t)plan.steps[(size_t)step].buffer];
+  float* const* delayed = line.beginSpan(numSamples);
+  for (int channel = 0; channel < 2; ++channel) {
+    if (!input.isSilent()) {
+      juce::FloatVectorOperations::copy(delayed[channel] + input.start,
+                                        buffer.getReadPointer(channel, offset + input.start),
+                                        input.getLength());
+    }
+  }
+
+  const RenderActivity output = line.endSpan(input, numSamples);
+  if (!master) {
+    bus->activity = output;
+  }
+  if (master || !output.isSilent()) {
+    for (int channel = 0; channel < 2; ++channel) {
+      juce::FloatVectorOperations::copy(buffer.getWritePointer(channel, offset),
+                                        line.getOutput()[channel], numSamples);
+    }
+  }
+}
+
+void MixEngine::pullInput(const TrackList& trackList, const MixPlan::Input& input,
+                          int destination, int offset, int numSamples) noexcept {
+  const auto& source = trackList.plan->steps[(size_t)input.source];
+  const MixBus& bus = *source.bus;
+  bool audible = !bus.activity.isSilent() && !bus.strip.isSilent();
+
+  StripGains gains = bus.strip.getGains();
+  if (input.send != nullptr) {
+    // Post-fader, before pan: the send level takes the place of the pan
+    audible = audible && !input.send->strip.isSilent();
+    gains.left = gains.right = input.send->strip.getGains().fader;
+  }
+
+  const auto& buffer = (*trackList.busBuffers)[(size_t)source.buffer];
+  const float* const channels[2] = {buffer.getReadPointer(0, offset),
+                                    buffer.getReadPointer(1, offset)};
+  if (input.delay < 0) {
+    if (audible) {
+      mixRange(channels, bus.activity, gains,
+               getTarget(trackList, destination, offset, numSamples, bus.activity));
+    }
+    return;
+  }
+
+  // Through the compensation line at the source's gains, then out of it
+  // at unity
+  jassert((size_t)input.delay < trackList.delays.size());  // prepare() was not called
+  auto& line = *trackList.delays[(size_t)input.delay];
+  if (!audible && line.isSilent()) {
+    return;
+  }
+
+  float* const* delayed = line.beginSpan(numSamples);
+  if (audible) {
+    mixRange(channels, bus.activity, gains, {delayed[0], delayed[1]});
+  }
+  const RenderActivity range =
+      line.endSpan(audible ? bus.activity : RenderActivity::silent(), numSamples);
+  if (!range.isSilent()) {
+    const StripGains unity{GainRamp::constant(1.0f), GainRamp::constant(1.0f),
+                           GainRamp::constant(1.0f)};
+    mixRange(line.getOutput(), range, unity,
+             getTarget(trackList, destination, offset, numSamples, range));
+  }
+}
+
+void MixEngine::busTask(void* context, int index) {
+  auto& engine = *static_cast<MixEngine*>(context);
+  engine.processBus(*engine.renderingList, engine.renderingLevelBegin + index,
+                    engine.renderingOffset, engine.renderingNumSamples);
+}
+
+MixEngine::MixTarget MixEngine::getTarget(const TrackList& trackList, int step, int offset,
+                                          int numSamples, RenderActivity range) noexcept {
+  if (step == MixPlan::kMaster) {
+    return {mixBuffer.getWritePointer(0, offset), mixBuffer.getWritePointer(1, offset)};
+  }
+
+  jassert(trackList.busBuffers != nullptr);  // prepare() was not called
+  const auto& entry = trackList.plan->steps[(size_t)step];
+  auto& buffer = (*trackList.busBuffers)[(size_t)entry.buffer];
+  MixBus& bus = *entry.bus;
+  if (bus.activity.isSilent()) {
+    // First input of the span: the buffer may hold another bus's samples
+    buffer.clear(offset, numSamples);
+    bus.activity = range;
+  } else {
+    bus.activity.include(range.start, range.end);
+  }
+  return {buffer.getWritePointer(0, offset), buffer.getWritePointer(1, offset)};
+}
+
+void MixEngine::routeTrack(const TrackList& trackList, int trackIndex,
+                           juce::AudioBuffer<float>& buffer, int offset, int numSamples,
+                           const StripGains& gains, bool keepPostFader,
+                           SpanLevels* levels) noexcept {
+  const auto& plan = *trackList.plan;
+  const auto& route = plan.tracks[(size_t)trackIndex];
+  const auto& track = *trackList.tracks[(size_t)trackIndex];
+  const bool audible = isAudible(track);
+
+  if (audible) {
+    mixTrack(track, buffer, offset, gains, keepPostFader, levels,
+             getTarget(trackList, route.output, offset, numSamples, track.activity));
+  }
+
+  // Sends are advanced even when silent, to stay in step with the track
+  for (int i = 0; i < route.numSends; ++i) {
+    const auto& send = plan.trackSends[(size_t)(route.firstSend + i)];
+    const auto& level =
+        send.send->strip.advance(send.send->level, 0.0f, false, numSamples, smoothingSamples);
+    if (audible && !send.send->strip.isSilent()) {
+      // From the post-fader signal, unpanned
+      const float* const channels[2] = {
+          buffer.getReadPointer(0, offset),
+          track.getNumOutputChannels() > 1 ? buffer.getReadPointer(1, offset) : nullptr};
+      const StripGains sendGains{level.fader, GainRamp::constant(1.0f),
+                                 GainRamp::constant(1.0f)};
+      mixRange(channels, track.activity, sendGains,
+               getTarget(trackList, send.destination, offset, numSamples, track.activity));
+    }
+  }
+}
+
+void MixEngine::publishMeters(const TrackList& trackList) {
+  // Peaks of a frame the reader missed are carried over to this one
+  const bool previousUnread = meterFrames.hasUnreadValue();
+  auto& frame = meterFrames.getWriteBuffer();
+
+  frame.position = transport.getPosition();
+  for (int channel = 0; channel < 2; ++channel) {
+    frame.master[channel] = masterMeters[channel].takeReading(previousUnread);
+  }
+
+  frame.numTracks = (int)std::min<size_t>(trackList.tracks.size(),
+                                          (size_t)MeterFrame::kMaxTracks);
+  for (int i = 0; i < frame.numTracks; ++i) {
+    auto& track = *trackList.tracks[(size_t)i];
+    frame.tracks[(size_t)i] = track.meter.takeReading(previousUnread);
+    if (track.getNumOutputChannels() > 1) {
+      frame.tracks[(size_t)i] = MeterReading::combine(
+          frame.tracks[(size_t)i], track.rightMeter.takeReading(previousUnread));
+    }
+  }
+
+  meterFrames.publish();
+}
+
+bool MixEngine::sendCommand(EngineCommand command) {
+  return commands.push(std::move(command));
+}
+
+void MixEngine::applyCommands() {
+  EngineCommand command;
+  while (numPendingCommands < pendingCommands.size() && commands.pop(command)) {
+    pendingCommands[numPendingCommands++] = std::move(command);
+  }
+
+  // Apply in queue order, keep the others (still in order) for later. The
+  // position stands still while stopped, so commands due later apply now;
+  // once a Play applied, the commands after it wait for their sample again.
+  // A Seek can jump past commands kept earlier in the pass: the pass runs
+  // again until none is left behind the position.
+  juce::int64 passStart;
+  do {
+    passStart = transport.getPosition();
+    size_t kept = 0;
+    for (size_t i = 0; i < numPendingCommands; ++i) {
+      auto& pending = pendingCommands[i];
+      const juce::int64 position = transport.getPosition();
+      if (!playing || pending.sample <= position) {
+        applyCommand(pending);
+        pending.appliedSample = position;
+        commands.sendReply(std::move(pending));
+      } else if (kept != i) {
+        pendingCommands[kept++] = std::move(pending);
+      } else {
+        ++kept;
+      }
+    }
+    numPendingCommands = kept;
+  } while (numPendingCommands > 0 && transport.getPosition() > passStart);
+}
+
+void MixEngine::applyCommand(const EngineCommand& command) {
+  switch (command.type) {
+    case EngineCommand::Type::SetTrackVolume:
+      if (command.track != nullptr) {
+        command.track->setVolume((float)command.value);
+      }
+      break;
+    case EngineCommand::Type::SetTrackMute:
+      if (command.track != nullptr) {
+        command.track->setMute(command.value != 0.0);
+      }
+      break;
+    case EngineCommand::Type::SetTrackPan:
+      if (command.track != nullptr) {
+        command.track->setPan((float)command.value);
+      }
+      break;
+    case EngineCommand::Type::SetMasterVolume:
+      masterVolume = juce::jlimit(0.0f, 1.0f, (float)command.value);
+      break;
+    case EngineCommand::Type::Play:
+      playing = true;
+      break;
+    case EngineCommand::Type::Stop:
+      playing = false;
+      break;
+    case EngineCommand::Type::Seek:
+      transport.setPosition((juce::int64)command.value);
+      break;
+    case EngineCommand::Type::SetBusVolume:
+      if (command.bus != nullptr) {
+        command.bus->setVolume((float)command.value);
+      }
+      break;
+    case EngineCommand::Type::SetBusMute:
+      if (command.bus != nullptr) {
+        command.bus->setMute(command.value != 0.0);
+      }
+      break;
+    case EngineCommand::Type::SetBusPan:
+      if (command.bus != nullptr) {
+        command.bus->setPan((float)command.value);
+      }
+      break;
+    case EngineCommand::Type::SetSendLevel:
+      if (command.send != nullptr) {
+        command.send->setLevel((float)command.value);
+      }
+      break;
+    case EngineCommand::Type::NoteOn:
+      if (command.track != nullptr) {
+        command.track->noteOn(command.note, (float)command.value);
+      }
+      break;
+    case EngineCommand::Type::NoteOff:
+      if (command.track != nullptr) {
+        command.track->noteOff(command.note);
+      }
+      break;
+    case EngineCommand::Type::SetTrackMidiInput:
+      if (command.track != nullptr) {
+        command.track->receivesMidi = command.value != 0.0;
+      }
+      break;
+  }
+}
+
+void MixEngine::setTempoMap(TempoMap map) {
+  map.setSampleRate(sampleRate);
+  auto published = std::make_shared<const TempoMap>(std::move(map));
+
+  // Positions precompiled by the tracks follow the new map
+  for (const auto& track : tracks.getTracks()) {
+    track->tempoMapChanged(*published);
+  }
+  tracks.setTempoMap(std::move(published));
+}
+
+std::shared_ptr<const TempoMap> MixEngine::getTempoMap() const {
+  return tracks.getTempoMap();
+}
+
+size_t MixEngine::addTrack(std::shared_ptr<AudioTrack> track) {
+  track->tempoMapChanged(*tracks.getTempoMap());
+  return tracks.addTrack(std::move(track));
+}
+
+bool MixEngine::removeTrack(size_t index) {
+  return tracks.removeTrack(index);
+}
+
+std::shared_ptr<AudioTrack> MixEngine::getTrack(size_t index) const {
+  return tracks.getTrack(index);
+}
+
+std::vector<std::shared_ptr<AudioTrack>> MixEngine::getTracks() const {
+  return tracks.getTracks();
+}
+
+size_t MixEngine::getTrackCount() const {
+  return tracks.getTrackCount();
+}
+
+int MixEngine::addBus(std::shared_ptr<MixBus> bus, int output) {
+  int index = -1;
+  tracks.editGraph([&](MixGraph& graph) {
+    index = graph.addBus(std::move(bus), output);
+    return index >= 0;
+  });
+  return index;
+}
+
+bool MixEngine::removeBus(int index) {
+  return tracks.editGraph([index](MixGraph& graph) { return graph.removeBus(index); });
+}
+
+std::shared_ptr<MixBus> MixEngine::getBus(int index) const {
+  const auto graph = tracks.getGraph();
+  return index >= 0 && index < graph.getNumBuses() ? graph.getBuses()[(size_t)index].bus
+                                                   : nullptr;
+}
+
+int MixEngine::getBusCount() const {
+  return tracks.getGraph().getNumBuses();
+}
+
+bool MixEngine::setTrackOutput(size_t track, int output) {
+  return tracks.editGraph(
+      [&](MixGraph& graph) { return graph.setTrackOutput((int)track, output); });
+}
+
+bool MixEngine::setBusOutput(int bus, int output) {
+  return tracks.editGraph([&](MixGraph& graph) { return graph.setBusOutput(bus, output); });
+}
+
+int MixEngine::addSend(MixGraph::Source source, int destination,
+                       std::shared_ptr<MixSend> send) {
+  int index = -1;
+  tracks.editGraph([&](MixGraph& graph) {
+    index = graph.addSend(source, destination, std::move(send));
+    return index >= 0;
+  });
+  return index;
+}
+
+bool MixEngine::removeSend(int index) {
+  return tracks.editGraph([index](MixGraph& graph) { return graph.removeSend(index); });
+}
+
+std::shared_ptr<MixSend> MixEngine::getSend(int index) const {
+  const auto graph = tracks.getGraph();
+  const auto& sends = graph.getSends();
+  return index >= 0 && index < (int)sends.size() ? sends[(size_t)index].send : nullptr;
+}
+
+bool MixEngine::setEffects(int bus, std::vector<std::shared_ptr<AudioEffect>> chain) {
+  MixGraph staged;
+  staged.setEffects(MixGraph::kMaster, chain);
+  prepareEffects(staged);
+
+  return tracks.editGraph(
+      [&](MixGraph& graph) { return graph.setEffects(bus, std::move(chain)); });
+}
+
+MixGraph MixEngine::getGraph() const {
+  return tracks.getGraph();
+}
+
+void MixEngine::setGraph(MixGraph graph) {
+  prepareEffects(graph);
+  tracks.editGraph([&](MixGraph& current) {
+    current = std::move(graph);
+    return true;
+  });
+}
+
+int MixEngine::getLatencySamples() const {
+  return tracks.getLatencySamples();
+}
+
+bool MixEngine::refreshLatency() {
+  return tracks.refreshLatency();
+}
+
+void MixEngine::prepareEffects(const MixGraph& graph) const {
+  // Until prepare(), which prepares every effect of the graph
+  const int maxBlockSize = getMaxBlockSize();
+  if (maxBlockSize == 0) {
+    return;
+  }
+
+  // Effects already published are in use on the audio thread
+  const MixGraph published = tracks.getGraph();
+  graph.forEachEffect([&](AudioEffect& effect) {
+    if (!published.containsEffect(&effect)) {
+      effect.prepare(sampleRate, maxBlockSize);
+    }
+  });
+}
+
+void MixEngine::collectGarbage() {
+  tracks.collectGarbage();
+}
+
+int MixEngine::getRenderThreadCount() const {
+  return renderPool != nullptr ? renderPool->getNumWorkers() : 0;
+}
+
+void MixEngine::setParallelTrackThreshold(int minTracks) {
+  parallelTrackThreshold.store(juce::jmax(2, minTracks));
+}
+
+void MixEngine::renderTrackTask(void* context, int trackIndex) {
+  auto& engine = *static_cast<MixEngine*>(context);
+  auto& buffer = (*engine.renderingList->renderBuffers)[(size_t)trackIndex];
+
+  auto& track = *engine.renderingList->tracks[(size_t)trackIndex];
+  const int offset = engine.renderingOffset;
+  const int numSamples = engine.renderingNumSamples;
+  renderTrack(track, buffer, offset, numSamples, *engine.renderingContext,
+              engine.renderingEvents, engine.timing);
+
+  // Fader applied and measured here, in parallel, while the block is still
+  // in this core's cache; pan is applied by the mix
+  const auto& gains = track.strip.advance(track.volume, track.pan, track.mute,
+                                          numSamples, engine.smoothingSamples);
+  SpanLevels levels[2];
+  if (isAudible(track)) {
+    const auto& activity = track.activity;
+    float* const channels[2] = {buffer.getWritePointer(0, offset + activity.start),
+                                buffer.getWritePointer(1, offset + activity.start)};
+    ChannelStrip::applyFader(channels, track.getNumOutputChannels(),
+                             activity.getLength(), gains.fader.from(activity.start),
+                             engine.metering ? levels : nullptr);
+    for (auto& channel : levels) {
+      channel.peakIndex += activity.start;
+    }
+  }
+  engine.measureTrack(track, buffer, offset, numSamples, levels, nullptr);
+}
+
+void MixEngine::mixTrack(const AudioTrack& track, juce::AudioBuffer<float>& buffer,
+                         int offset, const StripGains& gains, bool keepPostFader,
+                         SpanLevels* levels, MixTarget target) noexcept {
+  // Zeros around the active range add nothing, scaled or not
+  const auto& activity = track.activity;
+  const int first = offset + activity.start;
+
+  ChannelStrip::MixJob job;
+  const int numChannels = track.getNumOutputChannels() > 1 ? 2 : 1;
+  for (int channel = 0; channel < numChannels; ++channel) {
+    job.input[channel] = buffer.getReadPointer(channel, first);
+    if (keepPostFader) {
+      job.postFader[channel] = buffer.getWritePointer(channel, first);
+    }
+  }
+  job.left = target.left + activity.start;
+  job.right = target.right + activity.start;
+  job.numSamples = activity.getLength();
+  job.gains = gains.from(activity.start);
+  job.levels = levels;
+  ChannelStrip::mix(job);
+
+  // Levels of the active range, indexed from the start of the span
+  if (levels != nullptr) {
+    for (int channel = 0; channel < numChannels; ++channel) {
+      levels[channel].peakIndex += activity.start;
+    }
+  }
+}
+
+void MixEngine::mixRange(const float* const* input, RenderActivity range,
+                         const StripGains& gains, MixTarget target) noexcept {
+  ChannelStrip::MixJob job;
+  job.input[0] = input[0] + range.start;
+  job.input[1] = input[1] != nullptr ? input[1] + range.start : nullptr;
+  job.left = target.left + range.start;
+  job.right = target.right + range.start;
+  job.numSamples = range.getLength();
+  job.gains = gains.from(range.start);
+  ChannelStrip::mix(job);
+}
+
+void MixEngine::measureTrack(AudioTrack& track, juce::AudioBuffer<float>& buffer,
+                             int offset, int numSamples, const SpanLevels* levels,
+                             const GainRamp* fader) const noexcept {
+  // The whole span is metered, for an RMS over the same time as other
+  // tracks: the samples around the active range are zeros, so the levels of
+  // that range are those of the span
+  const bool silent = !isAudible(track);
+  const bool stereo = track.getNumOutputChannels() > 1;
+  if (metering) {
+    if (silent) {
+      track.meter.processSilence(numSamples, meterCoefficient);
+      if (stereo) {
+        track.rightMeter.processSilence(numSamples, meterCoefficient);
+      }
+    } else {
+      // Post-fader samples, with the ramp of the active range the mix used
+      const auto& activity = track.activity;
+      const GainRamp gain =
+          fader != nullptr ? fader->from(activity.start) : GainRamp::constant(1.0f);
+      for (int channel = 0; channel < (stereo ? 2 : 1); ++channel) {
+        const float* samples = buffer.getReadPointer(channel, offset);
+        auto& meter = channel == 0 ? track.meter : track.rightMeter;
+        meter.process(numSamples, levels[channel], meterCoefficient,
+                      [samples, &activity, &gain](int i) noexcept {
+                        return i >= activity.start && i < activity.end
+                                   ? samples[i] * gain.at(i - activity.start)
+                                   : 0.0f;
+                      });
+      }
+    }
+  }
+  if (tappingTracks) {
+    // The dry signal of a muted track was never scaled
+    if (track.strip.isSilent() && !track.activity.isSilent()) {
+      juce::FloatVectorOperations::clear(buffer.getWritePointer(0, offset), numSamples);
+    }
+    analysisTap->pushTrack(track, buffer.getReadPointer(0, offset), numSamples);
+  }
+}
+
+juce::int64 MixEngine::renderTrack(AudioTrack& track,
+                                   juce::AudioBuffer<float>& buffer, int offset,
+                                   int numSamples, const BeatContext& context,
+                                   const MidiEventList* events,
+                                   bool timed) noexcept {
+  const juce::int64 start = timed ? EngineProfiler::now() : 0;
+  if (events != nullptr && track.receivesMidi) {
+    track.activity =
+        track.renderWithEvents(buffer, offset, numSamples, context, *events);
+  } else {
+    track.activity = track.renderBlock(buffer, offset, numSamples, context);
+  }
+  if (!timed) {
+    return 0;
+  }
+
+  const juce::int64 elapsed = EngineProfiler::now() - start;
+  track.renderTime.record(EngineProfiler::toSeconds(elapsed));
+  return elapsed;
+}
@@ -0,0 +1,534 @@
+#include "mix-graph.hpp"
+#include <algorithm>
+#include <limits>
+
+MixBus::MixBus(juce::String name) : name(std::move(name)) {}
+
+void MixBus::setVolume(float newVolume) {
+  volume = juce::jlimit(0.0f, 1.0f, newVolume);
+}
+
+void MixBus::setPan(float newPan) {
+  pan = juce::jlimit(-1.0f, 1.0f, newPan);
+}
+
+CompensationDelay::CompensationDelay(int delaySamples, int maxBlockSize)
+    : delaySamples(juce::jmax(1, delaySamples)), maxBlockSize(juce::jmax(1, maxBlockSize)) {
+  for (int channel = 0; channel < 2; ++channel) {
+    rings[channel].assign((size_t)this->delaySamples, 0.0f);
+    inputs[channel].assign((size_t)this->maxBlockSize, 0.0f);
+    outputs[channel].assign((size_t)this->maxBlockSize, 0.0f);
+    input[channel] = inputs[channel].data();
+    output[channel] = outputs[channel].data();
+  }
+}
+
+float* const* CompensationDelay::beginSpan(int numSamples) noexcept {
+  jassert(numSamples <= maxBlockSize);
+
+  for (auto& line : inputs) {
+    std::fill(line.begin(), line.begin() + numSamples, 0.0f);
+  }
+  return input;
+}
+
+RenderActivity CompensationDelay::endSpan(RenderActivity range, int numSamples) noexcept {
+  // What the ring holds at the position is delaySamples old: it is played,
+  // and the span's input takes its place. Spans longer than the delay play
+  // their own first samples.
+  for (int channel = 0; channel < 2; ++channel) {
+    float* ring = rings[channel].data();
+    const float* in = input[channel];
+    float* out = output[channel];
+    int done = 0;
+    int at = position;
+    while (done < numSamples) {
+      const int count = juce::jmin(numSamples - done, delaySamples - at);
+      std::copy(ring + at, ring + at + count, out + done);
+      std::copy(in + done, in + done + count, ring + at);
+      done += count;
+      at = at + count == delaySamples ? 0 : at + count;
+    }
+  }
+  position = (int)(((juce::int64)position + numSamples) % delaySamples);
+
+  RenderActivity played;
+  if (heldSamples > 0) {
+    played.include(0, juce::jmin(heldSamples, numSamples));
+  }
+  heldSamples = juce::jmax(0, heldSamples - numSamples);
+
+  if (!range.isSilent()) {
+    if (range.start + delaySamples < numSamples) {
+      played.include(range.start + delaySamples,
+                     juce::jmin(range.end + delaySamples, numSamples));
+    }
+    heldSamples = juce::jmax(heldSamples, range.end + delaySamples - numSamples);
+  }
+  return played;
+}
+
+void MixPlan::compensateLatency() {
+  // Buses fed by tracks delay them as one path; the master when a track
+  // goes to it directly
+  std::vector<bool> fedByTracks(steps.size() + 1, false);
+  const auto feeds = [&fedByTracks](int step) {
+    fedByTracks[step == kMaster ? 0 : (size_t)step + 1] = true;
+  };
+  for (const auto& route : tracks) {
+    feeds(route.output);
+  }
+  for (const auto& send : trackSends) {
+    feeds(send.destination);
+  }
+
+  // Paths into a bus arrive with the latest of them: the others are
+  // delayed by the difference, through a compensation
+  compensations.clear();
+  const auto compensate = [this](const void* path, bool ofTracks, int samples) {
+    if (samples <= 0) {
+      return -1;
+    }
+    compensations.push_back({path, ofTracks, samples});
+    return (int)compensations.size() - 1;
+  };
+  const auto alignInputs = [this, &compensate, &fedByTracks](int first, int count, int step,
+                                                            const void* trackPath) {
+    int arrival = 0;
+    for (int i = first; i < first + count; ++i) {
+      arrival = std::max(arrival, steps[(size_t)inputs[(size_t)i].source].latency);
+    }
+    for (int i = first; i < first + count; ++i) {
+      auto& input = inputs[(size_t)i];
+      const auto& source = steps[(size_t)input.source];
+      input.delay = compensate(input.send != nullptr ? (const void*)input.send
+                                                     : (const void*)source.bus,
+                               false, arrival - source.latency);
+    }
+    const bool tracksIn = fedByTracks[step == kMaster ? 0 : (size_t)step + 1];
+    return std::make_pair(arrival, tracksIn ? compensate(trackPath, true, arrival) : -1);
+  };
+  const auto chainLatency = [this](int first, int count) {
+    juce::int64 sum = 0;
+    for (int i = first; i < first + count; ++i) {
+      sum += effects[(size_t)i]->getLatencySamples();
+    }
+    return sum;
+  };
+
+  // Steps in order: their inputs come from earlier steps
+  for (size_t step = 0; step < steps.size(); ++step) {
+    auto& entry = steps[step];
+    const auto aligned = alignInputs(entry.firstInput, entry.numInputs, (int)step, entry.bus);
+    entry.trackDelay = aligned.second;
+    entry.latency = (int)std::min<juce::int64>(
+        aligned.first + chainLatency(entry.firstEffect, entry.numEffects),
+        std::numeric_limits<int>::max());
+  }
+
+  const auto aligned = alignInputs(firstMasterInput, numMasterInputs, kMaster, nullptr);
+  masterTrackDelay = aligned.second;
+  latency = (int)std::min<juce::int64>(
+      aligned.first + chainLatency(firstMasterEffect, numMasterEffects),
+      std::numeric_limits<int>::max());
+}
+
+MixSend::MixSend(float level) : level(juce::jlimit(0.0f, 1.0f, level)) {}
+
+void MixSend::setLevel(float newLevel) {
+  level = juce::jlimit(0.0f, 1.0f, newLevel);
+}
+
+int MixGraph::addBus(std::shared_ptr<MixBus> bus, int output) {
+  if (output != kMaster && !isBus(output)) {
+    return -1;
+  }
+
+  // A new bus has no input yet: it cannot close a loop
+  buses.push_back({bus != nullptr ? std::move(bus) : std::make_shared<MixBus>(), output, {}});
+  return (int)buses.size() - 1;
+}
+
+bool MixGraph::removeBus(int index) {
+  if (!isBus(index)) {
+    return false;
+  }
+
+  buses.erase(buses.begin() + index);
+
+  // What went to the bus goes to the master, and indices above it move down
+  const auto remap = [index](int& output) {
+    if (output == index) {
+      output = kMaster;
+    } else if (output > index) {
+      --output;
+    }
+  };
+  for (auto& bus : buses) {
+    remap(bus.output);
+  }
+  for (auto& output : trackOutputs) {
+    remap(output);
+  }
+
+  sends.erase(std::remove_if(sends.begin(), sends.end(),
+                             [index](const Send& send) {
+                               return send.destination == index ||
+                                      (send.source.isBus && send.source.index == index);
+                             }),
+              sends.end());
+  for (auto& send : sends) {
+    remap(send.destination);
+    if (send.source.isBus) {
+      remap(send.source.index);
+    }
+  }
+  return true;
+}
+
+bool MixGraph::setBusOutput(int index, int output) {
+  if (!isBus(index) || (output != kMaster && !isBus(output))) {
+    return false;
+  }
+
+  const int previous = buses[(size_t)index].output;
+  buses[(size_t)index].output = output;
+  if (!isAcyclic()) {
+    buses[(size_t)index].output = previous;
+    return false;
+  }
+  return true;
+}
+
+bool MixGraph::setTrackOutput(int track, int output) {
+  if (track < 0 || track >= getNumTracks() || (output != kMaster && !isBus(output))) {
+    return false;
+  }
+
+  trackOutputs[(size_t)track] = output;
+  return true;
+}
+
+int MixGraph::addSend(Source source, int destination, std::shared_ptr<MixSend> send) {
+  const bool sourceExists =
+      source.isBus ? isBus(source.index) : source.index >= 0 && source.index < getNumTracks();
+  if (!sourceExists || !isBus(destination)) {
+    return -1;
+  }
+
+  sends.push_back({source, destination,
+                   send != nullptr ? std::move(send) : std::make_shared<MixSend>()});
+  if (!isAcyclic()) {
+    sends.pop_back();
+    return -1;
+  }
+  return (int)sends.size() - 1;
+}
+
+bool MixGraph::removeSend(int index) {
+  if (index < 0 || index >= (int)sends.size()) {
+    return false;
+  }
+
+  sends.erase(sends.begin() + index);
+  return true;
+}
+
+bool MixGraph::setEffects(int index, std::vector<std::shared_ptr<AudioEffect>> chain) {
+  chain.erase(std::remove(chain.begin(), chain.end(), nullptr), chain.end());
+
+  if (index == kMaster) {
+    masterEffects = std::move(chain);
+    return true;
+  }
+  if (!isBus(index)) {
+    return false;
+  }
+
+  buses[(size_t)index].effects = std::move(chain);
+  return true;
+}
+
+const std::vector<std::shared_ptr<AudioEffect>>& MixGraph::getEffects(int index) const {
+  static const std::vector<std::shared_ptr<AudioEffect>> none;
+
+  if (index == kMaster) {
+    return masterEffects;
+  }
+  return isBus(index) ? buses[(size_t)index].effects : none;
+}
+
+void MixGraph::removeTrack(int index) {
+  if (index < 0 || index >= getNumTracks()) {
+    return;
+  }
+
+  trackOutputs.erase(trackOutputs.begin() + index);
+
+  sends.erase(std::remove_if(sends.begin(), sends.end(),
+                             [index](const Send& send) {
+                               return !send.source.isBus && send.source.index == index;
+                             }),
+              sends.end());
+  for (auto& send : sends) {
+    if (!send.source.isBus && send.source.index > index) {
+      --send.source.index;
+    }
+  }
+}
+
+void MixGraph::resizeTracks(int numTracks) {
+  while (getNumTracks() > numTracks) {
+    removeTrack(getNumTracks() - 1);
+  }
+  while (getNumTracks() < numTracks) {
+    addTrack();
+  }
+}
+
+int MixGraph::getTrackOutput(int track) const noexcept {
+  return track >= 0 && track < getNumTracks() ? trackOutputs[(size_t)track] : kMaster;
+}
+
+bool MixGraph::containsEffect(const AudioEffect* effect) const noexcept {
+  bool found = false;
+  forEachEffect([&](const AudioEffect& candidate) { found = found || &candidate == effect; });
+  return found;
+}
+
+MixGraph MixGraph::clone() const {
+  MixGraph copy = *this;
+
+  for (auto& bus : copy.buses) {
+    auto fresh = std::make_shared<MixBus>(bus.bus->name);
+    fresh->setVolume(bus.bus->volume);
+    fresh->setPan(bus.bus->pan);
+    fresh->setMute(bus.bus->mute);
+    bus.bus = std::move(fresh);
+
+    for (auto& effect : bus.effects) {
+      effect = effect->clone();
+    }
+  }
+  for (auto& send : copy.sends) {
+    send.send = std::make_shared<MixSend>(send.send->level);
+  }
+  for (auto& effect : copy.masterEffects) {
+    effect = effect->clone();
+  }
+  return copy;
+}
+
+bool MixGraph::isAcyclic() const {
+  std::vector<int> levels;
+  return sortBuses(levels).size() == buses.size();
+}
+
+std::vector<int> MixGraph::sortBuses(std::vector<int>& levels) const {
+  const int numBuses = getNumBuses();
+
+  std::vector<std::vector<int>> outgoing((size_t)numBuses);
+  std::vector<int> numIncoming((size_t)numBuses, 0);
+  const auto connect = [&](int from, int to) {
+    outgoing[(size_t)from].push_back(to);
+    ++numIncoming[(size_t)to];
+  };
+  for (int index = 0; index < numBuses; ++index) {
+    if (isBus(buses[(size_t)index].output)) {
+      connect(index, buses[(size_t)index].output);
+    }
+  }
+  for (const auto& send : sends) {
+    if (send.source.isBus) {
+      connect(send.source.index, send.destination);
+    }
+  }
+
+  // Kahn's algorithm: a bus is ready once all the buses feeding it are. A
+  // loop leaves its buses waiting forever.
+  levels.assign((size_t)numBuses, 1);
+  std::vector<int> order;
+  order.reserve((size_t)numBuses);
+  for (int index = 0; index < numBuses; ++index) {
+    if (numIncoming[(size_t)index] == 0) {
+      order.push_back(index);
+    }
+  }
+  for (size_t i = 0; i < order.size(); ++i) {
+    const int from = order[i];
+    for (const int to : outgoing[(size_t)from]) {
+      levels[(size_t)to] = std::max(levels[(size_t)to], levels[(size_t)from] + 1);
+      if (--numIncoming[(size_t)to] == 0) {
+        order.push_back(to);
+      }
+    }
+  }
+  return order;
+}
+
+std::shared_ptr<const MixPlan> MixGraph::compile() const {
+  auto plan = std::make_shared<MixPlan>();
+  const int numBuses = getNumBuses();
+
+  std::vector<int> levels;
+  const bool acyclic = sortBuses(levels).size() == buses.size();
+  jassert(acyclic);  // Edits keep the graph free of loops
+  if (!acyclic) {
+    levels.assign((size_t)numBuses, 1);
+  }
+
+  // Steps by level, then by bus index: sorting by level alone is a valid
+  // order, as every bus has a higher level than its inputs
+  std::vector<int> busOfStep((size_t)numBuses);
+  for (int index = 0; index < numBuses; ++index) {
+    busOfStep[(size_t)index] = index;
+  }
+  std::stable_sort(busOfStep.begin(), busOfStep.end(), [&levels](int a, int b) {
+    return levels[(size_t)a] < levels[(size_t)b];
+  });
+  std::vector<int> stepOfBus((size_t)numBuses);
+  for (int step = 0; step < numBuses; ++step) {
+    stepOfBus[(size_t)busOfStep[(size_t)step]] = step;
+  }
+  const auto stepOf = [&stepOfBus](int bus) {
+    return bus == kMaster ? MixPlan::kMaster : stepOfBus[(size_t)bus];
+  };
+
+  // Sends grouped by source, in send order
+  std::vector<std::vector<const Send*>> trackSendsOf((size_t)getNumTracks());
+  std::vector<std::vector<const Send*>> busSendsOf((size_t)numBuses);
+  for (const auto& send : sends) {
+    auto& group = send.source.isBus ? busSendsOf : trackSendsOf;
+    group[(size_t)send.source.index].push_back(&send);
+    plan->ownedSends.push_back(send.send);
+  }
+
+  // Tracks: route, sends, and which buses they feed
+  std::vector<bool> fedByTracks((size_t)numBuses, false);
+  plan->tracks.resize(trackOutputs.size());
+  for (size_t track = 0; track < trackOutputs.size(); ++track) {
+    auto& route = plan->tracks[track];
+    route.output = stepOf(trackOutputs[track]);
+    if (isBus(trackOutputs[track])) {
+      fedByTracks[(size_t)trackOutputs[track]] = true;
+    }
+
+    route.firstSend = (int)plan->trackSends.size();
+    for (const auto* send : trackSendsOf[track]) {
+      plan->trackSends.push_back({stepOf(send->destination), send->send.get()});
+      fedByTracks[(size_t)send->destination] = true;
+    }
+    route.numSends = (int)plan->trackSends.size() - route.firstSend;
+  }
+
+  // Inputs of every bus and of the master, in step order
+  std::vector<std::vector<MixPlan::Input>> inputsOf((size_t)numBuses);
+  std::vector<MixPlan::Input> masterInputs;
+  const int masterLevel = numBuses > 0 ? levels[(size_t)busOfStep.back()] + 1 : 1;
+  std::vector<int> lastRead((size_t)numBuses, masterLevel);
+  for (int step = 0; step < numBuses; ++step) {
+    const int bus = busOfStep[(size_t)step];
+    const int output = buses[(size_t)bus].output;
+    if (output == kMaster) {
+      masterInputs.push_back({step, nullptr});
+    } else {
+      inputsOf[(size_t)output].push_back({step, nullptr});
+      lastRead[(size_t)bus] = levels[(size_t)output];
+    }
+    for (const auto* send : busSendsOf[(size_t)bus]) {
+      inputsOf[(size_t)send->destination].push_back({step, send->send.get()});
+      lastRead[(size_t)bus] =
+          std::max(lastRead[(size_t)bus], levels[(size_t)send->destination]);
+    }
+  }
+
+  // Steps, their inputs, inserts and sends
+  plan->steps.resize((size_t)numBuses);
+  for (int step = 0; step < numBuses; ++step) {
+    const auto& bus = buses[(size_t)busOfStep[(size_t)step]];
+    auto& entry = plan->steps[(size_t)step];
+    entry.bus = bus.bus.get();
+    plan->ownedBuses.push_back(bus.bus);
+
+    const auto& inputs = inputsOf[(size_t)busOfStep[(size_t)step]];
+    entry.firstInput = (int)plan->inputs.size();
+    entry.numInputs = (int)inputs.size();
+    plan->inputs.insert(plan->inputs.end(), inputs.begin(), inputs.end());
+
+    entry.firstEffect = (int)plan->effects.size();
+    entry.numEffects = (int)bus.effects.size();
+    juce::int64 tail = 0;
+    for (const auto& effect : bus.effects) {
+      plan->effects.push_back(effect.get());
+      plan->ownedEffects.push_back(effect);
+      tail += effect->getTailSamples();
+    }
+    entry.tailSamples = (int)std::min<juce::int64>(tail, std::numeric_limits<int>::max());
+
+    entry.firstSend = (int)plan->busSends.size();
+    for (const auto* send : busSendsOf[(size_t)busOfStep[(size_t)step]]) {
+      plan->busSends.push_back(send->send.get());
+    }
+    entry.numSends = (int)plan->busSends.size() - entry.firstSend;
+  }
+
+  plan->firstMasterInput = (int)plan->inputs.size();
+  plan->numMasterInputs = (int)masterInputs.size();
+  plan->inputs.insert(plan->inputs.end(), masterInputs.begin(), masterInputs.end());
+
+  plan->firstMasterEffect = (int)plan->effects.size();
+  plan->numMasterEffects = (int)masterEffects.size();
+  for (const auto& effect : masterEffects) {
+    plan->effects.push_back(effect.get());
+    plan->ownedEffects.push_back(effect);
+  }
+
+  plan->compensateLatency();
+
+  // Levels: consecutive steps of the same bus level
+  for (int step = 0; step < numBuses;) {
+    MixPlan::Level level;
+    level.begin = step;
+    int numChains = 0;
+    const int busLevel = levels[(size_t)busOfStep[(size_t)step]];
+    while (step < numBuses && levels[(size_t)busOfStep[(size_t)step]] == busLevel) {
+      numChains += plan->steps[(size_t)step].numEffects > 0 ? 1 : 0;
+      ++step;
+    }
+    level.end = step;
+    level.parallel = numChains >= 2;
+    plan->levels.push_back(level);
+  }
+
+  // Buffers: a bus writes its buffer from the track phase (0) if tracks
+  // feed it, else from its own level, until the last level reading it. A
+  // buffer is reused once its previous bus is no longer read.
+  std::vector<int> bufferFreeAfter;
+  std::vector<int> stepsByStart((size_t)numBuses);
+  for (int step = 0; step < numBuses; ++step) {
+    stepsByStart[(size_t)step] = step;
+  }
+  const auto firstWrite = [&](int step) {
+    const int bus = busOfStep[(size_t)step];
+    return fedByTracks[(size_t)bus] ? 0 : levels[(size_t)bus];
+  };
+  std::stable_sort(stepsByStart.begin(), stepsByStart.end(),
+                   [&firstWrite](int a, int b) { return firstWrite(a) < firstWrite(b); });
+  for (const int step : stepsByStart) {
+    const int start = firstWrite(step);
+    const int end = lastRead[(size_t)busOfStep[(size_t)step]];
+
+    auto free = std::find_if(bufferFreeAfter.begin(), bufferFreeAfter.end(),
+                             [start](int freeAfter) { return freeAfter < start; });
+    if (free == bufferFreeAfter.end()) {
+      bufferFreeAfter.push_back(end);
+      plan->steps[(size_t)step].buffer = (int)bufferFreeAfter.size() - 1;
+    } else {
+      *free = end;
+      plan->steps[(size_t)step].buffer = (int)(free - bufferFreeAfter.begin());
+    }
+  }
+  plan->numBuffers = (int)bufferFreeAfter.size();
+
+  return plan;
+}
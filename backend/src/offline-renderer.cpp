@@ -0,0 +1,113 @@
+#include "offline-renderer.hpp"
+#include "mix-engine.hpp"
+
+OfflineRenderer::Result OfflineRenderer::render(
+    const std::vector<std::shared_ptr<AudioTrack>>& tracks,
+    const Settings& settings) {
+  Result result;
+  const double sampleRate = settings.sampleRate;
+
+  if (settings.durationSeconds <= 0.0 || settings.blockSize <= 0 ||
+      !(sampleRate > 0.0)) {
+    result.errorMessage = "Duration, block size and sample rate must be positive";
+    return result;
+  }
+
+  auto writer = createWriter(settings, sampleRate, result.errorMessage);
+  if (writer == nullptr) {
+    return result;
+  }
+
+  // Same pipeline as live playback, without a device
+  MixEngine engine(settings.numRenderThreads);
+  for (const auto& track : tracks) {
+    engine.addTrack(track);
+  }
+  engine.prepare(settings.blockSize, sampleRate);
+  engine.setMeteringEnabled(false);  // Nobody watches the meters of a bounce
+  engine.setTempoMap(settings.tempoMap);
+  engine.setGraph(settings.routing);
+  engine.setPosition((juce::int64)std::llround(settings.startSeconds * sampleRate));
+
+  juce::AudioBuffer<float> block(2, settings.blockSize);
+  const auto totalSamples =
+      (juce::int64)std::llround(settings.durationSeconds * sampleRate);
+  const double startTime = juce::Time::getMillisecondCounterHiRes();
+
+  // Output lags the timeline by the latency of the effects: skip it
+  for (juce::int64 skipped = 0, latency = engine.getLatencySamples(); skipped < latency;) {
+    const auto numSamples =
+        (int)juce::jmin((juce::int64)settings.blockSize, latency - skipped);
+    engine.process(block, 0, numSamples);
+    skipped += numSamples;
+  }
+
+  while (result.numSamples < totalSamples) {
+    const auto numSamples = (int)juce::jmin(
+        (juce::int64)settings.blockSize, totalSamples - result.numSamples);
+
+    engine.process(block, 0, numSamples);
+
+    if (!writer->writeFromAudioSampleBuffer(block, 0, numSamples)) {
+      result.errorMessage = "Failed to write to " +
+                            settings.outputFile.getFullPathName();
+      writer.reset();
+      settings.outputFile.deleteFile();  // Not a partial file either
+      return result;
+    }
+    result.numSamples += numSamples;
+  }
+
+  writer.reset();  // Flushes and closes the file
+
+  result.renderSeconds =
+      (juce::Time::getMillisecondCounterHiRes() - startTime) / 1000.0;
+  result.realtimeFactor =
+      (double)totalSamples / sampleRate / juce::jmax(result.renderSeconds, 1e-9);
+  result.success = true;
+  return result;
+}
+
+std::unique_ptr<juce::AudioFormatWriter> OfflineRenderer::createWriter(
+    const Settings& settings, double sampleRate, juce::String& error) {
+  const auto& file = settings.outputFile;
+  std::unique_ptr<juce::AudioFormat> format;
+
+  if (file.hasFileExtension("wav")) {
+    format = std::make_unique<juce::WavAudioFormat>();
+  } else if (file.hasFileExtension("flac")) {
+    format = std::make_unique<juce::FlacAudioFormat>();
+  } else {
+    error = "Unsupported output format (use .wav or .flac): " +
+            file.getFullPathName();
+    return nullptr;
+  }
+
+  // createOutputStream() appends to existing files
+  if (file.existsAsFile() && !file.deleteFile()) {
+    error = "Cannot overwrite " + file.getFullPathName();
+    return nullptr;
+  }
+
+  std::unique_ptr<juce::OutputStream> stream(file.createOutputStream());
+  if (stream == nullptr) {
+    error = "Cannot open " + file.getFullPathName() + " for writing";
+    return nullptr;
+  }
+
+  std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(
+      stream.get(), sampleRate, 2, settings.bitDepth, {}, 0));
+  if (writer == nullptr) {
+    // Still ours: close it, then remove the empty file it created
+    stream.reset();
+    file.deleteFile();
+    error = format->getFormatName() + " does not support " +
+            juce::String(settings.bitDepth) + "-bit at " +
+            juce::String(sampleRate) + " Hz";
+    return nullptr;
+  }
+
+  // The writer now owns the stream
+  stream.release();
+  return writer;
+}
@@ -0,0 +1,286 @@
+#include "pattern-track.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+juce::int64 getFirstSampleAt(const TempoMap& map, double beat) {
+  return (juce::int64)std::ceil(map.getSampleAtBeat(beat));
+}
+
+}  // namespace
+
+//==============================================================================
+std::shared_ptr<const PatternTimeline> PatternTimeline::compile(const Pattern& pattern,
+                                                                const TempoMap& map) {
+  auto timeline = std::make_shared<PatternTimeline>();
+  timeline->map = map;
+  timeline->tempoMapId = map.getId();
+
+  const auto numSteps = std::min(pattern.steps.size(), (size_t)Pattern::kMaxSteps);
+  const double stepBeats = std::max(pattern.stepBeats, 1.0e-3);
+  timeline->firstBeat = std::max(0.0, pattern.startBeat);
+  timeline->cycleBeats = stepBeats * (double)numSteps;
+  timeline->notes.reserve(numSteps);
+
+  for (size_t i = 0; i < numSteps; ++i) {
+    const auto& step = pattern.steps[i];
+    if (!(step.velocity > 0.0f)) {
+      continue;
+    }
+
+    const double delay = juce::jlimit(
+        0.0, Pattern::kMaxSwing, step.swing + (i % 2 == 1 ? pattern.swing : 0.0));
+
+    Note note;
+    note.beat = ((double)i + delay) * stepBeats;
+    note.length = std::max(step.length, 0.0) * stepBeats;
+    note.note = juce::jlimit(0, 127, step.note);
+    note.velocity = std::min(step.velocity, 1.0f);
+    timeline->notes.push_back(note);
+  }
+
+  // Steps are delayed by less than a step, so notes are already ordered,
+  // and the last one of a cycle starts before the first one of the next
+  return timeline;
+}
+
+double PatternTimeline::getBeat(Cursor cursor) const noexcept {
+  return firstBeat + (double)cursor.cycle * cycleBeats + notes[cursor.index].beat;
+}
+
+juce::int64 PatternTimeline::getStart(Cursor cursor) const noexcept {
+  return getFirstSampleAt(map, getBeat(cursor));
+}
+
+juce::int64 PatternTimeline::getEnd(Cursor cursor) const noexcept {
+  const double end = getBeat(cursor) + notes[cursor.index].length;
+  return std::max(getStart(cursor) + 1, getFirstSampleAt(map, end));
+}
+
+PatternTimeline::Cursor PatternTimeline::getNext(Cursor cursor) const noexcept {
+  if (++cursor.index == notes.size()) {
+    cursor = {cursor.cycle + 1, 0};
+  }
+  return cursor;
+}
+
+PatternTimeline::Cursor PatternTimeline::findFirst(juce::int64 sample) const noexcept {
+  // Estimate from the beat of the sample, then settle the rounding of both
+  // conversions by comparing samples
+  Cursor cursor;
+  const double beat = map.getBeatAtSample(sample) - firstBeat;
+  if (beat > 0.0) {
+    cursor.cycle = (juce::int64)std::floor(beat / cycleBeats);
+    const double inCycle = beat - (double)cursor.cycle * cycleBeats;
+    cursor.index = (size_t)(std::lower_bound(notes.begin(), notes.end(), inCycle,
+                                             [](const Note& note, double value) {
+                                               return note.beat < value;
+                                             }) -
+                            notes.begin());
+    if (cursor.index == notes.size()) {
+      cursor = {cursor.cycle + 1, 0};
+    }
+  }
+
+  while (cursor.cycle > 0 || cursor.index > 0) {
+    Cursor previous = cursor.index > 0 ? Cursor{cursor.cycle, cursor.index - 1}
+                                       : Cursor{cursor.cycle - 1, notes.size() - 1};
+    if (getStart(previous) < sample) {
+      break;
+    }
+    cursor = previous;
+  }
+  while (getStart(cursor) < sample) {
+    cursor = getNext(cursor);
+  }
+  return cursor;
+}
+
+//==============================================================================
+PatternTrack::PatternTrack(int maxVoices, WaveTable::WaveType waveform)
+    : SynthTrack(maxVoices, waveform) {
+  noteEnds.fill(kNever);
+}
+
+PatternTrack::PatternTrack(const PatternTrack& other)
+    : SynthTrack(other.getMaxVoices(), other.getWaveform()) {
+  copySettings(other);
+  noteEnds.fill(kNever);
+
+  const std::lock_guard<std::mutex> lock(other.controlMutex);
+  pattern = other.pattern;
+  latest = other.latest;
+  timeline = latest;
+}
+
+PatternTrack::~PatternTrack() = default;
+
+float PatternTrack::getSampleValue(const BeatContext& context) {
+  sync(context.sample);
+  playDue(context.sample);
+  nextSample = context.sample + 1;
+  return SynthTrack::getSampleValue(context);
+}
+
+RenderActivity PatternTrack::renderBlock(juce::AudioBuffer<float>& buffer,
+                                         int startSample, int numSamples,
+                                         const BeatContext& context) {
+  sync(context.sample);
+
+  // One render per stretch between two note events. The voices only take
+  // the sample rate from the context.
+  RenderActivity activity;
+  for (int done = 0; done < numSamples;) {
+    const juce::int64 position = context.sample + done;
+    playDue(position);
+
+    const int count =
+        (int)std::min<juce::int64>(numSamples - done, getNextEvent() - position);
+    const auto piece =
+        SynthTrack::renderBlock(buffer, startSample + done, count, context);
+    if (!piece.isSilent()) {
+      activity.include(done + piece.start, done + piece.end);
+    }
+    done += count;
+  }
+
+  nextSample = context.sample + numSamples;
+  return activity;
+}
+
+std::unique_ptr<AudioTrack> PatternTrack::clone() const {
+  return std::unique_ptr<AudioTrack>(new PatternTrack(*this));
+}
+
+void PatternTrack::tempoMapChanged(const TempoMap& map) {
+  const std::lock_guard<std::mutex> lock(controlMutex);
+  if (latest == nullptr || latest->tempoMapId == map.getId()) {
+    return;
+  }
+  publish(PatternTimeline::compile(pattern, map));
+}
+
+bool PatternTrack::setPattern(Pattern newPattern, const TempoMap& map) {
+  if (newPattern.steps.size() > (size_t)Pattern::kMaxSteps) {
+    newPattern.steps.resize((size_t)Pattern::kMaxSteps);
+  }
+
+  // Compiled before taking the lock: the audio thread never waits for it,
+  // but other control threads would
+  auto compiled = PatternTimeline::compile(newPattern, map);
+
+  const std::lock_guard<std::mutex> lock(controlMutex);
+  if (!publish(std::move(compiled))) {
+    return false;
+  }
+  pattern = std::move(newPattern);
+  return true;
+}
+
+Pattern PatternTrack::getPattern() const {
+  const std::lock_guard<std::mutex> lock(controlMutex);
+  return pattern;
+}
+
+std::shared_ptr<const PatternTimeline> PatternTrack::getTimeline() const {
+  const std::lock_guard<std::mutex> lock(controlMutex);
+  return latest;
+}
+
+bool PatternTrack::publish(std::shared_ptr<const PatternTimeline> compiled) {
+  collectRetired();
+  if (inFlight == kMaxPendingTimelines) {
+    return false;
+  }
+
+  // Every timeline pushed comes back once replaced, so the retired queue
+  // always has room for the audio thread
+  auto queued = compiled;
+  if (!incoming.tryPush(std::move(queued))) {
+    return false;
+  }
+  ++inFlight;
+  latest = std::move(compiled);
+  return true;
+}
+
+void PatternTrack::collectRetired() {
+  std::shared_ptr<const PatternTimeline> old;
+  while (retired.tryPop(old)) {
+    old.reset();  // Freed here, not on the audio thread
+    --inFlight;
+  }
+}
+
+void PatternTrack::sync(juce::int64 position) noexcept {
+  // Newest timeline wins; replaced ones go back to the control side
+  bool seek = false;
+  std::shared_ptr<const PatternTimeline> next;
+  while (incoming.tryPop(next)) {
+    std::swap(timeline, next);
+    retired.tryPush(std::move(next));
+    seek = true;
+  }
+
+  if (position != nextSample) {
+    // Seek or first block: notes of the previous position end here
+    releaseAll();
+    seek = true;
+  }
+  if (seek) {
+    if (timeline != nullptr && !timeline->notes.empty()) {
+      cursor = timeline->findFirst(position);
+      cursorStart = timeline->getStart(cursor);
+    } else {
+      cursorStart = kNever;
+    }
+  }
+}
+
+void PatternTrack::playDue(juce::int64 position) noexcept {
+  // Note-offs first, so a note ending where it starts again is restarted
+  if (nextNoteEnd <= position) {
+    releaseDue(position);
+  }
+  while (cursorStart <= position) {
+    startNote(timeline->notes[cursor.index], timeline->getEnd(cursor));
+    cursor = timeline->getNext(cursor);
+    cursorStart = timeline->getStart(cursor);
+  }
+}
+
+void PatternTrack::startNote(const PatternTimeline::Note& note, juce::int64 end) noexcept {
+  auto& noteEnd = noteEnds[(size_t)note.note];
+  if (noteEnd != kNever) {
+    noteOff(note.note);
+  }
+  noteOn(note.note, note.velocity);
+  noteEnd = end;
+  nextNoteEnd = std::min(nextNoteEnd, end);
+}
+
+void PatternTrack::releaseDue(juce::int64 position) noexcept {
+  nextNoteEnd = kNever;
+  for (size_t note = 0; note < noteEnds.size(); ++note) {
+    if (noteEnds[note] == kNever) {
+      continue;
+    }
+    if (noteEnds[note] <= position) {
+      noteOff((int)note);
+      noteEnds[note] = kNever;
+    } else {
+      nextNoteEnd = std::min(nextNoteEnd, noteEnds[note]);
+    }
+  }
+}
+
+void PatternTrack::releaseAll() noexcept {
+  if (nextNoteEnd != kNever) {
+    releaseDue(kNever);
+  }
+}
+
+juce::int64 PatternTrack::getNextEvent() const noexcept {
+  return std::min(nextNoteEnd, cursorStart);
+}
@@ -0,0 +1,435 @@
+#include "realtime-guard.hpp"
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if DAW_REALTIME_GUARD && defined(__linux__) && defined(__GLIBC__)
+#define DAW_INTERPOSE_LIBC 1
+#include <dlfcn.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#else
+#define DAW_INTERPOSE_LIBC 0
+#endif
+
+namespace {
+
+// Plain thread_local ints: constant-initialised, so reading them never
+// allocates, even from inside malloc
+thread_local int realtimeDepth = 0;
+thread_local int allowDepth = 0;
+
+std::atomic<std::uint64_t> violations{0};
+
+// -1 until read from the environment
+std::atomic<int> currentMode{-1};
+
+RealtimeGuard::Mode getModeFromEnvironment() noexcept {
+  const char* value = std::getenv("DAW_REALTIME_GUARD_MODE");
+  if (value != nullptr && std::strcmp(value, "abort") == 0) {
+    return RealtimeGuard::Mode::Abort;
+  }
+  if (value != nullptr && std::strcmp(value, "count") == 0) {
+    return RealtimeGuard::Mode::Count;
+  }
+  return RealtimeGuard::Mode::Report;
+}
+
+}  // namespace
+
+//==============================================================================
+void RealtimeGuard::enter() noexcept {
+  ++realtimeDepth;
+}
+
+void RealtimeGuard::leave() noexcept {
+  --realtimeDepth;
+}
+
+void RealtimeGuard::suspend() noexcept {
+  ++allowDepth;
+}
+
+void RealtimeGuard::resume() noexcept {
+  --allowDepth;
+}
+
+bool RealtimeGuard::isRealtimeThread() noexcept {
+  return realtimeDepth > 0 && allowDepth == 0;
+}
+
+void RealtimeGuard::setMode(Mode mode) noexcept {
+  currentMode.store((int)mode, std::memory_order_relaxed);
+}
+
+RealtimeGuard::Mode RealtimeGuard::getMode() noexcept {
+  int mode = currentMode.load(std::memory_order_relaxed);
+  if (mode < 0) {
+    mode = (int)getModeFromEnvironment();
+    currentMode.store(mode, std::memory_order_relaxed);
+  }
+  return (Mode)mode;
+}
+
+std::uint64_t RealtimeGuard::getViolationCount() noexcept {
+  return violations.load(std::memory_order_relaxed);
+}
+
+void RealtimeGuard::check(const char* function) noexcept {
+  if (!isRealtimeThread()) {
+    return;
+  }
+
+  // Reporting allocates and writes: not a violation of its own
+  const AllowScope reporting;
+  violations.fetch_add(1, std::memory_order_relaxed);
+
+  const Mode mode = getMode();
+  if (mode == Mode::Count) {
+    return;
+  }
+
+  std::fprintf(stderr, "[RealtimeGuard] %s called on the audio thread\n",
+               function);
+  std::fputs(juce::SystemStats::getStackBacktrace().toRawUTF8(), stderr);
+  std::fflush(stderr);
+
+  if (mode == Mode::Abort) {
+    std::abort();
+  }
+}
+
+#if DAW_REALTIME_GUARD
+//==============================================================================
+// Allocation
+
+#if DAW_INTERPOSE_LIBC
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+}
+#endif
+
+namespace {
+
+// Underlying allocator, without the check (operator new checks once)
+void* rawAllocate(std::size_t size) noexcept {
+#if DAW_INTERPOSE_LIBC
+  return __libc_malloc(size);
+#else
+  return std::malloc(size);
+#endif
+}
+
+void rawFree(void* pointer) noexcept {
+#if DAW_INTERPOSE_LIBC
+  __libc_free(pointer);
+#else
+  std::free(pointer);
+#endif
+}
+
+void* rawAllocateAligned(std::size_t size, std::size_t alignment) noexcept {
+#if DAW_INTERPOSE_LIBC
+  return __libc_memalign(alignment, size);
+#elif defined(_MSC_VER)
+  return _aligned_malloc(size, alignment);
+#else
+  return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+void rawFreeAligned(void* pointer) noexcept {
+#if defined(_MSC_VER) && !DAW_INTERPOSE_LIBC
+  _aligned_free(pointer);
+#else
+  rawFree(pointer);
+#endif
+}
+
+void* allocate(std::size_t size, const char* function) {
+  RealtimeGuard::check(function);
+  size = size == 0 ? 1 : size;
+
+  void* pointer;
+  while ((pointer = rawAllocate(size)) == nullptr) {
+    const auto handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+  return pointer;
+}
+
+void* allocateAligned(std::size_t size, std::align_val_t alignment,
+                      const char* function) {
+  RealtimeGuard::check(function);
+  size = size == 0 ? 1 : size;
+
+  void* pointer;
+  while ((pointer = rawAllocateAligned(size, (std::size_t)alignment)) == nullptr) {
+    const auto handler = std::get_new_handler();
+    if (handler == nullptr) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+  return pointer;
+}
+
+void release(void* pointer, const char* function) noexcept {
+  if (pointer != nullptr) {
+    RealtimeGuard::check(function);
+    rawFree(pointer);
+  }
+}
+
+void releaseAligned(void* pointer, const char* function) noexcept {
+  if (pointer != nullptr) {
+    RealtimeGuard::check(function);
+    rawFreeAligned(pointer);
+  }
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  return allocate(size, "operator new");
+}
+
+void* operator new[](std::size_t size) {
+  return allocate(size, "operator new[]");
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return allocate(size, "operator new");
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  try {
+    return allocate(size, "operator new[]");
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return allocateAligned(size, alignment, "operator new");
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+  return allocateAligned(size, alignment, "operator new[]");
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept {
+  try {
+    return allocateAligned(size, alignment, "operator new");
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept {
+  try {
+    return allocateAligned(size, alignment, "operator new[]");
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void operator delete(void* pointer) noexcept {
+  release(pointer, "operator delete");
+}
+
+void operator delete[](void* pointer) noexcept {
+  release(pointer, "operator delete[]");
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+  release(pointer, "operator delete");
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+  release(pointer, "operator delete[]");
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+  release(pointer, "operator delete");
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+  release(pointer, "operator delete[]");
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+  releaseAligned(pointer, "operator delete");
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+  releaseAligned(pointer, "operator delete[]");
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept {
+  releaseAligned(pointer, "operator delete");
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept {
+  releaseAligned(pointer, "operator delete[]");
+}
+
+void operator delete(void* pointer, std::align_val_t,
+                     const std::nothrow_t&) noexcept {
+  releaseAligned(pointer, "operator delete");
+}
+
+void operator delete[](void* pointer, std::align_val_t,
+                       const std::nothrow_t&) noexcept {
+  releaseAligned(pointer, "operator delete[]");
+}
+
+#if DAW_INTERPOSE_LIBC
+//==============================================================================
+// C library: calls from JUCE, libstdc++ and C code end up here too
+
+namespace {
+
+// The definition this executable hides, looked up once
+template <typename Function>
+Function findNext(Function, const char* name) noexcept {
+  return reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+}
+
+}  // namespace
+
+extern "C" {
+
+void* malloc(size_t size) __THROW {
+  RealtimeGuard::check("malloc");
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) __THROW {
+  RealtimeGuard::check("calloc");
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) __THROW {
+  RealtimeGuard::check("realloc");
+  return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer) __THROW {
+  if (pointer != nullptr) {
+    RealtimeGuard::check("free");
+    __libc_free(pointer);
+  }
+}
+
+void* memalign(size_t alignment, size_t size) __THROW {
+  RealtimeGuard::check("memalign");
+  return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) __THROW {
+  RealtimeGuard::check("aligned_alloc");
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** result, size_t alignment, size_t size) __THROW {
+  RealtimeGuard::check("posix_memalign");
+  if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
+  }
+
+  void* pointer = __libc_memalign(alignment, size);
+  if (pointer == nullptr) {
+    return ENOMEM;
+  }
+  *result = pointer;
+  return 0;
+}
+
+// Locks and waits (std::mutex, juce::CriticalSection, std::thread::join...)
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) __THROWNL {
+  RealtimeGuard::check("pthread_mutex_lock");
+  static const auto next = findNext(&pthread_mutex_lock, "pthread_mutex_lock");
+  return next(mutex);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* lock) __THROWNL {
+  RealtimeGuard::check("pthread_rwlock_rdlock");
+  static const auto next =
+      findNext(&pthread_rwlock_rdlock, "pthread_rwlock_rdlock");
+  return next(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* lock) __THROWNL {
+  RealtimeGuard::check("pthread_rwlock_wrlock");
+  static const auto next =
+      findNext(&pthread_rwlock_wrlock, "pthread_rwlock_wrlock");
+  return next(lock);
+}
+
+int pthread_join(pthread_t thread, void** result) {
+  RealtimeGuard::check("pthread_join");
+  static const auto next = findNext(&pthread_join, "pthread_join");
+  return next(thread, result);
+}
+
+int sem_wait(sem_t* semaphore) {
+  RealtimeGuard::check("sem_wait");
+  static const auto next = findNext(&sem_wait, "sem_wait");
+  return next(semaphore);
+}
+
+int sem_timedwait(sem_t* semaphore, const struct timespec* timeout) {
+  RealtimeGuard::check("sem_timedwait");
+  static const auto next = findNext(&sem_timedwait, "sem_timedwait");
+  return next(semaphore, timeout);
+}
+
+int nanosleep(const struct timespec* duration, struct timespec* remaining) {
+  RealtimeGuard::check("nanosleep");
+  static const auto next = findNext(&nanosleep, "nanosleep");
+  return next(duration, remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec* duration,
+                    struct timespec* remaining) {
+  RealtimeGuard::check("clock_nanosleep");
+  static const auto next = findNext(&clock_nanosleep, "clock_nanosleep");
+  return next(clock, flags, duration, remaining);
+}
+
+int usleep(useconds_t microseconds) {
+  RealtimeGuard::check("usleep");
+  static const auto next = findNext(&usleep, "usleep");
+  return next(microseconds);
+}
+
+unsigned int sleep(unsigned int seconds) {
+  RealtimeGuard::check("sleep");
+  static const auto next = findNext(&sleep, "sleep");
+  return next(seconds);
+}
+
+}  // extern "C"
+#endif  // DAW_INTERPOSE_LIBC
+#endif  // DAW_REALTIME_GUARD
@@ -0,0 +1,222 @@
+#include "render-worker-pool.hpp"
+#include "realtime-guard.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <cerrno>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Busy-wait hint: keeps the core responsive without giving up the time slice
+inline void cpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+
+}  // namespace
+
+//==============================================================================
+WorkStealingDeque::WorkStealingDeque(int capacity)
+    : tasks((size_t)std::max(1, capacity)) {}
+
+void WorkStealingDeque::reset() noexcept {
+  top.store(0, std::memory_order_relaxed);
+  bottom.store(0, std::memory_order_relaxed);
+}
+
+bool WorkStealingDeque::push(int task) noexcept {
+  const int64_t b = bottom.load(std::memory_order_relaxed);
+  if (b >= (int64_t)tasks.size()) {
+    return false;
+  }
+
+  tasks[(size_t)b] = task;
+  bottom.store(b + 1, std::memory_order_relaxed);
+  return true;
+}
+
+int WorkStealingDeque::pop() noexcept {
+  const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+  bottom.store(b, std::memory_order_seq_cst);
+  int64_t t = top.load(std::memory_order_seq_cst);
+
+  if (t > b) {
+    // Empty: restore bottom
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return -1;
+  }
+
+  int task = tasks[(size_t)b];
+  if (t == b) {
+    // Last task: race against thieves for it
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed)) {
+      task = -1;
+    }
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+  return task;
+}
+
+int WorkStealingDeque::steal() noexcept {
+  int64_t t = top.load(std::memory_order_seq_cst);
+  const int64_t b = bottom.load(std::memory_order_seq_cst);
+
+  if (t >= b) {
+    return -1;
+  }
+
+  const int task = tasks[(size_t)t];
+  if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                   std::memory_order_relaxed)) {
+    return -1;
+  }
+  return task;
+}
+
+//==============================================================================
+RenderWorkerPool::RenderWorkerPool(int numWorkers, int maxTasks) {
+  numWorkers = std::max(0, numWorkers);
+  const int participants = numWorkers + 1;
+  dequeCapacity = std::max(1, (maxTasks + participants - 1) / participants);
+
+  for (int i = 0; i < participants; ++i) {
+    deques.push_back(std::make_unique<WorkStealingDeque>(dequeCapacity));
+  }
+
+  for (int i = 0; i < numWorkers; ++i) {
+    auto worker = std::make_unique<Worker>();
+    sem_init(&worker->wakeUp, 0, 0);
+    workers.push_back(std::move(worker));
+  }
+
+  for (int i = 0; i < numWorkers; ++i) {
+    workers[(size_t)i]->thread = std::thread([this, i]() { workerLoop(i); });
+
+    // Best effort: run workers with real-time priority, just below the
+    // audio device thread. Silently stays SCHED_OTHER without privileges.
+    sched_param param{};
+    param.sched_priority = std::max(sched_get_priority_min(SCHED_FIFO),
+                                    sched_get_priority_max(SCHED_FIFO) / 2);
+    pthread_setschedparam(workers[(size_t)i]->thread.native_handle(),
+                          SCHED_FIFO, &param);
+  }
+}
+
+RenderWorkerPool::~RenderWorkerPool() {
+  shouldExit.store(true);
+
+  for (auto& worker : workers) {
+    sem_post(&worker->wakeUp);
+  }
+
+  for (auto& worker : workers) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+    sem_destroy(&worker->wakeUp);
+  }
+}
+
+int RenderWorkerPool::getDefaultThreadCount() {
+  return std::max(0, (int)std::thread::hardware_concurrency() - 1);
+}
+
+void RenderWorkerPool::run(int numTasks,
+                           TaskFunction function,
+                           void* context) noexcept {
+  if (numTasks <= 0) {
+    return;
+  }
+
+  const int participants = (int)deques.size();
+  const int queuedTasks = std::min(numTasks, dequeCapacity * participants);
+
+  // No worker is running here: deques can be refilled without atomics races
+  for (auto& deque : deques) {
+    deque->reset();
+  }
+  for (int task = 0; task < queuedTasks; ++task) {
+    deques[(size_t)(task % participants)]->push(task);
+  }
+
+  currentFunction = function;
+  currentContext = context;
+  realtimeBatch = RealtimeGuard::isRealtimeThread();
+  remainingTasks.store(queuedTasks, std::memory_order_relaxed);
+
+  // Wake only as many workers as there are tasks to share
+  wokenWorkers = std::min(getNumWorkers(), queuedTasks - 1);
+  for (int i = 0; i < wokenWorkers; ++i) {
+    workers[(size_t)i]->state.store(Pending, std::memory_order_release);
+    sem_post(&workers[(size_t)i]->wakeUp);
+  }
+
+  executeTasks(0);
+
+  // Tasks beyond the deque capacity run on the calling thread
+  for (int task = queuedTasks; task < numTasks; ++task) {
+    function(context, task);
+  }
+
+  // Cancel workers that did not wake up in time, wait for the running ones
+  // (they are about to leave executeTasks since no task is left)
+  for (int i = 0; i < wokenWorkers; ++i) {
+    auto& state = workers[(size_t)i]->state;
+    int expected = Pending;
+    if (!state.compare_exchange_strong(expected, Idle,
+                                       std::memory_order_acq_rel)) {
+      while (state.load(std::memory_order_acquire) != Idle) {
+        cpuRelax();
+      }
+    }
+  }
+}
+
+void RenderWorkerPool::workerLoop(int workerIndex) {
+  auto& worker = *workers[(size_t)workerIndex];
+
+  while (true) {
+    while (sem_wait(&worker.wakeUp) != 0 && errno == EINTR) {
+    }
+
+    if (shouldExit.load()) {
+      break;
+    }
+
+    // A stale wake-up (batch already cancelled) finds the worker Idle
+    int expected = Pending;
+    if (worker.state.compare_exchange_strong(expected, Running,
+                                             std::memory_order_acq_rel)) {
+      const RealtimeGuard::Scope realtime(realtimeBatch);
+      executeTasks(workerIndex + 1);
+      worker.state.store(Idle, std::memory_order_release);
+    }
+  }
+}
+
+void RenderWorkerPool::executeTasks(int participant) noexcept {
+  const int participants = (int)deques.size();
+
+  while (remainingTasks.load(std::memory_order_acquire) > 0) {
+    int task = deques[(size_t)participant]->pop();
+
+    for (int i = 1; task < 0 && i < participants; ++i) {
+      task = deques[(size_t)((participant + i) % participants)]->steal();
+    }
+
+    if (task >= 0) {
+      currentFunction(currentContext, task);
+      remainingTasks.fetch_sub(1, std::memory_order_acq_rel);
+    } else {
+      cpuRelax();
+    }
+  }
+}
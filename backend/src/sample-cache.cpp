@@ -0,0 +1,359 @@
+#include "sample-cache.hpp"
+#include "sample-sidecar.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace {
+
+void writeMetric(std::string& out, const char* name, const char* help,
+                 const char* type, juce::uint64 value) {
+  out += "# HELP ";
+  out += name;
+  out += ' ';
+  out += help;
+  out += "\n# TYPE ";
+  out += name;
+  out += ' ';
+  out += type;
+  out += '\n';
+  out += name;
+  out += ' ' + std::to_string(value) + '\n';
+}
+
+}  // namespace
+
+//==============================================================================
+// DecodedSample
+
+std::shared_ptr<const DecodedSample> DecodedSample::decode(
+    juce::AudioFormatReader* reader) {
+  if (reader == nullptr || reader->sampleRate <= 0.0 || reader->numChannels == 0 ||
+      reader->lengthInSamples < 0 ||
+      reader->lengthInSamples > (juce::int64)(INT_MAX - kPaddingFrames)) {
+    return nullptr;
+  }
+
+  std::shared_ptr<DecodedSample> sample(new DecodedSample());
+  sample->allocate(juce::jmin((int)reader->numChannels, kMaxChannels),
+                   (int)reader->lengthInSamples);
+  sample->sampleRate = reader->sampleRate;
+  reader->read(&sample->buffer, 0, sample->length, 0, true, true);
+  return sample;
+}
+
+std::shared_ptr<const DecodedSample> DecodedSample::resample(
+    std::shared_ptr<const DecodedSample> sample, double sampleRate) {
+  if (sample == nullptr || sampleRate <= 0.0 || sample->sampleRate == sampleRate) {
+    return sample;
+  }
+  const auto newLength = sample->getLength(sampleRate);
+  if (newLength > (juce::int64)(INT_MAX - kPaddingFrames)) {
+    return nullptr;
+  }
+
+  // Same interpolation as SamplePlayhead, so both play the same frames
+  std::shared_ptr<DecodedSample> resampled(new DecodedSample());
+  resampled->allocate(sample->numChannels, (int)newLength);
+  resampled->sampleRate = sampleRate;
+  const double speedRatio = sample->sampleRate / sampleRate;
+  for (int channel = 0; channel < sample->numChannels; ++channel) {
+    juce::LagrangeInterpolator interpolator;
+    interpolator.process(speedRatio, sample->getReadPointer(channel),
+                         resampled->buffer.getWritePointer(channel), resampled->length);
+  }
+  return resampled;
+}
+
+void DecodedSample::allocate(int newNumChannels, int newLength) {
+  numChannels = newNumChannels;
+  length = newLength;
+  buffer.setSize(numChannels, length + kPaddingFrames);
+  buffer.clear(length, kPaddingFrames);
+  for (int channel = 0; channel < numChannels; ++channel) {
+    channels[(size_t)channel] = buffer.getReadPointer(channel);
+  }
+}
+
+juce::int64 DecodedSample::getLength(double outputSampleRate) const noexcept {
+  if (sampleRate <= 0.0) {
+    return 0;
+  }
+  return (juce::int64)std::ceil((double)length * outputSampleRate / sampleRate -
+                                1.0e-6);
+}
+
+//==============================================================================
+// SamplePlayhead
+
+int SamplePlayhead::read(const DecodedSample& sample, juce::int64 frame,
+                         double sampleRate, float* const* destinations,
+                         int numDestinations, int numFrames) noexcept {
+  numDestinations = juce::jmin(numDestinations, DecodedSample::kMaxChannels);
+  const int numChannels = sample.getNumChannels();
+
+  // Silence before the start of the sample, and after its end
+  const juce::int64 first = juce::jmax<juce::int64>(frame, 0);
+  const int leadIn = (int)juce::jmin<juce::int64>(numFrames, first - frame);
+  int count = (int)juce::jlimit<juce::int64>(0, numFrames - leadIn,
+                                             sample.getLength(sampleRate) - first);
+  const double speedRatio = sample.getSampleRate() / sampleRate;
+
+  if (speedRatio == 1.0) {
+    if (numDestinations == 1 && numChannels == 2) {
+      juce::FloatVectorOperations::copyWithMultiply(
+          destinations[0] + leadIn, sample.getReadPointer(0) + first, 0.5f, count);
+      juce::FloatVectorOperations::addWithMultiply(
+          destinations[0] + leadIn, sample.getReadPointer(1) + first, 0.5f, count);
+    } else {
+      for (int channel = 0; channel < numDestinations; ++channel) {
+        juce::FloatVectorOperations::copy(
+            destinations[channel] + leadIn,
+            sample.getReadPointer(juce::jmin(channel, numChannels - 1)) + first, count);
+      }
+    }
+  } else {
+    if (first != nextFrame || sampleRate != lastSampleRate) {
+      sourcePosition = (juce::int64)std::floor((double)first * speedRatio);
+      for (auto& interpolator : interpolators) {
+        interpolator.reset();
+      }
+    }
+
+    // Interpolators never read past the padding
+    const juce::int64 available =
+        sample.getLength() + DecodedSample::kPaddingFrames - 2 - sourcePosition;
+    count = juce::jmin(count, (int)((double)juce::jmax<juce::int64>(available, 0) /
+                                    speedRatio));
+
+    if (count > 0) {
+      int used = 0;
+      if (numDestinations == 1 && numChannels == 2) {
+        float* output = destinations[0] + leadIn;
+        used = interpolators[0].process(
+            speedRatio, sample.getReadPointer(0) + sourcePosition, output, count);
+        juce::FloatVectorOperations::multiply(output, 0.5f, count);
+        interpolators[1].processAdding(speedRatio,
+                                       sample.getReadPointer(1) + sourcePosition,
+                                       output, count, 0.5f);
+      } else {
+        for (int channel = 0; channel < numDestinations; ++channel) {
+          if (channel < numChannels) {
+            used = interpolators[(size_t)channel].process(
+                speedRatio, sample.getReadPointer(channel) + sourcePosition,
+                destinations[channel] + leadIn, count);
+          } else {
+            juce::FloatVectorOperations::copy(destinations[channel] + leadIn,
+                                              destinations[0] + leadIn, count);
+          }
+        }
+      }
+      sourcePosition += used;
+    }
+  }
+
+  for (int channel = 0; channel < numDestinations; ++channel) {
+    juce::FloatVectorOperations::clear(destinations[channel], leadIn);
+    juce::FloatVectorOperations::clear(destinations[channel] + leadIn + count,
+                                       numFrames - leadIn - count);
+  }
+
+  nextFrame = first + (numFrames - leadIn);
+  lastSampleRate = sampleRate;
+  return count;
+}
+
+//==============================================================================
+// SampleCache
+
+SampleCache::SampleCache(size_t budgetBytes) : budget(budgetBytes) {}
+
+SampleCache& SampleCache::getInstance() {
+  static SampleCache instance;
+  return instance;
+}
+
+std::shared_ptr<const DecodedSample> SampleCache::load(const juce::File& file,
+                                                      double sampleRate) {
+  return load(file, sampleRate, DiskStreamer::getReaderFactory(file));
+}
+
+std::shared_ptr<const DecodedSample> SampleCache::load(
+    const juce::File& file, double sampleRate, const SampleStream::ReaderFactory& factory) {
+  // A file rewritten in place is a different entry
+  std::string key = file.getFullPathName().toStdString() + '|' +
+                    std::to_string(file.getSize()) + '|' +
+                    std::to_string(file.getLastModificationTime().toMilliseconds());
+  if (sampleRate > 0.0) {
+    key += '@' + std::to_string(sampleRate);
+  }
+
+  const auto directory = getSidecarDirectory();
+  const bool useSidecar = sampleRate > 0.0 && directory.getFullPathName().isNotEmpty();
+  return loadDecoded(key, [&]() -> std::shared_ptr<const DecodedSample> {
+    const auto sidecar = useSidecar ? SampleSidecar::getFile(directory, file, sampleRate)
+                                    : juce::File();
+    if (useSidecar) {
+      if (auto mapped = SampleSidecar::open(sidecar, file, sampleRate)) {
+        const std::lock_guard<std::mutex> lock(mutex);
+        ++counters.sidecarLoads;
+        return mapped;
+      }
+    }
+
+    std::shared_ptr<const DecodedSample> sample;
+    if (factory) {
+      const auto reader = factory();
+      sample = DecodedSample::resample(DecodedSample::decode(reader.get()), sampleRate);
+    }
+    if (useSidecar && sample != nullptr && SampleSidecar::write(sidecar, file, *sample)) {
+      {
+        const std::lock_guard<std::mutex> lock(mutex);
+        ++counters.sidecarWrites;
+      }
+      // Played from the mapping, as after the next start; the decoded copy is freed
+      if (auto mapped = SampleSidecar::open(sidecar, file, sampleRate)) {
+        return mapped;
+      }
+    }
+    return sample;
+  });
+}
+
+std::shared_ptr<const DecodedSample> SampleCache::load(
+    const std::string& key, const SampleStream::ReaderFactory& factory) {
+  return loadDecoded(key, [&factory]() -> std::shared_ptr<const DecodedSample> {
+    if (!factory) {
+      return nullptr;
+    }
+    const auto reader = factory();
+    return DecodedSample::decode(reader.get());
+  });
+}
+
+std::shared_ptr<const DecodedSample> SampleCache::loadDecoded(const std::string& key,
+                                                              const Decoder& decoder) {
+  {
+    const std::lock_guard<std::mutex> lock(mutex);
+    const auto found = index.find(key);
+    if (found != index.end()) {
+      entries.splice(entries.begin(), entries, found->second);
+      ++counters.hits;
+      return found->second->sample;
+    }
+    ++counters.misses;
+  }
+
+  // Decoded without the lock: hits on other files are not held up
+  auto sample = decoder();
+
+  // Freed after the lock is released
+  std::vector<std::shared_ptr<const DecodedSample>> released;
+  const std::lock_guard<std::mutex> lock(mutex);
+  if (sample == nullptr) {
+    ++counters.failures;
+    return nullptr;
+  }
+
+  const auto found = index.find(key);
+  if (found != index.end()) {
+    // Decoded by another thread meanwhile: share its copy
+    released.push_back(std::move(sample));
+    entries.splice(entries.begin(), entries, found->second);
+    return found->second->sample;
+  }
+
+  entries.push_front({key, sample});
+  index[key] = entries.begin();
+  bytes += sample->getSizeInBytes();
+  evict(budget, released);
+  return sample;
+}
+
+void SampleCache::setBudget(size_t budgetBytes) {
+  std::vector<std::shared_ptr<const DecodedSample>> released;
+  const std::lock_guard<std::mutex> lock(mutex);
+  budget = budgetBytes;
+  evict(budget, released);
+}
+
+void SampleCache::setSidecarDirectory(const juce::File& directory) {
+  const std::lock_guard<std::mutex> lock(mutex);
+  sidecarDirectory = directory;
+}
+
+juce::File SampleCache::getSidecarDirectory() const {
+  const std::lock_guard<std::mutex> lock(mutex);
+  return sidecarDirectory;
+}
+
+size_t SampleCache::getBudget() const {
+  const std::lock_guard<std::mutex> lock(mutex);
+  return budget;
+}
+
+void SampleCache::trim() {
+  std::vector<std::shared_ptr<const DecodedSample>> released;
+  const std::lock_guard<std::mutex> lock(mutex);
+  evict(budget, released);
+}
+
+void SampleCache::clear() {
+  std::vector<std::shared_ptr<const DecodedSample>> released;
+  const std::lock_guard<std::mutex> lock(mutex);
+  evict(0, released);
+}
+
+SampleCache::Statistics SampleCache::getStatistics() const {
+  const std::lock_guard<std::mutex> lock(mutex);
+  Statistics statistics = counters;
+  statistics.entries = (int)entries.size();
+  statistics.entriesInUse = (int)std::count_if(
+      entries.begin(), entries.end(),
+      [](const Entry& entry) { return entry.sample.use_count() > 1; });
+  statistics.bytes = bytes;
+  statistics.budgetBytes = budget;
+  return statistics;
+}
+
+void SampleCache::writePrometheus(const Statistics& statistics, std::string& out) {
+  writeMetric(out, "daw_sample_cache_hits_total", "Sample loads served from the cache",
+              "counter", statistics.hits);
+  writeMetric(out, "daw_sample_cache_misses_total", "Sample loads which decoded a file",
+              "counter", statistics.misses);
+  writeMetric(out, "daw_sample_cache_evictions_total",
+              "Samples dropped to stay within the budget", "counter",
+              statistics.evictions);
+  writeMetric(out, "daw_sample_cache_failures_total",
+              "Sample loads of files which could not be decoded", "counter",
+              statistics.failures);
+  writeMetric(out, "daw_sample_cache_sidecar_loads_total",
+              "Sample loads served by mapping a sidecar file", "counter",
+              statistics.sidecarLoads);
+  writeMetric(out, "daw_sample_cache_sidecar_writes_total",
+              "Sidecar files written after decoding", "counter", statistics.sidecarWrites);
+  writeMetric(out, "daw_sample_cache_entries", "Decoded samples in the cache", "gauge",
+              (juce::uint64)statistics.entries);
+  writeMetric(out, "daw_sample_cache_bytes", "Memory held by decoded samples", "gauge",
+              statistics.bytes);
+  writeMetric(out, "daw_sample_cache_budget_bytes", "Memory budget of the cache",
+              "gauge", statistics.budgetBytes);
+}
+
+void SampleCache::evict(size_t targetBytes,
+                        std::vector<std::shared_ptr<const DecodedSample>>& released) {
+  // Oldest first; samples still held by a track stay
+  for (auto it = entries.end(); bytes > targetBytes && it != entries.begin();) {
+    --it;
+    if (it->sample.use_count() > 1) {
+      continue;
+    }
+    bytes -= it->sample->getSizeInBytes();
+    ++counters.evictions;
+    index.erase(it->key);
+    released.push_back(std::move(it->sample));
+    it = entries.erase(it);
+  }
+}
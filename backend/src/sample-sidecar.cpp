@@ -0,0 +1,176 @@
+#include "sample-sidecar.hpp"
+#include <climits>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr char kMagic[8] = {'D', 'A', 'W', 'F', 'L', 'O', 'A', 'T'};
+
+/** @brief Written as is, so it reads back differently in another byte order */
+constexpr juce::uint32 kByteOrderMark = 0x01020304;
+
+/** @brief Start of a sidecar, padded to kPageBytes in the file */
+struct Header {
+  char magic[8];
+  juce::uint32 version;
+  juce::uint32 byteOrder;
+  juce::uint32 numChannels;
+  juce::uint32 paddingFrames;
+  juce::int64 length;
+  /** @brief Frames from the start of a channel to the start of the next */
+  juce::int64 channelStride;
+  double sampleRate;
+  juce::int64 sourceSize;
+  /** @brief Milliseconds since the epoch */
+  juce::int64 sourceModificationTime;
+  juce::uint64 sourceHash;
+};
+
+static_assert(sizeof(Header) <= SampleSidecar::kPageBytes, "Header must fit a page");
+
+constexpr juce::uint64 kHashSeed = 14695981039346656037ull;
+
+juce::uint64 hashBytes(const void* data, size_t size, juce::uint64 hash) {
+  const auto* bytes = static_cast<const juce::uint8*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+/** @brief Channel length rounded up to whole pages, in frames */
+juce::int64 getChannelStride(juce::int64 length) {
+  constexpr auto framesPerPage = (juce::int64)(SampleSidecar::kPageBytes / sizeof(float));
+  const auto frames = length + DecodedSample::kPaddingFrames;
+  return (frames + framesPerPage - 1) / framesPerPage * framesPerPage;
+}
+
+/** @brief The source has the contents the sidecar was written from */
+bool isCurrent(const Header& header, const juce::File& source) {
+  if (!source.existsAsFile() || source.getSize() != header.sourceSize) {
+    return false;
+  }
+  // Same modification time: trusted without reading the source
+  return source.getLastModificationTime().toMilliseconds() ==
+             header.sourceModificationTime ||
+         SampleSidecar::hashFile(source) == header.sourceHash;
+}
+
+}  // namespace
+
+juce::File SampleSidecar::getFile(const juce::File& directory, const juce::File& source,
+                                  double sampleRate) {
+  const auto path = source.getFullPathName().toStdString();
+  return directory.getChildFile(
+      source.getFileNameWithoutExtension() + "-" +
+      juce::String::toHexString((juce::int64)hashBytes(path.data(), path.size(), kHashSeed)) +
+      "-" + juce::String(juce::roundToInt(sampleRate)) + ".f32");
+}
+
+std::shared_ptr<const DecodedSample> SampleSidecar::open(const juce::File& sidecar,
+                                                         const juce::File& source,
+                                                         double sampleRate) {
+  if (!sidecar.existsAsFile()) {
+    return nullptr;
+  }
+  auto mapping =
+      std::make_unique<juce::MemoryMappedFile>(sidecar, juce::MemoryMappedFile::readOnly);
+  if (mapping->getData() == nullptr || mapping->getSize() < kPageBytes) {
+    return nullptr;
+  }
+
+  Header header;
+  std::memcpy(&header, mapping->getData(), sizeof(header));
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion ||
+      header.byteOrder != kByteOrderMark || header.numChannels == 0 ||
+      header.numChannels > (juce::uint32)DecodedSample::kMaxChannels ||
+      header.paddingFrames != (juce::uint32)DecodedSample::kPaddingFrames ||
+      header.sampleRate != sampleRate || header.length < 0 ||
+      header.length > (juce::int64)(INT_MAX - DecodedSample::kPaddingFrames) ||
+      header.channelStride != getChannelStride(header.length) ||
+      mapping->getSize() != kPageBytes + (size_t)header.numChannels *
+                                             (size_t)header.channelStride *
+                                             sizeof(float) ||
+      !isCurrent(header, source)) {
+    return nullptr;
+  }
+
+  std::shared_ptr<DecodedSample> sample(new DecodedSample());
+  sample->numChannels = (int)header.numChannels;
+  sample->length = (int)header.length;
+  sample->sampleRate = header.sampleRate;
+  const auto* frames = static_cast<const char*>(mapping->getData()) + kPageBytes;
+  for (int channel = 0; channel < sample->numChannels; ++channel) {
+    sample->channels[(size_t)channel] = reinterpret_cast<const float*>(
+        frames + (size_t)channel * (size_t)header.channelStride * sizeof(float));
+  }
+
+  // Fault every page in now rather than on the audio thread
+  const auto* pages = static_cast<const volatile char*>(mapping->getData());
+  for (size_t offset = 0; offset < mapping->getSize(); offset += kPageBytes) {
+    (void)pages[offset];
+  }
+
+  sample->mapping = std::move(mapping);
+  return sample;
+}
+
+bool SampleSidecar::write(const juce::File& sidecar, const juce::File& source,
+                          const DecodedSample& sample) {
+  if (!source.existsAsFile() || !sidecar.getParentDirectory().createDirectory()) {
+    return false;
+  }
+
+  std::vector<char> page(kPageBytes, 0);
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byteOrder = kByteOrderMark;
+  header.numChannels = (juce::uint32)sample.getNumChannels();
+  header.paddingFrames = (juce::uint32)DecodedSample::kPaddingFrames;
+  header.length = sample.getLength();
+  header.channelStride = getChannelStride(header.length);
+  header.sampleRate = sample.getSampleRate();
+  header.sourceSize = source.getSize();
+  header.sourceModificationTime = source.getLastModificationTime().toMilliseconds();
+  header.sourceHash = hashFile(source);
+  std::memcpy(page.data(), &header, sizeof(header));
+
+  const auto temporary = sidecar.getSiblingFile(sidecar.getFileName() + ".tmp");
+  temporary.deleteFile();
+  bool written = false;
+  if (auto stream = temporary.createOutputStream()) {
+    // Frames and padding of each channel, then zeros up to the next page
+    const auto frameBytes =
+        (size_t)(header.length + DecodedSample::kPaddingFrames) * sizeof(float);
+    const std::vector<char> zeros(
+        (size_t)header.channelStride * sizeof(float) - frameBytes, 0);
+    written = stream->write(page.data(), page.size());
+    for (int channel = 0; written && channel < sample.getNumChannels(); ++channel) {
+      written = stream->write(sample.getReadPointer(channel), frameBytes) &&
+                (zeros.empty() || stream->write(zeros.data(), zeros.size()));
+    }
+    stream->flush();
+  }
+
+  if (!written || !temporary.moveFileTo(sidecar)) {
+    temporary.deleteFile();
+    return false;
+  }
+  return true;
+}
+
+juce::uint64 SampleSidecar::hashFile(const juce::File& file) {
+  auto stream = file.createInputStream();
+  if (stream == nullptr) {
+    return 0;
+  }
+  std::vector<char> chunk((size_t)1 << 16);
+  juce::uint64 hash = kHashSeed;
+  for (int read; (read = stream->read(chunk.data(), (int)chunk.size())) > 0;) {
+    hash = hashBytes(chunk.data(), (size_t)read, hash);
+  }
+  return hash;
+}
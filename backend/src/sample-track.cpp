@@ -0,0 +1,83 @@
+#include "sample-track.hpp"
+#include "audio-context.hpp"
+
+SampleTrack::SampleTrack(std::shared_ptr<SampleStream> stream,
+                         juce::int64 startSample)
+    : AudioTrack(),
+      stream(std::move(stream)),
+      startSample(startSample),
+      numOutputChannels(getOutputChannels(
+          this->stream != nullptr ? this->stream->getNumChannels() : 0)) {}
+
+SampleTrack::SampleTrack(std::shared_ptr<const DecodedSample> sample,
+                         juce::int64 startSample)
+    : AudioTrack(),
+      sample(std::move(sample)),
+      startSample(startSample),
+      numOutputChannels(getOutputChannels(
+          this->sample != nullptr ? this->sample->getNumChannels() : 0)) {}
+
+float SampleTrack::getSampleValue(const BeatContext& context) {
+  float values[2] = {0.0f, 0.0f};
+  float* outputs[2] = {&values[0], &values[1]};
+  read(context.sample - startSample, context.sampleRate, outputs, numOutputChannels, 1);
+  return values[0];
+}
+
+RenderActivity SampleTrack::renderBlock(juce::AudioBuffer<float>& buffer,
+                                        int startSample, int numSamples,
+                                        const BeatContext& context) {
+  float* outputs[2] = {buffer.getWritePointer(0, startSample), nullptr};
+  if (numOutputChannels > 1) {
+    outputs[1] = buffer.getWritePointer(1, startSample);
+  }
+  const juce::int64 frame = context.sample - this->startSample;
+  read(frame, context.sampleRate, outputs, numOutputChannels, numSamples);
+
+  // Still read outside the file: the stream prefetches its start
+  RenderActivity activity;
+  activity.start = (int)juce::jlimit<juce::int64>(0, numSamples, -frame);
+  activity.end = (int)juce::jlimit<juce::int64>(0, numSamples,
+                                                getLength(context.sampleRate) - frame);
+  return activity;
+}
+
+std::unique_ptr<AudioTrack> SampleTrack::clone() const {
+  std::unique_ptr<SampleTrack> copy;
+  if (stream != nullptr) {
+    copy = std::make_unique<SampleTrack>(
+        std::make_shared<SampleStream>(stream->getReaderFactory(),
+                                       AudioContext::getInstance().sampleRate,
+                                       SampleStream::kDefaultBufferFrames, nullptr),
+        startSample);
+  } else {
+    copy = std::make_unique<SampleTrack>(sample, startSample);
+  }
+  copy->copyMixSettings(*this);
+  return copy;
+}
+
+void SampleTrack::read(juce::int64 frame, double sampleRate, float* const* outputs,
+                       int numOutputs, int numFrames) {
+  // Reads continue while muted, so unmuting needs no seek
+  if (stream != nullptr) {
+    stream->read(frame, sampleRate, outputs, numOutputs, numFrames);
+  } else if (sample != nullptr) {
+    playhead.read(*sample, frame, sampleRate, outputs, numOutputs, numFrames);
+  } else {
+    for (int channel = 0; channel < numOutputs; ++channel) {
+      juce::FloatVectorOperations::clear(outputs[channel], numFrames);
+    }
+  }
+}
+
+juce::int64 SampleTrack::getLength(double sampleRate) const {
+  if (stream != nullptr) {
+    return stream->getLength(sampleRate);
+  }
+  return sample != nullptr ? sample->getLength(sampleRate) : 0;
+}
+
+int SampleTrack::getOutputChannels(int sourceChannels) {
+  return sourceChannels > 1 ? 2 : 1;
+}
@@ -0,0 +1,267 @@
+#include "synth-track.hpp"
+#include <algorithm>
+#include <cmath>
+#include "audio-context.hpp"
+#include "wave-table-simd.hpp"
+
+namespace {
+
+constexpr int kLanes = WaveTableSimd::kVoiceLanes;
+
+int roundUpToLanes(int numVoices) {
+  return (numVoices + kLanes - 1) / kLanes * kLanes;
+}
+
+}  // namespace
+
+SynthTrack::SynthTrack(int maxVoices, WaveTable::WaveType waveform)
+    : AudioTrack(),
+      maxVoices(juce::jlimit(1, kMaxVoices, maxVoices)),
+      waveform(waveform),
+      bank(&WaveTableBank::get(waveform)),
+      renderSampleRate(AudioContext::getInstance().sampleRate) {
+  adsr.attackTime = 0.005f;
+  adsr.decayTime = 0.1f;
+  adsr.sustainLevel = 0.7f;
+  adsr.releaseTime = 0.2f;
+
+  // Every slot the kernel reads, padding included, exists from here on:
+  // notes only move values around
+  const auto capacity = (size_t)roundUpToLanes(this->maxVoices);
+  positions.assign(capacity, 0.0f);
+  increments.assign(capacity, 0.0f);
+  gains.assign(capacity, 0.0f);
+  gainSteps.assign(capacity, 0.0f);
+  tableOffsets.assign(capacity, 0);
+  envelopes.assign(capacity, EnvelopeGenerator());
+  notes.assign(capacity, 0);
+  velocities.assign(capacity, 0.0f);
+  orders.assign(capacity, 0);
+  released.assign(capacity, false);
+  partials.assign((size_t)(WaveTableSimd::kChunkSize * kLanes), 0.0f);
+}
+
+float SynthTrack::getSampleValue(const BeatContext& context) {
+  if (context.sampleRate != renderSampleRate) {
+    setSampleRate(context.sampleRate);
+  }
+  float value = 0.0f;
+  render(&value, 1);
+  return value;
+}
+
+RenderActivity SynthTrack::renderBlock(juce::AudioBuffer<float>& buffer,
+                                       int startSample, int numSamples,
+                                       const BeatContext& context) {
+  if (context.sampleRate != renderSampleRate) {
+    setSampleRate(context.sampleRate);
+  }
+  return render(buffer.getWritePointer(0, startSample), numSamples);
+}
+
+RenderActivity SynthTrack::render(float* output, int numSamples) noexcept {
+  int rendered = 0;
+  while (rendered < numSamples && numActive > 0) {
+    const int count = std::min(WaveTableSimd::kChunkSize, numSamples - rendered);
+    renderChunk(output + rendered, count);
+    rendered += count;
+  }
+
+  std::fill(output + rendered, output + numSamples, 0.0f);
+  return {0, rendered};
+}
+
+void SynthTrack::renderChunk(float* output, int numSamples) noexcept {
+  // Envelopes at control rate: a linear gain ramp per voice and chunk
+  for (int voice = 0; voice < numActive; ++voice) {
+    auto& envelope = envelopes[(size_t)voice];
+    const float start = envelope.getValue() * velocities[(size_t)voice];
+    envelope.advance(numSamples);
+    const float end = envelope.getValue() * velocities[(size_t)voice];
+    gains[(size_t)voice] = start;
+    gainSteps[(size_t)voice] = (end - start) / (float)numSamples;
+  }
+
+  std::fill(partials.begin(), partials.begin() + numSamples * kLanes, 0.0f);
+
+  WaveTableSimd::VoiceJob job;
+  job.table = bank->getLevel(0);
+  job.tableSize = bank->getTableSize();
+  job.numVoices = roundUpToLanes(numActive);
+  job.numSamples = numSamples;
+  job.position = positions.data();
+  job.increment = increments.data();
+  job.gain = gains.data();
+  job.gainStep = gainSteps.data();
+  job.tableOffset = tableOffsets.data();
+  job.partials = partials.data();
+  WaveTableSimd::getBestKernels().voices(job);
+
+  // Lanes are added in a fixed order, so the output does not depend on
+  // the instruction set
+  for (int i = 0; i < numSamples; ++i) {
+    const float* lanes = partials.data() + i * kLanes;
+    float sum = 0.0f;
+    for (int lane = 0; lane < kLanes; ++lane) {
+      sum += lanes[lane];
+    }
+    output[i] = sum;
+  }
+
+  for (int voice = 0; voice < numActive; ++voice) {
+    positions[(size_t)voice] = WaveTableSimd::wrapPosition(
+        positions[(size_t)voice] + (float)numSamples * increments[(size_t)voice],
+        job.tableSize);
+  }
+
+  // Backwards, so the voice moved into a free slot was already checked
+  for (int voice = numActive - 1; voice >= 0; --voice) {
+    if (!envelopes[(size_t)voice].isActive()) {
+      removeVoice(voice);
+    }
+  }
+}
+
+void SynthTrack::noteOn(int note, float velocity) noexcept {
+  if (!(velocity > 0.0f)) {
+    noteOff(note);
+    return;
+  }
+
+  const int voice = allocateVoice();
+  const auto slot = (size_t)voice;
+  if (voice == numActive) {
+    // Free voice: starts at phase 0 from silence
+    ++numActive;
+    positions[slot] = 0.0f;
+    envelopes[slot].reset();
+  }
+
+  notes[slot] = juce::jlimit(0, 127, note);
+  velocities[slot] = std::min(velocity, 1.0f);
+  orders[slot] = nextOrder++;
+  released[slot] = false;
+
+  envelopes[slot].setParameters(adsr);
+  envelopes[slot].setSampleRate(renderSampleRate);
+  envelopes[slot].noteOn();
+  tune(voice);
+}
+
+void SynthTrack::noteOff(int note) noexcept {
+  for (int voice = 0; voice < numActive; ++voice) {
+    const auto slot = (size_t)voice;
+    if (notes[slot] == note && !released[slot]) {
+      envelopes[slot].noteOff();
+      released[slot] = true;
+    }
+  }
+}
+
+void SynthTrack::allNotesOff() noexcept {
+  for (int voice = 0; voice < numActive; ++voice) {
+    const auto slot = (size_t)voice;
+    if (!released[slot]) {
+      envelopes[slot].noteOff();
+      released[slot] = true;
+    }
+  }
+}
+
+int SynthTrack::allocateVoice() const noexcept {
+  if (numActive < maxVoices) {
+    return numActive;
+  }
+
+  int chosen = 0;
+  if (stealMode == StealMode::Oldest) {
+    for (int voice = 1; voice < numActive; ++voice) {
+      if (orders[(size_t)voice] < orders[(size_t)chosen]) {
+        chosen = voice;
+      }
+    }
+  } else {
+    float quietest = envelopes[0].getValue() * velocities[0];
+    for (int voice = 1; voice < numActive; ++voice) {
+      const float level =
+          envelopes[(size_t)voice].getValue() * velocities[(size_t)voice];
+      if (level < quietest) {
+        quietest = level;
+        chosen = voice;
+      }
+    }
+  }
+  return chosen;
+}
+
+void SynthTrack::tune(int voice) noexcept {
+  const auto slot = (size_t)voice;
+  const int tableSize = bank->getTableSize();
+  const double frequency = 440.0 * std::pow(2.0, (notes[slot] - 69) / 12.0);
+
+  // Table samples per output sample, at most Nyquist
+  const auto increment = (float)std::min(
+      frequency * (double)tableSize / renderSampleRate, 0.5 * (double)tableSize);
+  increments[slot] = increment;
+
+  // Lower level of the crossfade range: alias-free up to twice the
+  // increment, and constant for the note
+  const float radians =
+      increment * 2.0f * juce::MathConstants<float>::pi / (float)tableSize;
+  const auto level = (int)bank->getLevelForIncrement(radians);
+  tableOffsets[slot] = (int)(bank->getLevel(level) - bank->getLevel(0));
+}
+
+void SynthTrack::setSampleRate(double newSampleRate) noexcept {
+  renderSampleRate = newSampleRate;
+  for (int voice = 0; voice < numActive; ++voice) {
+    envelopes[(size_t)voice].setSampleRate(newSampleRate);
+    tune(voice);
+  }
+}
+
+void SynthTrack::removeVoice(int voice) noexcept {
+  const auto slot = (size_t)voice;
+  const auto last = (size_t)(numActive - 1);
+  if (slot != last) {
+    positions[slot] = positions[last];
+    increments[slot] = increments[last];
+    gains[slot] = gains[last];
+    gainSteps[slot] = gainSteps[last];
+    tableOffsets[slot] = tableOffsets[last];
+    envelopes[slot] = envelopes[last];
+    notes[slot] = notes[last];
+    velocities[slot] = velocities[last];
+    orders[slot] = orders[last];
+    released[slot] = released[last];
+  }
+
+  // The freed slot becomes silent padding
+  positions[last] = 0.0f;
+  increments[last] = 0.0f;
+  gains[last] = 0.0f;
+  gainSteps[last] = 0.0f;
+  tableOffsets[last] = 0;
+  envelopes[last].reset();
+  --numActive;
+}
+
+void SynthTrack::setADSRParameters(const ADSRParameters& params) {
+  adsr = params;
+}
+
+ADSRParameters SynthTrack::getADSRParameters() const {
+  return adsr;
+}
+
+std::unique_ptr<AudioTrack> SynthTrack::clone() const {
+  auto copy = std::make_unique<SynthTrack>(maxVoices, waveform);
+  copy->copySettings(*this);
+  return copy;
+}
+
+void SynthTrack::copySettings(const SynthTrack& other) {
+  copyMixSettings(other);
+  setADSRParameters(other.adsr);
+  setStealMode(other.stealMode);
+}
@@ -0,0 +1,210 @@
+#include "tempo-map.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+TempoMap::TempoMap(double bpm, double sampleRate) : sampleRate(sampleRate) {
+  tempoPoints.push_back({0.0, juce::jlimit(1.0, 1000.0, bpm), false});
+  timeSignatures.push_back({0, 4, 4});
+  rebuild();
+}
+
+void TempoMap::setTempo(double beat, double bpm, bool rampToNext) {
+  const TempoPoint point{std::max(0.0, beat), juce::jlimit(1.0, 1000.0, bpm),
+                         rampToNext};
+
+  auto it = std::lower_bound(
+      tempoPoints.begin(), tempoPoints.end(), point.beat,
+      [](const TempoPoint& existing, double b) { return existing.beat < b; });
+  if (it != tempoPoints.end() && it->beat == point.beat) {
+    *it = point;
+  } else {
+    tempoPoints.insert(it, point);
+  }
+  rebuild();
+}
+
+void TempoMap::setTimeSignature(juce::int64 bar, int numerator,
+                                int denominator) {
+  denominator = juce::jlimit(1, 64, denominator);
+  while (!juce::isPowerOfTwo(denominator)) {
+    --denominator;
+  }
+  const TimeSignature signature{std::max<juce::int64>(0, bar),
+                                std::max(1, numerator), denominator};
+
+  auto it = std::lower_bound(timeSignatures.begin(), timeSignatures.end(),
+                             signature.bar,
+                             [](const TimeSignature& existing, juce::int64 b) {
+                               return existing.bar < b;
+                             });
+  if (it != timeSignatures.end() && it->bar == signature.bar) {
+    *it = signature;
+  } else {
+    timeSignatures.insert(it, signature);
+  }
+  rebuild();
+}
+
+void TempoMap::setSampleRate(double newSampleRate) {
+  sampleRate = newSampleRate;
+  rebuild();
+}
+
+size_t TempoMap::findSegment(juce::int64 sample) const {
+  const auto it = std::upper_bound(
+      segments.begin(), segments.end(), sample,
+      [](juce::int64 s, const Segment& segment) {
+        return s < segment.firstSample;
+      });
+  return it == segments.begin() ? 0 : (size_t)(it - segments.begin()) - 1;
+}
+
+juce::int64 TempoMap::getSegmentEnd(size_t segment) const {
+  return segment + 1 < segments.size()
+             ? segments[segment + 1].firstSample
+             : std::numeric_limits<juce::int64>::max();
+}
+
+double TempoMap::getBeatAtSample(juce::int64 sample) const {
+  return getBeatInSegment(segments[findSegment(sample)], (double)sample);
+}
+
+double TempoMap::getSampleAtBeat(double beat) const {
+  const auto it = std::upper_bound(
+      segments.begin(), segments.end(), beat,
+      [](double b, const Segment& segment) { return b < segment.startBeat; });
+  const auto index =
+      it == segments.begin() ? 0 : (size_t)(it - segments.begin()) - 1;
+  return getSampleInSegment(segments[index], beat);
+}
+
+BeatContext TempoMap::getContext(juce::int64 sample) const {
+  return getContext(sample, findSegment(sample));
+}
+
+BeatContext TempoMap::getContext(juce::int64 sample, size_t segment) const {
+  const Segment& s = segments[segment];
+  const double offset = (double)sample - s.originSample;
+
+  BeatContext context;
+  context.sample = sample;
+  context.sampleRate = sampleRate;
+  context.beat = getBeatInSegment(s, (double)sample);
+  context.beatsPerSample = 1.0 / s.samplesPerBeat + s.acceleration * offset;
+  context.beatsPerSampleDelta = s.acceleration;
+  context.numerator = s.numerator;
+  context.denominator = s.denominator;
+  context.tempoMap = this;
+
+  const double beatsPerBar = context.getBeatsPerBar();
+  const double bars = std::floor((context.beat - s.signatureBeat) / beatsPerBar);
+  context.bar = s.signatureBar + (juce::int64)bars;
+  context.barStartBeat = s.signatureBeat + bars * beatsPerBar;
+  return context;
+}
+
+double TempoMap::getBeatInSegment(const Segment& segment, double sample) {
+  const double offset = sample - segment.originSample;
+  return segment.startBeat + offset / segment.samplesPerBeat +
+         0.5 * segment.acceleration * offset * offset;
+}
+
+double TempoMap::getSampleInSegment(const Segment& segment, double beat) {
+  const double beats = beat - segment.startBeat;
+  if (segment.acceleration == 0.0) {
+    // Exact for whole beats at round tempos (no reciprocal involved)
+    return segment.originSample + beats * segment.samplesPerBeat;
+  }
+
+  // Root of acceleration/2 * d^2 + d / samplesPerBeat - beats = 0, in the
+  // form that stays accurate when the acceleration is tiny
+  const double velocity = 1.0 / segment.samplesPerBeat;
+  const double discriminant =
+      std::max(0.0, velocity * velocity + 2.0 * segment.acceleration * beats);
+  return segment.originSample +
+         2.0 * beats / (velocity + std::sqrt(discriminant));
+}
+
+void TempoMap::rebuild() {
+  static std::atomic<juce::uint32> nextId{1};
+  id = nextId++;
+  segments.clear();
+
+  // Beat position of every time signature change
+  std::vector<double> signatureBeats(timeSignatures.size(), 0.0);
+  for (size_t i = 1; i < timeSignatures.size(); ++i) {
+    const auto& previous = timeSignatures[i - 1];
+    signatureBeats[i] = signatureBeats[i - 1] +
+                        (double)(timeSignatures[i].bar - previous.bar) *
+                            previous.numerator * 4.0 / previous.denominator;
+  }
+
+  // One segment per tempo point or signature change, in beat order
+  size_t tempoIndex = 0;
+  size_t signatureIndex = 0;
+  double beat = 0.0;
+
+  for (;;) {
+    while (tempoIndex + 1 < tempoPoints.size() &&
+           tempoPoints[tempoIndex + 1].beat <= beat) {
+      ++tempoIndex;
+    }
+    while (signatureIndex + 1 < timeSignatures.size() &&
+           signatureBeats[signatureIndex + 1] <= beat) {
+      ++signatureIndex;
+    }
+
+    const auto& point = tempoPoints[tempoIndex];
+    const auto& signature = timeSignatures[signatureIndex];
+
+    Segment segment;
+    segment.startBeat = beat;
+
+    if (segments.empty()) {
+      segment.originSample = 0.0;
+    } else {
+      segment.originSample = getSampleInSegment(segments.back(), beat);
+    }
+
+    if (segments.empty() || point.beat == beat) {
+      segment.samplesPerBeat = 60.0 * sampleRate / point.bpm;
+    } else {
+      // Signature change in the middle of a tempo span: continue its tempo
+      const Segment& previous = segments.back();
+      const double offset = segment.originSample - previous.originSample;
+      segment.samplesPerBeat =
+          1.0 / (1.0 / previous.samplesPerBeat + previous.acceleration * offset);
+    }
+
+    if (point.rampToNext && tempoIndex + 1 < tempoPoints.size()) {
+      // Tempo linear in time: v(n) = v0 + a * n covers the span when
+      // a = (v1^2 - v0^2) / (2 * beats)
+      const auto& next = tempoPoints[tempoIndex + 1];
+      const double from = point.bpm / (60.0 * sampleRate);
+      const double to = next.bpm / (60.0 * sampleRate);
+      segment.acceleration =
+          (to * to - from * from) / (2.0 * (next.beat - point.beat));
+    }
+
+    segment.firstSample = (juce::int64)std::ceil(segment.originSample);
+    segment.numerator = signature.numerator;
+    segment.denominator = signature.denominator;
+    segment.signatureBar = signature.bar;
+    segment.signatureBeat = signatureBeats[signatureIndex];
+    segments.push_back(segment);
+
+    double next = std::numeric_limits<double>::infinity();
+    if (tempoIndex + 1 < tempoPoints.size()) {
+      next = tempoPoints[tempoIndex + 1].beat;
+    }
+    if (signatureIndex + 1 < timeSignatures.size()) {
+      next = std::min(next, signatureBeats[signatureIndex + 1]);
+    }
+    if (std::isinf(next)) {
+      break;
+    }
+    beat = next;
+  }
+}
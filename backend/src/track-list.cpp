@@ -0,0 +1,258 @@
+#include "track-list.hpp"
+#include <algorithm>
+
+namespace {
+
+using BufferPool = std::shared_ptr<std::vector<juce::AudioBuffer<float>>>;
+
+/** @brief Stereo buffers of blockSize samples, at least required of them,
+ * reusing the previous pool if it is large enough */
+BufferPool assignBuffers(const BufferPool& previous, size_t required, int blockSize) {
+  const bool reusable = previous != nullptr && !previous->empty() &&
+                        previous->front().getNumSamples() == blockSize;
+
+  if (reusable && previous->size() >= required) {
+    return previous;
+  }
+
+  // Grow geometrically so that adding tracks one by one stays cheap
+  const size_t capacity =
+      std::max<size_t>({required, reusable ? previous->size() * 2 : 0, 8});
+
+  auto buffers = std::make_shared<std::vector<juce::AudioBuffer<float>>>();
+  buffers->reserve(capacity);
+  for (size_t i = 0; i < capacity; ++i) {
+    buffers->emplace_back(2, blockSize);
+  }
+  return buffers;
+}
+
+}  // namespace
+
+TrackListPublisher::TrackListPublisher() : current(new TrackList()) {
+  current.load()->tempoMap = std::make_shared<TempoMap>();
+  current.load()->plan = graph.compile();
+}
+
+TrackListPublisher::~TrackListPublisher() {
+  delete current.load();
+}
+
+size_t TrackListPublisher::addTrack(std::shared_ptr<AudioTrack> track) {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+
+  auto next = std::make_unique<TrackList>(*current.load());
+  next->tracks.push_back(std::move(track));
+  const size_t index = next->tracks.size() - 1;
+  graph.addTrack();
+  next->plan = graph.compile();
+
+  publish(std::move(next));
+  return index;
+}
+
+bool TrackListPublisher::removeTrack(size_t index) {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+
+  const TrackList* list = current.load();
+  if (index >= list->tracks.size()) {
+    return false;
+  }
+
+  auto next = std::make_unique<TrackList>(*list);
+  next->tracks.erase(next->tracks.begin() + (std::ptrdiff_t)index);
+  graph.removeTrack((int)index);
+  next->plan = graph.compile();
+
+  publish(std::move(next));
+  return true;
+}
+
+std::shared_ptr<AudioTrack> TrackListPublisher::getTrack(size_t index) const {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+
+  const TrackList* list = current.load();
+  return index < list->tracks.size() ? list->tracks[index] : nullptr;
+}
+
+std::vector<std::shared_ptr<AudioTrack>> TrackListPublisher::getTracks()
+    const {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+  return current.load()->tracks;
+}
+
+void TrackListPublisher::setTempoMap(std::shared_ptr<const TempoMap> map) {
+  if (map == nullptr) {
+    return;
+  }
+
+  const std::lock_guard<std::mutex> lock(writerMutex);
+
+  auto next = std::make_unique<TrackList>(*current.load());
+  next->tempoMap = std::move(map);
+  publish(std::move(next));
+}
+
+std::shared_ptr<const TempoMap> TrackListPublisher::getTempoMap() const {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+  return current.load()->tempoMap;
+}
+
+bool TrackListPublisher::editGraph(const std::function<bool(MixGraph&)>& edit) {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+
+  MixGraph edited = graph;
+  if (!edit(edited)) {
+    return false;
+  }
+  edited.resizeTracks((int)current.load()->tracks.size());
+  graph = std::move(edited);
+
+  auto next = std::make_unique<TrackList>(*current.load());
+  next->plan = graph.compile();
+  publish(std::move(next));
+  return true;
+}
+
+MixGraph TrackListPublisher::getGraph() const {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+  return graph;
+}
+
+int TrackListPublisher::getLatencySamples() const {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+  return current.load()->plan->latency;
+}
+
+bool TrackListPublisher::refreshLatency() {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+
+  // Same routing: only the delays are recomputed
+  const auto& published = *current.load()->plan;
+  auto plan = std::make_shared<MixPlan>(published);
+  plan->compensateLatency();
+  if (plan->latency == published.latency &&
+      plan->compensations == published.compensations) {
+    return false;
+  }
+
+  auto next = std::make_unique<TrackList>(*current.load());
+  next->plan = std::move(plan);
+  publish(std::move(next));
+  return true;
+}
+
+void TrackListPublisher::setRenderBlockSize(int numSamples) {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+
+  renderBlockSize = std::max(0, numSamples);
+
+  // Effects were prepared for the new rate: their tails are recompiled
+  auto next = std::make_unique<TrackList>();
+  next->tracks = current.load()->tracks;
+  next->tempoMap = current.load()->tempoMap;
+  next->plan = graph.compile();
+  publish(std::move(next));
+}
+
+size_t TrackListPublisher::getTrackCount() const {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+  return current.load()->tracks.size();
+}
+
+void TrackListPublisher::collectGarbage() {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+  reclaim();
+}
+
+size_t TrackListPublisher::getPendingReclaimCount() const {
+  const std::lock_guard<std::mutex> lock(writerMutex);
+  return retired.size();
+}
+
+const TrackList* TrackListPublisher::beginRead() noexcept {
+  // Both operations are sequentially consistent: a writer that reads an even
+  // sequence after its swap is guaranteed that the next block sees the new
+  // list.
+  readSequence.fetch_add(1);
+  return current.load();
+}
+
+void TrackListPublisher::endRead() noexcept {
+  readSequence.fetch_add(1, std::memory_order_release);
+}
+
+void TrackListPublisher::publish(std::unique_ptr<TrackList> next) {
+  assignRenderBuffers(*next, current.load());
+  assignBusBuffers(*next, current.load());
+  assignDelays(*next, current.load());
+
+  TrackList* previous = current.exchange(next.release());
+  const uint64_t sequence = readSequence.load();
+
+  retired.push_back({std::unique_ptr<TrackList>(previous), sequence});
+  reclaim();
+}
+
+void TrackListPublisher::reclaim() {
+  const uint64_t sequence = readSequence.load(std::memory_order_acquire);
+
+  // A list retired while no block was running (even sequence) is already
+  // unreachable. Otherwise the block running at swap time must have ended.
+  retired.erase(std::remove_if(retired.begin(), retired.end(),
+                               [sequence](const RetiredList& entry) {
+                                 return (entry.readSequence & 1u) == 0 ||
+                                        sequence != entry.readSequence;
+                               }),
+                retired.end());
+}
+
+void TrackListPublisher::assignRenderBuffers(TrackList& next,
+                                             const TrackList* previous) const {
+  if (renderBlockSize == 0) {
+    next.renderBuffers.reset();
+    return;
+  }
+
+  next.renderBuffers =
+      assignBuffers(previous != nullptr ? previous->renderBuffers : nullptr,
+                    next.tracks.size(), renderBlockSize);
+}
+
+void TrackListPublisher::assignBusBuffers(TrackList& next,
+                                          const TrackList* previous) const {
+  if (renderBlockSize == 0) {
+    next.busBuffers.reset();
+    return;
+  }
+
+  next.busBuffers =
+      assignBuffers(previous != nullptr ? previous->busBuffers : nullptr,
+                    (size_t)next.plan->numBuffers, renderBlockSize);
+}
+
+void TrackListPublisher::assignDelays(TrackList& next, const TrackList* previous) const {
+  const auto& compensations = next.plan->compensations;
+  next.delays.clear();
+  if (renderBlockSize == 0) {
+    return;
+  }
+
+  next.delays.reserve(compensations.size());
+  for (const auto& compensation : compensations) {
+    std::shared_ptr<CompensationDelay> line;
+    if (previous != nullptr) {
+      // Same path, same delay: the line carries on with what it holds
+      const auto& before = previous->plan->compensations;
+      const auto found = std::find(before.begin(), before.end(), compensation);
+      const auto index = (size_t)(found - before.begin());
+      if (found != before.end() && index < previous->delays.size() &&
+          previous->delays[index]->getMaxBlockSize() == renderBlockSize) {
+        line = previous->delays[index];
+      }
+    }
+    next.delays.push_back(line != nullptr ? std::move(line)
+                                          : std::make_shared<CompensationDelay>(
+                                                compensation.samples, renderBlockSize));
+  }
+}
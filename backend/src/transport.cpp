@@ -0,0 +1,20 @@
+#include "transport.hpp"
+#include <algorithm>
+
+BeatContext Transport::getContext(const TempoMap& map, int& numSamples) {
+  const auto& segments = map.getSegments();
+
+  // Seek or new map: search. Otherwise playback only ever moves forward.
+  if (map.getId() != mapId || segment >= segments.size() ||
+      position < segments[segment].firstSample) {
+    mapId = map.getId();
+    segment = map.findSegment(position);
+  }
+  while (position >= map.getSegmentEnd(segment)) {
+    ++segment;
+  }
+
+  numSamples = (int)std::min<juce::int64>(numSamples,
+                                          map.getSegmentEnd(segment) - position);
+  return map.getContext(position, segment);
+}
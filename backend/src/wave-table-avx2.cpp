@@ -0,0 +1,134 @@
+#include <immintrin.h>
+#include <cstring>
+#include "wave-table-simd.hpp"
+
+// AVX2 kernels, 8 lanes with hardware gathers. Built with -mavx2 and only
+// called after runtime detection.
+
+namespace WaveTableSimd {
+
+namespace {
+
+template <bool Linear>
+void renderChunk(const BlockJob& job, float base, const float* modulation,
+                 float* output) {
+  const __m256 size = _mm256_set1_ps((float)job.tableSize);
+  const __m256 inverseSize = _mm256_set1_ps(1.0f / (float)job.tableSize);
+  const __m256i sizeInt = _mm256_set1_epi32(job.tableSize);
+  const __m256i lastIndex = _mm256_set1_epi32(job.tableSize - 1);
+  const __m256 increment = _mm256_set1_ps(job.increment);
+  const __m256 baseVector = _mm256_set1_ps(base);
+
+  for (int group = 0; group < kChunkSize; group += 8) {
+    const __m256 lanes = _mm256_add_ps(
+        _mm256_set1_ps((float)group),
+        _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+    __m256 position =
+        _mm256_add_ps(baseVector, _mm256_mul_ps(lanes, increment));
+    if (modulation != nullptr) {
+      position = _mm256_add_ps(
+          position, _mm256_mul_ps(_mm256_loadu_ps(modulation + group),
+                                  _mm256_set1_ps(job.modulationScale)));
+    }
+
+    const __m256 wrapped = _mm256_sub_ps(
+        position,
+        _mm256_mul_ps(_mm256_floor_ps(_mm256_mul_ps(position, inverseSize)),
+                      size));
+    const __m256 floored = _mm256_floor_ps(wrapped);
+
+    __m256i index = _mm256_cvttps_epi32(floored);
+    index = _mm256_add_epi32(
+        index, _mm256_and_si256(
+                   _mm256_cmpgt_epi32(_mm256_setzero_si256(), index), sizeInt));
+    index = _mm256_sub_epi32(
+        index, _mm256_and_si256(_mm256_cmpgt_epi32(index, lastIndex), sizeInt));
+
+    const __m256 a = _mm256_i32gather_ps(job.table, index, 4);
+    if constexpr (Linear) {
+      const __m256 b = _mm256_i32gather_ps(job.table + 1, index, 4);
+      const __m256 frac = _mm256_sub_ps(wrapped, floored);
+      _mm256_storeu_ps(output + group,
+                       _mm256_add_ps(a, _mm256_mul_ps(frac, _mm256_sub_ps(b, a))));
+    } else {
+      _mm256_storeu_ps(output + group, a);
+    }
+  }
+}
+
+template <bool Linear>
+float renderAvx2(const BlockJob& job) {
+  float base = job.position;
+
+  for (int start = 0; start < job.numSamples; start += kChunkSize) {
+    const int count = job.numSamples - start < kChunkSize
+                          ? job.numSamples - start
+                          : kChunkSize;
+    const float* modulation =
+        job.phaseModulation != nullptr ? job.phaseModulation + start : nullptr;
+
+    if (count == kChunkSize) {
+      renderChunk<Linear>(job, base, modulation, job.output + start);
+    } else {
+      // Partial last chunk: run the same vector code on padded copies
+      float paddedModulation[kChunkSize] = {};
+      float paddedOutput[kChunkSize];
+      if (modulation != nullptr) {
+        std::memcpy(paddedModulation, modulation, sizeof(float) * (size_t)count);
+      }
+      renderChunk<Linear>(job, base,
+                          modulation != nullptr ? paddedModulation : nullptr,
+                          paddedOutput);
+      std::memcpy(job.output + start, paddedOutput, sizeof(float) * (size_t)count);
+    }
+
+    base = wrapPosition(base + (float)count * job.increment, job.tableSize);
+  }
+
+  return base;
+}
+
+void mixVoicesAvx2(const VoiceJob& job) {
+  const __m256i mask = _mm256_set1_epi32(job.tableSize - 1);
+
+  for (int first = 0; first < job.numVoices; first += kVoiceLanes) {
+    for (int group = 0; group < kVoiceLanes; group += 8) {
+      const int voice = first + group;
+      const __m256 start = _mm256_loadu_ps(job.position + voice);
+      const __m256 increment = _mm256_loadu_ps(job.increment + voice);
+      const __m256 gain = _mm256_loadu_ps(job.gain + voice);
+      const __m256 gainStep = _mm256_loadu_ps(job.gainStep + voice);
+      const __m256i offset = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(job.tableOffset + voice));
+
+      for (int i = 0; i < job.numSamples; ++i) {
+        const __m256 sample = _mm256_set1_ps((float)i);
+        const __m256 position =
+            _mm256_add_ps(start, _mm256_mul_ps(sample, increment));
+        // Positions stay below 17 tables: truncation is floor()
+        const __m256i whole = _mm256_cvttps_epi32(position);
+        const __m256 frac = _mm256_sub_ps(position, _mm256_cvtepi32_ps(whole));
+        const __m256i index =
+            _mm256_add_epi32(offset, _mm256_and_si256(whole, mask));
+
+        const __m256 a = _mm256_i32gather_ps(job.table, index, 4);
+        const __m256 b = _mm256_i32gather_ps(job.table + 1, index, 4);
+        const __m256 value =
+            _mm256_add_ps(a, _mm256_mul_ps(frac, _mm256_sub_ps(b, a)));
+        const __m256 ramp = _mm256_add_ps(gain, _mm256_mul_ps(sample, gainStep));
+
+        float* partials = job.partials + i * kVoiceLanes + group;
+        _mm256_storeu_ps(partials, _mm256_add_ps(_mm256_loadu_ps(partials),
+                                                 _mm256_mul_ps(ramp, value)));
+      }
+    }
+  }
+}
+
+}  // namespace
+
+Kernels getAvx2Kernels() {
+  return {&renderAvx2<true>, &renderAvx2<false>, &mixVoicesAvx2};
+}
+
+}  // namespace WaveTableSimd
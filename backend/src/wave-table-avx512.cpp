@@ -0,0 +1,128 @@
+#include <immintrin.h>
+#include <cstring>
+#include "wave-table-simd.hpp"
+
+// AVX-512F kernels, a whole chunk per vector. Built with -mavx512f and only
+// called after runtime detection.
+
+namespace WaveTableSimd {
+
+namespace {
+
+static_assert(kChunkSize == 16, "One AVX-512 vector per chunk");
+
+inline __m512 floorPs(__m512 x) {
+  return _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+}
+
+template <bool Linear>
+void renderChunk(const BlockJob& job, float base, const float* modulation,
+                 float* output) {
+  const __m512 size = _mm512_set1_ps((float)job.tableSize);
+  const __m512 inverseSize = _mm512_set1_ps(1.0f / (float)job.tableSize);
+  const __m512i sizeInt = _mm512_set1_epi32(job.tableSize);
+  const __m512 lanes =
+      _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f,
+                     9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+
+  __m512 position = _mm512_add_ps(
+      _mm512_set1_ps(base), _mm512_mul_ps(lanes, _mm512_set1_ps(job.increment)));
+  if (modulation != nullptr) {
+    position = _mm512_add_ps(position,
+                             _mm512_mul_ps(_mm512_loadu_ps(modulation),
+                                           _mm512_set1_ps(job.modulationScale)));
+  }
+
+  const __m512 wrapped = _mm512_sub_ps(
+      position, _mm512_mul_ps(floorPs(_mm512_mul_ps(position, inverseSize)), size));
+  const __m512 floored = floorPs(wrapped);
+
+  __m512i index = _mm512_cvttps_epi32(floored);
+  index = _mm512_mask_add_epi32(
+      index, _mm512_cmplt_epi32_mask(index, _mm512_setzero_si512()), index,
+      sizeInt);
+  index = _mm512_mask_sub_epi32(index, _mm512_cmpge_epi32_mask(index, sizeInt),
+                                index, sizeInt);
+
+  const __m512 a = _mm512_i32gather_ps(index, job.table, 4);
+  if constexpr (Linear) {
+    const __m512 b = _mm512_i32gather_ps(index, job.table + 1, 4);
+    const __m512 frac = _mm512_sub_ps(wrapped, floored);
+    _mm512_storeu_ps(output, _mm512_add_ps(a, _mm512_mul_ps(frac, _mm512_sub_ps(b, a))));
+  } else {
+    _mm512_storeu_ps(output, a);
+  }
+}
+
+template <bool Linear>
+float renderAvx512(const BlockJob& job) {
+  float base = job.position;
+
+  for (int start = 0; start < job.numSamples; start += kChunkSize) {
+    const int count = job.numSamples - start < kChunkSize
+                          ? job.numSamples - start
+                          : kChunkSize;
+    const float* modulation =
+        job.phaseModulation != nullptr ? job.phaseModulation + start : nullptr;
+
+    if (count == kChunkSize) {
+      renderChunk<Linear>(job, base, modulation, job.output + start);
+    } else {
+      // Partial last chunk: run the same vector code on padded copies
+      float paddedModulation[kChunkSize] = {};
+      float paddedOutput[kChunkSize];
+      if (modulation != nullptr) {
+        std::memcpy(paddedModulation, modulation, sizeof(float) * (size_t)count);
+      }
+      renderChunk<Linear>(job, base,
+                          modulation != nullptr ? paddedModulation : nullptr,
+                          paddedOutput);
+      std::memcpy(job.output + start, paddedOutput, sizeof(float) * (size_t)count);
+    }
+
+    base = wrapPosition(base + (float)count * job.increment, job.tableSize);
+  }
+
+  return base;
+}
+
+void mixVoicesAvx512(const VoiceJob& job) {
+  const __m512i mask = _mm512_set1_epi32(job.tableSize - 1);
+
+  for (int voice = 0; voice < job.numVoices; voice += kVoiceLanes) {
+    const __m512 start = _mm512_loadu_ps(job.position + voice);
+    const __m512 increment = _mm512_loadu_ps(job.increment + voice);
+    const __m512 gain = _mm512_loadu_ps(job.gain + voice);
+    const __m512 gainStep = _mm512_loadu_ps(job.gainStep + voice);
+    const __m512i offset = _mm512_loadu_si512(job.tableOffset + voice);
+
+    for (int i = 0; i < job.numSamples; ++i) {
+      const __m512 sample = _mm512_set1_ps((float)i);
+      const __m512 position =
+          _mm512_add_ps(start, _mm512_mul_ps(sample, increment));
+      // Positions stay below 17 tables: truncation is floor()
+      const __m512i whole = _mm512_cvttps_epi32(position);
+      const __m512 frac = _mm512_sub_ps(position, _mm512_cvtepi32_ps(whole));
+      const __m512i index =
+          _mm512_add_epi32(offset, _mm512_and_si512(whole, mask));
+
+      const __m512 a = _mm512_i32gather_ps(index, job.table, 4);
+      const __m512 b = _mm512_i32gather_ps(index, job.table + 1, 4);
+      const __m512 value =
+          _mm512_add_ps(a, _mm512_mul_ps(frac, _mm512_sub_ps(b, a)));
+      const __m512 ramp = _mm512_add_ps(gain, _mm512_mul_ps(sample, gainStep));
+
+      float* partials = job.partials + i * kVoiceLanes;
+      _mm512_storeu_ps(partials, _mm512_add_ps(_mm512_loadu_ps(partials),
+                                               _mm512_mul_ps(ramp, value)));
+    }
+  }
+}
+
+}  // namespace
+
+Kernels getAvx512Kernels() {
+  return {&renderAvx512<true>, &renderAvx512<false>, &mixVoicesAvx512};
+}
+
+}  // namespace WaveTableSimd
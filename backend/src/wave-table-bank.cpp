@@ -0,0 +1,209 @@
+#include "wave-table-bank.hpp"
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <algorithm>
+#include <cmath>
+#include <new>
+#include <vector>
+
+namespace {
+
+constexpr size_t kCacheLineBytes = 64;
+constexpr size_t kFloatsPerCacheLine = kCacheLineBytes / sizeof(float);
+
+// Crossfade scratch size, a multiple of the kernel chunk size so that split
+// rendering reproduces a single kernel call exactly
+constexpr int kScratchSize = 256;
+static_assert(kScratchSize % WaveTableSimd::kChunkSize == 0,
+              "Scratch must hold whole kernel chunks");
+
+// Fourier coefficient of harmonic h, as a sine (or cosine) amplitude
+double getHarmonicAmplitude(WaveTable::WaveType type, int harmonic) {
+  const double pi = juce::MathConstants<double>::pi;
+  const bool odd = (harmonic & 1) != 0;
+
+  switch (type) {
+    case WaveTable::WaveType::SINE:
+      return harmonic == 1 ? 1.0 : 0.0;
+    case WaveTable::WaveType::SQUARE:
+      return odd ? 4.0 / (pi * harmonic) : 0.0;
+    case WaveTable::WaveType::SAW:
+      return -2.0 / (pi * harmonic);
+    case WaveTable::WaveType::TRIANGLE:
+      return odd ? -8.0 / (pi * pi * harmonic * harmonic) : 0.0;
+  }
+  return 0.0;
+}
+
+}  // namespace
+
+void WaveTableBank::AlignedDeleter::operator()(float* data) const {
+  ::operator delete[](data, std::align_val_t(kCacheLineBytes));
+}
+
+WaveTableBank::WaveTableBank(WaveTable::WaveType type, int size)
+    : tableSize(size),
+      numLevels(0),
+      maxLevel(0),
+      levelStride(0),
+      phaseToIndex((float)size / (2.0f * juce::MathConstants<float>::pi)) {
+  jassert(juce::isPowerOfTwo(tableSize) && tableSize >= 8);
+
+  // Halve the harmonics per level until only the fundamental is left
+  while ((tableSize >> (numLevels + 2)) >= 1) {
+    ++numLevels;
+  }
+
+  levelStride = ((size_t)tableSize + 1 + kFloatsPerCacheLine - 1) /
+                kFloatsPerCacheLine * kFloatsPerCacheLine;
+
+  const size_t bytes = levelStride * (size_t)numLevels * sizeof(float);
+  storage.reset(static_cast<float*>(
+      ::operator new[](bytes, std::align_val_t(kCacheLineBytes))));
+
+  build(type);
+}
+
+WaveTableBank::~WaveTableBank() = default;
+
+const WaveTableBank& WaveTableBank::get(WaveTable::WaveType type) {
+  switch (type) {
+    case WaveTable::WaveType::SQUARE: {
+      static const WaveTableBank square(WaveTable::WaveType::SQUARE);
+      return square;
+    }
+    case WaveTable::WaveType::SAW: {
+      static const WaveTableBank saw(WaveTable::WaveType::SAW);
+      return saw;
+    }
+    case WaveTable::WaveType::TRIANGLE: {
+      static const WaveTableBank triangle(WaveTable::WaveType::TRIANGLE);
+      return triangle;
+    }
+    case WaveTable::WaveType::SINE:
+    default: {
+      static const WaveTableBank sine(WaveTable::WaveType::SINE);
+      return sine;
+    }
+  }
+}
+
+void WaveTableBank::build(WaveTable::WaveType type) {
+  const size_t mask = (size_t)tableSize - 1;
+  const size_t quarter = (size_t)tableSize / 4;
+
+  // sin(2πhi/N) is sine[(h * i) mod N]: exact and cheap
+  std::vector<double> sine((size_t)tableSize);
+  for (int i = 0; i < tableSize; ++i) {
+    sine[(size_t)i] =
+        std::sin(2.0 * juce::MathConstants<double>::pi * i / tableSize);
+  }
+
+  // Walk from the top level (fundamental only) down to level 0, adding the
+  // harmonics each level gains over the next one
+  std::vector<double> sum((size_t)tableSize, 0.0);
+  int harmonicsDone = 0;
+  maxLevel = numLevels - 1;
+
+  for (int level = numLevels - 1; level >= 0; --level) {
+    const int harmonics = getNumHarmonics(level);
+    bool changed = false;
+
+    for (int h = harmonicsDone + 1; h <= harmonics; ++h) {
+      const double amplitude = getHarmonicAmplitude(type, h);
+      if (amplitude == 0.0) {
+        continue;
+      }
+      changed = true;
+
+      // Triangle is a cosine series
+      const size_t offset =
+          type == WaveTable::WaveType::TRIANGLE ? quarter : 0;
+      for (int i = 0; i < tableSize; ++i) {
+        sum[(size_t)i] += amplitude * sine[((size_t)h * (size_t)i + offset) & mask];
+      }
+    }
+    harmonicsDone = harmonics;
+
+    // Identical to the level above (e.g. a sine): never crossfade towards it
+    if (!changed && maxLevel == level + 1) {
+      maxLevel = level;
+    }
+
+    float* table = storage.get() + (size_t)level * levelStride;
+    for (int i = 0; i < tableSize; ++i) {
+      table[i] = (float)sum[(size_t)i];
+    }
+    table[tableSize] = table[0];
+  }
+}
+
+float WaveTableBank::getLevelForIncrement(float phaseIncrement) const {
+  const float increment = std::abs(phaseIncrement) * phaseToIndex;
+  if (!(increment > 1.0f)) {
+    return 0.0f;
+  }
+  return std::min(std::log2(increment), (float)maxLevel);
+}
+
+float WaveTableBank::getSample(float phase, float phaseIncrement) const {
+  const float level = getLevelForIncrement(phaseIncrement);
+  const int first = (int)level;
+  const float mix = level - (float)first;
+
+  const float index = WaveTableSimd::wrapPosition(phase * phaseToIndex, tableSize);
+  const auto index0 = (int)index;
+  const float frac = index - (float)index0;
+
+  const auto lookup = [index0, frac](const float* table) {
+    return table[index0] + frac * (table[index0 + 1] - table[index0]);
+  };
+
+  const float sample = lookup(getLevel(first));
+  if (mix <= 0.0f) {
+    return sample;
+  }
+  return sample + mix * (lookup(getLevel(first + 1)) - sample);
+}
+
+float WaveTableBank::renderBlock(float* output, int numSamples, float phase,
+                                 float phaseIncrement) const {
+  const float level = getLevelForIncrement(phaseIncrement);
+  const int first = (int)level;
+  const float mix = level - (float)first;
+  const auto& kernels = WaveTableSimd::getBestKernels();
+
+  WaveTableSimd::BlockJob job;
+  job.table = getLevel(first);
+  job.tableSize = tableSize;
+  job.output = output;
+  job.phaseModulation = nullptr;
+  job.modulationScale = phaseToIndex;
+  job.numSamples = numSamples;
+  job.position = WaveTableSimd::wrapPosition(phase * phaseToIndex, tableSize);
+  job.increment = phaseIncrement * phaseToIndex;
+
+  if (mix <= 0.0f) {
+    return kernels.linear(job) / phaseToIndex;
+  }
+
+  // Crossfade towards the next level, a scratch-sized piece at a time
+  float scratch[kScratchSize];
+  for (int start = 0; start < numSamples; start += kScratchSize) {
+    const int count = std::min(kScratchSize, numSamples - start);
+
+    job.numSamples = count;
+    job.table = getLevel(first + 1);
+    job.output = scratch;
+    kernels.linear(job);
+
+    job.table = getLevel(first);
+    job.output = output + start;
+    job.position = kernels.linear(job);
+
+    juce::FloatVectorOperations::multiply(output + start, 1.0f - mix, count);
+    juce::FloatVectorOperations::addWithMultiply(output + start, scratch, mix,
+                                                 count);
+  }
+
+  return job.position / phaseToIndex;
+}
@@ -0,0 +1,160 @@
+#include "wave-table-simd.hpp"
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <cmath>
+
+#ifndef DAW_ENABLE_SIMD
+#define DAW_ENABLE_SIMD 0
+#endif
+
+namespace WaveTableSimd {
+
+namespace {
+
+template <bool Linear>
+float lookup(const float* table, int tableSize, float position) {
+  const float size = (float)tableSize;
+  const float wrapped = position - std::floor(position * (1.0f / size)) * size;
+
+  // Rounding can leave wrapped a hair below 0 or at tableSize
+  const float floored = std::floor(wrapped);
+  int index = (int)floored;
+  if (index < 0) {
+    index += tableSize;
+  } else if (index >= tableSize) {
+    index -= tableSize;
+  }
+
+  if constexpr (Linear) {
+    const float frac = wrapped - floored;
+    return table[index] + frac * (table[index + 1] - table[index]);
+  } else {
+    return table[index];
+  }
+}
+
+template <bool Linear>
+float renderScalar(const BlockJob& job) {
+  float base = job.position;
+
+  for (int start = 0; start < job.numSamples; start += kChunkSize) {
+    const int count = std::min(kChunkSize, job.numSamples - start);
+
+    for (int lane = 0; lane < count; ++lane) {
+      float position = base + (float)lane * job.increment;
+      if (job.phaseModulation != nullptr) {
+        position = position + job.phaseModulation[start + lane] * job.modulationScale;
+      }
+      job.output[start + lane] = lookup<Linear>(job.table, job.tableSize, position);
+    }
+
+    base = wrapPosition(base + (float)count * job.increment, job.tableSize);
+  }
+
+  return base;
+}
+
+void mixVoicesScalar(const VoiceJob& job) {
+  const int mask = job.tableSize - 1;
+
+  for (int first = 0; first < job.numVoices; first += kVoiceLanes) {
+    for (int i = 0; i < job.numSamples; ++i) {
+      float* partials = job.partials + i * kVoiceLanes;
+
+      for (int lane = 0; lane < kVoiceLanes; ++lane) {
+        const int voice = first + lane;
+        // Positions stay below 17 tables: truncation is floor()
+        const float position = job.position[voice] + (float)i * job.increment[voice];
+        const int whole = (int)position;
+        const float frac = position - (float)whole;
+        const float* table = job.table + job.tableOffset[voice] + (whole & mask);
+        const float value = table[0] + frac * (table[1] - table[0]);
+        const float gain = job.gain[voice] + (float)i * job.gainStep[voice];
+        partials[lane] = partials[lane] + gain * value;
+      }
+    }
+  }
+}
+
+Level detectBestLevel() {
+#if DAW_ENABLE_SIMD
+  if (juce::SystemStats::hasAVX512F()) {
+    return Level::AVX512;
+  }
+  if (juce::SystemStats::hasAVX2()) {
+    return Level::AVX2;
+  }
+  if (juce::SystemStats::hasSSE2()) {
+    return Level::SSE2;
+  }
+#endif
+  return Level::Scalar;
+}
+
+}  // namespace
+
+float wrapPosition(float position, int tableSize) {
+  const float size = (float)tableSize;
+  float wrapped = position - std::floor(position * (1.0f / size)) * size;
+  if (wrapped < 0.0f) {
+    wrapped += size;
+  }
+  if (wrapped >= size) {
+    wrapped -= size;
+  }
+  return wrapped;
+}
+
+Kernels getScalarKernels() {
+  return {&renderScalar<true>, &renderScalar<false>, &mixVoicesScalar};
+}
+
+const Kernels* getKernels(Level level) {
+  static const Kernels scalar = getScalarKernels();
+#if DAW_ENABLE_SIMD
+  static const Kernels sse2 = getSse2Kernels();
+  static const Kernels avx2 = getAvx2Kernels();
+  static const Kernels avx512 = getAvx512Kernels();
+#endif
+
+  switch (level) {
+    case Level::Scalar:
+      return &scalar;
+#if DAW_ENABLE_SIMD
+    case Level::SSE2:
+      return juce::SystemStats::hasSSE2() ? &sse2 : nullptr;
+    case Level::AVX2:
+      return juce::SystemStats::hasAVX2() ? &avx2 : nullptr;
+    case Level::AVX512:
+      return juce::SystemStats::hasAVX512F() ? &avx512 : nullptr;
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+Level getBestLevel() {
+  static const Level level = detectBestLevel();
+  return level;
+}
+
+const Kernels& getBestKernels() {
+  static const Kernels& kernels = *getKernels(getBestLevel());
+  return kernels;
+}
+
+const char* getLevelName(Level level) {
+  switch (level) {
+    case Level::SSE2:
+      return "sse2";
+    case Level::AVX2:
+      return "avx2";
+    case Level::AVX512:
+      return "avx512";
+    case Level::Scalar:
+    default:
+      return "scalar";
+  }
+}
+
+}  // namespace WaveTableSimd
@@ -0,0 +1,145 @@
+#include <emmintrin.h>
+#include <cstring>
+#include "wave-table-simd.hpp"
+
+// SSE2 kernels, 4 lanes. SSE2 has neither floor nor gathers, both are
+// emulated.
+
+namespace WaveTableSimd {
+
+namespace {
+
+// Exact floor() for |x| < 2^31
+inline __m128 floorPs(__m128 x) {
+  const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+  return _mm_sub_ps(truncated,
+                    _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+}
+
+template <bool Linear>
+void renderChunk(const BlockJob& job, float base, const float* modulation,
+                 float* output) {
+  const __m128 size = _mm_set1_ps((float)job.tableSize);
+  const __m128 inverseSize = _mm_set1_ps(1.0f / (float)job.tableSize);
+  const __m128i sizeInt = _mm_set1_epi32(job.tableSize);
+  const __m128i lastIndex = _mm_set1_epi32(job.tableSize - 1);
+  const __m128 increment = _mm_set1_ps(job.increment);
+  const __m128 baseVector = _mm_set1_ps(base);
+
+  for (int group = 0; group < kChunkSize; group += 4) {
+    const __m128 lanes = _mm_setr_ps((float)group, (float)(group + 1),
+                                     (float)(group + 2), (float)(group + 3));
+    __m128 position = _mm_add_ps(baseVector, _mm_mul_ps(lanes, increment));
+    if (modulation != nullptr) {
+      position = _mm_add_ps(
+          position, _mm_mul_ps(_mm_loadu_ps(modulation + group),
+                               _mm_set1_ps(job.modulationScale)));
+    }
+
+    const __m128 wrapped = _mm_sub_ps(
+        position, _mm_mul_ps(floorPs(_mm_mul_ps(position, inverseSize)), size));
+    const __m128 floored = floorPs(wrapped);
+
+    __m128i index = _mm_cvttps_epi32(floored);
+    index = _mm_add_epi32(
+        index, _mm_and_si128(_mm_cmplt_epi32(index, _mm_setzero_si128()), sizeInt));
+    index = _mm_sub_epi32(index,
+                          _mm_and_si128(_mm_cmpgt_epi32(index, lastIndex), sizeInt));
+
+    alignas(16) int indices[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(indices), index);
+
+    const __m128 a = _mm_setr_ps(job.table[indices[0]], job.table[indices[1]],
+                                 job.table[indices[2]], job.table[indices[3]]);
+    if constexpr (Linear) {
+      const __m128 b =
+          _mm_setr_ps(job.table[indices[0] + 1], job.table[indices[1] + 1],
+                      job.table[indices[2] + 1], job.table[indices[3] + 1]);
+      const __m128 frac = _mm_sub_ps(wrapped, floored);
+      _mm_storeu_ps(output + group,
+                    _mm_add_ps(a, _mm_mul_ps(frac, _mm_sub_ps(b, a))));
+    } else {
+      _mm_storeu_ps(output + group, a);
+    }
+  }
+}
+
+template <bool Linear>
+float renderSse2(const BlockJob& job) {
+  float base = job.position;
+
+  for (int start = 0; start < job.numSamples; start += kChunkSize) {
+    const int count = job.numSamples - start < kChunkSize
+                          ? job.numSamples - start
+                          : kChunkSize;
+    const float* modulation =
+        job.phaseModulation != nullptr ? job.phaseModulation + start : nullptr;
+
+    if (count == kChunkSize) {
+      renderChunk<Linear>(job, base, modulation, job.output + start);
+    } else {
+      // Partial last chunk: run the same vector code on padded copies
+      float paddedModulation[kChunkSize] = {};
+      float paddedOutput[kChunkSize];
+      if (modulation != nullptr) {
+        std::memcpy(paddedModulation, modulation, sizeof(float) * (size_t)count);
+      }
+      renderChunk<Linear>(job, base,
+                          modulation != nullptr ? paddedModulation : nullptr,
+                          paddedOutput);
+      std::memcpy(job.output + start, paddedOutput, sizeof(float) * (size_t)count);
+    }
+
+    base = wrapPosition(base + (float)count * job.increment, job.tableSize);
+  }
+
+  return base;
+}
+
+void mixVoicesSse2(const VoiceJob& job) {
+  const __m128i mask = _mm_set1_epi32(job.tableSize - 1);
+
+  for (int first = 0; first < job.numVoices; first += kVoiceLanes) {
+    for (int group = 0; group < kVoiceLanes; group += 4) {
+      const int voice = first + group;
+      const __m128 start = _mm_loadu_ps(job.position + voice);
+      const __m128 increment = _mm_loadu_ps(job.increment + voice);
+      const __m128 gain = _mm_loadu_ps(job.gain + voice);
+      const __m128 gainStep = _mm_loadu_ps(job.gainStep + voice);
+      const __m128i offset = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(job.tableOffset + voice));
+
+      for (int i = 0; i < job.numSamples; ++i) {
+        const __m128 sample = _mm_set1_ps((float)i);
+        const __m128 position = _mm_add_ps(start, _mm_mul_ps(sample, increment));
+        // Positions stay below 17 tables: truncation is floor()
+        const __m128i whole = _mm_cvttps_epi32(position);
+        const __m128 frac = _mm_sub_ps(position, _mm_cvtepi32_ps(whole));
+
+        alignas(16) int indices[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(indices),
+                        _mm_add_epi32(offset, _mm_and_si128(whole, mask)));
+
+        const __m128 a = _mm_setr_ps(job.table[indices[0]], job.table[indices[1]],
+                                     job.table[indices[2]], job.table[indices[3]]);
+        const __m128 b =
+            _mm_setr_ps(job.table[indices[0] + 1], job.table[indices[1] + 1],
+                        job.table[indices[2] + 1], job.table[indices[3] + 1]);
+        const __m128 value = _mm_add_ps(a, _mm_mul_ps(frac, _mm_sub_ps(b, a)));
+        const __m128 ramp = _mm_add_ps(gain, _mm_mul_ps(sample, gainStep));
+
+        float* partials = job.partials + i * kVoiceLanes + group;
+        _mm_storeu_ps(partials, _mm_add_ps(_mm_loadu_ps(partials),
+                                           _mm_mul_ps(ramp, value)));
+      }
+    }
+  }
+}
+
+}  // namespace
+
+Kernels getSse2Kernels() {
+  return {&renderSse2<true>, &renderSse2<false>, &mixVoicesSse2};
+}
+
+}  // namespace WaveTableSimd
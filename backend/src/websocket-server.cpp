@@ -0,0 +1,1171 @@
+#include "websocket-server.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "audio-context.hpp"
+#include "sample-track.hpp"
+#include "synth-track.hpp"
+
+void WebSocketServer::start(uint16_t port) {
+  if (running_.load()) {
+    std::cerr << "[WebSocket] Server already running" << std::endl;
+    return;
+  }
+
+  port_ = port;
+  running_.store(true);
+
+  // Launch server on separate thread
+  server_thread_ = std::thread([this]() { this->run(); });
+  meter_thread_ = std::thread([this]() { this->runMeters(); });
+  analysis_thread_ = std::thread([this]() { this->runAnalysis(); });
+  render_thread_ = std::thread([this]() { this->runRenders(); });
+
+  std::cout << "[WebSocket] Server starting on port " << port_ << std::endl;
+}
+
+void WebSocketServer::stop() {
+  if (!running_.load() && !server_thread_.joinable()) {
+    return;
+  }
+
+  std::cout << "[WebSocket] Stopping server..." << std::endl;
+
+  if (app_ && running_.load()) {
+    try {
+      app_->stop();
+    } catch (...) {
+      // Ignore exceptions during shutdown
+    }
+  }
+
+  if (server_thread_.joinable()) {
+    try {
+      server_thread_.join();
+    } catch (...) {
+      // Ignore exceptions during thread join
+    }
+  }
+
+  {
+    const std::lock_guard<std::mutex> meterLock(meterMutex_);
+    const std::lock_guard<std::mutex> analysisLock(analysisMutex_);
+    const std::lock_guard<std::mutex> renderLock(renderMutex_);
+    running_.store(false);
+  }
+  meterWakeup_.notify_all();
+  analysisWakeup_.notify_all();
+  renderWakeup_.notify_all();
+  if (meter_thread_.joinable()) {
+    meter_thread_.join();
+  }
+  if (analysis_thread_.joinable()) {
+    analysis_thread_.join();
+  }
+  if (render_thread_.joinable()) {
+    render_thread_.join();
+  }
+
+  running_.store(false);
+  std::cout << "[WebSocket] Server stopped" << std::endl;
+}
+
+void WebSocketServer::run() {
+  app_ = std::make_unique<crow::SimpleApp>();
+
+  // WebSocket endpoint
+  CROW_WEBSOCKET_ROUTE((*app_), "/ws")
+      .onopen([](crow::websocket::connection& conn) {
+        conn.userdata(new ConnectionState());
+        std::cout << "[WebSocket] Client connected" << std::endl;
+      })
+      .onclose(
+          [this](crow::websocket::connection& conn, const std::string& reason) {
+            unsubscribeMeters(conn);
+            unsubscribeProfile(conn);
+            unsubscribeAnalysis(conn, 0);
+            cancelRenders(conn);
+            delete static_cast<ConnectionState*>(conn.userdata());
+            conn.userdata(nullptr);
+            std::cout << "[WebSocket] Client disconnected: " << reason
+                      << std::endl;
+          })
+      .onmessage([this](crow::websocket::connection& conn,
+                        const std::string& data, bool is_binary) {
+        auto& state = getState(conn);
+        if (is_binary) {
+          // High-rate path: never logged, no parsing beyond the frame view
+          const auto& reply = handleBinaryMessage(state, data);
+          if (!reply.empty()) {
+            conn.send_binary(reply);
+          }
+        } else {
+          const auto reply = handleMessage(conn, data);
+          if (!reply.empty()) {
+            conn.send_text(reply);
+          }
+        }
+      })
+      .onerror(
+          [](crow::websocket::connection& conn, const std::string& error) {
+            std::cerr << "[WebSocket] Error: " << error << std::endl;
+          });
+
+  // Simple HTTP endpoint for health check
+  CROW_ROUTE((*app_), "/health")
+  ([]() { return crow::response(200, "OK"); });
+
+  // Engine profile for Prometheus scrapers
+  CROW_ROUTE((*app_), "/metrics")
+  ([this]() {
+    crow::response response(200, engine_.getMetrics());
+    response.set_header("Content-Type", "text/plain; version=0.0.4");
+    return response;
+  });
+
+  // Run the server (blocking call)
+  app_->port(port_).multithreaded().run();
+
+  thread_exited_.store(true);
+  std::cout << "[WebSocket] Server thread exited" << std::endl;
+}
+
+std::string WebSocketServer::handleMessage(crow::websocket::connection& conn,
+                                           const std::string& data) {
+  auto& state = getState(conn);
+  auto message = crow::json::load(data);
+  if (!message || message.t() != crow::json::type::Object ||
+      !message.has("type")) {
+    // Echo back non-command messages
+    logMessage(data);
+    return "Echo: " + data;
+  }
+
+  const std::string type = message["type"].s();
+  if (type == "meterAck") {
+    // Sent at the meter rate: never logged, not answered
+    if (message.has("sequence")) {
+      acknowledgeMeters(state, static_cast<juce::uint32>(message["sequence"].u()));
+    }
+    return {};
+  }
+
+  logMessage(data);
+  crow::json::wvalue reply;
+
+  if (type == "hello") {
+    return negotiate(state, message);
+  } else if (type == "subscribeMeters") {
+    const double rate = message.has("rate") ? message["rate"].d() : 0.0;
+    reply["type"] = "metersSubscribed";
+    reply["rate"] = subscribeMeters(
+        conn, rate, message.has("ack") && message["ack"].b());
+  } else if (type == "unsubscribeMeters") {
+    unsubscribeMeters(conn);
+    reply["type"] = "metersUnsubscribed";
+  } else if (type == "subscribeProfile") {
+    const double rate = message.has("rate") ? message["rate"].d() : 0.0;
+    reply["type"] = "profileSubscribed";
+    reply["rate"] = subscribeProfile(conn, rate);
+  } else if (type == "unsubscribeProfile") {
+    unsubscribeProfile(conn);
+    reply["type"] = "profileUnsubscribed";
+  } else if (type == "setProfiling") {
+    auto& profiler = engine_.getProfiler();
+    if (message.has("enabled")) {
+      profiler.setEnabled(message["enabled"].b());
+    }
+    if (message.has("detailed")) {
+      profiler.setDetailed(message["detailed"].b());
+    }
+    reply["type"] = "profiling";
+    reply["enabled"] = profiler.isEnabled();
+    reply["detailed"] = profiler.isDetailed();
+  } else if (type == "subscribeAnalysis") {
+    subscribeAnalysis(conn, message, reply);
+  } else if (type == "unsubscribeAnalysis" && message.has("id")) {
+    const auto id = static_cast<juce::uint32>(message["id"].u());
+    reply["type"] = id != 0 && unsubscribeAnalysis(conn, id)
+                        ? "analysisUnsubscribed"
+                        : "error";
+    reply["id"] = id;
+  } else if (type == "addTrack") {
+    const double frequency =
+        message.has("frequency") ? message["frequency"].d() : 440.0;
+    reply["type"] = "trackAdded";
+    reply["index"] = engine_.addTrack(
+        std::make_unique<BeatTrack>(static_cast<float>(frequency)));
+  } else if (type == "addSynthTrack") {
+    const int voices = message.has("voices")
+                           ? static_cast<int>(message["voices"].i())
+                           : SynthTrack::kDefaultVoices;
+    auto track = std::make_unique<SynthTrack>(voices, getWaveform(message));
+    if (message.has("steal") && std::string(message["steal"].s()) == "quietest") {
+      track->setStealMode(SynthTrack::StealMode::Quietest);
+    }
+    reply["type"] = "trackAdded";
+    reply["index"] = engine_.addTrack(std::move(track));
+  } else if (type == "addPatternTrack") {
+    const int voices = message.has("voices")
+                           ? static_cast<int>(message["voices"].i())
+                           : PatternTrack::kDefaultVoices;
+    reply["type"] = "trackAdded";
+    reply["index"] = engine_.addTrack(
+        std::make_unique<PatternTrack>(voices, getWaveform(message)));
+  } else if (type == "setPattern" && message.has("index")) {
+    // Compiled here, swapped in by the audio thread at its next block. The
+    // track is held until the reply, in case another connection removes it.
+    const auto index = static_cast<size_t>(message["index"].i());
+    const auto track = std::dynamic_pointer_cast<PatternTrack>(engine_.getTrack(index));
+    if (track == nullptr) {
+      reply["type"] = "error";
+      reply["message"] = "No pattern track at index " + std::to_string(index);
+    } else if (!track->setPattern(parsePattern(message), *engine_.getTempoMap())) {
+      reply["type"] = "error";
+      reply["message"] = "Pattern edits pending";
+    } else {
+      reply["type"] = "patternSet";
+      reply["index"] = index;
+      reply["notes"] = track->getTimeline()->notes.size();
+    }
+  } else if (type == "addSampleTrack" && message.has("path")) {
+    // Streamed by the engine's disk thread, or with "cache": true decoded
+    // (or mapped from its sidecar) at the device rate here once and shared
+    // through the SampleCache
+    const auto file = juce::File::getCurrentWorkingDirectory().getChildFile(
+        juce::String(std::string(message["path"].s())));
+    const double sampleRate = AudioContext::getInstance().sampleRate;
+    const auto start = message.has("start")
+                           ? (juce::int64)std::llround(message["start"].d() * sampleRate)
+                           : 0;
+    std::unique_ptr<SampleTrack> track;
+    if (message.has("cache") && message["cache"].b()) {
+      if (auto sample = SampleCache::getInstance().load(file, sampleRate)) {
+        track = std::make_unique<SampleTrack>(std::move(sample), start);
+      }
+    } else if (auto stream = engine_.getDiskStreamer().createStream(file, sampleRate)) {
+      track = std::make_unique<SampleTrack>(std::move(stream), start);
+    }
+
+    if (track == nullptr) {
+      reply["type"] = "error";
+      reply["message"] = "Cannot open " + std::string(message["path"].s());
+    } else {
+      reply["type"] = "trackAdded";
+      reply["index"] = engine_.addTrack(std::move(track));
+    }
+  } else if (type == "removeTrack" && message.has("index")) {
+    const auto index = static_cast<size_t>(message["index"].i());
+    reply["type"] = engine_.removeTrack(index) ? "trackRemoved" : "error";
+    reply["index"] = index;
+  } else if (type == "render" && message.has("path")) {
+    // Offline bounce of a snapshot of the session, on the render thread so
+    // this connection keeps its meters and commands meanwhile
+    OfflineRenderer::Settings settings;
+    settings.outputFile = juce::File::getCurrentWorkingDirectory().getChildFile(
+        juce::String(std::string(message["path"].s())));
+    if (message.has("duration")) {
+      settings.durationSeconds = message["duration"].d();
+    }
+    if (message.has("start")) {
+      settings.startSeconds = message["start"].d();
+    }
+    if (message.has("bitDepth")) {
+      settings.bitDepth = static_cast<int>(message["bitDepth"].i());
+    }
+    settings.sampleRate =
+        message.has("sampleRate") ? message["sampleRate"].d() : engine_.getSampleRate();
+
+    const auto path = settings.outputFile.getFullPathName().toStdString();
+    if (queueRender(conn, std::move(settings))) {
+      reply["type"] = "renderQueued";
+      reply["path"] = path;
+    } else {
+      reply["type"] = "error";
+      reply["message"] = "Too many renders queued";
+    }
+  } else if (type == "setVolume" || type == "setMute" || type == "setPan" ||
+             type == "setMasterVolume" || type == "play" || type == "stop" ||
+             type == "seek" || type == "setBusVolume" || type == "setBusMute" ||
+             type == "setBusPan" || type == "setSendLevel" ||
+             type == "noteOn" || type == "noteOff" || type == "setMidiInput") {
+    queueCommand(type, message, reply);
+  } else if (type == "addBus" || type == "removeBus" || type == "routeTrack" ||
+             type == "routeBus" || type == "addSend" || type == "removeSend" ||
+             type == "setEffects") {
+    editRouting(type, message, reply);
+  } else {
+    reply["type"] = "error";
+    reply["message"] = "Unknown command: " + type;
+  }
+
+  reply["trackCount"] = engine_.getTrackCount();
+  reply["busCount"] = engine_.getBusCount();
+  reply["latency"] = engine_.getLatencySamples();
+  reply["appliedCommand"] = engine_.getLastAppliedCommand();
+  return reply.dump();
+}
+
+void WebSocketServer::logMessage(const std::string& data) const {
+  if (logMessages_.load(std::memory_order_relaxed)) {
+    std::cout << "[WebSocket] Received message: " << data << std::endl;
+  }
+}
+
+void WebSocketServer::editRouting(const std::string& type, const crow::json::rvalue& message,
+                                  crow::json::wvalue& reply) {
+  const auto getInt = [&message](const char* key, int fallback) {
+    return message.has(key) ? static_cast<int>(message[key].i()) : fallback;
+  };
+  const int index = getInt("index", -1);
+  const int output = getInt("output", MixGraph::kMaster);
+  bool done = false;
+
+  if (type == "addBus") {
+    auto bus = std::make_shared<MixBus>(
+        message.has("name") ? juce::String(std::string(message["name"].s())) : juce::String());
+    const int busIndex = engine_.addBus(std::move(bus), output);
+    done = busIndex >= 0;
+    reply["type"] = "busAdded";
+    reply["index"] = busIndex;
+  } else if (type == "removeBus") {
+    done = engine_.removeBus(index);
+    reply["type"] = "busRemoved";
+    reply["index"] = index;
+  } else if (type == "routeTrack") {
+    done = index >= 0 && engine_.setTrackOutput(static_cast<size_t>(index), output);
+    reply["type"] = "trackRouted";
+    reply["index"] = index;
+  } else if (type == "routeBus") {
+    done = engine_.setBusOutput(index, output);
+    reply["type"] = "busRouted";
+    reply["index"] = index;
+  } else if (type == "addSend") {
+    const auto source = message.has("bus") ? MixGraph::Source::bus(getInt("bus", -1))
+                                           : MixGraph::Source::track(getInt("track", -1));
+    const double level = message.has("level") ? message["level"].d() : 1.0;
+    const int sendIndex = engine_.addSend(source, getInt("destination", -1),
+                                          std::make_shared<MixSend>(static_cast<float>(level)));
+    done = sendIndex >= 0;
+    reply["type"] = "sendAdded";
+    reply["index"] = sendIndex;
+  } else if (type == "removeSend") {
+    done = engine_.removeSend(index);
+    reply["type"] = "sendRemoved";
+    reply["index"] = index;
+  } else if (type == "setEffects") {
+    std::vector<std::shared_ptr<AudioEffect>> chain;
+    done = true;
+    if (message.has("effects")) {
+      for (const auto& description : message["effects"]) {
+        auto effect = makeEffect(description);
+        done = done && effect != nullptr;
+        chain.push_back(std::move(effect));
+      }
+    }
+    const int bus = getInt("bus", MixGraph::kMaster);
+    done = done && engine_.setEffects(bus, std::move(chain));
+    // The other chains' effects may have changed their latency since they
+    // were routed: the reply's "latency" is the compensated one
+    engine_.refreshLatency();
+    reply["type"] = "effectsSet";
+    reply["bus"] = bus;
+  }
+
+  if (!done) {
+    reply["type"] = "error";
+    reply["message"] = "Invalid " + type + " (unknown index, effect, or a loop)";
+  }
+}
+
+WaveTable::WaveType WebSocketServer::getWaveform(const crow::json::rvalue& message) {
+  const std::string waveform =
+      message.has("waveform") ? std::string(message["waveform"].s()) : "saw";
+  return waveform == "sine"       ? WaveTable::WaveType::SINE
+         : waveform == "square"   ? WaveTable::WaveType::SQUARE
+         : waveform == "triangle" ? WaveTable::WaveType::TRIANGLE
+                                  : WaveTable::WaveType::SAW;
+}
+
+Pattern WebSocketServer::parsePattern(const crow::json::rvalue& message) {
+  const auto get = [](const crow::json::rvalue& object, const char* key,
+                      double fallback) {
+    return object.has(key) ? object[key].d() : fallback;
+  };
+
+  Pattern pattern;
+  pattern.stepBeats = get(message, "stepBeats", pattern.stepBeats);
+  pattern.swing = get(message, "swing", pattern.swing);
+  pattern.startBeat = get(message, "startBeat", pattern.startBeat);
+  if (message.has("steps") && message["steps"].t() == crow::json::type::List) {
+    for (const auto& description : message["steps"]) {
+      PatternStep step;
+      const bool isNote = description.t() == crow::json::type::Object &&
+                          description.has("note");
+      step.note = isNote ? static_cast<int>(description["note"].i()) : 0;
+      step.velocity =
+          isNote ? static_cast<float>(get(description, "velocity", step.velocity))
+                 : 0.0f;
+      if (isNote) {
+        step.length = get(description, "length", step.length);
+        step.swing = get(description, "swing", step.swing);
+      }
+      pattern.steps.push_back(step);
+    }
+  }
+  return pattern;
+}
+
+std::shared_ptr<AudioEffect> WebSocketServer::makeEffect(const crow::json::rvalue& description) {
+  if (description.t() != crow::json::type::Object || !description.has("type")) {
+    return nullptr;
+  }
+  const auto get = [&description](const char* key, double fallback) {
+    return description.has(key) ? description[key].d() : fallback;
+  };
+
+  const std::string type = description["type"].s();
+  if (type == "delay") {
+    return std::make_shared<DelayEffect>(get("time", 0.25),
+                                         static_cast<float>(get("feedback", 0.3)),
+                                         static_cast<float>(get("wet", 0.5)));
+  }
+  if (type == "lowpass" || type == "highpass") {
+    return std::make_shared<BiquadFilter>(
+        type == "lowpass" ? BiquadFilter::Type::LowPass : BiquadFilter::Type::HighPass,
+        get("cutoff", 1000.0), get("q", 0.707));
+  }
+  if (type == "limiter") {
+    return std::make_shared<LimiterEffect>(static_cast<float>(get("ceiling", 0.9)),
+                                           get("lookahead", 0.005), get("release", 0.1));
+  }
+  return nullptr;
+}
+
+std::string WebSocketServer::negotiate(ConnectionState& state, const crow::json::rvalue& message) {
+  state.binaryVersion = 0;
+  if (message.has("binary")) {
+    for (const auto& version : message["binary"]) {
+      if (version.i() == ControlProtocol::kVersion) {
+        state.binaryVersion = ControlProtocol::kVersion;
+      }
+    }
+  }
+
+  auto* reply = new juce::DynamicObject();
+  reply->setProperty("type", "welcome");
+  reply->setProperty("protocol", state.binaryVersion > 0 ? "binary" : "json");
+  if (state.binaryVersion > 0) {
+    reply->setProperty("version", state.binaryVersion);
+    reply->setProperty("schema", ControlProtocol::getSchema());
+  }
+  return juce::JSON::toString(juce::var(reply), true).toStdString();
+}
+
+const std::string& WebSocketServer::handleBinaryMessage(ConnectionState& state,
+                                                        const std::string& data) {
+  using namespace ControlProtocol;
+
+  const FrameView frame(data.data(), data.size());
+  Status status;
+
+  if (state.binaryVersion > 0 && frame.isValid() &&
+      frame.getType() == MessageType::MeterAck) {
+    acknowledgeMeters(state, frame.getSequence());
+    state.reply.clear();
+    return state.reply;
+  }
+
+  if (state.binaryVersion == 0) {
+    status.error = Error::NotNegotiated;
+  } else if (!frame.isValid()) {
+    status.error = frame.getError();
+  } else if (frame.getType() != MessageType::Commands) {
+    status.error = Error::UnknownMessage;
+  } else if (frame.getCount() > 0) {
+    // One id per record, consecutive within the frame
+    const int count = frame.getCount();
+    status.firstCommandId = nextCommandId_.fetch_add((juce::uint32)count) + 1;
+    const auto tempoMap = engine_.getTempoMap();
+
+    for (int i = 0; i < count && status.error == Error::None; ++i) {
+      const auto command = frame.getCommand(i);
+      status.error = queueCommand(
+          command.getOp(), command.getTrack(), command.getValue(),
+          getCommandSample(*tempoMap, command.getTiming(), command.getWhen()),
+          status.firstCommandId + (juce::uint32)i, command.getNote());
+      if (status.error == Error::None) {
+        ++status.accepted;
+      }
+    }
+  }
+
+  status.appliedCommand = engine_.getLastAppliedCommand();
+  status.trackCount = (juce::uint32)engine_.getTrackCount();
+
+  writeStatusFrame(state.reply, frame.getSequence(), status);
+  return state.reply;
+}
+
+void WebSocketServer::queueCommand(const std::string& type, const crow::json::rvalue& message,
+                                   crow::json::wvalue& reply) {
+  using ControlProtocol::Op;
+
+  Op op = Op::Play;
+  double value = message.has("value") ? message["value"].d() : 0.0;
+  juce::uint32 track = 0;
+  int note = 0;
+
+  if (type == "setVolume" || type == "setMute" || type == "setPan" ||
+      type == "setBusVolume" || type == "setBusMute" || type == "setBusPan" ||
+      type == "setSendLevel" || type == "noteOn" || type == "noteOff" ||
+      type == "setMidiInput") {
+    // Track, bus or send index
+    track = message.has("index")
+                ? static_cast<juce::uint32>(message["index"].i())
+                : 0;
+    if (type == "setVolume") {
+      op = Op::SetTrackVolume;
+    } else if (type == "setPan") {
+      op = Op::SetTrackPan;
+    } else if (type == "setMute") {
+      op = Op::SetTrackMute;
+      value = message.has("value") && message["value"].b() ? 1.0 : 0.0;
+    } else if (type == "setMidiInput") {
+      op = Op::SetTrackMidiInput;
+      value = message.has("value") && message["value"].b() ? 1.0 : 0.0;
+    } else if (type == "setBusVolume") {
+      op = Op::SetBusVolume;
+    } else if (type == "setBusPan") {
+      op = Op::SetBusPan;
+    } else if (type == "setBusMute") {
+      op = Op::SetBusMute;
+      value = message.has("value") && message["value"].b() ? 1.0 : 0.0;
+    } else if (type == "noteOn" || type == "noteOff") {
+      op = type == "noteOn" ? Op::NoteOn : Op::NoteOff;
+      note = message.has("note") ? static_cast<int>(message["note"].i()) : 60;
+      value = message.has("velocity") ? message["velocity"].d() : 1.0;
+    } else {
+      op = Op::SetSendLevel;
+    }
+  } else if (type == "setMasterVolume") {
+    op = Op::SetMasterVolume;
+  } else if (type == "stop") {
+    op = Op::Stop;
+  } else if (type == "seek") {
+    op = Op::Seek;
+  }
+
+  const auto id = ++nextCommandId_;
+  const auto error =
+      queueCommand(op, track, value, getCommandSample(message), id, note);
+  if (error == ControlProtocol::Error::None) {
+    reply["type"] = "commandQueued";
+    reply["id"] = id;
+  } else {
+    reply["type"] = "error";
+    using ControlProtocol::Error;
+    const char* target = error == Error::NoSuchBus    ? "bus"
+                         : error == Error::NoSuchSend ? "send"
+                                                      : "track";
+    reply["message"] = error == Error::QueueFull
+                           ? std::string("Command queue full")
+                           : std::string("No ") + target + " at index " + std::to_string(track);
+  }
+}
+
+ControlProtocol::Error WebSocketServer::queueCommand(ControlProtocol::Op op, juce::uint32 track,
+                                                     double value, juce::int64 sample,
+                                                     juce::uint32 id, int note) {
+  using ControlProtocol::Error;
+  using ControlProtocol::Op;
+
+  EngineCommand command;
+  command.id = id;
+  command.sample = sample;
+  command.value = value;
+
+  switch (op) {
+    case Op::SetTrackVolume:
+    case Op::SetTrackMute:
+    case Op::SetTrackPan:
+      command.track = engine_.getTrack(track);
+      if (command.track == nullptr) {
+        return Error::NoSuchTrack;
+      }
+      command.type = op == Op::SetTrackVolume ? EngineCommand::Type::SetTrackVolume
+                     : op == Op::SetTrackMute ? EngineCommand::Type::SetTrackMute
+                                              : EngineCommand::Type::SetTrackPan;
+      break;
+    case Op::NoteOn:
+    case Op::NoteOff:
+      // Tracks which are not instruments ignore notes
+      command.track = engine_.getTrack(track);
+      if (command.track == nullptr) {
+        return Error::NoSuchTrack;
+      }
+      command.type = op == Op::NoteOn ? EngineCommand::Type::NoteOn
+                                      : EngineCommand::Type::NoteOff;
+      command.note = juce::jlimit(0, 127, note);
+      break;
+    case Op::SetTrackMidiInput:
+      command.track = engine_.getTrack(track);
+      if (command.track == nullptr) {
+        return Error::NoSuchTrack;
+      }
+      command.type = EngineCommand::Type::SetTrackMidiInput;
+      break;
+    case Op::SetBusVolume:
+    case Op::SetBusMute:
+    case Op::SetBusPan:
+      command.bus = engine_.getBus(static_cast<int>(track));
+      if (command.bus == nullptr) {
+        return Error::NoSuchBus;
+      }
+      command.type = op == Op::SetBusVolume ? EngineCommand::Type::SetBusVolume
+                     : op == Op::SetBusMute ? EngineCommand::Type::SetBusMute
+                                            : EngineCommand::Type::SetBusPan;
+      break;
+    case Op::SetSendLevel:
+      command.send = engine_.getSend(static_cast<int>(track));
+      if (command.send == nullptr) {
+        return Error::NoSuchSend;
+      }
+      command.type = EngineCommand::Type::SetSendLevel;
+      break;
+    case Op::SetMasterVolume:
+      command.type = EngineCommand::Type::SetMasterVolume;
+      break;
+    case Op::Play:
+      command.type = EngineCommand::Type::Play;
+      break;
+    case Op::Stop:
+      command.type = EngineCommand::Type::Stop;
+      break;
+    case Op::Seek:
+      // The target position uses the same fields as the timestamp
+      command.type = EngineCommand::Type::Seek;
+      command.value = (double)std::max<juce::int64>(0, sample);
+      command.sample = EngineCommand::kImmediate;
+      break;
+    default:
+      return Error::UnknownMessage;
+  }
+
+  return engine_.sendCommand(std::move(command)) ? Error::None
+                                                 : Error::QueueFull;
+}
+
+juce::int64 WebSocketServer::getCommandSample(const crow::json::rvalue& message) const {
+  if (message.has("beat")) {
+    return getCommandSample(*engine_.getTempoMap(),
+                            ControlProtocol::Timing::Beat,
+                            message["beat"].d());
+  }
+  if (message.has("time")) {
+    return getCommandSample(*engine_.getTempoMap(),
+                            ControlProtocol::Timing::Seconds,
+                            message["time"].d());
+  }
+  return EngineCommand::kImmediate;
+}
+
+juce::int64 WebSocketServer::getCommandSample(const TempoMap& tempoMap,
+                                              ControlProtocol::Timing timing,
+                                              double when) {
+  switch (timing) {
+    case ControlProtocol::Timing::Sample:
+      return static_cast<juce::int64>(std::llround(when));
+    case ControlProtocol::Timing::Beat:
+      return static_cast<juce::int64>(
+          std::ceil(tempoMap.getSampleAtBeat(when)));
+    case ControlProtocol::Timing::Seconds:
+      return static_cast<juce::int64>(
+          std::llround(when * tempoMap.getSampleRate()));
+    default:
+      return EngineCommand::kImmediate;
+  }
+}
+
+double WebSocketServer::subscribeMeters(crow::websocket::connection& conn, double rate,
+                                        bool acknowledges) {
+  const double maxRate = meterRate_.load();
+  const double granted = rate > 0.0 ? std::min(rate, maxRate) : maxRate;
+
+  auto& state = getState(conn);
+  const std::lock_guard<std::mutex> lock(meterMutex_);
+  state.acknowledgesMeters = acknowledges;
+  state.meterPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(1.0 / granted));
+  state.nextMeterSend = std::chrono::steady_clock::now();
+  state.lastAckedMeters = state.lastSentMeters;
+  state.hasPendingMeters = false;
+  // Preallocate, so merging frames never allocates
+  state.pendingMeters.tracks.resize(MeterFrame::kMaxTracks);
+
+  if (!state.metersSubscribed) {
+    state.metersSubscribed = true;
+    meterSubscribers_.push_back(&conn);
+  }
+  return granted;
+}
+
+void WebSocketServer::unsubscribeMeters(crow::websocket::connection& conn) {
+  const std::lock_guard<std::mutex> lock(meterMutex_);
+  meterSubscribers_.erase(
+      std::remove(meterSubscribers_.begin(), meterSubscribers_.end(), &conn),
+      meterSubscribers_.end());
+  if (auto* state = static_cast<ConnectionState*>(conn.userdata())) {
+    state->metersSubscribed = false;
+  }
+}
+
+void WebSocketServer::acknowledgeMeters(ConnectionState& state, juce::uint32 sequence) {
+  const std::lock_guard<std::mutex> lock(meterMutex_);
+  // Ignore stale or future sequences (wrap-around safe)
+  if ((juce::int32)(sequence - state.lastAckedMeters) > 0 &&
+      (juce::int32)(state.lastSentMeters - sequence) >= 0) {
+    state.lastAckedMeters = sequence;
+  }
+}
+
+double WebSocketServer::subscribeProfile(crow::websocket::connection& conn, double rate) {
+  const double maxRate = std::min(kMaxProfileRate, meterRate_.load());
+  const double granted = rate > 0.0 ? std::min(rate, maxRate) : 1.0;
+
+  auto& state = getState(conn);
+  const std::lock_guard<std::mutex> lock(meterMutex_);
+  state.profilePeriod =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / granted));
+  // The first summary covers one period from now
+  state.nextProfileSend = std::chrono::steady_clock::now() + state.profilePeriod;
+  engine_.captureProfile(state.lastProfile);
+
+  if (!state.profileSubscribed) {
+    state.profileSubscribed = true;
+    profileSubscribers_.push_back(&conn);
+  }
+  return granted;
+}
+
+void WebSocketServer::unsubscribeProfile(crow::websocket::connection& conn) {
+  const std::lock_guard<std::mutex> lock(meterMutex_);
+  profileSubscribers_.erase(
+      std::remove(profileSubscribers_.begin(), profileSubscribers_.end(), &conn),
+      profileSubscribers_.end());
+  if (auto* state = static_cast<ConnectionState*>(conn.userdata())) {
+    state->profileSubscribed = false;
+  }
+}
+
+void WebSocketServer::sendProfiles(std::chrono::steady_clock::time_point now) {
+  bool captured = false;
+  for (auto* conn : profileSubscribers_) {
+    auto& state = getState(*conn);
+    if (now < state.nextProfileSend) {
+      continue;
+    }
+    state.nextProfileSend = std::max(state.nextProfileSend + state.profilePeriod, now);
+
+    // One capture shared by every subscriber due on this tick
+    if (!captured) {
+      engine_.captureProfile(profileSnapshot_);
+      captured = true;
+    }
+
+    const auto summary = EngineProfiler::describe(profileSnapshot_, state.lastProfile);
+    summary.getDynamicObject()->setProperty("type", "profile");
+    conn->send_text(juce::JSON::toString(summary, true).toStdString());
+    state.lastProfile = profileSnapshot_;
+  }
+}
+
+void WebSocketServer::runMeters() {
+  std::unique_lock<std::mutex> lock(meterMutex_);
+  auto nextTick = std::chrono::steady_clock::now();
+
+  while (running_.load()) {
+    nextTick += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / meterRate_.load()));
+    meterWakeup_.wait_until(lock, nextTick, [this] { return !running_.load(); });
+    const auto now = std::chrono::steady_clock::now();
+    if (nextTick < now) {
+      // Fell behind (e.g. a long send): do not try to catch up
+      nextTick = now;
+    }
+
+    sendProfiles(now);
+
+    // Read even without subscribers, or the engine keeps holding peaks
+    const MeterFrame* frame = engine_.readMeters();
+    if (frame == nullptr) {
+      continue;
+    }
+
+    for (auto* conn : meterSubscribers_) {
+      auto& state = getState(*conn);
+      if (state.hasPendingMeters) {
+        state.pendingMeters.merge(*frame);
+      } else {
+        state.pendingMeters.position = frame->position;
+        std::copy(std::begin(frame->master), std::end(frame->master),
+                  std::begin(state.pendingMeters.master));
+        std::copy(frame->tracks.begin(), frame->tracks.begin() + frame->numTracks,
+                  state.pendingMeters.tracks.begin());
+        state.pendingMeters.numTracks = frame->numTracks;
+        state.hasPendingMeters = true;
+      }
+
+      const bool congested =
+          state.acknowledgesMeters &&
+          state.lastSentMeters - state.lastAckedMeters >= kMaxUnackedMeters;
+      if (now < state.nextMeterSend || congested) {
+        continue;
+      }
+
+      state.nextMeterSend = std::max(state.nextMeterSend + state.meterPeriod, now);
+      sendMeters(*conn, state);
+    }
+  }
+}
+
+void WebSocketServer::sendMeters(crow::websocket::connection& conn, ConnectionState& state) {
+  const auto& frame = state.pendingMeters;
+  const auto sequence = ++state.lastSentMeters;
+  state.hasPendingMeters = false;
+
+  if (state.binaryVersion > 0) {
+    using namespace ControlProtocol;
+    beginFrame(state.meterMessage, MessageType::Meters, sequence);
+    for (const auto& reading : frame.master) {
+      appendMeter(state.meterMessage, reading.peak, reading.truePeak, reading.rms);
+    }
+    for (int i = 0; i < frame.numTracks; ++i) {
+      const auto& reading = frame.tracks[(size_t)i];
+      appendMeter(state.meterMessage, reading.peak, reading.truePeak, reading.rms);
+    }
+    conn.send_binary(state.meterMessage);
+    return;
+  }
+
+  auto toVar = [](const MeterReading& reading) {
+    juce::Array<juce::var> values;
+    values.add(reading.peak);
+    values.add(reading.truePeak);
+    values.add(reading.rms);
+    return juce::var(values);
+  };
+
+  juce::Array<juce::var> master;
+  for (const auto& reading : frame.master) {
+    master.add(toVar(reading));
+  }
+  juce::Array<juce::var> tracks;
+  for (int i = 0; i < frame.numTracks; ++i) {
+    tracks.add(toVar(frame.tracks[(size_t)i]));
+  }
+
+  auto* message = new juce::DynamicObject();
+  message->setProperty("type", "meters");
+  message->setProperty("sequence", (juce::int64)sequence);
+  message->setProperty("position", frame.position);
+  message->setProperty("master", master);
+  message->setProperty("tracks", tracks);
+  conn.send_text(juce::JSON::toString(juce::var(message), true).toStdString());
+}
+
+void WebSocketServer::subscribeAnalysis(crow::websocket::connection& conn,
+                                        const crow::json::rvalue& message,
+                                        crow::json::wvalue& reply) {
+  auto& state = getState(conn);
+  auto& tap = engine_.getAnalysisTap();
+  reply["type"] = "error";
+
+  const int fftSize =
+      message.has("fftSize") ? static_cast<int>(message["fftSize"].i()) : 2048;
+  const int scopePoints =
+      message.has("scopePoints")
+          ? juce::jlimit(0, kMaxScopePoints,
+                         static_cast<int>(message["scopePoints"].i()))
+          : 0;
+  const double requestedRate = message.has("rate") ? message["rate"].d() : 30.0;
+  const double rate = requestedRate > 0.0
+                          ? std::min(requestedRate, kMaxAnalysisRate)
+                          : kMaxAnalysisRate;
+
+  if (state.binaryVersion == 0) {
+    reply["message"] = "Analysis frames need the binary protocol (\"hello\")";
+    return;
+  }
+  if (fftSize <= 0 && scopePoints == 0) {
+    reply["message"] = "Nothing to analyse: fftSize and scopePoints are 0";
+    return;
+  }
+
+  std::shared_ptr<AudioTrack> track;
+  if (message.has("track")) {
+    const auto index = static_cast<size_t>(message["track"].i());
+    track = engine_.getTrack(index);
+    if (track == nullptr) {
+      reply["message"] = "No track at index " + std::to_string(index);
+      return;
+    }
+  }
+
+  const std::lock_guard<std::mutex> lock(analysisMutex_);
+  if (analysisSubscriptions_.size() >= kMaxAnalysisSubscriptions) {
+    reply["message"] = "Too many analysis subscriptions";
+    return;
+  }
+
+  // Share the source of a track already tapped, or take a free one
+  int source = AnalysisTap::kMasterSource;
+  if (track != nullptr) {
+    source = -1;
+    for (int i = AnalysisTap::kMasterSource + 1; i < AnalysisTap::kNumSources; ++i) {
+      if (tap.getTrackSource(i) == track.get()) {
+        source = i;
+        break;
+      }
+      if (source < 0 && !analysisSourceActive_[(size_t)i]) {
+        source = i;
+      }
+    }
+    if (source < 0) {
+      reply["message"] = "All " + std::to_string(AnalysisTap::kMaxTrackTaps) +
+                         " track analysis slots are in use";
+      return;
+    }
+  }
+
+  if (!analysisSourceActive_[(size_t)source]) {
+    // Forget what a previous tap of this source left behind
+    tap.discard(source);
+    analysisHistories_[(size_t)source].reset();
+    analysisSourceActive_[(size_t)source] = true;
+    if (source == AnalysisTap::kMasterSource) {
+      tap.setMasterActive(true);
+    } else {
+      tap.setTrackSource(source, track.get());
+    }
+  }
+
+  auto subscription = std::make_unique<AnalysisSubscription>();
+  subscription->id = ++nextAnalysisId_;
+  subscription->conn = &conn;
+  subscription->source = source;
+  subscription->track = std::move(track);
+  if (fftSize > 0) {
+    subscription->spectrum = std::make_unique<SpectrumAnalyzer>(
+        SpectrumAnalyzer::getOrderForSize(fftSize));
+    subscription->magnitudes.resize(
+        (size_t)subscription->spectrum->getNumBins());
+  }
+  subscription->scopePoints = scopePoints;
+  subscription->minimums.resize((size_t)scopePoints);
+  subscription->maximums.resize((size_t)scopePoints);
+  subscription->samples.resize((size_t)AnalysisHistory::kCapacity);
+  subscription->scopeStart = analysisHistories_[(size_t)source].getEnd();
+  subscription->lastEnd = subscription->scopeStart;
+  subscription->period =
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / rate));
+  subscription->nextSend = std::chrono::steady_clock::now();
+
+  reply["type"] = "analysisSubscribed";
+  reply["id"] = subscription->id;
+  if (source == AnalysisTap::kMasterSource) {
+    reply["source"] = "master";
+  } else {
+    reply["track"] = static_cast<size_t>(message["track"].i());
+  }
+  reply["fftSize"] = subscription->spectrum != nullptr
+                         ? subscription->spectrum->getSize()
+                         : 0;
+  reply["scopePoints"] = scopePoints;
+  reply["rate"] = rate;
+  reply["sampleRate"] = tap.getSampleRate();
+
+  analysisSubscriptions_.push_back(std::move(subscription));
+  analysisWakeup_.notify_all();
+}
+
+bool WebSocketServer::unsubscribeAnalysis(crow::websocket::connection& conn, juce::uint32 id) {
+  const std::lock_guard<std::mutex> lock(analysisMutex_);
+  const auto removed = std::remove_if(
+      analysisSubscriptions_.begin(), analysisSubscriptions_.end(),
+      [&](const std::unique_ptr<AnalysisSubscription>& subscription) {
+        return subscription->conn == &conn && (id == 0 || subscription->id == id);
+      });
+  const bool found = removed != analysisSubscriptions_.end();
+  analysisSubscriptions_.erase(removed, analysisSubscriptions_.end());
+
+  auto& tap = engine_.getAnalysisTap();
+  for (int source = 0; source < AnalysisTap::kNumSources; ++source) {
+    const bool used = std::any_of(
+        analysisSubscriptions_.begin(), analysisSubscriptions_.end(),
+        [source](const std::unique_ptr<AnalysisSubscription>& subscription) {
+          return subscription->source == source;
+        });
+    if (used || !analysisSourceActive_[(size_t)source]) {
+      continue;
+    }
+    analysisSourceActive_[(size_t)source] = false;
+    if (source == AnalysisTap::kMasterSource) {
+      tap.setMasterActive(false);
+    } else {
+      tap.setTrackSource(source, nullptr);
+    }
+  }
+  return found;
+}
+
+void WebSocketServer::runAnalysis() {
+  // Drain often enough that the tap never overflows, even at slow rates
+  const auto drainPeriod = std::chrono::milliseconds(50);
+  std::unique_lock<std::mutex> lock(analysisMutex_);
+
+  while (running_.load()) {
+    if (analysisSubscriptions_.empty()) {
+      analysisWakeup_.wait(lock, [this] {
+        return !running_.load() || !analysisSubscriptions_.empty();
+      });
+      continue;
+    }
+
+    auto wakeup = std::chrono::steady_clock::now() + drainPeriod;
+    for (const auto& subscription : analysisSubscriptions_) {
+      wakeup = std::min(wakeup, subscription->nextSend);
+    }
+    if (analysisWakeup_.wait_until(lock, wakeup,
+                                   [this] { return !running_.load(); })) {
+      break;
+    }
+
+    auto& tap = engine_.getAnalysisTap();
+    for (int source = 0; source < AnalysisTap::kNumSources; ++source) {
+      if (analysisSourceActive_[(size_t)source]) {
+        analysisHistories_[(size_t)source].drain(tap, source);
+      }
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    for (const auto& subscription : analysisSubscriptions_) {
+      if (now < subscription->nextSend) {
+        continue;
+      }
+      subscription->nextSend =
+          std::max(subscription->nextSend + subscription->period, now);
+      sendAnalysis(*subscription, tap.getSampleRate());
+    }
+  }
+}
+
+void WebSocketServer::sendAnalysis(AnalysisSubscription& subscription, double sampleRate) {
+  using namespace ControlProtocol;
+
+  const auto& history = analysisHistories_[(size_t)subscription.source];
+  const auto end = history.getEnd();
+  if (end == subscription.lastEnd) {
+    // No new audio (device stopped): nothing new to show
+    return;
+  }
+  subscription.lastEnd = end;
+
+  AnalysisInfo info;
+  info.subscription = subscription.id;
+  info.end = end;
+  info.sampleRate = static_cast<float>(sampleRate);
+
+  if (subscription.spectrum != nullptr) {
+    auto& spectrum = *subscription.spectrum;
+    history.copyLatest(subscription.samples.data(), spectrum.getSize());
+    spectrum.process(subscription.samples.data(), subscription.magnitudes.data());
+
+    info.span = static_cast<juce::uint32>(spectrum.getSize());
+    beginAnalysisFrame(subscription.message, MessageType::Spectrum,
+                       ++subscription.sequence, info);
+    appendSpectrum(subscription.message, subscription.magnitudes.data(),
+                   spectrum.getNumBins());
+    subscription.conn->send_binary(subscription.message);
+  }
+
+  if (subscription.scopePoints > 0) {
+    const int count =
+        history.copyFrom(subscription.scopeStart, subscription.samples.data());
+    subscription.scopeStart = end;
+    const int points = std::min(count, subscription.scopePoints);
+    decimateScope(subscription.samples.data(), count,
+                  subscription.minimums.data(), subscription.maximums.data(),
+                  points);
+
+    info.span = static_cast<juce::uint32>(count);
+    beginAnalysisFrame(subscription.message, MessageType::Scope,
+                       ++subscription.sequence, info);
+    appendScope(subscription.message, subscription.minimums.data(),
+                subscription.maximums.data(), points);
+    subscription.conn->send_binary(subscription.message);
+  }
+}
+
+bool WebSocketServer::queueRender(crow::websocket::connection& conn,
+                                  OfflineRenderer::Settings settings) {
+  {
+    const std::lock_guard<std::mutex> lock(renderMutex_);
+    if (renderJobs_.size() >= kMaxQueuedRenders) {
+      return false;
+    }
+    renderJobs_.push_back({&conn, std::move(settings)});
+  }
+  renderWakeup_.notify_all();
+  return true;
+}
+
+void WebSocketServer::cancelRenders(crow::websocket::connection& conn) {
+  const std::lock_guard<std::mutex> lock(renderMutex_);
+  renderJobs_.erase(std::remove_if(renderJobs_.begin(), renderJobs_.end(),
+                                   [&conn](const RenderJob& job) {
+                                     return job.conn == &conn;
+                                   }),
+                    renderJobs_.end());
+  if (renderingConn_ == &conn) {
+    renderingConn_ = nullptr;
+  }
+}
+
+void WebSocketServer::runRenders() {
+  std::unique_lock<std::mutex> lock(renderMutex_);
+  while (running_.load()) {
+    if (renderJobs_.empty()) {
+      renderWakeup_.wait(lock);
+      continue;
+    }
+
+    auto job = std::move(renderJobs_.front());
+    renderJobs_.pop_front();
+    renderingConn_ = job.conn;
+    lock.unlock();
+
+    const auto result = engine_.renderOffline(job.settings);
+    crow::json::wvalue reply;
+    reply["path"] = job.settings.outputFile.getFullPathName().toStdString();
+    if (result.success) {
+      reply["type"] = "renderComplete";
+      reply["samples"] = result.numSamples;
+      reply["renderSeconds"] = result.renderSeconds;
+      reply["realtimeFactor"] = result.realtimeFactor;
+    } else {
+      reply["type"] = "error";
+      reply["message"] = result.errorMessage.toStdString();
+    }
+    const auto message = reply.dump();
+
+    // Sent under the lock: the connection cannot close meanwhile
+    lock.lock();
+    if (renderingConn_ != nullptr) {
+      renderingConn_->send_text(message);
+    }
+    renderingConn_ = nullptr;
+  }
+}
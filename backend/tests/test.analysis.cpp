@@ -0,0 +1,324 @@
+#include <juce_core/juce_core.h>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "../include/analysis-tap.hpp"
+#include "../include/mix-engine.hpp"
+
+/**
+ * Unit tests for AnalysisTap, AnalysisHistory, SpectrumAnalyzer and
+ * decimateScope
+ * Tests that only active sources are copied, overflow and cross-thread
+ * delivery of the FIFOs, the history windows, spectrum calibration, scope
+ * columns, and the track taps of the MixEngine
+ */
+class AnalysisTests : public juce::UnitTest {
+ public:
+  AnalysisTests() : juce::UnitTest("Analysis Tests") {}
+
+  void runTest() override {
+    beginTest("Tap copies active sources only");
+    testActiveSources();
+
+    beginTest("Tap drops samples when full");
+    testOverflow();
+
+    beginTest("Tap across threads");
+    testThreads();
+
+    beginTest("History windows");
+    testHistory();
+
+    beginTest("Spectrum of a sine");
+    testSpectrum();
+
+    beginTest("Scope columns");
+    testScope();
+
+    beginTest("MixEngine taps selected tracks");
+    testEngineTaps();
+  }
+
+ private:
+  static constexpr double kSampleRate = 48000.0;
+
+  // Outputs 1 on every sample: mixed at its volume
+  class ConstantTrack : public AudioTrack {
+   public:
+    float getSampleValue(const BeatContext&) override {
+      return 1.0f;
+    }
+
+    RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                               int numSamples, const BeatContext&) override {
+      juce::FloatVectorOperations::fill(buffer.getWritePointer(0, startSample),
+                                        1.0f, numSamples);
+      return RenderActivity::whole(numSamples);
+    }
+
+    std::unique_ptr<AudioTrack> clone() const override {
+      return std::make_unique<ConstantTrack>(*this);
+    }
+  };
+
+  void testActiveSources() {
+    AnalysisTap tap(1024);
+    juce::AudioBuffer<float> block(2, 64);
+    juce::FloatVectorOperations::fill(block.getWritePointer(0), 0.5f, 64);
+    juce::FloatVectorOperations::fill(block.getWritePointer(1), -0.25f, 64);
+
+    // Nobody listens: nothing is copied
+    tap.pushMaster(block, 0, 64);
+    std::vector<float> read(1024);
+    expectEquals(tap.read(AnalysisTap::kMasterSource, read.data(), 1024), 0);
+
+    // Mono sum of the requested span
+    tap.setMasterActive(true);
+    tap.pushMaster(block, 16, 32);
+    expectEquals(tap.read(AnalysisTap::kMasterSource, read.data(), 1024), 32);
+    expectWithinAbsoluteError(read[0], 0.125f, 1.0e-7f);
+    expectWithinAbsoluteError(read[31], 0.125f, 1.0e-7f);
+
+    // Tracks are matched by address
+    ConstantTrack first, second;
+    expect(!tap.hasTrackTaps());
+    tap.setTrackSource(2, &second);
+    expect(tap.hasTrackTaps());
+    expect(tap.getTrackSource(2) == &second);
+
+    const std::vector<float> samples(16, 0.75f);
+    tap.pushTrack(first, samples.data(), 16);
+    tap.pushTrack(second, samples.data(), 16);
+    expectEquals(tap.read(1, read.data(), 1024), 0);
+    expectEquals(tap.read(2, read.data(), 1024), 16);
+    expectEquals(read[15], 0.75f);
+
+    tap.setTrackSource(2, nullptr);
+    expect(!tap.hasTrackTaps());
+    tap.pushTrack(second, samples.data(), 16);
+    expectEquals(tap.read(2, read.data(), 1024), 0);
+  }
+
+  void testOverflow() {
+    AnalysisTap tap(256);
+    tap.setMasterActive(true);
+    juce::AudioBuffer<float> block(1, 100);
+    for (int i = 0; i < 100; ++i) {
+      block.setSample(0, i, (float)i);
+    }
+
+    // The FIFO keeps what fits; the newest samples are dropped
+    for (int i = 0; i < 4; ++i) {
+      tap.pushMaster(block, 0, 100);
+    }
+    std::vector<float> read(512);
+    const int count = tap.read(AnalysisTap::kMasterSource, read.data(), 512);
+    expect(count >= 250 && count < 256, "Kept " + juce::String(count));
+    expectEquals((int)tap.getDroppedSamples(AnalysisTap::kMasterSource),
+                 400 - count);
+    expectEquals(read[101], 1.0f);
+
+    // Discarded samples are never read
+    tap.pushMaster(block, 0, 100);
+    tap.discard(AnalysisTap::kMasterSource);
+    expectEquals(tap.read(AnalysisTap::kMasterSource, read.data(), 512), 0);
+  }
+
+  void testThreads() {
+    constexpr int blockSize = 64;
+    constexpr int numBlocks = 2000;
+    AnalysisTap tap(4096);
+    tap.setMasterActive(true);
+
+    std::thread writer([&tap] {
+      juce::AudioBuffer<float> block(1, blockSize);
+      int value = 0;
+      for (int b = 0; b < numBlocks; ++b) {
+        for (int i = 0; i < blockSize; ++i) {
+          block.setSample(0, i, (float)value++);
+        }
+        tap.pushMaster(block, 0, blockSize);
+        std::this_thread::yield();
+      }
+    });
+
+    // Whatever arrives, arrives complete and in order
+    std::vector<float> read(1024);
+    int received = 0;
+    float expected = 0.0f;
+    bool inOrder = true;
+    auto drain = [&] {
+      const int count = tap.read(AnalysisTap::kMasterSource, read.data(), 1024);
+      for (int i = 0; i < count; ++i) {
+        inOrder = inOrder && read[(size_t)i] >= expected;
+        expected = read[(size_t)i] + 1.0f;
+      }
+      received += count;
+    };
+    while (received + (int)tap.getDroppedSamples(AnalysisTap::kMasterSource) <
+           blockSize * numBlocks) {
+      drain();
+    }
+    writer.join();
+    drain();
+
+    expect(inOrder, "Samples out of order");
+    expectEquals(received +
+                     (int)tap.getDroppedSamples(AnalysisTap::kMasterSource),
+                 blockSize * numBlocks);
+  }
+
+  void testHistory() {
+    AnalysisHistory history;
+    std::vector<float> ramp(1000);
+    for (int i = 0; i < 1000; ++i) {
+      ramp[(size_t)i] = (float)i;
+    }
+
+    // Silence before the first sample
+    history.append(ramp.data(), 10);
+    std::vector<float> window(16, -1.0f);
+    history.copyLatest(window.data(), 16);
+    expectEquals(window[5], 0.0f);
+    expectEquals(window[6], 0.0f);
+    expectEquals(window[15], 9.0f);
+
+    // Wraps around the capacity, keeping the newest samples
+    const int total = AnalysisHistory::kCapacity + 500;
+    while ((int)history.getEnd() < total) {
+      const int count = juce::jmin(1000, total - (int)history.getEnd());
+      for (int i = 0; i < count; ++i) {
+        ramp[(size_t)i] = (float)(history.getEnd() + (juce::uint64)i);
+      }
+      history.append(ramp.data(), count);
+    }
+    expectEquals((int)history.getStart(), 500);
+
+    history.copyLatest(window.data(), 16);
+    expectEquals(window[0], (float)(total - 16));
+    expectEquals(window[15], (float)(total - 1));
+
+    // Reading from before the start begins at the oldest sample kept
+    std::vector<float> all((size_t)AnalysisHistory::kCapacity);
+    expectEquals(history.copyFrom(0, all.data()), AnalysisHistory::kCapacity);
+    expectEquals(all[0], 500.0f);
+    expectEquals(history.copyFrom((juce::uint64)total - 3, all.data()), 3);
+    expectEquals(all[2], (float)(total - 1));
+
+    // From a tap
+    AnalysisTap tap(1024);
+    tap.setMasterActive(true);
+    juce::AudioBuffer<float> block(1, 300);
+    block.clear();
+    block.setSample(0, 299, 0.5f);
+    tap.pushMaster(block, 0, 300);
+    history.reset();
+    history.drain(tap, AnalysisTap::kMasterSource);
+    expectEquals((int)history.getEnd(), 300);
+    history.copyLatest(window.data(), 1);
+    expectEquals(window[0], 0.5f);
+  }
+
+  void testSpectrum() {
+    expectEquals(SpectrumAnalyzer::getOrderForSize(100), SpectrumAnalyzer::kMinOrder);
+    expectEquals(SpectrumAnalyzer::getOrderForSize(1024), 10);
+    expectEquals(SpectrumAnalyzer::getOrderForSize(1000), 10);
+    expectEquals(SpectrumAnalyzer::getOrderForSize(1 << 20), SpectrumAnalyzer::kMaxOrder);
+
+    SpectrumAnalyzer analyzer(10);
+    expectEquals(analyzer.getSize(), 1024);
+    expectEquals(analyzer.getNumBins(), 513);
+
+    // Full-scale sine centred on bin 64
+    std::vector<float> samples(1024);
+    for (int i = 0; i < 1024; ++i) {
+      samples[(size_t)i] =
+          (float)std::sin(2.0 * juce::MathConstants<double>::pi * 64.0 * i / 1024.0);
+    }
+    std::vector<float> bins(513);
+    analyzer.process(samples.data(), bins.data());
+
+    expectWithinAbsoluteError(bins[64], 0.0f, 0.1f);
+    expect(bins[63] < bins[64] - 5.0f && bins[65] < bins[64] - 5.0f,
+           "Neighbouring bins below the peak");
+    expect(bins[200] < -60.0f, "Far bin leaks " + juce::String(bins[200]));
+
+    // Half amplitude reads -6 dB; the input is left untouched
+    for (auto& sample : samples) {
+      sample *= 0.5f;
+    }
+    const float input = samples[100];
+    analyzer.process(samples.data(), bins.data());
+    expectWithinAbsoluteError(bins[64], -6.02f, 0.1f);
+    expectEquals(samples[100], input);
+
+    // Silence sits on the floor
+    std::fill(samples.begin(), samples.end(), 0.0f);
+    analyzer.process(samples.data(), bins.data());
+    expectEquals(bins[64], SpectrumAnalyzer::kFloorDb);
+  }
+
+  void testScope() {
+    // Columns take the extremes of their own samples
+    const float samples[] = {0.1f, -0.5f, 0.3f, 0.9f, -0.2f, 0.0f, 0.4f, -0.8f};
+    float minimums[4], maximums[4];
+    decimateScope(samples, 8, minimums, maximums, 4);
+    expectEquals(minimums[0], -0.5f);
+    expectEquals(maximums[0], 0.1f);
+    expectEquals(minimums[1], 0.3f);
+    expectEquals(maximums[1], 0.9f);
+    expectEquals(minimums[3], -0.8f);
+    expectEquals(maximums[3], 0.4f);
+
+    // Uneven division: every sample belongs to exactly one column
+    float lows[3], highs[3];
+    decimateScope(samples, 8, lows, highs, 3);
+    expectEquals(lows[0], -0.5f);
+    expectEquals(highs[1], 0.9f);
+    expectEquals(lows[2], -0.8f);
+
+    // One sample per column
+    decimateScope(samples, 4, minimums, maximums, 4);
+    expectEquals(minimums[3], 0.9f);
+    expectEquals(maximums[3], 0.9f);
+  }
+
+  void testEngineTaps() {
+    constexpr int blockSize = 256;
+    for (const int threads : {0, 2}) {
+      MixEngine engine(threads);
+      engine.setParallelTrackThreshold(2);
+      AnalysisTap tap;
+      engine.setAnalysisTap(&tap);
+
+      std::vector<std::shared_ptr<ConstantTrack>> tracks;
+      for (int i = 0; i < 4; ++i) {
+        tracks.push_back(std::make_shared<ConstantTrack>());
+        tracks.back()->setVolume(0.1f * (float)(i + 1));
+        engine.addTrack(tracks.back());
+      }
+      engine.prepare(blockSize, kSampleRate);
+      juce::AudioBuffer<float> output(2, blockSize);
+
+      // Not tapped: nothing copied
+      engine.process(output, 0, blockSize);
+      std::vector<float> read(4096);
+      expectEquals(tap.read(1, read.data(), 4096), 0);
+
+      tap.setTrackSource(1, tracks[2].get());
+      tap.setTrackSource(3, tracks[0].get());
+      engine.process(output, 0, blockSize);
+      engine.process(output, 0, blockSize);
+
+      // Each tapped track, complete and unmixed
+      expectEquals(tap.read(1, read.data(), 4096), 2 * blockSize);
+      expectWithinAbsoluteError(read[0], 0.3f, 1.0e-6f);
+      expectWithinAbsoluteError(read[2 * blockSize - 1], 0.3f, 1.0e-6f);
+      expectEquals(tap.read(3, read.data(), 4096), 2 * blockSize);
+      expectWithinAbsoluteError(read[blockSize], 0.1f, 1.0e-6f);
+      expectEquals(tap.read(2, read.data(), 4096), 0);
+    }
+  }
+};
+
+static AnalysisTests analysisTests;
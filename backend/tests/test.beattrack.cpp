@@ -1,6 +1,8 @@
 #include <juce_core/juce_core.h>
 #include "../include/beat-track.hpp"
-#include "../include/audio-context.hpp"
+#include "../include/mix-engine.hpp"
+#include "../include/tempo-map.hpp"
+#include "../include/transport.hpp"
 #include <cmath>
 
 /**
@@ -38,19 +40,49 @@ public:
 
     beginTest("Silence between beats");
     testSilenceBetweenBeats();
+
+    beginTest("Block rendering matches per-sample values");
+    testBlockMatchesPerSample();
+
+    beginTest("No drift after hours of playback");
+    testNoDrift();
+
+    beginTest("Reported activity");
+    testActivity();
+
+    beginTest("Mixing only the active range");
+    testMixActiveRange();
   }
 
 private:
+  // A BeatTrack reporting signal everywhere, as tracks without activity
+  // reporting would
+  class AlwaysActiveTrack : public BeatTrack {
+   public:
+    using BeatTrack::BeatTrack;
+
+    RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                               int numSamples, const BeatContext& context) override {
+      BeatTrack::renderBlock(buffer, startSample, numSamples, context);
+      return RenderActivity::whole(numSamples);
+    }
+  };
+
+  // Context of the sample closest to a time
+  static BeatContext at(const TempoMap& map, double seconds) {
+    return map.getContext(
+        (juce::int64)std::llround(seconds * map.getSampleRate()));
+  }
+
   void testInitialization() {
     BeatTrack track(440.0f);
-    auto& ctx = AudioContext::getInstance();
-    ctx.sampleRate = 44100.0;
+    const TempoMap map(120.0, 44100.0);
     
     // Track should be initialized and not muted - check RMS over a period
     float sumSquares = 0.0f;
     int numSamples = 100;
     for (int i = 0; i < numSamples; ++i) {
-      float sample = track.getSampleValue(i / 44100.0);
+      float sample = track.getSampleValue(at(map, i / 44100.0));
       sumSquares += sample * sample;
     }
     float rms = std::sqrt(sumSquares / numSamples);
@@ -59,15 +91,13 @@ private:
 
   void testAttackPhase() {
     BeatTrack track(440.0f);
-    auto& ctx = AudioContext::getInstance();
-    ctx.sampleRate = 44100.0;
-    ctx.tempoBPM = 120.0f;
+    const TempoMap map(120.0, 44100.0);
 
     // During attack phase, RMS volume should increase
     auto getRMS = [&](double time, int samples = 50) {
       float sum = 0.0f;
       for (int i = 0; i < samples; ++i) {
-        float s = track.getSampleValue(time + i / 44100.0);
+        float s = track.getSampleValue(at(map, time + i / 44100.0));
         sum += s * s;
       }
       return std::sqrt(sum / samples);
@@ -83,15 +113,13 @@ private:
 
   void testDecayPhase() {
     BeatTrack track(440.0f);
-    auto& ctx = AudioContext::getInstance();
-    ctx.sampleRate = 44100.0;
-    ctx.tempoBPM = 120.0f;
+    const TempoMap map(120.0, 44100.0);
 
     // After attack (10ms), during decay (20ms), RMS volume should decrease
     auto getRMS = [&](double time, int samples = 50) {
       float sum = 0.0f;
       for (int i = 0; i < samples; ++i) {
-        float s = track.getSampleValue(time + i / 44100.0);
+        float s = track.getSampleValue(at(map, time + i / 44100.0));
         sum += s * s;
       }
       return std::sqrt(sum / samples);
@@ -105,15 +133,13 @@ private:
 
   void testSustainPhase() {
     BeatTrack track(440.0f);
-    auto& ctx = AudioContext::getInstance();
-    ctx.sampleRate = 44100.0;
-    ctx.tempoBPM = 120.0f;
+    const TempoMap map(120.0, 44100.0);
 
     // During sustain phase, RMS volume should remain relatively constant
     auto getRMS = [&](double time, int samples = 100) {
       float sum = 0.0f;
       for (int i = 0; i < samples; ++i) {
-        float s = track.getSampleValue(time + i / 44100.0);
+        float s = track.getSampleValue(at(map, time + i / 44100.0));
         sum += s * s;
       }
       return std::sqrt(sum / samples);
@@ -128,14 +154,12 @@ private:
 
   void testReleasePhase() {
     BeatTrack track(440.0f);
-    auto& ctx = AudioContext::getInstance();
-    ctx.sampleRate = 44100.0;
-    ctx.tempoBPM = 120.0f;
+    const TempoMap map(120.0, 44100.0);
 
     // After note duration (150ms), during release (20ms), volume should decrease to 0
-    float sampleStartRelease = std::abs(track.getSampleValue(0.151));  // Start of release
-    float sampleMidRelease = std::abs(track.getSampleValue(0.160));    // Mid release
-    float sampleEndRelease = std::abs(track.getSampleValue(0.170));    // End of release
+    float sampleStartRelease = std::abs(track.getSampleValue(at(map, 0.151)));  // Start of release
+    float sampleMidRelease = std::abs(track.getSampleValue(at(map, 0.160)));    // Mid release
+    float sampleEndRelease = std::abs(track.getSampleValue(at(map, 0.170)));    // End of release
 
     expect(sampleMidRelease < sampleStartRelease, "Volume should decrease during release");
     expect(sampleEndRelease < sampleMidRelease, "Volume should continue decreasing during release");
@@ -144,15 +168,13 @@ private:
 
   void testBeatTiming() {
     BeatTrack track(440.0f);
-    auto& ctx = AudioContext::getInstance();
-    ctx.sampleRate = 44100.0;
-    ctx.tempoBPM = 120.0f;  // 120 BPM = 0.5 second per beat
+    const TempoMap map(120.0, 44100.0);  // 120 BPM = 0.5 second per beat
 
     // Check RMS at beat starts
     auto getRMS = [&](double time, int samples = 100) {
       float sum = 0.0f;
       for (int i = 0; i < samples; ++i) {
-        float s = track.getSampleValue(time + i / 44100.0);
+        float s = track.getSampleValue(at(map, time + i / 44100.0));
         sum += s * s;
       }
       return std::sqrt(sum / samples);
@@ -167,83 +189,254 @@ private:
     expect(beat3RMS > 0.01f, "Third beat should start at t=1.0");
   }
 
+  // RMS of the first beat, mixed by an engine (left channel, master 0.5)
+  static float getMixedRMS(float volume, bool mute) {
+    constexpr int blockSize = 2048;
+    MixEngine engine(0);
+    auto track = std::make_shared<BeatTrack>(440.0f);
+    track->setVolume(volume);
+    track->setMute(mute);
+    engine.addTrack(track);
+    engine.prepare(blockSize, 44100.0);
+
+    juce::AudioBuffer<float> output(2, blockSize);
+    engine.process(output, 0, blockSize);
+    return output.getRMSLevel(0, 0, blockSize);
+  }
+
   void testVolumeControl() {
     BeatTrack track(440.0f);
-    auto& ctx = AudioContext::getInstance();
-    ctx.sampleRate = 44100.0;
+    const TempoMap map(120.0, 44100.0);
 
     auto getRMS = [&](int samples = 200) {
       float sum = 0.0f;
       for (int i = 0; i < samples; ++i) {
-        float s = track.getSampleValue(0.05 + i / 44100.0);
+        float s = track.getSampleValue(at(map, 0.05 + i / 44100.0));
         sum += s * s;
       }
       return std::sqrt(sum / samples);
     };
 
-    // Test default volume
-    float rmsDefault = getRMS();
-
-    // Set volume to 0.2 (50% of default 0.4)
+    // The track renders dry: volume is applied by the mixer
+    float rmsDry = getRMS();
     track.setVolume(0.2f);
-    float rmsLow = getRMS();
+    expectEquals(getRMS(), rmsDry);
 
-    // Set volume to 0.8 (200% of default 0.4)
-    track.setVolume(0.8f);
-    float rmsHigh = getRMS();
-
-    expect(rmsLow < rmsDefault * 0.9f, "Lower volume should produce quieter sound");
-    expect(rmsHigh > rmsDefault * 1.1f, "Higher volume should produce louder sound");
+    // Default volume 0.4; 0.2 and 0.8 are half and twice as loud
+    const float rmsDefault = getMixedRMS(0.4f, false);
+    expect(rmsDefault > 0.01f);
+    expectWithinAbsoluteError(getMixedRMS(0.2f, false) / rmsDefault, 0.5f, 1.0e-4f);
+    expectWithinAbsoluteError(getMixedRMS(0.8f, false) / rmsDefault, 2.0f, 1.0e-4f);
 
     // Test volume clamping
     track.setVolume(2.0f);  // Should clamp to 1.0
-    float rmsClamped = getRMS();
-    expect(rmsClamped <= rmsHigh * 1.5f, "Volume should be clamped to valid range");
+    expectEquals(track.volume, 1.0f);
   }
 
   void testMute() {
     BeatTrack track(440.0f);
-    auto& ctx = AudioContext::getInstance();
-    ctx.sampleRate = 44100.0;
+    const TempoMap map(120.0, 44100.0);
 
     auto getRMS = [&](int samples = 200) {
       float sum = 0.0f;
       for (int i = 0; i < samples; ++i) {
-        float s = track.getSampleValue(0.05 + i / 44100.0);
+        float s = track.getSampleValue(at(map, 0.05 + i / 44100.0));
         sum += s * s;
       }
       return std::sqrt(sum / samples);
     };
 
-    // Track should produce sound when not muted
-    float rmsUnmuted = getRMS();
-    expect(rmsUnmuted > 0.01f, "Track should produce sound when not muted");
-
-    // Track should be silent when muted
+    // Muted tracks keep rendering (dry), so they stay in time when unmuted
     track.setMute(true);
-    float rmsMuted = getRMS();
-    expect(rmsMuted == 0.0f, "Track should be silent when muted");
+    expect(getRMS() > 0.01f, "Mute is applied by the mixer");
 
-    // Track should produce sound again when unmuted
-    track.setMute(false);
-    float rmsUnmutedAgain = getRMS();
-    expect(rmsUnmutedAgain > 0.01f, "Track should produce sound when unmuted again");
+    // Track should produce sound when not muted, and be silent when muted
+    expect(getMixedRMS(0.4f, false) > 0.01f, "Track should produce sound when not muted");
+    expectEquals(getMixedRMS(0.4f, true), 0.0f);
   }
 
   void testSilenceBetweenBeats() {
     BeatTrack track(440.0f);
-    auto& ctx = AudioContext::getInstance();
-    ctx.sampleRate = 44100.0;
-    ctx.tempoBPM = 120.0f;  // 120 BPM = 0.5 second per beat
+    const TempoMap map(120.0, 44100.0);  // 120 BPM = 0.5 second per beat
 
     // After release phase (150ms + 20ms = 170ms), there should be silence
-    float sampleSilence = track.getSampleValue(0.200);  // 200ms into the beat
+    float sampleSilence = track.getSampleValue(at(map, 0.200));  // 200ms into the beat
     expect(std::abs(sampleSilence) < 0.01f, "Should be silent between beats");
 
     // Just before next beat (at 0.49s), should still be silent
-    float sampleBeforeNextBeat = track.getSampleValue(0.49);
+    float sampleBeforeNextBeat = track.getSampleValue(at(map, 0.49));
     expect(std::abs(sampleBeforeNextBeat) < 0.01f, "Should be silent before next beat");
   }
+
+  void testBlockMatchesPerSample() {
+    // Fractional beat length (20353.85 samples), then a ramp to 90 BPM and
+    // a 7/8 bar so the tempo map changes mid-playback
+    TempoMap map(130.0, 44100.0);
+    map.setTempo(4.0, 130.0, true);
+    map.setTempo(6.0, 90.0);
+    map.setTimeSignature(2, 7, 8);
+
+    // Odd block sizes put beat boundaries and note ends mid-block
+    for (int blockSize : {1, 37, 512, 4096}) {
+      BeatTrack track(440.0f);
+      juce::AudioBuffer<float> buffer(1, blockSize);
+      Transport transport;
+      float maxError = 0.0f;
+
+      while (transport.getPosition() < 6 * 44100) {
+        int numSamples = blockSize;
+        const BeatContext context = transport.getContext(map, numSamples);
+        track.renderBlock(buffer, 0, numSamples, context);
+
+        for (int i = 0; i < numSamples; ++i) {
+          const float expected =
+              track.getSampleValue(map.getContext(context.sample + i));
+          maxError = juce::jmax(maxError, std::abs(buffer.getSample(0, i) - expected));
+        }
+        transport.advance(numSamples);
+      }
+
+      expect(maxError < 1.0e-4f, "Block size " + juce::String(blockSize) +
+                                     " differs by " + juce::String(maxError));
+    }
+  }
+
+  void testNoDrift() {
+    const TempoMap map(130.0, 48000.0);
+
+    constexpr int blockSize = 480;
+    const double samplesPerBeat = 48000.0 * 60.0 / 130.0;
+    const juce::int64 sessionStart = 6 * 3600 * 48000LL;  // 6 hours in
+
+    // One minute of continuous playback, six hours into the session
+    BeatTrack track(440.0f);
+    juce::AudioBuffer<float> buffer(1, blockSize);
+    bool onGrid = true;
+    int beats = 0;
+    float previous = 0.0f;
+
+    for (juce::int64 sample = sessionStart; sample < sessionStart + 60 * 48000;
+         sample += blockSize) {
+      track.renderBlock(buffer, 0, blockSize, map.getContext(sample));
+
+      for (int i = 0; i < blockSize; ++i) {
+        const float current = buffer.getSample(0, i);
+        const juce::int64 position = sample + i;
+
+        // Notes start from zero (sine and attack both at 0), so the first
+        // non-zero sample follows the beat start ceil(k * beat) by one
+        if (previous == 0.0f && current != 0.0f) {
+          const juce::int64 onset = position - 1;
+          const auto beat = (juce::int64)std::llround(onset / samplesPerBeat);
+          onGrid = onGrid &&
+                   onset == (juce::int64)std::ceil(beat * samplesPerBeat);
+          ++beats;
+        }
+        previous = current;
+      }
+    }
+
+    expect(onGrid, "Every beat should start exactly on the sample grid");
+    expect(beats >= 129 && beats <= 131,
+           "One minute at 130 BPM should hold 130 beats, got " + juce::String(beats));
+
+    // A track jumping straight to the end agrees with the one that played
+    BeatTrack fresh(440.0f);
+    juce::AudioBuffer<float> freshBuffer(1, blockSize);
+    const juce::int64 last = sessionStart + 60 * 48000;
+    track.renderBlock(buffer, 0, blockSize, map.getContext(last));
+    fresh.renderBlock(freshBuffer, 0, blockSize, map.getContext(last));
+
+    float maxError = 0.0f;
+    for (int i = 0; i < blockSize; ++i) {
+      maxError = juce::jmax(maxError, std::abs(buffer.getSample(0, i) -
+                                               freshBuffer.getSample(0, i)));
+    }
+    expect(maxError < 1.0e-4f, "Continuous and resynced playback differ by " +
+                                   juce::String(maxError));
+  }
+
+  void testActivity() {
+    // 120 BPM: a 170 ms note every 500 ms
+    const TempoMap map(120.0, 44100.0);
+
+    for (int blockSize : {37, 512, 4096}) {
+      BeatTrack track(440.0f);
+      juce::AudioBuffer<float> buffer(1, blockSize);
+      Transport transport;
+      int silentBlocks = 0;
+      int outside = 0;
+      juce::int64 activeSamples = 0;
+
+      while (transport.getPosition() < 4 * 44100) {
+        const RenderActivity activity =
+            track.renderBlock(buffer, 0, blockSize, transport.getContext(map, blockSize));
+        silentBlocks += activity.isSilent() ? 1 : 0;
+
+        for (int i = 0; i < blockSize; ++i) {
+          const bool active = i >= activity.start && i < activity.end;
+          outside += !active && buffer.getSample(0, i) != 0.0f ? 1 : 0;
+        }
+        activeSamples += activity.getLength();
+        transport.advance(blockSize);
+      }
+
+      const juce::String size(blockSize);
+      expectEquals(outside, 0, "Signal outside the range, block size " + size);
+      // The range follows the notes, not the blocks: 170 ms out of 500
+      expect(activeSamples < transport.getPosition() * 2 / 5,
+             "Active samples " + juce::String(activeSamples) + ", block size " + size);
+      expect(silentBlocks > 0, "Blocks between notes are silent, block size " + size);
+    }
+
+    // Tails: the release is still active past the note off
+    BeatTrack track(440.0f);
+    juce::AudioBuffer<float> buffer(1, 64);
+    const auto noteOff = (juce::int64)std::ceil(0.15 * 44100.0);
+    const RenderActivity release =
+        track.renderBlock(buffer, 0, 64, map.getContext(noteOff + 100));
+    expect(!release.isSilent(), "The release belongs to the active range");
+  }
+
+  void testMixActiveRange() {
+    // Mixing only the reported range must not change the mix
+    const TempoMap map(133.0, 44100.0);
+    MixEngine sparse(0);
+    MixEngine dense(0);
+    for (float frequency : {220.0f, 330.0f, 550.0f}) {
+      sparse.addTrack(std::make_shared<BeatTrack>(frequency));
+      dense.addTrack(std::make_shared<AlwaysActiveTrack>(frequency));
+    }
+
+    constexpr int blockSize = 300;
+    juce::AudioBuffer<float> sparseOutput(2, blockSize);
+    juce::AudioBuffer<float> denseOutput(2, blockSize);
+    for (auto* engine : {&sparse, &dense}) {
+      engine->prepare(blockSize, 44100.0);
+      engine->setTempoMap(map);
+      engine->getTrack(1)->setPan(-0.5f);
+    }
+
+    int differences = 0;
+    for (int block = 0; block < 4 * 44100 / blockSize; ++block) {
+      if (block == 100) {
+        // A ramp running across active and silent blocks
+        sparse.getTrack(0)->setVolume(0.9f);
+        dense.getTrack(0)->setVolume(0.9f);
+      }
+      sparse.process(sparseOutput, 0, blockSize);
+      dense.process(denseOutput, 0, blockSize);
+      for (int channel = 0; channel < 2; ++channel) {
+        for (int i = 0; i < blockSize; ++i) {
+          differences += std::abs(sparseOutput.getSample(channel, i) -
+                                  denseOutput.getSample(channel, i)) > 1.0e-6f
+                             ? 1
+                             : 0;
+        }
+      }
+    }
+    expectEquals(differences, 0);
+  }
 };
 
 static BeatTrackTests beatTrackTests;
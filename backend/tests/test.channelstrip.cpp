@@ -0,0 +1,442 @@
+#include <juce_core/juce_core.h>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "../include/beat-track.hpp"
+#include "../include/channel-strip.hpp"
+#include "../include/mix-engine.hpp"
+
+/**
+ * Unit tests for ChannelStrip and the MixEngine track mix
+ * Tests the pan law, smoothed ramps across spans, the vector kernel against
+ * the scalar one (with the levels measured by both), stereo tracks, skipped
+ * muted tracks, and serial and parallel mixes agreeing bit for bit
+ */
+class ChannelStripTests : public juce::UnitTest {
+ public:
+  ChannelStripTests() : juce::UnitTest("ChannelStrip Tests") {}
+
+  void runTest() override {
+    beginTest("Constant-power pan law");
+    testPanLaw();
+
+    beginTest("Parameter changes ramp over the smoothing time");
+    testRamps();
+
+    beginTest("Vector mix matches the scalar mix");
+    testVectorMatchesScalar();
+
+    beginTest("Fader then unity mix matches the fused mix");
+    testSplitFader();
+
+    beginTest("MixEngine applies volume and pan");
+    testEnginePan();
+
+    beginTest("Stereo tracks");
+    testStereoTrack();
+
+    beginTest("Muted tracks are not mixed");
+    testMutedTrack();
+
+    beginTest("Parallel mix matches serial mix");
+    testParallelMatchesSerial();
+  }
+
+ private:
+  static constexpr double kSampleRate = 44100.0;
+
+  // Outputs a constant on each channel: mixed at its volume and pan
+  class ConstantTrack : public AudioTrack {
+   public:
+    ConstantTrack(float left, float right, int numChannels)
+        : left(left), right(right), numChannels(numChannels) {}
+
+    float getSampleValue(const BeatContext&) override { return left; }
+
+    RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                               int numSamples, const BeatContext&) override {
+      juce::FloatVectorOperations::fill(buffer.getWritePointer(0, startSample), left,
+                                        numSamples);
+      if (numChannels > 1) {
+        juce::FloatVectorOperations::fill(buffer.getWritePointer(1, startSample), right,
+                                          numSamples);
+      }
+      return RenderActivity::whole(numSamples);
+    }
+
+    int getNumOutputChannels() const override { return numChannels; }
+
+    std::unique_ptr<AudioTrack> clone() const override {
+      return std::make_unique<ConstantTrack>(*this);
+    }
+
+   private:
+    float left;
+    float right;
+    int numChannels;
+  };
+
+  // Pseudo-random samples in [-1, 1)
+  static void fillNoise(std::vector<float>& samples, juce::Random& random) {
+    for (auto& sample : samples) {
+      sample = random.nextFloat() * 2.0f - 1.0f;
+    }
+  }
+
+  static bool sameBits(const std::vector<float>& a, const std::vector<float>& b) {
+    return a.size() == b.size() &&
+           std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+  }
+
+  void testPanLaw() {
+    float left = 0.0f;
+    float right = 0.0f;
+    ChannelStrip::getPanGains(0.0f, left, right);
+    expect(left == 1.0f && right == 1.0f, "Centred tracks are mixed at unity");
+
+    ChannelStrip::getPanGains(-1.0f, left, right);
+    expectWithinAbsoluteError(left, std::sqrt(2.0f), 1.0e-6f);
+    expectEquals(right, 0.0f);
+    ChannelStrip::getPanGains(2.0f, left, right);
+    expect(left == 0.0f && right > 1.41f, "Pan is clamped to hard right");
+
+    // Same power at every position
+    for (float pan = -1.0f; pan <= 1.0f; pan += 0.125f) {
+      ChannelStrip::getPanGains(pan, left, right);
+      expectWithinAbsoluteError(left * left + right * right, 2.0f, 1.0e-5f);
+    }
+  }
+
+  void testRamps() {
+    constexpr int smoothing = 100;
+    ChannelStrip strip;
+
+    // First span: directly at the parameters
+    auto gains = strip.advance(0.5f, 0.0f, false, 64, smoothing);
+    expect(gains.fader.isConstant() && gains.fader.end == 0.5f);
+    expect(!strip.isSilent());
+
+    // Ramp to 0.25 over spans of odd lengths: linear, then exactly on target
+    std::vector<float> faders;
+    for (int span : {7, 64, 13, 50, 30}) {
+      gains = strip.advance(0.25f, 0.0f, false, span, smoothing);
+      for (int i = 0; i < span; ++i) {
+        faders.push_back(gains.fader.at(i));
+      }
+    }
+    expectEquals(faders[0], 0.5f);
+    float largestStep = 0.0f;
+    bool decreasing = true;
+    for (size_t i = 1; i < (size_t)smoothing; ++i) {
+      largestStep = juce::jmax(largestStep, std::abs(faders[i] - faders[i - 1]));
+      decreasing = decreasing && faders[i] < faders[i - 1];
+    }
+    expect(decreasing, "Gain moves towards the target on every sample");
+    expect(largestStep < 0.25f / smoothing * 1.01f,
+           "No jump larger than the ramp slope: " + juce::String(largestStep));
+    for (size_t i = smoothing; i < faders.size(); ++i) {
+      expectEquals(faders[i], 0.25f);
+    }
+
+    // Mute fades out, then the strip is silent
+    gains = strip.advance(0.25f, 0.0f, true, 64, smoothing);
+    expect(!strip.isSilent() && gains.fader.start == 0.25f);
+    strip.advance(0.25f, 0.0f, true, 64, smoothing);
+    expect(!strip.isSilent(), "Still fading");
+    strip.advance(0.25f, 0.0f, true, 64, smoothing);
+    expect(strip.isSilent());
+
+    // Pan ramps too
+    gains = strip.advance(0.25f, 1.0f, false, smoothing, smoothing);
+    expect(gains.left.start == 1.0f && gains.left.end == 0.0f);
+    expectEquals(gains.left.at(smoothing / 2), 0.5f);
+
+    // reset() jumps
+    strip.reset();
+    gains = strip.advance(1.0f, 0.0f, false, 16, smoothing);
+    expect(gains.fader.isConstant() && gains.left.isConstant());
+  }
+
+  void testVectorMatchesScalar() {
+    juce::Random random(19);
+    StripGains gains;
+    gains.fader = {0.1f, 0.003f, 0.4f, 100};
+    gains.left = {1.2f, -0.004f, 0.9f, 77};
+    gains.right = GainRamp::constant(0.7f);
+
+    bool identical = true;
+    for (int numSamples : {1, 3, 4, 31, 256, 1023}) {
+      for (int channels = 1; channels <= 2; ++channels) {
+        for (bool store : {false, true}) {
+          std::vector<float> input[2];
+          for (auto& channel : input) {
+            channel.resize((size_t)numSamples);
+            fillNoise(channel, random);
+          }
+          std::vector<float> bus(2 * (size_t)numSamples);
+          fillNoise(bus, random);
+
+          std::vector<float> vectorBus = bus;
+          std::vector<float> scalarBus = bus;
+          std::vector<float> vectorPost[2] = {input[0], input[1]};
+          std::vector<float> scalarPost[2] = {input[0], input[1]};
+          SpanLevels vectorLevels[2];
+          SpanLevels scalarLevels[2];
+
+          // Measured whether stored or not, like the engine's metered tracks
+          auto makeJob = [&](std::vector<float>& mix, std::vector<float>* post,
+                             SpanLevels* levels) {
+            ChannelStrip::MixJob job;
+            for (int channel = 0; channel < channels; ++channel) {
+              job.input[channel] = post[channel].data();
+              job.postFader[channel] = store ? post[channel].data() : nullptr;
+            }
+            job.levels = levels;
+            job.left = mix.data();
+            job.right = mix.data() + numSamples;
+            job.numSamples = numSamples;
+            job.gains = gains;
+            return job;
+          };
+
+          // In place, like the engine
+          ChannelStrip::mix(makeJob(vectorBus, vectorPost, vectorLevels));
+          ChannelStrip::mixScalar(makeJob(scalarBus, scalarPost, scalarLevels));
+          identical = identical && sameBits(vectorBus, scalarBus) &&
+                      sameBits(vectorPost[0], scalarPost[0]) &&
+                      sameBits(vectorPost[1], scalarPost[1]);
+          for (int channel = 0; channel < channels; ++channel) {
+            identical = identical &&
+                        std::memcmp(&vectorLevels[channel], &scalarLevels[channel],
+                                    sizeof(SpanLevels)) == 0;
+          }
+
+          // The levels are those of the post-fader signal
+          for (int channel = 0; channel < channels; ++channel) {
+            float peak = 0.0f;
+            int peakIndex = 0;
+            double sumSquares = 0.0;
+            for (int i = 0; i < numSamples; ++i) {
+              const float post = input[channel][(size_t)i] * gains.fader.at(i);
+              if (std::abs(post) > peak) {
+                peak = std::abs(post);
+                peakIndex = i;
+              }
+              sumSquares += (double)post * post;
+            }
+            expectEquals(vectorLevels[channel].peak, peak);
+            expectEquals(vectorLevels[channel].peakIndex, peakIndex);
+            expectWithinAbsoluteError(vectorLevels[channel].sumSquares, (float)sumSquares,
+                                      1.0e-4f * (float)numSamples);
+          }
+
+          // Against a plain reference, within rounding
+          float maxError = 0.0f;
+          for (int i = 0; i < numSamples; ++i) {
+            const float left = input[0][(size_t)i] * gains.fader.at(i);
+            const float right =
+                (channels > 1 ? input[1][(size_t)i] : input[0][(size_t)i]) *
+                gains.fader.at(i);
+            maxError = juce::jmax(
+                maxError,
+                std::abs(vectorBus[(size_t)i] - (bus[(size_t)i] + left * gains.left.at(i))),
+                std::abs(vectorBus[(size_t)(numSamples + i)] -
+                         (bus[(size_t)(numSamples + i)] + right * gains.right.at(i))));
+          }
+          expect(maxError < 1.0e-6f, "Error " + juce::String(maxError));
+        }
+      }
+    }
+    expect(identical, "Vector and scalar paths must be bit-identical");
+  }
+
+  void testSplitFader() {
+    juce::Random random(7);
+    constexpr int numSamples = 203;
+    StripGains gains;
+    gains.fader = {0.9f, -0.002f, 0.6f, 150};
+    gains.left = {0.5f, 0.001f, 0.6f, 100};
+    gains.right = {1.3f, -0.001f, 1.2f, 100};
+
+    std::vector<float> input((size_t)numSamples);
+    fillNoise(input, random);
+    std::vector<float> fused(2 * (size_t)numSamples, 0.0f);
+    std::vector<float> split = fused;
+
+    ChannelStrip::MixJob job;
+    job.input[0] = input.data();
+    job.left = fused.data();
+    job.right = fused.data() + numSamples;
+    job.numSamples = numSamples;
+    job.gains = gains;
+    ChannelStrip::mix(job);
+
+    // Worker applies the fader, the mix thread pans at unity fader
+    std::vector<float> faded = input;
+    float* const channels[1] = {faded.data()};
+    SpanLevels fadedLevels;
+    ChannelStrip::applyFader(channels, 1, numSamples, gains.fader, &fadedLevels);
+    job.input[0] = faded.data();
+    job.left = split.data();
+    job.right = split.data() + numSamples;
+    job.gains.fader = GainRamp::constant(1.0f);
+    ChannelStrip::mix(job);
+
+    expect(sameBits(fused, split), "Split fader must not change the mix");
+
+    // Measured by either pass, the levels are the same
+    SpanLevels fusedLevels;
+    std::vector<float> post = input;
+    std::vector<float> bus(2 * (size_t)numSamples, 0.0f);
+    job.input[0] = post.data();
+    job.postFader[0] = post.data();
+    job.left = bus.data();
+    job.right = bus.data() + numSamples;
+    job.gains = gains;
+    job.levels = &fusedLevels;
+    ChannelStrip::mix(job);
+    expect(std::memcmp(&fusedLevels, &fadedLevels, sizeof(SpanLevels)) == 0,
+           "Fader pass and mix must measure the same levels");
+  }
+
+  void testEnginePan() {
+    MixEngine engine(0);
+    auto track = std::make_shared<ConstantTrack>(1.0f, 0.0f, 1);
+    track->setVolume(0.8f);
+    track->setPan(1.0f);
+    engine.addTrack(track);
+    engine.prepare(256, kSampleRate);
+
+    // Hard right: nothing on the left, +3 dB on the right (master 0.5)
+    juce::AudioBuffer<float> output(2, 256);
+    engine.process(output, 0, 256);
+    expectEquals(output.getMagnitude(0, 0, 256), 0.0f);
+    expectWithinAbsoluteError(output.getSample(1, 100), 0.8f * std::sqrt(2.0f) * 0.5f,
+                              1.0e-6f);
+
+    // Centred over the smoothing time
+    EngineCommand command;
+    command.type = EngineCommand::Type::SetTrackPan;
+    command.track = track;
+    command.value = 0.0;
+    expect(engine.sendCommand(command));
+    const int smoothing = juce::roundToInt(ChannelStrip::kSmoothingSeconds * kSampleRate);
+    for (int done = 0; done <= smoothing; done += 256) {
+      engine.process(output, 0, 256);
+    }
+    expectEquals(output.getSample(0, 255), 0.4f);
+    expectEquals(output.getSample(1, 255), 0.4f);
+    expectEquals(track->pan, 0.0f);
+  }
+
+  void testStereoTrack() {
+    MixEngine engine(0);
+    auto track = std::make_shared<ConstantTrack>(0.5f, -0.25f, 2);
+    track->setVolume(1.0f);
+    engine.addTrack(track);
+    engine.prepare(512, kSampleRate);
+
+    juce::AudioBuffer<float> output(2, 512);
+    engine.process(output, 0, 512);
+    expectEquals(output.getSample(0, 10), 0.25f);
+    expectEquals(output.getSample(1, 10), -0.125f);
+
+    // One reading for both channels: highest peak, mean power RMS
+    engine.process(output, 0, 512);
+    const auto* frame = engine.readMeters();
+    expect(frame != nullptr && frame->numTracks == 1);
+    if (frame != nullptr) {
+      expectEquals(frame->tracks[0].peak, 0.5f);
+      expect(frame->tracks[0].rms > 0.0f &&
+             frame->tracks[0].rms < std::sqrt((0.25f + 0.0625f) / 2.0f) + 1.0e-4f);
+    }
+  }
+
+  void testMutedTrack() {
+    MixEngine engine(0);
+    auto track = std::make_shared<ConstantTrack>(1.0f, 0.0f, 1);
+    track->setMute(true);
+    engine.addTrack(track);
+    engine.prepare(512, kSampleRate);
+
+    juce::AudioBuffer<float> output(2, 512);
+    engine.process(output, 0, 512);
+    expectEquals(output.getMagnitude(0, 0, 512), 0.0f);
+    expect(track->strip.isSilent(), "Muted track is skipped by the mix");
+
+    engine.process(output, 0, 512);
+    const auto* frame = engine.readMeters();
+    expect(frame != nullptr && frame->tracks[0].peak == 0.0f,
+           "Muted track is metered as silence");
+
+    // Unmuting fades in
+    track->setMute(false);
+    engine.process(output, 0, 512);
+    expectEquals(output.getSample(0, 0), 0.0f);
+    expect(output.getSample(0, 1) > 0.0f && output.getSample(0, 511) < 0.2f);
+  }
+
+  void testParallelMatchesSerial() {
+    constexpr int numTracks = 12;
+    constexpr int blockSize = 256;
+
+    MixEngine serial(0);
+    MixEngine parallel(3);
+    parallel.setParallelTrackThreshold(2);
+    std::vector<std::shared_ptr<AudioTrack>> serialTracks;
+    std::vector<std::shared_ptr<AudioTrack>> parallelTracks;
+    for (int i = 0; i < numTracks; ++i) {
+      for (auto* engine : {&serial, &parallel}) {
+        auto track = std::make_shared<BeatTrack>(110.0f + 30.0f * (float)i);
+        track->setVolume(0.1f + 0.05f * (float)i);
+        track->setPan(-1.0f + (float)i / 6.0f);
+        engine->addTrack(track);
+        (engine == &serial ? serialTracks : parallelTracks).push_back(track);
+      }
+    }
+    // A stereo track
+    for (auto* engine : {&serial, &parallel}) {
+      auto track = std::make_shared<ConstantTrack>(0.3f, -0.2f, 2);
+      track->setPan(0.3f);
+      engine->addTrack(track);
+      (engine == &serial ? serialTracks : parallelTracks).push_back(track);
+    }
+    serial.prepare(blockSize, kSampleRate);
+    parallel.prepare(blockSize, kSampleRate);
+
+    juce::AudioBuffer<float> serialOutput(2, blockSize);
+    juce::AudioBuffer<float> parallelOutput(2, blockSize);
+    bool identical = true;
+    for (int block = 0; block < 100; ++block) {
+      // Volume, pan and mute changes mid-block
+      if (block % 10 == 3) {
+        for (auto* tracks : {&serialTracks, &parallelTracks}) {
+          for (auto type : {EngineCommand::Type::SetTrackVolume,
+                            EngineCommand::Type::SetTrackPan,
+                            EngineCommand::Type::SetTrackMute}) {
+            EngineCommand command;
+            command.type = type;
+            command.track = (*tracks)[(size_t)(block % numTracks)];
+            command.value = type == EngineCommand::Type::SetTrackMute
+                                ? (double)((block / 10) % 2)
+                                : 0.7 - 0.1 * (block / 10);
+            command.sample = (juce::int64)block * blockSize + 37;
+            (tracks == &serialTracks ? serial : parallel).sendCommand(command);
+          }
+        }
+      }
+
+      serial.process(serialOutput, 0, blockSize);
+      parallel.process(parallelOutput, 0, blockSize);
+      for (int channel = 0; channel < 2; ++channel) {
+        for (int i = 0; i < blockSize; ++i) {
+          identical = identical && serialOutput.getSample(channel, i) ==
+                                       parallelOutput.getSample(channel, i);
+        }
+      }
+    }
+    expect(identical, "Parallel and serial mixes must be bit-identical");
+  }
+};
+
+static ChannelStripTests channelStripTests;
@@ -0,0 +1,323 @@
+#include <juce_core/juce_core.h>
+#include <limits>
+#include <thread>
+#include <vector>
+#include "../include/command-queue.hpp"
+#include "../include/mix-engine.hpp"
+#include "../include/spsc-queue.hpp"
+
+/**
+ * Unit tests for the SpscQueue and CommandQueue classes
+ * Tests ordering and bounds, a producer/consumer stress run, commands
+ * applied by the MixEngine on their exact sample, timestamped commands
+ * sent while the transport is stopped, and waiting commands a seek jumps
+ * past
+ */
+class CommandQueueTests : public juce::UnitTest {
+ public:
+  CommandQueueTests() : juce::UnitTest("CommandQueue Tests") {}
+
+  void runTest() override {
+    beginTest("SPSC queue order and bounds");
+    testQueueBounds();
+
+    beginTest("SPSC queue across threads");
+    testQueueThreads();
+
+    beginTest("Commands apply on their sample");
+    testSampleAccurate();
+
+    beginTest("Acknowledgements return tracks to the control thread");
+    testReplies();
+
+    beginTest("Transport commands");
+    testTransport();
+
+    beginTest("Timestamped commands apply while stopped");
+    testTimestampedWhileStopped();
+
+    beginTest("Seeking past waiting commands applies them");
+    testSeekPastWaiting();
+  }
+
+ private:
+  // Outputs 1 on every sample: mixed at its volume
+  class ConstantTrack : public AudioTrack {
+   public:
+    float getSampleValue(const BeatContext&) override {
+      return 1.0f;
+    }
+
+    RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                               int numSamples, const BeatContext&) override {
+      juce::FloatVectorOperations::fill(buffer.getWritePointer(0, startSample),
+                                        1.0f, numSamples);
+      return RenderActivity::whole(numSamples);
+    }
+
+    std::unique_ptr<AudioTrack> clone() const override {
+      return std::make_unique<ConstantTrack>(*this);
+    }
+  };
+
+  // Records the smallest and largest span it is asked to render
+  class SpanTrack : public ConstantTrack {
+   public:
+    RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                               int numSamples, const BeatContext& context) override {
+      smallest = std::min(smallest, numSamples);
+      largest = std::max(largest, startSample + numSamples);
+      return ConstantTrack::renderBlock(buffer, startSample, numSamples, context);
+    }
+
+    int smallest = std::numeric_limits<int>::max();
+    int largest = 0;
+  };
+
+  void testQueueBounds() {
+    SpscQueue<int> queue(5);
+    expectEquals((int)queue.getCapacity(), 8);
+
+    int value = 0;
+    expect(!queue.tryPop(value), "New queue is empty");
+
+    bool pushed = true;
+    for (int i = 0; i < 8; ++i) {
+      pushed = pushed && queue.tryPush(int(i));
+    }
+    expect(pushed);
+    expect(!queue.tryPush(8), "Full queue refuses values");
+
+    bool ordered = true;
+    for (int i = 0; i < 8; ++i) {
+      ordered = ordered && queue.tryPop(value) && value == i;
+    }
+    expect(ordered, "Values come out in push order");
+    expect(!queue.tryPop(value));
+  }
+
+  void testQueueThreads() {
+    constexpr int count = 1000000;
+    SpscQueue<int> queue(64);
+    bool ordered = true;
+
+    std::thread consumer([&]() {
+      int expected = 0;
+      int value = 0;
+      while (expected < count) {
+        if (queue.tryPop(value)) {
+          ordered = ordered && value == expected;
+          ++expected;
+        }
+      }
+    });
+
+    for (int i = 0; i < count;) {
+      if (queue.tryPush(int(i))) {
+        ++i;
+      }
+    }
+    consumer.join();
+
+    expect(ordered, "Every value should arrive once, in order");
+    expectEquals((int)queue.getNumReady(), 0);
+  }
+
+  void testSampleAccurate() {
+    MixEngine engine(0);
+    auto track = std::make_shared<ConstantTrack>();
+    track->setVolume(1.0f);
+    engine.addTrack(track);
+    engine.prepare(512, 44100.0);
+
+    EngineCommand command;
+    command.type = EngineCommand::Type::SetTrackVolume;
+    command.track = track;
+    command.value = 0.5;
+    command.sample = 700;  // Inside the second block
+    expect(engine.sendCommand(command));
+
+    juce::AudioBuffer<float> output(2, 2048);
+    for (int block = 0; block < 4; ++block) {
+      engine.process(output, block * 512, 512);
+    }
+
+    // Master gain 0.5: 1.0 -> 0.5, then a ramp to 0.25 starting on sample
+    // 700 and lasting the smoothing time
+    const int rampEnd =
+        700 + juce::roundToInt(ChannelStrip::kSmoothingSeconds * 44100.0);
+    expectEquals(output.getSample(0, 699), 0.5f);
+    expectEquals(output.getSample(1, 700), 0.5f);
+    expect(output.getSample(0, 701) < 0.5f, "Ramp starts on the command sample");
+    expect(output.getSample(0, rampEnd - 1) > 0.25f);
+    expectEquals(output.getSample(1, rampEnd), 0.25f);
+    expectEquals(output.getSample(0, 2047), 0.25f);
+    expectEquals(engine.getPosition(), (juce::int64)2048);
+  }
+
+  void testReplies() {
+    MixEngine engine(0);
+    auto track = std::make_shared<ConstantTrack>();
+    engine.addTrack(track);
+    engine.prepare(256, 44100.0);
+
+    std::weak_ptr<AudioTrack> removed = track;
+    for (juce::uint32 id = 1; id <= 3; ++id) {
+      EngineCommand command;
+      command.type = EngineCommand::Type::SetTrackMute;
+      command.track = track;
+      command.value = 1.0;
+      command.id = id;
+      command.sample = 100 * id;
+      engine.sendCommand(std::move(command));
+    }
+
+    // The track leaves the session while commands still point to it
+    engine.removeTrack(0);
+    track.reset();
+
+    juce::AudioBuffer<float> output(2, 256);
+    engine.process(output, 0, 256);
+    expect(!removed.expired(), "The audio thread never frees the track");
+
+    std::vector<juce::int64> applied;
+    const int count = engine.collectCommandReplies(
+        [&](const EngineCommand& reply) { applied.push_back(reply.appliedSample); });
+    expectEquals(count, 2);
+    expect(applied == std::vector<juce::int64>({100, 200}));
+
+    engine.process(output, 0, 256);
+    engine.collectCommandReplies([](const EngineCommand&) {});
+    engine.collectGarbage();
+    expect(removed.expired(), "Collecting replies releases the last reference");
+  }
+
+  void testTransport() {
+    MixEngine engine(0);
+    engine.addTrack(std::make_shared<ConstantTrack>());
+    engine.prepare(128, 44100.0);
+
+    juce::AudioBuffer<float> output(2, 128);
+    EngineCommand stop;
+    stop.type = EngineCommand::Type::Stop;
+    stop.sample = 64;
+    engine.sendCommand(std::move(stop));
+
+    engine.process(output, 0, 128);
+    expect(!engine.isPlaying());
+    expectEquals(engine.getPosition(), (juce::int64)64);
+    expect(output.getSample(0, 63) != 0.0f && output.getSample(0, 64) == 0.0f,
+           "Output stops on the command sample");
+
+    EngineCommand seek;
+    seek.type = EngineCommand::Type::Seek;
+    seek.value = 44100.0;
+    engine.sendCommand(std::move(seek));
+    EngineCommand play;
+    play.type = EngineCommand::Type::Play;
+    engine.sendCommand(std::move(play));
+
+    engine.process(output, 0, 128);
+    expect(engine.isPlaying());
+    expectEquals(engine.getPosition(), (juce::int64)(44100 + 128));
+
+    // Full queue is reported, acknowledgements free the slots
+    MixEngine small(0);
+    int accepted = 0;
+    while (small.sendCommand(EngineCommand()) && accepted < 100000) {
+      ++accepted;
+    }
+    expect(accepted > 0 && accepted < 100000, "Queue is bounded");
+    small.prepare(64, 44100.0);
+    small.process(output, 0, 64);
+    expectEquals(small.collectCommandReplies([](const EngineCommand&) {}),
+                 accepted);
+    expect(small.sendCommand(EngineCommand()));
+  }
+
+  void testTimestampedWhileStopped() {
+    MixEngine engine(0);
+    auto track = std::make_shared<ConstantTrack>();
+    engine.addTrack(track);
+    engine.prepare(128, 44100.0);
+
+    juce::AudioBuffer<float> output(2, 128);
+    EngineCommand stop;
+    stop.type = EngineCommand::Type::Stop;
+    engine.sendCommand(std::move(stop));
+    engine.process(output, 0, 128);
+    expect(!engine.isPlaying());
+    expectEquals(engine.getPosition(), (juce::int64)0);
+
+    // The position never reaches these samples while stopped
+    EngineCommand play;
+    play.type = EngineCommand::Type::Play;
+    play.sample = 44100;
+    play.id = 1;
+    engine.sendCommand(std::move(play));
+    EngineCommand mute;
+    mute.type = EngineCommand::Type::SetTrackMute;
+    mute.track = track;
+    mute.value = 1.0;
+    mute.sample = 200;
+    mute.id = 2;
+    engine.sendCommand(std::move(mute));
+
+    engine.process(output, 0, 128);
+    expect(engine.isPlaying(), "A timestamped Play starts a stopped transport");
+    expectEquals(engine.getPosition(), (juce::int64)128);
+
+    // Commands after the Play wait for their sample again
+    expect(!track->mute);
+    engine.process(output, 0, 128);
+    expect(track->mute);
+    expect(output.getSample(0, 71) != 0.0f, "Playing until the mute");
+
+    std::vector<juce::int64> applied;
+    engine.collectCommandReplies([&](const EngineCommand& reply) {
+      if (reply.id != 0) {
+        applied.push_back(reply.appliedSample);
+      }
+    });
+    expect(applied == std::vector<juce::int64>({0, 200}));
+  }
+
+  void testSeekPastWaiting() {
+    MixEngine engine(0);
+    auto track = std::make_shared<SpanTrack>();
+    track->setVolume(1.0f);
+    engine.addTrack(track);
+    engine.prepare(256, 48000.0);
+
+    // The volume waits for its sample; the Seek after it jumps past it
+    EngineCommand volume;
+    volume.type = EngineCommand::Type::SetMasterVolume;
+    volume.value = 0.25;
+    volume.sample = 10000;
+    volume.id = 1;
+    engine.sendCommand(std::move(volume));
+    EngineCommand seek;
+    seek.type = EngineCommand::Type::Seek;
+    seek.value = 100000.0;
+    seek.id = 2;
+    engine.sendCommand(std::move(seek));
+
+    juce::AudioBuffer<float> output(2, 256);
+    engine.process(output, 0, 256);
+    expectEquals(track->smallest, 256, "One span, not split at a past sample");
+    expectEquals(track->largest, 256, "Spans stay inside the block");
+    expectEquals(engine.getPosition(), (juce::int64)(100000 + 256));
+    expectEquals(output.getSample(0, 0), 0.25f);
+
+    std::vector<juce::uint32> order;
+    std::vector<juce::int64> applied;
+    engine.collectCommandReplies([&](const EngineCommand& reply) {
+      order.push_back(reply.id);
+      applied.push_back(reply.appliedSample);
+    });
+    expect(order == std::vector<juce::uint32>({2, 1}));
+    expect(applied == std::vector<juce::int64>({0, 100000}));
+  }
+};
+
+static CommandQueueTests commandQueueTests;
@@ -0,0 +1,315 @@
+#include <juce_core/juce_core.h>
+#include <string>
+#include <vector>
+#include "../include/control-protocol.hpp"
+
+/**
+ * Unit tests for the ControlProtocol binary format
+ * Tests command, status, meter and analysis round trips, byte layout, rejection of
+ * malformed frames, and the schema sent to clients
+ */
+class ControlProtocolTests : public juce::UnitTest {
+ public:
+  ControlProtocolTests() : juce::UnitTest("ControlProtocol Tests") {}
+
+  void runTest() override {
+    beginTest("Command frames round-trip");
+    testCommands();
+
+    beginTest("Fields are little-endian at fixed offsets");
+    testLayout();
+
+    beginTest("Status frames round-trip");
+    testStatus();
+
+    beginTest("Meter frames round-trip");
+    testMeters();
+
+    beginTest("Spectrum and scope frames round-trip");
+    testAnalysis();
+
+    beginTest("Malformed frames are rejected");
+    testMalformed();
+
+    beginTest("Schema describes the layouts");
+    testSchema();
+  }
+
+ private:
+  void testCommands() {
+    using namespace ControlProtocol;
+
+    std::string frame;
+    beginFrame(frame, MessageType::Commands, 42);
+    for (int i = 0; i < 100; ++i) {
+      appendCommand(frame, Op::SetTrackVolume, Timing::Beat, (juce::uint32)i,
+                    i / 100.0, 16.0 + i);
+    }
+    appendCommand(frame, Op::Seek, Timing::Seconds, 0, 0.0, -2.5);
+    appendCommand(frame, Op::NoteOn, Timing::Beat, 3, 0.75, 8.0, 61);
+
+    const FrameView view(frame.data(), frame.size());
+    expect(view.isValid());
+    expect(view.getType() == MessageType::Commands);
+    expectEquals(view.getCount(), 102);
+    expectEquals((int)view.getSequence(), 42);
+    expectEquals(frame.size(), HeaderLayout::size + 102 * CommandLayout::size);
+
+    bool matches = true;
+    for (int i = 0; i < 100; ++i) {
+      const auto command = view.getCommand(i);
+      matches = matches && command.getOp() == Op::SetTrackVolume &&
+                command.getTiming() == Timing::Beat &&
+                command.getTrack() == (juce::uint32)i &&
+                command.getValue() == i / 100.0 && command.getWhen() == 16.0 + i;
+    }
+    expect(matches, "Every record should decode to what was encoded");
+
+    const auto seek = view.getCommand(100);
+    expect(seek.getOp() == Op::Seek && seek.getTiming() == Timing::Seconds);
+    expectEquals(seek.getWhen(), -2.5);
+    expectEquals(seek.getNote(), 0);
+
+    const auto note = view.getCommand(101);
+    expect(note.getOp() == Op::NoteOn && note.getTrack() == 3);
+    expectEquals(note.getNote(), 61);
+    expectEquals(note.getValue(), 0.75);
+
+    // The buffer is reused for the next frame
+    beginFrame(frame, MessageType::Commands, 43);
+    expectEquals(frame.size(), HeaderLayout::size);
+    expectEquals(FrameView(frame.data(), frame.size()).getCount(), 0);
+  }
+
+  void testLayout() {
+    using namespace ControlProtocol;
+
+    std::string frame;
+    beginFrame(frame, MessageType::Commands, 0x04030201);
+    appendCommand(frame, Op::SetTrackMute, Timing::Sample, 0x0a0b0c0d, 1.0, 0.0);
+
+    const auto* bytes = reinterpret_cast<const juce::uint8*>(frame.data());
+    expectEquals((int)bytes[HeaderLayout::version], (int)kVersion);
+    expectEquals((int)bytes[HeaderLayout::type], 0x01);
+    expectEquals((int)bytes[HeaderLayout::count], 1);
+    expectEquals((int)bytes[HeaderLayout::count + 1], 0);
+    expect(bytes[4] == 0x01 && bytes[5] == 0x02 && bytes[6] == 0x03 &&
+               bytes[7] == 0x04,
+           "Sequence should be little-endian");
+
+    const auto* record = bytes + HeaderLayout::size;
+    expectEquals((int)record[CommandLayout::op], (int)Op::SetTrackMute);
+    expectEquals((int)record[CommandLayout::track], 0x0d);
+    expectEquals((int)record[CommandLayout::track + 3], 0x0a);
+    // 1.0 is 0x3ff0000000000000
+    expectEquals((int)record[CommandLayout::value + 7], 0x3f);
+    expectEquals((int)record[CommandLayout::value + 6], 0xf0);
+  }
+
+  void testStatus() {
+    using namespace ControlProtocol;
+
+    Status status;
+    status.firstCommandId = 1000;
+    status.accepted = 3;
+    status.error = Error::QueueFull;
+    status.appliedCommand = 998;
+    status.trackCount = 12;
+
+    std::string frame;
+    beginFrame(frame, MessageType::Status, 7);
+    appendStatus(frame, status);
+
+    const FrameView view(frame.data(), frame.size());
+    expect(view.isValid());
+    expect(view.getType() == MessageType::Status);
+    expectEquals((int)view.getSequence(), 7);
+
+    const auto decoded = view.getStatus();
+    expectEquals((int)decoded.firstCommandId, 1000);
+    expectEquals((int)decoded.accepted, 3);
+    expect(decoded.error == Error::QueueFull);
+    expectEquals((int)decoded.appliedCommand, 998);
+    expectEquals((int)decoded.trackCount, 12);
+    expectEquals(juce::String(getErrorName(decoded.error)), juce::String("queueFull"));
+    // The one-pass encoder writes the same bytes into a reused buffer
+    std::string reused(64, 'x');
+    writeStatusFrame(reused, 7, status);
+    expect(reused == frame, "writeStatusFrame matches beginFrame + appendStatus");
+  }
+
+  void testMeters() {
+    using namespace ControlProtocol;
+
+    std::string frame;
+    beginFrame(frame, MessageType::Meters, 9);
+    for (int i = 0; i < 502; ++i) {
+      appendMeter(frame, i / 1000.0f, i / 900.0f, i / 2000.0f);
+    }
+
+    const FrameView view(frame.data(), frame.size());
+    expect(view.isValid());
+    expect(view.getType() == MessageType::Meters);
+    expectEquals(view.getCount(), 502);
+    expectEquals(frame.size(), HeaderLayout::size + 502 * MeterLayout::size);
+
+    bool matches = true;
+    for (int i = 0; i < 502; ++i) {
+      const auto meter = view.getMeter(i);
+      matches = matches && meter.getPeak() == i / 1000.0f &&
+                meter.getTruePeak() == i / 900.0f && meter.getRms() == i / 2000.0f;
+    }
+    expect(matches, "Every record should decode to what was encoded");
+
+    // 1.0f is 0x3f800000
+    std::string unity;
+    beginFrame(unity, MessageType::Meters, 0);
+    appendMeter(unity, 1.0f, 0.0f, 0.0f);
+    const auto* bytes =
+        reinterpret_cast<const juce::uint8*>(unity.data()) + HeaderLayout::size;
+    expectEquals((int)bytes[MeterLayout::peak + 2], 0x80);
+    expectEquals((int)bytes[MeterLayout::peak + 3], 0x3f);
+
+    // Acknowledgements are a bare header
+    std::string ack;
+    beginFrame(ack, MessageType::MeterAck, 9);
+    const FrameView ackView(ack.data(), ack.size());
+    expect(ackView.isValid());
+    expect(ackView.getType() == MessageType::MeterAck);
+    expectEquals((int)ackView.getSequence(), 9);
+
+    std::string longer = ack + '\0';
+    expect(FrameView(longer.data(), longer.size()).getError() == Error::BadFrame,
+           "MeterAck has no record");
+  }
+
+  void testAnalysis() {
+    using namespace ControlProtocol;
+
+    AnalysisInfo info;
+    info.subscription = 3;
+    info.span = 4096;
+    info.end = 0x123456789ull;
+    info.sampleRate = 48000.0f;
+
+    std::vector<float> bins(2049);
+    for (size_t i = 0; i < bins.size(); ++i) {
+      bins[i] = -(float)i / 16.0f;
+    }
+    std::string spectrum;
+    beginAnalysisFrame(spectrum, MessageType::Spectrum, 21, info);
+    appendSpectrum(spectrum, bins.data(), 2000);
+    appendSpectrum(spectrum, bins.data() + 2000, 49);
+
+    const FrameView view(spectrum.data(), spectrum.size());
+    expect(view.isValid());
+    expect(view.getType() == MessageType::Spectrum);
+    expectEquals(view.getCount(), 2049);
+    expectEquals(spectrum.size(), HeaderLayout::size + AnalysisLayout::size +
+                                      2049 * SpectrumLayout::size);
+
+    const auto decoded = view.getAnalysisInfo();
+    expectEquals((int)decoded.subscription, 3);
+    expectEquals((int)decoded.span, 4096);
+    expect(decoded.end == info.end, "u64 end position");
+    expectEquals(decoded.sampleRate, 48000.0f);
+
+    bool matches = true;
+    for (int i = 0; i < 2049; ++i) {
+      matches = matches && view.getBin(i) == bins[(size_t)i];
+    }
+    expect(matches, "Every bin should decode to what was encoded");
+
+    const float minimums[] = {-0.5f, -0.25f, 0.0f};
+    const float maximums[] = {0.5f, 0.75f, 1.0f};
+    std::string scope;
+    beginAnalysisFrame(scope, MessageType::Scope, 22, info);
+    appendScope(scope, minimums, maximums, 3);
+
+    const FrameView scopeView(scope.data(), scope.size());
+    expect(scopeView.isValid());
+    expectEquals(scopeView.getCount(), 3);
+    expectEquals((int)scopeView.getAnalysisInfo().subscription, 3);
+    expectEquals(scopeView.getScope(1).getMin(), -0.25f);
+    expectEquals(scopeView.getScope(2).getMax(), 1.0f);
+
+    // The prefix counts in the size check
+    std::string truncated = scope.substr(0, scope.size() - 1);
+    expect(FrameView(truncated.data(), truncated.size()).getError() ==
+           Error::BadFrame);
+    std::string noPrefix;
+    beginFrame(noPrefix, MessageType::Scope, 0);
+    expect(FrameView(noPrefix.data(), noPrefix.size()).getError() ==
+           Error::BadFrame, "Analysis frames always have a prefix");
+  }
+
+  void testMalformed() {
+    using namespace ControlProtocol;
+
+    std::string frame;
+    beginFrame(frame, MessageType::Commands, 5);
+    appendCommand(frame, Op::Play, Timing::Immediate, 0, 0.0, 0.0);
+    appendCommand(frame, Op::Stop, Timing::Immediate, 0, 0.0, 0.0);
+
+    expect(FrameView(frame.data(), 3).getError() == Error::BadFrame,
+           "Truncated header");
+    const FrameView truncated(frame.data(), frame.size() - 1);
+    expect(truncated.getError() == Error::BadFrame, "Truncated record");
+    expectEquals((int)truncated.getSequence(), 5);
+
+    std::string longer = frame + '\0';
+    expect(FrameView(longer.data(), longer.size()).getError() == Error::BadFrame,
+           "Trailing bytes");
+
+    std::string version = frame;
+    version[HeaderLayout::version] = (char)(kVersion + 1);
+    expect(FrameView(version.data(), version.size()).getError() ==
+           Error::UnsupportedVersion);
+
+    std::string type = frame;
+    type[HeaderLayout::type] = 0x7f;
+    expect(FrameView(type.data(), type.size()).getError() == Error::UnknownMessage);
+  }
+
+  void testSchema() {
+    using namespace ControlProtocol;
+
+    const auto schema = getSchema();
+    expectEquals((int)schema["version"], (int)kVersion);
+    expectEquals((int)schema["header"]["size"], (int)HeaderLayout::size);
+
+    const auto command = schema["messages"]["commands"];
+    expectEquals((int)command["type"], (int)MessageType::Commands);
+    expectEquals((int)command["record"]["size"], (int)CommandLayout::size);
+
+    const auto* fields = command["record"]["fields"].getArray();
+    expect(fields != nullptr && fields->size() == 6);
+    if (fields != nullptr && fields->size() == 6) {
+      expectEquals(fields->getReference(2)["name"].toString(), juce::String("note"));
+      expectEquals((int)fields->getReference(2)["offset"], (int)CommandLayout::note);
+      expectEquals(fields->getReference(5)["name"].toString(), juce::String("when"));
+      expectEquals((int)fields->getReference(5)["offset"], (int)CommandLayout::when);
+    }
+
+    const auto meters = schema["messages"]["meters"];
+    expectEquals((int)meters["type"], (int)MessageType::Meters);
+    expectEquals((int)meters["record"]["size"], (int)MeterLayout::size);
+    expectEquals((int)schema["messages"]["meterAck"]["type"],
+                 (int)MessageType::MeterAck);
+
+    const auto spectrum = schema["messages"]["spectrum"];
+    expectEquals((int)spectrum["type"], (int)MessageType::Spectrum);
+    expectEquals((int)spectrum["prefix"]["size"], (int)AnalysisLayout::size);
+    expectEquals((int)spectrum["record"]["size"], (int)SpectrumLayout::size);
+    expectEquals((int)schema["messages"]["scope"]["record"]["size"],
+                 (int)ScopeLayout::size);
+
+    expectEquals((int)schema["enums"]["op"]["seek"], (int)Op::Seek);
+    expectEquals((int)schema["enums"]["op"]["setTrackPan"], (int)Op::SetTrackPan);
+    expectEquals((int)schema["enums"]["op"]["noteOff"], (int)Op::NoteOff);
+    expectEquals((int)schema["enums"]["op"]["setTrackMidiInput"],
+                 (int)Op::SetTrackMidiInput);
+  }
+};
+
+static ControlProtocolTests controlProtocolTests;
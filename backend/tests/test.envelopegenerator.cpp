@@ -0,0 +1,186 @@
+#include <juce_core/juce_core.h>
+#include <cmath>
+#include <vector>
+#include "../include/envelope-generator.hpp"
+
+/**
+ * Unit tests for the EnvelopeGenerator class
+ * Tests segment lengths and values, curve shapes, and that skipping,
+ * rendering and applying the envelope agree
+ */
+class EnvelopeGeneratorTests : public juce::UnitTest {
+ public:
+  EnvelopeGeneratorTests() : juce::UnitTest("EnvelopeGenerator Tests") {}
+
+  void runTest() override {
+    beginTest("Linear segments");
+    testLinearSegments();
+
+    beginTest("Curved segments reach their targets");
+    testCurves();
+
+    beginTest("Advance matches rendering");
+    testAdvanceMatchesRender();
+
+    beginTest("Apply matches gains times input");
+    testApplyBlock();
+
+    beginTest("Zero-length segments and release");
+    testEdgeCases();
+  }
+
+ private:
+  // 1 kHz keeps segment lengths readable: 1 ms = 1 sample
+  static constexpr double kSampleRate = 1000.0;
+
+  static ADSRParameters makeParameters(ADSRParameters::Curve curve) {
+    ADSRParameters params;
+    params.attackTime = 0.010f;
+    params.decayTime = 0.020f;
+    params.sustainLevel = 0.5f;
+    params.releaseTime = 0.040f;
+    params.attackCurve = curve;
+    params.decayCurve = curve;
+    params.releaseCurve = curve;
+    return params;
+  }
+
+  void testLinearSegments() {
+    EnvelopeGenerator env(makeParameters(ADSRParameters::Curve::Linear),
+                          kSampleRate);
+    expect(!env.isActive(), "Envelope starts idle");
+
+    env.noteOn();
+    expect(env.getStage() == EnvelopeGenerator::Stage::Attack);
+    expectEquals(env.getRemainingSamples(), (juce::int64)10);
+
+    std::vector<float> gains(40);
+    env.renderBlock(gains.data(), (int)gains.size());
+
+    expectEquals(gains[0], 0.0f);
+    expectWithinAbsoluteError(gains[5], 0.5f, 1.0e-6f);
+    expectWithinAbsoluteError(gains[10], 1.0f, 1.0e-6f);   // decay starts
+    expectWithinAbsoluteError(gains[20], 0.75f, 1.0e-6f);  // half-way
+    expectWithinAbsoluteError(gains[30], 0.5f, 1.0e-6f);   // sustain
+    expectEquals(gains[39], 0.5f);
+    expect(env.getStage() == EnvelopeGenerator::Stage::Sustain);
+    expectEquals(env.getRemainingSamples(), (juce::int64)-1);
+
+    env.noteOff();
+    expectEquals(env.getRemainingSamples(), (juce::int64)40);
+    env.renderBlock(gains.data(), 20);
+    expectWithinAbsoluteError(gains[0], 0.5f, 1.0e-6f);
+    expectWithinAbsoluteError(gains[10], 0.375f, 1.0e-6f);
+
+    env.renderBlock(gains.data(), 40);
+    expectWithinAbsoluteError(gains[19], 0.0125f, 1.0e-6f);
+    expectEquals(gains[20], 0.0f);
+    expect(!env.isActive(), "Envelope is idle after the release");
+  }
+
+  void testCurves() {
+    for (auto curve : {ADSRParameters::Curve::Exponential,
+                       ADSRParameters::Curve::Logarithmic}) {
+      auto params = makeParameters(curve);
+      params.attackTime = 0.5f;  // 500 samples
+      EnvelopeGenerator env(params, kSampleRate);
+      env.noteOn();
+
+      std::vector<float> gains(501);
+      env.renderBlock(gains.data(), (int)gains.size());
+
+      bool monotonic = true;
+      for (size_t i = 1; i < 500; ++i) {
+        monotonic = monotonic && gains[i] > gains[i - 1];
+      }
+      expect(monotonic, "Attack should rise on every sample");
+      expectEquals(gains[0], 0.0f);
+      expectWithinAbsoluteError(gains[500], 1.0f, 1.0e-4f);
+
+      // Exponential attacks are above the straight line at mid-point,
+      // logarithmic ones below it
+      if (curve == ADSRParameters::Curve::Exponential) {
+        expect(gains[250] > 0.8f, "Exponential attack is fast at first");
+      } else {
+        expect(gains[250] < 0.2f, "Logarithmic attack is slow at first");
+      }
+
+      env.advance(100);
+      expect(env.getStage() == EnvelopeGenerator::Stage::Sustain);
+      expectWithinAbsoluteError(env.getValue(), 0.5f, 1.0e-4f);
+    }
+  }
+
+  void testAdvanceMatchesRender() {
+    for (auto curve : {ADSRParameters::Curve::Linear,
+                       ADSRParameters::Curve::Exponential}) {
+      EnvelopeGenerator rendered(makeParameters(curve), kSampleRate);
+      EnvelopeGenerator skipped(makeParameters(curve), kSampleRate);
+      rendered.noteOn();
+      skipped.noteOn();
+
+      std::vector<float> gains(14);
+      for (int offset : {3, 7, 14}) {  // crosses attack and decay ends
+        rendered.renderBlock(gains.data(), offset);
+        skipped.advance(offset);
+        expectWithinAbsoluteError(skipped.getValue(), rendered.getValue(),
+                                  1.0e-5f);
+        expect(skipped.getStage() == rendered.getStage());
+      }
+    }
+  }
+
+  void testApplyBlock() {
+    const auto params = makeParameters(ADSRParameters::Curve::Exponential);
+    EnvelopeGenerator gainEnv(params, kSampleRate);
+    EnvelopeGenerator applyEnv(params, kSampleRate);
+    gainEnv.noteOn();
+    applyEnv.noteOn();
+
+    juce::Random random(42);
+    std::vector<float> input(64);
+    for (auto& sample : input) {
+      sample = random.nextFloat() * 2.0f - 1.0f;
+    }
+
+    std::vector<float> gains(input.size());
+    std::vector<float> applied(input);
+    gainEnv.renderBlock(gains.data(), (int)gains.size());
+    applyEnv.applyBlock(applied.data(), (int)applied.size());
+
+    float maxError = 0.0f;
+    for (size_t i = 0; i < input.size(); ++i) {
+      maxError = std::max(maxError, std::abs(applied[i] - input[i] * gains[i]));
+    }
+    expectEquals(maxError, 0.0f);
+  }
+
+  void testEdgeCases() {
+    auto params = makeParameters(ADSRParameters::Curve::Linear);
+    params.attackTime = 0.0f;
+    params.decayTime = 0.0f;
+    EnvelopeGenerator env(params, kSampleRate);
+
+    env.noteOn();
+    expect(env.getStage() == EnvelopeGenerator::Stage::Sustain,
+           "Zero attack and decay jump straight to sustain");
+    expectEquals(env.getValue(), 0.5f);
+
+    // Release from the middle of the attack starts at the current value
+    params.attackTime = 0.010f;
+    env.setParameters(params);
+    env.reset();
+    env.noteOn();
+    env.advance(4);
+    env.noteOff();
+    expect(env.getStage() == EnvelopeGenerator::Stage::Release);
+    expectWithinAbsoluteError(env.getValue(), 0.4f, 1.0e-6f);
+
+    // Note off while idle stays idle
+    env.reset();
+    env.noteOff();
+    expect(!env.isActive());
+  }
+};
+
+static EnvelopeGeneratorTests envelopeGeneratorTests;
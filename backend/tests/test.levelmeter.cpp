@@ -0,0 +1,406 @@
+#include <juce_core/juce_core.h>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "../include/level-meter.hpp"
+#include "../include/mix-engine.hpp"
+#include "../include/triple-buffer.hpp"
+
+/**
+ * Unit tests for ChannelMeter, TripleBuffer and the MixEngine meter frames
+ * Tests peak, RMS and true-peak values of known signals, independence from
+ * the block size, latest-value exchange across threads, and frames published
+ * by the engine without losing peaks the reader missed
+ */
+class LevelMeterTests : public juce::UnitTest {
+ public:
+  LevelMeterTests() : juce::UnitTest("LevelMeter Tests") {}
+
+  void runTest() override {
+    beginTest("Sine peak and RMS");
+    testSineLevels();
+
+    beginTest("True peak between samples");
+    testTruePeak();
+
+    beginTest("Readings do not depend on the block size");
+    testBlockSizes();
+
+    beginTest("True peak estimate around sample peaks");
+    testTruePeakEstimate();
+
+    beginTest("Readings carry over undelivered peaks");
+    testReadings();
+
+    beginTest("Frames merge");
+    testFrameMerge();
+
+    beginTest("Triple buffer keeps the latest value");
+    testTripleBuffer();
+
+    beginTest("Triple buffer across threads");
+    testTripleBufferThreads();
+
+    beginTest("MixEngine publishes meter frames");
+    testEngineFrames();
+
+    beginTest("MixEngine keeps peaks of unread frames");
+    testEngineCarryOver();
+  }
+
+ private:
+  static constexpr double kSampleRate = 48000.0;
+
+  // Outputs 1 on every sample: mixed at its volume
+  class ConstantTrack : public AudioTrack {
+   public:
+    float getSampleValue(const BeatContext&) override {
+      return 1.0f;
+    }
+
+    RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                               int numSamples, const BeatContext&) override {
+      juce::FloatVectorOperations::fill(buffer.getWritePointer(0, startSample),
+                                        1.0f, numSamples);
+      return RenderActivity::whole(numSamples);
+    }
+
+    std::unique_ptr<AudioTrack> clone() const override {
+      return std::make_unique<ConstantTrack>(*this);
+    }
+  };
+
+  // Outputs a single full-scale sample, then silence
+  class ImpulseTrack : public AudioTrack {
+   public:
+    float getSampleValue(const BeatContext&) override { return 0.0f; }
+
+    RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                               int numSamples, const BeatContext&) override {
+      juce::FloatVectorOperations::clear(buffer.getWritePointer(0, startSample),
+                                         numSamples);
+      if (!fired && numSamples > 0) {
+        buffer.setSample(0, startSample, 1.0f);
+        fired = true;
+        return {0, 1};
+      }
+      return RenderActivity::silent();
+    }
+
+    std::unique_ptr<AudioTrack> clone() const override {
+      return std::make_unique<ImpulseTrack>(*this);
+    }
+
+   private:
+    bool fired = false;
+  };
+
+  static std::vector<float> makeSine(int numSamples, double frequency,
+                                     float amplitude, double phase) {
+    std::vector<float> samples((size_t)numSamples);
+    for (int i = 0; i < numSamples; ++i) {
+      samples[(size_t)i] =
+          amplitude * (float)std::sin(2.0 * juce::MathConstants<double>::pi *
+                                          frequency * i / kSampleRate +
+                                      phase);
+    }
+    return samples;
+  }
+
+  // Measure a signal in blocks of the given size
+  static MeterReading measure(
+      const std::vector<float>& samples, int blockSize,
+      ChannelMeter::TruePeakMode mode = ChannelMeter::TruePeakMode::Exact) {
+    ChannelMeter meter(mode);
+    for (int start = 0; start < (int)samples.size(); start += blockSize) {
+      const int count = juce::jmin(blockSize, (int)samples.size() - start);
+      meter.process(samples.data() + start, count,
+                    ChannelMeter::getRmsCoefficient(count, kSampleRate));
+    }
+    return meter.takeReading(false);
+  }
+
+  void testSineLevels() {
+    // Two seconds: the RMS smoothing has settled
+    const auto sine = makeSine((int)(2 * kSampleRate), 1000.0, 0.5f, 0.0);
+    const auto reading = measure(sine, 512);
+
+    expectWithinAbsoluteError(reading.peak, 0.5f, 1.0e-3f);
+    expectWithinAbsoluteError(reading.rms, 0.5f / std::sqrt(2.0f), 2.0e-3f);
+    expect(reading.truePeak >= reading.peak, "True peak is at least the peak");
+    expectWithinAbsoluteError(reading.truePeak, 0.5f, 5.0e-3f);
+
+    ChannelMeter silent;
+    const std::vector<float> zeros(512, 0.0f);
+    silent.process(zeros.data(), 512, ChannelMeter::getRmsCoefficient(512, kSampleRate));
+    const auto silence = silent.takeReading(false);
+    expectEquals(silence.peak, 0.0f);
+    expectEquals(silence.truePeak, 0.0f);
+    expectEquals(silence.rms, 0.0f);
+  }
+
+  void testTruePeak() {
+    // fs/4 with a 45 degree phase: every sample is at 0.707 of the crest
+    const auto sine = makeSine(4800, kSampleRate / 4.0, 1.0f,
+                               juce::MathConstants<double>::pi / 4.0);
+    const auto reading = measure(sine, 480);
+
+    expectWithinAbsoluteError(reading.peak, std::sqrt(0.5f), 1.0e-3f);
+    expect(reading.truePeak > 0.95f,
+           "Crest between samples found, got " + juce::String(reading.truePeak));
+    expect(reading.truePeak < 1.05f);
+  }
+
+  void testBlockSizes() {
+    // Bursts and decays: exercises chunks skipped by the true-peak bound
+    juce::Random random(42);
+    std::vector<float> samples(20000);
+    float envelope = 0.0f;
+    for (size_t i = 0; i < samples.size(); ++i) {
+      if (i % 3000 == 0) {
+        envelope = 0.2f + 0.8f * random.nextFloat();
+      }
+      envelope *= 0.999f;
+      samples[i] = envelope * (random.nextFloat() * 2.0f - 1.0f);
+    }
+
+    const auto whole = measure(samples, (int)samples.size());
+    for (const int blockSize : {1, 7, 11, 32, 100, 512}) {
+      const auto reading = measure(samples, blockSize);
+      expectEquals(reading.peak, whole.peak);
+      expectWithinAbsoluteError(reading.truePeak, whole.truePeak, 1.0e-6f);
+    }
+    expect(whole.truePeak >= whole.peak);
+  }
+
+  void testTruePeakEstimate() {
+    using Mode = ChannelMeter::TruePeakMode;
+
+    // Worst case for sample peaks, with peaks at block boundaries
+    const auto quarter = makeSine(4800, kSampleRate / 4.0, 1.0f,
+                                  juce::MathConstants<double>::pi / 4.0);
+    for (const int blockSize : {480, 1, 5, 64}) {
+      const auto estimate = measure(quarter, blockSize, Mode::AroundPeak);
+      expect(estimate.truePeak > 0.99f,
+             "Crest found, got " + juce::String(estimate.truePeak));
+    }
+
+    // High sines of any phase: the estimate misses at most the 4x grid
+    // resolution of one cycle (BS.1770 itself under-reads up to 0.7 dB)
+    juce::Random random(7);
+    float worst = 0.0f;
+    for (int i = 0; i < 50; ++i) {
+      const double frequency = 2000.0 + 18000.0 * random.nextDouble();
+      const auto sine = makeSine(2048, frequency, 0.9f,
+                                 juce::MathConstants<double>::twoPi * random.nextDouble());
+      const auto exact = measure(sine, 256);
+      const auto estimate = measure(sine, 256, Mode::AroundPeak);
+      expect(estimate.truePeak <= exact.truePeak + 1.0e-6f,
+             "The estimate is a subset of the exact values");
+      expect(estimate.truePeak >= estimate.peak);
+      worst = juce::jmax(worst, exact.truePeak / estimate.truePeak);
+    }
+    logMessage("  Largest estimate error: " +
+               juce::String(juce::Decibels::gainToDecibels(worst), 3) + " dB");
+    expect(worst < juce::Decibels::decibelsToGain(1.0f));
+  }
+
+  void testReadings() {
+    ChannelMeter meter;
+    const float loud[] = {0.9f, -0.2f};
+    const float quiet[] = {0.1f, -0.1f};
+    const float coefficient = ChannelMeter::getRmsCoefficient(2, kSampleRate);
+
+    meter.process(loud, 2, coefficient);
+    expectWithinAbsoluteError(meter.takeReading(false).peak, 0.9f, 1.0e-6f);
+
+    // Delivered: a new interval starts
+    meter.process(quiet, 2, coefficient);
+    expectWithinAbsoluteError(meter.takeReading(false).peak, 0.1f, 1.0e-6f);
+
+    // Not delivered: its peak is carried into the next reading
+    meter.process(loud, 2, coefficient);
+    meter.takeReading(false);
+    meter.process(quiet, 2, coefficient);
+    expectWithinAbsoluteError(meter.takeReading(true).peak, 0.9f, 1.0e-6f);
+
+    // RMS decays through silence
+    const float before = meter.takeReading(false).rms;
+    const int twoSeconds = 2 * (int)kSampleRate;
+    meter.processSilence(twoSeconds,
+                         ChannelMeter::getRmsCoefficient(twoSeconds, kSampleRate));
+    expect(meter.takeReading(false).rms < before * 0.1f);
+
+    meter.reset();
+    const auto reset = meter.takeReading(false);
+    expectEquals(reset.peak + reset.truePeak + reset.rms, 0.0f);
+  }
+
+  void testFrameMerge() {
+    MeterFrame pending;
+    pending.tracks.resize(MeterFrame::kMaxTracks);
+    pending.numTracks = 2;
+    pending.position = 100;
+    pending.master[0] = {0.8f, 0.9f, 0.3f};
+    pending.tracks[0] = {0.5f, 0.6f, 0.2f};
+    pending.tracks[1] = {0.1f, 0.1f, 0.1f};
+
+    MeterFrame later;
+    later.tracks.resize(MeterFrame::kMaxTracks);
+    later.numTracks = 3;
+    later.position = 200;
+    later.master[0] = {0.4f, 0.4f, 0.35f};
+    later.tracks[0] = {0.2f, 0.2f, 0.15f};
+    later.tracks[1] = {0.7f, 0.75f, 0.4f};
+    later.tracks[2] = {0.3f, 0.3f, 0.25f};
+
+    pending.merge(later);
+    expectEquals((int)pending.position, 200);
+    expectEquals(pending.numTracks, 3);
+    expectEquals(pending.master[0].peak, 0.8f);
+    expectEquals(pending.master[0].truePeak, 0.9f);
+    expectEquals(pending.master[0].rms, 0.35f);
+    expectEquals(pending.tracks[0].peak, 0.5f);
+    expectEquals(pending.tracks[0].rms, 0.15f);
+    expectEquals(pending.tracks[1].peak, 0.7f);
+    expectEquals(pending.tracks[2].peak, 0.3f);
+  }
+
+  void testTripleBuffer() {
+    TripleBuffer<int> buffer;
+    expect(!buffer.hasUnreadValue());
+    expect(!buffer.update(), "Nothing published yet");
+
+    buffer.getWriteBuffer() = 1;
+    buffer.publish();
+    buffer.getWriteBuffer() = 2;
+    buffer.publish();
+    expect(buffer.hasUnreadValue());
+
+    expect(buffer.update());
+    expectEquals(buffer.getReadBuffer(), 2);
+    expect(!buffer.hasUnreadValue());
+    expect(!buffer.update(), "The same value is not read twice");
+    expectEquals(buffer.getReadBuffer(), 2);
+
+    buffer.getWriteBuffer() = 3;
+    buffer.publish();
+    expect(buffer.update());
+    expectEquals(buffer.getReadBuffer(), 3);
+  }
+
+  void testTripleBufferThreads() {
+    struct Value {
+      int first = 0;
+      int second = 0;
+    };
+
+    constexpr int count = 200000;
+    TripleBuffer<Value> buffer;
+    bool consistent = true;
+    bool increasing = true;
+    int last = 0;
+
+    std::thread reader([&]() {
+      while (last < count) {
+        if (buffer.update()) {
+          const auto& value = buffer.getReadBuffer();
+          consistent = consistent && value.first == value.second;
+          increasing = increasing && value.first > last;
+          last = value.first;
+        }
+      }
+    });
+
+    for (int i = 1; i <= count; ++i) {
+      auto& value = buffer.getWriteBuffer();
+      value.first = i;
+      value.second = i;
+      buffer.publish();
+    }
+    reader.join();
+
+    expect(consistent, "A slot is never written while it is read");
+    expect(increasing, "Values come newest-first, never older");
+    expectEquals(last, count);
+  }
+
+  void testEngineFrames() {
+    constexpr int blockSize = 480;  // 10 ms, the first block publishes
+    MixEngine engine(0);
+    auto first = std::make_shared<ConstantTrack>();
+    first->setVolume(0.25f);
+    auto second = std::make_shared<ConstantTrack>();
+    second->setVolume(0.5f);
+    engine.addTrack(first);
+    engine.addTrack(second);
+    engine.prepare(blockSize, kSampleRate);
+
+    juce::AudioBuffer<float> output(2, blockSize);
+    expect(engine.readMeters() == nullptr, "No frame before processing");
+
+    engine.process(output, 0, blockSize);
+    const MeterFrame* frame = engine.readMeters();
+    expect(frame != nullptr);
+    if (frame == nullptr) {
+      return;
+    }
+
+    expectEquals(frame->numTracks, 2);
+    expectEquals((int)frame->position, blockSize);
+    expectWithinAbsoluteError(frame->tracks[0].peak, 0.25f, 1.0e-6f);
+    expectWithinAbsoluteError(frame->tracks[1].peak, 0.5f, 1.0e-6f);
+    // The step from silence rings through the interpolator
+    expect(frame->tracks[1].truePeak >= 0.5f && frame->tracks[1].truePeak < 0.6f,
+           "Step overshoot, got " + juce::String(frame->tracks[1].truePeak));
+    expect(frame->tracks[1].rms > 0.0f && frame->tracks[1].rms < 0.5f,
+           "RMS rises towards the level");
+
+    // Default master volume is 0.5
+    expectWithinAbsoluteError(frame->master[0].peak, 0.375f, 1.0e-6f);
+    expectWithinAbsoluteError(frame->master[1].peak, 0.375f, 1.0e-6f);
+    expect(engine.readMeters() == nullptr, "A frame is read once");
+
+    // Disabled: nothing is published
+    engine.setMeteringEnabled(false);
+    engine.process(output, 0, blockSize);
+    expect(engine.readMeters() == nullptr);
+  }
+
+  void testEngineCarryOver() {
+    // One meter interval per block
+    const int blockSize = juce::roundToInt(MixEngine::kMeterIntervalSeconds * kSampleRate);
+    MixEngine engine(0);
+    auto impulse = std::make_shared<ImpulseTrack>();
+    impulse->setVolume(1.0f);
+    engine.addTrack(impulse);
+    engine.addTrack(std::make_shared<ConstantTrack>());
+    engine.prepare(blockSize, kSampleRate);
+    juce::AudioBuffer<float> output(2, blockSize);
+
+    // Many frames published, none read: the impulse of the first survives
+    for (int block = 0; block < 20; ++block) {
+      engine.process(output, 0, blockSize);
+    }
+
+    const MeterFrame* frame = engine.readMeters();
+    expect(frame != nullptr);
+    if (frame == nullptr) {
+      return;
+    }
+    expectEquals(frame->tracks[0].peak, 1.0f);
+    expect(frame->tracks[0].truePeak >= 1.0f);
+    // Impulse plus the constant track (volume 0.4), at master volume 0.5
+    expectWithinAbsoluteError(frame->master[0].peak, 0.7f, 1.0e-6f);
+
+    // Once read, the next frame starts over
+    engine.process(output, 0, blockSize);
+    frame = engine.readMeters();
+    expect(frame != nullptr);
+    if (frame != nullptr) {
+      expectEquals(frame->tracks[0].peak, 0.0f);
+    }
+  }
+};
+
+static LevelMeterTests levelMeterTests;
@@ -0,0 +1,352 @@
+#include <juce_core/juce_core.h>
+#include <string>
+#include <vector>
+#include "../include/engine-profiler.hpp"
+#include "../include/midi-input.hpp"
+#include "../include/mix-engine.hpp"
+#include "../include/realtime-guard.hpp"
+#include "../include/synth-track.hpp"
+
+/**
+ * Unit tests for MidiEventList, MidiInputQueue and MIDI delivery to tracks
+ * Tests event order and capacity, sample offsets and latency from arrival
+ * times, events held for the next block, dropped events, renders split at
+ * event samples, delivery to armed tracks only, jitter from late callbacks,
+ * the profile export, and that delivery never allocates on the audio thread
+ */
+class MidiInputTests : public juce::UnitTest {
+ public:
+  MidiInputTests() : juce::UnitTest("MidiInput Tests") {}
+
+  void runTest() override {
+    beginTest("Event lists stay sorted and bounded");
+    testEventList();
+
+    beginTest("Events land on the sample they arrived at");
+    testOffsets();
+
+    beginTest("Events after the callback wait for the next block");
+    testHeldEvents();
+
+    beginTest("Full queues and lists lose or delay events");
+    testCapacity();
+
+    beginTest("Late callbacks show up as jitter");
+    testJitter();
+
+    beginTest("Renders split at event samples");
+    testRenderWithEvents();
+
+    beginTest("MixEngine plays events on armed tracks");
+    testEngineDelivery();
+
+    beginTest("MIDI timing is exported with the profile");
+    testProfileExport();
+
+    beginTest("Delivery is real-time safe");
+    testRealtime();
+  }
+
+ private:
+  static constexpr double kSampleRate = 48000.0;
+  static constexpr int kBlockSize = 480;  // 10 ms
+
+  static juce::int64 toTicks(double seconds) {
+    return (juce::int64)(seconds * (double)juce::Time::getHighResolutionTicksPerSecond());
+  }
+
+  static MidiEvent makeEvent(MidiEvent::Type type, int note, juce::int64 arrivalTicks,
+                             int offset = 0) {
+    MidiEvent event;
+    event.type = type;
+    event.note = (juce::uint8)note;
+    event.velocity = type == MidiEvent::Type::NoteOn ? 0.8f : 0.0f;
+    event.arrivalTicks = arrivalTicks;
+    event.offset = offset;
+    return event;
+  }
+
+  // Records its render calls and the notes it received
+  class RecordingTrack : public AudioTrack {
+   public:
+    struct Call {
+      int startSample;
+      int numSamples;
+      juce::int64 sample;
+    };
+
+    float getSampleValue(const BeatContext&) override { return 0.0f; }
+
+    RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                               int numSamples, const BeatContext& context) override {
+      calls.push_back({startSample, numSamples, context.sample});
+      buffer.clear(0, startSample, numSamples);
+      return RenderActivity::silent();
+    }
+
+    void noteOn(int note, float) noexcept override { notes.push_back(note); }
+    void noteOff(int note) noexcept override { notes.push_back(-note); }
+
+    std::unique_ptr<AudioTrack> clone() const override {
+      return std::make_unique<RecordingTrack>(*this);
+    }
+
+    std::vector<Call> calls;
+    std::vector<int> notes;  // Note-offs negated
+  };
+
+  void testEventList() {
+    MidiEventList list(4);
+    expect(list.isEmpty());
+    expect(list.add(makeEvent(MidiEvent::Type::NoteOn, 1, 0, 50)));
+    expect(list.add(makeEvent(MidiEvent::Type::NoteOn, 2, 0, 10)));
+    expect(list.add(makeEvent(MidiEvent::Type::NoteOff, 3, 0, 50)));
+    expect(list.add(makeEvent(MidiEvent::Type::NoteOn, 4, 0, 30)));
+    expect(list.isFull());
+    expect(!list.add(makeEvent(MidiEvent::Type::NoteOn, 5, 0, 0)), "Full lists refuse");
+
+    // By offset, same offsets in the order they were added
+    const int expected[] = {2, 4, 1, 3};
+    for (int i = 0; i < 4; ++i) {
+      expectEquals((int)list[i].note, expected[i]);
+    }
+    expectEquals((int)(list.lowerBound(30) - list.begin()), 1);
+    expectEquals((int)(list.lowerBound(31) - list.begin()), 2);
+    expect(list.lowerBound(51) == list.end());
+
+    list.clear();
+    expect(list.isEmpty() && list.lowerBound(0) == list.end());
+  }
+
+  void testOffsets() {
+    MidiInputQueue queue;
+    queue.prepare(kSampleRate);
+    MidiEventList events;
+    const juce::int64 start = toTicks(10.0);
+
+    queue.collectBlock(start, kBlockSize, events);
+    expect(events.isEmpty());
+
+    // 2.51 ms after the previous callback: sample 120 of the next block
+    expect(queue.push(makeEvent(MidiEvent::Type::NoteOn, 60, start + toTicks(0.00251))));
+    expect(queue.push(makeEvent(MidiEvent::Type::NoteOff, 60, start + toTicks(0.00751))));
+    queue.collectBlock(start + toTicks(0.01), kBlockSize, events);
+
+    expectEquals(events.size(), 2);
+    expectEquals(events[0].offset, 120);
+    expect(events[0].type == MidiEvent::Type::NoteOn);
+    expectEquals(events[1].offset, 360);
+    expect(events[1].type == MidiEvent::Type::NoteOff);
+
+    // Spacing is kept: every event is one block late, within a sample
+    const auto latency = queue.getLatency().getSnapshot();
+    const auto jitter = queue.getJitter().getSnapshot();
+    expectEquals((int)latency.getCount(), 2);
+    expectWithinAbsoluteError(latency.getMean(), 0.01, 1.0 / kSampleRate);
+    expect(jitter.max < 1.0 / kSampleRate,
+           "Jitter " + juce::String(jitter.max) + " s with a steady callback");
+  }
+
+  void testHeldEvents() {
+    MidiInputQueue queue;
+    queue.prepare(kSampleRate);
+    MidiEventList events;
+    const juce::int64 start = toTicks(20.0);
+    queue.collectBlock(start, kBlockSize, events);
+
+    // Stamped after the callback started: not part of its block
+    queue.push(makeEvent(MidiEvent::Type::NoteOn, 60, start + toTicks(0.005)));
+    queue.push(makeEvent(MidiEvent::Type::NoteOn, 62, start + toTicks(0.01051)));
+    queue.collectBlock(start + toTicks(0.01), kBlockSize, events);
+    expectEquals(events.size(), 1);
+    expectEquals((int)events[0].note, 60);
+
+    queue.collectBlock(start + toTicks(0.02), kBlockSize, events);
+    expectEquals(events.size(), 1);
+    expectEquals((int)events[0].note, 62);
+    expectEquals(events[0].offset, 24);
+
+    queue.collectBlock(start + toTicks(0.03), kBlockSize, events);
+    expect(events.isEmpty());
+  }
+
+  void testCapacity() {
+    MidiInputQueue queue(4);
+    queue.prepare(kSampleRate);
+    const juce::int64 start = toTicks(30.0);
+    MidiEventList small(3);
+    queue.collectBlock(start, kBlockSize, small);
+
+    for (int note = 0; note < 4; ++note) {
+      expect(queue.push(makeEvent(MidiEvent::Type::NoteOn, note, start + note)));
+    }
+    expect(!queue.push(makeEvent(MidiEvent::Type::NoteOn, 4, start)), "Queue full");
+    expectEquals((int)queue.getDroppedCount(), 1);
+
+    // Three fit in the block, the fourth plays on the next one
+    queue.collectBlock(start + toTicks(0.01), kBlockSize, small);
+    expectEquals(small.size(), 3);
+    queue.collectBlock(start + toTicks(0.02), kBlockSize, small);
+    expectEquals(small.size(), 1);
+    expectEquals((int)small[0].note, 3);
+    expectEquals(small[0].offset, 0);
+  }
+
+  void testJitter() {
+    MidiInputQueue queue;
+    queue.prepare(kSampleRate);
+    MidiEventList events;
+    const juce::int64 start = toTicks(40.0);
+    queue.collectBlock(start, kBlockSize, events);
+
+    // The callback comes 5 ms late: the event cannot keep its spacing
+    queue.push(makeEvent(MidiEvent::Type::NoteOn, 60, start + toTicks(0.012)));
+    queue.collectBlock(start + toTicks(0.015), kBlockSize, events);
+    expectEquals(events.size(), 1);
+    expectEquals(events.isEmpty() ? -1 : events[0].offset, kBlockSize - 1);
+
+    const auto jitter = queue.getJitter().getSnapshot();
+    expectWithinAbsoluteError(jitter.max, 0.003, 2.0 / kSampleRate);
+    expectWithinAbsoluteError(queue.getLatency().getSnapshot().max, 0.013,
+                              2.0 / kSampleRate);
+  }
+
+  void testRenderWithEvents() {
+    const TempoMap map(120.0, kSampleRate);
+    const BeatContext context = map.getContext(1000);
+    juce::AudioBuffer<float> buffer(1, 512);
+
+    MidiEventList events;
+    events.add(makeEvent(MidiEvent::Type::NoteOn, 60, 0, 0));
+    events.add(makeEvent(MidiEvent::Type::NoteOn, 64, 0, 100));
+    events.add(makeEvent(MidiEvent::Type::NoteOff, 60, 0, 100));
+    events.add(makeEvent(MidiEvent::Type::NoteOff, 64, 0, 300));
+    events.add(makeEvent(MidiEvent::Type::NoteOn, 67, 0, 600));  // Outside
+
+    RecordingTrack track;
+    track.renderWithEvents(buffer, 0, 512, context, events);
+    expect(track.notes == std::vector<int>({60, 64, -60, -64}));
+    expectEquals((int)track.calls.size(), 3);
+    const int starts[] = {0, 100, 300};
+    const int lengths[] = {100, 200, 212};
+    for (size_t i = 0; i < track.calls.size() && i < 3; ++i) {
+      expectEquals(track.calls[i].startSample, starts[i]);
+      expectEquals(track.calls[i].numSamples, lengths[i]);
+      expectEquals(track.calls[i].sample, (juce::int64)(1000 + starts[i]));
+    }
+
+    // A later span of the block only plays its own events
+    RecordingTrack later;
+    later.renderWithEvents(buffer, 256, 256, map.getContext(1256), events);
+    expect(later.notes == std::vector<int>({-64}));
+    expectEquals((int)later.calls.size(), 2);
+    expectEquals(later.calls[1].startSample, 300);
+    expectEquals(later.calls[1].sample, (juce::int64)1300);
+  }
+
+  void testEngineDelivery() {
+    MixEngine engine(0);
+    auto armed = std::make_shared<RecordingTrack>();
+    auto other = std::make_shared<RecordingTrack>();
+    engine.addTrack(armed);
+    engine.addTrack(other);
+    engine.prepare(512, kSampleRate);
+
+    MidiInputQueue input;
+    input.prepare(kSampleRate);
+    engine.setMidiInput(&input);
+
+    EngineCommand command;
+    command.type = EngineCommand::Type::SetTrackMidiInput;
+    command.track = armed;
+    command.value = 1.0;
+    expect(engine.sendCommand(command));
+
+    juce::AudioBuffer<float> output(2, 512);
+    engine.process(output, 0, 512);
+    expect(armed->receivesMidi && !other->receivesMidi);
+
+    const auto firstCall = armed->calls.size();
+    input.push(makeEvent(MidiEvent::Type::NoteOn, 60, EngineProfiler::now()));
+    engine.process(output, 0, 512);
+    expect(armed->notes == std::vector<int>({60}));
+    expect(other->notes.empty(), "Unarmed tracks get no notes");
+    expectEquals((int)input.getLatency().getSnapshot().getCount(), 1);
+
+    // The split render still covers the block
+    int rendered = 0;
+    for (size_t i = firstCall; i < armed->calls.size(); ++i) {
+      rendered += armed->calls[i].numSamples;
+    }
+    expectEquals(rendered, 512);
+
+    // Stopped: notes are still delivered, nothing is rendered
+    command.type = EngineCommand::Type::Stop;
+    command.track = nullptr;
+    expect(engine.sendCommand(command));
+    engine.process(output, 0, 512);
+    const auto numCalls = armed->calls.size();
+    input.push(makeEvent(MidiEvent::Type::NoteOff, 60, EngineProfiler::now()));
+    engine.process(output, 0, 512);
+    expect(armed->notes == std::vector<int>({60, -60}));
+    expectEquals((int)armed->calls.size(), (int)numCalls);
+  }
+
+  void testProfileExport() {
+    MidiInputQueue queue;
+    queue.prepare(kSampleRate);
+    MidiEventList events;
+    const juce::int64 start = toTicks(50.0);
+    queue.collectBlock(start, kBlockSize, events);
+    queue.push(makeEvent(MidiEvent::Type::NoteOn, 60, start + toTicks(0.00201)));
+    queue.collectBlock(start + toTicks(0.01), kBlockSize, events);
+
+    ProfileSnapshot previous;
+    ProfileSnapshot current;
+    current.midiLatency = queue.getLatency().getSnapshot();
+    current.midiJitter = queue.getJitter().getSnapshot();
+    current.midiDropped = 3;
+
+    std::string text;
+    EngineProfiler::writePrometheus(current, text);
+    expect(text.find("# TYPE daw_midi_latency_seconds histogram") != std::string::npos);
+    expect(text.find("daw_midi_latency_seconds_bucket{le=\"0.01\"} 1") != std::string::npos);
+    expect(text.find("daw_midi_jitter_seconds_count 1") != std::string::npos);
+    expect(text.find("daw_midi_dropped_total 3") != std::string::npos);
+
+    const auto summary = EngineProfiler::describe(current, previous);
+    expectEquals((int)summary["midi"]["events"], 1);
+    expectEquals((int)summary["midi"]["dropped"], 3);
+    expectWithinAbsoluteError((double)summary["midi"]["latency"]["mean"], 0.01,
+                              1.0 / kSampleRate);
+  }
+
+  void testRealtime() {
+    MixEngine engine(0);
+    auto synth = std::make_shared<SynthTrack>(64);
+    synth->receivesMidi = true;
+    engine.addTrack(synth);
+    engine.prepare(256, kSampleRate);
+    MidiInputQueue input;
+    input.prepare(kSampleRate);
+    engine.setMidiInput(&input);
+    juce::AudioBuffer<float> output(2, 256);
+
+    const auto before = RealtimeGuard::getViolationCount();
+    for (int block = 0; block < 20; ++block) {
+      // Pushed by this thread, as a device thread would between callbacks
+      const auto now = EngineProfiler::now();
+      for (int note = 0; note < 8; ++note) {
+        input.push(makeEvent(note % 2 == 0 ? MidiEvent::Type::NoteOn : MidiEvent::Type::NoteOff,
+                             48 + block + note / 2, now));
+      }
+
+      const RealtimeGuard::Scope realtime;
+      engine.process(output, 0, 256);
+    }
+    expectEquals((int)(RealtimeGuard::getViolationCount() - before), 0);
+    expectEquals((int)input.getLatency().getSnapshot().getCount(), 160);
+  }
+};
+
+static MidiInputTests midiInputTests;
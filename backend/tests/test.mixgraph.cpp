@@ -0,0 +1,613 @@
+#include <juce_core/juce_core.h>
+#include <memory>
+#include <vector>
+#include "../include/audio-effect.hpp"
+#include "../include/beat-track.hpp"
+#include "../include/mix-engine.hpp"
+#include "../include/mix-graph.hpp"
+
+/**
+ * Unit tests for MixGraph and bus mixing in the MixEngine
+ * Tests plan order and levels, rejected loops, index updates on removal,
+ * shared bus buffers, bus gains and sends, effect tails and skipped buses,
+ * parallel bus mixes against serial ones, routing edits during playback,
+ * latency compensation and the lookahead limiter
+ */
+class MixGraphTests : public juce::UnitTest {
+ public:
+  MixGraphTests() : juce::UnitTest("MixGraph Tests") {}
+
+  void runTest() override {
+    beginTest("Buses are compiled in dependency order");
+    testPlanOrder();
+
+    beginTest("Loops are rejected");
+    testLoops();
+
+    beginTest("Removing tracks and buses updates the routes");
+    testRemoval();
+
+    beginTest("Bus buffers are shared when lifetimes do not overlap");
+    testBufferReuse();
+
+    beginTest("Buses apply their volume, pan and mute");
+    testBusGains();
+
+    beginTest("Sends are post-fader");
+    testSends();
+
+    beginTest("Effect tails play out, then the bus is skipped");
+    testEffectTail();
+
+    beginTest("Parallel bus mix matches serial mix");
+    testParallelMatchesSerial();
+
+    beginTest("Routing edits keep effect state");
+    testEditDuringPlayback();
+
+    beginTest("Paths are delayed to the latest one");
+    testCompensationPlan();
+
+    beginTest("Latent and direct paths arrive together");
+    testAlignedPaths();
+
+    beginTest("Compensation lines survive unrelated edits");
+    testCompensationKept();
+
+    beginTest("Limiter holds the ceiling with its lookahead as latency");
+    testLimiter();
+  }
+
+ private:
+  static constexpr double kSampleRate = 44100.0;
+
+  // Mono constant
+  class ConstantTrack : public AudioTrack {
+   public:
+    explicit ConstantTrack(float value) : value(value) { setVolume(1.0f); }
+
+    float getSampleValue(const BeatContext&) override { return value; }
+
+    RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                               int numSamples, const BeatContext&) override {
+      juce::FloatVectorOperations::fill(buffer.getWritePointer(0, startSample), value,
+                                        numSamples);
+      return RenderActivity::whole(numSamples);
+    }
+
+    std::unique_ptr<AudioTrack> clone() const override {
+      return std::make_unique<ConstantTrack>(*this);
+    }
+
+   private:
+    float value;
+  };
+
+  // Ones for the first samples of playback, then silence
+  class BurstTrack : public AudioTrack {
+   public:
+    explicit BurstTrack(int length) : remaining(length) { setVolume(1.0f); }
+
+    float getSampleValue(const BeatContext&) override { return 0.0f; }
+
+    RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                               int numSamples, const BeatContext&) override {
+      const int count = juce::jmin(remaining, numSamples);
+      remaining -= count;
+      float* samples = buffer.getWritePointer(0, startSample);
+      juce::FloatVectorOperations::fill(samples, 1.0f, count);
+      juce::FloatVectorOperations::clear(samples + count, numSamples - count);
+      return count > 0 ? RenderActivity{0, count} : RenderActivity::silent();
+    }
+
+    std::unique_ptr<AudioTrack> clone() const override {
+      return std::make_unique<BurstTrack>(*this);
+    }
+
+   private:
+    int remaining;
+  };
+
+  // Delays by a whole number of samples, reported as its latency
+  class PureDelay : public AudioEffect {
+   public:
+    explicit PureDelay(int latency) : latency(latency) {}
+
+    void prepare(double, int) override {
+      for (auto& line : lines) {
+        line.assign((size_t)latency, 0.0f);
+      }
+      position = 0;
+    }
+
+    void process(float* const* channels, int numSamples) noexcept override {
+      for (int i = 0; i < numSamples; ++i) {
+        std::swap(channels[0][i], lines[0][(size_t)position]);
+        std::swap(channels[1][i], lines[1][(size_t)position]);
+        position = (position + 1) % latency;
+      }
+    }
+
+    void reset() noexcept override { prepare(0.0, 0); }
+    int getTailSamples() const noexcept override { return latency; }
+    int getLatencySamples() const noexcept override { return latency; }
+
+    std::unique_ptr<AudioEffect> clone() const override {
+      return std::make_unique<PureDelay>(latency);
+    }
+
+    juce::String getName() const override { return "pureDelay"; }
+
+    int latency;
+
+   private:
+    std::vector<float> lines[2];
+    int position = 0;
+  };
+
+  void testPlanOrder() {
+    // track 0 -> A -> B -> master, track 1 -> C -> master, A sends to C
+    MixGraph graph;
+    for (int i = 0; i < 3; ++i) {
+      graph.addTrack();
+    }
+    const int b = graph.addBus(std::make_shared<MixBus>("B"));
+    const int a = graph.addBus(std::make_shared<MixBus>("A"), b);
+    const int c = graph.addBus(std::make_shared<MixBus>("C"));
+    expect(graph.setTrackOutput(0, a));
+    expect(graph.setTrackOutput(1, c));
+    expect(graph.addSend(MixGraph::Source::bus(a), c, nullptr) == 0);
+
+    const auto plan = graph.compile();
+    expectEquals((int)plan->steps.size(), 3);
+    expectEquals((int)plan->levels.size(), 2);
+    expect(plan->steps[0].bus->name == "A", "A feeds the others: first");
+    expect(plan->steps[1].bus->name == "B" && plan->steps[2].bus->name == "C");
+    expectEquals(plan->levels[1].begin, 1);
+    expectEquals(plan->levels[1].end, 3);
+    expect(!plan->levels[1].parallel, "No insert chain to run in parallel");
+
+    // C pulls the send from A; the master pulls B then C
+    const auto& stepC = plan->steps[2];
+    expectEquals(stepC.numInputs, 1);
+    expectEquals(plan->inputs[(size_t)stepC.firstInput].source, 0);
+    expect(plan->inputs[(size_t)stepC.firstInput].send != nullptr);
+    expectEquals(plan->numMasterInputs, 2);
+    expectEquals(plan->inputs[(size_t)plan->firstMasterInput].source, 1);
+
+    expectEquals(plan->tracks[0].output, 0);
+    expectEquals(plan->tracks[1].output, 2);
+    expectEquals(plan->tracks[2].output, (int)MixPlan::kMaster);
+  }
+
+  void testLoops() {
+    MixGraph graph;
+    graph.addTrack();
+    const int a = graph.addBus(nullptr);
+    const int b = graph.addBus(nullptr, a);
+    const int c = graph.addBus(nullptr, b);
+
+    expect(!graph.setBusOutput(a, a), "A bus cannot feed itself");
+    expect(!graph.setBusOutput(a, c), "a -> c -> b -> a is a loop");
+    expectEquals(graph.getBuses()[(size_t)a].output, (int)MixGraph::kMaster);
+    expectEquals(graph.addSend(MixGraph::Source::bus(a), c, nullptr), -1);
+    expectEquals(graph.addSend(MixGraph::Source::bus(b), b, nullptr), -1);
+    expect(graph.getSends().empty());
+
+    // Sends forward are fine, and tracks cannot make loops
+    expect(graph.addSend(MixGraph::Source::bus(c), a, nullptr) >= 0);
+    expect(graph.setTrackOutput(0, c));
+    expect(!graph.setTrackOutput(0, 7), "No such bus");
+    expect(!graph.setTrackOutput(1, a), "No such track");
+    expectEquals((int)graph.compile()->steps.size(), 3);
+  }
+
+  void testRemoval() {
+    MixGraph graph;
+    for (int i = 0; i < 3; ++i) {
+      graph.addTrack();
+    }
+    const int a = graph.addBus(nullptr);
+    const int b = graph.addBus(nullptr);
+    const int c = graph.addBus(nullptr, b);
+    graph.setTrackOutput(0, a);
+    graph.setTrackOutput(2, c);
+    graph.addSend(MixGraph::Source::track(1), a, nullptr);
+    graph.addSend(MixGraph::Source::track(2), a, nullptr);
+    graph.addSend(MixGraph::Source::bus(c), a, nullptr);
+
+    // Track 1 and its send go, track 2 becomes track 1
+    graph.removeTrack(1);
+    expectEquals(graph.getNumTracks(), 2);
+    expectEquals(graph.getTrackOutput(1), c);
+    expectEquals((int)graph.getSends().size(), 2);
+    expectEquals(graph.getSends()[0].source.index, 1);
+
+    // Bus a goes with its sends, track 0 falls back to the master
+    expect(graph.removeBus(a));
+    expectEquals(graph.getTrackOutput(0), (int)MixGraph::kMaster);
+    expectEquals(graph.getTrackOutput(1), c - 1);
+    expectEquals(graph.getBuses()[(size_t)(c - 1)].output, b - 1);
+    expect(graph.getSends().empty());
+    expect(!graph.removeBus(5));
+  }
+
+  void testBufferReuse() {
+    // Tracks -> A -> B -> C -> master: A is free once B has pulled it
+    MixGraph graph;
+    graph.addTrack();
+    const int c = graph.addBus(nullptr);
+    const int b = graph.addBus(nullptr, c);
+    const int a = graph.addBus(nullptr, b);
+    graph.setTrackOutput(0, a);
+
+    auto plan = graph.compile();
+    expectEquals(plan->numBuffers, 2);
+    expectEquals(plan->steps[0].buffer, plan->steps[2].buffer);
+    expect(plan->steps[0].buffer != plan->steps[1].buffer);
+
+    // Buses fed by tracks are written from the start: never shared
+    graph.addTrack();
+    graph.setTrackOutput(1, c);
+    plan = graph.compile();
+    expectEquals(plan->numBuffers, 3);
+  }
+
+  void testBusGains() {
+    MixEngine engine(0);
+    engine.addTrack(std::make_shared<ConstantTrack>(1.0f));
+    engine.addTrack(std::make_shared<ConstantTrack>(1.0f));
+    auto bus = std::make_shared<MixBus>("Group");
+    bus->setVolume(0.5f);
+    bus->setPan(1.0f);
+    const int index = engine.addBus(bus);
+    expect(engine.setTrackOutput(0, index));
+    engine.prepare(256, kSampleRate);
+
+    // Track 1 direct, track 0 through the bus, hard right (master 0.5)
+    juce::AudioBuffer<float> output(2, 256);
+    engine.process(output, 0, 256);
+    expectEquals(output.getSample(0, 100), 0.5f);
+    expectWithinAbsoluteError(output.getSample(1, 100),
+                              0.5f + 0.5f * std::sqrt(2.0f) * 0.5f, 1.0e-6f);
+
+    // Muted bus: silence once the fade is over
+    EngineCommand command;
+    command.type = EngineCommand::Type::SetBusMute;
+    command.bus = bus;
+    command.value = 1.0;
+    expect(engine.sendCommand(command));
+    const int smoothing = juce::roundToInt(ChannelStrip::kSmoothingSeconds * kSampleRate);
+    for (int done = 0; done <= smoothing; done += 256) {
+      engine.process(output, 0, 256);
+    }
+    expectEquals(output.getSample(1, 255), 0.5f);
+    engine.process(output, 0, 256);
+    expect(bus->strip.isSilent(), "Muted bus is skipped");
+  }
+
+  void testSends() {
+    MixEngine engine(0);
+    auto track = std::make_shared<ConstantTrack>(1.0f);
+    track->setVolume(0.5f);
+    track->setPan(-1.0f);
+    engine.addTrack(track);
+    const int reverb = engine.addBus(std::make_shared<MixBus>("Return"));
+    expectEquals(engine.addSend(MixGraph::Source::track(0), reverb,
+                                std::make_shared<MixSend>(0.5f)),
+                 0);
+    engine.prepare(256, kSampleRate);
+
+    // Hard left direct; the send is unpanned, at the track volume
+    juce::AudioBuffer<float> output(2, 256);
+    engine.process(output, 0, 256);
+    expectWithinAbsoluteError(output.getSample(0, 10),
+                              (0.5f * std::sqrt(2.0f) + 0.25f) * 0.5f, 1.0e-6f);
+    expectWithinAbsoluteError(output.getSample(1, 10), 0.25f * 0.5f, 1.0e-6f);
+
+    // Post-fader: a muted track does not feed the send
+    track->setMute(true);
+    const int smoothing = juce::roundToInt(ChannelStrip::kSmoothingSeconds * kSampleRate);
+    for (int done = 0; done <= smoothing; done += 256) {
+      engine.process(output, 0, 256);
+    }
+    engine.process(output, 0, 256);
+    expectEquals(output.getMagnitude(0, 0, 256), 0.0f);
+    expectEquals(output.getMagnitude(1, 0, 256), 0.0f);
+
+    expect(engine.removeSend(0));
+    expect(engine.getSend(0) == nullptr);
+  }
+
+  void testEffectTail() {
+    MixEngine engine(0);
+    engine.addTrack(std::make_shared<BurstTrack>(64));
+    auto bus = std::make_shared<MixBus>("Echo");
+    const int index = engine.addBus(bus);
+    engine.setTrackOutput(0, index);
+    engine.prepare(512, kSampleRate);
+    auto delay = std::make_shared<DelayEffect>(0.01, 0.5f, 1.0f);
+    expect(engine.setEffects(index, {delay}));
+
+    // Dry burst, then its echo 441 samples later (master 0.5)
+    juce::AudioBuffer<float> output(2, 512);
+    engine.process(output, 0, 512);
+    expectEquals(output.getSample(0, 10), 0.5f);
+    expectEquals(output.getSample(0, 200), 0.0f);
+    expectEquals(output.getSample(1, 441), 0.5f);
+
+    // The input is silent: the bus runs for the tail of the delay only
+    const int tail = delay->getTailSamples();
+    expectEquals(tail, 441 * 17);
+    bool echoes = false;
+    for (int block = 0; block < (tail + 511) / 512; ++block) {
+      engine.process(output, 0, 512);
+      echoes = echoes || output.getMagnitude(0, 0, 512) > 0.0f;
+      expect(!bus->activity.isSilent(), "Still in the tail");
+    }
+    expect(echoes, "Echoes after the input has stopped");
+    engine.process(output, 0, 512);
+    expect(bus->activity.isSilent(), "Skipped after the tail");
+    expectEquals(bus->tailRemaining, 0);
+    expectEquals(output.getMagnitude(0, 0, 512), 0.0f);
+  }
+
+  void testParallelMatchesSerial() {
+    constexpr int numTracks = 16;
+    constexpr int blockSize = 256;
+
+    MixEngine serial(0);
+    MixEngine parallel(3);
+    parallel.setParallelTrackThreshold(2);
+    std::vector<std::shared_ptr<MixBus>> serialBuses;
+    std::vector<std::shared_ptr<MixBus>> parallelBuses;
+
+    for (auto* engine : {&serial, &parallel}) {
+      for (int i = 0; i < numTracks; ++i) {
+        auto track = std::make_shared<BeatTrack>(110.0f + 30.0f * (float)i);
+        track->setVolume(0.2f + 0.04f * (float)i);
+        track->setPan(-1.0f + (float)i / 8.0f);
+        engine->addTrack(track);
+      }
+
+      // Four groups with filters and delays, summed by a group bus; a
+      // return bus fed by sends from tracks and one group
+      auto& buses = engine == &serial ? serialBuses : parallelBuses;
+      const int groupBus = engine->addBus(std::make_shared<MixBus>("Groups"));
+      const int returnBus = engine->addBus(std::make_shared<MixBus>("Return"));
+      engine->setEffects(returnBus, {std::make_shared<DelayEffect>(0.003, 0.6f, 0.4f)});
+      for (int group = 0; group < 4; ++group) {
+        auto bus = std::make_shared<MixBus>();
+        bus->setPan(-0.6f + 0.4f * (float)group);
+        buses.push_back(bus);
+        const int index = engine->addBus(bus, groupBus);
+        engine->setEffects(
+            index, {std::make_shared<BiquadFilter>(group % 2 == 0 ? BiquadFilter::Type::LowPass
+                                                                  : BiquadFilter::Type::HighPass,
+                                                   300.0 + 400.0 * group, 0.9),
+                    std::make_shared<DelayEffect>(0.002 * (group + 1), 0.3f, 0.5f)});
+        for (int track = group; track < numTracks; track += 4) {
+          engine->setTrackOutput((size_t)track, index);
+        }
+        if (group == 1) {
+          engine->addSend(MixGraph::Source::bus(index), returnBus,
+                          std::make_shared<MixSend>(0.7f));
+        }
+      }
+      for (int track = 0; track < numTracks; track += 3) {
+        engine->addSend(MixGraph::Source::track(track), returnBus,
+                        std::make_shared<MixSend>(0.3f));
+      }
+      engine->prepare(blockSize, kSampleRate);
+    }
+
+    const auto plan = parallel.getGraph().compile();
+    expect(plan->levels.size() == 2 && plan->levels[0].parallel,
+           "Group buses run side by side");
+
+    juce::AudioBuffer<float> serialOutput(2, blockSize);
+    juce::AudioBuffer<float> parallelOutput(2, blockSize);
+    bool identical = true;
+    for (int block = 0; block < 100; ++block) {
+      // Bus volume and mute changes mid-block
+      if (block % 10 == 3) {
+        for (auto* buses : {&serialBuses, &parallelBuses}) {
+          for (auto type : {EngineCommand::Type::SetBusVolume, EngineCommand::Type::SetBusMute}) {
+            EngineCommand command;
+            command.type = type;
+            command.bus = (*buses)[(size_t)(block / 10 % 4)];
+            command.value = type == EngineCommand::Type::SetBusMute
+                                ? (double)((block / 10) % 2)
+                                : 0.9 - 0.05 * (block / 10);
+            command.sample = (juce::int64)block * blockSize + 61;
+            (buses == &serialBuses ? serial : parallel).sendCommand(command);
+          }
+        }
+      }
+
+      serial.process(serialOutput, 0, blockSize);
+      parallel.process(parallelOutput, 0, blockSize);
+      for (int channel = 0; channel < 2; ++channel) {
+        for (int i = 0; i < blockSize; ++i) {
+          identical = identical && serialOutput.getSample(channel, i) ==
+                                       parallelOutput.getSample(channel, i);
+        }
+      }
+    }
+    expect(identical, "Parallel and serial bus mixes must be bit-identical");
+    expect(serialOutput.getMagnitude(0, 0, blockSize) > 0.0f);
+  }
+
+  void testEditDuringPlayback() {
+    MixEngine engine(0);
+    engine.addTrack(std::make_shared<BurstTrack>(64));
+    const int index = engine.addBus(std::make_shared<MixBus>("Echo"));
+    engine.setTrackOutput(0, index);
+    engine.prepare(512, kSampleRate);
+    engine.setEffects(index, {std::make_shared<DelayEffect>(0.02, 0.5f, 1.0f)});
+
+    juce::AudioBuffer<float> output(2, 512);
+    engine.process(output, 0, 512);
+
+    // New routing published between two blocks: the pending echo (882
+    // samples after the burst) still comes out of the same delay line
+    engine.addTrack(std::make_shared<ConstantTrack>(0.0f));
+    const int other = engine.addBus(nullptr);
+    expect(engine.setTrackOutput(1, other));
+    expect(engine.setBusOutput(other, index));
+    expectEquals(engine.getBusCount(), 2);
+
+    engine.process(output, 0, 512);
+    expectEquals(output.getSample(0, 882 - 512), 0.5f);
+    expectEquals(output.getSample(0, 882 - 512 + 64), 0.0f);
+  }
+
+  void testCompensationPlan() {
+    // track 0 -> A (latency 100) -> master, track 1 -> B -> master, B sends
+    // to A, track 2 -> master
+    MixGraph graph;
+    for (int i = 0; i < 3; ++i) {
+      graph.addTrack();
+    }
+    const int a = graph.addBus(std::make_shared<MixBus>("A"));
+    const int b = graph.addBus(std::make_shared<MixBus>("B"));
+    auto delay = std::make_shared<PureDelay>(100);
+    expect(graph.setEffects(a, {delay}));
+    graph.setTrackOutput(0, a);
+    graph.setTrackOutput(1, b);
+    graph.addSend(MixGraph::Source::bus(b), a, nullptr);
+
+    const auto plan = graph.compile();
+    expectEquals(plan->latency, 100);
+    const auto& stepA = plan->steps[1];
+    expect(stepA.bus->name == "A");
+    expectEquals(stepA.latency, 100);
+    expectEquals(stepA.trackDelay, -1);
+    expectEquals(plan->inputs[(size_t)stepA.firstInput].delay, -1);
+
+    // The master delays B and its own tracks to meet A
+    expectEquals(plan->numMasterInputs, 2);
+    const auto& inputB = plan->inputs[(size_t)plan->firstMasterInput];
+    expectEquals(inputB.source, 0);
+    expect(inputB.delay >= 0 && plan->compensations[(size_t)inputB.delay].samples == 100);
+    expectEquals(plan->inputs[(size_t)plan->firstMasterInput + 1].delay, -1);
+    expect(plan->masterTrackDelay >= 0);
+    const auto& tracks = plan->compensations[(size_t)plan->masterTrackDelay];
+    expect(tracks.tracks && tracks.path == nullptr && tracks.samples == 100);
+    expectEquals((int)plan->compensations.size(), 2);
+
+    // Inserts on the master add to the latency without delaying anything
+    graph.setEffects(MixGraph::kMaster, {std::make_shared<PureDelay>(30)});
+    expectEquals(graph.compile()->latency, 130);
+    expectEquals((int)graph.compile()->compensations.size(), 2);
+
+    // Recomputed in place, the delays are those of a new compile
+    MixPlan refreshed = *graph.compile();
+    delay->latency = 250;
+    refreshed.compensateLatency();
+    const auto compiled = graph.compile();
+    expectEquals(refreshed.latency, 280);
+    expectEquals(refreshed.steps[1].latency, compiled->steps[1].latency);
+    expect(refreshed.compensations == compiled->compensations);
+  }
+
+  void testAlignedPaths() {
+    // Same routing as the plan test, every track a 64-sample burst
+    MixEngine engine(0);
+    for (int i = 0; i < 3; ++i) {
+      engine.addTrack(std::make_shared<BurstTrack>(64));
+    }
+    const int a = engine.addBus(std::make_shared<MixBus>("A"));
+    const int b = engine.addBus(std::make_shared<MixBus>("B"));
+    engine.setTrackOutput(0, a);
+    engine.setTrackOutput(1, b);
+    engine.addSend(MixGraph::Source::bus(b), a, nullptr);
+    engine.prepare(512, kSampleRate);
+    expect(engine.setEffects(a, {std::make_shared<PureDelay>(100)}));
+    expectEquals(engine.getLatencySamples(), 100);
+
+    // Four bursts land on samples 100 to 163 (master 0.5)
+    juce::AudioBuffer<float> output(2, 512);
+    engine.process(output, 0, 512);
+    expectEquals(output.getMagnitude(0, 0, 100), 0.0f);
+    expectEquals(output.getSample(0, 100), 2.0f);
+    expectEquals(output.getSample(1, 163), 2.0f);
+    expectEquals(output.getMagnitude(0, 164, 512 - 164), 0.0f);
+
+    engine.process(output, 0, 512);
+    expectEquals(output.getMagnitude(0, 0, 512), 0.0f);
+  }
+
+  void testCompensationKept() {
+    MixEngine engine(0);
+    engine.addTrack(std::make_shared<BurstTrack>(64));
+    engine.addTrack(std::make_shared<BurstTrack>(64));
+    const int index = engine.addBus(std::make_shared<MixBus>("Latent"));
+    engine.setTrackOutput(0, index);
+    engine.prepare(512, kSampleRate);
+    auto delay = std::make_shared<PureDelay>(700);
+    engine.setEffects(index, {delay});
+
+    juce::AudioBuffer<float> output(2, 512);
+    engine.process(output, 0, 512);
+    expectEquals(output.getMagnitude(0, 0, 512), 0.0f);
+
+    // Both bursts are still in flight when another bus is added: the
+    // direct track keeps its line
+    expect(engine.addBus(nullptr) == 1);
+    engine.process(output, 0, 512);
+    expectEquals(output.getSample(0, 700 - 512), 1.0f);
+    expectEquals(output.getSample(0, 700 - 512 + 64), 0.0f);
+
+    // A latency changed behind the engine's back is picked up on request
+    expect(!engine.refreshLatency(), "Nothing changed");
+    delay->latency = 300;
+    delay->prepare(kSampleRate, 512);
+    expect(engine.refreshLatency());
+    expectEquals(engine.getLatencySamples(), 300);
+    expect(!engine.refreshLatency());
+  }
+
+  void testLimiter() {
+    LimiterEffect limiter(0.5f, 0.001, 0.005);
+    limiter.prepare(kSampleRate, 512);
+    const int lookahead = limiter.getLatencySamples();
+    expectEquals(lookahead, 44);
+    expectEquals(limiter.getTailSamples(), lookahead);
+
+    // Quiet input comes out unchanged, late by the lookahead
+    juce::AudioBuffer<float> buffer(2, 512);
+    for (int i = 0; i < 512; ++i) {
+      buffer.setSample(0, i, 0.25f * std::sin(0.05f * (float)i));
+      buffer.setSample(1, i, 0.25f * std::cos(0.05f * (float)i));
+    }
+    juce::AudioBuffer<float> input(buffer);
+    limiter.process(buffer.getArrayOfWritePointers(), 512);
+    expectEquals(buffer.getMagnitude(0, 0, lookahead), 0.0f);
+    for (int i = lookahead; i < 512; i += 37) {
+      expectWithinAbsoluteError(buffer.getSample(0, i), input.getSample(0, i - lookahead),
+                                1.0e-6f);
+      expectWithinAbsoluteError(buffer.getSample(1, i), input.getSample(1, i - lookahead),
+                                1.0e-6f);
+    }
+
+    // A loud burst never goes over the ceiling, even on its first sample
+    float peak = 0.0f;
+    for (int block = 0; block < 8; ++block) {
+      for (int i = 0; i < 512; ++i) {
+        const float value = block >= 2 && block < 4 ? 2.0f * std::sin(0.02f * (float)i) : 0.1f;
+        buffer.setSample(0, i, value);
+        buffer.setSample(1, i, -value);
+      }
+      limiter.process(buffer.getArrayOfWritePointers(), 512);
+      peak = juce::jmax(peak, buffer.getMagnitude(0, 0, 512), buffer.getMagnitude(1, 0, 512));
+    }
+    expect(peak <= 0.5f + 1.0e-5f, "Output above the ceiling");
+    expect(peak > 0.45f, "Limited, not silenced");
+
+    // The gain recovers once the burst is over
+    expectWithinAbsoluteError(buffer.getSample(0, 511), 0.1f, 1.0e-3f);
+  }
+};
+
+static MixGraphTests mixGraphTests;
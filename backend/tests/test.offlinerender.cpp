@@ -0,0 +1,147 @@
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_core/juce_core.h>
+#include "../include/audio-context.hpp"
+#include "../include/beat-track.hpp"
+#include "../include/mix-engine.hpp"
+#include "../include/offline-renderer.hpp"
+
+/**
+ * Unit tests for the OfflineRenderer and MixEngine classes
+ * Tests file output, equivalence with the live pipeline, the render sample
+ * rate, and error handling
+ */
+class OfflineRenderTests : public juce::UnitTest {
+ public:
+  OfflineRenderTests() : juce::UnitTest("OfflineRender Tests") {}
+
+  void runTest() override {
+    beginTest("Render to WAV matches the live pipeline");
+    testRenderMatchesMixEngine();
+
+    beginTest("Render to FLAC at its own sample rate");
+    testRenderFlac();
+
+    beginTest("Unsupported format is reported");
+    testUnsupportedFormat();
+
+    beginTest("Failed writers leave no file");
+    testUnsupportedBitDepth();
+  }
+
+ private:
+  static juce::File getTempFile(const juce::String& name) {
+    return juce::File::getSpecialLocation(juce::File::tempDirectory)
+        .getChildFile(name);
+  }
+
+  static std::vector<std::shared_ptr<AudioTrack>> makeSession() {
+    return {std::make_shared<BeatTrack>(440.0f),
+            std::make_shared<BeatTrack>(660.0f)};
+  }
+
+  std::unique_ptr<juce::AudioFormatReader> openReader(juce::AudioFormat& format,
+                                                      const juce::File& file) {
+    return std::unique_ptr<juce::AudioFormatReader>(
+        format.createReaderFor(file.createInputStream().release(), true));
+  }
+
+  void testRenderMatchesMixEngine() {
+    auto& ctx = AudioContext::getInstance();
+    ctx.sampleRate = 44100.0;
+
+    OfflineRenderer::Settings settings;
+    settings.outputFile = getTempFile("daw-offline-render-test.wav");
+    settings.sampleRate = ctx.sampleRate;
+    settings.durationSeconds = 2.0;
+    settings.bitDepth = 32;
+    settings.numRenderThreads = 0;
+
+    const auto result = OfflineRenderer::render(makeSession(), settings);
+    expect(result.success, result.errorMessage);
+    expectEquals(result.numSamples, (juce::int64)88200);
+    logMessage("Offline render speed: " +
+               juce::String(result.realtimeFactor, 1) + "x realtime");
+
+    juce::WavAudioFormat wav;
+    auto reader = openReader(wav, settings.outputFile);
+    expect(reader != nullptr, "Rendered file should be readable");
+    if (reader == nullptr) {
+      return;
+    }
+    expectEquals((int)reader->numChannels, 2);
+    expectEquals(reader->lengthInSamples, (juce::int64)88200);
+
+    juce::AudioBuffer<float> fromFile(2, (int)reader->lengthInSamples);
+    reader->read(&fromFile, 0, fromFile.getNumSamples(), 0, true, true);
+
+    // Drive the live pipeline with device-sized blocks over the same span
+    MixEngine engine(0);
+    for (const auto& track : makeSession()) {
+      engine.addTrack(track);
+    }
+    engine.prepare(512, ctx.sampleRate);
+
+    juce::AudioBuffer<float> live(2, fromFile.getNumSamples());
+    for (int start = 0; start < live.getNumSamples(); start += 512) {
+      engine.process(live, start,
+                     juce::jmin(512, live.getNumSamples() - start));
+    }
+
+    float maxDifference = 0.0f;
+    for (int i = 0; i < live.getNumSamples(); ++i) {
+      maxDifference = juce::jmax(
+          maxDifference,
+          std::abs(live.getSample(0, i) - fromFile.getSample(0, i)));
+    }
+    expect(fromFile.getMagnitude(0, 0, fromFile.getNumSamples()) > 0.01f,
+           "Rendered file should contain audio");
+    expect(maxDifference < 1.0e-4f,
+           "Offline render should match the live pipeline");
+
+    settings.outputFile.deleteFile();
+  }
+
+  void testRenderFlac() {
+    // The device rate stays at 44.1 kHz
+    OfflineRenderer::Settings settings;
+    settings.outputFile = getTempFile("daw-offline-render-test.flac");
+    settings.sampleRate = 48000.0;
+    settings.durationSeconds = 1.0;
+    settings.bitDepth = 24;
+
+    const auto result = OfflineRenderer::render(makeSession(), settings);
+    expect(result.success, result.errorMessage);
+
+    juce::FlacAudioFormat flac;
+    auto reader = openReader(flac, settings.outputFile);
+    expect(reader != nullptr, "Rendered FLAC should be readable");
+    if (reader != nullptr) {
+      expectEquals(reader->lengthInSamples, (juce::int64)48000);
+      expectEquals((int)reader->sampleRate, 48000);
+    }
+
+    settings.outputFile.deleteFile();
+  }
+
+  void testUnsupportedFormat() {
+    OfflineRenderer::Settings settings;
+    settings.outputFile = getTempFile("daw-offline-render-test.mp3");
+
+    const auto result = OfflineRenderer::render(makeSession(), settings);
+    expect(!result.success, "MP3 output is not supported");
+    expect(result.errorMessage.isNotEmpty(), "Error should be explained");
+  }
+
+  void testUnsupportedBitDepth() {
+    OfflineRenderer::Settings settings;
+    settings.outputFile = getTempFile("daw-offline-render-test-12bit.wav");
+    settings.bitDepth = 12;
+
+    const auto result = OfflineRenderer::render(makeSession(), settings);
+    expect(!result.success, "WAV has no 12-bit format");
+    expect(result.errorMessage.isNotEmpty(), "Error should be explained");
+    expect(!settings.outputFile.exists(), "The empty file is removed");
+  }
+};
+
+static OfflineRenderTests offlineRenderTests;
@@ -0,0 +1,381 @@
+#include <juce_core/juce_core.h>
+#include <vector>
+#include "../include/audio-context.hpp"
+#include "../include/mix-engine.hpp"
+#include "../include/pattern-track.hpp"
+#include "../include/realtime-guard.hpp"
+#include "../include/transport.hpp"
+
+/**
+ * Unit tests for the PatternTrack class
+ * Tests the compiled cycle (positions, swing, rests, order, wrapping),
+ * notes starting and ending on their sample whatever the block size, pattern
+ * swaps and seeks during playback, recompilation on tempo changes, clones
+ * and real-time safety of rendering
+ */
+class PatternTrackTests : public juce::UnitTest {
+ public:
+  PatternTrackTests() : juce::UnitTest("PatternTrack Tests") {}
+
+  void runTest() override {
+    AudioContext::getInstance().sampleRate = kSampleRate;
+
+    beginTest("Steps compile to a cycle of sorted positions");
+    testCompile();
+
+    beginTest("Swing delays odd steps");
+    testSwing();
+
+    beginTest("Notes start and end on their sample");
+    testExactSamples();
+
+    beginTest("Long blocks split at note events");
+    testBlockSplit();
+
+    beginTest("Swapped patterns keep sounding notes");
+    testSwap();
+
+    beginTest("Seeking releases sounding notes");
+    testSeek();
+
+    beginTest("Tempo changes recompile the timeline");
+    testTempoChange();
+
+    beginTest("Clones keep the pattern without voices");
+    testClone();
+
+    beginTest("Rendering and swaps are real-time safe");
+    testRealtime();
+  }
+
+ private:
+  static constexpr double kSampleRate = 48000.0;
+
+  // 120 BPM: a sixteenth note lasts 6000 samples
+  static constexpr juce::int64 kStep = 6000;
+
+  // Records the notes played, on the sample set before each block
+  struct RecordingTrack : PatternTrack {
+    struct Call {
+      juce::int64 sample;
+      int note;
+      bool on;
+    };
+
+    RecordingTrack() { calls.reserve(4096); }
+
+    void noteOn(int note, float velocity) noexcept override {
+      calls.push_back({now, note, true});
+      PatternTrack::noteOn(note, velocity);
+    }
+
+    void noteOff(int note) noexcept override {
+      calls.push_back({now, note, false});
+      PatternTrack::noteOff(note);
+    }
+
+    juce::int64 now = 0;
+    std::vector<Call> calls;
+  };
+
+  // Renders numSamples samples in blocks of blockSize into output
+  struct Renderer {
+    TempoMap map{120.0, kSampleRate};
+    Transport transport;
+    juce::AudioBuffer<float> buffer{1, 4096};
+
+    void render(PatternTrack& track, float* output, int numSamples,
+                int blockSize = 64) {
+      auto* recording = dynamic_cast<RecordingTrack*>(&track);
+      for (int done = 0; done < numSamples;) {
+        int count = std::min(blockSize, numSamples - done);
+        const BeatContext context = transport.getContext(map, count);
+        if (recording != nullptr) {
+          recording->now = context.sample;
+        }
+        track.renderBlock(buffer, 0, count, context);
+        transport.advance(count);
+        if (output != nullptr) {
+          std::copy(buffer.getReadPointer(0), buffer.getReadPointer(0) + count,
+                    output + done);
+        }
+        done += count;
+      }
+    }
+  };
+
+  static Pattern makePattern(std::vector<PatternStep> steps) {
+    Pattern pattern;
+    pattern.steps = std::move(steps);
+    return pattern;
+  }
+
+  static PatternStep makeStep(int note, double length = 1.0, double swing = 0.0) {
+    PatternStep step;
+    step.note = note;
+    step.length = length;
+    step.swing = swing;
+    return step;
+  }
+
+  static PatternStep makeRest() {
+    PatternStep step;
+    step.velocity = 0.0f;
+    return step;
+  }
+
+  static ADSRParameters getShortEnvelope() {
+    ADSRParameters adsr;
+    adsr.attackTime = 0.001f;
+    adsr.decayTime = 0.001f;
+    adsr.sustainLevel = 1.0f;
+    adsr.releaseTime = 0.002f;
+    return adsr;
+  }
+
+  void testCompile() {
+    const TempoMap map(120.0, kSampleRate);
+    auto pattern = makePattern({makeStep(36, 0.5), makeRest(), makeStep(38, 2.0)});
+    pattern.startBeat = 1.0;
+    const auto timeline = PatternTimeline::compile(pattern, map);
+
+    // One cycle is compiled; cursors place it on every repetition
+    expectEquals((int)timeline->notes.size(), 2);
+    expectEquals(timeline->tempoMapId, map.getId());
+    expectEquals(timeline->notes[0].note, 36);
+    expectEquals(timeline->notes[1].note, 38);
+    for (juce::int64 cycle = 0; cycle < 3; ++cycle) {
+      const auto origin = 24000 + cycle * 3 * kStep;
+      const PatternTimeline::Cursor kick{cycle, 0};
+      const PatternTimeline::Cursor snare{cycle, 1};
+      expectEquals(timeline->getStart(kick), origin);
+      expectEquals(timeline->getEnd(kick), origin + kStep / 2);
+      expectEquals(timeline->getStart(snare), origin + 2 * kStep);
+      expectEquals(timeline->getEnd(snare), origin + 4 * kStep);
+    }
+
+    expect(timeline->getNext({0, 0}) == PatternTimeline::Cursor{0, 1});
+    expect(timeline->getNext({0, 1}) == PatternTimeline::Cursor{1, 0});
+    expect(timeline->findFirst(0) == PatternTimeline::Cursor{0, 0});
+    expect(timeline->findFirst(24000) == PatternTimeline::Cursor{0, 0});
+    expect(timeline->findFirst(24001) == PatternTimeline::Cursor{0, 1});
+    expect(timeline->findFirst(24000 + 2 * kStep + 1) == PatternTimeline::Cursor{1, 0});
+    expect(timeline->findFirst(1000000) == PatternTimeline::Cursor{54, 1});
+
+    // Zero-length notes still last one sample
+    const auto shortest =
+        PatternTimeline::compile(makePattern({makeStep(60, 0.0)}), map);
+    expectEquals(shortest->getEnd({}) - shortest->getStart({}), (juce::int64)1);
+  }
+
+  void testSwing() {
+    const TempoMap map(120.0, kSampleRate);
+    auto pattern = makePattern({makeStep(60), makeStep(61), makeStep(62, 1.0, 0.5),
+                                makeStep(63, 1.0, 0.5)});
+    pattern.swing = 0.5;
+    const auto timeline = PatternTimeline::compile(pattern, map);
+
+    // Odd steps take the pattern swing, added to their own and clamped
+    const std::vector<juce::int64> starts{0, kStep + kStep / 2, 2 * kStep + kStep / 2,
+                                          3 * kStep + kStep * 3 / 4};
+    expectEquals((int)timeline->notes.size(), 4);
+    for (size_t i = 0; i < starts.size(); ++i) {
+      expectEquals(timeline->getStart({0, i}), starts[i]);
+    }
+
+    // Swing stays under a step: notes come out in order, even across cycles
+    bool ordered = true;
+    PatternTimeline::Cursor cursor;
+    for (int i = 1; i < 32; ++i) {
+      const auto next = timeline->getNext(cursor);
+      ordered = ordered && timeline->getStart(cursor) < timeline->getStart(next);
+      cursor = next;
+    }
+    expect(ordered, "Notes are ordered by start");
+  }
+
+  void testExactSamples() {
+    RecordingTrack track;
+    Renderer renderer;
+    expect(track.setPattern(makePattern({makeStep(60, 0.5), makeStep(64, 1.5)}),
+                            renderer.map));
+
+    // One sample per block: every call is stamped with its exact sample
+    renderer.render(track, nullptr, 5 * (int)kStep, 1);
+    const std::vector<RecordingTrack::Call> expected{
+        {0, 60, true},
+        {kStep / 2, 60, false},
+        {kStep, 64, true},
+        {2 * kStep, 60, true},
+        {2 * kStep + kStep / 2, 60, false},
+        {2 * kStep + kStep / 2, 64, false},
+        {3 * kStep, 64, true},
+        {4 * kStep, 60, true},
+        {4 * kStep + kStep / 2, 60, false},
+        {4 * kStep + kStep / 2, 64, false}};
+    expectEquals((int)track.calls.size(), (int)expected.size());
+    for (size_t i = 0; i < std::min(expected.size(), track.calls.size()); ++i) {
+      expectEquals(track.calls[i].sample, expected[i].sample);
+      expectEquals(track.calls[i].note, expected[i].note);
+      expect(track.calls[i].on == expected[i].on);
+    }
+  }
+
+  void testBlockSplit() {
+    PatternTrack track(8, WaveTable::WaveType::SQUARE);
+    track.setADSRParameters(getShortEnvelope());
+    Renderer renderer;
+    auto pattern = makePattern({makeRest(), makeStep(60), makeRest(), makeRest()});
+    pattern.stepBeats = 1.0 / 24.0;  // 1000 samples
+    expect(track.setPattern(pattern, renderer.map));
+
+    std::vector<float> output(4096);
+    renderer.render(track, output.data(), (int)output.size(), 4096);
+
+    bool silentBefore = true;
+    for (int i = 0; i <= 1000; ++i) {
+      silentBefore = silentBefore && output[(size_t)i] == 0.0f;
+    }
+    bool startsOnTime = false;
+    for (int i = 1001; i < 1008; ++i) {
+      startsOnTime = startsOnTime || output[(size_t)i] != 0.0f;
+    }
+    expect(silentBefore, "Nothing plays before the step");
+    expect(startsOnTime, "The note starts on its sample inside the block");
+    expectEquals(track.getActiveVoiceCount(), 0);
+  }
+
+  void testSwap() {
+    RecordingTrack track;
+    Renderer renderer;
+    expect(track.setPattern(makePattern({makeStep(60, 4.0)}), renderer.map));
+    renderer.render(track, nullptr, (int)kStep, 64);
+
+    // The new pattern starts at its next note; note 60 still ends on its sample
+    auto next = makePattern({makeRest(), makeStep(72, 0.5)});
+    expect(track.setPattern(next, renderer.map));
+    expectEquals(track.getPattern().steps[1].note, 72);
+    expectEquals(track.getTimeline()->notes.front().note, 72);
+    renderer.render(track, nullptr, 4 * (int)kStep, 1);
+
+    const std::vector<RecordingTrack::Call> expected{
+        {0, 60, true}, {kStep, 72, true}, {kStep + kStep / 2, 72, false},
+        {3 * kStep, 72, true}, {3 * kStep + kStep / 2, 72, false},
+        {4 * kStep, 60, false}};
+    expectEquals((int)track.calls.size(), (int)expected.size());
+    for (size_t i = 0; i < std::min(expected.size(), track.calls.size()); ++i) {
+      expectEquals(track.calls[i].sample, expected[i].sample);
+      expectEquals(track.calls[i].note, expected[i].note);
+      expect(track.calls[i].on == expected[i].on);
+    }
+
+    // Edits the audio thread has not taken yet are bounded
+    int accepted = 0;
+    while (accepted < 100 && track.setPattern(next, renderer.map)) {
+      ++accepted;
+    }
+    expectEquals(accepted, PatternTrack::kMaxPendingTimelines);
+    renderer.render(track, nullptr, 64);
+    expect(track.setPattern(next, renderer.map), "Swapped timelines are collected");
+  }
+
+  void testSeek() {
+    RecordingTrack track;
+    Renderer renderer;
+    expect(track.setPattern(makePattern({makeStep(60, 2.0), makeRest()}),
+                            renderer.map));
+    renderer.render(track, nullptr, (int)kStep);
+    expectEquals((int)track.calls.size(), 1);
+
+    // Back to the middle of the note: it is released, not restarted
+    renderer.transport.setPosition(kStep / 2);
+    renderer.render(track, nullptr, 64);
+    expectEquals((int)track.calls.size(), 2);
+    expect(!track.calls.back().on);
+    expectEquals(track.calls.back().sample, kStep / 2);
+
+    // The next cycle plays from its own sample
+    renderer.transport.setPosition(2 * kStep - 10);
+    renderer.render(track, nullptr, 64);
+    expectEquals((int)track.calls.size(), 3);
+    expect(track.calls.back().on);
+  }
+
+  void testTempoChange() {
+    MixEngine engine(0);
+    auto track = std::make_shared<PatternTrack>(8);
+    engine.addTrack(track);
+    engine.prepare(512, kSampleRate);
+    expect(track->setPattern(makePattern({makeRest(), makeStep(60)}),
+                             *engine.getTempoMap()));
+    expectEquals(track->getTimeline()->getStart({}), kStep);
+
+    TempoMap faster(240.0, kSampleRate);
+    engine.setTempoMap(faster);
+    const auto timeline = track->getTimeline();
+    expectEquals(timeline->tempoMapId, engine.getTempoMap()->getId());
+    expectEquals(timeline->getStart({}), kStep / 2);
+
+    // Tracks added later follow the session map too
+    auto added = std::make_shared<PatternTrack>(8);
+    expect(added->setPattern(makePattern({makeRest(), makeStep(60)}),
+                             TempoMap(120.0, kSampleRate)));
+    engine.addTrack(added);
+    expectEquals(added->getTimeline()->getStart({}), kStep / 2);
+  }
+
+  void testClone() {
+    PatternTrack track(16, WaveTable::WaveType::TRIANGLE);
+    Renderer renderer;
+    expect(track.setPattern(makePattern({makeStep(48, 4.0)}), renderer.map));
+    renderer.render(track, nullptr, 256);
+    expectEquals(track.getActiveVoiceCount(), 1);
+
+    const auto copy = track.clone();
+    auto* pattern = dynamic_cast<PatternTrack*>(copy.get());
+    expect(pattern != nullptr);
+    if (pattern != nullptr) {
+      expectEquals(pattern->getActiveVoiceCount(), 0);
+      expectEquals(pattern->getMaxVoices(), 16);
+      expect(pattern->getTimeline() == track.getTimeline(), "Timelines are shared");
+      expectEquals(pattern->getPattern().steps[0].note, 48);
+
+      // The copy plays the pattern on its own from the start
+      Renderer other;
+      other.render(*pattern, nullptr, 64);
+      expectEquals(pattern->getActiveVoiceCount(), 1);
+    }
+  }
+
+  void testRealtime() {
+    PatternTrack track(PatternTrack::kDefaultVoices);
+    track.setADSRParameters(getShortEnvelope());
+    Renderer renderer;
+
+    std::vector<PatternStep> steps;
+    for (int i = 0; i < 16; ++i) {
+      steps.push_back(i % 4 == 3 ? makeRest() : makeStep(36 + i * 3, 0.5 + i % 3));
+    }
+    auto pattern = makePattern(steps);
+    pattern.stepBeats = 1.0 / 96.0;  // 250 samples
+    pattern.swing = 0.3;
+    expect(track.setPattern(pattern, renderer.map));
+    pattern.steps[0].note = 90;
+    expect(track.setPattern(pattern, renderer.map));
+
+    std::vector<float> output(512);
+    const auto before = RealtimeGuard::getViolationCount();
+    {
+      const RealtimeGuard::Scope realtime;
+      for (int block = 0; block < 400; ++block) {
+        renderer.render(track, output.data(), 97, 97);
+        if (block == 200) {
+          renderer.transport.setPosition(1000);
+        }
+      }
+    }
+    expectEquals((int)(RealtimeGuard::getViolationCount() - before), 0);
+  }
+};
+
+static PatternTrackTests patternTrackTests;
@@ -0,0 +1,285 @@
+#include <juce_core/juce_core.h>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../include/engine-profiler.hpp"
+#include "../include/mix-engine.hpp"
+
+/**
+ * Unit tests for Histogram and EngineProfiler
+ * Tests bucket boundaries, quantiles and intervals, deadline accounting,
+ * the Prometheus text output, JSON summaries, and the detailed timing
+ * recorded by the MixEngine
+ */
+class ProfilerTests : public juce::UnitTest {
+ public:
+  ProfilerTests() : juce::UnitTest("Profiler Tests") {}
+
+  void runTest() override {
+    beginTest("Histogram buckets");
+    testBuckets();
+
+    beginTest("Quantiles and intervals");
+    testQuantiles();
+
+    beginTest("Deadlines and load");
+    testDeadlines();
+
+    beginTest("Prometheus text format");
+    testPrometheus();
+
+    beginTest("JSON summaries cover their interval");
+    testDescribe();
+
+    beginTest("MixEngine detailed timing");
+    testEngineTiming();
+  }
+
+ private:
+  static constexpr double kSampleRate = 48000.0;
+
+  // Outputs 1 on every sample: mixed at its volume
+  class ConstantTrack : public AudioTrack {
+   public:
+    float getSampleValue(const BeatContext&) override {
+      return 1.0f;
+    }
+
+    RenderActivity renderBlock(juce::AudioBuffer<float>& buffer, int startSample,
+                               int numSamples, const BeatContext&) override {
+      juce::FloatVectorOperations::fill(buffer.getWritePointer(0, startSample),
+                                        1.0f, numSamples);
+      return RenderActivity::whole(numSamples);
+    }
+
+    std::unique_ptr<AudioTrack> clone() const override {
+      return std::make_unique<ConstantTrack>(*this);
+    }
+  };
+
+  static juce::int64 toTicks(double seconds) {
+    return (juce::int64)(seconds * (double)juce::Time::getHighResolutionTicksPerSecond());
+  }
+
+  void testBuckets() {
+    using Scale = Histogram::Scale;
+    expectEquals(Histogram::getBound(Scale::Seconds, 0), 1.0e-6);
+    expectEquals(Histogram::getBound(Scale::Load, Histogram::getNumBounds(Scale::Load) - 1),
+                 2.0);
+    expect(Histogram::getNumBounds(Scale::Seconds) < Histogram::kMaxBuckets);
+
+    Histogram histogram(Scale::Seconds);
+    histogram.record(0.5e-6);
+    histogram.record(1.0e-6);  // Bounds are inclusive
+    histogram.record(3.0e-6);
+    histogram.record(1.0);     // Above every bound
+
+    const auto snapshot = histogram.getSnapshot();
+    expectEquals((int)snapshot.counts[0], 2);
+    expectEquals((int)snapshot.counts[1], 0);
+    expectEquals((int)snapshot.counts[2], 1);
+    expectEquals((int)snapshot.counts[(size_t)Histogram::getNumBounds(Scale::Seconds)], 1);
+    expectEquals((int)snapshot.getCount(), 4);
+    expectWithinAbsoluteError(snapshot.sum, 1.0000045, 1.0e-12);
+    expectEquals(snapshot.max, 1.0);
+
+    // A cloned track starts with the counts of the original
+    const Histogram copy(histogram);
+    expectEquals((int)copy.getSnapshot().getCount(), 4);
+
+    histogram.reset();
+    expectEquals((int)histogram.getSnapshot().getCount(), 0);
+    expectEquals(histogram.getSnapshot().max, 0.0);
+  }
+
+  void testQuantiles() {
+    using Scale = Histogram::Scale;
+    Histogram histogram(Scale::Seconds);
+    expectEquals(histogram.getSnapshot().getQuantile(Scale::Seconds, 0.5), 0.0);
+
+    for (int i = 0; i < 99; ++i) {
+      histogram.record(8.0e-6);
+    }
+    histogram.record(0.02);
+
+    const auto snapshot = histogram.getSnapshot();
+    expectEquals(snapshot.getQuantile(Scale::Seconds, 0.5), 1.0e-5);
+    expectEquals(snapshot.getQuantile(Scale::Seconds, 0.99), 1.0e-5);
+    expectEquals(snapshot.getQuantile(Scale::Seconds, 1.0), 2.5e-2);
+
+    // Overflow bucket: the largest value seen
+    histogram.record(3.0);
+    expectEquals(histogram.getSnapshot().getQuantile(Scale::Seconds, 1.0), 3.0);
+
+    // Interval since the first snapshot: only the overflow value
+    const auto interval = histogram.getSnapshot().since(snapshot);
+    expectEquals((int)interval.getCount(), 1);
+    expectWithinAbsoluteError(interval.getMean(), 3.0, 1.0e-9);
+
+    // Another histogram (e.g. a new track at the same index): no subtraction
+    Histogram other(Scale::Seconds);
+    other.record(1.0e-3);
+    expectEquals((int)other.getSnapshot().since(snapshot).getCount(), 1);
+  }
+
+  void testDeadlines() {
+    EngineProfiler profiler;
+    profiler.prepare(kSampleRate);
+
+    // 480 samples: a 10 ms deadline
+    profiler.recordCallback(toTicks(0.005), 480);
+    profiler.recordCallback(toTicks(0.015), 480);
+    profiler.recordCallback(toTicks(0.001), 480);
+
+    ProfileSnapshot snapshot;
+    profiler.capture({}, snapshot);
+    expectEquals((int)snapshot.callback.getCount(), 3);
+    expectEquals((int)snapshot.missedDeadlines, 1);
+    expectWithinAbsoluteError(snapshot.load.max, 1.5, 1.0e-3);
+    expectEquals(snapshot.load.getQuantile(Histogram::Scale::Load, 0.5), 0.5);
+    expect(!snapshot.detailed);
+
+    // Detailed timing needs profiling enabled
+    profiler.setDetailed(true);
+    expect(profiler.isDetailed());
+    profiler.setEnabled(false);
+    expect(!profiler.isDetailed());
+  }
+
+  void testPrometheus() {
+    EngineProfiler profiler;
+    profiler.prepare(kSampleRate);
+    profiler.recordCallback(toTicks(0.002), 480);
+    profiler.recordCallback(toTicks(0.020), 480);
+
+    Histogram track(Histogram::Scale::Seconds);
+    track.record(2.0e-5);
+
+    ProfileSnapshot snapshot;
+    profiler.capture({&track}, snapshot);
+    snapshot.deviceXRuns = 7;
+    std::string text;
+    EngineProfiler::writePrometheus(snapshot, text);
+
+    auto contains = [&text](const std::string& line) {
+      return text.find(line + "\n") != std::string::npos;
+    };
+    expect(contains("# TYPE daw_callback_duration_seconds histogram"));
+    expect(contains("daw_callback_duration_seconds_bucket{le=\"0.0025\"} 1"));
+    expect(contains("daw_callback_duration_seconds_bucket{le=\"0.1\"} 2"));
+    expect(contains("daw_callback_duration_seconds_bucket{le=\"+Inf\"} 2"));
+    expect(contains("daw_callback_duration_seconds_count 2"));
+    expect(contains("daw_missed_deadlines_total 1"));
+    expect(contains("daw_device_xruns_total 7"));
+    expect(contains("daw_dsp_load_bucket{le=\"2\"} 2"));
+    expect(contains("daw_track_render_duration_seconds_bucket{track=\"0\",le=\"2.5e-05\"} 1"));
+    expect(contains("daw_track_render_duration_seconds_count{track=\"0\"} 1"));
+
+    // Every line is a comment or "name[{labels}] value"
+    bool wellFormed = true;
+    std::istringstream lines(text);
+    for (std::string line; std::getline(lines, line);) {
+      if (line.rfind("# ", 0) == 0) {
+        continue;
+      }
+      const auto space = line.rfind(' ');
+      wellFormed = wellFormed && line.rfind("daw_", 0) == 0 &&
+                   space != std::string::npos && space + 1 < line.size();
+    }
+    expect(wellFormed);
+
+    // Unknown device xruns are left out
+    snapshot.deviceXRuns = -1;
+    text.clear();
+    EngineProfiler::writePrometheus(snapshot, text);
+    expect(text.find("daw_device_xruns_total") == std::string::npos);
+  }
+
+  void testDescribe() {
+    EngineProfiler profiler;
+    profiler.prepare(kSampleRate);
+    profiler.setDetailed(true);
+    Histogram track(Histogram::Scale::Seconds);
+
+    ProfileSnapshot previous;
+    profiler.recordCallback(toTicks(0.004), 480);
+    track.record(1.0e-5);
+    profiler.capture({&track}, previous);
+
+    profiler.recordCallback(toTicks(0.012), 480);
+    profiler.recordCallback(toTicks(0.004), 480);
+    profiler.recordPhases(toTicks(0.003), toTicks(0.001));
+    track.record(1.0e-5);
+    track.record(1.0e-5);
+
+    ProfileSnapshot current;
+    profiler.capture({&track}, current);
+    const auto summary = EngineProfiler::describe(current, previous);
+    expectEquals((int)summary["callbacks"], 2);
+    expectEquals((int)summary["missedDeadlines"], 1);
+    expectEquals((int)summary["totalMissedDeadlines"], 1);
+    expectWithinAbsoluteError((double)summary["callback"]["peak"], 0.012, 1.0e-4);
+    expect((bool)summary["detailed"]);
+    expectWithinAbsoluteError((double)summary["render"]["mean"], 0.003, 1.0e-4);
+
+    const auto* tracks = summary["tracks"].getArray();
+    expect(tracks != nullptr && tracks->size() == 1);
+    if (tracks != nullptr && tracks->size() == 1) {
+      expectWithinAbsoluteError((double)tracks->getReference(0)["mean"], 1.0e-5,
+                                1.0e-9);
+    }
+  }
+
+  void testEngineTiming() {
+    constexpr int blockSize = 256;
+    constexpr int numBlocks = 5;
+
+    for (const int threads : {0, 2}) {
+      EngineProfiler profiler;
+      MixEngine engine(threads);
+      engine.setParallelTrackThreshold(2);
+      engine.setProfiler(&profiler);
+
+      std::vector<std::shared_ptr<ConstantTrack>> tracks;
+      for (int i = 0; i < 4; ++i) {
+        tracks.push_back(std::make_shared<ConstantTrack>());
+        engine.addTrack(tracks.back());
+      }
+      engine.prepare(blockSize, kSampleRate);
+      juce::AudioBuffer<float> output(2, blockSize);
+
+      // Off by default: nothing timed
+      engine.process(output, 0, blockSize);
+      expectEquals((int)tracks[0]->renderTime.getSnapshot().getCount(), 0);
+
+      profiler.setDetailed(true);
+      for (int block = 0; block < numBlocks; ++block) {
+        engine.process(output, 0, blockSize);
+      }
+
+      ProfileSnapshot snapshot;
+      std::vector<const Histogram*> histograms;
+      for (const auto& track : tracks) {
+        histograms.push_back(&track->renderTime);
+      }
+      profiler.capture(histograms, snapshot);
+
+      // One renderBlock() per track and block, one render and mix phase per block
+      bool everyTrack = true;
+      for (const auto& track : snapshot.tracks) {
+        everyTrack = everyTrack && track.getCount() == (juce::uint64)numBlocks;
+      }
+      expect(everyTrack, "Every track timed on every block");
+      expectEquals((int)snapshot.render.getCount(), numBlocks);
+      expectEquals((int)snapshot.mix.getCount(), numBlocks);
+      expect(snapshot.render.sum > 0.0 && snapshot.mix.sum >= 0.0);
+
+      // Disabled again: counts stay
+      profiler.setDetailed(false);
+      engine.process(output, 0, blockSize);
+      expectEquals((int)tracks[3]->renderTime.getSnapshot().getCount(), numBlocks);
+    }
+  }
+};
+
+static ProfilerTests profilerTests;
@@ -0,0 +1,298 @@
+#include <juce_core/juce_core.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../include/analysis-tap.hpp"
+#include "../include/audio-context.hpp"
+#include "../include/beat-track.hpp"
+#include "../include/mix-engine.hpp"
+#include "../include/realtime-guard.hpp"
+#include "../include/render-worker-pool.hpp"
+#include "../include/transport.hpp"
+
+/**
+ * Unit tests for RealtimeGuard
+ * Tests scope nesting, detection of allocations, locks and sleeps, worker
+ * threads inheriting the real-time state, and that BeatTrack and the
+ * MixEngine (serial and parallel, with commands, meters, analysis taps and
+ * profiling, while the control thread edits the session) never allocate,
+ * lock or block on the audio thread
+ *
+ * Detection needs -DENABLE_REALTIME_GUARD=ON; the render paths are still
+ * exercised without it.
+ */
+class RealtimeGuardTests : public juce::UnitTest {
+ public:
+  RealtimeGuardTests() : juce::UnitTest("RealtimeGuard Tests") {}
+
+  void runTest() override {
+    beginTest("Scopes");
+    testScopes();
+
+    beginTest("Violations are detected");
+    testDetection();
+
+    beginTest("Workers inherit the real-time state");
+    testWorkers();
+
+    beginTest("BeatTrack renders without violations");
+    testBeatTrack();
+
+    beginTest("MixEngine processes without violations");
+    testMixEngine(0);
+    testMixEngine(2);
+  }
+
+ private:
+  static constexpr double kSampleRate = 48000.0;
+
+  // Counts violations instead of reporting them, for provoked violations
+  class ScopedCountMode {
+   public:
+    ScopedCountMode() : previous(RealtimeGuard::getMode()) {
+      RealtimeGuard::setMode(RealtimeGuard::Mode::Count);
+    }
+    ~ScopedCountMode() { RealtimeGuard::setMode(previous); }
+
+   private:
+    RealtimeGuard::Mode previous;
+  };
+
+  void testScopes() {
+    expect(!RealtimeGuard::isRealtimeThread());
+    {
+      const RealtimeGuard::Scope outer;
+      expectEquals(RealtimeGuard::isRealtimeThread(), RealtimeGuard::kEnabled);
+      {
+        const RealtimeGuard::Scope inner;
+        const RealtimeGuard::AllowScope allowed;
+        expect(!RealtimeGuard::isRealtimeThread(), "Allowed inside a scope");
+      }
+      expectEquals(RealtimeGuard::isRealtimeThread(), RealtimeGuard::kEnabled);
+    }
+    expect(!RealtimeGuard::isRealtimeThread());
+
+    const RealtimeGuard::Scope inactive(false);
+    expect(!RealtimeGuard::isRealtimeThread(), "Inactive scope");
+  }
+
+  void testDetection() {
+    if (!RealtimeGuard::kEnabled) {
+      logMessage("Realtime guard not built in (ENABLE_REALTIME_GUARD=OFF)");
+      return;
+    }
+
+    const ScopedCountMode counting;
+    std::mutex mutex;
+
+    // Outside a scope nothing is a violation
+    const auto before = RealtimeGuard::getViolationCount();
+    {
+      void* memory = ::operator new(64);
+      ::operator delete(memory);
+      const std::lock_guard<std::mutex> lock(mutex);
+    }
+    expectEquals((int)(RealtimeGuard::getViolationCount() - before), 0);
+
+    // Counted inside the scope, checked outside: expect() allocates
+    int allocations = 0, containers = 0, allowed = 0;
+    int mallocs = 1, locks = 1, sleeps = 1;
+    {
+      const RealtimeGuard::Scope realtime;
+
+      auto start = RealtimeGuard::getViolationCount();
+      void* memory = ::operator new(64);
+      ::operator delete(memory);
+      allocations = (int)(RealtimeGuard::getViolationCount() - start);
+
+      start = RealtimeGuard::getViolationCount();
+      {
+        std::vector<float> buffer(256);
+        buffer[0] = 1.0f;
+      }
+      containers = (int)(RealtimeGuard::getViolationCount() - start);
+
+#if defined(__linux__) && defined(__GLIBC__)
+      start = RealtimeGuard::getViolationCount();
+      void* volatile block = std::malloc(32);
+      std::free(block);
+      mallocs = (int)(RealtimeGuard::getViolationCount() - start);
+
+      start = RealtimeGuard::getViolationCount();
+      mutex.lock();
+      mutex.unlock();
+      locks = (int)(RealtimeGuard::getViolationCount() - start);
+
+      start = RealtimeGuard::getViolationCount();
+      std::this_thread::sleep_for(std::chrono::microseconds(1));
+      sleeps = (int)(RealtimeGuard::getViolationCount() - start);
+#endif
+
+      // Deliberately allowed
+      start = RealtimeGuard::getViolationCount();
+      {
+        const RealtimeGuard::AllowScope allowing;
+        void* allowedMemory = ::operator new(64);
+        ::operator delete(allowedMemory);
+      }
+      allowed = (int)(RealtimeGuard::getViolationCount() - start);
+    }
+
+    expectEquals(allocations, 2, "operator new and delete");
+    expectEquals(containers, 2, "Container allocation");
+    expectEquals(mallocs, 2, "malloc and free");
+    expectEquals(locks, 1, "Mutex lock");
+    expect(sleeps >= 1, "Sleep");
+    expectEquals(allowed, 0, "AllowScope");
+  }
+
+  void testWorkers() {
+    constexpr int numTasks = 64;
+    RenderWorkerPool pool(2);
+
+    struct Batch {
+      std::array<std::atomic<int>, numTasks> realtime{};
+    } batch;
+
+    auto task = [](void* context, int index) {
+      auto& current = *static_cast<Batch*>(context);
+      current.realtime[(size_t)index].store(RealtimeGuard::isRealtimeThread() ? 1 : 0);
+    };
+
+    // Every task sees the state of the thread which started the batch
+    for (const bool realtime : {true, false}) {
+      const RealtimeGuard::Scope scope(realtime);
+      pool.run(numTasks, task, &batch);
+
+      int count = 0;
+      for (const auto& value : batch.realtime) {
+        count += value.load();
+      }
+      expectEquals(count, realtime && RealtimeGuard::kEnabled ? numTasks : 0);
+    }
+  }
+
+  void testBeatTrack() {
+    AudioContext::getInstance().sampleRate = kSampleRate;
+    BeatTrack track(440.0f);
+    TempoMap map(128.0, kSampleRate);
+    map.setTempo(16.0, 90.0, true);
+    map.setTempo(32.0, 140.0);
+
+    juce::AudioBuffer<float> buffer(1, 2048);
+    Transport transport;
+    const auto before = RealtimeGuard::getViolationCount();
+    {
+      const RealtimeGuard::Scope realtime;
+
+      // Several block sizes across notes, the ramp and tempo changes
+      for (int block = 0; block < 400; ++block) {
+        int numSamples = 32 << (block % 7);
+        const BeatContext context = transport.getContext(map, numSamples);
+        track.renderBlock(buffer, 0, numSamples, context);
+        transport.advance(numSamples);
+      }
+
+      track.setVolume(0.25f);
+      track.setMute(true);
+      int numSamples = 512;
+      track.renderBlock(buffer, 0, numSamples, transport.getContext(map, numSamples));
+    }
+    expectEquals((int)(RealtimeGuard::getViolationCount() - before), 0);
+  }
+
+  void testMixEngine(int numThreads) {
+    constexpr int blockSize = 512;
+    constexpr int numBlocks = 600;
+
+    AudioContext::getInstance().sampleRate = kSampleRate;
+    MixEngine engine(numThreads);
+    engine.setParallelTrackThreshold(2);
+
+    AnalysisTap tap;
+    tap.setMasterActive(true);
+    engine.setAnalysisTap(&tap);
+
+    EngineProfiler profiler;
+    profiler.setDetailed(true);
+    engine.setProfiler(&profiler);
+
+    std::vector<std::shared_ptr<AudioTrack>> tracks;
+    for (int i = 0; i < 8; ++i) {
+      tracks.push_back(std::make_shared<BeatTrack>(220.0f * (float)(i + 1)));
+      engine.addTrack(tracks.back());
+    }
+    tap.setTrackSource(1, tracks[3].get());
+
+    TempoMap map(120.0);
+    map.setTempo(8.0, 150.0, true);
+    engine.setTempoMap(map);
+    engine.prepare(blockSize, kSampleRate);
+    profiler.prepare(kSampleRate);
+
+    // Control thread: track edits, tempo changes and reclamation while the
+    // "audio thread" renders
+    std::atomic<bool> done{false};
+    std::thread control([&]() {
+      for (int edit = 1; !done.load(); ++edit) {
+        const auto index = engine.addTrack(std::make_shared<BeatTrack>(330.0f));
+        engine.removeTrack(index);
+        if (edit % 4 == 0) {
+          map.setTempo(4.0, 100.0 + (double)(edit % 50));
+          engine.setTempoMap(map);
+        }
+        engine.collectGarbage();
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+      }
+    });
+
+    juce::AudioBuffer<float> output(2, blockSize);
+    std::vector<float> samples(4096);
+    juce::Random random(42);
+    const auto before = RealtimeGuard::getViolationCount();
+
+    for (int block = 0; block < numBlocks; ++block) {
+      // Commands due inside the next block split it
+      EngineCommand command;
+      command.id = (juce::uint32)block;
+      command.type = random.nextBool() ? EngineCommand::Type::SetTrackVolume
+                                       : EngineCommand::Type::SetTrackMute;
+      command.track = tracks[(size_t)random.nextInt((int)tracks.size())];
+      command.value = random.nextFloat();
+      command.sample = engine.getPosition() + random.nextInt(blockSize);
+      engine.sendCommand(std::move(command));
+
+      if (block % 100 == 50 || block % 100 == 51) {
+        EngineCommand transport;
+        transport.type = block % 100 == 50 ? EngineCommand::Type::Stop
+                                           : EngineCommand::Type::Play;
+        engine.sendCommand(std::move(transport));
+      }
+
+      {
+        const RealtimeGuard::Scope realtime;
+        engine.process(output, 0, blockSize);
+        tap.pushMaster(output, 0, blockSize);
+      }
+
+      // Reader side of acknowledgements, meters and taps
+      engine.collectCommandReplies([](const EngineCommand&) {});
+      engine.readMeters();
+      tap.read(AnalysisTap::kMasterSource, samples.data(), 4096);
+      tap.read(1, samples.data(), 4096);
+    }
+
+    done.store(true);
+    control.join();
+    engine.collectGarbage();
+
+    expectEquals((int)(RealtimeGuard::getViolationCount() - before), 0,
+                 juce::String(numThreads) + " render threads");
+  }
+};
+
+static RealtimeGuardTests realtimeGuardTests;
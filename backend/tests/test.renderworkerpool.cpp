@@ -0,0 +1,151 @@
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <vector>
+#include "../include/beat-track.hpp"
+#include "../include/render-worker-pool.hpp"
+
+/**
+ * Unit tests for the RenderWorkerPool class
+ * Tests task distribution, work stealing, capacity overflow, and that a
+ * parallel render mixed in track order matches the serial render exactly
+ */
+class RenderWorkerPoolTests : public juce::UnitTest {
+ public:
+  RenderWorkerPoolTests() : juce::UnitTest("RenderWorkerPool Tests") {}
+
+  void runTest() override {
+    beginTest("Work-stealing deque pop and steal");
+    testDeque();
+
+    beginTest("Every task runs exactly once");
+    testEveryTaskRunsOnce();
+
+    beginTest("Tasks beyond capacity run on the calling thread");
+    testCapacityOverflow();
+
+    beginTest("Pool without workers runs serially");
+    testNoWorkers();
+
+    beginTest("Parallel render matches serial render");
+    testParallelMatchesSerial();
+  }
+
+ private:
+  struct Counters {
+    std::vector<std::atomic<int>> runs;
+    explicit Counters(int numTasks) : runs((size_t)numTasks) {}
+  };
+
+  static void countTask(void* context, int taskIndex) {
+    static_cast<Counters*>(context)->runs[(size_t)taskIndex].fetch_add(1);
+  }
+
+  void expectEachTaskRanOnce(RenderWorkerPool& pool, int numTasks) {
+    Counters counters(numTasks);
+    pool.run(numTasks, &countTask, &counters);
+
+    bool allOnce = true;
+    for (const auto& count : counters.runs) {
+      allOnce = allOnce && count.load() == 1;
+    }
+    expect(allOnce, "Each of " + juce::String(numTasks) +
+                        " tasks should run exactly once");
+  }
+
+  void testDeque() {
+    WorkStealingDeque deque(4);
+    expect(deque.push(1) && deque.push(2) && deque.push(3) && deque.push(4));
+    expect(!deque.push(5), "Full deque should reject tasks");
+
+    expectEquals(deque.pop(), 4);
+    expectEquals(deque.steal(), 1);
+    expectEquals(deque.pop(), 3);
+    expectEquals(deque.pop(), 2);
+    expectEquals(deque.pop(), -1);
+    expectEquals(deque.steal(), -1);
+
+    deque.reset();
+    expect(deque.push(7));
+    expectEquals(deque.steal(), 7);
+  }
+
+  void testEveryTaskRunsOnce() {
+    RenderWorkerPool pool(3);
+    for (int iteration = 0; iteration < 500; ++iteration) {
+      expectEachTaskRanOnce(pool, 1 + iteration % 97);
+    }
+  }
+
+  void testCapacityOverflow() {
+    RenderWorkerPool pool(2, 16);
+    expectEachTaskRanOnce(pool, 100);
+  }
+
+  void testNoWorkers() {
+    RenderWorkerPool pool(0);
+    expectEquals(pool.getNumWorkers(), 0);
+    expectEachTaskRanOnce(pool, 10);
+  }
+
+  struct RenderJob {
+    std::vector<std::unique_ptr<BeatTrack>>* tracks;
+    std::vector<juce::AudioBuffer<float>>* buffers;
+    int numSamples;
+    BeatContext context;
+  };
+
+  static void renderTask(void* context, int trackIndex) {
+    auto& job = *static_cast<RenderJob*>(context);
+    (*job.tracks)[(size_t)trackIndex]->renderBlock(
+        (*job.buffers)[(size_t)trackIndex], 0, job.numSamples, job.context);
+  }
+
+  void testParallelMatchesSerial() {
+    const TempoMap tempoMap(120.0, 44100.0);
+
+    constexpr int numTracks = 64;
+    constexpr int blockSize = 256;
+
+    // Tracks keep render state between blocks: each path gets its own
+    std::vector<std::unique_ptr<BeatTrack>> tracks;
+    std::vector<std::unique_ptr<BeatTrack>> serialTracks;
+    std::vector<juce::AudioBuffer<float>> buffers;
+    for (int i = 0; i < numTracks; ++i) {
+      tracks.push_back(std::make_unique<BeatTrack>(100.0f + 10.0f * i));
+      serialTracks.push_back(std::make_unique<BeatTrack>(100.0f + 10.0f * i));
+      buffers.emplace_back(1, blockSize);
+    }
+
+    RenderWorkerPool pool(3);
+    juce::AudioBuffer<float> serialMix(1, blockSize);
+    juce::AudioBuffer<float> parallelMix(1, blockSize);
+    juce::AudioBuffer<float> trackBuffer(1, blockSize);
+    bool identical = true;
+
+    for (int block = 0; block < 200; ++block) {
+      const BeatContext context = tempoMap.getContext(block * blockSize);
+
+      serialMix.clear();
+      for (auto& track : serialTracks) {
+        track->renderBlock(trackBuffer, 0, blockSize, context);
+        serialMix.addFrom(0, 0, trackBuffer, 0, 0, blockSize);
+      }
+
+      RenderJob job{&tracks, &buffers, blockSize, context};
+      pool.run(numTracks, &renderTask, &job);
+      parallelMix.clear();
+      for (auto& buffer : buffers) {
+        parallelMix.addFrom(0, 0, buffer, 0, 0, blockSize);
+      }
+
+      for (int i = 0; i < blockSize; ++i) {
+        identical = identical &&
+                    serialMix.getSample(0, i) == parallelMix.getSample(0, i);
+      }
+    }
+
+    expect(identical, "Mix order is fixed, results must be bit-identical");
+  }
+};
+
+static RenderWorkerPoolTests renderWorkerPoolTests;
@@ -0,0 +1,393 @@
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/realtime-guard.hpp"
+#include "../include/sample-cache.hpp"
+#include "../include/sample-track.hpp"
+
+/**
+ * Unit tests for SampleCache, DecodedSample and SamplePlayhead
+ * Tests decoding, hits and misses, LRU eviction under the budget, samples
+ * in use surviving eviction and being freed by the cache, concurrent loads,
+ * Prometheus output, sample-exact and resampled playback, and sample tracks
+ * sharing decoded samples with their offline copies
+ */
+class SampleCacheTests : public juce::UnitTest {
+ public:
+  SampleCacheTests() : juce::UnitTest("SampleCache Tests") {}
+
+  void runTest() override {
+    beginTest("Decoding");
+    testDecode();
+
+    beginTest("Hits and misses");
+    testHits();
+
+    beginTest("LRU eviction under the budget");
+    testEviction();
+
+    beginTest("Samples in use are kept and freed by the cache");
+    testInUse();
+
+    beginTest("Concurrent loads");
+    testConcurrentLoads();
+
+    beginTest("Prometheus text format");
+    testPrometheus();
+
+    beginTest("Playhead");
+    testPlayhead();
+
+    beginTest("Resampled playback");
+    testResampling();
+
+    beginTest("SampleTrack");
+    testTrack();
+  }
+
+ private:
+  static constexpr double kSampleRate = 48000.0;
+
+  // In-memory file: a ramp, negated on the second channel
+  class RampReader : public juce::AudioFormatReader {
+   public:
+    RampReader(double rate, int channels, juce::int64 length)
+        : juce::AudioFormatReader(nullptr, "Ramp") {
+      sampleRate = rate;
+      numChannels = (unsigned int)channels;
+      lengthInSamples = length;
+      bitsPerSample = 32;
+      usesFloatingPointData = true;
+    }
+
+    static float getValue(int channel, juce::int64 frame) {
+      const auto value = (float)(frame % 40000) * 2.5e-5f;
+      return channel == 0 ? value : -value;
+    }
+
+    bool readSamples(int* const* destChannels, int numDestChannels,
+                     int startOffsetInDestBuffer, juce::int64 startSampleInFile,
+                     int numSamples) override {
+      for (int channel = 0; channel < numDestChannels; ++channel) {
+        if (destChannels[channel] == nullptr) {
+          continue;
+        }
+        auto* output =
+            reinterpret_cast<float*>(destChannels[channel]) + startOffsetInDestBuffer;
+        for (int i = 0; i < numSamples; ++i) {
+          output[i] = getValue(channel, startSampleInFile + i);
+        }
+      }
+      return true;
+    }
+  };
+
+  static SampleStream::ReaderFactory makeFactory(double rate, int channels,
+                                                 juce::int64 length,
+                                                 std::atomic<int>* opened = nullptr) {
+    return [=]() -> std::unique_ptr<juce::AudioFormatReader> {
+      if (opened != nullptr) {
+        ++*opened;
+      }
+      return std::make_unique<RampReader>(rate, channels, length);
+    };
+  }
+
+  // Memory of a mono sample of a given length
+  static size_t monoBytes(int length) {
+    return (size_t)(length + DecodedSample::kPaddingFrames) * sizeof(float);
+  }
+
+  void testDecode() {
+    RampReader reader(44100.0, 2, 1000);
+    const auto sample = DecodedSample::decode(&reader);
+    expect(sample != nullptr);
+    if (sample == nullptr) {
+      return;
+    }
+    expectEquals(sample->getNumChannels(), 2);
+    expectEquals(sample->getLength(), 1000);
+    expectEquals(sample->getSampleRate(), 44100.0);
+    expect(sample->getLength(88200.0) == 2000);
+    expect(sample->getSizeInBytes() == 2 * (1000 + DecodedSample::kPaddingFrames) * sizeof(float));
+
+    int errors = 0;
+    for (int i = 0; i < 1000; ++i) {
+      errors += sample->getReadPointer(0)[i] == RampReader::getValue(0, i) &&
+                        sample->getReadPointer(1)[i] == RampReader::getValue(1, i)
+                    ? 0
+                    : 1;
+    }
+    for (int i = 0; i < DecodedSample::kPaddingFrames; ++i) {
+      errors += sample->getReadPointer(1)[1000 + i] == 0.0f ? 0 : 1;
+    }
+    expectEquals(errors, 0);
+
+    expect(DecodedSample::decode(nullptr) == nullptr);
+  }
+
+  void testHits() {
+    SampleCache cache;
+    std::atomic<int> opened{0};
+
+    const auto first = cache.load("kick", makeFactory(kSampleRate, 1, 1000, &opened));
+    const auto second = cache.load("kick", makeFactory(kSampleRate, 1, 1000, &opened));
+    const auto other = cache.load("snare", makeFactory(kSampleRate, 1, 2000, &opened));
+    expect(first != nullptr && first == second, "Shared buffer");
+    expect(other != nullptr && other != first);
+    expectEquals(opened.load(), 2, "Decoded once per file");
+
+    expect(cache.load("missing", []() { return nullptr; }) == nullptr);
+    expect(cache.load("no factory", {}) == nullptr);
+
+    const auto statistics = cache.getStatistics();
+    expectEquals((int)statistics.hits, 1);
+    expectEquals((int)statistics.misses, 4);
+    expectEquals((int)statistics.failures, 2);
+    expectEquals(statistics.entries, 2);
+    expectEquals(statistics.entriesInUse, 2);
+    expect(statistics.bytes == monoBytes(1000) + monoBytes(2000));
+    expect(statistics.budgetBytes == SampleCache::kDefaultBudgetBytes);
+
+    // Failures are not cached
+    expect(cache.load("missing", makeFactory(kSampleRate, 1, 10)) != nullptr);
+  }
+
+  void testEviction() {
+    // Room for two samples
+    SampleCache cache(2 * monoBytes(1000) + 16);
+    expect(cache.getBudget() == 2 * monoBytes(1000) + 16);
+    std::weak_ptr<const DecodedSample> b;
+
+    cache.load("a", makeFactory(kSampleRate, 1, 1000));
+    b = cache.load("b", makeFactory(kSampleRate, 1, 1000));
+    cache.load("a", makeFactory(kSampleRate, 1, 1000));  // "a" used last
+    cache.load("c", makeFactory(kSampleRate, 1, 1000));
+
+    auto statistics = cache.getStatistics();
+    expectEquals((int)statistics.evictions, 1);
+    expectEquals(statistics.entries, 2);
+    expect(b.expired(), "Least recently used entry evicted");
+
+    cache.load("a", makeFactory(kSampleRate, 1, 1000));
+    expectEquals((int)cache.getStatistics().hits, 2, "Recently used entry kept");
+
+    // A smaller budget evicts at once, clear() empties the cache
+    cache.setBudget(monoBytes(1000));
+    expectEquals(cache.getStatistics().entries, 1);
+    cache.clear();
+    statistics = cache.getStatistics();
+    expectEquals(statistics.entries, 0);
+    expect(statistics.bytes == 0);
+    expectEquals((int)statistics.evictions, 3);
+  }
+
+  void testInUse() {
+    SampleCache cache(monoBytes(1000));
+
+    // Both over the budget while a track holds the first one
+    auto held = cache.load("held", makeFactory(kSampleRate, 1, 1000));
+    std::weak_ptr<const DecodedSample> watched = held;
+    cache.load("other", makeFactory(kSampleRate, 1, 1000));
+    expectEquals(cache.getStatistics().entries, 2, "Loaded entry returned to the caller");
+    cache.trim();
+    auto statistics = cache.getStatistics();
+    expectEquals(statistics.entries, 1, "Unused entry evicted, held one kept");
+    expectEquals(statistics.entriesInUse, 1);
+
+    cache.clear();
+    expectEquals(cache.getStatistics().entries, 1, "clear() keeps samples in use");
+
+    // The track lets go (e.g. on the audio thread): nothing is freed there...
+    held.reset();
+    expect(!watched.expired());
+    expectEquals(cache.getStatistics().entriesInUse, 0);
+
+    // ...but on the next trim, on the control thread
+    cache.setBudget(0);
+    expect(watched.expired());
+  }
+
+  void testConcurrentLoads() {
+    constexpr int numThreads = 8;
+    constexpr int numKeys = 16;
+    SampleCache cache;
+    std::vector<std::vector<std::shared_ptr<const DecodedSample>>> results(
+        (size_t)numThreads);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < numThreads; ++t) {
+      threads.emplace_back([&cache, &results, t]() {
+        for (int k = 0; k < numKeys; ++k) {
+          results[(size_t)t].push_back(cache.load(
+              "sample " + std::to_string(k), makeFactory(kSampleRate, 2, 5000 + k)));
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    // Every thread got the single stored copy of each sample
+    bool shared = true;
+    for (int k = 0; k < numKeys; ++k) {
+      for (int t = 1; t < numThreads; ++t) {
+        shared = shared && results[(size_t)t][(size_t)k] == results[0][(size_t)k];
+      }
+    }
+    expect(shared);
+
+    const auto statistics = cache.getStatistics();
+    expectEquals(statistics.entries, numKeys);
+    expectEquals((int)(statistics.hits + statistics.misses), numThreads * numKeys);
+  }
+
+  void testPrometheus() {
+    SampleCache cache;
+    const auto sample = cache.load("kick", makeFactory(kSampleRate, 1, 1000));
+    cache.load("kick", makeFactory(kSampleRate, 1, 1000));
+
+    std::string text;
+    SampleCache::writePrometheus(cache.getStatistics(), text);
+    auto contains = [&text](const std::string& line) {
+      return text.find(line + "\n") != std::string::npos;
+    };
+    expect(contains("# TYPE daw_sample_cache_hits_total counter"));
+    expect(contains("daw_sample_cache_hits_total 1"));
+    expect(contains("daw_sample_cache_misses_total 1"));
+    expect(contains("daw_sample_cache_entries 1"));
+    expect(contains("daw_sample_cache_bytes " + std::to_string(monoBytes(1000))));
+  }
+
+  void testPlayhead() {
+    constexpr int length = 3000;
+    RampReader monoReader(kSampleRate, 1, length), stereoReader(kSampleRate, 2, length);
+    const auto mono = DecodedSample::decode(&monoReader);
+    const auto stereo = DecodedSample::decode(&stereoReader);
+
+    constexpr int blockSize = 512;
+    std::vector<float> left(blockSize), right(blockSize);
+    float* destinations[] = {left.data(), right.data()};
+    SamplePlayhead playhead;
+
+    // Lead-in, body and end of a mono sample, in blocks
+    int errors = 0, delivered = 0;
+    const auto before = RealtimeGuard::getViolationCount();
+    for (juce::int64 frame = -700; frame < length + blockSize; frame += blockSize) {
+      {
+        const RealtimeGuard::Scope realtime;
+        delivered += playhead.read(*mono, frame, kSampleRate, destinations, 2, blockSize);
+      }
+      for (int i = 0; i < blockSize; ++i) {
+        const auto position = frame + i;
+        const float expected = position >= 0 && position < length
+                                   ? RampReader::getValue(0, position)
+                                   : 0.0f;
+        errors += left[(size_t)i] == expected && right[(size_t)i] == expected ? 0 : 1;
+      }
+    }
+    expectEquals((int)(RealtimeGuard::getViolationCount() - before), 0);
+    expectEquals(errors, 0);
+    expectEquals(delivered, length);
+
+    // Stereo to stereo, then summed to mono (the channels cancel out)
+    SamplePlayhead stereoPlayhead;
+    expectEquals(stereoPlayhead.read(*stereo, 100, kSampleRate, destinations, 2, blockSize),
+                 blockSize);
+    expectEquals(left[10], RampReader::getValue(0, 110));
+    expectEquals(right[10], RampReader::getValue(1, 110));
+    stereoPlayhead.read(*stereo, 100, kSampleRate, destinations, 1, blockSize);
+    expectEquals(juce::FloatVectorOperations::findMaximum(left.data(), blockSize), 0.0f);
+  }
+
+  void testResampling() {
+    constexpr double sourceRate = 44100.0;
+    constexpr int length = 44100;
+    RampReader reader(sourceRate, 1, length);
+    const auto sample = DecodedSample::decode(&reader);
+
+    constexpr int blockSize = 480;
+    const auto outputLength = (int)sample->getLength(kSampleRate);
+    expectEquals(outputLength, 48000);
+    std::vector<float> output((size_t)outputLength + 4 * blockSize);
+    SamplePlayhead playhead;
+
+    int delivered = 0;
+    const auto before = RealtimeGuard::getViolationCount();
+    {
+      const RealtimeGuard::Scope realtime;
+      for (int frame = 0; frame < (int)output.size(); frame += blockSize) {
+        float* destination = output.data() + frame;
+        delivered += playhead.read(*sample, frame, kSampleRate, &destination, 1, blockSize);
+      }
+    }
+    expectEquals((int)(RealtimeGuard::getViolationCount() - before), 0);
+    expect(delivered >= outputLength - 2 && delivered <= outputLength);
+
+    // Within a few source frames of the exact position (interpolator
+    // latency), away from the ramp's wrap-around; silence after the end
+    double worst = 0.0;
+    for (int i = 100; i < outputLength - 8; i += 5) {
+      const double position = std::fmod(i * sourceRate / kSampleRate, 40000.0);
+      if (position > 39990.0) {
+        continue;
+      }
+      worst = std::max(worst, std::abs(output[(size_t)i] - position * 2.5e-5));
+    }
+    expect(worst < 5.0 * 2.5e-5, "Worst error " + juce::String(worst));
+    expectEquals(juce::FloatVectorOperations::findMaximum(
+                     output.data() + outputLength, 2 * blockSize),
+                 0.0f);
+  }
+
+  void testTrack() {
+    SampleCache cache;
+    const auto sample = cache.load("loop", makeFactory(kSampleRate, 1, 20000));
+    SampleTrack track(sample, 1000);
+    track.setVolume(0.5f);
+    expect(track.getStream() == nullptr && track.getSample() == sample);
+    expectEquals(track.getNumOutputChannels(), 1);
+
+    constexpr int blockSize = 256;
+    juce::AudioBuffer<float> buffer(1, blockSize);
+    BeatContext context;
+    context.sampleRate = kSampleRate;
+
+    // Active from the start of the file (sample 1000) to its end (21000)
+    int errors = 0;
+    int activityErrors = 0;
+    for (context.sample = 0; context.sample < 4000; context.sample += blockSize) {
+      const RenderActivity activity = track.renderBlock(buffer, 0, blockSize, context);
+      for (int i = 0; i < blockSize; ++i) {
+        const auto frame = context.sample + i - 1000;
+        const float expected = frame >= 0 ? RampReader::getValue(0, frame) : 0.0f;
+        errors += buffer.getSample(0, i) == expected ? 0 : 1;
+        activityErrors += (i >= activity.start && i < activity.end) == (frame >= 0) ? 0 : 1;
+      }
+    }
+    expectEquals(errors, 0);
+    expectEquals(activityErrors, 0);
+
+    context.sample = 20900;
+    const RenderActivity end = track.renderBlock(buffer, 0, blockSize, context);
+    expect(end.start == 0 && end.end == 100);
+    context.sample += blockSize;
+    expect(track.renderBlock(buffer, 0, blockSize, context).isSilent());
+
+    // Offline copies share the decoded sample
+    const auto copy = track.clone();
+    auto* sampleCopy = dynamic_cast<SampleTrack*>(copy.get());
+    expect(sampleCopy != nullptr && sampleCopy->getSample() == sample);
+    context.sample = 5000;
+    expectEquals(copy->getSampleValue(context), RampReader::getValue(0, 4000));
+    expectEquals(cache.getStatistics().entriesInUse, 1);
+  }
+};
+
+static SampleCacheTests sampleCacheTests;
@@ -0,0 +1,342 @@
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_core/juce_core.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "../include/realtime-guard.hpp"
+#include "../include/sample-cache.hpp"
+#include "../include/sample-sidecar.hpp"
+#include "../include/sample-track.hpp"
+
+/**
+ * Unit tests for SampleSidecar and sidecar loads of the SampleCache
+ * Tests the file layout, invalidation by sample rate and source contents,
+ * damaged files, offline resampling, and cache misses mapping sidecars
+ * instead of decoding after a restart
+ */
+class SampleSidecarTests : public juce::UnitTest {
+ public:
+  SampleSidecarTests() : juce::UnitTest("SampleSidecar Tests") {}
+
+  void runTest() override {
+    directory = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                    .getChildFile("daw-sample-sidecar-test");
+    directory.deleteRecursively();
+    directory.createDirectory();
+    source = directory.getChildFile("loop.flac");
+    source.replaceWithText("compressed audio");
+
+    beginTest("Write and map");
+    testRoundTrip();
+
+    beginTest("Sidecar names");
+    testNames();
+
+    beginTest("Invalidation");
+    testInvalidation();
+
+    beginTest("Damaged sidecars");
+    testDamaged();
+
+    beginTest("Offline resampling");
+    testResample();
+
+    beginTest("Cache loads map sidecars");
+    testCache();
+
+    directory.deleteRecursively();
+  }
+
+ private:
+  static constexpr double kSampleRate = 48000.0;
+
+  juce::File directory, source;
+
+  // In-memory file: a ramp, negated on the second channel
+  class RampReader : public juce::AudioFormatReader {
+   public:
+    RampReader(double rate, int channels, juce::int64 length)
+        : juce::AudioFormatReader(nullptr, "Ramp") {
+      sampleRate = rate;
+      numChannels = (unsigned int)channels;
+      lengthInSamples = length;
+      bitsPerSample = 32;
+      usesFloatingPointData = true;
+    }
+
+    static float getValue(int channel, juce::int64 frame) {
+      const auto value = (float)(frame % 40000) * 2.5e-5f;
+      return channel == 0 ? value : -value;
+    }
+
+    bool readSamples(int* const* destChannels, int numDestChannels,
+                     int startOffsetInDestBuffer, juce::int64 startSampleInFile,
+                     int numSamples) override {
+      for (int channel = 0; channel < numDestChannels; ++channel) {
+        if (destChannels[channel] == nullptr) {
+          continue;
+        }
+        auto* output =
+            reinterpret_cast<float*>(destChannels[channel]) + startOffsetInDestBuffer;
+        for (int i = 0; i < numSamples; ++i) {
+          output[i] = getValue(channel, startSampleInFile + i);
+        }
+      }
+      return true;
+    }
+  };
+
+  static std::shared_ptr<const DecodedSample> makeSample(double rate, int channels,
+                                                         juce::int64 length) {
+    RampReader reader(rate, channels, length);
+    return DecodedSample::decode(&reader);
+  }
+
+  static bool sameFrames(const DecodedSample& a, const DecodedSample& b) {
+    if (a.getNumChannels() != b.getNumChannels() || a.getLength() != b.getLength()) {
+      return false;
+    }
+    for (int channel = 0; channel < a.getNumChannels(); ++channel) {
+      for (int i = 0; i < a.getLength() + DecodedSample::kPaddingFrames; ++i) {
+        if (a.getReadPointer(channel)[i] != b.getReadPointer(channel)[i]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  void testRoundTrip() {
+    const auto sample = makeSample(kSampleRate, 2, 5000);
+    const auto sidecar = SampleSidecar::getFile(directory, source, kSampleRate);
+    expect(SampleSidecar::write(sidecar, source, *sample));
+    expect(!sidecar.getSiblingFile(sidecar.getFileName() + ".tmp").exists(),
+           "Temporary file renamed");
+
+    // Header page, then 5000 + 32 frames per channel rounded up to pages
+    expect(sidecar.getSize() == (juce::int64)(SampleSidecar::kPageBytes + 2 * 5120 * 4));
+
+    const auto mapped = SampleSidecar::open(sidecar, source, kSampleRate);
+    expect(mapped != nullptr);
+    if (mapped == nullptr) {
+      return;
+    }
+    expect(mapped->isMapped() && !sample->isMapped());
+    expectEquals(mapped->getSampleRate(), kSampleRate);
+    expect(sameFrames(*mapped, *sample), "Frames and padding read back");
+    expect(mapped->getSizeInBytes() == sample->getSizeInBytes());
+    for (int channel = 0; channel < 2; ++channel) {
+      expect((std::uintptr_t)mapped->getReadPointer(channel) % SampleSidecar::kPageBytes ==
+                 0,
+             "Channels start on a page");
+    }
+
+    // An empty file is valid too
+    const auto empty = makeSample(kSampleRate, 1, 0);
+    const auto emptySidecar = directory.getChildFile("empty.f32");
+    expect(SampleSidecar::write(emptySidecar, source, *empty));
+    const auto emptyMapped = SampleSidecar::open(emptySidecar, source, kSampleRate);
+    expect(emptyMapped != nullptr && emptyMapped->getLength() == 0);
+  }
+
+  void testNames() {
+    const auto file = SampleSidecar::getFile(directory, source, kSampleRate);
+    expect(file.getParentDirectory() == directory);
+    expect(file.hasFileExtension("f32"));
+    expect(file.getFileName().startsWith("loop-"));
+    expect(file != SampleSidecar::getFile(directory, source, 44100.0), "Per rate");
+    expect(file != SampleSidecar::getFile(directory, directory.getChildFile("sub")
+                                                         .getChildFile("loop.flac"),
+                                          kSampleRate),
+           "Per source path");
+  }
+
+  void testInvalidation() {
+    const auto sample = makeSample(kSampleRate, 1, 3000);
+    const auto sidecar = SampleSidecar::getFile(directory, source, kSampleRate);
+    expect(SampleSidecar::write(sidecar, source, *sample));
+
+    expect(SampleSidecar::open(sidecar, source, 44100.0) == nullptr, "Other rate");
+    expect(SampleSidecar::open(sidecar, directory.getChildFile("missing.wav"),
+                               kSampleRate) == nullptr,
+           "Other source");
+
+    // Touched (or copied) but unchanged: the hash still matches
+    const auto modified = source.getLastModificationTime();
+    source.setLastModificationTime(juce::Time(modified.toMilliseconds() - 60000));
+    expect(SampleSidecar::open(sidecar, source, kSampleRate) != nullptr, "Same contents");
+
+    // Rewritten with the same size
+    source.replaceWithText("COMPRESSED AUDIO");
+    source.setLastModificationTime(juce::Time(modified.toMilliseconds() + 60000));
+    expect(SampleSidecar::open(sidecar, source, kSampleRate) == nullptr, "New contents");
+
+    // Rewritten with another size
+    source.replaceWithText("compressed audio, longer");
+    expect(SampleSidecar::open(sidecar, source, kSampleRate) == nullptr, "New size");
+
+    // Written again: current
+    expect(SampleSidecar::write(sidecar, source, *sample));
+    expect(SampleSidecar::open(sidecar, source, kSampleRate) != nullptr);
+
+    expect(SampleSidecar::hashFile(source) != 0);
+    expect(SampleSidecar::hashFile(source) == SampleSidecar::hashFile(source));
+    expect(SampleSidecar::hashFile(directory.getChildFile("missing.wav")) == 0);
+  }
+
+  void testDamaged() {
+    const auto sample = makeSample(kSampleRate, 2, 3000);
+    const auto sidecar = directory.getChildFile("damaged.f32");
+    expect(SampleSidecar::write(sidecar, source, *sample));
+    std::vector<char> contents;
+    {
+      juce::MemoryMappedFile mapping(sidecar, juce::MemoryMappedFile::readOnly);
+      const auto* data = static_cast<const char*>(mapping.getData());
+      contents.assign(data, data + mapping.getSize());
+    }
+
+    sidecar.replaceWithData(contents.data(), contents.size() - 4096);
+    expect(SampleSidecar::open(sidecar, source, kSampleRate) == nullptr, "Truncated");
+
+    sidecar.replaceWithData(contents.data(), 100);
+    expect(SampleSidecar::open(sidecar, source, kSampleRate) == nullptr, "Short");
+
+    contents[0] = 'X';
+    sidecar.replaceWithData(contents.data(), contents.size());
+    expect(SampleSidecar::open(sidecar, source, kSampleRate) == nullptr, "Not a sidecar");
+
+    sidecar.deleteFile();
+    expect(SampleSidecar::open(sidecar, source, kSampleRate) == nullptr, "Missing");
+  }
+
+  void testResample() {
+    const auto sample = makeSample(44100.0, 2, 44100);
+    expect(DecodedSample::resample(sample, 44100.0) == sample, "Already at the rate");
+
+    const auto resampled = DecodedSample::resample(sample, kSampleRate);
+    expect(resampled != nullptr && resampled != sample);
+    if (resampled == nullptr) {
+      return;
+    }
+    expectEquals(resampled->getSampleRate(), kSampleRate);
+    expectEquals(resampled->getLength(), 48000);
+    expectEquals(resampled->getNumChannels(), 2);
+    expectEquals(resampled->getReadPointer(0)[48000], 0.0f, "Padding");
+
+    // The same frames as resampling while playing
+    constexpr int blockSize = 480;
+    std::vector<float> left(48000 + blockSize), right(48000 + blockSize);
+    SamplePlayhead playhead;
+    for (int frame = 0; frame < 48000; frame += blockSize) {
+      float* destinations[] = {left.data() + frame, right.data() + frame};
+      playhead.read(*sample, frame, kSampleRate, destinations, 2, blockSize);
+    }
+    float worst = 0.0f;
+    for (int i = 0; i < 48000; ++i) {
+      worst = std::max(worst, std::abs(left[(size_t)i] - resampled->getReadPointer(0)[i]));
+      worst = std::max(worst, std::abs(right[(size_t)i] - resampled->getReadPointer(1)[i]));
+    }
+    expect(worst < 1.0e-6f, "Worst difference " + juce::String(worst));
+  }
+
+  void testCache() {
+    source.replaceWithText("a compressed loop");
+    const auto sidecarDirectory = directory.getChildFile("sidecars");
+    std::atomic<int> opened{0};
+    const SampleStream::ReaderFactory factory =
+        [&opened]() -> std::unique_ptr<juce::AudioFormatReader> {
+      ++opened;
+      return std::make_unique<RampReader>(44100.0, 2, 20000);
+    };
+    const auto expected = DecodedSample::resample(makeSample(44100.0, 2, 20000), kSampleRate);
+
+    // Without a directory: resampled in memory
+    {
+      SampleCache cache;
+      const auto sample = cache.load(source, kSampleRate, factory);
+      expect(sample != nullptr && !sample->isMapped());
+      expect(sample != nullptr && sameFrames(*sample, *expected));
+      expectEquals((int)cache.getStatistics().sidecarWrites, 0);
+      expect(!sidecarDirectory.exists());
+    }
+
+    // First run: decoded, resampled, written, then played from the mapping
+    {
+      SampleCache cache;
+      cache.setSidecarDirectory(sidecarDirectory);
+      expect(cache.getSidecarDirectory() == sidecarDirectory);
+      opened = 0;
+      const auto sample = cache.load(source, kSampleRate, factory);
+      expect(sample != nullptr && sample->isMapped());
+      expect(sample != nullptr && sameFrames(*sample, *expected));
+      expectEquals(opened.load(), 1);
+      const auto statistics = cache.getStatistics();
+      expectEquals((int)statistics.sidecarWrites, 1);
+      expectEquals((int)statistics.sidecarLoads, 0);
+      expect(SampleSidecar::getFile(sidecarDirectory, source, kSampleRate).existsAsFile());
+
+      // Same file, same rate: a plain hit
+      expect(cache.load(source, kSampleRate, factory) == sample);
+      expectEquals((int)cache.getStatistics().hits, 1);
+    }
+
+    // Next run: mapped, nothing decoded
+    {
+      SampleCache cache;
+      cache.setSidecarDirectory(sidecarDirectory);
+      opened = 0;
+      const auto sample = cache.load(source, kSampleRate, factory);
+      expect(sample != nullptr && sample->isMapped());
+      expect(sample != nullptr && sameFrames(*sample, *expected));
+      expectEquals(opened.load(), 0, "No decoding");
+      expectEquals((int)cache.getStatistics().sidecarLoads, 1);
+
+      // Played like any cached sample, without violations
+      SampleTrack track(sample);
+      expectEquals(track.getNumOutputChannels(), 2);
+      juce::AudioBuffer<float> buffer(2, 512);
+      BeatContext context;
+      context.sampleRate = kSampleRate;
+      context.sample = 1000;
+      const auto before = RealtimeGuard::getViolationCount();
+      {
+        const RealtimeGuard::Scope realtime;
+        track.renderBlock(buffer, 0, 512, context);
+      }
+      expectEquals((int)(RealtimeGuard::getViolationCount() - before), 0);
+      expectEquals(buffer.getSample(0, 0), expected->getReadPointer(0)[1000]);
+      expectEquals(buffer.getSample(1, 0), expected->getReadPointer(1)[1000]);
+
+      // Another rate: its own sidecar
+      cache.load(source, 96000.0, factory);
+      expectEquals(opened.load(), 1);
+      expectEquals((int)cache.getStatistics().sidecarWrites, 1);
+      expect(SampleSidecar::getFile(sidecarDirectory, source, 96000.0).existsAsFile());
+    }
+
+    // Source rewritten: decoded again, sidecar replaced
+    {
+      source.replaceWithText("an edited loop!!!");
+      SampleCache cache;
+      cache.setSidecarDirectory(sidecarDirectory);
+      opened = 0;
+      expect(cache.load(source, kSampleRate, factory) != nullptr);
+      expectEquals(opened.load(), 1);
+      expectEquals((int)cache.getStatistics().sidecarLoads, 0);
+      expectEquals((int)cache.getStatistics().sidecarWrites, 1);
+    }
+
+    // Prometheus counters
+    SampleCache::Statistics statistics;
+    statistics.sidecarLoads = 500;
+    std::string text;
+    SampleCache::writePrometheus(statistics, text);
+    expect(text.find("daw_sample_cache_sidecar_loads_total 500\n") != std::string::npos);
+    expect(text.find("daw_sample_cache_sidecar_writes_total 0\n") != std::string::npos);
+  }
+};
+
+static SampleSidecarTests sampleSidecarTests;
@@ -0,0 +1,386 @@
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_core/juce_core.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../include/disk-streamer.hpp"
+#include "../include/realtime-guard.hpp"
+#include "../include/sample-track.hpp"
+
+/**
+ * Unit tests for SampleStream, DiskStreamer and SampleTrack
+ * Tests sample-exact streaming, lead-in and end of file, seeks, underruns
+ * and catching up after them, channel mapping, sample rate conversion,
+ * hundreds of simultaneous streams read without allocating or locking, and
+ * sample tracks and their offline copies
+ */
+class SampleStreamTests : public juce::UnitTest {
+ public:
+  SampleStreamTests() : juce::UnitTest("SampleStream Tests") {}
+
+  void runTest() override {
+    beginTest("Streams in time");
+    testContinuous();
+
+    beginTest("Lead-in and seeks");
+    testSeeks();
+
+    beginTest("Underruns catch up");
+    testUnderrun();
+
+    beginTest("Channel mapping");
+    testChannels();
+
+    beginTest("Sample rate conversion");
+    testResampling();
+
+    beginTest("Hundreds of streams");
+    testManyStreams();
+
+    beginTest("SampleTrack");
+    testTrack();
+  }
+
+ private:
+  static constexpr double kSampleRate = 48000.0;
+
+  // In-memory file: a ramp, negated on the second channel
+  class RampReader : public juce::AudioFormatReader {
+   public:
+    RampReader(double rate, int channels, juce::int64 length, int delayMs)
+        : juce::AudioFormatReader(nullptr, "Ramp"), delayMs(delayMs) {
+      sampleRate = rate;
+      numChannels = (unsigned int)channels;
+      lengthInSamples = length;
+      bitsPerSample = 32;
+      usesFloatingPointData = true;
+    }
+
+    static float getValue(int channel, juce::int64 frame) {
+      const auto value = (float)(frame % 50000) * 2.0e-5f;
+      return channel == 0 ? value : -value;
+    }
+
+    bool readSamples(int* const* destChannels, int numDestChannels,
+                     int startOffsetInDestBuffer, juce::int64 startSampleInFile,
+                     int numSamples) override {
+      if (delayMs > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+      }
+      for (int channel = 0; channel < numDestChannels; ++channel) {
+        if (destChannels[channel] == nullptr) {
+          continue;
+        }
+        auto* output =
+            reinterpret_cast<float*>(destChannels[channel]) + startOffsetInDestBuffer;
+        for (int i = 0; i < numSamples; ++i) {
+          output[i] = getValue(channel, startSampleInFile + i);
+        }
+      }
+      return true;
+    }
+
+   private:
+    int delayMs;
+  };
+
+  static SampleStream::ReaderFactory makeFactory(double rate, int channels,
+                                                 juce::int64 length,
+                                                 int delayMs = 0) {
+    return [=]() -> std::unique_ptr<juce::AudioFormatReader> {
+      return std::make_unique<RampReader>(rate, channels, length, delayMs);
+    };
+  }
+
+  static bool waitFor(const std::function<bool()>& condition) {
+    for (int i = 0; i < 5000; ++i) {
+      if (condition()) {
+        return true;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+  }
+
+  // Wait until the disk thread has decoded the frames of the next read
+  static bool waitForFrames(const SampleStream& stream, int numFrames) {
+    return waitFor([&stream, numFrames]() {
+      return !stream.hasPendingSeek() && stream.getBufferedFrames() >= numFrames;
+    });
+  }
+
+  // Frames which do not match the file (mono, first channel)
+  static int countErrors(const float* samples, juce::int64 frame, int numFrames,
+                         juce::int64 length) {
+    int errors = 0;
+    for (int i = 0; i < numFrames; ++i) {
+      const auto position = frame + i;
+      const float expected = position >= 0 && position < length
+                                 ? RampReader::getValue(0, position)
+                                 : 0.0f;
+      errors += samples[i] == expected ? 0 : 1;
+    }
+    return errors;
+  }
+
+  void testContinuous() {
+    constexpr juce::int64 length = 100000;
+    constexpr int blockSize = 480;
+    DiskStreamer streamer;
+    auto stream = streamer.createStream(makeFactory(kSampleRate, 1, length), kSampleRate);
+    expect(stream != nullptr && stream->isValid());
+    if (stream == nullptr) {
+      return;
+    }
+    expectEquals(stream->getNumChannels(), 1);
+    expect(stream->getLength(kSampleRate) == length);
+    expect(!stream->isMemoryMapped());
+
+    std::vector<float> block(blockSize);
+    float* destination = block.data();
+    int errors = 0, delivered = 0;
+    for (juce::int64 frame = 0; frame < length + 4 * blockSize; frame += blockSize) {
+      const int due = (int)juce::jlimit<juce::int64>(0, blockSize, length - frame);
+      expect(waitForFrames(*stream, due));
+      delivered += stream->read(frame, kSampleRate, &destination, 1, blockSize);
+      errors += countErrors(destination, frame, blockSize, length);
+    }
+
+    expectEquals(errors, 0, "Every frame, silence after the end");
+    expectEquals(delivered, (int)length);
+    expectEquals((int)stream->getUnderrunFrames(), 0);
+  }
+
+  void testSeeks() {
+    constexpr juce::int64 length = 400000;
+    constexpr int blockSize = 512;
+    DiskStreamer streamer;
+    auto stream = streamer.createStream(makeFactory(kSampleRate, 1, length), kSampleRate);
+    if (stream == nullptr) {
+      expect(false, "Stream not created");
+      return;
+    }
+
+    std::vector<float> block(blockSize);
+    float* destination = block.data();
+
+    // Starts 100 frames before the file
+    expect(waitForFrames(*stream, blockSize));
+    expectEquals(stream->read(-100, kSampleRate, &destination, 1, blockSize),
+                 blockSize - 100);
+    expectEquals(countErrors(destination, -100, blockSize, length), 0, "Lead-in");
+
+    // A jump is silent until the disk thread caught up, then in time even
+    // though the reader moved on meanwhile
+    for (const juce::int64 target : {(juce::int64)300000, (juce::int64)7, length - 100}) {
+      stream->read(target, kSampleRate, &destination, 1, blockSize);
+      expect(waitForFrames(*stream, (int)juce::jmin<juce::int64>(2 * blockSize,
+                                                                 length - target)));
+      const auto next = target + blockSize;
+      stream->read(next, kSampleRate, &destination, 1, blockSize);
+      expectEquals(countErrors(destination, next, blockSize, length), 0,
+                   "After seeking to " + juce::String(target));
+    }
+
+    // Silence before the file does not request a seek per block
+    stream->read(-5000, kSampleRate, &destination, 1, blockSize);
+    stream->read(-5000 + blockSize, kSampleRate, &destination, 1, blockSize);
+    expect(waitForFrames(*stream, blockSize));
+    expect(!stream->hasPendingSeek());
+    expectEquals(countErrors(destination, -5000 + blockSize, blockSize, length), 0);
+    expectEquals((int)stream->getUnderrunFrames(), 0);
+  }
+
+  void testUnderrun() {
+    constexpr juce::int64 length = 200000;
+    constexpr int blockSize = 1024;
+    // 4096-frame ring refilled 1024 frames at a time by a slow disk
+    DiskStreamer streamer(4096, 1024);
+    auto stream =
+        streamer.createStream(makeFactory(kSampleRate, 1, length, 5), kSampleRate);
+    if (stream == nullptr) {
+      expect(false, "Stream not created");
+      return;
+    }
+
+    std::vector<float> block(blockSize);
+    float* destination = block.data();
+    expect(waitForFrames(*stream, 4096));
+
+    // Read far faster than the disk: the ring runs dry
+    juce::int64 frame = 0;
+    for (int i = 0; i < 32; ++i, frame += blockSize) {
+      stream->read(frame, kSampleRate, &destination, 1, blockSize);
+    }
+    expect(stream->getUnderrunFrames() > 0);
+
+    // The disk thread restarts at the reader: frames missed are skipped, not
+    // played late
+    expect(waitForFrames(*stream, 2048));
+    const int delivered = stream->read(frame, kSampleRate, &destination, 1, blockSize);
+    expectEquals(countErrors(destination, frame, delivered, length), 0);
+  }
+
+  void testChannels() {
+    constexpr juce::int64 length = 10000;
+    constexpr int numFrames = 6000;
+    std::vector<float> left(numFrames), right(numFrames);
+    float* destinations[] = {left.data(), right.data()};
+
+    // Synchronous streams: read() decodes what it needs
+    SampleStream stereo(makeFactory(kSampleRate, 2, length), kSampleRate, 1024, nullptr);
+    expectEquals(stereo.getNumChannels(), 2);
+    expectEquals(stereo.read(0, kSampleRate, destinations, 2, numFrames), numFrames);
+    int errors = 0;
+    for (int i = 0; i < numFrames; ++i) {
+      errors += left[(size_t)i] == RampReader::getValue(0, i) &&
+                        right[(size_t)i] == RampReader::getValue(1, i)
+                    ? 0
+                    : 1;
+    }
+    expectEquals(errors, 0, "Stereo");
+
+    // Summed to mono: the channels cancel out
+    stereo.read(numFrames, kSampleRate, destinations, 1, numFrames);
+    expectEquals(juce::FloatVectorOperations::findMaximum(left.data(), numFrames), 0.0f);
+
+    SampleStream mono(makeFactory(kSampleRate, 1, length), kSampleRate, 1024, nullptr);
+    mono.read(0, kSampleRate, destinations, 2, numFrames);
+    expectEquals(countErrors(left.data(), 0, numFrames, length), 0);
+    expectEquals(countErrors(right.data(), 0, numFrames, length), 0, "Mono copied");
+
+    // Unreadable files
+    DiskStreamer streamer;
+    expect(streamer.createStream([]() { return nullptr; }, kSampleRate) == nullptr);
+    expect(streamer.createStream(juce::File("/nonexistent/sample.wav"), kSampleRate) ==
+           nullptr);
+    expectEquals(streamer.getNumStreams(), 0);
+  }
+
+  void testResampling() {
+    constexpr double sourceRate = 44100.0;
+    constexpr juce::int64 length = 44100;
+    constexpr int numFrames = 48000;
+    SampleStream stream(makeFactory(sourceRate, 1, length), kSampleRate, 4096, nullptr);
+    expect(stream.getLength(kSampleRate) == 48000);
+
+    std::vector<float> output(numFrames);
+    float* destination = output.data();
+    expectEquals(stream.read(0, kSampleRate, &destination, 1, numFrames), numFrames);
+
+    // The ramp resampled: within a few source frames of the exact position
+    // (interpolator latency), away from the ramp's wrap-around
+    double worst = 0.0;
+    for (int i = 100; i < numFrames; i += 7) {
+      const double position = i * sourceRate / kSampleRate;
+      if (std::fmod(position, 50000.0) > 49990.0) {
+        continue;
+      }
+      const double expected = std::fmod(position, 50000.0) * 2.0e-5;
+      worst = std::max(worst, std::abs(output[(size_t)i] - expected));
+    }
+    expect(worst < 5.0 * 2.0e-5, "Worst error " + juce::String(worst));
+  }
+
+  void testManyStreams() {
+    constexpr int numStreams = 256;
+    constexpr int blockSize = 256;
+    constexpr int numBlocks = 200;
+    constexpr juce::int64 length = 1 << 20;
+    DiskStreamer streamer(16384, 4096);
+
+    std::vector<std::shared_ptr<SampleStream>> streams;
+    for (int i = 0; i < numStreams; ++i) {
+      streams.push_back(
+          streamer.createStream(makeFactory(kSampleRate, 1, length), kSampleRate));
+    }
+    expectEquals(streamer.getNumStreams(), numStreams);
+    for (const auto& stream : streams) {
+      expect(waitForFrames(*stream, 16384 - 2048));
+    }
+
+    // Every stream played in real time
+    std::vector<float> block(blockSize);
+    float* destination = block.data();
+    int errors = 0;
+    const auto before = RealtimeGuard::getViolationCount();
+    for (int b = 0; b < numBlocks; ++b) {
+      for (int i = 0; i < numStreams; ++i) {
+        const juce::int64 frame = (juce::int64)b * blockSize;
+        const RealtimeGuard::Scope realtime;
+        streams[(size_t)i]->read(frame, kSampleRate, &destination, 1, blockSize);
+        errors += countErrors(destination, frame, blockSize, length);
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(5300));
+    }
+    const auto violations = RealtimeGuard::getViolationCount() - before;
+
+    juce::uint64 underruns = 0;
+    for (const auto& stream : streams) {
+      underruns += stream->getUnderrunFrames();
+    }
+    expectEquals((int)violations, 0, "Reads never allocate, lock or block");
+    expectEquals((int)underruns, 0);
+    expectEquals(errors, 0);
+
+    // Streams of removed tracks are released
+    streams.clear();
+    expectEquals(streamer.getNumStreams(), 0);
+  }
+
+  void testTrack() {
+    constexpr juce::int64 length = 50000;
+    constexpr int blockSize = 1000;
+    DiskStreamer streamer;
+    auto stream = streamer.createStream(makeFactory(kSampleRate, 1, length), kSampleRate);
+    if (stream == nullptr) {
+      expect(false, "Stream not created");
+      return;
+    }
+
+    SampleTrack track(stream, 2000);
+    track.setVolume(0.5f);
+    expect(track.getStartSample() == 2000);
+
+    juce::AudioBuffer<float> buffer(1, blockSize);
+    BeatContext context;
+    context.sampleRate = kSampleRate;
+
+    // Silent until the file starts at sample 2000
+    int errors = 0;
+    for (context.sample = 0; context.sample < 10000; context.sample += blockSize) {
+      expect(waitForFrames(*stream, blockSize));
+      track.renderBlock(buffer, 0, blockSize, context);
+      for (int i = 0; i < blockSize; ++i) {
+        const auto frame = context.sample + i - 2000;
+        const float expected = frame >= 0 ? RampReader::getValue(0, frame) : 0.0f;
+        errors += buffer.getSample(0, i) == expected ? 0 : 1;
+      }
+    }
+    expectEquals(errors, 0);
+
+    // Rendered dry: volume and mute are applied by the mixer, so muted
+    // tracks keep their position
+    track.setMute(true);
+    expect(waitForFrames(*stream, blockSize));
+    track.renderBlock(buffer, 0, blockSize, context);
+    expectEquals(buffer.getSample(0, 0), RampReader::getValue(0, context.sample - 2000));
+    track.setMute(false);
+    context.sample += blockSize;
+    expect(waitForFrames(*stream, blockSize));
+    track.renderBlock(buffer, 0, blockSize, context);
+    expectEquals(buffer.getSample(0, 0), RampReader::getValue(0, context.sample - 2000));
+
+    // The offline copy decodes by itself, from any position
+    auto copy = track.clone();
+    context.sample = 30000;
+    copy->renderBlock(buffer, 0, blockSize, context);
+    expectEquals(buffer.getSample(0, 10), RampReader::getValue(0, 30000 + 10 - 2000));
+    expectEquals(copy->volume, 0.5f);
+    expectEquals(copy->getSampleValue(context), RampReader::getValue(0, 30000 - 2000));
+  }
+};
+
+static SampleStreamTests sampleStreamTests;
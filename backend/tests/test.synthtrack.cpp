@@ -0,0 +1,285 @@
+#include <juce_core/juce_core.h>
+#include <cmath>
+#include <vector>
+#include "../include/audio-context.hpp"
+#include "../include/mix-engine.hpp"
+#include "../include/realtime-guard.hpp"
+#include "../include/synth-track.hpp"
+#include "../include/transport.hpp"
+
+/**
+ * Unit tests for the SynthTrack class
+ * Tests pitch, release and retirement of voices, both steal modes, block
+ * size independence, notes queued to the MixEngine on their sample, and
+ * that notes and rendering never allocate on the audio thread
+ */
+class SynthTrackTests : public juce::UnitTest {
+ public:
+  SynthTrackTests() : juce::UnitTest("SynthTrack Tests") {}
+
+  void runTest() override {
+    AudioContext::getInstance().sampleRate = kSampleRate;
+
+    beginTest("Notes play at their pitch");
+    testPitch();
+
+    beginTest("Released voices leave the pool");
+    testRelease();
+
+    beginTest("Oldest voice is stolen");
+    testStealOldest();
+
+    beginTest("Quietest voice is stolen");
+    testStealQuietest();
+
+    beginTest("Output does not depend on the block size");
+    testBlockSizes();
+
+    beginTest("Clones start without voices");
+    testClone();
+
+    beginTest("Notes apply on their sample");
+    testSampleAccurate();
+
+    beginTest("Notes and rendering are real-time safe");
+    testRealtime();
+  }
+
+ private:
+  static constexpr double kSampleRate = 48000.0;
+
+  // Renders numSamples samples in blocks of blockSize into output
+  struct Renderer {
+    TempoMap map{120.0, kSampleRate};
+    Transport transport;
+    juce::AudioBuffer<float> buffer{1, 4096};
+
+    RenderActivity render(SynthTrack& track, float* output, int numSamples,
+                          int blockSize = 64) {
+      RenderActivity activity;
+      for (int done = 0; done < numSamples;) {
+        // The constant tempo map never shortens the span
+        int count = std::min(blockSize, numSamples - done);
+        const BeatContext context = transport.getContext(map, count);
+        const auto block = track.renderBlock(buffer, 0, count, context);
+        transport.advance(count);
+        if (!block.isSilent()) {
+          activity.include(done + block.start, done + block.end);
+        }
+        if (output != nullptr) {
+          std::copy(buffer.getReadPointer(0), buffer.getReadPointer(0) + count,
+                    output + done);
+        }
+        done += count;
+      }
+      return activity;
+    }
+  };
+
+  static ADSRParameters getShortEnvelope() {
+    ADSRParameters adsr;
+    adsr.attackTime = 0.001f;
+    adsr.decayTime = 0.001f;
+    adsr.sustainLevel = 1.0f;
+    adsr.releaseTime = 0.002f;
+    return adsr;
+  }
+
+  void testPitch() {
+    SynthTrack track(8, WaveTable::WaveType::SINE);
+    track.setADSRParameters(getShortEnvelope());
+    Renderer renderer;
+
+    std::vector<float> output(48000);
+    expect(renderer.render(track, output.data(), 256).isSilent(),
+           "No voice, no signal");
+
+    track.noteOn(69, 0.5f);
+    expectEquals(track.getActiveVoiceCount(), 1);
+    renderer.render(track, output.data(), (int)output.size());
+
+    // One second of A4: 440 rising zero crossings after the attack
+    int crossings = 0;
+    float peak = 0.0f;
+    for (size_t i = 1000; i < output.size(); ++i) {
+      crossings += output[i - 1] < 0.0f && output[i] >= 0.0f ? 1 : 0;
+      peak = std::max(peak, std::abs(output[i]));
+    }
+    const int expected =
+        juce::roundToInt(440.0 * (double)(output.size() - 1000) / kSampleRate);
+    expect(std::abs(crossings - expected) <= 1,
+           "Expected about " + juce::String(expected) + " periods, got " +
+               juce::String(crossings));
+    expectWithinAbsoluteError(peak, 0.5f, 0.01f);
+  }
+
+  void testRelease() {
+    SynthTrack track(8);
+    track.setADSRParameters(getShortEnvelope());
+    Renderer renderer;
+
+    track.noteOn(60, 1.0f);
+    track.noteOn(64, 1.0f);
+    track.noteOn(67, 0.0f);  // Velocity 0 is a note-off
+    expectEquals(track.getActiveVoiceCount(), 2);
+    renderer.render(track, nullptr, 1024);
+
+    track.noteOff(60);
+    expectEquals(track.getActiveVoiceCount(), 2);
+    renderer.render(track, nullptr, 1024);
+    expectEquals(track.getActiveVoiceCount(), 1);
+
+    // The tail ends within the block, then blocks are cleared and silent
+    track.allNotesOff();
+    std::vector<float> output(1024, 1.0f);
+    const auto tail = renderer.render(track, output.data(), 1024, 1024);
+    expectEquals(track.getActiveVoiceCount(), 0);
+    expect(!tail.isSilent() && tail.end < 1024, "Activity stops with the tail");
+    bool zeros = true;
+    for (int i = tail.end; i < 1024; ++i) {
+      zeros = zeros && output[(size_t)i] == 0.0f;
+    }
+    expect(zeros, "Samples after the tail are exact zeros");
+    expect(renderer.render(track, output.data(), 1024).isSilent());
+  }
+
+  void testStealOldest() {
+    SynthTrack track(4);
+    track.setADSRParameters(getShortEnvelope());
+    Renderer renderer;
+
+    for (int note = 60; note < 64; ++note) {
+      track.noteOn(note, 1.0f);
+      renderer.render(track, nullptr, 64);
+    }
+    track.noteOn(64, 1.0f);
+    expectEquals(track.getActiveVoiceCount(), 4);
+
+    // Note 60 was stolen: releasing the others empties the pool
+    for (int note = 61; note <= 64; ++note) {
+      track.noteOff(note);
+    }
+    renderer.render(track, nullptr, 2048);
+    expectEquals(track.getActiveVoiceCount(), 0);
+  }
+
+  void testStealQuietest() {
+    SynthTrack track(4);
+    track.setADSRParameters(getShortEnvelope());
+    track.setStealMode(SynthTrack::StealMode::Quietest);
+    Renderer renderer;
+
+    // The oldest voice is loud, the second one quiet
+    track.noteOn(60, 1.0f);
+    track.noteOn(61, 0.1f);
+    track.noteOn(62, 1.0f);
+    track.noteOn(63, 1.0f);
+    renderer.render(track, nullptr, 512);
+    track.noteOn(64, 1.0f);
+
+    for (int note : {60, 62, 63, 64}) {
+      track.noteOff(note);
+    }
+    renderer.render(track, nullptr, 2048);
+    expectEquals(track.getActiveVoiceCount(), 0);
+  }
+
+  void testBlockSizes() {
+    // Envelopes step once per chunk: blocks of whole chunks give the same
+    // samples whatever their size
+    std::vector<float> expected(4096);
+    std::vector<float> actual(4096);
+    for (int blockSize : {4096, 64, 16}) {
+      SynthTrack track(64);
+      Renderer renderer;
+      auto& output = blockSize == 4096 ? expected : actual;
+      for (int note = 0; note < 40; ++note) {
+        track.noteOn(30 + note * 2, 0.02f * (float)(note + 1));
+      }
+      renderer.render(track, output.data(), 2048, blockSize);
+      track.allNotesOff();
+      renderer.render(track, output.data() + 2048, 2048, blockSize);
+
+      if (blockSize != 4096) {
+        expect(actual == expected,
+               "Blocks of " + juce::String(blockSize) + " differ");
+      }
+    }
+  }
+
+  void testClone() {
+    SynthTrack track(32, WaveTable::WaveType::TRIANGLE);
+    track.setStealMode(SynthTrack::StealMode::Quietest);
+    track.setVolume(0.3f);
+    track.noteOn(60, 1.0f);
+
+    const auto copy = track.clone();
+    auto* synth = dynamic_cast<SynthTrack*>(copy.get());
+    expect(synth != nullptr);
+    if (synth != nullptr) {
+      expectEquals(synth->getActiveVoiceCount(), 0);
+      expectEquals(synth->getMaxVoices(), 32);
+      expect(synth->getWaveform() == WaveTable::WaveType::TRIANGLE);
+      expect(synth->getStealMode() == SynthTrack::StealMode::Quietest);
+      expectEquals(synth->volume, 0.3f);
+    }
+    expectEquals(track.getActiveVoiceCount(), 1);
+  }
+
+  void testSampleAccurate() {
+    MixEngine engine(0);
+    auto track = std::make_shared<SynthTrack>(16);
+    engine.addTrack(track);
+    engine.prepare(512, kSampleRate);
+
+    EngineCommand command;
+    command.type = EngineCommand::Type::NoteOn;
+    command.track = track;
+    command.note = 57;
+    command.value = 1.0;
+    command.sample = 700;  // Inside the second block
+    expect(engine.sendCommand(command));
+
+    juce::AudioBuffer<float> output(2, 2048);
+    for (int block = 0; block < 4; ++block) {
+      engine.process(output, block * 512, 512);
+    }
+
+    bool silentBefore = true;
+    for (int i = 0; i <= 700; ++i) {
+      silentBefore = silentBefore && output.getSample(0, i) == 0.0f;
+    }
+    expect(silentBefore, "Nothing plays before the note's sample");
+    expect(output.getSample(0, 702) != 0.0f, "The note starts on its sample");
+    expectEquals(track->getActiveVoiceCount(), 1);
+  }
+
+  void testRealtime() {
+    SynthTrack track(SynthTrack::kDefaultVoices);
+    track.setADSRParameters(getShortEnvelope());
+    Renderer renderer;
+    std::vector<float> output(512);
+
+    const auto before = RealtimeGuard::getViolationCount();
+    {
+      const RealtimeGuard::Scope realtime;
+
+      // More notes than voices, so later ones steal
+      for (int block = 0; block < 40; ++block) {
+        for (int note = 0; note < 10; ++note) {
+          track.noteOn(24 + (block * 10 + note) % 96, 0.5f);
+        }
+        if (block % 3 == 0) {
+          track.noteOff(24 + block % 96);
+        }
+        renderer.render(track, output.data(), 64);
+      }
+      track.allNotesOff();
+      renderer.render(track, output.data(), 512);
+    }
+    expectEquals((int)(RealtimeGuard::getViolationCount() - before), 0);
+    expectEquals(track.getActiveVoiceCount(), 0);
+  }
+};
+
+static SynthTrackTests synthTrackTests;
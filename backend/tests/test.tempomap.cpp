@@ -0,0 +1,161 @@
+#include <juce_core/juce_core.h>
+#include <cmath>
+#include "../include/tempo-map.hpp"
+#include "../include/transport.hpp"
+
+/**
+ * Unit tests for the TempoMap and Transport classes
+ * Tests sample/beat conversions at constant and ramped tempos, bar
+ * positions across time signature changes, and block-by-block evaluation
+ */
+class TempoMapTests : public juce::UnitTest {
+ public:
+  TempoMapTests() : juce::UnitTest("TempoMap Tests") {}
+
+  void runTest() override {
+    beginTest("Constant tempo is exact on whole beats");
+    testConstantTempo();
+
+    beginTest("Tempo ramps");
+    testRamp();
+
+    beginTest("Time signature changes");
+    testTimeSignatures();
+
+    beginTest("Transport spans stay within one segment");
+    testTransport();
+
+    beginTest("Edits and identity");
+    testEdits();
+  }
+
+ private:
+  void testConstantTempo() {
+    const TempoMap map(120.0, 44100.0);
+
+    bool exact = true;
+    for (juce::int64 beat : {1LL, 7LL, 1000000LL}) {
+      exact = exact && map.getSampleAtBeat((double)beat) == 22050.0 * beat;
+      exact = exact && map.getBeatAtSample(22050 * beat) == (double)beat;
+    }
+    expect(exact, "Whole beats should land on whole samples");
+
+    const auto context = map.getContext(11025);
+    expectEquals(context.beat, 0.5);
+    expectWithinAbsoluteError(context.getTempo(), 120.0, 1.0e-9);
+    expectEquals(context.beatsPerSampleDelta, 0.0);
+    expectEquals(context.bar, (juce::int64)0);
+    expect(context.tempoMap == &map);
+  }
+
+  void testRamp() {
+    // 4 beats at 120 BPM (2 s), then 4 beats slowing down to 60 BPM
+    TempoMap map(120.0, 44100.0);
+    map.setTempo(4.0, 120.0, true);
+    map.setTempo(8.0, 60.0);
+
+    // A linear ramp averages its end tempos: 4 beats at 90 BPM = 8/3 s
+    const double rampEnd = (2.0 + 8.0 / 3.0) * 44100.0;
+    expectWithinAbsoluteError(map.getSampleAtBeat(8.0), rampEnd, 1.0e-6);
+    expectWithinAbsoluteError(map.getSampleAtBeat(9.0), rampEnd + 44100.0, 1.0e-6);
+
+    const auto middle = map.getContext(88200 + 44100);
+    expect(middle.getTempo() < 120.0 && middle.getTempo() > 60.0,
+           "Tempo should be between the ramp ends");
+    expect(middle.beatsPerSampleDelta < 0.0, "Tempo should be decreasing");
+
+    const auto end = map.getContext((juce::int64)std::ceil(rampEnd));
+    expectWithinAbsoluteError(end.getTempo(), 60.0, 1.0e-3);
+
+    // Conversions invert each other and beats only move forward
+    bool roundTrip = true;
+    bool monotonic = true;
+    double previous = -1.0;
+    for (juce::int64 sample = 0; sample < 300000; sample += 997) {
+      const double beat = map.getBeatAtSample(sample);
+      roundTrip = roundTrip &&
+                  std::abs(map.getSampleAtBeat(beat) - (double)sample) < 1.0e-6;
+      monotonic = monotonic && beat > previous;
+      previous = beat;
+    }
+    expect(roundTrip, "Sample -> beat -> sample should round-trip");
+    expect(monotonic, "Beat position should always increase");
+  }
+
+  void testTimeSignatures() {
+    TempoMap map(120.0, 48000.0);
+    map.setTimeSignature(2, 7, 8);  // Bars 0-1 in 4/4, then 3.5 beats a bar
+    map.setTimeSignature(4, 3, 4);
+
+    const auto inSeven = map.getContext((juce::int64)map.getSampleAtBeat(12.0));
+    expectEquals(inSeven.numerator, 7);
+    expectEquals(inSeven.denominator, 8);
+    expectEquals(inSeven.bar, (juce::int64)3);
+    expectEquals(inSeven.barStartBeat, 11.5);
+
+    // Bar 4 starts at 8 + 2 * 3.5 beats
+    const auto inThree = map.getContext((juce::int64)map.getSampleAtBeat(19.0));
+    expectEquals(inThree.numerator, 3);
+    expectEquals(inThree.bar, (juce::int64)5);
+    expectEquals(inThree.barStartBeat, 18.0);
+  }
+
+  void testTransport() {
+    TempoMap map(100.0, 44100.0);
+    map.setTempo(3.0, 100.0, true);
+    map.setTempo(5.0, 170.0);
+    map.setTimeSignature(1, 5, 4);
+    map.setTempo(11.0, 80.0);
+
+    Transport transport;
+    bool withinSegment = true;
+    bool matches = true;
+    int spans = 0;
+
+    while (transport.getPosition() < 10 * 44100) {
+      int numSamples = 512;
+      const auto context = transport.getContext(map, numSamples);
+      const auto first = transport.getPosition();
+      const auto last = first + numSamples - 1;
+
+      withinSegment = withinSegment && numSamples > 0 &&
+                      map.findSegment(first) == map.findSegment(last);
+      matches = matches && context.beat == map.getContext(first).beat &&
+                std::abs(context.getBeatAt(numSamples - 1) -
+                         map.getBeatAtSample(last)) < 1.0e-9;
+
+      transport.advance(numSamples);
+      ++spans;
+    }
+
+    expect(withinSegment, "Blocks should be split at tempo map changes");
+    expect(matches, "Incremental contexts should match lookups");
+    expect(spans > 10 * 44100 / 512, "Some blocks should have been split");
+
+    // Seeking backwards finds the right segment again
+    transport.setPosition(0);
+    int numSamples = 512;
+    expectEquals(transport.getContext(map, numSamples).beat, 0.0);
+    expectEquals(numSamples, 512);
+  }
+
+  void testEdits() {
+    TempoMap map(120.0, 44100.0);
+    const auto copy = map;
+    expectEquals(copy.getId(), map.getId());
+
+    map.setTempo(4.0, 90.0);
+    map.setTempo(4.0, 140.0);  // Replaces the point
+    expect(map.getId() != copy.getId(), "Edits should change the id");
+    expectEquals((int)map.getSegments().size(), 2);
+    expectWithinAbsoluteError(map.getContext(88200).getTempo(), 140.0, 1.0e-9);
+
+    map.setTempo(0.0, 0.0);  // Clamped
+    expectEquals(map.getInitialTempo(), 1.0);
+
+    map.setSampleRate(48000.0);
+    expectEquals(map.getSampleAtBeat(1.0), 48000.0 * 60.0);
+  }
+};
+
+static TempoMapTests tempoMapTests;
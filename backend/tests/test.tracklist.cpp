@@ -0,0 +1,170 @@
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <thread>
+#include "../include/beat-track.hpp"
+#include "../include/track-list.hpp"
+
+/**
+ * Unit tests for the TrackListPublisher class
+ * Tests track editing, deferred reclamation, and concurrent add/remove while
+ * a simulated audio callback is running
+ */
+class TrackListTests : public juce::UnitTest {
+ public:
+  TrackListTests() : juce::UnitTest("TrackList Tests") {}
+
+  void runTest() override {
+    beginTest("Add and remove tracks");
+    testAddRemove();
+
+    beginTest("Published list is stable inside a read scope");
+    testReadScopeStability();
+
+    beginTest("Retired lists are reclaimed after the block ends");
+    testDeferredReclamation();
+
+    beginTest("Concurrent add/remove during simulated callbacks");
+    testConcurrentEdits();
+  }
+
+ private:
+  void testAddRemove() {
+    TrackListPublisher publisher;
+    expectEquals((int)publisher.getTrackCount(), 0);
+
+    expectEquals((int)publisher.addTrack(std::make_shared<BeatTrack>(440.0f)),
+                 0);
+    expectEquals((int)publisher.addTrack(std::make_shared<BeatTrack>(880.0f)),
+                 1);
+    expectEquals((int)publisher.getTrackCount(), 2);
+
+    expect(publisher.removeTrack(0), "Existing track should be removed");
+    expect(!publisher.removeTrack(5), "Out of range index should be rejected");
+    expectEquals((int)publisher.getTrackCount(), 1);
+    expect(publisher.getTrack(0) != nullptr, "Remaining track should exist");
+    expect(publisher.getTrack(1) == nullptr, "Removed slot should be empty");
+  }
+
+  void testReadScopeStability() {
+    TrackListPublisher publisher;
+    publisher.addTrack(std::make_shared<BeatTrack>(440.0f));
+
+    const TrackListPublisher::ReadScope scope(publisher);
+    publisher.addTrack(std::make_shared<BeatTrack>(880.0f));
+    publisher.removeTrack(0);
+
+    // The block keeps seeing the list it started with
+    expectEquals((int)scope->tracks.size(), 1);
+    expectEquals((int)publisher.getTrackCount(), 1);
+  }
+
+  void testDeferredReclamation() {
+    TrackListPublisher publisher;
+    std::weak_ptr<AudioTrack> removed;
+
+    {
+      auto track = std::make_shared<BeatTrack>(440.0f);
+      removed = track;
+      publisher.addTrack(std::move(track));
+    }
+
+    {
+      const TrackListPublisher::ReadScope scope(publisher);
+      publisher.removeTrack(0);
+
+      expect(publisher.getPendingReclaimCount() > 0,
+             "List seen by a running block must not be freed");
+      expect(!removed.expired(), "Track must outlive the running block");
+    }
+
+    publisher.collectGarbage();
+    expectEquals((int)publisher.getPendingReclaimCount(), 0);
+    expect(removed.expired(), "Track should be freed once the block ended");
+  }
+
+  void testConcurrentEdits() {
+    const TempoMap tempoMap(120.0, 44100.0);
+
+    constexpr int blockSize = 512;
+    constexpr int numBlocks = 4000;
+    constexpr size_t maxTracks = 32;
+
+    TrackListPublisher publisher;
+    juce::AudioBuffer<float> trackBuffer(1, blockSize);
+    juce::AudioBuffer<float> mixBuffer(2, blockSize);
+
+    std::atomic<bool> controlStarted{false};
+    std::atomic<bool> audioDone{false};
+    juce::int64 worstTicks = 0;
+    juce::int64 totalTicks = 0;
+    int edits = 0;
+
+    // Simulated audio callback: same render/mix loop as getNextAudioBlock
+    std::thread audioThread([&]() {
+      // Empty blocks are quick: without this the audio thread could finish
+      // before the control thread is even scheduled
+      while (!controlStarted.load()) {
+        std::this_thread::yield();
+      }
+
+      juce::int64 position = 0;
+      for (int block = 0; block < numBlocks; ++block) {
+        const auto start = juce::Time::getHighResolutionTicks();
+        {
+          const TrackListPublisher::ReadScope trackList(publisher);
+          mixBuffer.clear();
+          for (const auto& track : trackList->tracks) {
+            track->renderBlock(trackBuffer, 0, blockSize,
+                               tempoMap.getContext(position));
+            for (int channel = 0; channel < 2; ++channel) {
+              mixBuffer.addFrom(channel, 0, trackBuffer, 0, 0, blockSize);
+            }
+          }
+        }
+        const auto elapsed = juce::Time::getHighResolutionTicks() - start;
+        worstTicks = juce::jmax(worstTicks, elapsed);
+        totalTicks += elapsed;
+        position += blockSize;
+      }
+      audioDone.store(true);
+    });
+
+    // Control thread standing in for the WebSocket handler
+    std::thread controlThread([&]() {
+      juce::Random random(42);
+      controlStarted.store(true);
+      while (!audioDone.load()) {
+        const size_t count = publisher.getTrackCount();
+        if (count < maxTracks && (count == 0 || random.nextBool())) {
+          publisher.addTrack(
+              std::make_shared<BeatTrack>(200.0f + random.nextFloat() * 800.0f));
+        } else {
+          publisher.removeTrack((size_t)random.nextInt((int)count));
+        }
+        ++edits;
+      }
+    });
+
+    audioThread.join();
+    controlThread.join();
+
+    publisher.collectGarbage();
+    expectEquals((int)publisher.getPendingReclaimCount(), 0);
+    expect(edits > 0, "Control thread should have edited the track list");
+
+    const double worstMs =
+        juce::Time::highResolutionTicksToSeconds(worstTicks) * 1000.0;
+    const double meanMs =
+        juce::Time::highResolutionTicksToSeconds(totalTicks) * 1000.0 /
+        numBlocks;
+    const double deadlineMs = blockSize / tempoMap.getSampleRate() * 1000.0;
+
+    logMessage("Track list edits: " + juce::String(edits) + " over " +
+               juce::String(numBlocks) + " blocks");
+    logMessage("Callback time: mean " + juce::String(meanMs, 4) +
+               " ms, worst " + juce::String(worstMs, 4) + " ms (deadline " +
+               juce::String(deadlineMs, 2) + " ms)");
+  }
+};
+
+static TrackListTests trackListTests;
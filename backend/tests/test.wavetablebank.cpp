@@ -0,0 +1,180 @@
+#include <juce_core/juce_core.h>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "../include/wave-table-bank.hpp"
+
+/**
+ * Unit tests for the WaveTableBank class
+ * Tests band limits of each level, level selection, sharing and alignment,
+ * and that high notes render without aliasing
+ */
+class WaveTableBankTests : public juce::UnitTest {
+ public:
+  WaveTableBankTests() : juce::UnitTest("WaveTableBank Tests") {}
+
+  void runTest() override {
+    beginTest("Levels are band-limited");
+    testLevelBandLimits();
+
+    beginTest("Lowest level matches the naive waveform");
+    testLowestLevelShape();
+
+    beginTest("Level selection from the phase increment");
+    testLevelSelection();
+
+    beginTest("Banks are shared and cache-line aligned");
+    testSharingAndAlignment();
+
+    beginTest("High notes are alias-free");
+    testNoAliasing();
+
+    beginTest("Crossfade is continuous across octaves");
+    testCrossfadeContinuity();
+  }
+
+ private:
+  static constexpr float kTwoPi = 2.0f * juce::MathConstants<float>::pi;
+
+  // Magnitude of DFT bin k, normalized so a unit sine gives 1
+  static double getBinMagnitude(const float* data, int size, int bin) {
+    double re = 0.0;
+    double im = 0.0;
+    for (int i = 0; i < size; ++i) {
+      const double angle = 2.0 * juce::MathConstants<double>::pi * bin * i / size;
+      re += data[i] * std::cos(angle);
+      im -= data[i] * std::sin(angle);
+    }
+    return 2.0 * std::sqrt(re * re + im * im) / size;
+  }
+
+  void testLevelBandLimits() {
+    const WaveTableBank bank(WaveTable::WaveType::SAW, 1024);
+    expectEquals(bank.getNumLevels(), 9);
+    expectEquals(bank.getNumHarmonics(0), 256);
+    expectEquals(bank.getNumHarmonics(bank.getNumLevels() - 1), 1);
+
+    for (int level : {0, 3, 6}) {
+      const float* table = bank.getLevel(level);
+      const int harmonics = bank.getNumHarmonics(level);
+
+      const double last = getBinMagnitude(table, bank.getTableSize(), harmonics);
+      const double above =
+          getBinMagnitude(table, bank.getTableSize(), harmonics + 1);
+
+      expect(std::abs(last - 2.0 / (juce::MathConstants<double>::pi * harmonics)) < 1.0e-4,
+             "Highest harmonic of level " + juce::String(level) + " is kept");
+      expect(above < 1.0e-5, "Level " + juce::String(level) +
+                                 " has no harmonic above its limit");
+    }
+
+    // Guard sample for interpolation
+    const float* table = bank.getLevel(2);
+    expectEquals(table[bank.getTableSize()], table[0]);
+  }
+
+  void testLowestLevelShape() {
+    const WaveTableBank bank(WaveTable::WaveType::TRIANGLE, 4096);
+    const WaveTable naive(WaveTable::WaveType::TRIANGLE, 4096);
+
+    // Triangle harmonics fall off as 1/h^2: level 0 is almost exact
+    float maxError = 0.0f;
+    for (int i = 0; i < 64; ++i) {
+      const float phase = kTwoPi * (float)i / 64.0f;
+      maxError = std::max(maxError, std::abs(bank.getSample(phase, 0.0f) -
+                                             naive.getSample(phase)));
+    }
+    expect(maxError < 2.0e-3f, "Triangle error " + juce::String(maxError));
+
+    const WaveTableBank square(WaveTable::WaveType::SQUARE, 4096);
+    expect(std::abs(square.getSample(kTwoPi / 4.0f, 0.0f) - 1.0f) < 0.01f,
+           "Square plateau should be ~1");
+    expect(std::abs(square.getSample(3.0f * kTwoPi / 4.0f, 0.0f) + 1.0f) < 0.01f,
+           "Square plateau should be ~-1");
+  }
+
+  void testLevelSelection() {
+    const WaveTableBank bank(WaveTable::WaveType::SAW, 4096);
+    const float samplesToRadians = kTwoPi / 4096.0f;
+
+    expectEquals(bank.getLevelForIncrement(0.0f), 0.0f);
+    expectEquals(bank.getLevelForIncrement(0.5f * samplesToRadians), 0.0f);
+    expectWithinAbsoluteError(bank.getLevelForIncrement(8.0f * samplesToRadians),
+                              3.0f, 1.0e-4f);
+    expectWithinAbsoluteError(bank.getLevelForIncrement(-8.0f * samplesToRadians),
+                              3.0f, 1.0e-4f);
+    expectWithinAbsoluteError(bank.getLevelForIncrement(12.0f * samplesToRadians),
+                              std::log2(12.0f), 1.0e-4f);
+    expectEquals(bank.getLevelForIncrement(kTwoPi),
+                 (float)(bank.getNumLevels() - 1));
+  }
+
+  void testSharingAndAlignment() {
+    const auto& saw = WaveTableBank::get(WaveTable::WaveType::SAW);
+    expect(&saw == &WaveTableBank::get(WaveTable::WaveType::SAW),
+           "Same waveform should share one bank");
+    expect(&saw != &WaveTableBank::get(WaveTable::WaveType::SQUARE),
+           "Waveforms should have their own bank");
+
+    bool aligned = true;
+    for (int level = 0; level < saw.getNumLevels(); ++level) {
+      aligned = aligned &&
+                reinterpret_cast<std::uintptr_t>(saw.getLevel(level)) % 64 == 0;
+    }
+    expect(aligned, "Every level should start on a cache line");
+  }
+
+  void testNoAliasing() {
+    // A saw at bin 150 of a 4096-point window (~1.6 kHz at 44.1 kHz): the
+    // naive table folds harmonics above Nyquist onto non-multiples of 150
+    constexpr int size = 4096;
+    constexpr int fundamentalBin = 150;
+    const float increment = kTwoPi * fundamentalBin / size;
+
+    std::vector<float> bandLimited(size);
+    WaveTableBank::get(WaveTable::WaveType::SAW)
+        .renderBlock(bandLimited.data(), size, 0.0f, increment);
+
+    std::vector<float> naive(size);
+    WaveTable(WaveTable::WaveType::SAW, 4096)
+        .renderBlock(naive.data(), size, 0.0f, increment);
+
+    const auto getAliasEnergy = [this](const std::vector<float>& data) {
+      double energy = 0.0;
+      for (int bin = 1; bin < size / 2; bin += 7) {
+        if (bin % fundamentalBin != 0) {
+          energy += std::pow(getBinMagnitude(data.data(), size, bin), 2.0);
+        }
+      }
+      return energy;
+    };
+
+    const double bankAliasing = getAliasEnergy(bandLimited);
+    const double naiveAliasing = getAliasEnergy(naive);
+    logMessage("Alias energy: bank " + juce::String(bankAliasing) + ", naive " +
+               juce::String(naiveAliasing));
+
+    expect(bankAliasing < 1.0e-8, "Band-limited saw should not alias");
+    expect(naiveAliasing > 1000.0 * bankAliasing,
+           "Naive saw aliases far more than the bank");
+  }
+
+  void testCrossfadeContinuity() {
+    const auto& bank = WaveTableBank::get(WaveTable::WaveType::SQUARE);
+    const float boundary = 16.0f * kTwoPi / 4096.0f;  // level 4 exactly
+
+    std::vector<float> below(64);
+    std::vector<float> above(64);
+    bank.renderBlock(below.data(), 64, 1.0f, boundary * 0.9999f);
+    bank.renderBlock(above.data(), 64, 1.0f, boundary);
+
+    float maxStep = 0.0f;
+    for (size_t i = 0; i < below.size(); ++i) {
+      maxStep = std::max(maxStep, std::abs(below[i] - above[i]));
+    }
+    expect(maxStep < 0.01f, "Crossing an octave should not change the timbre "
+                            "abruptly (step " + juce::String(maxStep) + ")");
+  }
+};
+
+static WaveTableBankTests waveTableBankTests;
@@ -0,0 +1,236 @@
+#include <juce_core/juce_core.h>
+#include <cmath>
+#include <vector>
+#include "../include/wave-table-simd.hpp"
+#include "../include/wave-table.hpp"
+
+/**
+ * Unit tests for the WaveTable block API and its SIMD kernels
+ * Tests block lookups against getSample(), every available instruction set
+ * against the scalar kernels (block and voice kernels), and phase
+ * continuity across blocks
+ */
+class WaveTableSimdTests : public juce::UnitTest {
+ public:
+  WaveTableSimdTests() : juce::UnitTest("WaveTableSimd Tests") {}
+
+  void runTest() override {
+    logMessage("Best SIMD level: " + juce::String(WaveTableSimd::getLevelName(
+                                         WaveTableSimd::getBestLevel())));
+
+    beginTest("Block lookup matches per-sample lookup");
+    testBlockMatchesPerSample();
+
+    beginTest("SIMD kernels match scalar kernels");
+    testKernelsMatchScalar();
+
+    beginTest("SIMD voice kernels match the scalar voice kernel");
+    testVoiceKernelsMatchScalar();
+
+    beginTest("Phase is continuous across blocks");
+    testPhaseContinuity();
+
+    beginTest("Extreme phase modulation stays in the table");
+    testExtremeModulation();
+  }
+
+ private:
+  static constexpr float kTwoPi = 2.0f * juce::MathConstants<float>::pi;
+
+  void testBlockMatchesPerSample() {
+    WaveTable waveTable(WaveTable::WaveType::SINE, 2048);
+    const float increment = kTwoPi * 440.0f / 44100.0f;
+    std::vector<float> block(1000);
+    waveTable.renderBlock(block.data(), (int)block.size(), 1.0f, increment);
+
+    // getSample() accumulates in radians, the block in table units: both
+    // track the same phase up to float rounding
+    double phase = 1.0;
+    float maxError = 0.0f;
+    for (float sample : block) {
+      maxError = std::max(maxError,
+                          std::abs(sample - waveTable.getSample((float)phase)));
+      phase = std::fmod(phase + (double)increment, (double)kTwoPi);
+    }
+    expect(maxError < 1.0e-3f,
+           "Block and per-sample lookups differ by " + juce::String(maxError));
+
+    // Nearest lookup stays on table samples
+    waveTable.renderBlock(block.data(), (int)block.size(), 0.0f, increment,
+                          WaveTable::Interpolation::NEAREST);
+    expect(std::abs(block[0]) < 1.0e-6f, "Nearest lookup at 0 should be 0");
+  }
+
+  void testKernelsMatchScalar() {
+    constexpr int tableSize = 2048;
+    std::vector<float> table(tableSize + 1);
+    for (int i = 0; i <= tableSize; ++i) {
+      table[(size_t)i] = std::sin(kTwoPi * (float)(i % tableSize) / tableSize);
+    }
+
+    juce::Random random(42);
+    std::vector<float> modulation(4096);
+    for (auto& value : modulation) {
+      value = (random.nextFloat() - 0.5f) * 40.0f;
+    }
+
+    const auto* scalar = WaveTableSimd::getKernels(WaveTableSimd::Level::Scalar);
+    expect(scalar != nullptr, "Scalar kernels are always available");
+
+    const WaveTableSimd::Level levels[] = {WaveTableSimd::Level::SSE2,
+                                           WaveTableSimd::Level::AVX2,
+                                           WaveTableSimd::Level::AVX512};
+
+    for (auto level : levels) {
+      const auto* kernels = WaveTableSimd::getKernels(level);
+      if (kernels == nullptr) {
+        logMessage(juce::String(WaveTableSimd::getLevelName(level)) +
+                   " not available, skipped");
+        continue;
+      }
+
+      float maxError = 0.0f;
+      float maxPositionError = 0.0f;
+
+      // Odd lengths exercise the partial last chunk, negative increments
+      // the wrapping below zero
+      for (int numSamples : {1, 15, 16, 17, 333, 4096}) {
+        for (float increment : {0.0f, 20.43f, -7.5f, 1000.1f}) {
+          for (bool modulated : {false, true}) {
+            for (bool linear : {true, false}) {
+              std::vector<float> expected((size_t)numSamples);
+              std::vector<float> actual((size_t)numSamples);
+
+              WaveTableSimd::BlockJob job{table.data(),
+                                          tableSize,
+                                          expected.data(),
+                                          modulated ? modulation.data() : nullptr,
+                                          tableSize / kTwoPi,
+                                          numSamples,
+                                          1234.5f,
+                                          increment};
+              const float expectedPosition =
+                  linear ? scalar->linear(job) : scalar->nearest(job);
+
+              job.output = actual.data();
+              const float actualPosition =
+                  linear ? kernels->linear(job) : kernels->nearest(job);
+
+              maxPositionError = std::max(
+                  maxPositionError, std::abs(expectedPosition - actualPosition));
+              for (int i = 0; i < numSamples; ++i) {
+                maxError = std::max(
+                    maxError, std::abs(expected[(size_t)i] - actual[(size_t)i]));
+              }
+            }
+          }
+        }
+      }
+
+      logMessage(juce::String(WaveTableSimd::getLevelName(level)) +
+                 " max error: " + juce::String(maxError));
+      expect(maxError <= 1.0e-6f,
+             juce::String(WaveTableSimd::getLevelName(level)) +
+                 " differs from scalar by " + juce::String(maxError));
+      expectEquals(maxPositionError, 0.0f,
+                   "Returned position must not depend on the level");
+    }
+  }
+
+  void testVoiceKernelsMatchScalar() {
+    using WaveTableSimd::kChunkSize;
+    using WaveTableSimd::kVoiceLanes;
+
+    // Three tables with their guard samples, voices spread across them
+    constexpr int tableSize = 512;
+    constexpr int numVoices = 3 * kVoiceLanes;
+    juce::Random random(7);
+    std::vector<float> tables(3 * (tableSize + 1));
+    for (auto& value : tables) {
+      value = random.nextFloat() * 2.0f - 1.0f;
+    }
+
+    std::vector<float> position(numVoices), increment(numVoices);
+    std::vector<float> gain(numVoices), gainStep(numVoices);
+    std::vector<int> tableOffset(numVoices);
+    for (int voice = 0; voice < numVoices; ++voice) {
+      position[(size_t)voice] = random.nextFloat() * (float)tableSize;
+      increment[(size_t)voice] = random.nextFloat() * (float)tableSize * 0.5f;
+      gain[(size_t)voice] = random.nextFloat();
+      gainStep[(size_t)voice] = (random.nextFloat() - 0.5f) * 0.01f;
+      tableOffset[(size_t)voice] = (voice % 3) * (tableSize + 1);
+    }
+
+    const auto mix = [&](const WaveTableSimd::Kernels& kernels, int numSamples) {
+      // Partial sums start non-zero: kernels add to them
+      std::vector<float> partials((size_t)(kChunkSize * kVoiceLanes), 0.25f);
+      const WaveTableSimd::VoiceJob job{tables.data(),   tableSize,
+                                        numVoices,       numSamples,
+                                        position.data(), increment.data(),
+                                        gain.data(),     gainStep.data(),
+                                        tableOffset.data(), partials.data()};
+      kernels.voices(job);
+      return partials;
+    };
+
+    const auto* scalar = WaveTableSimd::getKernels(WaveTableSimd::Level::Scalar);
+    const WaveTableSimd::Level levels[] = {WaveTableSimd::Level::SSE2,
+                                           WaveTableSimd::Level::AVX2,
+                                           WaveTableSimd::Level::AVX512};
+    for (auto level : levels) {
+      const auto* kernels = WaveTableSimd::getKernels(level);
+      if (kernels == nullptr) {
+        continue;
+      }
+      for (int numSamples : {1, 7, kChunkSize}) {
+        expect(mix(*kernels, numSamples) == mix(*scalar, numSamples),
+               juce::String(WaveTableSimd::getLevelName(level)) + " differs from "
+               "scalar for " + juce::String(numSamples) + " samples");
+      }
+    }
+  }
+
+  void testPhaseContinuity() {
+    WaveTable waveTable(WaveTable::WaveType::SAW, 2048);
+    const float increment = kTwoPi * 1234.0f / 48000.0f;
+
+    std::vector<float> whole(1024);
+    waveTable.renderBlock(whole.data(), (int)whole.size(), 0.0f, increment);
+
+    // Blocks that are multiples of the chunk size resume exactly
+    std::vector<float> pieces(whole.size());
+    float phase = 0.0f;
+    for (size_t start = 0; start < pieces.size(); start += 128) {
+      phase = waveTable.renderBlock(pieces.data() + start, 128, phase, increment);
+    }
+
+    float maxError = 0.0f;
+    for (size_t i = 0; i < whole.size(); ++i) {
+      maxError = std::max(maxError, std::abs(whole[i] - pieces[i]));
+    }
+    expect(maxError < 1.0e-4f,
+           "Split rendering differs by " + juce::String(maxError));
+    expect(phase >= 0.0f && phase <= kTwoPi, "Returned phase is wrapped");
+  }
+
+  void testExtremeModulation() {
+    WaveTable waveTable(WaveTable::WaveType::SINE, 2048);
+
+    std::vector<float> modulation(512);
+    for (size_t i = 0; i < modulation.size(); ++i) {
+      modulation[i] = (i % 2 == 0 ? 1.0f : -1.0f) * 1000.0f * (float)i;
+    }
+
+    std::vector<float> output(modulation.size());
+    waveTable.renderBlock(output.data(), modulation.data(), (int)output.size(),
+                          -1.0e4f, -0.3f);
+
+    bool inRange = true;
+    for (float sample : output) {
+      inRange = inRange && std::abs(sample) <= 1.0f;
+    }
+    expect(inRange, "Modulated samples must come from the table");
+  }
+};
+
+static WaveTableSimdTests waveTableSimdTests;